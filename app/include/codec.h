@@ -0,0 +1,122 @@
+/**
+ * @file codec.h
+ * @brief Optional blob compression (zlib when built with DB_HAVE_ZLIB).
+ *
+ * @author  Roman Horshkov <roman.horshkov@gmail.com>
+ * @date    2025
+ * (c) 2025
+ */
+
+#ifndef CODEC_H
+#define CODEC_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/****************************************************************************
+ * PUBLIC STRUCTURED VARIABLES
+ ****************************************************************************
+*/
+
+/* One deflate stream writing to an fd. Not thread-safe: one owner. */
+typedef struct CodecZ CodecZ;
+
+/* One inflating reader over a stream in an fd. Not thread-safe: one owner. */
+typedef struct CodecRd CodecRd;
+
+/****************************************************************************
+ * PUBLIC FUNCTIONS DECLARATIONS
+ ****************************************************************************
+*/
+
+/**
+ * @brief 1 if this build can compress (zlib), 0 otherwise.
+ */
+int codec_zlib_available(void);
+
+/**
+ * @brief Compressed size of in[0..n) at 'level', without keeping the output
+ *        (a cheap "is it worth it" probe over the first chunk of a stream).
+ * @return 0 on success, -ENOTSUP without zlib, -ENOMEM or -EIO.
+ */
+int codec_deflate_probe(const void* in, size_t n, int level, size_t* out_len);
+
+/**
+ * @brief Start a zlib stream at 'level' (1..9) appending to 'out_fd' at
+ *        offset 0. Every 1 MiB of input ends in a full flush recorded as a
+ *        seek point; codec_deflate_finish() appends them as a footer.
+ * @return The stream, or NULL with errno set (ENOTSUP without zlib).
+ */
+CodecZ* codec_deflate_open(int level, int out_fd);
+
+/**
+ * @brief Compress in[0..n) into the stream (output is written as it fills).
+ * @return 0 on success, -errno on a write or codec error.
+ */
+int codec_deflate_write(CodecZ* z, const void* in, size_t n);
+
+/**
+ * @brief Flush the end of the stream and write the seek point footer.
+ *        *out_written = bytes written, footer included.
+ * @return 0 on success, -errno on a write or codec error.
+ */
+int codec_deflate_finish(CodecZ* z, uint64_t* out_written);
+
+/**
+ * @brief Free the stream (finished or not). The fd is not closed.
+ */
+void codec_deflate_close(CodecZ* z);
+
+/**
+ * @brief 1 if 'in_fd' holds a stream written by codec_deflate_finish() (it
+ *        ends in the seek point footer), 0 if not.
+ * @return 1, 0, -EINVAL or -EIO on a read error.
+ */
+int codec_stream_probe(int in_fd);
+
+/**
+ * @brief Reader over the stream in 'in_fd' positioned at decompressed
+ *        offset 'off': inflation starts at the last seek point at or
+ *        before it (offset 0 for streams without a footer).
+ * @return The reader, or NULL with errno set (ENOTSUP without zlib, ENOMEM,
+ *         EIO on a read error or a corrupt stream).
+ */
+CodecRd* codec_inflate_open(int in_fd, uint64_t off);
+
+/**
+ * @brief Next decompressed bytes, up to 'len'. *out_n is short only at the
+ *        end of the stream.
+ * @return 0 on success, -ENOTSUP without zlib, -ENOMEM or -EIO.
+ */
+int codec_inflate_read(CodecRd* r, void* buf, size_t len, size_t* out_n);
+
+/**
+ * @brief Free the reader. The fd is not closed.
+ */
+void codec_inflate_close(CodecRd* r);
+
+/**
+ * @brief codec_inflate_open() + codec_inflate_read() + close: copy up to
+ *        'len' decompressed bytes from 'off' into 'buf'.
+ * @return 0 on success (*out_n may be short at the end), -ENOTSUP without
+ *         zlib, -ENOMEM or -EIO on a read error or a corrupt stream.
+ */
+int codec_inflate_range(int in_fd, uint64_t off, void* buf, size_t len,
+                        size_t* out_n);
+
+/**
+ * @brief Inflate the whole stream in 'in_fd' and write it to 'out_fd'.
+ * @return 0 on success, -ENOTSUP without zlib, -ENOMEM or -EIO.
+ */
+int codec_inflate_to_fd(int in_fd, int out_fd, uint64_t* out_n);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CODEC_H */
@@ -0,0 +1,51 @@
+/**
+ * @file blake3.h
+ * @brief BLAKE3 (256-bit output, unkeyed): incremental hashing, and a
+ *        one-shot form that hashes the subtrees of a large input on several
+ *        threads. Chunks are compressed 8 or 16 at a time on AVX2 / AVX-512.
+ *
+ * @author  Roman Horshkov <roman.horshkov@gmail.com>
+ * @date    2025
+ * (c) 2025
+ */
+
+#ifndef CRYPTOGRAPHY_BLAKE3_H
+#define CRYPTOGRAPHY_BLAKE3_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define CRYPT_BLAKE3_OUT_LEN 32
+
+/* SIMD kernels (same bits as CRYPT_SHA256_IMPL_AVX2 / _AVX512) */
+#define CRYPT_BLAKE3_IMPL_AVX2   0x2u
+#define CRYPT_BLAKE3_IMPL_AVX512 0x4u
+
+/* Enable the kernels of 'mask' this CPU supports (process-wide; default:
+   all of them; 0 = portable code only). Returns the mask now in effect. */
+unsigned crypt_blake3_set_impl(unsigned mask);
+
+/* Hash p[0..n). Inputs of several MiB are split into 1 MiB subtrees hashed
+   on up to 'threads' threads (0 = one per CPU, 1 = the caller only). */
+void crypt_blake3(const void* p, size_t n, unsigned threads,
+                  uint8_t out[CRYPT_BLAKE3_OUT_LEN]);
+
+/* Incremental hashing for bytes that arrive piecewise. */
+typedef struct CryptBlake3 CryptBlake3;
+
+/* New hasher, or NULL on allocation failure. */
+CryptBlake3* crypt_blake3_begin(void);
+/* Feed p[0..n). */
+void         crypt_blake3_update(CryptBlake3* h, const void* p, size_t n);
+/* Write the digest (unless out is NULL) and free the hasher. */
+void         crypt_blake3_end(CryptBlake3* h, uint8_t out[CRYPT_BLAKE3_OUT_LEN]);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* CRYPTOGRAPHY_BLAKE3_H */
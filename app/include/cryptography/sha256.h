@@ -3,6 +3,10 @@
 
 #include <stddef.h>
 #include <stdint.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+#include "fsutil.h"
 
 #ifdef __cplusplus
 extern "C"
@@ -17,6 +21,13 @@ typedef struct
 /* Lowercase hex (out[65], NUL-terminated). */
 void crypt_sha256_hex(const Sha256* d, char out[65]);
 
+/* Hash an in-memory buffer. Returns 0 on success. */
+int crypt_sha256_buf(const void* p, size_t n, Sha256* out);
+
+/* Hash the in-memory segments iov[0..iovcnt) in order. Returns 0 on
+   success. */
+int crypt_sha256_iov(const struct iovec* iov, int iovcnt, Sha256* out);
+
 /* Hash the entire file at path. Returns 0 on success. */
 int crypt_sha256_file(const char* path, Sha256* out, size_t* size_out);
 
@@ -25,13 +36,156 @@ int crypt_sha256_file(const char* path, Sha256* out, size_t* size_out);
    Returns 0 on success. */
 int crypt_sha256_fd(int fd, Sha256* out, size_t* size_out);
 
-/* High-level ingest:
-   Read from src_fd, hash while copying to a temp under root, fsync,
-   then atomically rename to objects/sha256/aa/bb/<hex> (dedup if exists).
-   On success: set digest_out + size_out. Returns 0. */
-int crypt_store_sha256_object_from_fd(const char* root, int src_fd,
+/* Incremental hashing for bytes that arrive piecewise. */
+typedef struct CryptSha256Ctx CryptSha256Ctx;
+
+/* New context, or NULL on allocation failure. */
+CryptSha256Ctx* crypt_sha256_begin(void);
+/* Feed p[0..n). Returns 0 on success. */
+int crypt_sha256_update(CryptSha256Ctx* c, const void* p, size_t n);
+/* Write the digest (unless out is NULL) and free the context. Returns 0 on
+   success; the context is freed either way. */
+int crypt_sha256_end(CryptSha256Ctx* c, Sha256* out);
+
+/* Resumable hashing: the state is plain data that crypt_sha256_state_save()
+   turns into CRYPT_SHA256_STATE_SIZE portable bytes (chaining value, length
+   and the pending partial block), so a hash can continue in another process
+   after crypt_sha256_state_load(). */
+#define CRYPT_SHA256_STATE_SIZE 104
+
+typedef struct
+{
+    uint32_t h[8];    /* chaining value */
+    uint64_t len;     /* bytes fed so far */
+    uint8_t  buf[64]; /* the len % 64 bytes of the partial block */
+} CryptSha256State;
+
+void crypt_sha256_state_init(CryptSha256State* s);
+/* Feed p[0..n). */
+void crypt_sha256_state_update(CryptSha256State* s, const void* p, size_t n);
+/* Digest of the bytes fed so far; 's' is left unchanged (more may follow). */
+void crypt_sha256_state_final(const CryptSha256State* s, Sha256* out);
+void crypt_sha256_state_save(const CryptSha256State* s,
+                             uint8_t out[CRYPT_SHA256_STATE_SIZE]);
+void crypt_sha256_state_load(CryptSha256State* s,
+                             const uint8_t in[CRYPT_SHA256_STATE_SIZE]);
+
+/* Internal SHA-256 backends, dispatched at run time; with none enabled the
+   in-memory entry points go through OpenSSL. */
+#define CRYPT_SHA256_IMPL_SHANI  0x1u /* SHA extensions, one stream */
+#define CRYPT_SHA256_IMPL_AVX2   0x2u /* 8 messages at once */
+#define CRYPT_SHA256_IMPL_AVX512 0x4u /* 16 messages at once */
+#define CRYPT_SHA256_IMPL_ALL    0x7u
+
+/* Enable the backends of 'mask' this CPU supports (process-wide; default:
+   all of them). Returns the mask now in effect. */
+unsigned crypt_sha256_set_impl(unsigned mask);
+/* Backends in effect. */
+unsigned crypt_sha256_impl(void);
+
+/* Hash 'count' independent buffers: out[i] = SHA-256(p[i][0..n[i])). Runs
+   8 or 16 messages per instruction on the multi-buffer backends. Returns 0
+   on success. */
+int crypt_sha256_many(size_t count, const void* const p[], const size_t n[],
+                      Sha256 out[]);
+
+/* Hash [off, off+len) of a seekable fd without moving its offset (mmap with
+   sequential readahead, pread fallback). Returns 0 on success, -1 on error
+   or if the file is shorter than off+len. */
+int crypt_sha256_fd_range(int fd, off_t off, size_t len, Sha256* out);
+
+/* Content digest: the hash objects are addressed by. SHA-256 by default;
+   BLAKE3 (same 32-byte size, kept in a Sha256) hashes large contents on
+   several cores. The crypt_sha256_* functions above are always SHA-256. */
+typedef enum
+{
+    CRYPT_HASH_SHA256 = 0,
+    CRYPT_HASH_BLAKE3
+} CryptHash;
+
+/* Select the content digest (process-wide; set by db_open from the store). */
+void      crypt_set_content_hash(CryptHash h);
+CryptHash crypt_content_hash(void);
+
+/* Content-digest counterparts of crypt_sha256_buf/_iov/_fd_range/_many.
+   Return 0 on success. */
+int crypt_digest_buf(const void* p, size_t n, Sha256* out);
+int crypt_digest_iov(const struct iovec* iov, int iovcnt, Sha256* out);
+int crypt_digest_fd_range(int fd, off_t off, size_t len, Sha256* out);
+int crypt_digest_many(size_t count, const void* const p[], const size_t n[],
+                      Sha256 out[]);
+
+/* Contents crypt_digest_many() hashes side by side on this CPU: the
+   multi-buffer lane count, 1 when it hashes them one after another (a
+   caller spreading items over threads should then hash on the threads). */
+unsigned crypt_digest_lanes(void);
+
+/* Incremental content digest, semantics of crypt_sha256_begin/_update/_end. */
+typedef struct CryptDigestCtx CryptDigestCtx;
+
+CryptDigestCtx* crypt_digest_begin(void);
+int             crypt_digest_update(CryptDigestCtx* c, const void* p, size_t n);
+int             crypt_digest_end(CryptDigestCtx* c, Sha256* out);
+
+/* High-level ingest (the digest is the content digest, despite the name):
+   Read from src_fd, hash while copying to an O_TMPFILE in the object
+   directory, fsync, then linkat it to aa/bb/<hex> through the cached shard
+   handles of 'od' (dedup if exists).
+   On success: set digest_out + size_out. Returns 0.
+   Regular-file sources skip the userspace copy: the temp is reflinked
+   (FICLONE) or filled with copy_file_range, then hashed through mmap.
+   Pipes, sockets and filesystems without kernel copy use the streaming
+   engine selected by crypt_set_ingest_engine(). With crypt_set_compression()
+   on, compressible sources are deflated while they are hashed instead. */
+int crypt_store_sha256_object_from_fd(FsObjDir* od, int src_fd,
                                       Sha256* digest_out, size_t* size_out);
 
+/* Same copy+hash as above but stop before publishing: the data is left in
+   'tmp' for fs_objdir_publish()/fs_objdir_tmp_discard(). With sync == 0 the
+   temp is not fsynced; the caller must make it durable before publishing
+   (e.g. one fs_flusher_sync() for a whole group). Returns 0 on success. */
+int crypt_stage_sha256_object_from_fd(FsObjDir* od, int src_fd, FsTmp* tmp,
+                                      Sha256* digest_out, size_t* size_out,
+                                      int sync);
+
+/* Write the in-memory object iov[0..iovcnt) into a new temp in 'od' with
+   pwritev (deflated instead when crypt_set_compression() is on and it
+   pays), for fs_objdir_publish()/fs_objdir_tmp_discard(). The caller has
+   hashed the bytes already; 'sync' as above. Returns 0 on success. */
+int crypt_stage_object_from_iov(FsObjDir* od, const struct iovec* iov,
+                                int iovcnt, FsTmp* tmp, int sync);
+
+/* Enable/disable the regular-file zero-copy ingest path (default on). */
+void crypt_set_zero_copy(int enable);
+
+/* Engine for sources the kernel cannot copy (pipes, sockets, zero-copy off).
+   AUTO/URING: io_uring with reads+writes in flight on registered buffers and
+   a linked fsync; falls back to THREADS when io_uring is unavailable.
+   THREADS: caller reads+hashes while a helper thread writes behind.
+   SERIAL: the plain read/write loop. */
+typedef enum
+{
+    CRYPT_ENGINE_AUTO = 0,
+    CRYPT_ENGINE_URING,
+    CRYPT_ENGINE_THREADS,
+    CRYPT_ENGINE_SERIAL
+} CryptEngine;
+
+/* Select the ingest engine (process-wide, default CRYPT_ENGINE_AUTO). */
+void crypt_set_ingest_engine(CryptEngine engine);
+
+/* Store objects zlib-compressed at 'level' (1..9; 0 = off, the default).
+   The digest is always over the uncompressed bytes. A source whose first
+   64 KiB do not compress by 10% is stored raw; a compressed object ends in
+   the codec footer (codec_stream_probe()). No-op in builds without zlib. */
+void crypt_set_compression(int level);
+
+/* Current level (0 when off or unavailable). */
+int crypt_compression_level(void);
+
+/* 1 if the io_uring engine can be used by the calling thread. */
+int crypt_uring_available(void);
+
 /* Cryptographically strong random bytes. Returns 0 on success. */
 int crypt_rand_bytes(void* buf, size_t n);
 
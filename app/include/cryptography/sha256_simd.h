@@ -0,0 +1,45 @@
+/**
+ * @file sha256_simd.h
+ * @brief SHA-256 compression kernels for x86 extensions (SHA-NI, AVX2 and
+ *        AVX-512 multi-buffer), picked at run time by sha256.c.
+ *
+ * @author  Roman Horshkov <roman.horshkov@gmail.com>
+ * @date    2025
+ * (c) 2025
+ */
+
+#ifndef CRYPTOGRAPHY_SHA256_SIMD_H
+#define CRYPTOGRAPHY_SHA256_SIMD_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/* Widest multi-buffer kernel */
+#define SHA256_LANES_MAX 16
+
+/* Round constants (FIPS 180-4), shared with the portable code */
+extern const uint32_t crypt_sha256_k[64];
+
+/* CRYPT_SHA256_IMPL_* bits this CPU (and build) can run. */
+unsigned sha256_simd_features(void);
+
+/* SHA-NI: compress 'nblk' 64-byte blocks of p into h[8]. */
+void sha256_blocks_shani(uint32_t h[8], const uint8_t* p, size_t nblk);
+
+/* Multi-buffer: lane l compresses 'nblk' consecutive blocks at blk[l] into
+   the chaining value st[0..7][l] (one row per state word). The AVX2 kernel
+   runs lanes 0..7 only. */
+void sha256_x8_avx2(uint32_t st[8][SHA256_LANES_MAX],
+                    const uint8_t* const blk[SHA256_LANES_MAX], size_t nblk);
+void sha256_x16_avx512(uint32_t st[8][SHA256_LANES_MAX],
+                       const uint8_t* const blk[SHA256_LANES_MAX], size_t nblk);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* CRYPTOGRAPHY_SHA256_SIMD_H */
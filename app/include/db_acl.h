@@ -19,6 +19,8 @@ typedef enum
 
 /* ----------------------------- Grants / Revokes ---------------------------- */
 
+/* Grants: 0, MDB_MAP_FULL when the map must grow (the caller grows it and
+   retries the txn; it is never folded into -ENOMEM) or -errno. */
 int acl_grant_owner(MDB_txn* txn, const uint8_t principal[DB_ID_SIZE],
                     const uint8_t resource[DB_ID_SIZE]);
 
@@ -62,6 +64,8 @@ typedef int (*acl_iter_cb)(const uint8_t resource[DB_ID_SIZE], uint8_t rel,
 int acl_list_data_for_user(MDB_txn* txn, const uint8_t principal[DB_ID_SIZE],
                            acl_iter_cb cb, void* user);
 
+/* Drop every grant on 'resource': 0, MDB_MAP_FULL (as for the grants) or
+   -errno. */
 int acl_data_destroy(MDB_txn* txn, const uint8_t resource[DB_ID_SIZE]);
 
 #endif /* DB_ACL_H */
\ No newline at end of file
@@ -0,0 +1,99 @@
+/**
+ * @file db_chunk.h
+ * @brief Content-defined chunking: large objects cut at Gear-hash
+ *        boundaries, chunks stored once in pack files, objects kept as a
+ *        manifest of chunk digests.
+ *
+ * @author  Roman Horshkov <roman.horshkov@gmail.com>
+ * @date    2025
+ * (c) 2025
+ */
+
+#ifndef DB_CHUNK_H
+#define DB_CHUNK_H
+
+#include "db_int.h"
+#include "db_pack.h"
+#include "sha256.h"
+#include <stdint.h>
+#include <sys/uio.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/* One manifest entry: data_manifests value is an array of these, 40 bytes */
+typedef struct __attribute__((packed))
+{
+    uint8_t  sha[32]; /* SHA-256 of the chunk (its data_packs key) */
+    uint64_t end;     /* object offset just past the chunk */
+} ChunkRef;
+
+/* An object cut by chunk_ingest_fd() and not indexed yet */
+typedef struct
+{
+    ChunkRef* refs;  /* n entries, in object order */
+    PackLoc*  locs;  /* where a chunk was appended; .pack == 0: known */
+    size_t    n;
+    size_t    cap;
+    size_t    fresh; /* appended (pinned) chunks */
+} ChunkList;
+
+/* One chunk of an object located by chunk_locate() */
+typedef struct
+{
+    PackLoc  loc;   /* the chunk's bytes */
+    uint64_t start; /* object offset of its first byte */
+} ChunkSpan;
+
+/* Read 'src_fd' to EOF and cut it into chunks averaging 'avg' bytes (a
+   power of two; min avg/4, max 8*avg). Hashes the whole object and every
+   chunk; chunks whose bytes are not in a pack yet are appended and made
+   durable with one sync. 0 (free 'out' with chunk_list_free) or -EIO. */
+int chunk_ingest_fd(int src_fd, size_t avg, Sha256* digest, size_t* size,
+                    ChunkList* out);
+
+/* chunk_ingest_fd() over the caller's memory iov[0..iovcnt); a single
+   segment is cut in place, several are gathered through the window. With
+   'known', *digest already holds the content digest of these bytes and
+   only the chunks are hashed. */
+int chunk_ingest_iov(const struct iovec* iov, int iovcnt, size_t avg,
+                     int known, Sha256* digest, size_t* size,
+                     ChunkList* out);
+
+/* Release the pins of the appended chunks and free the list. */
+void chunk_list_free(ChunkList* cl);
+
+/* First reference of object 'sha' inside a write txn: index the appended
+   chunks, take a reference on every chunk and store the manifest.
+   MDB_NOTFOUND when a known chunk was dropped meanwhile (caller reports
+   -EAGAIN), MDB_MAP_FULL, or another MDB rc. */
+int chunk_manifest_put(MDB_txn* txn, const uint8_t sha[32],
+                       const ChunkList* cl);
+
+/* Last reference of object 'sha' is gone: drop the manifest and a
+   reference on every chunk; unreferenced chunks lose their pack index
+   entry (dead space for the repacker). MDB rc. */
+int chunk_manifest_release(MDB_txn* txn, const uint8_t sha[32]);
+
+/* 1 when some manifest references a chunk with this digest, else 0. */
+int chunk_in_use(MDB_txn* txn, const uint8_t sha[32]);
+
+/* Copy 'len' bytes at 'off' of the chunked object 'sha' (size bytes).
+   0, -ENOENT when the manifest or a chunk is gone, -EIO. */
+int chunk_read(MDB_txn* txn, const uint8_t sha[32], uint64_t size,
+               uint64_t off, void* buf, size_t len);
+
+/* Locate up to 'max' chunks of object 'sha' (size bytes) into out[], from
+   the one holding byte 'off' on; *out_n = how many. The spans outlive the
+   txn for a caller that entered it as a pack reader (pack_reader_enter).
+   0, -ENOENT when the manifest or a chunk is gone, -EINVAL, -EIO. */
+int chunk_locate(MDB_txn* txn, const uint8_t sha[32], uint64_t size,
+                 uint64_t off, ChunkSpan* out, size_t max, size_t* out_n);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* DB_CHUNK_H */
@@ -12,6 +12,7 @@
 
 #include <errno.h>
 #include <lmdb.h>
+#include <stdatomic.h>
 #include <stddef.h>
 #include <stdlib.h>
 #include <stdint.h>
@@ -21,6 +22,7 @@
 #include <unistd.h>  // unlink
 
 #include "db_interface.h"
+#include "fsutil.h"
 
 #ifdef __cplusplus
 extern "C"
@@ -34,6 +36,79 @@ extern "C"
 
 /* -------------------------- ACL namespaces -------------------------------- */
 
+/* ------------------------- Inline small objects --------------------------- */
+/* Upper bound for DB_INLINE_MAX: larger values would only bloat the map */
+#ifndef DB_INLINE_MAX_CAP
+#    define DB_INLINE_MAX_CAP (64u * 1024u)
+#endif
+
+/* ----------------------------- Pack files --------------------------------- */
+/* Upper bound for DB_PACK_MAX: larger objects are better off in a blob */
+#ifndef DB_PACK_MAX_CAP
+#    define DB_PACK_MAX_CAP (16u * 1024u * 1024u)
+#endif
+/* Default pack segment size (DB_PACK_SEGMENT_KB) */
+#ifndef DB_PACK_SEGMENT_DEFAULT
+#    define DB_PACK_SEGMENT_DEFAULT (256ull * 1024u * 1024u)
+#endif
+/* Default dead-byte threshold of the background repacker */
+#ifndef DB_REPACK_DEAD_PCT_DEFAULT
+#    define DB_REPACK_DEAD_PCT_DEFAULT 30u
+#endif
+
+/* ------------------------------ Orphan GC --------------------------------- */
+/* Grace period of db_data_gc(NULL, ..) unless DB_GC_GRACE_S says otherwise */
+#ifndef DB_GC_GRACE_DEFAULT
+#    define DB_GC_GRACE_DEFAULT 3600u
+#endif
+
+/* ------------------------------- Trash ------------------------------------ */
+/* Default period of the trash reaper (DB_TRASH_REAP_INTERVAL_S) */
+#ifndef DB_TRASH_REAP_INTERVAL_DEFAULT
+#    define DB_TRASH_REAP_INTERVAL_DEFAULT 60u
+#endif
+/* Default undelete window of trashed records (DB_TRASH_GRACE_S), s */
+#ifndef DB_TRASH_GRACE_DEFAULT
+#    define DB_TRASH_GRACE_DEFAULT 86400u
+#endif
+/* Records per write txn of db_data_delete_many() and db_data_reap() */
+#ifndef DB_DELETE_TXN_MAX
+#    define DB_DELETE_TXN_MAX 4096u
+#endif
+
+/* --------------------------- Upload sessions ------------------------------ */
+/* Idle time after which the reaper drops a session (DB_UPLOAD_TTL_S) */
+#ifndef DB_UPLOAD_TTL_DEFAULT
+#    define DB_UPLOAD_TTL_DEFAULT 86400u
+#endif
+/* Default period of the session reaper (DB_UPLOAD_REAP_INTERVAL_S) */
+#ifndef DB_UPLOAD_REAP_INTERVAL_DEFAULT
+#    define DB_UPLOAD_REAP_INTERVAL_DEFAULT 600u
+#endif
+
+/* ------------------------ Content-defined chunking ------------------------ */
+/* Bounds of DB_CDC_AVG_KB (rounded down to a power of two); chunks range
+   from a quarter to eight times the average */
+#ifndef DB_CDC_AVG_MIN
+#    define DB_CDC_AVG_MIN (4u * 1024u)
+#endif
+#ifndef DB_CDC_AVG_MAX
+#    define DB_CDC_AVG_MAX (1024u * 1024u)
+#endif
+
+/* ---------------------------- Shard layout -------------------------------- */
+/* store_conf keys: layout of the objects/<digest> tree ("<levels>x<width>"),
+   and the previous one while db_data_relayout() has not finished */
+#define DB_CONF_LAYOUT      "layout"
+#define DB_CONF_LAYOUT_FROM "layout_from"
+
+/* ---------------------------- Meta cache ---------------------------------- */
+/* Records kept by the db_data_get_meta/_path cache unless DB_META_CACHE
+   says otherwise (about 8 MiB) */
+#ifndef DB_META_CACHE_DEFAULT
+#    define DB_META_CACHE_DEFAULT 65536u
+#endif
+
 /* --------------------------- User roles ----------------------------------- */
 #define USER_ROLE_NONE      0u
 #define USER_ROLE_VIEWER    (1u << 0)
@@ -45,16 +120,46 @@ extern "C"
 */
 
 /* Handle for the whole store.  All LMDB databases live under <root>/meta,   */
-/* while content-addressed objects live under <root>/objects/sha256/.. .     */
+/* while content-addressed objects live under <root>/objects/<digest>/.. .   */
 struct DB
 {
-    char     root[1024]; /* Root directory */
-    MDB_env *env;        /* LMDB environment */
+    char       root[1024];       /* Root directory */
+    MDB_env   *env;              /* LMDB environment */
+    FsObjDir  *objdir;           /* cached objects/<digest> shard handles */
+    int        digest_alg;       /* CryptHash objects are addressed by */
+    unsigned   ingest_threads;   /* worker count for db_data_add_batch */
+    FsFlusher *flusher;          /* group durability; NULL = fsync per object */
+    int        dedup_hash_first; /* hash seekable sources before copying */
+    int        meta_inline_mime; /* write v0 meta records (MIME inline) */
+    size_t     inline_max;       /* objects <= this go to data_inline; 0 off */
+    size_t     pack_max;         /* objects <= this go to pack files; 0 off */
+    size_t     cdc_avg;          /* average CDC chunk size; 0 = no chunking */
+    uint32_t   gc_grace;         /* db_data_gc default grace, seconds */
+    uint32_t   trash_grace;      /* undelete window of trashed records, s */
+    uint32_t   upload_ttl;       /* idle upload sessions expire after, s */
+
+    MDB_dbi db_user_id2data;    /* User DBI */
+    MDB_dbi db_user_mail2id;    /* Email -> ID DBI */
+    MDB_dbi db_data_id2meta;    /* Data meta DBI */
+    MDB_dbi db_data_sha2ids;    /* SHA -> data_ids DBI (dupsort, dupfixed) */
+    MDB_dbi db_data_owner_time; /* owner|created_at|id -> sentinel */
+    MDB_dbi db_data_owner_sha;  /* owner|SHA -> the owner's data_id */
+    MDB_dbi db_data_inline;     /* SHA -> bytes of inline objects */
+    MDB_dbi db_data_packs;      /* SHA -> PackLoc of packed objects */
+    MDB_dbi db_pack_extents;    /* pack|off -> len|SHA (repacker scans) */
+    MDB_dbi db_data_manifests;  /* SHA -> ChunkRef[] of chunked objects */
+    MDB_dbi db_data_chunks;     /* chunk SHA -> manifest references (u64) */
+    MDB_dbi db_data_scrub;      /* scrubber checkpoint */
+    MDB_dbi db_data_trash;      /* id -> deleted_at|meta of trashed records */
+    MDB_dbi db_data_trash_sha;  /* SHA -> trashed ids (dupsort, dupfixed) */
+    MDB_dbi db_data_uploads;    /* session id -> UploadRec */
+    MDB_dbi db_mime_str2id;     /* MIME name -> id(2) */
+    MDB_dbi db_mime_id2str;     /* id(2, big-endian) -> MIME name */
+    MDB_dbi db_store_conf;      /* store-wide settings fixed at creation */
 
-    MDB_dbi db_user_id2data; /* User DBI */
-    MDB_dbi db_user_mail2id; /* Email -> ID DBI */
-    MDB_dbi db_data_id2meta; /* Data meta DBI */
-    MDB_dbi db_data_sha2id;  /* SHA -> data_id DBI */
+    struct MimeCache *mime_cache; /* MIME id -> name, filled on read */
+    struct MetaCache *meta_cache; /* data_id -> meta, filled on read; NULL off */
+    struct PackStore *packs;      /* objects/packs segments and repacker */
 
     MDB_dbi
         db_acl_fwd; /* key=principal(16)|rtype(1)|data(16), val=uint8_t(1) */
@@ -64,12 +169,52 @@ struct DB
     /* Stats and health */
     size_t map_size_bytes;
     size_t map_size_bytes_max;
+
+    _Atomic uint64_t st_objects;     /* objects stored by ingest */
+    _Atomic uint64_t st_fsyncs;      /* per-object fsyncs (non-group mode) */
+    _Atomic uint64_t st_dedup_saved; /* bytes not written (dedup hits) */
 };
 
 extern struct DB *DB; /* defined in db_env.c */
 
 typedef uint8_t user_role_t;
 
+/* On-disk meta records in data_id2meta, told apart by 'ver' and size:
+   v0 (DataMetaV0) keeps the MIME name inline, v1 interns the MIME name in the
+   MIME dictionary and stores its 2-byte id. v0 records are still read; new
+   records are v1 unless the dictionary is full. DB_DATA_F_INLINE (bytes in
+   data_inline), DB_DATA_F_PACKED (bytes in a pack file), DB_DATA_F_ZLIB
+   (compressed blob) or DB_DATA_F_CHUNKED (chunk manifest) may be OR-ed into
+   either version; DATA_META_F_MASK strips them. DATA_META_F_DIGEST names
+   the digest of 'sha' and is not a placement: strip it separately. The
+   public DataMeta gets the version and these bits in separate fields. */
+#define DATA_META_V0     0
+#define DATA_META_V1     1
+#define DATA_META_F_MASK                                    \
+    (DB_DATA_F_INLINE | DB_DATA_F_PACKED | DB_DATA_F_ZLIB | \
+     DB_DATA_F_CHUNKED)
+#define DATA_META_F_DIGEST DB_DATA_F_BLAKE3
+
+typedef struct __attribute__((packed))
+{
+    uint8_t  ver;               /* DATA_META_V0 | DB_DATA_F_* */
+    uint8_t  sha[32];           /* content digest of stored object */
+    char     mime[32];          /* MIME type */
+    uint64_t size;              /* total bytes */
+    uint64_t created_at;        /* epoch seconds */
+    uint8_t  owner[DB_ID_SIZE]; /* uploader id */
+} DataMetaV0;
+
+typedef struct __attribute__((packed))
+{
+    uint8_t  ver;               /* DATA_META_V1 | DB_DATA_F_* */
+    uint8_t  sha[32];           /* content digest of stored object */
+    uint16_t mime_id;           /* MIME dictionary id */
+    uint64_t size;              /* total bytes */
+    uint64_t created_at;        /* epoch seconds */
+    uint8_t  owner[DB_ID_SIZE]; /* uploader id */
+} DataMetaRec;
+
 typedef struct __attribute__((packed))
 {
     uint8_t     ver;              /* 1 byte version for future evolution */
@@ -85,6 +230,24 @@ typedef struct __attribute__((packed))
 int db_map_mdb_err(int mdb_rc);
 int db_env_mapsize_expand(void);
 
+/* Decode a data_id2meta record (v0 or v1) into 'out'. With txn == NULL the
+   MIME name is not resolved (out->mime is empty). 0, -EINVAL on a
+   malformed record, or a mime_lookup() error. */
+int db_data_meta_decode(MDB_txn *txn, const MDB_val *v, DataMeta *out);
+
+/* Meta of one live or trashed record referencing 'sha' (all agree on where
+   and how the content is stored). MDB_SUCCESS, MDB_NOTFOUND or another
+   MDB rc. */
+int db_data_sha_any_meta(MDB_txn *txn, MDB_val *sha, DataMeta *out);
+
+/* Owner must exist and be a publisher: 0, -EPERM, -ENOENT or -EIO. */
+int db_data_check_publisher(const uint8_t owner[DB_ID_SIZE]);
+
+/* Index 'data_id' under its owner: owner|time (listing) and owner|SHA (one
+   record per content and owner). */
+int db_data_owner_index_put(MDB_txn *txn, const DataMeta *meta,
+                            const uint8_t data_id[DB_ID_SIZE]);
+
 int db_user_get_and_check_mem(const MDB_val *v, uint8_t *ver, uint8_t *role,
                               uint8_t *email_len, char email[DB_EMAIL_MAX_LEN],
                               uint8_t *out_size);
@@ -25,21 +25,147 @@ extern "C"
 #define DB_EMAIL_MAX_LEN 128 /* Maximum length for email strings */
 #define DB_VER           0
 
+/* DataMeta.flags bit: the bytes are stored inline in the metadata store and
+   have no file path (read them with db_data_read / db_data_open) */
+#define DB_DATA_F_INLINE 0x80
+
+/* DataMeta.flags bit: the bytes live inside a shared pack file and have no
+   file path of their own (read them with db_data_read / db_data_open) */
+#define DB_DATA_F_PACKED 0x40
+
+/* DataMeta.flags bit: the blob file holds a zlib stream of the bytes
+   (DB_COMPRESS=zlib); db_data_read / db_data_open* decompress it */
+#define DB_DATA_F_ZLIB 0x20
+
+/* DataMeta.flags bit: the bytes are a list of content-defined chunks shared
+   with other objects (DB_CDC_AVG_KB); read them with db_data_read /
+   db_data_stream, or db_data_materialize for a file path */
+#define DB_DATA_F_CHUNKED 0x10
+
+/* DataMeta.flags bit: DataMeta.sha is a BLAKE3 digest; the store was created
+   with DB_CONTENT_HASH=blake3 (db_data_sha256 gives the SHA-256) */
+#define DB_DATA_F_BLAKE3 0x08
+
+/* Faults reported by the integrity scrubber (db_scrub_cb) */
+#define DB_SCRUB_MISSING 1 /* blob file, pack extent or chunk is gone */
+#define DB_SCRUB_SIZE    2 /* stored length differs from DataMeta.size */
+#define DB_SCRUB_HASH    3 /* bytes no longer hash to their digest */
+#define DB_SCRUB_IOERR   4 /* read or decode error */
+
+/* Resume point of a paginated listing: created_at(8) | data_id(16) */
+#define DB_PAGE_TOKEN_SIZE 24
+
 /****************************************************************************
  * PUBLIC STRUCTURED VARIABLES
  ****************************************************************************
 */
 
+/* <sys/uio.h>: segments of db_data_add_from_iov */
+struct iovec;
+
 typedef struct __attribute__((packed))
 {
-    uint8_t  ver;               /* version for future evolution */
-    uint8_t  sha[32];           /* SHA-256 of stored object */
+    uint8_t  ver;               /* record version (0: MIME inline, 1) */
+    uint8_t  flags;             /* DB_DATA_F_* */
+    uint8_t  sha[32];           /* content digest (see DB_DATA_F_BLAKE3) */
     char     mime[32];          /* MIME type */
     uint64_t size;              /* total bytes */
     uint64_t created_at;        /* epoch seconds */
     uint8_t  owner[DB_ID_SIZE]; /* uploader id */
 } DataMeta;
 
+/* Ingest counters since db_open */
+typedef struct
+{
+    uint64_t objects;           /* objects stored */
+    uint64_t syncs;             /* durability syncs issued (fsync or syncfs) */
+    uint64_t dedup_bytes_saved; /* bytes not written (hash-first dedup hits
+                                   and chunks already stored) */
+} DbIngestStats;
+
+/* Counters of the db_data_get_meta / db_data_get_path cache since db_open */
+typedef struct
+{
+    uint64_t hits;     /* lookups served from memory */
+    uint64_t misses;   /* lookups that read the meta DBI */
+    uint64_t entries;  /* records cached now */
+    uint64_t capacity; /* records it holds at most; 0 = cache off */
+} DbMetaCacheStats;
+
+/* Orphan GC settings (db_data_gc); NULL selects the defaults */
+typedef struct
+{
+    uint32_t grace_secs;  /* keep files changed within this many seconds */
+    uint32_t max_per_sec; /* removal rate limit; 0 = unlimited */
+    unsigned threads;     /* shard walkers; 0 = DB_INGEST_THREADS */
+    int      dry_run;     /* report only, remove nothing */
+} DbGcOptions;
+
+/* What one db_data_gc pass found */
+typedef struct
+{
+    uint64_t shards;       /* shard directories walked */
+    uint64_t objects;      /* blob files seen */
+    uint64_t orphans;      /* blobs no record stores as a blob */
+    uint64_t orphan_bytes; /* their size */
+    uint64_t temps;        /* stale temp files */
+    uint64_t temp_bytes;   /* their size */
+    uint64_t removed;      /* files unlinked (0 in a dry run) */
+    uint64_t young;        /* unreferenced files inside the grace period */
+    uint64_t errors;       /* unreadable shards, failed checks or unlinks */
+} DbGcReport;
+
+/* Target of db_data_relayout: 'levels' directories of 'width' hex digits
+   (1..3 each, levels * width <= 6; 2x2 = objects/<digest>/xx/yy) */
+typedef struct
+{
+    unsigned levels;
+    unsigned width;
+    unsigned threads; /* shard movers; 0 = DB_INGEST_THREADS */
+} DbRelayoutOptions;
+
+/* What one db_data_relayout pass did */
+typedef struct
+{
+    uint64_t shards; /* leaf directories of the old layout walked */
+    uint64_t moved;  /* blobs linked into the new layout */
+    uint64_t merged; /* blobs already there (published meanwhile) */
+    uint64_t errors; /* unreadable shards or blobs that could not move */
+} DbRelayoutReport;
+
+/* Integrity scrubber settings (db_scrub_run / db_scrub_start) */
+typedef struct
+{
+    unsigned threads;     /* verifiers; 0 = 1 */
+    uint32_t mb_per_sec;  /* read budget in MiB/s; 0 = unlimited */
+    uint32_t iops;        /* read calls per second; 0 = unlimited */
+    uint64_t max_objects; /* stop after this many; 0 = end of the pass */
+} DbScrubOptions;
+
+/* What one db_scrub_run call did */
+typedef struct
+{
+    uint64_t objects; /* contents verified */
+    uint64_t bytes;   /* bytes read and hashed */
+    uint64_t faults;  /* contents reported to the callback */
+    uint64_t passes;  /* full passes completed so far (checkpointed) */
+    int      wrapped; /* this call finished a pass */
+} DbScrubReport;
+
+/* Callback for db_data_scan_time_range.
+ * Return 0 to continue, non-zero to stop after this item. */
+typedef int (*db_data_scan_cb)(const uint8_t data_id[DB_ID_SIZE],
+                               const DataMeta* meta, void* user);
+
+/* Callback for db_data_stream: the next piece of the bytes, in order.
+ * Return 0 to continue, non-zero to stop (db_data_stream returns it). */
+typedef int (*db_data_sink_cb)(const void* buf, size_t len, void* user);
+
+/* Callback for the integrity scrubber: content 'meta' (one of its
+ * records) failed verification with DB_SCRUB_* 'fault'. Called from the
+ * scrubbing thread, one fault at a time. Return non-zero to stop the run. */
+typedef int (*db_scrub_cb)(const DataMeta* meta, int fault, void* user);
+
 /****************************************************************************
  * PUBLIC FUNCTIONS DECLARATIONS
  ****************************************************************************
@@ -163,14 +289,19 @@ int db_user_list_viewers(uint8_t* out_ids, size_t* inout_count_max);
  * @param img_id Data ID.
  * @param out_path Output path.
  * @param out_sz Output buffer size.
- * @return 0 on success, -ENOENT if meta missing, -EINVAL bad args, -EIO on path error.
+ * @return 0 on success, -ENOENT if meta missing, -ENODATA if the bytes are
+ *         stored inline, packed, compressed or chunked (no plain file; use
+ *         db_data_read or db_data_materialize), -ENAMETOOLONG if out_sz is
+ *         too small (PATH_MAX is always enough), -EINVAL bad args, -EIO on
+ *         path error.
  */
 int db_data_get_path(uint8_t img_id[DB_ID_SIZE], char* out_path,
                      unsigned long out_sz);
 
 /**
- * @brief Owner-only delete that removes: forward ACLs, reverse ACLs, sha->data,
- *        data_meta, and the blob on disk (best-effort) in a single RW txn.
+ * @brief Owner-only delete that removes: forward ACLs, reverse ACLs, this
+ *        record's sha->data reference and data_meta in a single RW txn. The
+ *        blob on disk is removed (best-effort) with its last reference.
  * @param actor Acting user (must have 'O' on data).
  * @param data_id Data to delete.
  * @return 0 on success, -EPERM if actor not owner, -ENOENT if missing, -EIO otherwise.
@@ -178,23 +309,492 @@ int db_data_get_path(uint8_t img_id[DB_ID_SIZE], char* out_path,
 int db_data_delete(const uint8_t actor[DB_ID_SIZE],
                    const uint8_t data_id[DB_ID_SIZE]);
 
+/**
+ * @brief Owner-only delete of many records: ACLs, sha->data references,
+ *        data_meta and listing rows go in one RW txn per DB_DELETE_TXN_MAX
+ *        items; the records are parked in the trash. Their content stays
+ *        stored until the background reaper (or db_data_reap) drops them
+ *        DB_TRASH_GRACE_S seconds later; until then db_data_undelete()
+ *        brings a record back.
+ * @param actor Acting user (must have 'O' on every item it deletes).
+ * @param n Number of ids.
+ * @param ids n * DB_ID_SIZE bytes.
+ * @param out_status Optional, n entries: 0, -EPERM if actor not owner,
+ *        -ENOENT if missing (or listed twice), -EIO.
+ * @return 0 on success (see out_status), -EINVAL bad args, or -errno when
+ *         a txn fails (items of earlier txns stay deleted; the rest get
+ *         that status).
+ */
+int db_data_delete_many(const uint8_t actor[DB_ID_SIZE], size_t n,
+                        const uint8_t* ids, int* out_status);
+
+/**
+ * @brief Restore a record deleted by db_data_delete_many() less than
+ *        DB_TRASH_GRACE_S seconds ago (default one day), the deadline the
+ *        reaper drops it at: meta, sha->data reference, listing and the
+ *        owner's ACL come back; shares granted before the delete do not.
+ * @param actor Acting user (must be the record's owner).
+ * @param data_id Trashed record.
+ * @return 0 on success, -EPERM if actor not owner, -ENOENT if not in the
+ *         trash or past the deadline, -EEXIST if the owner has stored the same content since,
+ *         -EIO otherwise.
+ */
+int db_data_undelete(const uint8_t actor[DB_ID_SIZE],
+                     const uint8_t data_id[DB_ID_SIZE]);
+
+/**
+ * @brief Drop trashed records older than DB_TRASH_GRACE_S and, with their
+ *        last reference, their content. Run by the background reaper
+ *        (DB_TRASH_REAP_INTERVAL_S) and after each db_data_delete_many().
+ * @param max Stop after this many records (0 = no limit).
+ * @param out_reaped Optional, records dropped.
+ * @return 0 on success, -EINVAL if the DB is not open, -errno from LMDB.
+ */
+int db_data_reap(size_t max, size_t* out_reaped);
+
 /**
  * @brief Ingest a blob from 'src_fd', computing SHA-256 while streaming it.
- *        Deduplicates by content; grants 'O' presence to the uploader.
+ *        Blobs are shared by content: every owner uploading the same bytes
+ *        gets an own record referencing one blob; grants 'O' presence to the
+ *        uploader. Regular-file sources of at most DB_INLINE_MAX bytes are
+ *        stored inline, in the same transaction as their meta; with
+ *        DB_CDC_AVG_KB, large ones are cut into content-defined chunks and
+ *        only chunks not stored yet are written.
  * @param owner Uploader ID.
  * @param src_fd Source file descriptor.
  * @param mime MIME type.
  * @param out_data_id Output data ID.
- * @return 0 on success, -EEXIST if content existed (id returned), -EPERM if not publisher,
- *         -ENOENT if owner not found, -EINVAL bad args, -EIO on error.
+ * @return 0 on success, -EEXIST if this owner already holds the content,
+ *         -EPERM if not publisher, -ENOENT if owner not found, -EINVAL bad
+ *         args, -EAGAIN if a concurrent delete removed the blob (retry),
+ *         -EIO on error.
  */
 int db_data_add_from_fd(uint8_t owner[DB_ID_SIZE], int src_fd, const char* mime,
                         uint8_t out_data_id[DB_ID_SIZE]);
 
+/**
+ * @brief Ingest an object the caller holds in memory, without an fd: it is
+ *        hashed straight from 'buf' and stored like db_data_add_from_fd
+ *        (inline, packed, chunked or written to a blob with pwritev; content
+ *        already stored is not written again).
+ * @param owner Uploader ID.
+ * @param buf Object bytes (may be NULL when len is 0).
+ * @param len Object size.
+ * @param mime MIME type.
+ * @param out_data_id Output data ID.
+ * @return As db_data_add_from_fd; -ENOMEM if a copy for an inline or
+ *         packed object cannot be allocated.
+ */
+int db_data_add_from_buf(uint8_t owner[DB_ID_SIZE], const void* buf,
+                         size_t len, const char* mime,
+                         uint8_t out_data_id[DB_ID_SIZE]);
+
+/**
+ * @brief db_data_add_from_buf for an object scattered over 'iovcnt'
+ *        segments (e.g. header and payload frames), stored as their
+ *        concatenation. Large objects go to the blob temp in one pwritev
+ *        per batch of segments; small ones are gathered for inline or pack
+ *        storage.
+ * @param owner Uploader ID.
+ * @param iov Segments, in order.
+ * @param iovcnt Segment count (0 stores an empty object).
+ * @param mime MIME type.
+ * @param out_data_id Output data ID.
+ * @return As db_data_add_from_buf.
+ */
+int db_data_add_from_iov(uint8_t owner[DB_ID_SIZE], const struct iovec* iov,
+                         int iovcnt, const char* mime,
+                         uint8_t out_data_id[DB_ID_SIZE]);
+
+/**
+ * @brief Open a resumable upload session: bytes are appended piecewise
+ *        (possibly across process restarts) and become a data item on
+ *        db_upload_commit(). Idle sessions are dropped by a background
+ *        reaper DB_UPLOAD_TTL_S seconds after their last append.
+ * @param owner Uploader ID (must be a publisher).
+ * @param mime MIME type of the item (shorter than 32 bytes).
+ * @param out_session Output session id.
+ * @return 0 on success, -EPERM if not a publisher, -ENOENT if no such user,
+ *         -EINVAL bad args, -EIO on error.
+ */
+int db_upload_begin(const uint8_t owner[DB_ID_SIZE], const char* mime,
+                    uint8_t out_session[DB_ID_SIZE]);
+
+/**
+ * @brief Append buf[0..len) at byte 'off' of the upload. The bytes are
+ *        durable and hashed when this returns. A retry may resend bytes
+ *        the session already holds: only the part past its offset is kept.
+ * @param owner Uploader ID (must have begun the session).
+ * @param session Session id.
+ * @param off Offset of buf in the object; at most the session's offset.
+ * @param buf Bytes to append (may be NULL when len is 0).
+ * @param len Byte count.
+ * @param out_offset Optional, bytes held by the session afterwards.
+ * @return 0 on success, -ERANGE if off is past the session's offset (the
+ *         bytes in between are missing), -EPERM if not the owner, -ENOENT
+ *         if no such session, -EBUSY if the session file is already linked
+ *         as an object (an interrupted commit: commit again), -EINVAL bad
+ *         args, -EIO on error.
+ */
+int db_upload_append(const uint8_t owner[DB_ID_SIZE],
+                     const uint8_t session[DB_ID_SIZE], uint64_t off,
+                     const void* buf, size_t len, uint64_t* out_offset);
+
+/**
+ * @brief Bytes held by an upload session: a client resuming after a
+ *        failure sends the tail from there.
+ * @param owner Uploader ID.
+ * @param session Session id.
+ * @param out_offset Output offset.
+ * @return 0 on success, -EPERM if not the owner, -ENOENT if no such
+ *         session, -EINVAL bad args, -EIO on error.
+ */
+int db_upload_status(const uint8_t owner[DB_ID_SIZE],
+                     const uint8_t session[DB_ID_SIZE], uint64_t* out_offset);
+
+/**
+ * @brief Finish an upload: the held bytes are stored and indexed like
+ *        db_data_add_from_fd() would (a plain blob is linked in without a
+ *        copy) and the session is closed.
+ * @param owner Uploader ID.
+ * @param session Session id.
+ * @param out_data_id Output data id.
+ * @return 0 on success, -EEXIST if the owner already stores this content,
+ *         -EPERM if not the owner, -ENOENT if no such session, -EINVAL bad
+ *         args, -EIO on error. The session stays open on failure.
+ */
+int db_upload_commit(const uint8_t owner[DB_ID_SIZE],
+                     const uint8_t session[DB_ID_SIZE],
+                     uint8_t out_data_id[DB_ID_SIZE]);
+
+/**
+ * @brief Drop an upload session and its bytes.
+ * @param owner Uploader ID.
+ * @param session Session id.
+ * @return 0 on success, -EPERM if not the owner, -ENOENT if no such
+ *         session, -EINVAL bad args, -EIO on error.
+ */
+int db_upload_abort(const uint8_t owner[DB_ID_SIZE],
+                    const uint8_t session[DB_ID_SIZE]);
+
+/**
+ * @brief Drop upload sessions idle for DB_UPLOAD_TTL_S seconds or more.
+ *        Run by the background reaper (DB_UPLOAD_REAP_INTERVAL_S).
+ * @param max Stop after this many sessions (0 = no limit).
+ * @param out_reaped Optional, sessions dropped.
+ * @return 0 on success, -EINVAL if the DB is not open, -errno from LMDB.
+ */
+int db_upload_reap(size_t max, size_t* out_reaped);
+
+/**
+ * @brief Ingest several blobs at once. Hashing, copying and fsync run in
+ *        parallel on up to DB_INGEST_THREADS workers (default: one per CPU);
+ *        all index updates then land in a single write transaction.
+ * @param owner Uploader ID (role checked once for the batch).
+ * @param n Number of items.
+ * @param fds Source file descriptors (n entries).
+ * @param mimes MIME types (n entries) or NULL.
+ * @param out_ids Output data IDs, n*DB_ID_SIZE bytes, or NULL.
+ * @param out_status Per-item result (n entries): 0 new, -EEXIST owner
+ *        already holds the content (id returned, also for duplicates within
+ *        the batch), -EAGAIN blob removed by a concurrent delete, -EIO.
+ * @return 0 when the batch committed, -EPERM if not publisher, -ENOENT if
+ *         owner not found, -EINVAL bad args, -ENOMEM, -EIO on error.
+ */
+int db_data_add_batch(uint8_t owner[DB_ID_SIZE], size_t n, const int fds[],
+                      const char* const mimes[], uint8_t* out_ids,
+                      int out_status[]);
+
 int db_data_get_meta(uint8_t data_id[DB_ID_SIZE], DataMeta* out_meta);
 int db_data_get_path(uint8_t data_id[DB_ID_SIZE], char* out_path,
                      unsigned long out_sz);
 
+/**
+ * @brief Resolve many data metas from one snapshot: ids are probed in key
+ *        order with one cursor, each hit is a single B-tree probe + memcpy.
+ * @param n Number of ids.
+ * @param ids_flat n*DB_ID_SIZE bytes of ids (repeats allowed).
+ * @param out_meta Output metas (n entries, in input order).
+ * @param out_status Per-item result (n entries): 0, -ENOENT or -EIO.
+ * @return 0 when the snapshot was read, -EINVAL bad args, -ENOMEM, -EIO.
+ */
+int db_data_get_metas(size_t n, const uint8_t* ids_flat, DataMeta* out_meta,
+                      int out_status[]);
+
+/**
+ * @brief Like db_data_get_metas() but writes blob paths.
+ * @param out_paths n slots of path_sz bytes each (PATH_MAX is always enough).
+ * @param path_sz Slot size.
+ * @param out_status Per-item result (n entries): 0, -ENOENT, -ENODATA
+ *        (inline, packed, compressed or chunked), -ENAMETOOLONG (slot too
+ *        small) or -EIO.
+ * @return 0 when the snapshot was read, -EINVAL bad args, -ENOMEM, -EIO.
+ */
+int db_data_get_paths(size_t n, const uint8_t* ids_flat, char* out_paths,
+                      size_t path_sz, int out_status[]);
+
+/**
+ * @brief Rewrite up to 'max' meta records still carrying an inline MIME
+ *        name (v0) as compact records with an interned MIME id (v1), in one
+ *        write txn. Readers decode both formats, so this can run in small
+ *        steps in the background.
+ * @param max Records to rewrite at most (0 = all).
+ * @param out_upgraded Records rewritten, or NULL.
+ * @return 0 on success, -ENOMEM if the map cannot grow, -EIO on error.
+ */
+int db_data_upgrade_metas(size_t max, size_t* out_upgraded);
+
+/**
+ * @brief One page of the data uploaded by 'owner', newest first, from the
+ *        owner|created_at|id index (cost is O(page), not O(uploads)).
+ * @param owner Uploader ID.
+ * @param page_token In: all zeros for the first page, else the token left
+ *        by the previous call. Out: resume point after this page.
+ * @param out_ids Output ids, *inout_count * DB_ID_SIZE bytes.
+ * @param inout_count In: page capacity. Out: ids returned; fewer than the
+ *        capacity means the listing is complete.
+ * @return 0 on success, -EINVAL bad args, -EIO on error.
+ */
+int db_data_list_by_owner(const uint8_t owner[DB_ID_SIZE],
+                          uint8_t       page_token[DB_PAGE_TOKEN_SIZE],
+                          uint8_t* out_ids, size_t* inout_count);
+
+/**
+ * @brief Visit the data created in [t0_ms, t1_ms), oldest first. Data IDs
+ *        are UUIDv7, so data_id2meta is already in time order: the scan
+ *        seeks to a synthetic id for t0_ms and stops at the first key at or
+ *        past t1_ms (no extra index, no full scan).
+ * @param t0_ms Range start, epoch milliseconds (inclusive).
+ * @param t1_ms Range end, epoch milliseconds (exclusive).
+ * @param cursor In: all zeros to start at t0_ms, else the id left by the
+ *        previous call (the scan resumes after it). Out: last id visited.
+ * @param limit Maximum number of items visited by this call (page size).
+ * @param cb Called per item; non-zero stops the scan after that item. It
+ *        runs inside the scan's read transaction and must not call back
+ *        into db_* (collect ids, act on them after the page).
+ * @param user Passed to cb.
+ * @param out_visited Optional: items visited; fewer than 'limit' with no
+ *        early stop means the range is exhausted.
+ * @return 0 on success, -EINVAL bad args, -EIO on error.
+ */
+int db_data_scan_time_range(uint64_t t0_ms, uint64_t t1_ms,
+                            uint8_t cursor[DB_ID_SIZE], size_t limit,
+                            db_data_scan_cb cb, void* user,
+                            size_t* out_visited);
+
+/**
+ * @brief Resolve a data id and open its blob read-only via the cached shard
+ *        directory handles (openat, no path walk). Inline and packed data
+ *        come back as a memfd holding a copy of the bytes, compressed and
+ *        chunked data as an unnamed temp file under objects/cache they were
+ *        inflated or reassembled into. Caller closes the fd.
+ * @param data_id Data ID.
+ * @param out_fd Output file descriptor.
+ * @return 0 on success, -ENOENT if meta or blob missing, -EINVAL bad args,
+ *         -EIO on error.
+ */
+int db_data_open(uint8_t data_id[DB_ID_SIZE], int* out_fd);
+
+/**
+ * @brief Copy up to 'len' bytes from offset 'off' of a data item into 'buf'.
+ *        Inline data is copied straight from the LMDB map in one read txn
+ *        (no file, no fd); packed data from its pack file; chunked data
+ *        from the chunks covering the range; other data from its blob,
+ *        compressed blobs being inflated up to off+len.
+ * @param data_id Data ID.
+ * @param off First byte to read.
+ * @param buf Output buffer ('len' bytes).
+ * @param len Bytes wanted.
+ * @param out_n Bytes copied (less than 'len' at the end of the data).
+ * @return 0 on success, -ENOENT if data or blob missing, -ERANGE if off is
+ *         past the end, -EINVAL bad args, -EIO on error.
+ */
+int db_data_read(const uint8_t data_id[DB_ID_SIZE], uint64_t off, void* buf,
+                 size_t len, size_t* out_n);
+
+/**
+ * @brief Feed [off, off+len) of a data item to 'sink' in order, in pieces of
+ *        at most 256 KiB. Chunked data is read chunk by chunk from its packs
+ *        and compressed data inflated on the fly, without being reassembled;
+ *        other data through db_data_open.
+ * @param data_id Data ID.
+ * @param off First byte.
+ * @param len Bytes; 0 or past the end means up to the end.
+ * @param sink Called per piece, with no transaction open.
+ * @param user Passed to sink.
+ * @return 0 on success, the sink's non-zero return, -ENOENT if data or its
+ *         bytes are missing, -ERANGE if off is past the end, -EINVAL bad
+ *         args, -ENOMEM, -EIO on error.
+ */
+int db_data_stream(const uint8_t data_id[DB_ID_SIZE], uint64_t off,
+                   uint64_t len, db_data_sink_cb sink, void* user);
+
+/**
+ * @brief SHA-256 of a data item. On SHA-256 stores this is DataMeta.sha; on
+ *        BLAKE3 stores (DB_DATA_F_BLAKE3) the bytes are read back and
+ *        hashed, for clients that still need the SHA-256.
+ * @param data_id Data ID.
+ * @param out 32-byte digest.
+ * @return 0 on success, -ENOENT if data or its bytes are missing, -EINVAL
+ *         bad args, -ENOMEM, -EIO on error.
+ */
+int db_data_sha256(const uint8_t data_id[DB_ID_SIZE], uint8_t out[32]);
+
+/**
+ * @brief Path of a file holding the bytes of a data item, for callers that
+ *        need one: the blob itself, or for inline, packed, compressed and
+ *        chunked data a copy written once under <root>/objects/cache/<sha>
+ *        and removed with the last reference.
+ * @param data_id Data ID.
+ * @param out_path Output path.
+ * @param out_sz Output buffer size.
+ * @return 0 on success, -ENOENT if data or its bytes are missing,
+ *         -ENAMETOOLONG, -EINVAL bad args, -EIO on error.
+ */
+int db_data_materialize(const uint8_t data_id[DB_ID_SIZE], char* out_path,
+                        unsigned long out_sz);
+
+/**
+ * @brief Compact pack files: every sealed pack whose dead bytes (deleted
+ *        objects, torn appends) reach 'min_dead_pct' percent of its size has
+ *        its live objects copied to the open pack and their index entries
+ *        repointed in one txn. Emptied packs are unlinked by the next pass,
+ *        once no reader can still hold an old location. Runs on its own
+ *        with DB_REPACK_INTERVAL_S.
+ * @param min_dead_pct Threshold, 0..100 (0 repacks every sealed pack).
+ * @param out_reclaimed Optional: dead bytes reclaimed by this pass.
+ * @return 0 on success, -EINVAL bad args, -ENOMEM, -EIO.
+ */
+int db_data_repack(unsigned min_dead_pct, uint64_t* out_reclaimed);
+
+/**
+ * @brief Remove orphaned blobs and stale temps from objects/sha256. The
+ *        leaf directories of the shard layout are walked on a worker pool;
+ *        each shard's sorted digests are merge-joined against the matching
+ *        key range of data_sha2ids in one read snapshot. A blob is an orphan when no
+ *        record references its digest, or when the content is stored inline,
+ *        packed or chunked instead. Every orphan is re-checked inside a
+ *        write txn right before the unlink, so an upload indexing the same
+ *        bytes either wins or retries with -EAGAIN. Files whose ctime falls
+ *        inside the grace period are kept (uploads in flight).
+ * @param opt Settings, or NULL for DB_GC_GRACE_S (default one hour), no
+ *        rate limit, DB_INGEST_THREADS walkers and removal enabled.
+ * @param out_report Optional: counters of this pass (also for a dry run).
+ * @return 0 on success (see out_report->errors for per-file failures),
+ *         -EINVAL if the DB is not open, -ENOMEM.
+ */
+int db_data_gc(const DbGcOptions* opt, DbGcReport* out_report);
+
+/**
+ * @brief Change the fan-out of objects/<digest> while the store stays in
+ *        use. The new layout is recorded in store_conf first; from then on
+ *        blobs are published there and lookups that miss fall back to the
+ *        old layout. The old leaf directories are walked on a worker pool
+ *        and each blob is hard-linked into the new layout before its old
+ *        name is dropped, so every blob stays reachable. When all moved,
+ *        the fallback ends and the old directories are removed. An
+ *        interrupted pass (crash, -EIO) resumes on the next call with the
+ *        same target; until then db_open keeps the fallback on.
+ *        A new store takes its layout from DB_SHARD_LAYOUT ("2x2" default).
+ * @param opt Target layout and worker count.
+ * @param out_report Optional: counters of this pass.
+ * @return 0 on success (also when already in that layout), -EINVAL bad
+ *         layout or DB not open, -EBUSY another relayout runs or an
+ *         interrupted one has a different target, -EIO some blobs could
+ *         not be moved (see out_report->errors; call again to resume).
+ */
+int db_data_relayout(const DbRelayoutOptions* opt,
+                     DbRelayoutReport* out_report);
+
+/**
+ * @brief Current shard layout of objects/<digest>.
+ * @param out_levels Output: directory levels.
+ * @param out_width Output: hex digits per level.
+ * @return 1 while a relayout is unfinished, 0 otherwise, -EINVAL if the DB
+ *         is not open or an output is NULL.
+ */
+int db_data_layout(unsigned* out_levels, unsigned* out_width);
+
+/**
+ * @brief Verify stored contents against their records: every digest in
+ *        data_sha2ids is re-read (blob file, inline bytes, pack extent,
+ *        chunks or zlib stream), re-hashed and its length checked against
+ *        DataMeta.size. Digests are taken in key order in batches shared
+ *        by 'threads' verifiers; progress is checkpointed in data_scrub
+ *        after every batch, so the next call (or the next db_open) resumes
+ *        where this one stopped and wraps around at the end. Blob files
+ *        that are not in the page cache are read with POSIX_FADV_NOREUSE
+ *        and dropped again as they are hashed, so a pass neither evicts hot
+ *        objects nor leaves cold ones behind.
+ * @param opt Settings, or NULL for one thread, no budgets, a whole pass.
+ * @param cb Fault callback, or NULL to only count faults.
+ * @param user Opaque pointer passed to cb.
+ * @param out_report Optional: counters of this call.
+ * @return 0 on success (also when cb stopped the run), -EINVAL if the DB
+ *         is not open, -ENOMEM, -EIO.
+ */
+int db_scrub_run(const DbScrubOptions* opt, db_scrub_cb cb, void* user,
+                 DbScrubReport* out_report);
+
+/**
+ * @brief Run db_scrub_run() continuously on a background thread: a pass,
+ *        then 'interval_s' seconds of rest, then the next pass. 'cb' is
+ *        called from that thread; a non-zero return ends the scrubber
+ *        (db_scrub_stop() still joins it). db_close() stops it.
+ * @return 0 on success, -EBUSY if already running, -EINVAL if the DB is
+ *         not open, -errno if the thread cannot be started.
+ */
+int db_scrub_start(const DbScrubOptions* opt, unsigned interval_s,
+                   db_scrub_cb cb, void* user);
+
+/**
+ * @brief Stop the background scrubber (no-op if not running); the current
+ *        batch finishes and is checkpointed.
+ */
+void db_scrub_stop(void);
+
+/**
+ * @brief Permission-checked open for serving a byte range. ACL presence
+ *        (owner, share or view) and the meta are resolved in one read txn,
+ *        then the blob is opened via the shard handles. The fd is positioned
+ *        at 'off' with read-ahead hinted for the range, ready for
+ *        sendfile()/splice(). For chunked and compressed data only the range
+ *        is reassembled, at its own offsets; bytes outside it read as
+ *        zeros.
+ * @param principal Requesting user.
+ * @param data_id Data ID.
+ * @param off First byte of the range.
+ * @param len Range length; 0 or past the end means up to the end.
+ * @param out_fd Output file descriptor (caller closes).
+ * @param out_meta Output meta, or NULL.
+ * @param out_len Bytes in the clipped range, or NULL.
+ * @return 0 on success, -ENOENT if data missing or not accessible by
+ *         principal, -ERANGE if off is past the end, -EINVAL bad args,
+ *         -EIO on error.
+ */
+int db_data_open_range_for(const uint8_t principal[DB_ID_SIZE],
+                           const uint8_t data_id[DB_ID_SIZE], uint64_t off,
+                           uint64_t len, int* out_fd, DataMeta* out_meta,
+                           uint64_t* out_len);
+
+/**
+ * @brief db_data_open_range_for() over the whole blob.
+ */
+int db_data_open_for(const uint8_t principal[DB_ID_SIZE],
+                     const uint8_t data_id[DB_ID_SIZE], int* out_fd,
+                     DataMeta* out_meta);
+
+/**
+ * @brief Permission-checked range copy straight to 'out_fd' (socket, pipe or
+ *        file) with sendfile(): the bytes never pass through user space.
+ * @param out_sent Bytes sent, or NULL (set also on a partial failure).
+ * @return 0 on success, the db_data_open_range_for() errors, or -errno from
+ *         sendfile (-EIO if the blob shrank).
+ */
+int db_data_send_for(const uint8_t principal[DB_ID_SIZE],
+                     const uint8_t data_id[DB_ID_SIZE], uint64_t off,
+                     uint64_t len, int out_fd, uint64_t* out_sent);
+
 /* ACL helpers and operations (reserved for future use) */
 /*
  * int db_revoke_data_from_user_email(uint8_t owner[DB_ID_SIZE], uint8_t data_id[DB_ID_SIZE], const char email[DB_EMAIL_MAX_LEN]);
@@ -206,6 +806,22 @@ int db_data_get_path(uint8_t data_id[DB_ID_SIZE], char* out_path,
 int db_env_metrics(uint64_t* used_bytes, uint64_t* mapsize_bytes,
                    uint32_t* page_size);
 
+/**
+ * @brief Ingest counters since db_open. With DB_DURABILITY=group, 'syncs'
+ *        counts the flusher's syncfs calls, each covering a whole group.
+ * @param out Output counters.
+ * @return 0 on success, -EINVAL if the DB is not open or out is NULL.
+ */
+int db_ingest_stats(DbIngestStats* out);
+
+/**
+ * @brief Hit-rate counters of the meta cache (DB_META_CACHE records,
+ *        default 65536; 0 turns it off and leaves every counter at 0).
+ * @param out Output counters.
+ * @return 0 on success, -EINVAL if the DB is not open or out is NULL.
+ */
+int db_meta_cache_stats(DbMetaCacheStats* out);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,54 @@
+/**
+ * @file db_meta_cache.h
+ * @brief Read-side cache of data_id -> DataMeta for db_data_get_meta and
+ *        db_data_get_path: bounded, split into independently locked shards.
+ *
+ * @author  Roman Horshkov <roman.horshkov@gmail.com>
+ * @date    2025
+ * (c) 2025
+ */
+
+#ifndef DB_META_CACHE_H
+#define DB_META_CACHE_H
+
+#include "db_int.h"
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/* One per open DB. Records are immutable until deleted, so an entry only
+   has to go when its record does: deleters drop ids after their commit. */
+typedef struct MetaCache MetaCache;
+
+/* Cache of about 'entries' records (rounded up to whole shards), or NULL
+   on allocation failure. */
+MetaCache* meta_cache_create(size_t entries);
+void       meta_cache_destroy(MetaCache* mc);
+
+/* Cached meta of 'id' into out: 0 on a hit, -ENOENT on a miss. A miss
+   sets *gen to the shard generation for meta_cache_put(); the txn reading
+   the record must begin after this call. */
+int meta_cache_get(MetaCache* mc, const uint8_t id[DB_ID_SIZE], DataMeta* out,
+                   uint64_t* gen);
+
+/* Remember 'meta' for 'id', read in a txn begun after the miss that
+   returned 'gen'. Skipped when an id of that shard was dropped since, as
+   the txn may predate the deletion. A full set evicts its coldest way. */
+void meta_cache_put(MetaCache* mc, const uint8_t id[DB_ID_SIZE],
+                    const DataMeta* meta, uint64_t gen);
+
+/* Forget 'id' (call after the txn removing it committed). */
+void meta_cache_drop(MetaCache* mc, const uint8_t id[DB_ID_SIZE]);
+
+/* Counters since creation, and the current / maximum entry counts. */
+void meta_cache_stats(MetaCache* mc, uint64_t* hits, uint64_t* misses,
+                      size_t* entries, size_t* capacity);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* DB_META_CACHE_H */
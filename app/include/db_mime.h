@@ -0,0 +1,41 @@
+/**
+ * @file db_mime.h
+ * @brief MIME dictionary: MIME strings interned as 2-byte ids for DataMeta.
+ *
+ * @author  Roman Horshkov <roman.horshkov@gmail.com>
+ * @date    2025
+ * (c) 2025
+ */
+
+#ifndef DB_MIME_H
+#define DB_MIME_H
+
+#include "db_int.h"
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/* In-memory id -> name map, one per open DB (ids differ between stores). */
+typedef struct MimeCache MimeCache;
+
+MimeCache* mime_cache_create(void);
+void       mime_cache_destroy(MimeCache* mc);
+
+/* Id of 'mime' (truncated to DataMeta.mime) inside a write txn; a new name
+   gets the next free id. 0, -ENOSPC when the dictionary is full,
+   MDB_MAP_FULL when the map must grow (caller retries the txn) or -EIO. */
+int mime_intern(MDB_txn* txn, const char* mime, uint16_t* out_id);
+
+/* Name of 'id' into out. Served from the cache; a miss reads the dictionary
+   through 'txn' and fills the cache, so 'id' must be committed (any id
+   found in a stored record is). 0, -ENOENT or -EIO. */
+int mime_lookup(MDB_txn* txn, uint16_t id, char out[32]);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* DB_MIME_H */
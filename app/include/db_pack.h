@@ -0,0 +1,83 @@
+/**
+ * @file db_pack.h
+ * @brief Pack-file blob backend: objects appended to large segment files
+ *        under objects/packs, located through an sha -> extent index.
+ *
+ * @author  Roman Horshkov <roman.horshkov@gmail.com>
+ * @date    2025
+ * (c) 2025
+ */
+
+#ifndef DB_PACK_H
+#define DB_PACK_H
+
+#include "db_int.h"
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/* Where one object lives: data_packs value, 20 bytes */
+typedef struct __attribute__((packed))
+{
+    uint32_t pack; /* segment id (pack-<id>.dat) */
+    uint64_t off;  /* first byte inside the segment */
+    uint64_t len;  /* object size */
+} PackLoc;
+
+/* Segment files of one store: the open append segment, plus the optional
+   background repacker. Safe to call from several threads. */
+typedef struct PackStore PackStore;
+
+/* Open objects/packs and resume appending to the newest segment; the
+   directory is created by the first append. Segments roll over at
+   'segment_max' bytes. NULL/errno. */
+PackStore* pack_store_open(const char* root, uint64_t segment_max);
+/* Stop the repacker (if started) and close every handle. */
+void       pack_store_close(PackStore* ps);
+
+/* Append 'len' bytes to the open segment (rolling it over when full; a
+   segment is made durable before it is closed). The bytes are not synced:
+   call pack_sync() before indexing them. 0 or -errno. */
+int pack_append(PackStore* ps, const void* buf, size_t len, PackLoc* out);
+
+/* Every pack_append() pins its segment against the repacker until the
+   caller has committed (or given up on) the index entry: release the pins
+   of locs[0..n) (entries with .pack == 0 hold none). */
+void pack_release(PackStore* ps, const PackLoc* locs, size_t n);
+
+/* Readers resolve locations in a snapshot and may read them after it ends.
+   Enter before the snapshot begins and exit after the last pack_read():
+   no segment retired meanwhile is unlinked in between. Returns the ticket
+   for pack_reader_exit(). */
+uint64_t pack_reader_enter(PackStore* ps);
+void     pack_reader_exit(PackStore* ps, uint64_t ticket);
+
+/* fdatasync the open segment if it was written since the last sync.
+   1 when a sync was issued, 0 when there was nothing to do, or -errno. */
+int pack_sync(PackStore* ps);
+
+/* Copy 'len' bytes at 'off' inside the object at 'loc'. 0, -ENOENT when
+   the segment is gone, -EIO on a short or failed read. */
+int pack_read(PackStore* ps, const PackLoc* loc, uint64_t off, void* buf,
+              size_t len);
+
+/* Index 'sha' at 'loc' (data_packs + pack_extents) inside a write txn,
+   replacing an older location. MDB rc. */
+int pack_index_put(MDB_txn* txn, const uint8_t sha[32], const PackLoc* loc);
+/* Location of 'sha'. MDB_SUCCESS, MDB_NOTFOUND or another MDB rc. */
+int pack_index_get(MDB_txn* txn, const uint8_t sha[32], PackLoc* out);
+/* Forget 'sha' (its bytes become dead space for the repacker). MDB rc. */
+int pack_index_del(MDB_txn* txn, const uint8_t sha[32]);
+
+/* Run db_data_repack(dead_pct) every 'interval_s' seconds on a background
+   thread until pack_store_close(). 0 or -errno. */
+int pack_repacker_start(PackStore* ps, unsigned interval_s, unsigned dead_pct);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* DB_PACK_H */
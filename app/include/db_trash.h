@@ -0,0 +1,52 @@
+/**
+ * @file db_trash.h
+ * @brief Trash of soft-deleted records: their content stays stored until
+ *        the reaper reclaims it after the grace period.
+ *
+ * @author  Roman Horshkov <roman.horshkov@gmail.com>
+ * @date    2025
+ * (c) 2025
+ */
+
+#ifndef DB_TRASH_H
+#define DB_TRASH_H
+
+#include "db_int.h"
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/* Park record 'id' (decoded 'm', id2meta value 'raw') in the trash,
+   stamped 'deleted_at' (epoch seconds). MDB rc. */
+int trash_put(MDB_txn* txn, const uint8_t id[DB_ID_SIZE], const DataMeta* m,
+              const MDB_val* raw, uint64_t deleted_at);
+
+/* Trashed record 'id': *raw is its id2meta value (valid until the next
+   write in 'txn'). MDB_SUCCESS, MDB_NOTFOUND or another MDB rc. */
+int trash_get(MDB_txn* txn, const uint8_t id[DB_ID_SIZE], MDB_val* raw,
+              uint64_t* deleted_at);
+
+/* Drop record 'id' of content 'sha' from the trash. MDB rc. */
+int trash_del(MDB_txn* txn, const uint8_t id[DB_ID_SIZE],
+              const uint8_t sha[32]);
+
+/* Meta of one trashed record of content 'sha': the content is still
+   stored where it says. MDB_SUCCESS, MDB_NOTFOUND or another MDB rc. */
+int trash_any_meta(MDB_txn* txn, const uint8_t sha[32], DataMeta* out);
+
+/* Background reaper: db_data_reap() every 'interval_s' seconds and
+   whenever trash_reaper_kick() is called. 0 or -errno. */
+int  trash_reaper_start(unsigned interval_s);
+/* Stop the reaper (if started); the pass in progress finishes. */
+void trash_reaper_stop(void);
+/* Wake the reaper for new trash (no-op if not started). */
+void trash_reaper_kick(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* DB_TRASH_H */
@@ -0,0 +1,49 @@
+/**
+ * @file db_upload.h
+ * @brief Resumable upload sessions: bytes appended to a file under
+ *        objects/uploads, offset and SHA-256 midstate kept in data_uploads.
+ *
+ * @author  Roman Horshkov <roman.horshkov@gmail.com>
+ * @date    2025
+ * (c) 2025
+ */
+
+#ifndef DB_UPLOAD_H
+#define DB_UPLOAD_H
+
+#include "db_int.h"
+#include "sha256.h"
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/* Background reaper: db_upload_reap() every 'interval_s' seconds. 0 or
+   -errno. */
+int  upload_reaper_start(unsigned interval_s);
+/* Stop the reaper (if started); the pass in progress finishes. */
+void upload_reaper_stop(void);
+
+/* db_data.c: index the finished upload 'session' in 'fd' (offset
+   anywhere) holding 'size' bytes of content 'digest' for 'owner'; the
+   session record is deleted in the indexing txn. A plain blob is the file
+   itself, linked into the shard tree; other placements are ingested from
+   it like db_data_add_from_fd(). 0, -EEXIST, -EAGAIN, -ENOENT (no such
+   session) or -errno. */
+int db_data_add_staged(uint8_t owner[DB_ID_SIZE], int fd, const Sha256* digest,
+                       size_t size, const char* mime,
+                       const uint8_t session[DB_ID_SIZE],
+                       uint8_t out_data_id[DB_ID_SIZE]);
+
+/* db_upload.c: remove session files under objects/uploads that have no
+   record (left by a crash in db_upload_begin or db_upload_commit) and put
+   back the ones a crash left aside mid-commit. Call at open. 0 or -errno. */
+int upload_sweep(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* DB_UPLOAD_H */
@@ -2,11 +2,174 @@
 #define FSUTIL_H
 #include <sys/stat.h>
 #include <stddef.h>
+#include <stdint.h>
+#include <time.h>
 
 int mkdir_p(const char* path, mode_t mode);
+/* "<root>/objects/sha256/xx/yy/<hex64>": the default layout (FsLayout) of
+   a SHA-256 store. */
 int path_sha256(char* out, size_t out_sz, const char* root,
                 const char* sha_hex64);
 int write_object_atomic_from_fd(const char* dst_path, int src_fd);
 int ensure_symlink(const char* link_path, const char* target);
 
+/* ---------------------- Content-addressed object dir ---------------------- */
+
+/* Shape of the shard tree: 'levels' directories of 'width' hex digits each,
+   cut from the front of the digest. 2x2 (xx/yy, 65536 leaves) is the
+   default; 1x2 suits small stores, 3x2 very large ones. */
+typedef struct
+{
+    unsigned levels; /* 1..3 */
+    unsigned width;  /* 1..3, levels * width <= FS_LAYOUT_MAX_DIGITS */
+} FsLayout;
+
+#define FS_LAYOUT_DEFAULT    ((FsLayout){2, 2})
+#define FS_LAYOUT_MAX_DIGITS 6
+
+/* 1 when 'l' is a supported shape, else 0. */
+int    fs_layout_valid(FsLayout l);
+/* Number of leaf directories (16^(levels * width)). */
+size_t fs_layout_shards(FsLayout l);
+/* "<levels>x<width>" (e.g. "2x2") into/from text. Parse: 0 or -1/EINVAL. */
+void   fs_layout_name(FsLayout l, char out[8]);
+int    fs_layout_parse(const char* s, FsLayout* out);
+
+/* Cached dirfds for <root>/objects/<ns> (ns names the digest: "sha256",
+   "blake3") and its shard tree. Leaf handles are opened lazily and kept for
+   the lifetime of the handle, within a budget derived from RLIMIT_NOFILE.
+   All functions are safe to call from several threads.
+   The layout can change while the directory is in use: after
+   fs_objdir_relayout_begin() objects are published in the new layout, and
+   lookups that miss there fall back to the old one until
+   fs_objdir_relayout_end(). fs_objdir_relink_shard() moves the objects. */
+typedef struct FsObjDir FsObjDir;
+
+/* Temp file that has not been published yet. name[0] == '\0' means the
+   file is anonymous (O_TMPFILE) and vanishes on close. */
+typedef struct
+{
+    int  fd;
+    char name[48];
+} FsTmp;
+
+/* 'precreate' makes every leaf up front (layouts of up to 65536 leaves). */
+FsObjDir* fs_objdir_open(const char* root, const char* ns, FsLayout layout,
+                         int precreate);
+void      fs_objdir_close(FsObjDir* od);
+
+/* Leaf directories of the current layout (shard indexes 0..n-1). */
+size_t fs_objdir_shards(FsObjDir* od);
+
+/* "<root>/objects/<ns>/<leaf>/<hex64>" of an object. While a re-layout
+   runs, an object not moved yet is linked into the new layout first, so
+   the path stays valid after the mover drops the old name. 0 or -1/errno
+   (ENAMETOOLONG when out_sz is too small). */
+int fs_objdir_object_path(FsObjDir* od, const char* hex64, char* out,
+                          size_t out_sz);
+
+/* Create a temp inside objects/<ns> (O_TMPFILE when supported). */
+int  fs_objdir_tmp_open(FsObjDir* od, FsTmp* tmp);
+/* Close (and unlink if named) a temp that will not be published. */
+void fs_objdir_tmp_discard(FsObjDir* od, FsTmp* tmp);
+/* Link the temp as <leaf>/<hex64> via linkat; an existing object is a dedup
+   hit and also returns 0. The temp is always closed/removed afterwards. */
+int  fs_objdir_publish(FsObjDir* od, FsTmp* tmp, const char* hex64);
+
+/* openat() an object through the cached shard handle. */
+int fs_objdir_open_object(FsObjDir* od, const char* hex64, int flags);
+/* fstatat() an object through the cached shard handle. */
+int fs_objdir_stat_object(FsObjDir* od, const char* hex64, struct stat* st);
+/* unlinkat() an object through the cached shard handle. */
+int fs_objdir_unlink_object(FsObjDir* od, const char* hex64);
+/* Move an object aside under a temp name so it can be put back with
+   fs_objdir_restore_object() or dropped with fs_objdir_tmp_discard().
+   out->fd is -1. 0 or -1/errno (ENOENT when there is no such object). */
+int fs_objdir_retire_object(FsObjDir* od, const char* hex64, FsTmp* out);
+/* Undo fs_objdir_retire_object(). 0 or -1/errno. */
+int fs_objdir_restore_object(FsObjDir* od, FsTmp* tmp, const char* hex64);
+
+/* Stale temp files found by a GC walk (named ingest temps, retired
+   objects, legacy '<hex64>.tmp.<pid>' copies) */
+typedef struct
+{
+    uint64_t found;   /* temps not changed after the cut-off */
+    uint64_t bytes;   /* their size */
+    uint64_t removed; /* unlinked (0 in a dry run) */
+    uint64_t young;   /* temps changed after the cut-off, kept */
+} FsTempSweep;
+
+/* Digests of the objects in shard 'idx' (0..fs_objdir_shards()-1), sorted
+   ascending; *out (32 bytes each) is malloc'ed, NULL when empty. Stale
+   temps of the shard (ctime <= 'before') are counted into 'tmp' and
+   unlinked unless 'dry_run'. An absent shard is empty. 0 or -1/errno. */
+int fs_objdir_scan_shard(FsObjDir* od, unsigned idx, time_t before,
+                         int dry_run, uint8_t** out, size_t* n,
+                         FsTempSweep* tmp);
+/* Same temp sweep over objects/<ns> itself ('.ingest.*' names). */
+int fs_objdir_sweep_temps(FsObjDir* od, time_t before, int dry_run,
+                          FsTempSweep* tmp);
+
+/* Switch to layout 'to': waits for running object calls, then publishes in
+   'to' and falls back to the current layout for lookups. 0 or -1/errno
+   (EINVAL bad layout, EBUSY already switching). */
+int fs_objdir_relayout_begin(FsObjDir* od, FsLayout to);
+/* Current layout into *cur; 1 (and the old layout into *from) while a
+   re-layout runs, else 0. Either pointer may be NULL. */
+int fs_objdir_layout(FsObjDir* od, FsLayout* cur, FsLayout* from);
+
+/* Objects moved by fs_objdir_relink_shard() */
+typedef struct
+{
+    uint64_t moved;  /* linked into the new layout, old name dropped */
+    uint64_t merged; /* already in the new layout; old name dropped */
+    uint64_t errors; /* names that could not be linked (left in place) */
+} FsRelink;
+
+/* Move the objects of shard 'idx' of the old layout to the new one: link
+   the new name, then unlink the old, so every object stays reachable. The
+   emptied leaf is removed. Runs next to ordinary object calls. 0, or
+   -1/errno when the shard cannot be read (EINVAL: no re-layout running). */
+int fs_objdir_relink_shard(FsObjDir* od, size_t idx, FsRelink* st);
+/* Number of leaves of the old layout (0 when no re-layout runs). */
+size_t fs_objdir_relink_shards(FsObjDir* od);
+/* Finish a re-layout: lookups stop falling back and the emptied directories
+   of the old layout are removed (best effort). */
+void fs_objdir_relayout_end(FsObjDir* od);
+
+/* sendfile() 'len' bytes of in_fd starting at 'off' to out_fd; retries short
+   writes, EINTR and EAGAIN (polls a non-blocking out_fd). *sent counts what
+   went out. 0 or -1/errno (EIO when in_fd ends early). */
+int fs_sendfile_range(int out_fd, int in_fd, off_t off, size_t len,
+                      size_t* sent);
+
+/* Anonymous in-memory file (memfd) holding a copy of buf[0..len), offset 0,
+   so fd-based readers can serve bytes that have no file. fd or -1/errno. */
+int fs_memfd_from_buf(const char* name, const void* buf, size_t len);
+
+/* Pages of [0, size) of 'fd' resident in the page cache (mincore on a
+   transient mapping). Count or -1/errno. */
+long fs_cached_pages(int fd, uint64_t size);
+
+/* Unnamed read-write file on the filesystem of 'dir' (O_TMPFILE, else a
+   temp name unlinked right away) for bytes too large to keep in memory.
+   fd or -1/errno. */
+int fs_tmpfile_in(const char* dir);
+
+/* ------------------------- Group-commit flusher --------------------------- */
+
+/* Coalesces durability requests for one filesystem. Writers skip their own
+   fsync and call fs_flusher_sync(); a background thread runs one syncfs()
+   covering every request that arrived before it started. Requests arriving
+   while a sync runs form the next group. 'window_us' optionally delays each
+   group to let it grow (0 = sync as soon as the flusher is idle). */
+typedef struct FsFlusher FsFlusher;
+
+FsFlusher* fs_flusher_open(const char* path, unsigned window_us);
+void       fs_flusher_close(FsFlusher* fl);
+/* Block until everything written before the call is durable. 0 or -1/errno. */
+int        fs_flusher_sync(FsFlusher* fl);
+/* Number of syncfs() calls issued so far. */
+uint64_t   fs_flusher_count(FsFlusher* fl);
+
 #endif
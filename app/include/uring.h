@@ -0,0 +1,108 @@
+/**
+ * @file uring.h
+ * @brief Thin io_uring wrapper over the raw syscalls (no liburing needed).
+ *
+ * @author  Roman Horshkov <roman.horshkov@gmail.com>
+ * @date    2025
+ * (c) 2025
+ */
+
+#ifndef URING_H
+#define URING_H
+
+#include <stddef.h>
+#include <sys/uio.h>
+#include <linux/io_uring.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/****************************************************************************
+ * PUBLIC STRUCTURED VARIABLES
+ ****************************************************************************
+*/
+
+/* One submission/completion ring pair. Not thread-safe: one owner thread. */
+typedef struct
+{
+    int ring_fd;
+
+    /* submission queue (shared with the kernel) */
+    unsigned            *sq_head;
+    unsigned            *sq_tail;
+    unsigned            *sq_mask;
+    unsigned            *sq_array;
+    unsigned             sq_entries;
+    unsigned             sq_local_tail; /* prepared, not yet published */
+    struct io_uring_sqe *sqes;
+
+    /* completion queue (shared with the kernel) */
+    unsigned            *cq_head;
+    unsigned            *cq_tail;
+    unsigned            *cq_mask;
+    struct io_uring_cqe *cqes;
+
+    /* mappings, for teardown */
+    void  *sq_ring;
+    size_t sq_ring_sz;
+    void  *cq_ring;
+    size_t cq_ring_sz;
+    size_t sqes_sz;
+} Uring;
+
+/****************************************************************************
+ * PUBLIC FUNCTIONS DECLARATIONS
+ ****************************************************************************
+*/
+
+/**
+ * @brief Create a ring with at least 'entries' SQ slots.
+ * @return 0 on success, -errno on failure (-ENOSYS/-EPERM when io_uring is
+ *         not available to this process).
+ */
+int uring_init(Uring* r, unsigned entries);
+
+/**
+ * @brief Close the ring; the kernel cancels whatever is still in flight.
+ */
+void uring_exit(Uring* r);
+
+/**
+ * @brief Pin 'n' buffers for IORING_OP_{READ,WRITE}_FIXED (buf_index = i).
+ * @return 0 on success, -errno on failure.
+ */
+int uring_register_buffers(Uring* r, const struct iovec* iov, unsigned n);
+
+/**
+ * @brief Next free SQE, zeroed. NULL when the SQ is full (submit first).
+ */
+struct io_uring_sqe* uring_get_sqe(Uring* r);
+
+/**
+ * @brief Free SQ slots left before uring_get_sqe() returns NULL.
+ */
+unsigned uring_sq_space(Uring* r);
+
+/**
+ * @brief Publish prepared SQEs and wait for at least 'wait_nr' completions.
+ * @return Number of SQEs consumed, or -errno.
+ */
+int uring_submit_and_wait(Uring* r, unsigned wait_nr);
+
+/**
+ * @brief Oldest unconsumed CQE, or NULL if the CQ is empty.
+ */
+struct io_uring_cqe* uring_peek_cqe(Uring* r);
+
+/**
+ * @brief Release the CQE returned by the last uring_peek_cqe().
+ */
+void uring_cqe_seen(Uring* r);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* URING_H */
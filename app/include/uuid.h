@@ -55,6 +55,17 @@ int uuid_v7(uint8_t val[UUID_BYTES_SIZE]);
  */
 void uuid_to_hex(uint8_t id[UUID_BYTES_SIZE], char out33[33]);
 
+/**
+ * @brief Millisecond timestamp carried by the first 48 bits of a v7 UUID.
+ */
+uint64_t uuid_v7_ms(const uint8_t id[UUID_BYTES_SIZE]);
+
+/**
+ * @brief Smallest v7 UUID with timestamp 'ms' (all bits after it zero):
+ *        a seek key for everything generated at or after 'ms'.
+ */
+void uuid_v7_floor(uint64_t ms, uint8_t out[UUID_BYTES_SIZE]);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,63 @@
+/**
+ * @file workpool.h
+ * @brief Minimal fork/join worker pool for data-parallel loops.
+ *
+ * @author  Roman Horshkov <roman.horshkov@gmail.com>
+ * @date    2025
+ * (c) 2025
+ */
+
+#ifndef WORKPOOL_H
+#define WORKPOOL_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/****************************************************************************
+ * PUBLIC DEFINES
+ ****************************************************************************
+ */
+
+#define WP_MAX_THREADS 64
+
+/****************************************************************************
+ * PUBLIC STRUCTURED VARIABLES
+ ****************************************************************************
+*/
+
+/* Work item callback: process index 'i' of the loop. */
+typedef void (*wp_item_fn)(size_t i, void* user);
+
+/****************************************************************************
+ * PUBLIC FUNCTIONS DECLARATIONS
+ ****************************************************************************
+*/
+
+/**
+ * @brief Number of online CPUs (at least 1).
+ */
+unsigned wp_ncpu(void);
+
+/**
+ * @brief Run fn(i) for i in [0, n) on up to 'nthreads' threads; the caller
+ *        thread participates. Items are handed out dynamically, so uneven
+ *        item costs balance out. Returns after every item completed.
+ * @param n Item count.
+ * @param nthreads Thread budget (0 = wp_ncpu()); capped at n and
+ *        WP_MAX_THREADS.
+ * @param fn Per-item callback (must be thread-safe).
+ * @param user Opaque pointer passed to fn.
+ * @return 0 on success, -EINVAL bad args. If threads cannot be spawned the
+ *         remaining work runs on the caller thread.
+ */
+int wp_parallel_for(size_t n, unsigned nthreads, wp_item_fn fn, void* user);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* WORKPOOL_H */
@@ -0,0 +1,584 @@
+/**
+ * @file codec.c
+ * @brief Optional zlib codec for stored blobs (stubs without DB_HAVE_ZLIB).
+ *
+ * @author  Roman Horshkov <roman.horshkov@gmail.com>
+ * @date    2025
+ * (c) 2025
+ */
+
+#include "codec.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef DB_HAVE_ZLIB
+#    include <zlib.h>
+#endif
+
+/****************************************************************************
+ * PRIVATE DEFINES
+ ****************************************************************************
+ */
+
+#ifndef CODEC_BUFSZ
+#    define CODEC_BUFSZ (1 << 16)
+#endif
+
+/* Raw bytes between seek points (a Z_FULL_FLUSH each) */
+#ifndef CODEC_SEEK_SPAN
+#    define CODEC_SEEK_SPAN (1u << 20)
+#endif
+
+/* Footer after the zlib stream: {raw, comp} u64 pairs, u64 count, u64 magic
+   (all little-endian). inflate() stops at the stream end and never sees it */
+#define CODEC_FOOT_MAGIC 0x314b45455a534244ull /* "DBZSEEK1" */
+#define CODEC_FOOT_TAIL 16u
+#define CODEC_FOOT_PAIR 16u
+
+/****************************************************************************
+ * PRIVATE STUCTURED VARIABLES
+ ****************************************************************************
+ */
+
+#ifdef DB_HAVE_ZLIB
+struct CodecZ
+{
+    z_stream  zs;
+    int       out_fd;
+    uint64_t  written;
+    uint64_t  raw;  /* uncompressed bytes fed */
+    uint64_t* pts;  /* seek points, {raw, comp} pairs */
+    size_t    npts; /* pairs */
+    size_t    cap;  /* pairs allocated */
+    uint8_t   out[CODEC_BUFSZ];
+};
+
+struct CodecRd
+{
+    z_stream zs;
+    int      in_fd;
+    off_t    roff; /* next compressed byte to read */
+    int      end;  /* Z_STREAM_END seen */
+    uint8_t  in[CODEC_BUFSZ];
+};
+#endif
+
+/****************************************************************************
+ * PRIVATE VARIABLES
+ ****************************************************************************
+ */
+/* None */
+
+/****************************************************************************
+ * PRIVATE FUNCTIONS PROTOTYPES
+ ****************************************************************************
+ */
+
+#ifdef DB_HAVE_ZLIB
+/* Run deflate() with 'flush' until it has consumed its input (and, for
+   Z_FINISH, ended the stream), writing every full output buffer. */
+static int deflate_pump(CodecZ* z, int flush);
+
+/* Z_FULL_FLUSH and record a seek point at the current position. */
+static int deflate_mark(CodecZ* z);
+
+/* Append the seek point footer. */
+static int deflate_footer(CodecZ* z);
+
+/* Footer of 'in_fd': *out_count pairs starting at *out_at. 1 if there is
+   one, 0 if not (a plain stream), -EIO on a read error. */
+static int foot_find(int in_fd, uint64_t* out_count, off_t* out_at);
+
+/* Last seek point at or before raw offset 'off' from the footer at 'at'. */
+static int foot_seek(int in_fd, off_t at, uint64_t count, uint64_t off,
+                     uint64_t* out_raw, uint64_t* out_comp);
+
+/* Inflate up to 'cap' bytes into 'dst'; *out_n == 0 only at the end. */
+static int inflate_step(CodecRd* r, uint8_t* dst, size_t cap, size_t* out_n);
+
+static int write_all(int fd, const uint8_t* p, size_t n);
+static int pread_all(int fd, uint8_t* p, size_t n, off_t off);
+static uint64_t le64_get(const uint8_t* p);
+static void     le64_put(uint8_t* p, uint64_t v);
+#endif
+
+/****************************************************************************
+ * PUBLIC FUNCTIONS DEFINITIONS
+ ****************************************************************************
+ */
+
+int codec_zlib_available(void)
+{
+#ifdef DB_HAVE_ZLIB
+    return 1;
+#else
+    return 0;
+#endif
+}
+
+int codec_deflate_probe(const void* in, size_t n, int level, size_t* out_len)
+{
+#ifdef DB_HAVE_ZLIB
+    if((!in && n) || !out_len)
+        return -EINVAL;
+    uLongf   cap = compressBound((uLong)n);
+    uint8_t* tmp = malloc(cap);
+    if(!tmp)
+        return -ENOMEM;
+    int zrc = compress2(tmp, &cap, (const Bytef*)in, (uLong)n, level);
+    free(tmp);
+    if(zrc != Z_OK)
+        return -EIO;
+    *out_len = (size_t)cap;
+    return 0;
+#else
+    (void)in;
+    (void)n;
+    (void)level;
+    (void)out_len;
+    return -ENOTSUP;
+#endif
+}
+
+CodecZ* codec_deflate_open(int level, int out_fd)
+{
+#ifdef DB_HAVE_ZLIB
+    CodecZ* z = calloc(1, sizeof *z);
+    if(!z)
+        return NULL;
+    if(deflateInit(&z->zs, level) != Z_OK)
+    {
+        free(z);
+        errno = EINVAL;
+        return NULL;
+    }
+    z->out_fd = out_fd;
+    return z;
+#else
+    (void)level;
+    (void)out_fd;
+    errno = ENOTSUP;
+    return NULL;
+#endif
+}
+
+int codec_deflate_write(CodecZ* z, const void* in, size_t n)
+{
+#ifdef DB_HAVE_ZLIB
+    if(!z || (!in && n))
+        return -EINVAL;
+    const uint8_t* p = (const uint8_t*)in;
+    while(n > 0)
+    {
+        /* up to the next seek point; avail_in is a uInt besides */
+        uint64_t left = CODEC_SEEK_SPAN - z->raw % CODEC_SEEK_SPAN;
+        uInt     step = n < left ? (uInt)n : (uInt)left;
+        z->zs.next_in  = (Bytef*)(uintptr_t)p;
+        z->zs.avail_in = step;
+        int rc         = deflate_pump(z, Z_NO_FLUSH);
+        if(rc != 0)
+            return rc;
+        p += step;
+        n -= step;
+        z->raw += step;
+        if(z->raw % CODEC_SEEK_SPAN == 0 && (rc = deflate_mark(z)) != 0)
+            return rc;
+    }
+    return 0;
+#else
+    (void)z;
+    (void)in;
+    (void)n;
+    return -ENOTSUP;
+#endif
+}
+
+int codec_deflate_finish(CodecZ* z, uint64_t* out_written)
+{
+#ifdef DB_HAVE_ZLIB
+    if(!z)
+        return -EINVAL;
+    z->zs.next_in  = NULL;
+    z->zs.avail_in = 0;
+    int rc         = deflate_pump(z, Z_FINISH);
+    if(rc == 0)
+        rc = deflate_footer(z);
+    if(rc == 0 && out_written)
+        *out_written = z->written;
+    return rc;
+#else
+    (void)z;
+    (void)out_written;
+    return -ENOTSUP;
+#endif
+}
+
+void codec_deflate_close(CodecZ* z)
+{
+#ifdef DB_HAVE_ZLIB
+    if(!z)
+        return;
+    deflateEnd(&z->zs);
+    free(z->pts);
+    free(z);
+#else
+    (void)z;
+#endif
+}
+
+int codec_stream_probe(int in_fd)
+{
+    if(in_fd < 0)
+        return -EINVAL;
+#ifdef DB_HAVE_ZLIB
+    uint64_t count = 0;
+    off_t    at    = 0;
+    return foot_find(in_fd, &count, &at);
+#else
+    return 0;
+#endif
+}
+
+CodecRd* codec_inflate_open(int in_fd, uint64_t off)
+{
+#ifdef DB_HAVE_ZLIB
+    if(in_fd < 0)
+    {
+        errno = EINVAL;
+        return NULL;
+    }
+    uint64_t count = 0, raw = 0, comp = 0;
+    off_t    at    = 0;
+    int      frc   = foot_find(in_fd, &count, &at);
+    if(frc > 0 && count > 0)
+        frc = foot_seek(in_fd, at, count, off, &raw, &comp);
+    if(frc < 0)
+    {
+        errno = EIO;
+        return NULL;
+    }
+
+    CodecRd* r = calloc(1, sizeof *r);
+    if(!r)
+        return NULL;
+    r->in_fd = in_fd;
+    r->roff  = (off_t)comp;
+    /* a seek point is byte-aligned with an empty window: raw deflate from
+       there; from the top, the zlib header comes first */
+    int zrc = comp ? inflateInit2(&r->zs, -MAX_WBITS) : inflateInit(&r->zs);
+    if(zrc != Z_OK)
+    {
+        free(r);
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    /* decompress and drop up to 'off' */
+    uint8_t* skip = raw < off ? malloc(CODEC_BUFSZ) : NULL;
+    int      rc   = raw < off && !skip ? -ENOMEM : 0;
+    while(rc == 0 && raw < off)
+    {
+        size_t want = off - raw < CODEC_BUFSZ ? (size_t)(off - raw)
+                                              : CODEC_BUFSZ;
+        size_t got  = 0;
+        rc          = inflate_step(r, skip, want, &got);
+        if(rc == 0 && got == 0)
+            break; /* past the end: reads return nothing */
+        raw += got;
+    }
+    free(skip);
+    if(rc != 0)
+    {
+        codec_inflate_close(r);
+        errno = -rc;
+        return NULL;
+    }
+    return r;
+#else
+    (void)in_fd;
+    (void)off;
+    errno = ENOTSUP;
+    return NULL;
+#endif
+}
+
+int codec_inflate_read(CodecRd* r, void* buf, size_t len, size_t* out_n)
+{
+    if(!r || (!buf && len) || !out_n)
+        return -EINVAL;
+    *out_n = 0;
+#ifdef DB_HAVE_ZLIB
+    size_t got = 0;
+    while(got < len)
+    {
+        size_t n  = 0;
+        int    rc = inflate_step(r, (uint8_t*)buf + got, len - got, &n);
+        if(rc != 0)
+            return rc;
+        if(n == 0)
+            break;
+        got += n;
+    }
+    *out_n = got;
+    return 0;
+#else
+    return -ENOTSUP;
+#endif
+}
+
+void codec_inflate_close(CodecRd* r)
+{
+#ifdef DB_HAVE_ZLIB
+    if(!r)
+        return;
+    inflateEnd(&r->zs);
+    free(r);
+#else
+    (void)r;
+#endif
+}
+
+int codec_inflate_range(int in_fd, uint64_t off, void* buf, size_t len,
+                        size_t* out_n)
+{
+    if(in_fd < 0 || (!buf && len) || !out_n)
+        return -EINVAL;
+    *out_n = 0;
+#ifdef DB_HAVE_ZLIB
+    CodecRd* r = codec_inflate_open(in_fd, off);
+    if(!r)
+        return -errno;
+    int rc = codec_inflate_read(r, buf, len, out_n);
+    codec_inflate_close(r);
+    return rc;
+#else
+    (void)off;
+    return -ENOTSUP;
+#endif
+}
+
+int codec_inflate_to_fd(int in_fd, int out_fd, uint64_t* out_n)
+{
+    if(in_fd < 0 || out_fd < 0)
+        return -EINVAL;
+#ifdef DB_HAVE_ZLIB
+    CodecRd* r = codec_inflate_open(in_fd, 0);
+    if(!r)
+        return -errno;
+    uint8_t* out = malloc(CODEC_BUFSZ);
+    int      rc  = out ? 0 : -ENOMEM;
+    uint64_t n   = 0;
+    size_t   got = 0;
+    while(rc == 0 &&
+          (rc = codec_inflate_read(r, out, CODEC_BUFSZ, &got)) == 0 && got)
+    {
+        if(write_all(out_fd, out, got) != 0)
+            rc = -EIO;
+        n += got;
+    }
+    free(out);
+    codec_inflate_close(r);
+    if(rc == 0 && out_n)
+        *out_n = n;
+    return rc;
+#else
+    (void)out_n;
+    return -ENOTSUP;
+#endif
+}
+
+/****************************************************************************
+ * PRIVATE FUNCTIONS DEFINITIONS
+ ****************************************************************************
+ */
+
+#ifdef DB_HAVE_ZLIB
+static int deflate_pump(CodecZ* z, int flush)
+{
+    for(;;)
+    {
+        z->zs.next_out  = z->out;
+        z->zs.avail_out = sizeof z->out;
+        int zrc         = deflate(&z->zs, flush);
+        if(zrc == Z_STREAM_ERROR)
+            return -EIO;
+        size_t have = sizeof z->out - z->zs.avail_out;
+        if(have && write_all(z->out_fd, z->out, have) != 0)
+            return -errno;
+        z->written += have;
+        if(flush == Z_FINISH ? zrc == Z_STREAM_END
+                             : z->zs.avail_in == 0 && z->zs.avail_out != 0)
+            return 0;
+    }
+}
+
+static int deflate_mark(CodecZ* z)
+{
+    int rc = deflate_pump(z, Z_FULL_FLUSH);
+    if(rc != 0)
+        return rc;
+    if(z->npts == z->cap)
+    {
+        size_t    cap = z->cap ? z->cap * 2 : 16;
+        uint64_t* pts = realloc(z->pts, cap * 2 * sizeof *pts);
+        if(!pts)
+            return -ENOMEM;
+        z->pts = pts;
+        z->cap = cap;
+    }
+    z->pts[z->npts * 2]     = z->raw;
+    z->pts[z->npts * 2 + 1] = z->written;
+    z->npts++;
+    return 0;
+}
+
+static int deflate_footer(CodecZ* z)
+{
+    size_t   n    = z->npts * CODEC_FOOT_PAIR + CODEC_FOOT_TAIL;
+    uint8_t* foot = malloc(n);
+    if(!foot)
+        return -ENOMEM;
+    for(size_t i = 0; i < z->npts * 2; ++i)
+        le64_put(foot + i * 8, z->pts[i]);
+    le64_put(foot + n - 16, (uint64_t)z->npts);
+    le64_put(foot + n - 8, CODEC_FOOT_MAGIC);
+    int rc = write_all(z->out_fd, foot, n) == 0 ? 0 : -errno;
+    free(foot);
+    if(rc == 0)
+        z->written += n;
+    return rc;
+}
+
+static int foot_find(int in_fd, uint64_t* out_count, off_t* out_at)
+{
+    struct stat st;
+    if(fstat(in_fd, &st) != 0)
+        return -EIO;
+    if(st.st_size < (off_t)CODEC_FOOT_TAIL)
+        return 0;
+    uint8_t tail[CODEC_FOOT_TAIL];
+    if(pread_all(in_fd, tail, sizeof tail, st.st_size - (off_t)sizeof tail))
+        return -EIO;
+    uint64_t count = le64_get(tail);
+    uint64_t room  = (uint64_t)st.st_size - CODEC_FOOT_TAIL;
+    if(le64_get(tail + 8) != CODEC_FOOT_MAGIC ||
+       count > room / CODEC_FOOT_PAIR)
+        return 0;
+    *out_count = count;
+    *out_at    = (off_t)(room - count * CODEC_FOOT_PAIR);
+    return 1;
+}
+
+static int foot_seek(int in_fd, off_t at, uint64_t count, uint64_t off,
+                     uint64_t* out_raw, uint64_t* out_comp)
+{
+    /* binary search over the pairs, sorted by construction */
+    uint64_t lo = 0, hi = count;
+    *out_raw  = 0;
+    *out_comp = 0;
+    while(lo < hi)
+    {
+        uint64_t mid = lo + (hi - lo) / 2;
+        uint8_t  pair[CODEC_FOOT_PAIR];
+        if(pread_all(in_fd, pair, sizeof pair,
+                     at + (off_t)(mid * CODEC_FOOT_PAIR)) != 0)
+            return -EIO;
+        uint64_t raw = le64_get(pair);
+        if(raw > off)
+            hi = mid;
+        else
+        {
+            *out_raw  = raw;
+            *out_comp = le64_get(pair + 8);
+            lo        = mid + 1;
+        }
+    }
+    return *out_comp < (uint64_t)at ? 0 : -EIO;
+}
+
+static int inflate_step(CodecRd* r, uint8_t* dst, size_t cap, size_t* out_n)
+{
+    *out_n = 0;
+    if(cap > (1u << 30))
+        cap = 1u << 30;
+    while(!r->end)
+    {
+        if(r->zs.avail_in == 0)
+        {
+            ssize_t rd = pread(r->in_fd, r->in, CODEC_BUFSZ, r->roff);
+            if(rd < 0 && errno == EINTR)
+                continue;
+            if(rd <= 0)
+                return -EIO; /* truncated stream */
+            r->roff += rd;
+            r->zs.next_in  = r->in;
+            r->zs.avail_in = (uInt)rd;
+        }
+        r->zs.next_out  = dst;
+        r->zs.avail_out = (uInt)cap;
+        int zrc         = inflate(&r->zs, Z_NO_FLUSH);
+        if(zrc == Z_STREAM_END)
+            r->end = 1;
+        else if(zrc != Z_OK && zrc != Z_BUF_ERROR)
+            return zrc == Z_MEM_ERROR ? -ENOMEM : -EIO;
+        *out_n = cap - r->zs.avail_out;
+        if(*out_n)
+            return 0;
+    }
+    return 0;
+}
+
+static int write_all(int fd, const uint8_t* p, size_t n)
+{
+    size_t off = 0;
+    while(off < n)
+    {
+        ssize_t wr = write(fd, p + off, n - off);
+        if(wr > 0)
+            off += (size_t)wr;
+        else if(wr < 0 && errno == EINTR)
+            continue;
+        else
+        {
+            if(wr == 0)
+                errno = EIO;
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static int pread_all(int fd, uint8_t* p, size_t n, off_t off)
+{
+    size_t got = 0;
+    while(got < n)
+    {
+        ssize_t rd = pread(fd, p + got, n - got, off + (off_t)got);
+        if(rd > 0)
+            got += (size_t)rd;
+        else if(rd < 0 && errno == EINTR)
+            continue;
+        else
+            return -1;
+    }
+    return 0;
+}
+
+static uint64_t le64_get(const uint8_t* p)
+{
+    uint64_t v = 0;
+    for(int i = 7; i >= 0; --i)
+        v = v << 8 | p[i];
+    return v;
+}
+
+static void le64_put(uint8_t* p, uint64_t v)
+{
+    for(int i = 0; i < 8; ++i)
+        p[i] = (uint8_t)(v >> (8 * i));
+}
+#endif
@@ -0,0 +1,754 @@
+/**
+ * @file blake3.c
+ * @brief BLAKE3: portable compression, AVX2 / AVX-512 kernels that run one
+ *        chunk (or parent node) per lane, and the tree built on top of them.
+ *
+ * The tree is left-complete: any aligned run of 2^k chunks that is not the
+ * whole input is a subtree, so such runs can be hashed independently (on
+ * lanes, or on threads) and merged on a stack of chaining values.
+ *
+ * @author  Roman Horshkov <roman.horshkov@gmail.com>
+ * @date    2025
+ * (c) 2025
+ */
+
+#include "cryptography/blake3.h"
+#include "cryptography/sha256_simd.h" /* sha256_simd_features(): CPU probe */
+#include "workpool.h"
+
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#    define B3_X86 1
+#    include <immintrin.h>
+#endif
+
+/****************************************************************************
+ * PRIVATE DEFINES
+ ****************************************************************************
+ */
+
+#define B3_BLOCK 64
+#define B3_CHUNK 1024
+
+#define B3_CHUNK_START 0x01
+#define B3_CHUNK_END   0x02
+#define B3_PARENT      0x04
+#define B3_ROOT        0x08
+
+/* Deepest stack of subtree chaining values (2^54 chunks) */
+#define B3_STACK 54
+
+/* Subtree handed to one task of crypt_blake3() (power of two chunks) */
+#ifndef CRYPT_BLAKE3_PIECE
+#    define CRYPT_BLAKE3_PIECE (1u << 20)
+#endif
+/* Smallest share of the input worth another thread */
+#ifndef CRYPT_BLAKE3_MT_MIN
+#    define CRYPT_BLAKE3_MT_MIN (4u << 20)
+#endif
+/* Bytes an incremental hasher gathers before hashing them on the lanes
+   (power of two chunks) */
+#ifndef CRYPT_BLAKE3_BUF
+#    define CRYPT_BLAKE3_BUF (16u * B3_CHUNK)
+#endif
+
+#define B3_PIECE_CHUNKS (CRYPT_BLAKE3_PIECE / B3_CHUNK)
+
+/****************************************************************************
+ * PRIVATE STUCTURED VARIABLES
+ ****************************************************************************
+ */
+
+/* A node not compressed yet: compressed once for its chaining value, or
+   with B3_ROOT for the digest. */
+typedef struct
+{
+    uint32_t cv[8];
+    uint8_t  block[B3_BLOCK];
+    uint64_t ctr;
+    uint8_t  len;
+    uint8_t  flags;
+} B3Out;
+
+/* Stack of chaining values of complete subtrees, left to right */
+typedef struct
+{
+    uint8_t  cv[B3_STACK][32];
+    unsigned depth;
+} B3Stack;
+
+struct CryptBlake3
+{
+    B3Stack  st;
+    uint64_t groups; /* CRYPT_BLAKE3_BUF subtrees pushed so far */
+    size_t   have;   /* bytes in buf, not hashed yet */
+    uint8_t  buf[CRYPT_BLAKE3_BUF];
+};
+
+/* crypt_blake3() task: CVs of the full pieces */
+typedef struct
+{
+    const uint8_t* p;
+    uint8_t (*cv)[32];
+} B3Pieces;
+
+/****************************************************************************
+ * PRIVATE VARIABLES
+ ****************************************************************************
+ */
+
+static const uint32_t B3_IV[8] = {0x6a09e667, 0xbb67ae85, 0x3c6ef372,
+                                  0xa54ff53a, 0x510e527f, 0x9b05688c,
+                                  0x1f83d9ab, 0x5be0cd19};
+
+/* Message word order of each of the 7 rounds */
+static const uint8_t B3_SCHED[7][16] = {
+    {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15},
+    {2, 6, 3, 10, 7, 0, 4, 13, 1, 11, 12, 5, 9, 14, 15, 8},
+    {3, 4, 10, 12, 13, 2, 7, 14, 6, 5, 9, 0, 11, 15, 8, 1},
+    {10, 7, 12, 9, 14, 3, 13, 15, 4, 0, 11, 2, 5, 8, 1, 6},
+    {12, 13, 9, 11, 15, 10, 14, 8, 7, 2, 5, 3, 0, 1, 6, 4},
+    {9, 14, 11, 5, 8, 12, 15, 1, 13, 3, 0, 10, 2, 6, 4, 7},
+    {11, 15, 5, 0, 1, 9, 8, 6, 14, 10, 2, 12, 3, 4, 7, 13}};
+
+/* Enabled CRYPT_BLAKE3_IMPL_* kernels, -1 until first use */
+static _Atomic int g_b3_impl = -1;
+
+/****************************************************************************
+ * PRIVATE FUNCTIONS PROTOTYPES
+ ****************************************************************************
+ */
+
+static unsigned b3_impl(void);
+
+static inline uint32_t b3_load32(const uint8_t* p);
+static inline void     b3_store32(uint8_t* p, uint32_t v);
+
+/* The compression function: out[0..7] is the next chaining value, out[8..15]
+   the extended output. */
+static void b3_compress(const uint32_t cv[8], const uint8_t block[B3_BLOCK],
+                        uint8_t len, uint64_t ctr, uint8_t flags,
+                        uint32_t out[16]);
+
+/* out[i] = chaining value of 'nblk' blocks at in[i] (full blocks), counter
+   ctr0 (+ i when 'inc'), 'flags' on every block, 'fstart' / 'fend' on the
+   first / last. 16 or 8 inputs per kernel call, the rest one by one. */
+static void b3_hash_many(const uint8_t* const* in, size_t n, size_t nblk,
+                         uint64_t ctr0, int inc, uint8_t flags, uint8_t fstart,
+                         uint8_t fend, uint8_t (*out)[32]);
+
+/* Output node of the chunk p[0..n) (n <= B3_CHUNK) with counter 'ctr'. */
+static void b3_chunk_out(const uint8_t* p, size_t n, uint64_t ctr, B3Out* o);
+/* Output node of the parent of two chaining values. */
+static void b3_parent_out(const uint8_t l[32], const uint8_t r[32], B3Out* o);
+static void b3_out_cv(const B3Out* o, uint8_t cv[32]);
+static void b3_out_root(const B3Out* o, uint8_t out[32]);
+
+/* Output node of the subtree over p[0..n) (at most CRYPT_BLAKE3_PIECE
+   bytes) whose first chunk has counter 'ctr0'. */
+static void b3_subtree_out(const uint8_t* p, size_t n, uint64_t ctr0,
+                           B3Out* o);
+
+/* Push the chaining value of subtree number 'idx' (0-based, all of one
+   power-of-two size) and merge the subtrees it completes. */
+static void b3_push(B3Stack* st, const uint8_t cv[32], uint64_t idx);
+/* Digest of the stack followed by the output node 'o' (the right edge). */
+static void b3_finish(const B3Stack* st, B3Out o, uint8_t out[32]);
+
+/* wp_item_fn: chaining value of piece i */
+static void b3_piece_one(size_t i, void* user);
+
+#ifdef B3_X86
+static void b3_x16_avx512(const uint8_t* const in[16], size_t nblk,
+                          const uint32_t ctr_lo[16], const uint32_t ctr_hi[16],
+                          uint8_t flags, uint8_t fstart, uint8_t fend,
+                          uint8_t (*out)[32]);
+static void b3_x8_avx2(const uint8_t* const in[8], size_t nblk,
+                       const uint32_t ctr_lo[8], const uint32_t ctr_hi[8],
+                       uint8_t flags, uint8_t fstart, uint8_t fend,
+                       uint8_t (*out)[32]);
+#endif
+
+/****************************************************************************
+ * PUBLIC FUNCTIONS DEFINITIONS
+ ****************************************************************************
+ */
+
+unsigned crypt_blake3_set_impl(unsigned mask)
+{
+    unsigned v = mask & sha256_simd_features() &
+                 (CRYPT_BLAKE3_IMPL_AVX2 | CRYPT_BLAKE3_IMPL_AVX512);
+    atomic_store(&g_b3_impl, (int)v);
+    return v;
+}
+
+void crypt_blake3(const void* p, size_t n, unsigned threads,
+                  uint8_t out[CRYPT_BLAKE3_OUT_LEN])
+{
+    const uint8_t* in = p;
+    B3Out          o;
+    if(n <= CRYPT_BLAKE3_PIECE)
+    {
+        b3_subtree_out(in, n, 0, &o);
+        b3_out_root(&o, out);
+        return;
+    }
+
+    /* every piece but the last is a complete subtree: hash those on the
+       pool, the last one (the right edge) here */
+    size_t np = (n + CRYPT_BLAKE3_PIECE - 1) / CRYPT_BLAKE3_PIECE;
+    if(threads == 0)
+        threads = wp_ncpu();
+    if((size_t)threads > n / CRYPT_BLAKE3_MT_MIN)
+        threads = (unsigned)(n / CRYPT_BLAKE3_MT_MIN);
+
+    B3Stack  st  = {.depth = 0};
+    B3Pieces job = {.p = in, .cv = NULL};
+    if(threads > 1)
+        job.cv = malloc((np - 1) * sizeof *job.cv);
+    if(job.cv)
+    {
+        wp_parallel_for(np - 1, threads, b3_piece_one, &job);
+        for(size_t i = 0; i + 1 < np; ++i)
+            b3_push(&st, job.cv[i], i);
+        free(job.cv);
+    }
+    else
+    {
+        for(size_t i = 0; i + 1 < np; ++i)
+        {
+            uint8_t cv[32];
+            b3_subtree_out(in + i * CRYPT_BLAKE3_PIECE, CRYPT_BLAKE3_PIECE,
+                           (uint64_t)i * B3_PIECE_CHUNKS, &o);
+            b3_out_cv(&o, cv);
+            b3_push(&st, cv, i);
+        }
+    }
+    size_t last = (np - 1) * CRYPT_BLAKE3_PIECE;
+    b3_subtree_out(in + last, n - last, (uint64_t)(np - 1) * B3_PIECE_CHUNKS,
+                   &o);
+    b3_finish(&st, o, out);
+}
+
+CryptBlake3* crypt_blake3_begin(void)
+{
+    CryptBlake3* h = malloc(sizeof *h);
+    if(!h)
+        return NULL;
+    h->st.depth = 0;
+    h->groups   = 0;
+    h->have     = 0;
+    return h;
+}
+
+void crypt_blake3_update(CryptBlake3* h, const void* p, size_t n)
+{
+    const uint8_t* in = p;
+    while(n)
+    {
+        /* a full buffer with more input behind it is not the right edge */
+        const uint8_t* grp = NULL;
+        if(h->have == CRYPT_BLAKE3_BUF)
+            grp = h->buf;
+        else if(h->have == 0 && n > CRYPT_BLAKE3_BUF)
+            grp = in; /* straight from the caller's memory */
+        if(grp)
+        {
+            B3Out   o;
+            uint8_t cv[32];
+            b3_subtree_out(grp, CRYPT_BLAKE3_BUF,
+                           h->groups * (CRYPT_BLAKE3_BUF / B3_CHUNK), &o);
+            b3_out_cv(&o, cv);
+            b3_push(&h->st, cv, h->groups++);
+            if(grp == in)
+            {
+                in += CRYPT_BLAKE3_BUF;
+                n -= CRYPT_BLAKE3_BUF;
+            }
+            else
+                h->have = 0;
+            continue;
+        }
+        size_t take = CRYPT_BLAKE3_BUF - h->have;
+        if(take > n)
+            take = n;
+        memcpy(h->buf + h->have, in, take);
+        h->have += take;
+        in += take;
+        n -= take;
+    }
+}
+
+void crypt_blake3_end(CryptBlake3* h, uint8_t out[CRYPT_BLAKE3_OUT_LEN])
+{
+    if(!h)
+        return;
+    if(out)
+    {
+        B3Out o;
+        b3_subtree_out(h->buf, h->have,
+                       h->groups * (CRYPT_BLAKE3_BUF / B3_CHUNK), &o);
+        b3_finish(&h->st, o, out);
+    }
+    free(h);
+}
+
+/****************************************************************************
+ * PRIVATE FUNCTIONS DEFINITIONS
+ ****************************************************************************
+ */
+
+static unsigned b3_impl(void)
+{
+    int v = atomic_load_explicit(&g_b3_impl, memory_order_relaxed);
+    if(v < 0)
+    {
+        int unset = -1;
+        (void)atomic_compare_exchange_strong(
+            &g_b3_impl, &unset,
+            (int)(sha256_simd_features() &
+                  (CRYPT_BLAKE3_IMPL_AVX2 | CRYPT_BLAKE3_IMPL_AVX512)));
+        v = atomic_load(&g_b3_impl);
+    }
+    return (unsigned)v;
+}
+
+static inline uint32_t b3_load32(const uint8_t* p)
+{
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 |
+           (uint32_t)p[3] << 24;
+}
+
+static inline void b3_store32(uint8_t* p, uint32_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+static void b3_compress(const uint32_t cv[8], const uint8_t block[B3_BLOCK],
+                        uint8_t len, uint64_t ctr, uint8_t flags,
+                        uint32_t out[16])
+{
+#define ROR(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+#define G(a, b, c, d, x, y)              \
+    do                                   \
+    {                                    \
+        v[a] = v[a] + v[b] + m[x];       \
+        v[d] = ROR(v[d] ^ v[a], 16);     \
+        v[c] = v[c] + v[d];              \
+        v[b] = ROR(v[b] ^ v[c], 12);     \
+        v[a] = v[a] + v[b] + m[y];       \
+        v[d] = ROR(v[d] ^ v[a], 8);      \
+        v[c] = v[c] + v[d];              \
+        v[b] = ROR(v[b] ^ v[c], 7);      \
+    } while(0)
+    uint32_t m[16], v[16];
+    for(int i = 0; i < 16; ++i)
+        m[i] = b3_load32(block + 4 * i);
+    memcpy(v, cv, 8 * sizeof *v);
+    memcpy(v + 8, B3_IV, 4 * sizeof *v);
+    v[12] = (uint32_t)ctr;
+    v[13] = (uint32_t)(ctr >> 32);
+    v[14] = len;
+    v[15] = flags;
+    for(int r = 0; r < 7; ++r)
+    {
+        const uint8_t* s = B3_SCHED[r];
+        G(0, 4, 8, 12, s[0], s[1]);
+        G(1, 5, 9, 13, s[2], s[3]);
+        G(2, 6, 10, 14, s[4], s[5]);
+        G(3, 7, 11, 15, s[6], s[7]);
+        G(0, 5, 10, 15, s[8], s[9]);
+        G(1, 6, 11, 12, s[10], s[11]);
+        G(2, 7, 8, 13, s[12], s[13]);
+        G(3, 4, 9, 14, s[14], s[15]);
+    }
+    for(int i = 0; i < 8; ++i)
+    {
+        out[i]     = v[i] ^ v[i + 8];
+        out[i + 8] = v[i + 8] ^ cv[i];
+    }
+#undef G
+#undef ROR
+}
+
+static void b3_hash_many(const uint8_t* const* in, size_t n, size_t nblk,
+                         uint64_t ctr0, int inc, uint8_t flags, uint8_t fstart,
+                         uint8_t fend, uint8_t (*out)[32])
+{
+    size_t i = 0;
+#ifdef B3_X86
+    unsigned impl = b3_impl();
+    uint32_t lo[16], hi[16];
+    for(; (impl & CRYPT_BLAKE3_IMPL_AVX512) && i + 16 <= n; i += 16)
+    {
+        for(unsigned l = 0; l < 16; ++l)
+        {
+            uint64_t c = ctr0 + (inc ? i + l : 0);
+            lo[l]      = (uint32_t)c;
+            hi[l]      = (uint32_t)(c >> 32);
+        }
+        b3_x16_avx512(in + i, nblk, lo, hi, flags, fstart, fend, out + i);
+    }
+    for(; (impl & CRYPT_BLAKE3_IMPL_AVX2) && i + 8 <= n; i += 8)
+    {
+        for(unsigned l = 0; l < 8; ++l)
+        {
+            uint64_t c = ctr0 + (inc ? i + l : 0);
+            lo[l]      = (uint32_t)c;
+            hi[l]      = (uint32_t)(c >> 32);
+        }
+        b3_x8_avx2(in + i, nblk, lo, hi, flags, fstart, fend, out + i);
+    }
+#endif
+    for(; i < n; ++i)
+    {
+        uint32_t cv[16];
+        memcpy(cv, B3_IV, sizeof B3_IV);
+        for(size_t b = 0; b < nblk; ++b)
+        {
+            uint8_t f = (uint8_t)(flags | (b == 0 ? fstart : 0) |
+                                  (b + 1 == nblk ? fend : 0));
+            b3_compress(cv, in[i] + b * B3_BLOCK, B3_BLOCK,
+                        ctr0 + (inc ? i : 0), f, cv);
+        }
+        for(int w = 0; w < 8; ++w)
+            b3_store32(out[i] + 4 * w, cv[w]);
+    }
+}
+
+static void b3_chunk_out(const uint8_t* p, size_t n, uint64_t ctr, B3Out* o)
+{
+    size_t   nblk = n ? (n + B3_BLOCK - 1) / B3_BLOCK : 1;
+    uint32_t cv[16];
+    memcpy(cv, B3_IV, sizeof B3_IV);
+    for(size_t b = 0; b + 1 < nblk; ++b)
+        b3_compress(cv, p + b * B3_BLOCK, B3_BLOCK, ctr,
+                    b == 0 ? B3_CHUNK_START : 0, cv);
+    size_t tail = n - (nblk - 1) * B3_BLOCK;
+    memcpy(o->cv, cv, sizeof o->cv);
+    memset(o->block, 0, sizeof o->block);
+    if(tail)
+        memcpy(o->block, p + (nblk - 1) * B3_BLOCK, tail);
+    o->len   = (uint8_t)tail;
+    o->ctr   = ctr;
+    o->flags = (uint8_t)((nblk == 1 ? B3_CHUNK_START : 0) | B3_CHUNK_END);
+}
+
+static void b3_parent_out(const uint8_t l[32], const uint8_t r[32], B3Out* o)
+{
+    memcpy(o->cv, B3_IV, sizeof o->cv);
+    memcpy(o->block, l, 32);
+    memcpy(o->block + 32, r, 32);
+    o->len   = B3_BLOCK;
+    o->ctr   = 0;
+    o->flags = B3_PARENT;
+}
+
+static void b3_out_cv(const B3Out* o, uint8_t cv[32])
+{
+    uint32_t w[16];
+    b3_compress(o->cv, o->block, o->len, o->ctr, o->flags, w);
+    for(int i = 0; i < 8; ++i)
+        b3_store32(cv + 4 * i, w[i]);
+}
+
+static void b3_out_root(const B3Out* o, uint8_t out[32])
+{
+    uint32_t w[16];
+    b3_compress(o->cv, o->block, o->len, 0, (uint8_t)(o->flags | B3_ROOT), w);
+    for(int i = 0; i < 8; ++i)
+        b3_store32(out + 4 * i, w[i]);
+}
+
+static void b3_subtree_out(const uint8_t* p, size_t n, uint64_t ctr0,
+                           B3Out* o)
+{
+    size_t nch = n ? (n + B3_CHUNK - 1) / B3_CHUNK : 1;
+    if(nch == 1)
+    {
+        b3_chunk_out(p, n, ctr0, o);
+        return;
+    }
+
+    /* chunk CVs: the full ones on the lanes, the last one (maybe short)
+       alone */
+    static _Thread_local uint8_t cv[2][B3_PIECE_CHUNKS][32];
+    const uint8_t*               in[B3_PIECE_CHUNKS];
+    for(size_t i = 0; i + 1 < nch; ++i)
+        in[i] = p + i * B3_CHUNK;
+    b3_hash_many(in, nch - 1, B3_CHUNK / B3_BLOCK, ctr0, 1, 0, B3_CHUNK_START,
+                 B3_CHUNK_END, cv[0]);
+    b3_chunk_out(p + (nch - 1) * B3_CHUNK, n - (nch - 1) * B3_CHUNK,
+                 ctr0 + nch - 1, o);
+    b3_out_cv(o, cv[0][nch - 1]);
+
+    /* parents level by level: adjacent pairs are one 64-byte block; an odd
+       last node moves up as is (left-complete tree) */
+    size_t m   = nch;
+    int    cur = 0;
+    while(m > 2)
+    {
+        size_t pairs = m / 2;
+        for(size_t j = 0; j < pairs; ++j)
+            in[j] = cv[cur][2 * j];
+        b3_hash_many(in, pairs, 1, 0, 0, B3_PARENT, 0, 0, cv[cur ^ 1]);
+        if(m & 1)
+            memcpy(cv[cur ^ 1][pairs], cv[cur][m - 1], 32);
+        m   = pairs + (m & 1);
+        cur ^= 1;
+    }
+    b3_parent_out(cv[cur][0], cv[cur][1], o);
+}
+
+static void b3_push(B3Stack* st, const uint8_t cv[32], uint64_t idx)
+{
+    uint8_t cur[32];
+    memcpy(cur, cv, 32);
+    /* each trailing one of idx closes a subtree twice the size */
+    for(uint64_t t = idx + 1; !(t & 1) && st->depth; t >>= 1)
+    {
+        B3Out o;
+        b3_parent_out(st->cv[--st->depth], cur, &o);
+        b3_out_cv(&o, cur);
+    }
+    memcpy(st->cv[st->depth++], cur, 32);
+}
+
+static void b3_finish(const B3Stack* st, B3Out o, uint8_t out[32])
+{
+    for(unsigned d = st->depth; d > 0; --d)
+    {
+        uint8_t cv[32];
+        b3_out_cv(&o, cv);
+        b3_parent_out(st->cv[d - 1], cv, &o);
+    }
+    b3_out_root(&o, out);
+}
+
+static void b3_piece_one(size_t i, void* user)
+{
+    B3Pieces* job = user;
+    B3Out     o;
+    b3_subtree_out(job->p + i * CRYPT_BLAKE3_PIECE, CRYPT_BLAKE3_PIECE,
+                   (uint64_t)i * B3_PIECE_CHUNKS, &o);
+    b3_out_cv(&o, job->cv[i]);
+}
+
+#ifdef B3_X86
+
+/* The 7 rounds on vectors of lanes: v[] / m[] hold one state / message word
+   per vector, B3_ADD .. B3_R7 are defined by each kernel. */
+#    define B3_ROUNDS()                                                      \
+        do                                                                   \
+        {                                                                    \
+            _Pragma("GCC unroll 7") for(int r = 0; r < 7; ++r)               \
+            {                                                                \
+                const uint8_t* s = B3_SCHED[r];                              \
+                B3_GV(0, 4, 8, 12, s[0], s[1]);                              \
+                B3_GV(1, 5, 9, 13, s[2], s[3]);                              \
+                B3_GV(2, 6, 10, 14, s[4], s[5]);                             \
+                B3_GV(3, 7, 11, 15, s[6], s[7]);                             \
+                B3_GV(0, 5, 10, 15, s[8], s[9]);                             \
+                B3_GV(1, 6, 11, 12, s[10], s[11]);                           \
+                B3_GV(2, 7, 8, 13, s[12], s[13]);                            \
+                B3_GV(3, 4, 9, 14, s[14], s[15]);                            \
+            }                                                                \
+        } while(0)
+#    define B3_GV(a, b, c, d, x, y)              \
+        do                                       \
+        {                                        \
+            v[a] = B3_ADD(B3_ADD(v[a], v[b]), m[x]);   \
+            v[d] = B3_R16(B3_XOR(v[d], v[a]));         \
+            v[c] = B3_ADD(v[c], v[d]);              \
+            v[b] = B3_R12(B3_XOR(v[b], v[c]));         \
+            v[a] = B3_ADD(B3_ADD(v[a], v[b]), m[y]);   \
+            v[d] = B3_R8(B3_XOR(v[d], v[a]));          \
+            v[c] = B3_ADD(v[c], v[d]);              \
+            v[b] = B3_R7(B3_XOR(v[b], v[c]));          \
+        } while(0)
+
+/* m[w] = word w of the block at in[l] + off, lane l: one 64-byte load per
+   lane, then a 16x16 transpose (unpack 32 / 64, then 128-bit lanes). The
+   lanes read 16 separate streams: prefetch a few blocks ahead in each. */
+__attribute__((target("avx512f"))) static inline void
+b3_msg_x16(const uint8_t* const in[16], size_t off, __m512i m[16])
+{
+    __m512i r[16], t[16];
+    for(int l = 0; l < 16; ++l)
+    {
+        r[l] = _mm512_loadu_si512((const void*)(in[l] + off));
+        _mm_prefetch((const char*)(in[l] + off) + 4 * B3_BLOCK, _MM_HINT_T0);
+    }
+    for(int i = 0; i < 16; i += 2)
+    {
+        t[i]     = _mm512_unpacklo_epi32(r[i], r[i + 1]);
+        t[i + 1] = _mm512_unpackhi_epi32(r[i], r[i + 1]);
+    }
+    /* r[4g + c]: column 4k + c of rows 4g..4g+3 in 128-bit lane k */
+    for(int g = 0; g < 4; ++g)
+    {
+        r[4 * g + 0] = _mm512_unpacklo_epi64(t[4 * g], t[4 * g + 2]);
+        r[4 * g + 1] = _mm512_unpackhi_epi64(t[4 * g], t[4 * g + 2]);
+        r[4 * g + 2] = _mm512_unpacklo_epi64(t[4 * g + 1], t[4 * g + 3]);
+        r[4 * g + 3] = _mm512_unpackhi_epi64(t[4 * g + 1], t[4 * g + 3]);
+    }
+    for(int c = 0; c < 4; ++c)
+    {
+        __m512i p = _mm512_shuffle_i32x4(r[c], r[4 + c], 0x44);
+        __m512i q = _mm512_shuffle_i32x4(r[8 + c], r[12 + c], 0x44);
+        __m512i x = _mm512_shuffle_i32x4(r[c], r[4 + c], 0xEE);
+        __m512i y = _mm512_shuffle_i32x4(r[8 + c], r[12 + c], 0xEE);
+        m[c]      = _mm512_shuffle_i32x4(p, q, 0x88);
+        m[4 + c]  = _mm512_shuffle_i32x4(p, q, 0xDD);
+        m[8 + c]  = _mm512_shuffle_i32x4(x, y, 0x88);
+        m[12 + c] = _mm512_shuffle_i32x4(x, y, 0xDD);
+    }
+}
+
+#    define B3_ADD(a, b) _mm512_add_epi32(a, b)
+#    define B3_XOR(a, b) _mm512_xor_si512(a, b)
+#    define B3_R16(x)    _mm512_ror_epi32(x, 16)
+#    define B3_R12(x)    _mm512_ror_epi32(x, 12)
+#    define B3_R8(x)     _mm512_ror_epi32(x, 8)
+#    define B3_R7(x)     _mm512_ror_epi32(x, 7)
+
+__attribute__((target("avx512f"))) static void
+b3_x16_avx512(const uint8_t* const in[16], size_t nblk,
+              const uint32_t ctr_lo[16], const uint32_t ctr_hi[16],
+              uint8_t flags, uint8_t fstart, uint8_t fend, uint8_t (*out)[32])
+{
+    __m512i h[8];
+    for(int i = 0; i < 8; ++i)
+        h[i] = _mm512_set1_epi32((int)B3_IV[i]);
+    const __m512i lo = _mm512_loadu_si512((const void*)ctr_lo);
+    const __m512i hi = _mm512_loadu_si512((const void*)ctr_hi);
+
+    for(size_t b = 0; b < nblk; ++b)
+    {
+        __m512i m[16], v[16];
+        b3_msg_x16(in, b * B3_BLOCK, m);
+        uint8_t f = (uint8_t)(flags | (b == 0 ? fstart : 0) |
+                              (b + 1 == nblk ? fend : 0));
+        for(int i = 0; i < 8; ++i)
+            v[i] = h[i];
+        for(int i = 0; i < 4; ++i)
+            v[8 + i] = _mm512_set1_epi32((int)B3_IV[i]);
+        v[12] = lo;
+        v[13] = hi;
+        v[14] = _mm512_set1_epi32(B3_BLOCK);
+        v[15] = _mm512_set1_epi32(f);
+        B3_ROUNDS();
+        for(int i = 0; i < 8; ++i)
+            h[i] = _mm512_xor_si512(v[i], v[i + 8]);
+    }
+
+    uint32_t t[8][16];
+    for(int i = 0; i < 8; ++i)
+        _mm512_storeu_si512((void*)t[i], h[i]);
+    for(int l = 0; l < 16; ++l)
+        for(int i = 0; i < 8; ++i)
+            b3_store32(out[l] + 4 * i, t[i][l]);
+}
+
+#    undef B3_ADD
+#    undef B3_XOR
+#    undef B3_R16
+#    undef B3_R12
+#    undef B3_R8
+#    undef B3_R7
+/* AVX2 counterpart of b3_msg_x16: two 8x8 transposes (words 0-7, 8-15). */
+__attribute__((target("avx2"))) static inline void
+b3_msg_x8(const uint8_t* const in[8], size_t off, __m256i m[16])
+{
+    for(int h = 0; h < 2; ++h)
+    {
+        __m256i r[8], t[8];
+        for(int l = 0; l < 8; ++l)
+            r[l] = _mm256_loadu_si256(
+                (const __m256i*)(in[l] + off + 32 * (size_t)h));
+        if(h == 0)
+            for(int l = 0; l < 8; ++l)
+                _mm_prefetch((const char*)(in[l] + off) + 4 * B3_BLOCK,
+                             _MM_HINT_T0);
+        for(int i = 0; i < 8; i += 2)
+        {
+            t[i]     = _mm256_unpacklo_epi32(r[i], r[i + 1]);
+            t[i + 1] = _mm256_unpackhi_epi32(r[i], r[i + 1]);
+        }
+        for(int g = 0; g < 2; ++g)
+        {
+            r[4 * g + 0] = _mm256_unpacklo_epi64(t[4 * g], t[4 * g + 2]);
+            r[4 * g + 1] = _mm256_unpackhi_epi64(t[4 * g], t[4 * g + 2]);
+            r[4 * g + 2] = _mm256_unpacklo_epi64(t[4 * g + 1], t[4 * g + 3]);
+            r[4 * g + 3] = _mm256_unpackhi_epi64(t[4 * g + 1], t[4 * g + 3]);
+        }
+        for(int c = 0; c < 4; ++c)
+        {
+            m[8 * h + c]     = _mm256_permute2x128_si256(r[c], r[4 + c], 0x20);
+            m[8 * h + 4 + c] = _mm256_permute2x128_si256(r[c], r[4 + c], 0x31);
+        }
+    }
+}
+
+#    define B3_ADD(a, b) _mm256_add_epi32(a, b)
+#    define B3_XOR(a, b) _mm256_xor_si256(a, b)
+#    define B3_R16(x)                                                        \
+        _mm256_shuffle_epi8(x, _mm256_set_epi8(13, 12, 15, 14, 9, 8, 11, 10, \
+                                               5, 4, 7, 6, 1, 0, 3, 2, 13,   \
+                                               12, 15, 14, 9, 8, 11, 10, 5,  \
+                                               4, 7, 6, 1, 0, 3, 2))
+#    define B3_R8(x)                                                          \
+        _mm256_shuffle_epi8(x, _mm256_set_epi8(12, 15, 14, 13, 8, 11, 10, 9,  \
+                                               4, 7, 6, 5, 0, 3, 2, 1, 12,    \
+                                               15, 14, 13, 8, 11, 10, 9, 4,   \
+                                               7, 6, 5, 0, 3, 2, 1))
+#    define B3_R12(x) \
+        _mm256_or_si256(_mm256_srli_epi32(x, 12), _mm256_slli_epi32(x, 20))
+#    define B3_R7(x) \
+        _mm256_or_si256(_mm256_srli_epi32(x, 7), _mm256_slli_epi32(x, 25))
+
+__attribute__((target("avx2"))) static void
+b3_x8_avx2(const uint8_t* const in[8], size_t nblk, const uint32_t ctr_lo[8],
+           const uint32_t ctr_hi[8], uint8_t flags, uint8_t fstart,
+           uint8_t fend, uint8_t (*out)[32])
+{
+    __m256i h[8];
+    for(int i = 0; i < 8; ++i)
+        h[i] = _mm256_set1_epi32((int)B3_IV[i]);
+    const __m256i lo = _mm256_loadu_si256((const __m256i*)ctr_lo);
+    const __m256i hi = _mm256_loadu_si256((const __m256i*)ctr_hi);
+
+    for(size_t b = 0; b < nblk; ++b)
+    {
+        __m256i m[16], v[16];
+        b3_msg_x8(in, b * B3_BLOCK, m);
+        uint8_t f = (uint8_t)(flags | (b == 0 ? fstart : 0) |
+                              (b + 1 == nblk ? fend : 0));
+        for(int i = 0; i < 8; ++i)
+            v[i] = h[i];
+        for(int i = 0; i < 4; ++i)
+            v[8 + i] = _mm256_set1_epi32((int)B3_IV[i]);
+        v[12] = lo;
+        v[13] = hi;
+        v[14] = _mm256_set1_epi32(B3_BLOCK);
+        v[15] = _mm256_set1_epi32(f);
+        B3_ROUNDS();
+        for(int i = 0; i < 8; ++i)
+            h[i] = _mm256_xor_si256(v[i], v[i + 8]);
+    }
+
+    uint32_t t[8][8];
+    for(int i = 0; i < 8; ++i)
+        _mm256_storeu_si256((__m256i*)t[i], h[i]);
+    for(int l = 0; l < 8; ++l)
+        for(int i = 0; i < 8; ++i)
+            b3_store32(out[l] + 4 * i, t[i][l]);
+}
+
+#endif /* B3_X86 */
@@ -1,343 +1,1997 @@
+#define _GNU_SOURCE /* copy_file_range */
 #include "cryptography/sha256.h"
-#include "fsutil.h"  // mkdir_p, path_sha256
+#include "cryptography/sha256_simd.h"
+#include "cryptography/blake3.h"
+#include "fsutil.h"  // FsObjDir
+#include "codec.h"
 #include <openssl/evp.h>
 #include <openssl/rand.h>
 #include <poll.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
 #include <errno.h>
 #include <fcntl.h>
 #include <stdio.h>
 #include <string.h>
 #include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <limits.h>
+#if defined(__linux__)
+#    include <linux/fs.h> /* FICLONE */
+#    include "uring.h"
+#endif
 
 #ifndef CRYPTO_READ_BUFSZ
 #    define CRYPTO_READ_BUFSZ (1 << 16)
 #endif
 
-/* tmp file inside dir using openat + random name */
-static int make_tmp_in_dir(const char* tmpdir, char out_path[PATH_MAX]);
+/* Hash step over a mapped object; keeps EVP updates cache friendly. */
+#ifndef CRYPTO_MAP_STEP
+#    define CRYPTO_MAP_STEP (1 << 20)
+#endif
+
+/* Async ingest: buffers kept in flight and bytes per (registered) buffer. */
+#ifndef CRYPTO_URING_QD
+#    define CRYPTO_URING_QD 8
+#endif
+#ifndef CRYPTO_URING_BUFSZ
+#    define CRYPTO_URING_BUFSZ (1 << 18)
+#endif
+/* Threads holding a ring (and its pinned buffers) at once; others fall back
+   to the write-behind engine. */
+#ifndef CRYPTO_URING_RINGS
+#    define CRYPTO_URING_RINGS 4
+#endif
+
+/* Write-behind fallback: buffers queued between reader and writer thread. */
+#ifndef CRYPTO_WB_SLOTS
+#    define CRYPTO_WB_SLOTS 4
+#endif
+
+/* Compression: the first chunk of a source is trial-compressed and the
+   object is stored compressed only if that saves at least this much */
+#ifndef CRYPTO_CODEC_PROBE
+#    define CRYPTO_CODEC_PROBE (1 << 16)
+#endif
+#ifndef CRYPTO_CODEC_MIN_SAVING_PCT
+#    define CRYPTO_CODEC_MIN_SAVING_PCT 10
+#endif
+
+/* Segments handed to one pwritev() call (IOV_MAX is at least 1024) */
+#ifndef CRYPTO_IOV_BATCH
+#    define CRYPTO_IOV_BATCH 64
+#endif
+
+struct CryptSha256Ctx
+{
+    EVP_MD_CTX*      md; /* NULL: hashed by the internal backend in 'st' */
+    CryptSha256State st;
+};
+
+struct CryptDigestCtx
+{
+    CryptHash alg;
+    union
+    {
+        CryptSha256Ctx* sha;
+        CryptBlake3*    b3;
+    } u;
+};
+
+/* One message in flight on a multi-buffer lane: its full blocks are read in
+   place, then the padded tail from tail[]. */
+typedef struct
+{
+    const uint8_t* p;     /* next block of the current segment */
+    size_t         left;  /* blocks left in the segment */
+    size_t         ntail; /* tail blocks still to come (0 once in tail[]) */
+    size_t         job;   /* index into out[] */
+    uint8_t        tail[128];
+} ShaLane;
+
+/* Enabled CRYPT_SHA256_IMPL_* backends, -1 until first use. */
+static _Atomic int g_sha_impl = -1;
+
+/* Content digest (CryptHash) */
+static _Atomic int g_content_hash = CRYPT_HASH_SHA256;
+
+/* Regular-file sources are copied by the kernel (reflink/copy_file_range). */
+static int g_zero_copy = 1;
+
+/* zlib level for stored objects, 0 = off (crypt_set_compression) */
+static _Atomic int g_codec_level = 0;
+
+/* Engine used for sources the kernel cannot copy (see CryptEngine). */
+static _Atomic int g_engine = CRYPT_ENGINE_AUTO;
+
+#if defined(__linux__)
+/* Per-thread ring + registered buffers, created on first use. */
+typedef struct
+{
+    Uring    ring;
+    uint8_t* buf; /* CRYPTO_URING_QD * CRYPTO_URING_BUFSZ bytes */
+} IngestRing;
+
+/* One in-flight buffer of the io_uring ingest loop. */
+typedef struct
+{
+    int      state; /* URING_SLOT_* */
+    uint32_t want;  /* bytes requested from the source */
+    uint32_t have;  /* bytes read so far */
+    uint32_t wdone; /* bytes written to the temp so far */
+    uint64_t seq;   /* read order; hashing follows it */
+    uint64_t roff;  /* source offset (seekable sources) */
+    uint64_t woff;  /* temp offset */
+} UringSlot;
+
+enum
+{
+    URING_SLOT_FREE = 0,
+    URING_SLOT_READING,
+    URING_SLOT_READY,
+    URING_SLOT_WRITING
+};
+
+enum
+{
+    URING_OP_READ = 1,
+    URING_OP_POLL,
+    URING_OP_WRITE,
+    URING_OP_FSYNC
+};
+
+#    define URING_UD(op, slot) (((uint64_t)(slot) << 8) | (uint64_t)(op))
+
+static pthread_key_t  g_ring_key;
+static pthread_once_t g_ring_once    = PTHREAD_ONCE_INIT;
+static int            g_ring_key_ok  = 0;
+static _Atomic int    g_uring_broken = 0; /* no io_uring: never retry */
+static _Atomic int    g_uring_rings  = 0; /* live IngestRings */
+#endif
+
+/* Hand-off queue between the reading/hashing caller and the writer thread. */
+typedef struct
+{
+    pthread_mutex_t mu;
+    pthread_cond_t  cv;
+    uint8_t*        buf; /* CRYPTO_WB_SLOTS * CRYPTO_URING_BUFSZ bytes */
+    size_t          len[CRYPTO_WB_SLOTS];
+    unsigned        head; /* next slot to write */
+    unsigned        tail; /* next slot to fill */
+    int             done; /* reader reached EOF (or gave up) */
+    int             err;  /* writer failed */
+    int             fd;
+} WriteBehind;
+
+/* Digest with 'alg' of everything read from fd until EOF. */
+static int digest_fd(int fd, CryptHash alg, Sha256* out, size_t* size_out);
+/* Digest with 'alg' of [off, off+len) of fd (crypt_sha256_fd_range). */
+static int digest_fd_range(int fd, off_t off, size_t len, CryptHash alg,
+                           Sha256* out);
+static CryptDigestCtx* digest_begin(CryptHash alg);
+
+/* Pick the configured engine. *synced is 1 on entry when no fsync is wanted
+   and is set to 1 when the engine already made the temp durable. */
+static int copy_and_digest_engine(int src_fd, int tmpfd, Sha256* out,
+                                  size_t* size_out, int* synced);
+
+#if defined(__linux__)
+/* io_uring engine: several reads and writes in flight on registered buffers,
+   hashing in read order as buffers complete, fsync linked after the last
+   write. Returns 0 (temp fsynced), 1 when io_uring is unusable (nothing
+   consumed), -1 on error. */
+static int copy_and_digest_uring(int src_fd, int tmpfd, Sha256* out,
+                                 size_t* size_out, int sync);
+
+/* Room for 'n' SQEs, flushing the SQ when it is full. A flush submits
+   '*last_write', so it is cleared then (it can no longer be linked).
+   0 or -1. */
+static int         ingest_sq_room(Uring* r, unsigned n,
+                                  struct io_uring_sqe** last_write);
+static IngestRing* ingest_ring_get(void);
+static void        ingest_ring_drop(void);
+static void        ingest_ring_free(void* p);
+static void        ingest_ring_key_init(void);
+#endif
+
+/* Fallback engine: caller reads + hashes, a helper thread writes behind.
+   Returns 0, 1 when the helper cannot start (nothing consumed), -1. */
+static int   copy_and_digest_threaded(int src_fd, int tmpfd, Sha256* out,
+                                      size_t* size_out);
+static void* write_behind_main(void* arg);
+
+/* Legacy path: read() → write() → digest update until EOF. */
+static int copy_and_digest_stream(int src_fd, int tmpfd, Sha256* out,
+                                  size_t* size_out);
+
+/* Regular-file fast path. Returns 0 when the object was copied and hashed,
+   1 when the kernel cannot copy this pair (nothing consumed), -1 on error. */
+static int copy_and_digest_regular(int src_fd, const struct stat* sst,
+                                   int tmpfd, Sha256* out, size_t* size_out);
+
+/* Hash 'len' bytes of 'fd' from offset 0 through a read-only mapping. */
+static int digest_mapped(int fd, size_t len, Sha256* out);
 
-static int publish_or_discard(const char* root, const Sha256* d,
-                              const char* tmp_path);
+/* Compressing path: hash the source while writing it deflated at 'level'.
+   Returns 0 when stored (compressed, or raw for a stream whose first chunk
+   did not compress), 1 when a regular file is better stored raw (nothing
+   consumed, temp empty), -1 on error. A compressed temp never has the
+   size of the source: readers tell the two apart by size. */
+static int copy_and_digest_codec(int src_fd, int regular, int tmpfd,
+                                 Sha256* out, size_t* size_out, int level);
+
+/* Deflate the in-memory object iov[0..iovcnt) into tmpfd. 0 when stored
+   compressed, 1 when it does not pay (tmpfd left empty), -1 on error. */
+static int deflate_iov(const struct iovec* iov, int iovcnt, int tmpfd,
+                       int level);
+
+/* SHA-256 compression of 'nblk' 64-byte blocks into h[8]: SHA-NI when
+   enabled, else the portable loop below. */
+static void sha256_compress(uint32_t h[8], const uint8_t* p, size_t nblk);
+static void sha256_blocks(uint32_t h[8], const uint8_t* p, size_t nblk);
+static unsigned sha_impl(void);
+
+/* crypt_sha256_many() over 'width' (8 or 16) lanes. */
+static void sha256_many_lanes(size_t count, const void* const p[],
+                              const size_t n[], Sha256 out[], unsigned width);
+/* Put message 'job' on lane 'l': IV into st[][l], blocks and padded tail. */
+static void sha_lane_load(ShaLane* ln, uint32_t st[8][SHA256_LANES_MAX],
+                          unsigned l, size_t job, const uint8_t* p, size_t n);
+/* Big-endian digest of chaining value h[i] = st[i][l]. */
+static void sha_digest_out(const uint32_t st[8][SHA256_LANES_MAX], unsigned l,
+                           Sha256* out);
+
+/* read() until 'n' bytes or EOF (waits on non-blocking sources). */
+static ssize_t read_full(int fd, uint8_t* buf, size_t n);
+static int     write_full(int fd, const uint8_t* buf, size_t n);
+/* pwritev() all of iov[0..iovcnt) at offset 0, resuming short writes. */
+static int     pwritev_full(int fd, const struct iovec* iov, int iovcnt);
+
+void crypt_set_zero_copy(int enable)
+{
+    g_zero_copy = enable ? 1 : 0;
+}
+
+void crypt_set_ingest_engine(CryptEngine engine)
+{
+    atomic_store(&g_engine, (int)engine);
+}
+
+void crypt_set_compression(int level)
+{
+    atomic_store(&g_codec_level,
+                 codec_zlib_available() && level > 0 ? (level > 9 ? 9 : level)
+                                                     : 0);
+}
+
+int crypt_compression_level(void)
+{
+    return atomic_load(&g_codec_level);
+}
 
-static int digest_fd_evp(int fd, Sha256* out, size_t* size_out);
+int crypt_uring_available(void)
+{
+#if defined(__linux__)
+    return ingest_ring_get() != NULL;
+#else
+    return 0;
+#endif
+}
 
-int crypt_store_sha256_object_from_fd(const char* root, int src_fd,
+int crypt_store_sha256_object_from_fd(FsObjDir* od, int src_fd,
                                       Sha256* digest_out, size_t* size_out)
 {
-    if(!root)
+    FsTmp  tmp;
+    Sha256 d     = {0};
+    size_t total = 0;
+    if(crypt_stage_sha256_object_from_fd(od, src_fd, &tmp, &d, &total, 1) != 0)
+        return -1;
+
+    /* linkat into the cached xx/yy handle; EEXIST is a dedup hit */
+    char hex[65];
+    crypt_sha256_hex(&d, hex);
+    if(fs_objdir_publish(od, &tmp, hex) != 0)
+        return -1;
+
+    if(digest_out)
+        *digest_out = d;
+    if(size_out)
+        *size_out = total;
+    return 0;
+}
+
+int crypt_stage_sha256_object_from_fd(FsObjDir* od, int src_fd, FsTmp* tmp,
+                                      Sha256* digest_out, size_t* size_out,
+                                      int sync)
+{
+    if(!od || !tmp || !digest_out)
+        return -1;
+
+    /* anonymous O_TMPFILE when possible: nothing to clean up on failure */
+    if(fs_objdir_tmp_open(od, tmp) != 0)
+        return -1;
+
+    size_t total  = 0;
+    int    rc     = 1;
+    int    synced = !sync; /* caller syncs (e.g. group flusher) */
+
+    struct stat sst;
+    int         regular = fstat(src_fd, &sst) == 0 && S_ISREG(sst.st_mode);
+    int         level   = atomic_load(&g_codec_level);
+    if(level > 0)
+        rc = copy_and_digest_codec(src_fd, regular, tmp->fd, digest_out,
+                                   &total, level);
+    if(rc == 1 && g_zero_copy && regular)
+        rc = copy_and_digest_regular(src_fd, &sst, tmp->fd, digest_out, &total);
+    if(rc == 1)
+        rc = copy_and_digest_engine(src_fd, tmp->fd, digest_out, &total,
+                                    &synced);
+    if(rc != 0 || (!synced && fsync(tmp->fd) != 0))
+    {
+        fs_objdir_tmp_discard(od, tmp);
+        return -1;
+    }
+    if(size_out)
+        *size_out = total;
+    return 0;
+}
+
+int crypt_stage_object_from_iov(FsObjDir* od, const struct iovec* iov,
+                                int iovcnt, FsTmp* tmp, int sync)
+{
+    if(!od || !tmp || iovcnt < 0 || (iovcnt && !iov))
+        return -1;
+    if(fs_objdir_tmp_open(od, tmp) != 0)
+        return -1;
+
+    int level = atomic_load(&g_codec_level);
+    int rc    = level > 0 ? deflate_iov(iov, iovcnt, tmp->fd, level) : 1;
+    if(rc == 1)
+        rc = pwritev_full(tmp->fd, iov, iovcnt);
+    if(rc != 0 || (sync && fsync(tmp->fd) != 0))
+    {
+        fs_objdir_tmp_discard(od, tmp);
         return -1;
+    }
+    return 0;
+}
+
+/* hex */
+void crypt_sha256_hex(const Sha256* d, char out[65])
+{
+    static const char* H = "0123456789abcdef";
+    for(int i = 0; i < 32; ++i)
+    {
+        out[i * 2]     = H[d->b[i] >> 4];
+        out[i * 2 + 1] = H[d->b[i] & 0xF];
+    }
+    out[64] = '\0';
+}
+
+int crypt_sha256_buf(const void* p, size_t n, Sha256* out)
+{
+    if((!p && n) || !out)
+        return -1;
+    if(sha_impl() & CRYPT_SHA256_IMPL_SHANI)
+    {
+        /* no EVP fetch/context per call: what small objects pay for most */
+        CryptSha256State st;
+        crypt_sha256_state_init(&st);
+        crypt_sha256_state_update(&st, p, n);
+        crypt_sha256_state_final(&st, out);
+        return 0;
+    }
+    unsigned int outlen = 0;
+    if(EVP_Digest(p, n, out->b, &outlen, EVP_sha256(), NULL) != 1 ||
+       outlen != 32)
+        return -1;
+    return 0;
+}
+
+int crypt_sha256_iov(const struct iovec* iov, int iovcnt, Sha256* out)
+{
+    if(iovcnt < 0 || (iovcnt && !iov) || !out)
+        return -1;
+    if(sha_impl() & CRYPT_SHA256_IMPL_SHANI)
+    {
+        CryptSha256State st;
+        crypt_sha256_state_init(&st);
+        for(int i = 0; i < iovcnt; ++i)
+            crypt_sha256_state_update(&st, iov[i].iov_base, iov[i].iov_len);
+        crypt_sha256_state_final(&st, out);
+        return 0;
+    }
+    int         rc  = -1;
+    EVP_MD_CTX* ctx = EVP_MD_CTX_new();
+    if(!ctx || EVP_DigestInit_ex(ctx, EVP_sha256(), NULL) != 1)
+        goto done;
+    for(int i = 0; i < iovcnt; ++i)
+        if(iov[i].iov_len &&
+           EVP_DigestUpdate(ctx, iov[i].iov_base, iov[i].iov_len) != 1)
+            goto done;
+    unsigned int outlen = 0;
+    if(EVP_DigestFinal_ex(ctx, out->b, &outlen) == 1 && outlen == 32)
+        rc = 0;
+done:
+    EVP_MD_CTX_free(ctx);
+    return rc;
+}
+
+CryptSha256Ctx* crypt_sha256_begin(void)
+{
+    CryptSha256Ctx* c = malloc(sizeof *c);
+    if(!c)
+        return NULL;
+    if(sha_impl() & CRYPT_SHA256_IMPL_SHANI)
+    {
+        c->md = NULL;
+        crypt_sha256_state_init(&c->st);
+        return c;
+    }
+    c->md = EVP_MD_CTX_new();
+    if(!c->md || EVP_DigestInit_ex(c->md, EVP_sha256(), NULL) != 1)
+    {
+        EVP_MD_CTX_free(c->md);
+        free(c);
+        return NULL;
+    }
+    return c;
+}
+
+int crypt_sha256_update(CryptSha256Ctx* c, const void* p, size_t n)
+{
+    if(!c || (!p && n))
+        return -1;
+    if(!c->md)
+    {
+        crypt_sha256_state_update(&c->st, p, n);
+        return 0;
+    }
+    return EVP_DigestUpdate(c->md, p, n) == 1 ? 0 : -1;
+}
+
+int crypt_sha256_end(CryptSha256Ctx* c, Sha256* out)
+{
+    if(!c)
+        return -1;
+    int rc = 0;
+    if(out && !c->md)
+        crypt_sha256_state_final(&c->st, out);
+    else if(out)
+    {
+        unsigned int outlen = 0;
+        rc = EVP_DigestFinal_ex(c->md, out->b, &outlen) == 1 && outlen == 32
+                 ? 0
+                 : -1;
+    }
+    EVP_MD_CTX_free(c->md);
+    free(c);
+    return rc;
+}
+
+void crypt_sha256_state_init(CryptSha256State* s)
+{
+    static const uint32_t IV[8] = {0x6a09e667, 0xbb67ae85, 0x3c6ef372,
+                                   0xa54ff53a, 0x510e527f, 0x9b05688c,
+                                   0x1f83d9ab, 0x5be0cd19};
+    memcpy(s->h, IV, sizeof IV);
+    s->len = 0;
+}
+
+void crypt_sha256_state_update(CryptSha256State* s, const void* p, size_t n)
+{
+    const uint8_t* in   = p;
+    size_t         have = (size_t)(s->len & 63u);
+    if(!n)
+        return;
+    s->len += n;
+    if(have)
+    {
+        size_t take = n < 64 - have ? n : 64 - have;
+        memcpy(s->buf + have, in, take);
+        in += take;
+        n -= take;
+        if(have + take < 64)
+            return;
+        sha256_compress(s->h, s->buf, 1);
+    }
+    sha256_compress(s->h, in, n / 64);
+    if(n & 63u)
+        memcpy(s->buf, in + (n & ~(size_t)63u), n & 63u);
+}
+
+void crypt_sha256_state_final(const CryptSha256State* s, Sha256* out)
+{
+    /* pad a copy: 0x80, zeros, then the bit length big-endian */
+    uint32_t h[8];
+    uint8_t  blk[128] = {0};
+    size_t   have     = (size_t)(s->len & 63u);
+    size_t   nblk     = have < 56 ? 1 : 2;
+    memcpy(h, s->h, sizeof h);
+    memcpy(blk, s->buf, have);
+    blk[have]  = 0x80;
+    uint64_t b = s->len << 3;
+    for(int i = 0; i < 8; ++i)
+        blk[nblk * 64 - 1 - (size_t)i] = (uint8_t)(b >> (8 * i));
+    sha256_compress(h, blk, nblk);
+    for(int i = 0; i < 8; ++i)
+    {
+        out->b[i * 4]     = (uint8_t)(h[i] >> 24);
+        out->b[i * 4 + 1] = (uint8_t)(h[i] >> 16);
+        out->b[i * 4 + 2] = (uint8_t)(h[i] >> 8);
+        out->b[i * 4 + 3] = (uint8_t)h[i];
+    }
+}
+
+void crypt_sha256_state_save(const CryptSha256State* s,
+                             uint8_t out[CRYPT_SHA256_STATE_SIZE])
+{
+    /* h[8] and len big-endian, then the partial block */
+    for(int i = 0; i < 8; ++i)
+        for(int j = 0; j < 4; ++j)
+            out[i * 4 + j] = (uint8_t)(s->h[i] >> (24 - 8 * j));
+    for(int j = 0; j < 8; ++j)
+        out[32 + j] = (uint8_t)(s->len >> (56 - 8 * j));
+    memset(out + 40, 0, 64);
+    memcpy(out + 40, s->buf, (size_t)(s->len & 63u));
+}
+
+void crypt_sha256_state_load(CryptSha256State* s,
+                             const uint8_t in[CRYPT_SHA256_STATE_SIZE])
+{
+    for(int i = 0; i < 8; ++i)
+    {
+        s->h[i] = 0;
+        for(int j = 0; j < 4; ++j)
+            s->h[i] = (s->h[i] << 8) | in[i * 4 + j];
+    }
+    s->len = 0;
+    for(int j = 0; j < 8; ++j)
+        s->len = (s->len << 8) | in[32 + j];
+    memcpy(s->buf, in + 40, 64);
+}
+
+unsigned crypt_sha256_set_impl(unsigned mask)
+{
+    unsigned v = mask & sha256_simd_features();
+    atomic_store(&g_sha_impl, (int)v);
+    return v;
+}
+
+unsigned crypt_sha256_impl(void)
+{
+    return sha_impl();
+}
+
+int crypt_sha256_many(size_t count, const void* const p[], const size_t n[],
+                      Sha256 out[])
+{
+    if(count && (!p || !n || !out))
+        return -1;
+    for(size_t i = 0; i < count; ++i)
+        if(!p[i] && n[i])
+            return -1;
+
+    /* AVX-512 lanes beat one SHA-NI stream; 8 AVX2 lanes do not */
+    unsigned impl = sha_impl();
+    if(impl & CRYPT_SHA256_IMPL_AVX512)
+        sha256_many_lanes(count, p, n, out, 16);
+    else if(impl & CRYPT_SHA256_IMPL_SHANI)
+        for(size_t i = 0; i < count; ++i)
+            (void)crypt_sha256_buf(p[i], n[i], &out[i]);
+    else if(impl & CRYPT_SHA256_IMPL_AVX2)
+        sha256_many_lanes(count, p, n, out, 8);
+    else
+        for(size_t i = 0; i < count; ++i)
+            if(crypt_sha256_buf(p[i], n[i], &out[i]) != 0)
+                return -1;
+    return 0;
+}
+
+int crypt_rand_bytes(void* buf, size_t n)
+{
+    if(!buf && n)
+        return -1;
+    return RAND_bytes((unsigned char*)buf, (int)n) == 1 ? 0 : -1;
+}
+
+int crypt_sha256_fd(int fd, Sha256* out, size_t* size_out)
+{
+    off_t cur = lseek(fd, 0, SEEK_CUR);
+    if(cur != (off_t)-1)
+        (void)lseek(fd, 0, SEEK_SET);
+    int rc = digest_fd(fd, CRYPT_HASH_SHA256, out, size_out);
+    if(cur != (off_t)-1)
+        (void)lseek(fd, cur, SEEK_SET);
+    return rc;
+}
+
+int crypt_sha256_fd_range(int fd, off_t off, size_t len, Sha256* out)
+{
+    return digest_fd_range(fd, off, len, CRYPT_HASH_SHA256, out);
+}
+
+int crypt_sha256_file(const char* path, Sha256* out, size_t* size_out)
+{
+    if(!path || !out)
+        return -1;
+    int fd = open(path, O_RDONLY);
+    if(fd < 0)
+        return -1;
+    int rc = digest_fd(fd, CRYPT_HASH_SHA256, out, size_out);
+    close(fd);
+    return rc;
+}
+
+void crypt_set_content_hash(CryptHash h)
+{
+    atomic_store(&g_content_hash, (int)h);
+}
+
+CryptHash crypt_content_hash(void)
+{
+    return (CryptHash)atomic_load_explicit(&g_content_hash,
+                                           memory_order_relaxed);
+}
+
+int crypt_digest_buf(const void* p, size_t n, Sha256* out)
+{
+    if(crypt_content_hash() == CRYPT_HASH_SHA256)
+        return crypt_sha256_buf(p, n, out);
+    if((!p && n) || !out)
+        return -1;
+    crypt_blake3(p, n, 1, out->b);
+    return 0;
+}
+
+int crypt_digest_iov(const struct iovec* iov, int iovcnt, Sha256* out)
+{
+    if(crypt_content_hash() == CRYPT_HASH_SHA256)
+        return crypt_sha256_iov(iov, iovcnt, out);
+    if(iovcnt < 0 || (iovcnt && !iov) || !out)
+        return -1;
+    if(iovcnt == 1)
+        return crypt_digest_buf(iov[0].iov_base, iov[0].iov_len, out);
+    CryptDigestCtx* c = digest_begin(CRYPT_HASH_BLAKE3);
+    if(!c)
+        return -1;
+    for(int i = 0; i < iovcnt; ++i)
+        (void)crypt_digest_update(c, iov[i].iov_base, iov[i].iov_len);
+    return crypt_digest_end(c, out);
+}
+
+int crypt_digest_fd_range(int fd, off_t off, size_t len, Sha256* out)
+{
+    return digest_fd_range(fd, off, len, crypt_content_hash(), out);
+}
+
+int crypt_digest_many(size_t count, const void* const p[], const size_t n[],
+                      Sha256 out[])
+{
+    if(crypt_content_hash() == CRYPT_HASH_SHA256)
+        return crypt_sha256_many(count, p, n, out);
+    if((count && (!p || !n || !out)))
+        return -1;
+    /* each content already fills the lanes with its own chunks */
+    for(size_t i = 0; i < count; ++i)
+        if(crypt_digest_buf(p[i], n[i], &out[i]) != 0)
+            return -1;
+    return 0;
+}
+
+unsigned crypt_digest_lanes(void)
+{
+    if(crypt_content_hash() != CRYPT_HASH_SHA256)
+        return 1;
+    /* same choice as crypt_sha256_many() */
+    unsigned impl = sha_impl();
+    if(impl & CRYPT_SHA256_IMPL_AVX512)
+        return 16;
+    if(impl & CRYPT_SHA256_IMPL_SHANI)
+        return 1;
+    return impl & CRYPT_SHA256_IMPL_AVX2 ? 8 : 1;
+}
+
+CryptDigestCtx* crypt_digest_begin(void)
+{
+    return digest_begin(crypt_content_hash());
+}
+
+int crypt_digest_update(CryptDigestCtx* c, const void* p, size_t n)
+{
+    if(!c || (!p && n))
+        return -1;
+    if(c->alg == CRYPT_HASH_SHA256)
+        return crypt_sha256_update(c->u.sha, p, n);
+    crypt_blake3_update(c->u.b3, p, n);
+    return 0;
+}
+
+int crypt_digest_end(CryptDigestCtx* c, Sha256* out)
+{
+    if(!c)
+        return -1;
+    int rc = 0;
+    if(c->alg == CRYPT_HASH_SHA256)
+        rc = crypt_sha256_end(c->u.sha, out);
+    else
+        crypt_blake3_end(c->u.b3, out ? out->b : NULL);
+    free(c);
+    return rc;
+}
+
+static int copy_and_digest_engine(int src_fd, int tmpfd, Sha256* out,
+                                  size_t* size_out, int* synced)
+{
+    int engine = atomic_load(&g_engine);
+    int rc     = 1;
+
+#if defined(__linux__)
+    if(engine == CRYPT_ENGINE_AUTO || engine == CRYPT_ENGINE_URING)
+    {
+        rc = copy_and_digest_uring(src_fd, tmpfd, out, size_out, !*synced);
+        if(rc == 0)
+            *synced = 1;
+    }
+#endif
+    if(rc == 1 && engine != CRYPT_ENGINE_SERIAL)
+        rc = copy_and_digest_threaded(src_fd, tmpfd, out, size_out);
+    if(rc == 1)
+        rc = copy_and_digest_stream(src_fd, tmpfd, out, size_out);
+    return rc;
+}
+
+#if defined(__linux__)
+static int copy_and_digest_uring(int src_fd, int tmpfd, Sha256* out,
+                                 size_t* size_out, int sync)
+{
+    IngestRing* ir = ingest_ring_get();
+    if(!ir)
+        return 1;
+    Uring* r = &ir->ring;
+
+    /* Seekable sources get QD reads in flight at explicit offsets up to the
+       size seen by fstat; past it (and for streams) one read stays
+       outstanding until one returns 0, so a growing file is read to EOF. */
+    int         seekable = 0;
+    uint64_t    rd_off = 0, start = 0, end = 0;
+    struct stat sst;
+    if(fstat(src_fd, &sst) == 0 && S_ISREG(sst.st_mode))
+    {
+        off_t cur = lseek(src_fd, 0, SEEK_CUR);
+        if(cur != (off_t)-1)
+        {
+            seekable = 1;
+            rd_off = start = (uint64_t)cur;
+            end = sst.st_size > cur ? (uint64_t)sst.st_size : rd_off;
+        }
+    }
+
+    CryptDigestCtx* ctx = crypt_digest_begin();
+    if(!ctx)
+        return -1;
+
+    UringSlot slots[CRYPTO_URING_QD];
+    memset(slots, 0, sizeof slots);
+
+    uint64_t next_seq = 0, hash_seq = 0, woff = 0;
+    unsigned reads = 0, polls = 0, writes = 0, fsyncs = 0;
+    int      eof = 0, failed = 0;
+    int      dirty = sync; /* data not yet covered by a completed fsync */
+
+    struct io_uring_sqe* sqe;
+    struct io_uring_sqe* last_write = NULL;
+
+    for(;;)
+    {
+        /* 1) keep the source busy */
+        for(unsigned i = 0; i < CRYPTO_URING_QD && !eof; ++i)
+        {
+            UringSlot* sl = &slots[i];
+            if(sl->state != URING_SLOT_FREE)
+                continue;
+            if((!seekable || rd_off >= end) && reads > 0)
+                break;
+            if(ingest_sq_room(r, 1, &last_write) != 0)
+            {
+                failed = 1;
+                break;
+            }
+            sl->state = URING_SLOT_READING;
+            sl->seq   = next_seq++;
+            sl->have  = 0;
+            sl->wdone = 0;
+            sl->roff  = rd_off;
+            sl->want  = CRYPTO_URING_BUFSZ;
+            if(seekable && rd_off < end && end - rd_off < CRYPTO_URING_BUFSZ)
+                sl->want = (uint32_t)(end - rd_off);
+            if(seekable)
+                rd_off += sl->want;
+
+            sqe            = uring_get_sqe(r);
+            sqe->opcode    = IORING_OP_READ_FIXED;
+            sqe->fd        = src_fd;
+            sqe->addr      = (uint64_t)(uintptr_t)(ir->buf +
+                                                   (size_t)i * CRYPTO_URING_BUFSZ);
+            sqe->len       = sl->want;
+            sqe->off       = seekable ? sl->roff : (uint64_t)-1;
+            sqe->buf_index = (uint16_t)i;
+            sqe->user_data = URING_UD(URING_OP_READ, i);
+            reads++;
+        }
+        if(failed)
+            break;
+
+        /* 2) hash completed buffers in order, then write them behind */
+        int progressed = 1;
+        while(progressed && !failed)
+        {
+            progressed = 0;
+            for(unsigned i = 0; i < CRYPTO_URING_QD; ++i)
+            {
+                UringSlot* sl = &slots[i];
+                if(sl->state != URING_SLOT_READY || sl->seq != hash_seq)
+                    continue;
+                uint8_t* b = ir->buf + (size_t)i * CRYPTO_URING_BUFSZ;
+                if(crypt_digest_update(ctx, b, sl->have) != 0)
+                {
+                    failed = 1;
+                    break;
+                }
+                if(ingest_sq_room(r, 1, &last_write) != 0)
+                {
+                    failed = 1;
+                    break;
+                }
+                sl->state = URING_SLOT_WRITING;
+                sl->woff  = woff;
+                woff += sl->have;
+                hash_seq++;
+
+                sqe            = uring_get_sqe(r);
+                sqe->opcode    = IORING_OP_WRITE_FIXED;
+                sqe->fd        = tmpfd;
+                sqe->addr      = (uint64_t)(uintptr_t)b;
+                sqe->len       = sl->have;
+                sqe->off       = sl->woff;
+                sqe->buf_index = (uint16_t)i;
+                sqe->user_data = URING_UD(URING_OP_WRITE, i);
+                last_write     = sqe;
+                writes++;
+                dirty      = sync;
+                progressed = 1;
+            }
+        }
+        if(failed)
+            break;
+
+        int ready = 0;
+        for(unsigned i = 0; i < CRYPTO_URING_QD; ++i)
+            ready += slots[i].state == URING_SLOT_READY;
+
+        /* 3) everything read and queued: fsync, drained behind the writes
+              and linked to the last one so a short write cancels it */
+        if(eof && reads == 0 && ready == 0 && fsyncs == 0 && dirty)
+        {
+            if(ingest_sq_room(r, 1, &last_write) != 0)
+            {
+                failed = 1;
+                break;
+            }
+            if(last_write)
+                last_write->flags |= IOSQE_IO_LINK;
+            sqe              = uring_get_sqe(r);
+            sqe->opcode      = IORING_OP_FSYNC;
+            sqe->fd          = tmpfd;
+            sqe->flags       = IOSQE_IO_DRAIN;
+            sqe->user_data   = URING_UD(URING_OP_FSYNC, 0);
+            fsyncs++;
+            dirty = 0;
+        }
+
+        if(eof && reads == 0 && polls == 0 && writes == 0 && fsyncs == 0 &&
+           ready == 0 && !dirty)
+            break; /* done */
+
+        /* 4) submit and reap */
+        if(uring_submit_and_wait(r, 1) < 0)
+        {
+            failed = 1;
+            break;
+        }
+        last_write = NULL;
+
+        struct io_uring_cqe* cqe;
+        while((cqe = uring_peek_cqe(r)) != NULL)
+        {
+            unsigned   op  = (unsigned)(cqe->user_data & 0xFF);
+            unsigned   i   = (unsigned)(cqe->user_data >> 8);
+            int        res = cqe->res;
+            UringSlot* sl  = &slots[i < CRYPTO_URING_QD ? i : 0];
+            uring_cqe_seen(r);
+
+            switch(op)
+            {
+                case URING_OP_POLL:
+                    polls--;
+                    if(res < 0 && res != -ECANCELED)
+                        failed = 1;
+                    break;
+
+                case URING_OP_READ:
+                    reads--;
+                    if(res == -EAGAIN || res == -EINTR || res == -ECANCELED)
+                    {
+                        /* non-blocking source: wait for POLLIN, then retry;
+                           both SQEs go in one submit so the link holds */
+                        if(ingest_sq_room(r, 2, &last_write) != 0)
+                        {
+                            failed = 1;
+                            break;
+                        }
+                        sqe              = uring_get_sqe(r);
+                        sqe->opcode      = IORING_OP_POLL_ADD;
+                        sqe->fd          = src_fd;
+                        sqe->poll_events = POLLIN;
+                        sqe->flags       = IOSQE_IO_LINK;
+                        sqe->user_data   = URING_UD(URING_OP_POLL, i);
+                        polls++;
+                    }
+                    else if(res < 0)
+                    {
+                        failed = 1;
+                        break;
+                    }
+                    else if(res == 0)
+                    {
+                        if(seekable && sl->roff + sl->have < end)
+                            failed = 1; /* source shrank under us */
+                        else
+                        {
+                            eof       = 1;
+                            sl->state = sl->have ? URING_SLOT_READY
+                                                 : URING_SLOT_FREE;
+                        }
+                        break;
+                    }
+                    else
+                    {
+                        sl->have += (uint32_t)res;
+                        if(!seekable || sl->have == sl->want)
+                        {
+                            sl->state = URING_SLOT_READY;
+                            break;
+                        }
+                    }
+                    /* retry / finish a short read of a seekable source */
+                    if(ingest_sq_room(r, 1, &last_write) != 0)
+                    {
+                        failed = 1;
+                        break;
+                    }
+                    sqe            = uring_get_sqe(r);
+                    sqe->opcode    = IORING_OP_READ_FIXED;
+                    sqe->fd        = src_fd;
+                    sqe->addr      = (uint64_t)(uintptr_t)(ir->buf +
+                                                      (size_t)i *
+                                                          CRYPTO_URING_BUFSZ +
+                                                      sl->have);
+                    sqe->len       = sl->want - sl->have;
+                    sqe->off       = seekable ? sl->roff + sl->have
+                                              : (uint64_t)-1;
+                    sqe->buf_index = (uint16_t)i;
+                    sqe->user_data = URING_UD(URING_OP_READ, i);
+                    reads++;
+                    break;
+
+                case URING_OP_WRITE:
+                    writes--;
+                    if(res < 0 && res != -EINTR && res != -EAGAIN)
+                    {
+                        failed = 1;
+                        break;
+                    }
+                    if(res > 0)
+                        sl->wdone += (uint32_t)res;
+                    if(sl->wdone == sl->have)
+                    {
+                        sl->state = URING_SLOT_FREE;
+                        break;
+                    }
+                    if(ingest_sq_room(r, 1, &last_write) != 0)
+                    {
+                        failed = 1;
+                        break;
+                    }
+                    sqe            = uring_get_sqe(r);
+                    sqe->opcode    = IORING_OP_WRITE_FIXED;
+                    sqe->fd        = tmpfd;
+                    sqe->addr      = (uint64_t)(uintptr_t)(ir->buf +
+                                                      (size_t)i *
+                                                          CRYPTO_URING_BUFSZ +
+                                                      sl->wdone);
+                    sqe->len       = sl->have - sl->wdone;
+                    sqe->off       = sl->woff + sl->wdone;
+                    sqe->buf_index = (uint16_t)i;
+                    sqe->user_data = URING_UD(URING_OP_WRITE, i);
+                    writes++;
+                    dirty = sync;
+                    break;
+
+                case URING_OP_FSYNC:
+                    fsyncs--;
+                    if(res == -ECANCELED)
+                        dirty = 1; /* linked write was short: sync again */
+                    else if(res < 0)
+                        failed = 1;
+                    break;
+
+                default:
+                    failed = 1;
+                    break;
+            }
+        }
+        if(failed)
+            break;
+    }
+
+    int rc = -1;
+    if(failed)
+    {
+        /* Ops may still reference the buffers: tear the ring down. */
+        ingest_ring_drop();
+        (void)crypt_digest_end(ctx, NULL);
+    }
+    else if(crypt_digest_end(ctx, out) == 0)
+    {
+        if(seekable)
+            (void)lseek(src_fd, (off_t)(start + woff), SEEK_SET);
+        if(size_out)
+            *size_out = (size_t)woff;
+        rc = 0;
+    }
+    return rc;
+}
+
+static int ingest_sq_room(Uring* r, unsigned n,
+                          struct io_uring_sqe** last_write)
+{
+    if(uring_sq_space(r) >= n)
+        return 0;
+    if(uring_submit_and_wait(r, 0) < 0)
+        return -1;
+    *last_write = NULL;
+    return uring_sq_space(r) >= n ? 0 : -1;
+}
+
+static IngestRing* ingest_ring_get(void)
+{
+    if(atomic_load(&g_uring_broken))
+        return NULL;
+    pthread_once(&g_ring_once, ingest_ring_key_init);
+    if(!g_ring_key_ok)
+        return NULL;
+
+    IngestRing* ir = pthread_getspecific(g_ring_key);
+    if(ir)
+        return ir;
+
+    /* each ring pins QD * BUFSZ bytes: bound how many exist at once */
+    if(atomic_fetch_add(&g_uring_rings, 1) >= CRYPTO_URING_RINGS)
+    {
+        atomic_fetch_sub(&g_uring_rings, 1);
+        return NULL;
+    }
+    ir = calloc(1, sizeof *ir);
+    if(!ir)
+    {
+        atomic_fetch_sub(&g_uring_rings, 1);
+        return NULL;
+    }
+    size_t bytes = (size_t)CRYPTO_URING_QD * CRYPTO_URING_BUFSZ;
+    ir->buf      = mmap(NULL, bytes, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(ir->buf == MAP_FAILED)
+    {
+        free(ir);
+        atomic_fetch_sub(&g_uring_rings, 1);
+        return NULL;
+    }
+
+    /* room for a poll+read or a write per slot, plus the fsync */
+    int rc = uring_init(&ir->ring, 2 * CRYPTO_URING_QD + 2);
+    if(rc == 0)
+    {
+        struct iovec iov[CRYPTO_URING_QD];
+        for(unsigned i = 0; i < CRYPTO_URING_QD; ++i)
+        {
+            iov[i].iov_base = ir->buf + (size_t)i * CRYPTO_URING_BUFSZ;
+            iov[i].iov_len  = CRYPTO_URING_BUFSZ;
+        }
+        rc = uring_register_buffers(&ir->ring, iov, CRYPTO_URING_QD);
+        if(rc != 0)
+            uring_exit(&ir->ring);
+    }
+    if(rc != 0)
+    {
+        /* no io_uring in this process: stop probing. Anything else
+           (ENOMEM, memlock limits) may be transient or caused by other
+           rings; this call falls back and a later one tries again. */
+        if(rc == -ENOSYS || rc == -EPERM)
+            atomic_store(&g_uring_broken, 1);
+        munmap(ir->buf, bytes);
+        free(ir);
+        atomic_fetch_sub(&g_uring_rings, 1);
+        return NULL;
+    }
+
+    if(pthread_setspecific(g_ring_key, ir) != 0)
+    {
+        ingest_ring_free(ir);
+        return NULL;
+    }
+    return ir;
+}
+
+static void ingest_ring_drop(void)
+{
+    IngestRing* ir = pthread_getspecific(g_ring_key);
+    if(!ir)
+        return;
+    (void)pthread_setspecific(g_ring_key, NULL);
+    ingest_ring_free(ir);
+}
+
+static void ingest_ring_free(void* p)
+{
+    IngestRing* ir = (IngestRing*)p;
+    if(!ir)
+        return;
+    uring_exit(&ir->ring);
+    munmap(ir->buf, (size_t)CRYPTO_URING_QD * CRYPTO_URING_BUFSZ);
+    free(ir);
+    atomic_fetch_sub(&g_uring_rings, 1);
+}
+
+static void ingest_ring_key_init(void)
+{
+    g_ring_key_ok = pthread_key_create(&g_ring_key, ingest_ring_free) == 0;
+}
+#endif
+
+static int copy_and_digest_threaded(int src_fd, int tmpfd, Sha256* out,
+                                    size_t* size_out)
+{
+    WriteBehind wb;
+    memset(&wb, 0, sizeof wb);
+    wb.fd  = tmpfd;
+    wb.buf = malloc((size_t)CRYPTO_WB_SLOTS * CRYPTO_URING_BUFSZ);
+    if(!wb.buf)
+        return 1;
+    if(pthread_mutex_init(&wb.mu, NULL) != 0)
+    {
+        free(wb.buf);
+        return 1;
+    }
+    if(pthread_cond_init(&wb.cv, NULL) != 0)
+    {
+        pthread_mutex_destroy(&wb.mu);
+        free(wb.buf);
+        return 1;
+    }
+    pthread_t writer;
+    if(pthread_create(&writer, NULL, write_behind_main, &wb) != 0)
+    {
+        pthread_cond_destroy(&wb.cv);
+        pthread_mutex_destroy(&wb.mu);
+        free(wb.buf);
+        return 1;
+    }
+
+    int             rc    = -1;
+    size_t          total = 0;
+    CryptDigestCtx* ctx   = crypt_digest_begin();
+    if(!ctx)
+        goto stop;
+
+    for(;;)
+    {
+        /* wait for a free slot */
+        pthread_mutex_lock(&wb.mu);
+        while(wb.tail - wb.head == CRYPTO_WB_SLOTS && !wb.err)
+            pthread_cond_wait(&wb.cv, &wb.mu);
+        int      werr = wb.err;
+        unsigned slot = wb.tail % CRYPTO_WB_SLOTS;
+        pthread_mutex_unlock(&wb.mu);
+        if(werr)
+            goto stop;
+
+        uint8_t* b  = wb.buf + (size_t)slot * CRYPTO_URING_BUFSZ;
+        ssize_t  rd = read(src_fd, b, CRYPTO_URING_BUFSZ);
+        if(rd == 0)
+            break;
+        if(rd < 0)
+        {
+            if(errno == EINTR)
+                continue;
+            if(errno == EAGAIN || errno == EWOULDBLOCK)
+            {
+                struct pollfd p  = {.fd = src_fd, .events = POLLIN};
+                int           pr = poll(&p, 1, -1);
+                if(pr > 0 || (pr < 0 && errno == EINTR))
+                    continue;
+            }
+            goto stop;
+        }
+        if(crypt_digest_update(ctx, b, (size_t)rd) != 0)
+            goto stop;
+        total += (size_t)rd;
+
+        pthread_mutex_lock(&wb.mu);
+        wb.len[slot] = (size_t)rd;
+        wb.tail++;
+        pthread_cond_broadcast(&wb.cv);
+        pthread_mutex_unlock(&wb.mu);
+    }
+    rc = 0;
+
+stop:
+    pthread_mutex_lock(&wb.mu);
+    wb.done = 1;
+    pthread_cond_broadcast(&wb.cv);
+    pthread_mutex_unlock(&wb.mu);
+    pthread_join(writer, NULL);
+    if(wb.err)
+        rc = -1;
+
+    if(crypt_digest_end(ctx, rc == 0 ? out : NULL) != 0)
+        rc = -1;
+    else if(rc == 0 && size_out)
+        *size_out = total;
+    pthread_cond_destroy(&wb.cv);
+    pthread_mutex_destroy(&wb.mu);
+    free(wb.buf);
+    return rc;
+}
+
+static void* write_behind_main(void* arg)
+{
+    WriteBehind* wb = (WriteBehind*)arg;
+    pthread_mutex_lock(&wb->mu);
+    for(;;)
+    {
+        while(wb->head == wb->tail && !wb->done)
+            pthread_cond_wait(&wb->cv, &wb->mu);
+        if(wb->head == wb->tail)
+            break; /* done and drained */
+        unsigned slot = wb->head % CRYPTO_WB_SLOTS;
+        size_t   len  = wb->len[slot];
+        pthread_mutex_unlock(&wb->mu);
+
+        const uint8_t* b   = wb->buf + (size_t)slot * CRYPTO_URING_BUFSZ;
+        size_t         off = 0;
+        int            err = 0;
+        while(off < len)
+        {
+            ssize_t wr = write(wb->fd, b + off, len - off);
+            if(wr > 0)
+                off += (size_t)wr;
+            else if(wr < 0 && errno == EINTR)
+                continue;
+            else
+            {
+                err = 1;
+                break;
+            }
+        }
+
+        pthread_mutex_lock(&wb->mu);
+        wb->head++;
+        if(err)
+        {
+            wb->err = 1;
+            pthread_cond_broadcast(&wb->cv);
+            break;
+        }
+        pthread_cond_broadcast(&wb->cv);
+    }
+    pthread_mutex_unlock(&wb->mu);
+    return NULL;
+}
+
+static int copy_and_digest_stream(int src_fd, int tmpfd, Sha256* out,
+                                  size_t* size_out)
+{
+    CryptDigestCtx* ctx = crypt_digest_begin();
+    if(!ctx)
+        return -1;
+    int rc = -1;
+
+    uint8_t buf[CRYPTO_READ_BUFSZ];
+    size_t  total = 0;
+
+    for(;;)
+    {
+        ssize_t rd = read(src_fd, buf, sizeof buf);
+        if(rd > 0)
+        {
+            ssize_t off = 0;
+            while(off < rd)
+            {
+                ssize_t wr = write(tmpfd, buf + off, (size_t)(rd - off));
+                if(wr > 0)
+                    off += wr;
+                else if(wr < 0 && errno == EINTR)
+                    continue;
+                else
+                    goto done;
+            }
+            if(crypt_digest_update(ctx, buf, (size_t)rd) != 0)
+                goto done;
+            total += (size_t)rd;
+            continue;
+        }
+        if(rd == 0)
+            break;
+        if(errno == EINTR)
+            continue;
+        if(errno == EAGAIN || errno == EWOULDBLOCK)
+        {
+            struct pollfd p  = {.fd = src_fd, .events = POLLIN};
+            int           pr = poll(&p, 1, -1);
+            if(pr > 0 || (pr < 0 && errno == EINTR))
+                continue;
+        }
+        goto done;
+    }
+
+    rc = crypt_digest_end(ctx, out);
+    ctx = NULL;
+    if(rc == 0 && size_out)
+        *size_out = total;
+done:
+    (void)crypt_digest_end(ctx, NULL);
+    return rc;
+}
+
+static int copy_and_digest_regular(int src_fd, const struct stat* sst,
+                                   int tmpfd, Sha256* out, size_t* size_out)
+{
+    off_t off = lseek(src_fd, 0, SEEK_CUR);
+    if(off == (off_t)-1 || sst->st_size <= off)
+        return 1; /* odd offset or empty tail: the stream loop handles it */
+
+    size_t len    = (size_t)(sst->st_size - off);
+    int    cloned = 0;
+
+#if defined(FICLONE)
+    /* Whole-file reflink: shares extents, no data is moved at all. */
+    if(off == 0 && ioctl(tmpfd, FICLONE, src_fd) == 0)
+        cloned = 1;
+#endif
+
+    if(!cloned)
+    {
+        loff_t in_off = off;
+        size_t left   = len;
+        while(left > 0)
+        {
+            ssize_t n = copy_file_range(src_fd, &in_off, tmpfd, NULL, left, 0);
+            if(n > 0)
+            {
+                left -= (size_t)n;
+                continue;
+            }
+            if(n < 0 && errno == EINTR)
+                continue;
+            if(n == 0)
+                break; /* source shrank under us; hash what we got */
+            if(left == len &&
+               (errno == EXDEV || errno == EOPNOTSUPP || errno == ENOSYS ||
+                errno == EINVAL || errno == EBADF))
+            {
+                if(ftruncate(tmpfd, 0) != 0)
+                    return -1;
+                return 1; /* nothing copied: fall back to the stream loop */
+            }
+            return -1;
+        }
+    }
+
+    /* Hash what actually landed in the temp so digest and bytes always agree,
+       even if the source is modified concurrently. */
+    struct stat tst;
+    if(fstat(tmpfd, &tst) != 0)
+        return -1;
+    size_t stored = (size_t)tst.st_size;
+    if(digest_mapped(tmpfd, stored, out) != 0)
+        return -1;
+
+    /* Behave like read(): the consumed range is behind the file offset. */
+    (void)lseek(src_fd, off + (off_t)stored, SEEK_SET);
+    if(size_out)
+        *size_out = stored;
+    return 0;
+}
 
-    char tmpdir[2048];
-    if(snprintf(tmpdir, sizeof tmpdir, "%s/objects/sha256", root) >=
-       (int)sizeof tmpdir)
+static int digest_mapped(int fd, size_t len, Sha256* out)
+{
+    CryptHash alg = crypt_content_hash();
+    if(len == 0)
     {
-        errno = ENAMETOOLONG;
-        return -1;
+        (void)lseek(fd, 0, SEEK_SET);
+        return digest_fd(fd, alg, out, NULL);
+    }
+    uint8_t* map = mmap(NULL, len, PROT_READ, MAP_SHARED, fd, 0);
+    if(map == MAP_FAILED)
+    {
+        if(lseek(fd, 0, SEEK_SET) == (off_t)-1)
+            return -1;
+        return digest_fd(fd, alg, out, NULL);
+    }
+    (void)madvise(map, len, MADV_SEQUENTIAL);
+    if(alg == CRYPT_HASH_BLAKE3)
+    {
+        /* the whole file is in reach: its subtrees go to every core */
+        crypt_blake3(map, len, 0, out->b);
+        munmap(map, len);
+        return 0;
     }
-    if(mkdir_p(tmpdir, 0770) != 0 && errno != EEXIST)
-        return -1;
-
-    char tmp_path[PATH_MAX];
-    int  tmpfd = make_tmp_in_dir(tmpdir, tmp_path);
-    if(tmpfd < 0)
-        return -1;
 
+    int         rc  = -1;
     EVP_MD_CTX* ctx = EVP_MD_CTX_new();
     if(!ctx)
-    {
-        close(tmpfd);
-        unlink(tmp_path);
-        return -1;
-    }
+        goto unmap;
     if(EVP_DigestInit_ex(ctx, EVP_sha256(), NULL) != 1)
+        goto done;
+    for(size_t pos = 0; pos < len; pos += CRYPTO_MAP_STEP)
     {
-        EVP_MD_CTX_free(ctx);
-        close(tmpfd);
-        unlink(tmp_path);
-        return -1;
+        size_t n = len - pos < CRYPTO_MAP_STEP ? len - pos : CRYPTO_MAP_STEP;
+        if(EVP_DigestUpdate(ctx, map + pos, n) != 1)
+            goto done;
     }
+    unsigned int outlen = 0;
+    if(EVP_DigestFinal_ex(ctx, out->b, &outlen) == 1 && outlen == 32)
+        rc = 0;
+done:
+    EVP_MD_CTX_free(ctx);
+unmap:
+    munmap(map, len);
+    return rc;
+}
+
+static int digest_fd(int fd, CryptHash alg, Sha256* out, size_t* size_out)
+{
+    if(!out)
+        return -1;
+    CryptDigestCtx* ctx = digest_begin(alg);
+    if(!ctx)
+        return -1;
+    int rc = -1;
 
     uint8_t buf[CRYPTO_READ_BUFSZ];
     size_t  total = 0;
 
     for(;;)
     {
-        ssize_t rd = read(src_fd, buf, sizeof buf);
+        ssize_t rd = read(fd, buf, sizeof buf);
         if(rd > 0)
         {
-            ssize_t off = 0;
-            while(off < rd)
-            {
-                ssize_t wr = write(tmpfd, buf + off, (size_t)(rd - off));
-                if(wr > 0)
-                    off += wr;
-                else if(wr < 0 && errno == EINTR)
-                    continue;
-                else
-                {
-                    EVP_MD_CTX_free(ctx);
-                    close(tmpfd);
-                    unlink(tmp_path);
-                    return -1;
-                }
-            }
-            if(EVP_DigestUpdate(ctx, buf, (size_t)rd) != 1)
-            {
-                EVP_MD_CTX_free(ctx);
-                close(tmpfd);
-                unlink(tmp_path);
-                return -1;
-            }
+            if(crypt_digest_update(ctx, buf, (size_t)rd) != 0)
+                goto done;
             total += (size_t)rd;
             continue;
         }
         if(rd == 0)
-            break;
+            break;  // EOF
         if(rd < 0)
         {
             if(errno == EINTR)
                 continue;
             if(errno == EAGAIN || errno == EWOULDBLOCK)
             {
-                struct pollfd p  = {.fd = src_fd, .events = POLLIN};
+                struct pollfd p  = {.fd = fd, .events = POLLIN};
                 int           pr = poll(&p, 1, -1);
                 if(pr > 0 || (pr < 0 && errno == EINTR))
                     continue;
             }
-            EVP_MD_CTX_free(ctx);
-            close(tmpfd);
-            unlink(tmp_path);
-            return -1;
+            goto done;
         }
     }
 
-    unsigned int outlen = 0;
-    Sha256       d      = {0};
-    if(EVP_DigestFinal_ex(ctx, d.b, &outlen) != 1 || outlen != 32)
-    {
-        EVP_MD_CTX_free(ctx);
-        close(tmpfd);
-        unlink(tmp_path);
-        return -1;
-    }
-    EVP_MD_CTX_free(ctx);
+    rc  = crypt_digest_end(ctx, out);
+    ctx = NULL;
+    if(rc == 0 && size_out)
+        *size_out = total;
+done:
+    (void)crypt_digest_end(ctx, NULL);
+    return rc;
+}
 
-    if(fsync(tmpfd) != 0)
-    {
-        close(tmpfd);
-        unlink(tmp_path);
+static int digest_fd_range(int fd, off_t off, size_t len, CryptHash alg,
+                           Sha256* out)
+{
+    if(fd < 0 || off < 0 || !out)
         return -1;
-    }
-    close(tmpfd);
 
-    if(publish_or_discard(root, &d, tmp_path) != 0)
+    CryptDigestCtx* ctx = digest_begin(alg);
+    if(!ctx)
         return -1;
+    int rc = -1;
 
-    if(digest_out)
-        *digest_out = d;
-    if(size_out)
-        *size_out = total;
-    return 0;
+    if(len > 0)
+    {
+        (void)posix_fadvise(fd, off, (off_t)len, POSIX_FADV_SEQUENTIAL);
+        (void)posix_fadvise(fd, off, (off_t)len, POSIX_FADV_WILLNEED);
+
+        /* map from the page containing 'off' */
+        long     pg   = sysconf(_SC_PAGESIZE);
+        off_t    base = pg > 0 ? off - off % pg : off;
+        size_t   skew = (size_t)(off - base);
+        uint8_t* map  = mmap(NULL, len + skew, PROT_READ, MAP_SHARED, fd, base);
+        if(map != MAP_FAILED)
+        {
+            (void)madvise(map, len + skew, MADV_SEQUENTIAL);
+            if(alg == CRYPT_HASH_BLAKE3)
+            {
+                /* all of it mapped: hash the subtrees on every core */
+                crypt_blake3(map + skew, len, 0, out->b);
+                munmap(map, len + skew);
+                (void)crypt_digest_end(ctx, NULL);
+                return 0;
+            }
+            int ok = 1;
+            for(size_t pos = 0; pos < len && ok; pos += CRYPTO_MAP_STEP)
+            {
+                size_t n = len - pos < CRYPTO_MAP_STEP ? len - pos
+                                                       : CRYPTO_MAP_STEP;
+                ok = crypt_digest_update(ctx, map + skew + pos, n) == 0;
+            }
+            munmap(map, len + skew);
+            if(!ok)
+                goto done;
+        }
+        else
+        {
+            uint8_t buf[CRYPTO_READ_BUFSZ];
+            size_t  pos = 0;
+            while(pos < len)
+            {
+                size_t  want = len - pos < sizeof buf ? len - pos : sizeof buf;
+                ssize_t rd   = pread(fd, buf, want, off + (off_t)pos);
+                if(rd < 0 && errno == EINTR)
+                    continue;
+                if(rd <= 0)
+                    goto done; /* error or file shrank */
+                if(crypt_digest_update(ctx, buf, (size_t)rd) != 0)
+                    goto done;
+                pos += (size_t)rd;
+            }
+        }
+    }
+
+    rc  = crypt_digest_end(ctx, out);
+    ctx = NULL;
+done:
+    (void)crypt_digest_end(ctx, NULL);
+    return rc;
 }
 
-/* hex */
-void crypt_sha256_hex(const Sha256* d, char out[65])
+static CryptDigestCtx* digest_begin(CryptHash alg)
 {
-    static const char* H = "0123456789abcdef";
-    for(int i = 0; i < 32; ++i)
+    CryptDigestCtx* c = malloc(sizeof *c);
+    if(!c)
+        return NULL;
+    c->alg = alg;
+    if(alg == CRYPT_HASH_SHA256)
+        c->u.sha = crypt_sha256_begin();
+    else
+        c->u.b3 = crypt_blake3_begin();
+    if(alg == CRYPT_HASH_SHA256 ? !c->u.sha : !c->u.b3)
     {
-        out[i * 2]     = H[d->b[i] >> 4];
-        out[i * 2 + 1] = H[d->b[i] & 0xF];
+        free(c);
+        return NULL;
     }
-    out[64] = '\0';
+    return c;
 }
 
-int crypt_rand_bytes(void* buf, size_t n)
+static int copy_and_digest_codec(int src_fd, int regular, int tmpfd,
+                                 Sha256* out, size_t* size_out, int level)
 {
-    if(!buf && n)
+    off_t off = regular ? lseek(src_fd, 0, SEEK_CUR) : 0;
+    if(off == (off_t)-1)
+        return 1;
+
+    uint8_t* buf = malloc(CRYPTO_READ_BUFSZ > CRYPTO_CODEC_PROBE
+                              ? CRYPTO_READ_BUFSZ
+                              : CRYPTO_CODEC_PROBE);
+    if(!buf)
         return -1;
-    return RAND_bytes((unsigned char*)buf, (int)n) == 1 ? 0 : -1;
-}
 
-int crypt_sha256_fd(int fd, Sha256* out, size_t* size_out)
-{
-    off_t cur = lseek(fd, 0, SEEK_CUR);
-    if(cur != (off_t)-1)
-        (void)lseek(fd, 0, SEEK_SET);
-    int rc = digest_fd_evp(fd, out, size_out);
-    if(cur != (off_t)-1)
-        (void)lseek(fd, cur, SEEK_SET);
+    /* probe: does the first chunk compress? */
+    ssize_t pn = read_full(src_fd, buf, CRYPTO_CODEC_PROBE);
+    if(pn < 0)
+    {
+        free(buf);
+        return -1;
+    }
+    size_t zn   = 0;
+    int    good = pn > 0 &&
+               codec_deflate_probe(buf, (size_t)pn, level, &zn) == 0 &&
+               zn * 100 <= (size_t)pn * (100 - CRYPTO_CODEC_MIN_SAVING_PCT);
+    if(!good && regular)
+    {
+        free(buf);
+        return lseek(src_fd, off, SEEK_SET) == off ? 1 : -1;
+    }
+
+    int             rc    = -1;
+    size_t          total = 0;
+    uint64_t        zout  = 0;
+    CodecZ*         z     = good ? codec_deflate_open(level, tmpfd) : NULL;
+    CryptDigestCtx* ctx   = crypt_digest_begin();
+    if((good && !z) || !ctx)
+        goto done;
+
+    /* the probe bytes first, then the rest of the source */
+    ssize_t n = pn;
+    while(n > 0)
+    {
+        if(crypt_digest_update(ctx, buf, (size_t)n) != 0)
+            goto done;
+        if(z ? codec_deflate_write(z, buf, (size_t)n) != 0
+             : write_full(tmpfd, buf, (size_t)n) != 0)
+            goto done;
+        total += (size_t)n;
+        n = read_full(src_fd, buf, CRYPTO_READ_BUFSZ);
+    }
+    if(n < 0 || (z && codec_deflate_finish(z, &zout) != 0))
+        goto done;
+
+    if(z && regular && zout >= (uint64_t)total)
+    {
+        /* the tail did not compress: start over raw */
+        if(ftruncate(tmpfd, 0) == 0 && lseek(tmpfd, 0, SEEK_SET) == 0 &&
+           lseek(src_fd, off, SEEK_SET) == off)
+            rc = 1;
+        goto done;
+    }
+    rc  = crypt_digest_end(ctx, out);
+    ctx = NULL;
+    if(rc == 0 && size_out)
+        *size_out = total;
+done:
+    (void)crypt_digest_end(ctx, NULL);
+    codec_deflate_close(z);
+    free(buf);
     return rc;
 }
 
-int crypt_sha256_file(const char* path, Sha256* out, size_t* size_out)
+static int deflate_iov(const struct iovec* iov, int iovcnt, int tmpfd,
+                       int level)
 {
-    if(!path || !out)
+    uint64_t total = 0;
+    for(int i = 0; i < iovcnt; ++i)
+        total += iov[i].iov_len;
+    size_t pn = total < CRYPTO_CODEC_PROBE ? (size_t)total : CRYPTO_CODEC_PROBE;
+    if(pn == 0)
+        return 1;
+
+    /* probe: does the first chunk compress? (gathered: it may be split) */
+    uint8_t* probe = malloc(pn);
+    if(!probe)
         return -1;
-    int fd = open(path, O_RDONLY);
-    if(fd < 0)
+    size_t got = 0;
+    for(int i = 0; i < iovcnt && got < pn; ++i)
+    {
+        size_t take = iov[i].iov_len < pn - got ? iov[i].iov_len : pn - got;
+        memcpy(probe + got, iov[i].iov_base, take);
+        got += take;
+    }
+    size_t zn   = 0;
+    int    good = codec_deflate_probe(probe, pn, level, &zn) == 0 &&
+               zn * 100 <= pn * (100 - CRYPTO_CODEC_MIN_SAVING_PCT);
+    free(probe);
+    if(!good)
+        return 1;
+
+    CodecZ* z = codec_deflate_open(level, tmpfd);
+    if(!z)
         return -1;
-    int rc = digest_fd_evp(fd, out, size_out);
-    close(fd);
+    int      rc   = -1;
+    uint64_t zout = 0;
+    for(int i = 0; i < iovcnt; ++i)
+        if(iov[i].iov_len &&
+           codec_deflate_write(z, iov[i].iov_base, iov[i].iov_len) != 0)
+            goto done;
+    if(codec_deflate_finish(z, &zout) != 0)
+        goto done;
+    rc = 0;
+    if(zout >= total)
+    {
+        /* the tail did not compress: store it raw */
+        rc = ftruncate(tmpfd, 0) == 0 && lseek(tmpfd, 0, SEEK_SET) == 0 ? 1
+                                                                       : -1;
+    }
+done:
+    codec_deflate_close(z);
     return rc;
 }
 
-/* tmp file inside dir using openat + random name */
-static int make_tmp_in_dir(const char* tmpdir, char out_path[PATH_MAX])
+static unsigned sha_impl(void)
 {
-    int dfd = open(tmpdir, O_DIRECTORY | O_RDONLY);
-    if(dfd < 0)
-        return -1;
+    int v = atomic_load_explicit(&g_sha_impl, memory_order_relaxed);
+    if(v < 0)
+    {
+        int unset = -1;
+        (void)atomic_compare_exchange_strong(&g_sha_impl, &unset,
+                                             (int)sha256_simd_features());
+        v = atomic_load(&g_sha_impl);
+    }
+    return (unsigned)v;
+}
+
+static void sha256_compress(uint32_t h[8], const uint8_t* p, size_t nblk)
+{
+    if(!nblk)
+        return;
+    if(sha_impl() & CRYPT_SHA256_IMPL_SHANI)
+        sha256_blocks_shani(h, p, nblk);
+    else
+        sha256_blocks(h, p, nblk);
+}
 
-    for(int tries = 0; tries < 128; ++tries)
+static void sha256_many_lanes(size_t count, const void* const p[],
+                              const size_t n[], Sha256 out[], unsigned width)
+{
+    ShaLane        lane[SHA256_LANES_MAX];
+    uint32_t       st[8][SHA256_LANES_MAX];
+    const uint8_t* blk[SHA256_LANES_MAX];
+    int            busy[SHA256_LANES_MAX] = {0};
+    size_t         next   = 0;
+    unsigned       active = 0;
+
+    for(unsigned l = 0; l < width && next < count; ++l, ++next, ++active)
     {
-        unsigned char rnd[16];
-        if(crypt_rand_bytes(rnd, sizeof rnd) != 0)
-        {
-            close(dfd);
-            return -1;
-        }
+        sha_lane_load(&lane[l], st, l, next, p[next], n[next]);
+        busy[l] = 1;
+    }
 
-        char               name[64];
-        static const char* hex = "0123456789abcdef";
-        memcpy(name, ".ingest.", 8);
-        for(int i = 0; i < 16; ++i)
-        {
-            name[8 + i * 2] = hex[rnd[i] >> 4];
-            name[9 + i * 2] = hex[rnd[i] & 0xF];
-        }
-        name[8 + 32] = '\0';
+    /* Every step runs all lanes for the blocks the shortest segment has
+       left; idle lanes hash a busy lane's input and are ignored. Once the
+       queue is empty and half the lanes idle, the rest finish one by one. */
+    while(active && (next < count || active * 2 > width))
+    {
+        size_t         k   = SIZE_MAX;
+        const uint8_t* any = NULL;
+        for(unsigned l = 0; l < width; ++l)
+            if(busy[l] && lane[l].left < k)
+            {
+                k   = lane[l].left;
+                any = lane[l].p;
+            }
+        for(unsigned l = 0; l < width; ++l)
+            blk[l] = busy[l] ? lane[l].p : any;
+        if(width == 16)
+            sha256_x16_avx512(st, blk, k);
+        else
+            sha256_x8_avx2(st, blk, k);
 
-        int fd = openat(dfd, name, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0660);
-        if(fd >= 0)
+        for(unsigned l = 0; l < width; ++l)
         {
-            size_t dlen = strlen(tmpdir);
-            if(dlen >= PATH_MAX)
+            ShaLane* ln = &lane[l];
+            if(!busy[l])
+                continue;
+            ln->p += 64 * k;
+            ln->left -= k;
+            if(ln->left)
+                continue;
+            if(ln->ntail)
             {
-                close(fd);
-                close(dfd);
-                errno = ENAMETOOLONG;
-                return -1;
+                ln->p     = ln->tail;
+                ln->left  = ln->ntail;
+                ln->ntail = 0;
+                continue;
             }
-            if(dlen + 1 + strlen(name) + 1 >= PATH_MAX)
+            sha_digest_out(st, l, &out[ln->job]);
+            if(next < count)
             {
-                close(fd);
-                close(dfd);
-                errno = ENAMETOOLONG;
-                return -1;
+                sha_lane_load(ln, st, l, next, p[next], n[next]);
+                ++next;
+            }
+            else
+            {
+                busy[l] = 0;
+                --active;
             }
-            memcpy(out_path, tmpdir, dlen);
-            out_path[dlen] = '/';
-            strcpy(out_path + dlen + 1, name);
-            close(dfd);
-            return fd;
-        }
-        if(errno != EEXIST)
-        {
-            close(dfd);
-            return -1;
         }
     }
-    close(dfd);
-    errno = EEXIST;
-    return -1;
+
+    for(unsigned l = 0; l < width && active; ++l)
+    {
+        if(!busy[l])
+            continue;
+        uint32_t h[8];
+        for(int i = 0; i < 8; ++i)
+            h[i] = st[i][l];
+        sha256_compress(h, lane[l].p, lane[l].left);
+        sha256_compress(h, lane[l].tail, lane[l].ntail);
+        for(int i = 0; i < 8; ++i)
+            st[i][l] = h[i];
+        sha_digest_out(st, l, &out[lane[l].job]);
+    }
 }
 
-static int publish_or_discard(const char* root, const Sha256* d,
-                              const char* tmp_path)
+static void sha_lane_load(ShaLane* ln, uint32_t st[8][SHA256_LANES_MAX],
+                          unsigned l, size_t job, const uint8_t* p, size_t n)
 {
-    char hex[65];
-    crypt_sha256_hex(d, hex);
+    CryptSha256State iv;
+    crypt_sha256_state_init(&iv);
+    for(int i = 0; i < 8; ++i)
+        st[i][l] = iv.h[i];
+
+    /* tail: the last n % 64 bytes, 0x80, zeros, bit length big-endian */
+    size_t   rem   = n & 63u;
+    size_t   ntail = rem < 56 ? 1 : 2;
+    uint64_t bits  = (uint64_t)n << 3;
+    memset(ln->tail, 0, sizeof ln->tail);
+    if(rem)
+        memcpy(ln->tail, p + (n - rem), rem);
+    ln->tail[rem] = 0x80;
+    for(int i = 0; i < 8; ++i)
+        ln->tail[ntail * 64 - 1 - (size_t)i] = (uint8_t)(bits >> (8 * i));
 
-    char sharddir[2048];
-    if(snprintf(sharddir, sizeof sharddir, "%s/objects/sha256/%.2s/%.2s", root,
-                hex, hex + 2) >= (int)sizeof sharddir)
+    ln->job = job;
+    if(n / 64)
     {
-        unlink(tmp_path);
-        errno = ENAMETOOLONG;
-        return -1;
+        ln->p     = p;
+        ln->left  = n / 64;
+        ln->ntail = ntail;
     }
-    if(mkdir_p(sharddir, 0770) != 0 && errno != EEXIST)
+    else
     {
-        unlink(tmp_path);
-        return -1;
+        ln->p     = ln->tail;
+        ln->left  = ntail;
+        ln->ntail = 0;
     }
+}
 
-    char final_path[2048];
-    if(path_sha256(final_path, sizeof final_path, root, hex) < 0)
+static void sha_digest_out(const uint32_t st[8][SHA256_LANES_MAX], unsigned l,
+                           Sha256* out)
+{
+    for(int i = 0; i < 8; ++i)
     {
-        unlink(tmp_path);
-        return -1;
+        out->b[i * 4]     = (uint8_t)(st[i][l] >> 24);
+        out->b[i * 4 + 1] = (uint8_t)(st[i][l] >> 16);
+        out->b[i * 4 + 2] = (uint8_t)(st[i][l] >> 8);
+        out->b[i * 4 + 3] = (uint8_t)st[i][l];
     }
+}
 
-    struct stat st;
-    if(stat(final_path, &st) == 0)
-    {
-        unlink(tmp_path);
-        return 0;
-    }  // dedup
-
-    if(rename(tmp_path, final_path) == 0)
-        return 0;
-    if(link(tmp_path, final_path) == 0)
+static void sha256_blocks(uint32_t h[8], const uint8_t* p, size_t nblk)
+{
+#define ROR(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+    for(; nblk; --nblk, p += 64)
     {
-        unlink(tmp_path);
-        return 0;
+        uint32_t w[64];
+        for(int i = 0; i < 16; ++i)
+            w[i] = (uint32_t)p[i * 4] << 24 | (uint32_t)p[i * 4 + 1] << 16 |
+                   (uint32_t)p[i * 4 + 2] << 8 | (uint32_t)p[i * 4 + 3];
+        for(int i = 16; i < 64; ++i)
+        {
+            uint32_t s0 = ROR(w[i - 15], 7) ^ ROR(w[i - 15], 18) ^
+                          (w[i - 15] >> 3);
+            uint32_t s1 = ROR(w[i - 2], 17) ^ ROR(w[i - 2], 19) ^
+                          (w[i - 2] >> 10);
+            w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+        }
+        uint32_t a = h[0], b = h[1], c = h[2], d = h[3];
+        uint32_t e = h[4], f = h[5], g = h[6], k = h[7];
+        for(int i = 0; i < 64; ++i)
+        {
+            uint32_t t1 = k + (ROR(e, 6) ^ ROR(e, 11) ^ ROR(e, 25)) +
+                          ((e & f) ^ (~e & g)) + crypt_sha256_k[i] + w[i];
+            uint32_t t2 = (ROR(a, 2) ^ ROR(a, 13) ^ ROR(a, 22)) +
+                          ((a & b) ^ (a & c) ^ (b & c));
+            k = g;
+            g = f;
+            f = e;
+            e = d + t1;
+            d = c;
+            c = b;
+            b = a;
+            a = t1 + t2;
+        }
+        h[0] += a;
+        h[1] += b;
+        h[2] += c;
+        h[3] += d;
+        h[4] += e;
+        h[5] += f;
+        h[6] += g;
+        h[7] += k;
     }
-    unlink(tmp_path);
-    return -1;
+#undef ROR
 }
 
-static int digest_fd_evp(int fd, Sha256* out, size_t* size_out)
+static ssize_t read_full(int fd, uint8_t* buf, size_t n)
 {
-    if(!out)
-        return -1;
-    EVP_MD_CTX* ctx = EVP_MD_CTX_new();
-    if(!ctx)
-        return -1;
-    int rc = -1;
-    if(EVP_DigestInit_ex(ctx, EVP_sha256(), NULL) != 1)
-        goto done;
-
-    uint8_t buf[CRYPTO_READ_BUFSZ];
-    size_t  total = 0;
-
-    for(;;)
+    size_t got = 0;
+    while(got < n)
     {
-        ssize_t rd = read(fd, buf, sizeof buf);
+        ssize_t rd = read(fd, buf + got, n - got);
         if(rd > 0)
         {
-            if(EVP_DigestUpdate(ctx, buf, (size_t)rd) != 1)
-                goto done;
-            total += (size_t)rd;
+            got += (size_t)rd;
             continue;
         }
         if(rd == 0)
-            break;  // EOF
-        if(rd < 0)
+            break;
+        if(errno == EINTR)
+            continue;
+        if(errno == EAGAIN || errno == EWOULDBLOCK)
         {
-            if(errno == EINTR)
+            struct pollfd p  = {.fd = fd, .events = POLLIN};
+            int           pr = poll(&p, 1, -1);
+            if(pr > 0 || (pr < 0 && errno == EINTR))
                 continue;
-            if(errno == EAGAIN || errno == EWOULDBLOCK)
-            {
-                struct pollfd p  = {.fd = fd, .events = POLLIN};
-                int           pr = poll(&p, 1, -1);
-                if(pr > 0 || (pr < 0 && errno == EINTR))
-                    continue;
-            }
-            goto done;
         }
+        return -1;
     }
+    return (ssize_t)got;
+}
 
-    unsigned int outlen = 0;
-    if(EVP_DigestFinal_ex(ctx, out->b, &outlen) != 1 || outlen != 32)
-        goto done;
-    if(size_out)
-        *size_out = total;
-    rc = 0;
-done:
-    EVP_MD_CTX_free(ctx);
-    return rc;
-}
\ No newline at end of file
+static int write_full(int fd, const uint8_t* buf, size_t n)
+{
+    size_t off = 0;
+    while(off < n)
+    {
+        ssize_t wr = write(fd, buf + off, n - off);
+        if(wr > 0)
+            off += (size_t)wr;
+        else if(wr < 0 && errno == EINTR)
+            continue;
+        else
+            return -1;
+    }
+    return 0;
+}
+
+static int pwritev_full(int fd, const struct iovec* iov, int iovcnt)
+{
+    struct iovec v[CRYPTO_IOV_BATCH];
+    off_t        off  = 0;
+    int          at   = 0;
+    size_t       skip = 0; /* bytes of iov[at] already written */
+    while(at < iovcnt)
+    {
+        int    n    = 0;
+        size_t want = 0;
+        for(int i = at; i < iovcnt && n < CRYPTO_IOV_BATCH; ++i, ++n)
+        {
+            size_t done   = i == at ? skip : 0;
+            v[n].iov_base = (uint8_t*)iov[i].iov_base + done;
+            v[n].iov_len  = iov[i].iov_len - done;
+            want += v[n].iov_len;
+        }
+        ssize_t wr = want ? pwritev(fd, v, n, off) : 0;
+        if(wr < 0 && errno == EINTR)
+            continue;
+        if(wr < 0 || (wr == 0 && want))
+            return -1;
+        off += wr;
+
+        size_t left = (size_t)wr;
+        while(at < iovcnt && left >= iov[at].iov_len - skip)
+        {
+            left -= iov[at].iov_len - skip;
+            ++at;
+            skip = 0;
+        }
+        skip += left;
+    }
+    return 0;
+}
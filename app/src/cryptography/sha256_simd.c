@@ -0,0 +1,321 @@
+/**
+ * @file sha256_simd.c
+ * @brief SHA-256 compression with x86 extensions: SHA-NI for one stream,
+ *        AVX2 (8 lanes) and AVX-512 (16 lanes) for many independent ones.
+ *        Each kernel is compiled for its own target; sha256.c only calls
+ *        those sha256_simd_features() reports.
+ *
+ * @author  Roman Horshkov <roman.horshkov@gmail.com>
+ * @date    2025
+ * (c) 2025
+ */
+
+#include "cryptography/sha256_simd.h"
+#include "cryptography/sha256.h"
+
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#    define SHA256_X86 1
+#    include <cpuid.h>
+#    include <immintrin.h>
+#endif
+
+/****************************************************************************
+ * PUBLIC VARIABLES
+ ****************************************************************************
+ */
+
+const uint32_t crypt_sha256_k[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1,
+    0x923f82a4, 0xab1c5ed5, 0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+    0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174, 0xe49b69c1, 0xefbe4786,
+    0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147,
+    0x06ca6351, 0x14292967, 0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+    0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85, 0xa2bfe8a1, 0xa81a664b,
+    0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a,
+    0x5b9cca4f, 0x682e6ff3, 0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+    0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
+
+/****************************************************************************
+ * PRIVATE FUNCTIONS PROTOTYPES
+ ****************************************************************************
+ */
+
+#ifdef SHA256_X86
+/* Big-endian word at p (message words of one lane). */
+static inline int be32(const uint8_t* p);
+#endif
+
+/****************************************************************************
+ * PUBLIC FUNCTIONS DEFINITIONS
+ ****************************************************************************
+ */
+
+#ifdef SHA256_X86
+
+unsigned sha256_simd_features(void)
+{
+    unsigned f = 0;
+    unsigned a = 0, b = 0, c = 0, d = 0;
+    __builtin_cpu_init();
+    /* CPUID.(7,0):EBX bit 29 = SHA extensions; the kernel also shuffles
+       with SSSE3 and blends with SSE4.1 */
+    if(__get_cpuid_count(7, 0, &a, &b, &c, &d) && (b & (1u << 29)) &&
+       __builtin_cpu_supports("ssse3") && __builtin_cpu_supports("sse4.1"))
+        f |= CRYPT_SHA256_IMPL_SHANI;
+    /* __builtin_cpu_supports also checks that the OS saves the registers */
+    if(__builtin_cpu_supports("avx2"))
+        f |= CRYPT_SHA256_IMPL_AVX2;
+    if(__builtin_cpu_supports("avx512f"))
+        f |= CRYPT_SHA256_IMPL_AVX512;
+    return f;
+}
+
+__attribute__((target("sha,ssse3,sse4.1"))) void
+sha256_blocks_shani(uint32_t h[8], const uint8_t* p, size_t nblk)
+{
+    const __m128i BSWAP = _mm_set_epi64x(0x0c0d0e0f08090a0bULL,
+                                         0x0405060700010203ULL);
+
+    /* h[] as the ABEF / CDGH pairs the instructions work on */
+    __m128i tmp = _mm_loadu_si128((const __m128i*)&h[0]);
+    __m128i st1 = _mm_loadu_si128((const __m128i*)&h[4]);
+    tmp         = _mm_shuffle_epi32(tmp, 0xB1);       /* CDAB */
+    st1         = _mm_shuffle_epi32(st1, 0x1B);       /* EFGH */
+    __m128i st0 = _mm_alignr_epi8(tmp, st1, 8);       /* ABEF */
+    st1         = _mm_blend_epi16(st1, tmp, 0xF0);    /* CDGH */
+
+    for(; nblk; --nblk, p += 64)
+    {
+        __m128i abef = st0, cdgh = st1;
+        __m128i m[4];
+#    pragma GCC unroll 16
+        for(int i = 0; i < 16; ++i)
+        {
+            /* words 4i..4i+3 of the schedule, four rounds per step */
+            if(i < 4)
+                m[i] = _mm_shuffle_epi8(
+                    _mm_loadu_si128((const __m128i*)(p + 16 * i)), BSWAP);
+            else
+                m[i & 3] = _mm_sha256msg2_epu32(
+                    _mm_add_epi32(
+                        _mm_sha256msg1_epu32(m[i & 3], m[(i + 1) & 3]),
+                        _mm_alignr_epi8(m[(i + 3) & 3], m[(i + 2) & 3], 4)),
+                    m[(i + 3) & 3]);
+            __m128i msg = _mm_add_epi32(
+                m[i & 3],
+                _mm_loadu_si128((const __m128i*)&crypt_sha256_k[4 * i]));
+            st1 = _mm_sha256rnds2_epu32(st1, st0, msg);
+            msg = _mm_shuffle_epi32(msg, 0x0E);
+            st0 = _mm_sha256rnds2_epu32(st0, st1, msg);
+        }
+        st0 = _mm_add_epi32(st0, abef);
+        st1 = _mm_add_epi32(st1, cdgh);
+    }
+
+    tmp = _mm_shuffle_epi32(st0, 0x1B);    /* FEBA */
+    st1 = _mm_shuffle_epi32(st1, 0xB1);    /* DCHG */
+    st0 = _mm_blend_epi16(tmp, st1, 0xF0); /* DCBA */
+    st1 = _mm_alignr_epi8(st1, tmp, 8);    /* ABEF */
+    _mm_storeu_si128((__m128i*)&h[0], st0);
+    _mm_storeu_si128((__m128i*)&h[4], st1);
+}
+
+__attribute__((target("avx2"))) void
+sha256_x8_avx2(uint32_t st[8][SHA256_LANES_MAX],
+               const uint8_t* const blk[SHA256_LANES_MAX], size_t nblk)
+{
+#    define ROR(x, n) \
+        _mm256_or_si256(_mm256_srli_epi32(x, n), _mm256_slli_epi32(x, 32 - (n)))
+    __m256i h[8];
+    for(int j = 0; j < 8; ++j)
+        h[j] = _mm256_loadu_si256((const __m256i*)st[j]);
+
+    for(size_t b = 0; b < nblk; ++b)
+    {
+        const size_t o = b * 64;
+        __m256i      w[16];
+        for(int t = 0; t < 16; ++t)
+            w[t] = _mm256_setr_epi32(
+                be32(blk[0] + o + 4 * t), be32(blk[1] + o + 4 * t),
+                be32(blk[2] + o + 4 * t), be32(blk[3] + o + 4 * t),
+                be32(blk[4] + o + 4 * t), be32(blk[5] + o + 4 * t),
+                be32(blk[6] + o + 4 * t), be32(blk[7] + o + 4 * t));
+
+        __m256i a = h[0], bb = h[1], c = h[2], d = h[3];
+        __m256i e = h[4], f = h[5], g = h[6], k = h[7];
+#    pragma GCC unroll 64
+        for(int t = 0; t < 64; ++t)
+        {
+            if(t >= 16)
+            {
+                __m256i w15 = w[(t + 1) & 15], w2 = w[(t + 14) & 15];
+                __m256i s0  = _mm256_xor_si256(
+                    _mm256_xor_si256(ROR(w15, 7), ROR(w15, 18)),
+                    _mm256_srli_epi32(w15, 3));
+                __m256i s1 = _mm256_xor_si256(
+                    _mm256_xor_si256(ROR(w2, 17), ROR(w2, 19)),
+                    _mm256_srli_epi32(w2, 10));
+                w[t & 15] = _mm256_add_epi32(
+                    _mm256_add_epi32(w[t & 15], s0),
+                    _mm256_add_epi32(w[(t + 9) & 15], s1));
+            }
+            __m256i S1 = _mm256_xor_si256(_mm256_xor_si256(ROR(e, 6), ROR(e, 11)),
+                                          ROR(e, 25));
+            __m256i ch = _mm256_xor_si256(_mm256_and_si256(e, f),
+                                          _mm256_andnot_si256(e, g));
+            __m256i t1 = _mm256_add_epi32(
+                _mm256_add_epi32(_mm256_add_epi32(k, S1), ch),
+                _mm256_add_epi32(_mm256_set1_epi32((int)crypt_sha256_k[t]),
+                                 w[t & 15]));
+            __m256i S0 = _mm256_xor_si256(_mm256_xor_si256(ROR(a, 2), ROR(a, 13)),
+                                          ROR(a, 22));
+            __m256i mj = _mm256_or_si256(
+                _mm256_and_si256(a, bb),
+                _mm256_and_si256(c, _mm256_or_si256(a, bb)));
+            k  = g;
+            g  = f;
+            f  = e;
+            e  = _mm256_add_epi32(d, t1);
+            d  = c;
+            c  = bb;
+            bb = a;
+            a  = _mm256_add_epi32(t1, _mm256_add_epi32(S0, mj));
+        }
+        h[0] = _mm256_add_epi32(h[0], a);
+        h[1] = _mm256_add_epi32(h[1], bb);
+        h[2] = _mm256_add_epi32(h[2], c);
+        h[3] = _mm256_add_epi32(h[3], d);
+        h[4] = _mm256_add_epi32(h[4], e);
+        h[5] = _mm256_add_epi32(h[5], f);
+        h[6] = _mm256_add_epi32(h[6], g);
+        h[7] = _mm256_add_epi32(h[7], k);
+    }
+
+    for(int j = 0; j < 8; ++j)
+        _mm256_storeu_si256((__m256i*)st[j], h[j]);
+#    undef ROR
+}
+
+__attribute__((target("avx512f"))) void
+sha256_x16_avx512(uint32_t st[8][SHA256_LANES_MAX],
+                  const uint8_t* const blk[SHA256_LANES_MAX], size_t nblk)
+{
+    __m512i h[8];
+    for(int j = 0; j < 8; ++j)
+        h[j] = _mm512_loadu_si512((const void*)st[j]);
+
+    for(size_t b = 0; b < nblk; ++b)
+    {
+        const size_t o = b * 64;
+        __m512i      w[16];
+        for(int t = 0; t < 16; ++t)
+        {
+            int v[16];
+            for(int l = 0; l < 16; ++l)
+                v[l] = be32(blk[l] + o + 4 * t);
+            w[t] = _mm512_loadu_si512((const void*)v);
+        }
+
+        __m512i a = h[0], bb = h[1], c = h[2], d = h[3];
+        __m512i e = h[4], f = h[5], g = h[6], k = h[7];
+#    pragma GCC unroll 64
+        for(int t = 0; t < 64; ++t)
+        {
+            if(t >= 16)
+            {
+                __m512i w15 = w[(t + 1) & 15], w2 = w[(t + 14) & 15];
+                /* three-way XORs in one ternary-logic op (0x96) */
+                __m512i s0 = _mm512_ternarylogic_epi32(
+                    _mm512_ror_epi32(w15, 7), _mm512_ror_epi32(w15, 18),
+                    _mm512_srli_epi32(w15, 3), 0x96);
+                __m512i s1 = _mm512_ternarylogic_epi32(
+                    _mm512_ror_epi32(w2, 17), _mm512_ror_epi32(w2, 19),
+                    _mm512_srli_epi32(w2, 10), 0x96);
+                w[t & 15] = _mm512_add_epi32(
+                    _mm512_add_epi32(w[t & 15], s0),
+                    _mm512_add_epi32(w[(t + 9) & 15], s1));
+            }
+            __m512i S1 = _mm512_ternarylogic_epi32(
+                _mm512_ror_epi32(e, 6), _mm512_ror_epi32(e, 11),
+                _mm512_ror_epi32(e, 25), 0x96);
+            __m512i ch = _mm512_ternarylogic_epi32(e, f, g, 0xCA);
+            __m512i t1 = _mm512_add_epi32(
+                _mm512_add_epi32(_mm512_add_epi32(k, S1), ch),
+                _mm512_add_epi32(_mm512_set1_epi32((int)crypt_sha256_k[t]),
+                                 w[t & 15]));
+            __m512i S0 = _mm512_ternarylogic_epi32(
+                _mm512_ror_epi32(a, 2), _mm512_ror_epi32(a, 13),
+                _mm512_ror_epi32(a, 22), 0x96);
+            __m512i mj = _mm512_ternarylogic_epi32(a, bb, c, 0xE8);
+            k  = g;
+            g  = f;
+            f  = e;
+            e  = _mm512_add_epi32(d, t1);
+            d  = c;
+            c  = bb;
+            bb = a;
+            a  = _mm512_add_epi32(t1, _mm512_add_epi32(S0, mj));
+        }
+        h[0] = _mm512_add_epi32(h[0], a);
+        h[1] = _mm512_add_epi32(h[1], bb);
+        h[2] = _mm512_add_epi32(h[2], c);
+        h[3] = _mm512_add_epi32(h[3], d);
+        h[4] = _mm512_add_epi32(h[4], e);
+        h[5] = _mm512_add_epi32(h[5], f);
+        h[6] = _mm512_add_epi32(h[6], g);
+        h[7] = _mm512_add_epi32(h[7], k);
+    }
+
+    for(int j = 0; j < 8; ++j)
+        _mm512_storeu_si512((void*)st[j], h[j]);
+}
+
+#else /* !SHA256_X86: nothing to dispatch to, the kernels are never called */
+
+unsigned sha256_simd_features(void)
+{
+    return 0;
+}
+
+void sha256_blocks_shani(uint32_t h[8], const uint8_t* p, size_t nblk)
+{
+    (void)h;
+    (void)p;
+    (void)nblk;
+}
+
+void sha256_x8_avx2(uint32_t st[8][SHA256_LANES_MAX],
+                    const uint8_t* const blk[SHA256_LANES_MAX], size_t nblk)
+{
+    (void)st;
+    (void)blk;
+    (void)nblk;
+}
+
+void sha256_x16_avx512(uint32_t st[8][SHA256_LANES_MAX],
+                       const uint8_t* const blk[SHA256_LANES_MAX], size_t nblk)
+{
+    (void)st;
+    (void)blk;
+    (void)nblk;
+}
+
+#endif
+
+/****************************************************************************
+ * PRIVATE FUNCTIONS DEFINITIONS
+ ****************************************************************************
+ */
+
+#ifdef SHA256_X86
+static inline int be32(const uint8_t* p)
+{
+    uint32_t v;
+    memcpy(&v, p, 4);
+    return (int)__builtin_bswap32(v);
+}
+#endif
@@ -279,10 +279,11 @@ int acl_data_destroy(MDB_txn* txn, const uint8_t resource[DB_ID_SIZE])
                 (void)mdb_del(txn, DB->db_acl_fwd, &fk, NULL);
 
                 /* delete this exact reverse dup (current cursor item) */
-                if(mdb_cursor_del(cur, 0) != MDB_SUCCESS)
+                rc = mdb_cursor_del(cur, 0);
+                if(rc != MDB_SUCCESS)
                 {
                     mdb_cursor_close(cur);
-                    return -EIO;
+                    return rc == MDB_MAP_FULL ? rc : -EIO;
                 }
 
                 /* loop re-seeks to the same rkey until dupset is empty */
@@ -328,6 +329,8 @@ static int put_forward(MDB_txn* txn, const uint8_t principal[DB_ID_SIZE],
     MDB_val fk  = {.mv_size = sizeof k, .mv_data = k};
     MDB_val fv  = {.mv_size = 1, .mv_data = &one};
     int     mrc = mdb_put(txn, DB->db_acl_fwd, &fk, &fv, MDB_NOOVERWRITE);
+    if(mrc == MDB_MAP_FULL)
+        return mrc;
     if(mrc != MDB_SUCCESS && mrc != MDB_KEYEXIST)
         return db_map_mdb_err(mrc);
     return 0;
@@ -341,6 +344,8 @@ static int put_reverse(MDB_txn* txn, const uint8_t resource[DB_ID_SIZE],
     MDB_val rk  = {.mv_size = sizeof k, .mv_data = k};
     MDB_val rv  = {.mv_size = DB_ID_SIZE, .mv_data = (void*)principal};
     int     mrc = mdb_put(txn, DB->db_acl_rel, &rk, &rv, MDB_NODUPDATA);
+    if(mrc == MDB_MAP_FULL)
+        return mrc;
     if(mrc != MDB_SUCCESS && mrc != MDB_KEYEXIST)
         return db_map_mdb_err(mrc);
     return 0;
@@ -0,0 +1,510 @@
+/**
+ * @file db_chunk.c
+ * @brief
+ *
+ * @author  Roman Horshkov <roman.horshkov@gmail.com>
+ * @date    2025
+ * (c) 2025
+ */
+
+#include "db_chunk.h"
+
+#include <pthread.h>
+#include <sys/uio.h>
+
+/****************************************************************************
+ * PRIVATE DEFINES
+ ****************************************************************************
+ */
+/* None */
+
+/****************************************************************************
+ * PRIVATE STUCTURED VARIABLES
+ ****************************************************************************
+ */
+
+/* Cut-point parameters derived from the average chunk size */
+typedef struct
+{
+    size_t   min;    /* no cut before this many bytes */
+    size_t   avg;    /* switch from the strict to the loose mask here */
+    size_t   max;    /* forced cut */
+    uint64_t mask_s; /* below avg: harder to match */
+    uint64_t mask_l; /* past avg: easier to match */
+} ChunkParams;
+
+/* Input of chunk_ingest(): a descriptor, or the caller's memory */
+typedef struct
+{
+    int                 fd;  /* -1: read from iov */
+    const struct iovec* iov;
+    int                 iovcnt;
+    int                 at;    /* current segment */
+    size_t              off;   /* consumed bytes of iov[at] */
+    int                 known; /* *digest is already the object's digest */
+} ChunkSrc;
+
+/****************************************************************************
+ * PRIVATE VARIABLES
+ ****************************************************************************
+ */
+
+/* Gear table: one pseudo-random word per byte value, fixed for all time
+   (chunk boundaries, hence dedup, depend on it) */
+static uint64_t       GEAR[256];
+static pthread_once_t GEAR_ONCE = PTHREAD_ONCE_INIT;
+
+/****************************************************************************
+ * PRIVATE FUNCTIONS PROTOTYPES
+ ****************************************************************************
+ */
+
+static void gear_init(void);
+
+/* Cut the whole of 'src' (see chunk_ingest_fd). */
+static int chunk_ingest(ChunkSrc* src, size_t avg, Sha256* digest,
+                        size_t* size, ChunkList* out);
+
+/* Up to 'n' next bytes of 'src' into 'dst': count, 0 at the end, -1. */
+static ssize_t chunk_src_read(ChunkSrc* src, uint8_t* dst, size_t n);
+
+/* Length of the next chunk of p[0..n): FastCDC normalized chunking, the
+   rolling hash h = (h << 1) + GEAR[byte] tested against a strict mask up
+   to avg and a loose one up to max. n < max only at the end of input. */
+static size_t chunk_cut(const ChunkParams* cp, const uint8_t* p, size_t n);
+
+/* Hash one chunk and append it to 'cl'; appended to the open pack unless
+   its bytes are already packed (looked up through 'rtxn', reset between
+   calls). *saved += len when it was known. 0 or -EIO. */
+static int chunk_add(ChunkList* cl, MDB_txn* rtxn, const uint8_t* p,
+                     size_t len, uint64_t end, uint64_t* saved);
+
+/* Adjust the reference count of a chunk by +1/-1. *out_left = new count. */
+static int chunk_ref(MDB_txn* txn, const uint8_t sha[32], int delta,
+                     uint64_t* out_left);
+
+/****************************************************************************
+ * PUBLIC FUNCTIONS DEFINITIONS
+ ****************************************************************************
+ */
+
+int chunk_ingest_fd(int src_fd, size_t avg, Sha256* digest, size_t* size,
+                    ChunkList* out)
+{
+    memset(out, 0, sizeof *out);
+    if(src_fd < 0)
+        return -EIO;
+    ChunkSrc src = {.fd = src_fd};
+    return chunk_ingest(&src, avg, digest, size, out);
+}
+
+int chunk_ingest_iov(const struct iovec* iov, int iovcnt, size_t avg,
+                     int known, Sha256* digest, size_t* size,
+                     ChunkList* out)
+{
+    memset(out, 0, sizeof *out);
+    if(iovcnt < 0 || (iovcnt && !iov))
+        return -EIO;
+    ChunkSrc src = {.fd = -1, .iov = iov, .iovcnt = iovcnt, .known = known};
+    return chunk_ingest(&src, avg, digest, size, out);
+}
+
+void chunk_list_free(ChunkList* cl)
+{
+    if(!cl)
+        return;
+    pack_release(DB->packs, cl->locs, cl->n);
+    free(cl->refs);
+    free(cl->locs);
+    memset(cl, 0, sizeof *cl);
+}
+
+int chunk_manifest_put(MDB_txn* txn, const uint8_t sha[32],
+                       const ChunkList* cl)
+{
+    int mrc = MDB_SUCCESS;
+    for(size_t i = 0; i < cl->n && mrc == MDB_SUCCESS; ++i)
+    {
+        const uint8_t* csha = cl->refs[i].sha;
+        if(cl->locs[i].pack)
+            mrc = pack_index_put(txn, csha, &cl->locs[i]);
+        else
+        {
+            /* known at ingest: its bytes must still be there */
+            PackLoc loc;
+            mrc = pack_index_get(txn, csha, &loc);
+        }
+        if(mrc == MDB_SUCCESS)
+            mrc = chunk_ref(txn, csha, +1, NULL);
+    }
+    if(mrc != MDB_SUCCESS)
+        return mrc;
+
+    MDB_val k = {.mv_size = 32, .mv_data = (void*)sha};
+    MDB_val v = {.mv_size = cl->n * sizeof(ChunkRef), .mv_data = cl->refs};
+    return mdb_put(txn, DB->db_data_manifests, &k, &v, 0);
+}
+
+int chunk_manifest_release(MDB_txn* txn, const uint8_t sha[32])
+{
+    MDB_val k   = {.mv_size = 32, .mv_data = (void*)sha};
+    MDB_val v   = {0};
+    int     mrc = mdb_get(txn, DB->db_data_manifests, &k, &v);
+    if(mrc != MDB_SUCCESS)
+        return mrc;
+    if(v.mv_size % sizeof(ChunkRef) != 0)
+        return MDB_CORRUPTED;
+
+    /* the value may move under the writes below: work on a copy */
+    size_t    n    = v.mv_size / sizeof(ChunkRef);
+    ChunkRef* refs = malloc(v.mv_size ? v.mv_size : 1);
+    if(!refs)
+        return ENOMEM;
+    memcpy(refs, v.mv_data, v.mv_size);
+
+    for(size_t i = 0; i < n && mrc == MDB_SUCCESS; ++i)
+    {
+        uint64_t left = 0;
+        mrc           = chunk_ref(txn, refs[i].sha, -1, &left);
+        if(mrc != MDB_SUCCESS || left != 0)
+            continue;
+        /* a packed object with the same bytes keeps the extent */
+        MDB_val  ck = {.mv_size = 32, .mv_data = refs[i].sha};
+        DataMeta m;
+        if(db_data_sha_any_meta(txn, &ck, &m) == MDB_SUCCESS &&
+           (m.flags & DB_DATA_F_PACKED))
+            continue;
+        mrc = pack_index_del(txn, refs[i].sha);
+        if(mrc == MDB_NOTFOUND)
+            mrc = MDB_SUCCESS;
+    }
+    free(refs);
+    if(mrc != MDB_SUCCESS)
+        return mrc;
+    return mdb_del(txn, DB->db_data_manifests, &k, NULL);
+}
+
+int chunk_in_use(MDB_txn* txn, const uint8_t sha[32])
+{
+    MDB_val k = {.mv_size = 32, .mv_data = (void*)sha};
+    MDB_val v = {0};
+    return mdb_get(txn, DB->db_data_chunks, &k, &v) == MDB_SUCCESS;
+}
+
+int chunk_read(MDB_txn* txn, const uint8_t sha[32], uint64_t size,
+               uint64_t off, void* buf, size_t len)
+{
+    if(off > size || (uint64_t)len > size - off)
+        return -EINVAL;
+    size_t done = 0;
+    while(done < len)
+    {
+        ChunkSpan sp[16];
+        size_t    n  = 0;
+        int       rc = chunk_locate(txn, sha, size, off + done, sp, 16, &n);
+        if(rc != 0)
+            return rc;
+        if(n == 0)
+            return -EIO;
+        for(size_t i = 0; i < n && done < len; ++i)
+        {
+            uint64_t in   = off + done - sp[i].start;
+            size_t   take = (size_t)(sp[i].loc.len - in);
+            if(take > len - done)
+                take = len - done;
+            rc = pack_read(DB->packs, &sp[i].loc, in, (uint8_t*)buf + done,
+                           take);
+            if(rc != 0)
+                return rc == -ENOENT ? rc : -EIO;
+            done += take;
+        }
+    }
+    return 0;
+}
+
+int chunk_locate(MDB_txn* txn, const uint8_t sha[32], uint64_t size,
+                 uint64_t off, ChunkSpan* out, size_t max, size_t* out_n)
+{
+    *out_n      = 0;
+    MDB_val k   = {.mv_size = 32, .mv_data = (void*)sha};
+    MDB_val v   = {0};
+    int     mrc = mdb_get(txn, DB->db_data_manifests, &k, &v);
+    if(mrc != MDB_SUCCESS)
+        return mrc == MDB_NOTFOUND ? -ENOENT : -EIO;
+    size_t          n    = v.mv_size / sizeof(ChunkRef);
+    const ChunkRef* refs = (const ChunkRef*)v.mv_data;
+    if(n == 0 || v.mv_size % sizeof(ChunkRef) != 0 || refs[n - 1].end != size)
+        return -EIO;
+    if(off > size)
+        return -EINVAL;
+
+    /* first chunk ending past 'off' */
+    size_t lo = 0, hi = n;
+    while(lo < hi)
+    {
+        size_t mid = lo + (hi - lo) / 2;
+        if(refs[mid].end <= off)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    size_t got = 0;
+    for(size_t i = lo; got < max && i < n; ++i)
+    {
+        uint64_t start = i ? refs[i - 1].end : 0;
+        mrc            = pack_index_get(txn, refs[i].sha, &out[got].loc);
+        if(mrc != MDB_SUCCESS)
+            return mrc == MDB_NOTFOUND ? -ENOENT : -EIO;
+        if(out[got].loc.len != refs[i].end - start)
+            return -EIO;
+        out[got++].start = start;
+    }
+    *out_n = got;
+    return 0;
+}
+
+/****************************************************************************
+ * PRIVATE FUNCTIONS DEFINITIONS
+ ****************************************************************************
+ */
+
+static void gear_init(void)
+{
+    /* splitmix64 from a fixed seed */
+    uint64_t x = 0x6a09e667f3bcc908ull;
+    for(int i = 0; i < 256; ++i)
+    {
+        uint64_t z = (x += 0x9e3779b97f4a7c15ull);
+        z          = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+        z          = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+        GEAR[i]    = z ^ (z >> 31);
+    }
+}
+
+static size_t chunk_cut(const ChunkParams* cp, const uint8_t* p, size_t n)
+{
+    if(n <= cp->min)
+        return n;
+    if(n > cp->max)
+        n = cp->max;
+    size_t   norm = cp->avg < n ? cp->avg : n;
+    uint64_t h    = 0;
+    size_t   i    = cp->min; /* cut-point skipping: nothing to find before */
+    for(; i < norm; ++i)
+    {
+        h = (h << 1) + GEAR[p[i]];
+        if(!(h & cp->mask_s))
+            return i + 1;
+    }
+    for(; i < n; ++i)
+    {
+        h = (h << 1) + GEAR[p[i]];
+        if(!(h & cp->mask_l))
+            return i + 1;
+    }
+    return n;
+}
+
+static int chunk_add(ChunkList* cl, MDB_txn* rtxn, const uint8_t* p,
+                     size_t len, uint64_t end, uint64_t* saved)
+{
+    if(cl->n == cl->cap)
+    {
+        size_t    cap  = cl->cap ? cl->cap * 2 : 64;
+        ChunkRef* refs = realloc(cl->refs, cap * sizeof *refs);
+        if(!refs)
+            return -EIO;
+        cl->refs  = refs;
+        PackLoc* locs = realloc(cl->locs, cap * sizeof *locs);
+        if(!locs)
+            return -EIO;
+        cl->locs = locs;
+        cl->cap  = cap;
+    }
+    ChunkRef* r = &cl->refs[cl->n];
+    PackLoc*  l = &cl->locs[cl->n];
+    Sha256    d;
+    if(crypt_digest_buf(p, len, &d) != 0)
+        return -EIO;
+    memcpy(r->sha, d.b, 32);
+    r->end = end;
+    memset(l, 0, sizeof *l);
+
+    /* runs of one chunk (zero fill) and chunks already packed */
+    int known = cl->n && memcmp(cl->refs[cl->n - 1].sha, d.b, 32) == 0;
+    if(!known && mdb_txn_renew(rtxn) == MDB_SUCCESS)
+    {
+        PackLoc loc;
+        known = pack_index_get(rtxn, d.b, &loc) == MDB_SUCCESS &&
+                loc.len == (uint64_t)len;
+        mdb_txn_reset(rtxn);
+    }
+    if(known)
+        *saved += (uint64_t)len;
+    else
+    {
+        if(pack_append(DB->packs, p, len, l) != 0)
+            return -EIO;
+        ++cl->fresh;
+    }
+    ++cl->n;
+    return 0;
+}
+
+static int chunk_ref(MDB_txn* txn, const uint8_t sha[32], int delta,
+                     uint64_t* out_left)
+{
+    MDB_val  k     = {.mv_size = 32, .mv_data = (void*)sha};
+    MDB_val  v     = {0};
+    uint64_t count = 0;
+    int      mrc   = mdb_get(txn, DB->db_data_chunks, &k, &v);
+    if(mrc == MDB_SUCCESS && v.mv_size == sizeof count)
+        memcpy(&count, v.mv_data, sizeof count);
+    else if(mrc != MDB_NOTFOUND)
+        return mrc == MDB_SUCCESS ? MDB_CORRUPTED : mrc;
+
+    if(delta < 0 && count > 0)
+        --count;
+    else if(delta > 0)
+        ++count;
+    if(out_left)
+        *out_left = count;
+    if(count == 0)
+    {
+        mrc = mdb_del(txn, DB->db_data_chunks, &k, NULL);
+        return mrc == MDB_NOTFOUND ? MDB_SUCCESS : mrc;
+    }
+    MDB_val nv = {.mv_size = sizeof count, .mv_data = &count};
+    return mdb_put(txn, DB->db_data_chunks, &k, &nv, 0);
+}
+
+static int chunk_ingest(ChunkSrc* src, size_t avg, Sha256* digest,
+                        size_t* size, ChunkList* out)
+{
+    if(avg < 64 || (avg & (avg - 1)) || !digest || !size)
+        return -EIO;
+    pthread_once(&GEAR_ONCE, gear_init);
+
+    unsigned bits = 0;
+    while(((size_t)1 << (bits + 1)) <= avg)
+        ++bits;
+    ChunkParams cp = {.min    = avg / 4,
+                      .avg    = avg,
+                      .max    = avg * 8,
+                      .mask_s = ~0ull << (64 - (bits + 2)),
+                      .mask_l = ~0ull << (64 - (bits - 2))};
+
+    /* two max-size chunks: a cut never runs into the end of the buffer
+       before the end of input; one contiguous segment is cut in place */
+    size_t          cap   = cp.max * 2;
+    int             flat  = src->fd < 0 && src->iovcnt == 1;
+    uint8_t*        buf   = flat ? NULL : malloc(cap);
+    const uint8_t*  win   = flat ? src->iov[0].iov_base : buf;
+    CryptDigestCtx* whole = src->known ? NULL : crypt_digest_begin();
+    MDB_txn*        rtxn  = NULL;
+    int             rc    = -EIO;
+    if((!flat && !buf) || (!whole && !src->known) ||
+       mdb_txn_begin(DB->env, NULL, MDB_RDONLY, &rtxn) != MDB_SUCCESS)
+        goto done;
+    mdb_txn_reset(rtxn);
+
+    size_t   fill = flat ? src->iov[0].iov_len : 0, pos = 0;
+    uint64_t total = 0, saved = 0;
+    int      eof   = flat;
+    if(flat && whole && crypt_digest_update(whole, win, fill) != 0)
+        goto done;
+    for(;;)
+    {
+        if(!eof && fill - pos < cp.max)
+        {
+            memmove(buf, buf + pos, fill - pos);
+            fill -= pos;
+            pos = 0;
+            while(fill < cap)
+            {
+                ssize_t rd = chunk_src_read(src, buf + fill, cap - fill);
+                if(rd > 0)
+                {
+                    if(whole &&
+                       crypt_digest_update(whole, buf + fill, (size_t)rd) != 0)
+                        goto done;
+                    fill += (size_t)rd;
+                }
+                else if(rd == 0)
+                {
+                    eof = 1;
+                    break;
+                }
+                else
+                    goto done;
+            }
+        }
+        if(pos == fill)
+            break;
+        size_t n = chunk_cut(&cp, win + pos, fill - pos);
+        total += n;
+        if(chunk_add(out, rtxn, win + pos, n, total, &saved) != 0)
+            goto done;
+        pos += n;
+    }
+
+    /* the new chunks are durable before any manifest points at them */
+    if(out->fresh)
+    {
+        int frc = DB->flusher ? fs_flusher_sync(DB->flusher)
+                              : pack_sync(DB->packs);
+        if(frc < 0)
+            goto done;
+        if(!DB->flusher && frc == 1)
+            atomic_fetch_add(&DB->st_fsyncs, 1);
+    }
+    rc    = !whole || crypt_digest_end(whole, digest) == 0 ? 0 : -EIO;
+    whole = NULL;
+    if(rc == 0)
+    {
+        *size = (size_t)total;
+        atomic_fetch_add(&DB->st_objects, 1);
+        atomic_fetch_add(&DB->st_dedup_saved, saved);
+    }
+
+done:
+    if(rtxn)
+        mdb_txn_abort(rtxn);
+    if(whole)
+        (void)crypt_digest_end(whole, NULL);
+    free(buf);
+    if(rc != 0)
+        chunk_list_free(out);
+    return rc;
+}
+
+static ssize_t chunk_src_read(ChunkSrc* src, uint8_t* dst, size_t n)
+{
+    if(src->fd >= 0)
+    {
+        for(;;)
+        {
+            ssize_t rd = read(src->fd, dst, n);
+            if(rd >= 0 || errno != EINTR)
+                return rd;
+        }
+    }
+    size_t got = 0;
+    while(got < n && src->at < src->iovcnt)
+    {
+        const struct iovec* v    = &src->iov[src->at];
+        size_t              take = v->iov_len - src->off;
+        if(take > n - got)
+            take = n - got;
+        memcpy(dst + got, (const uint8_t*)v->iov_base + src->off, take);
+        got += take;
+        src->off += take;
+        if(src->off == v->iov_len)
+        {
+            ++src->at;
+            src->off = 0;
+        }
+    }
+    return (ssize_t)got;
+}
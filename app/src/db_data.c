@@ -9,27 +9,97 @@
 
 #include "db_int.h"
 #include "db_acl.h"
+#include "db_mime.h"
+#include "db_meta_cache.h"
+#include "db_pack.h"
+#include "db_chunk.h"
+#include "db_trash.h"
+#include "db_upload.h"
+#include "codec.h"
 #include "uuid.h"
 #include "fsutil.h"
 #include "sha256.h"
+#include "workpool.h"
+
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
 
 /****************************************************************************
  * PRIVATE DEFINES
  ****************************************************************************
  */
-/* None */
+
+/* Piece size of db_data_stream */
+#ifndef DATA_STREAM_BUFSZ
+#    define DATA_STREAM_BUFSZ (256u * 1024u)
+#endif
+
+/* Chunks located per read txn while streaming a chunked object */
+#ifndef DATA_CHUNK_BATCH
+#    define DATA_CHUNK_BATCH 256u
+#endif
 
 /****************************************************************************
  * PRIVATE STUCTURED VARIABLES
  ****************************************************************************
  */
-/* None */
+
+/* Shared state of one db_data_add_batch call (one slot per item). */
+typedef struct
+{
+    const int *fds;
+    Sha256    *digests;
+    uint64_t  *sizes;
+    int       *status;
+    FsTmp     *tmps;   /* group durability: staged, unsynced temps */
+    uint8_t  **inl;    /* inline/pack mode: bytes of small items, else NULL */
+    int        defer;  /* small items are hashed by batch_hash_small() */
+    ChunkList *chunks; /* chunking mode: chunks of large items, else NULL */
+} BatchIngest;
+
+/* One requested id of a batch lookup and its position in the caller's array */
+typedef struct
+{
+    const uint8_t *id;
+    size_t         pos;
+} IdSlot;
+
+/* Per-hit sink of data_resolve_sorted() */
+typedef void (*data_hit_fn)(size_t pos, const DataMeta *meta, void *user);
+
+/* Output of db_data_get_paths */
+typedef struct
+{
+    char  *paths;
+    size_t path_sz;
+    int   *status;
+} PathSink;
+
+/* Content released by one reaped record, settled after the txn */
+typedef struct
+{
+    FsTmp retired; /* blob moved aside, or name[0] == 0 */
+    int   uncache; /* a materialized copy may exist */
+    char  hex[65];
+} ReapSlot;
 
 /****************************************************************************
  * PRIVATE VARIABLES
  ****************************************************************************
  */
-/* None */
+
+/* "00".."ff": one lookup per byte when formatting blob paths */
+static const char HEX_PAIRS[513] =
+    "000102030405060708090a0b0c0d0e0f101112131415161718191a1b1c1d1e1f"
+    "202122232425262728292a2b2c2d2e2f303132333435363738393a3b3c3d3e3f"
+    "404142434445464748494a4b4c4d4e4f505152535455565758595a5b5c5d5e5f"
+    "606162636465666768696a6b6c6d6e6f707172737475767778797a7b7c7d7e7f"
+    "808182838485868788898a8b8c8d8e8f909192939495969798999a9b9c9d9e9f"
+    "a0a1a2a3a4a5a6a7a8a9aaabacadaeafb0b1b2b3b4b5b6b7b8b9babbbcbdbebf"
+    "c0c1c2c3c4c5c6c7c8c9cacbcccdcecfd0d1d2d3d4d5d6d7d8d9dadbdcdddedf"
+    "e0e1e2e3e4e5e6e7e8e9eaebecedeeeff0f1f2f3f4f5f6f7f8f9fafbfcfdfeff";
 
 /****************************************************************************
  * PRIVATE FUNCTIONS PROTOTYPES
@@ -40,14 +110,251 @@ static int      db_user_get_role(const uint8_t id[DB_ID_SIZE],
                                  user_role_t  *out_role);
 static uint64_t now_secs(void);
 
+/* Index one stored object inside 'txn': a sha->id reference, id->meta and
+ * the owner ACL. With 'inl' (size bytes) the first reference also stores
+ * the bytes in data_inline, with 'pack' it indexes their pack location,
+ * with 'chunks' their manifest; records follow wherever the content lives.
+ * Returns MDB_SUCCESS, MDB_KEYEXIST when 'owner' already holds
+ * this content (out_id = that record), MDB_NOTFOUND when the blob was retired
+ * by a concurrent last-reference delete (caller reports -EAGAIN),
+ * MDB_MAP_FULL when the map must grow (caller retries the txn), or another
+ * error code. */
+static int data_index_put(MDB_txn *txn, const uint8_t owner[DB_ID_SIZE],
+                          const Sha256 *digest, uint64_t size,
+                          const char *mime, uint64_t created_at,
+                          const void *inl, const PackLoc *pack,
+                          const ChunkList *chunks, uint8_t out_id[DB_ID_SIZE]);
+
+/* Point lookup in owner|sha: MDB_SUCCESS with out_id set when 'owner'
+   already has a record of 'sha', MDB_NOTFOUND otherwise. *out_refs = live
+   reference count of 'sha' (the dup count, no walk). */
+static int data_sha_find_owned(MDB_txn *txn, const uint8_t owner[DB_ID_SIZE],
+                               MDB_val *sha, uint8_t out_id[DB_ID_SIZE],
+                               size_t *out_refs);
+
+/* Resolve n ids in one read txn with one cursor, probing in key order.
+   Calls 'hit' for every found id (MIME resolved only with 'with_mime') and
+   sets status[i] to 0 / -ENOENT / -EIO. Returns 0, -ENOMEM or -EIO. */
+static int data_resolve_sorted(size_t n, const uint8_t *ids, int status[],
+                               int with_mime, data_hit_fn hit, void *user);
+static int  id_slot_cmp(const void *a, const void *b);
+static void meta_hit_copy(size_t pos, const DataMeta *meta, void *user);
+static void path_hit_format(size_t pos, const DataMeta *meta, void *user);
+
+/* "<prefix>xx/yy/<hex64>" into out (out_sz bytes). 0 or -ENAMETOOLONG. */
+static int data_format_path(char *out, size_t out_sz, const uint8_t sha[32]);
+
+/* Pool worker for db_data_add_batch: store one fd, record digest+size. */
+static void batch_ingest_one(size_t i, void *user);
+
+/* Copy+hash+publish one object with the configured durability: its own
+   fsync, or (group mode) one flusher sync before and after the publish
+   shared with concurrent ingests. 0 or -EIO. */
+static int data_store_object(int src_fd, Sha256 *digest, size_t *size);
+
+/* Chunking mode: cut a regular-file source longer than one max-size chunk
+   (chunk_ingest_fd). 1 when handled (an empty list is a hash-first hit), 0
+   when the source takes the blob path (offset unchanged), -EIO. */
+static int data_chunk_object(int src_fd, Sha256 *digest, size_t *size,
+                             ChunkList *out);
+
+/* Hash-first dedup (DB_DEDUP_HASH_FIRST): for a seekable source, hash it in
+   place and skip the copy when the content is indexed and its blob exists.
+   Returns 1 on a hit (offset moved past the data), 0 when the caller must
+   store the object. A miss costs a second pass: the copy hashes again, from
+   the page cache the first pass filled, because a file can change between
+   the passes and the digest must be that of the bytes stored. Sources that
+   cannot be read twice (pipes, sockets) never take this path. */
+static int data_hash_first(int src_fd, Sha256 *digest, size_t *size);
+
+/* 1 when content 'digest' of 'len' bytes is indexed and its bytes are
+   present (nothing to write), else 0. */
+static int data_content_present(const Sha256 *digest, size_t len);
+
+/* Staged blob 'tmp' holding 'digest': when the content got indexed since
+   the ingest started (inline, packed, chunked or as a blob) the temp is
+   discarded and 1 returned, so the record reuses that storage instead of
+   leaving a stray blob next to it; 0 when the caller must publish. */
+static int data_stage_redundant(FsTmp *tmp, const Sha256 *digest,
+                                size_t size);
+
+/* data_store_object() for the caller's memory, already hashed: skipped
+   when the content is present, else written with pwritev into a temp and
+   published with the configured durability. 0 or -EIO. */
+static int data_store_iov(const struct iovec *iov, int iovcnt,
+                          const Sha256 *digest, size_t size);
+
+/* Index one stored object for 'owner' in its own write txn (grown and
+   retried on MDB_MAP_FULL); 'inl', 'pack' and 'chunks' as for
+   data_index_put. A non-NULL 'upload' names the data_uploads record the
+   object came from, deleted in the same txn. 0, -EAGAIN when its blob was
+   deleted meanwhile, -ENOENT when the upload record is gone, or -errno. */
+static int data_index_commit(uint8_t owner[DB_ID_SIZE], const Sha256 *digest,
+                             size_t size, const char *mime, const void *inl,
+                             const PackLoc *pack, const ChunkList *chunks,
+                             const uint8_t *upload, uint8_t out_id[DB_ID_SIZE]);
+
+/* db_data_add_from_fd() past the permission check; 'upload' as for
+   data_index_commit. */
+static int data_add_fd(uint8_t owner[DB_ID_SIZE], int src_fd,
+                       const char *mime, const uint8_t *upload,
+                       uint8_t out_data_id[DB_ID_SIZE]);
+
+/* Group mode: make the batch's staged temps durable, publish them and make
+   the links durable. Failed items get -EIO. 0 or -EIO. */
+static int batch_publish_group(size_t n, BatchIngest *bi);
+
+/* Pack mode: append the batch's small, not-inline, not-yet-indexed items
+   (their bytes move from bi->inl to locs[i]; locs[i].pack stays 0 for the
+   others) and make them durable with one sync. *out_pinned = appends to
+   release after indexing. Failed items get -EIO. 0 or -EIO. */
+static int batch_pack_items(size_t n, BatchIngest *bi, PackLoc *locs,
+                            size_t *out_pinned);
+
+/* Digests of the items batch_ingest_one() read into bi->inl, in one
+   crypt_digest_many() call (one by one if out of memory); an item that
+   cannot be hashed gets -EIO. */
+static void batch_hash_small(size_t n, BatchIngest *bi);
+
+/* Inline/pack mode: read a regular-file source of at most data_small_max()
+   bytes into a malloc'd buffer and hash it (unless digest is NULL). 1 when
+   read (*out owned by the caller), 0 when the source must take the blob path
+   (offset unchanged), -1 on a read error. */
+static int data_read_small(int src_fd, uint8_t **out, size_t *len,
+                           Sha256 *digest);
+
+/* Open the bytes behind 'meta' read-only: the blob through the shard
+   handles, or a memfd copy of inline or packed bytes (located within
+   'txn'). A chunked or compressed object is reassembled or inflated into a
+   sparse unnamed file under objects/cache that holds only [off, off+len)
+   at its own offsets (len 0 = to the end). The fd is at 0.
+   fd or -ENOENT / -ENOMEM / -EIO. */
+static int data_open_bytes(MDB_txn *txn, const DataMeta *meta, uint64_t off,
+                           uint64_t len);
+
+/* Open the blob file of 'meta' (as stored) through the shard handles. fd or
+   -ENOENT / -EIO. */
+static int data_open_object(const DataMeta *meta);
+
+/* Read txn of a data reader, entered as a pack reader first: segments its
+   snapshot points into stay on disk until data_read_end(). 0 or -EIO. */
+static int  data_read_begin(MDB_txn **txn, uint64_t *ticket);
+static void data_read_end(MDB_txn *txn, uint64_t ticket);
+
+/* Feed [off, off+len) of the compressed blob open as 'fd' (closed here) to
+   'sink', inflating from the nearest seek point. 0, the sink's non-zero
+   return, -ENOMEM or -EIO. */
+static int data_zlib_stream(int fd, uint64_t off, uint64_t len,
+                            db_data_sink_cb sink, void *user);
+
+/* Pack mode: append a small object read by data_read_small() to the open
+   pack and make it durable. 1 when appended (the caller indexes it, then
+   calls pack_release), 0 when the content is already indexed (nothing
+   written), -EIO. */
+static int data_pack_object(const Sha256 *digest, const uint8_t *buf,
+                            size_t len, PackLoc *out);
+
+/* Copy 'len' bytes at 'off' of the packed object behind 'meta', located
+   within 'txn'. 0, -ENOENT or -EIO. */
+static int data_pack_read(MDB_txn *txn, const DataMeta *meta, uint64_t off,
+                          void *buf, size_t len);
+
+/* Feed [off, off+len) of the chunked object behind 'meta' to 'sink' in
+   pieces of at most DATA_STREAM_BUFSZ. Chunks are located a batch per
+   short read txn; the sink runs with none open. 0, the sink's non-zero
+   return, -ENOENT, -ENOMEM or -EIO. */
+static int data_chunked_stream(const DataMeta *meta, uint64_t off,
+                               uint64_t len, db_data_sink_cb sink, void *user);
+
+/* Write [off, off+len) of the chunked object behind 'meta', located within
+   'txn', to 'fd' at its current offset. 0, -ENOENT or -EIO. */
+static int data_chunked_copy(MDB_txn *txn, const DataMeta *meta, uint64_t off,
+                             uint64_t len, int fd);
+
+/* db_data_sink_cb appending to the fd at *(int *)user. 0 or -EIO. */
+static int fd_sink(const void *buf, size_t len, void *user);
+
+/* "<root>/objects/cache/<hex64>": materialized copy of non-blob content */
+static int data_cache_path(char *out, size_t out_sz, const char hex[65]);
+
+/* Drop the content of 'meta' (hex digest 'hex') with its last reference:
+   inline bytes, pack extents and chunk references go with 'txn' (the
+   repacker reclaims the pack space; a chunk with the same bytes keeps a
+   packed object's extent), a blob is moved aside into *retired for the
+   caller to discard after commit or restore on failure. *uncache tells
+   whether a materialized copy may exist. MDB rc. */
+static int data_release_content(MDB_txn *txn, const DataMeta *meta,
+                                const char hex[65], FsTmp *retired,
+                                int *uncache);
+
+/* Move record 'id' to the trash when 'actor' owns it. *status gets the
+   item's outcome (0, -EPERM, -ENOENT, -EIO); the return is an MDB rc that
+   fails the whole txn. */
+static int data_trash_one(MDB_txn *txn, const uint8_t actor[DB_ID_SIZE],
+                          const uint8_t id[DB_ID_SIZE], uint64_t now,
+                          int *status);
+
+/* One write txn of db_data_delete_many(): ids[0..n). 0 or -errno. */
+static int data_trash_txn(const uint8_t actor[DB_ID_SIZE], size_t n,
+                          const uint8_t *ids, int status[], size_t *out_done);
+
+/* One write txn of db_data_reap(): up to 'max' expired records. 0 or
+   -errno. */
+static int data_reap_txn(size_t max, size_t *out_reaped);
+
+/* db_data_sink_cb feeding a CryptSha256Ctx (db_data_sha256) */
+static int data_sha256_sink(const void *buf, size_t len, void *user);
+
+/* Largest object read into memory by ingest (inline or packed); 0 = off */
+static inline size_t data_small_max(void)
+{
+    return DB->inline_max > DB->pack_max ? DB->inline_max : DB->pack_max;
+}
+
+/* A small object of 'len' bytes goes to data_inline (else to a pack) */
+static inline int data_goes_inline(size_t len)
+{
+    return DB->inline_max && len <= DB->inline_max;
+}
+
+/* DataMeta.ver tag of the store's content digest */
+static inline uint8_t data_meta_digest_flag(void)
+{
+    return DB->digest_alg == CRYPT_HASH_BLAKE3 ? DATA_META_F_DIGEST : 0;
+}
+
+/* owner(16) | created_at(8, big-endian) | data_id(16): per owner, sorted by
+   time and then by the (time-ordered) id */
+static inline void owner_time_key(uint8_t out[40],
+                                  const uint8_t owner[DB_ID_SIZE],
+                                  uint64_t      created_at,
+                                  const uint8_t data_id[DB_ID_SIZE])
+{
+    memcpy(out, owner, DB_ID_SIZE);
+    for(int i = 0; i < 8; ++i)
+        out[DB_ID_SIZE + i] = (uint8_t)(created_at >> (56 - 8 * i));
+    memcpy(out + DB_ID_SIZE + 8, data_id, DB_ID_SIZE);
+}
+
+/* owner(16) | sha(32): the owner's one record of a content */
+static inline void owner_sha_key(uint8_t out[48],
+                                 const uint8_t owner[DB_ID_SIZE],
+                                 const uint8_t sha[32])
+{
+    memcpy(out, owner, DB_ID_SIZE);
+    memcpy(out + DB_ID_SIZE, sha, 32);
+}
+
+/* v0 record: the MIME name inline */
 static inline void write_data_meta(void *dst, const Sha256 *digest,
                                    const char *mime, uint64_t size,
                                    uint64_t      created_at,
-                                   const uint8_t owner[DB_ID_SIZE])
+                                   const uint8_t owner[DB_ID_SIZE],
+                                   uint8_t       flags)
 {
-    DataMeta *m = (DataMeta *)dst;
+    DataMetaV0 *m = (DataMetaV0 *)dst;
     memset(m, 0, sizeof *m);
-    m->ver = DB_VER;
+    m->ver = (uint8_t)(DATA_META_V0 | flags | data_meta_digest_flag());
     memcpy(m->sha, digest->b, 32);
     snprintf(m->mime, sizeof m->mime, "%s",
              (mime && *mime) ? mime : "application/octet-stream");
@@ -56,13 +363,21 @@ static inline void write_data_meta(void *dst, const Sha256 *digest,
     memcpy(m->owner, owner, DB_ID_SIZE);
 }
 
-static inline int db_data_get_and_check_mem(const MDB_val *v, DataMeta *out)
+/* v1 record: MIME interned as a dictionary id */
+static inline void write_data_meta_rec(void *dst, const Sha256 *digest,
+                                       uint16_t mime_id, uint64_t size,
+                                       uint64_t      created_at,
+                                       const uint8_t owner[DB_ID_SIZE],
+                                       uint8_t       flags)
 {
-    if(!v || v->mv_size != sizeof(DataMeta))
-        return -EINVAL;
-    if(out)
-        memcpy(out, v->mv_data, sizeof *out);
-    return 0;
+    DataMetaRec *m = (DataMetaRec *)dst;
+    m->ver         = (uint8_t)(DATA_META_V1 | flags |
+                               data_meta_digest_flag());
+    memcpy(m->sha, digest->b, 32);
+    m->mime_id    = mime_id;
+    m->size       = size;
+    m->created_at = created_at;
+    memcpy(m->owner, owner, DB_ID_SIZE);
 }
 
 /****************************************************************************
@@ -72,8 +387,14 @@ static inline int db_data_get_and_check_mem(const MDB_val *v, DataMeta *out)
 
 int db_data_get_meta(uint8_t data_id[DB_ID_SIZE], DataMeta *out_meta)
 {
-    if(!out_meta)
+    if(!out_meta || !data_id)
         return -EINVAL;
+
+    /* hot records: one probe of the cache, no txn */
+    uint64_t gen = 0;
+    if(meta_cache_get(DB->meta_cache, data_id, out_meta, &gen) == 0)
+        return 0;
+
     MDB_txn *txn;
     if(mdb_txn_begin(DB->env, NULL, MDB_RDONLY, &txn) != MDB_SUCCESS)
         return -EIO;
@@ -87,9 +408,11 @@ int db_data_get_meta(uint8_t data_id[DB_ID_SIZE], DataMeta *out_meta)
         return db_map_mdb_err(mrc);
     }
 
-    mrc = db_data_get_and_check_mem(&v, out_meta);
+    mrc = db_data_meta_decode(txn, &v, out_meta);
 
     mdb_txn_abort(txn);
+    if(mrc == 0)
+        meta_cache_put(DB->meta_cache, data_id, out_meta, gen);
     return mrc;
 }
 
@@ -103,246 +426,2565 @@ int db_data_get_path(uint8_t data_id[DB_ID_SIZE], char *out_path,
     int      rc = db_data_get_meta(data_id, &meta);
     if(rc != 0)
         return rc; /* already -ENOENT / -EIO / -EINVAL */
+    if(meta.flags & DATA_META_F_MASK)
+        return -ENODATA; /* no file behind it */
 
-    char   hex[65];
-    Sha256 d;
-    memcpy(d.b, meta.sha, 32);
-    crypt_sha256_hex(&d, hex);
-
-    if(path_sha256(out_path, out_sz, DB->root, hex) < 0)
-        return -EIO;
-    return 0;
+    return data_format_path(out_path, out_sz, meta.sha);
 }
 
-int db_data_add_from_fd(uint8_t owner[DB_ID_SIZE], int src_fd, const char *mime,
-                        uint8_t out_data_id[DB_ID_SIZE])
+int db_data_get_metas(size_t n, const uint8_t *ids_flat, DataMeta *out_meta,
+                      int out_status[])
 {
-    if(!owner || src_fd < 0)
+    if(n == 0 || !ids_flat || !out_meta || !out_status)
         return -EINVAL;
+    return data_resolve_sorted(n, ids_flat, out_status, 1, meta_hit_copy,
+                               out_meta);
+}
 
-    user_role_t owner_role;
-    memset(&owner_role, 0, sizeof(user_role_t));
+int db_data_get_paths(size_t n, const uint8_t *ids_flat, char *out_paths,
+                      size_t path_sz, int out_status[])
+{
+    if(n == 0 || !ids_flat || !out_paths || path_sz == 0 || !out_status)
+        return -EINVAL;
+    PathSink ps = {
+        .paths = out_paths, .path_sz = path_sz, .status = out_status};
+    return data_resolve_sorted(n, ids_flat, out_status, 0, path_hit_format,
+                               &ps);
+}
 
-    /* Permission check: owner must exist and be a publisher */
-    {
-        int prc = db_user_get_role(owner, &owner_role);
-        if(prc != 0)
-            return db_map_mdb_err(prc);
-        if(owner_role != USER_ROLE_PUBLISHER)
-            return -EPERM;
-    }
+int db_data_open(uint8_t data_id[DB_ID_SIZE], int *out_fd)
+{
+    if(!data_id || !out_fd)
+        return -EINVAL;
 
-    /* One-pass ingest: stream → temp → fsync → atomic publish; compute digest+size */
-    Sha256 digest;
-    size_t total = 0;
-    if(crypt_store_sha256_object_from_fd(DB->root, src_fd, &digest, &total) !=
-       0)
+    MDB_txn *txn    = NULL;
+    uint64_t ticket = 0;
+    if(data_read_begin(&txn, &ticket) != 0)
         return -EIO;
+    DataMeta meta;
+    MDB_val  k  = {.mv_size = DB_ID_SIZE, .mv_data = data_id};
+    MDB_val  v  = {0};
+    int      rc = mdb_get(txn, DB->db_data_id2meta, &k, &v);
+    rc          = rc == MDB_SUCCESS ? db_data_meta_decode(NULL, &v, &meta)
+                                    : db_map_mdb_err(rc);
+    if(rc == 0)
+        rc = data_open_bytes(txn, &meta, 0, 0);
+    data_read_end(txn, ticket);
+    if(rc < 0)
+        return rc;
+    *out_fd = rc;
+    return 0;
+}
 
-    /* Upsert sha2data and data_meta in a single transaction */
-    uint8_t  data_id[DB_ID_SIZE] = {0};
-    unsigned db_sha2id_put_flags = MDB_NOOVERWRITE | MDB_RESERVE;
-    unsigned db_dataid_put_flags = MDB_NOOVERWRITE | MDB_RESERVE | MDB_APPEND;
-
-retry_chunk:
-    MDB_txn *txn = NULL;
-
-    int mrc = mdb_txn_begin(DB->env, NULL, 0, &txn);
-    if(mrc != MDB_SUCCESS)
-        return db_map_mdb_err(mrc);
-
-    /* sha -> id, make sure unique exists */
-    MDB_val shak = {.mv_size = 32, .mv_data = (void *)digest.b};
-    MDB_val shav = {.mv_size = DB_ID_SIZE, .mv_data = NULL};
+int db_data_read(const uint8_t data_id[DB_ID_SIZE], uint64_t off, void *buf,
+                 size_t len, size_t *out_n)
+{
+    if(!data_id || (!buf && len) || !out_n)
+        return -EINVAL;
+    *out_n = 0;
 
-    mrc = mdb_put(txn, DB->db_data_sha2id, &shak, &shav, db_sha2id_put_flags);
-    if(mrc == MDB_MAP_FULL)
-    {
-        mdb_txn_abort(txn);
-        int grc = db_env_mapsize_expand(); /* grow */
-        if(grc != 0)
-            return db_map_mdb_err(grc); /* stop if grow failed */
-        goto retry_chunk;               /* retry whole chunk */
-    }
-    if(mrc != MDB_SUCCESS)
+    MDB_txn *txn    = NULL;
+    uint64_t ticket = 0;
+    if(data_read_begin(&txn, &ticket) != 0)
+        return -EIO;
+    DataMeta meta;
+    MDB_val  k  = {.mv_size = DB_ID_SIZE, .mv_data = (void *)data_id};
+    MDB_val  v  = {0};
+    int      rc = mdb_get(txn, DB->db_data_id2meta, &k, &v);
+    rc          = rc == MDB_SUCCESS ? db_data_meta_decode(NULL, &v, &meta)
+                                    : db_map_mdb_err(rc);
+    if(rc == 0 && off > meta.size)
+        rc = -ERANGE;
+    if(rc != 0)
     {
-        mdb_txn_abort(txn);
-        return db_map_mdb_err(mrc);
+        data_read_end(txn, ticket);
+        return rc;
     }
-    /* generate new id, write it into reserved sha->id slot */
-    uuid_v7(data_id);
+    uint64_t avail = meta.size - off;
+    size_t   want  = (uint64_t)len < avail ? len : (size_t)avail;
 
-    MDB_val datak = {.mv_size = DB_ID_SIZE, .mv_data = (void *)data_id};
-    MDB_val datav = {.mv_size = sizeof(DataMeta), .mv_data = NULL};
-
-    mrc =
-        mdb_put(txn, DB->db_data_id2meta, &datak, &datav, db_dataid_put_flags);
-    if(mrc == MDB_MAP_FULL)
-    {
-        mdb_txn_abort(txn);
-        int grc = db_env_mapsize_expand(); /* grow */
-        if(grc != 0)
-            return db_map_mdb_err(grc); /* stop if grow failed */
-        goto retry_chunk;               /* retry whole chunk */
-    }
-    if(mrc != MDB_SUCCESS)
+    /* inline: copy straight out of the map, no fd */
+    if(meta.flags & DB_DATA_F_INLINE)
     {
-        mdb_txn_abort(txn);
-        return db_map_mdb_err(mrc);
+        MDB_val sk = {.mv_size = 32, .mv_data = meta.sha};
+        MDB_val bv = {0};
+        rc         = mdb_get(txn, DB->db_data_inline, &sk, &bv);
+        if(rc == MDB_SUCCESS && bv.mv_size == meta.size)
+        {
+            memcpy(buf, (const uint8_t *)bv.mv_data + off, want);
+            *out_n = want;
+        }
+        data_read_end(txn, ticket);
+        if(rc == MDB_SUCCESS && bv.mv_size != meta.size)
+            return -EIO;
+        return rc == MDB_SUCCESS ? 0 : db_map_mdb_err(rc);
     }
-
-    /* write new id into reserved sha->id slot */
-    memcpy(shav.mv_data, data_id, DB_ID_SIZE);
-
-    /* fill DataMeta in-place (no stack buffer) */
-    write_data_meta(datav.mv_data, &digest, mime, (uint64_t)total, now_secs(),
-                    owner);
-
-    mrc = acl_grant_owner(txn, owner, data_id);
-
-    if(mrc == MDB_MAP_FULL)
+    if(meta.flags & DB_DATA_F_PACKED)
     {
-        mdb_txn_abort(txn);
-        int grc = db_env_mapsize_expand(); /* grow */
-        if(grc != 0)
-            return db_map_mdb_err(grc); /* stop if grow failed */
-        goto retry_chunk;               /* retry whole chunk */
+        rc = data_pack_read(txn, &meta, off, buf, want);
+        data_read_end(txn, ticket);
+        if(rc == 0)
+            *out_n = want;
+        return rc;
     }
-    if(mrc != 0)
+    if(meta.flags & DB_DATA_F_CHUNKED)
     {
-        mdb_txn_abort(txn);
-        return db_map_mdb_err(mrc);
+        rc = chunk_read(txn, meta.sha, meta.size, off, buf, want);
+        data_read_end(txn, ticket);
+        if(rc == 0)
+            *out_n = want;
+        return rc;
     }
+    data_read_end(txn, ticket);
 
-    mrc = mdb_txn_commit(txn);
-    if(mrc == MDB_MAP_FULL)
+    int fd = data_open_object(&meta);
+    if(fd < 0)
+        return fd;
+    if(meta.flags & DB_DATA_F_ZLIB)
     {
-        int grc = db_env_mapsize_expand();
-        if(grc != 0)
-            return db_map_mdb_err(grc); /* stop if grow failed */
-        goto retry_chunk;
+        /* from the last seek point before 'off': no walk from the top */
+        rc = codec_inflate_range(fd, off, buf, want, out_n);
+        close(fd);
+        if(rc == 0 && *out_n != want)
+            rc = -EIO;
+        return rc == 0 ? 0 : -EIO;
     }
-    if(mrc != MDB_SUCCESS)
+    size_t got = 0;
+    while(got < want)
     {
-        /* txn is already aborted/freed on commit error */
-        return db_map_mdb_err(mrc);
+        ssize_t rd = pread(fd, (uint8_t *)buf + got, want - got,
+                           (off_t)(off + got));
+        if(rd > 0)
+            got += (size_t)rd;
+        else if(rd < 0 && errno == EINTR)
+            continue;
+        else
+            break;
     }
-    if(out_data_id)
-        memcpy(out_data_id, data_id, DB_ID_SIZE);
-    return 0;
+    close(fd);
+    *out_n = got;
+    return got == want ? 0 : -EIO;
 }
 
-int db_data_delete(const uint8_t owner[DB_ID_SIZE],
-                   const uint8_t data_id[DB_ID_SIZE])
+int db_data_stream(const uint8_t data_id[DB_ID_SIZE], uint64_t off,
+                   uint64_t len, db_data_sink_cb sink, void *user)
 {
-    if(!owner || !data_id)
+    if(!data_id || !sink)
         return -EINVAL;
 
-    MDB_txn *txn = NULL;
-    if(mdb_txn_begin(DB->env, NULL, 0, &txn) != MDB_SUCCESS)
+    MDB_txn *txn    = NULL;
+    uint64_t ticket = 0;
+    if(data_read_begin(&txn, &ticket) != 0)
         return -EIO;
-
-    /* must be owner */
+    DataMeta meta;
+    MDB_val  k  = {.mv_size = DB_ID_SIZE, .mv_data = (void *)data_id};
+    MDB_val  v  = {0};
+    int      rc = mdb_get(txn, DB->db_data_id2meta, &k, &v);
+    rc          = rc == MDB_SUCCESS ? db_data_meta_decode(NULL, &v, &meta)
+                                    : db_map_mdb_err(rc);
+    if(rc == 0 && off > meta.size)
+        rc = -ERANGE;
+    if(rc != 0)
     {
-        int rc = acl_has_owner(txn, owner, data_id);
-        if(rc != 0)
-        {
-            mdb_txn_abort(txn);
-            return rc;
-        }
+        data_read_end(txn, ticket);
+        return rc;
     }
+    if(len == 0 || len > meta.size - off)
+        len = meta.size - off;
 
-    /* fetch meta (for blob path) */
-    DataMeta meta = {0};
+    /* chunks straight from their packs: nothing is reassembled */
+    if(meta.flags & DB_DATA_F_CHUNKED)
     {
-        MDB_val k  = {.mv_size = DB_ID_SIZE, .mv_data = (void *)data_id};
-        MDB_val v  = {0};
-        int     rc = mdb_get(txn, DB->db_data_id2meta, &k, &v);
-        if(rc == MDB_NOTFOUND)
-        {
-            mdb_txn_abort(txn);
-            return -ENOENT;
-        }
-        if(rc != MDB_SUCCESS || v.mv_size != sizeof(DataMeta))
-        {
-            mdb_txn_abort(txn);
-            return -EIO;
-        }
-        memcpy(&meta, v.mv_data, sizeof meta);
+        data_read_end(txn, ticket);
+        return data_chunked_stream(&meta, off, len, sink, user);
     }
+    /* compressed: inflated straight to the sink from the nearest seek point,
+       nothing is materialized */
+    if(meta.flags & DB_DATA_F_ZLIB)
+    {
+        int zfd = data_open_object(&meta);
+        data_read_end(txn, ticket);
+        return zfd < 0 ? zfd : data_zlib_stream(zfd, off, len, sink, user);
+    }
+    int fd = data_open_bytes(txn, &meta, off, len);
+    data_read_end(txn, ticket);
+    if(fd < 0)
+        return fd;
 
-    /* nuke all ACLs for this data */
+    uint8_t *buf = malloc(DATA_STREAM_BUFSZ);
+    rc           = buf ? 0 : -ENOMEM;
+    uint64_t done = 0;
+    while(rc == 0 && done < len)
     {
-        int rc = acl_data_destroy(txn, data_id);
-        if(rc != 0)
+        size_t  want = len - done < DATA_STREAM_BUFSZ ? (size_t)(len - done)
+                                                      : DATA_STREAM_BUFSZ;
+        ssize_t rd   = pread(fd, buf, want, (off_t)(off + done));
+        if(rd < 0 && errno == EINTR)
+            continue;
+        if(rd <= 0)
+            rc = -EIO;
+        else
         {
-            mdb_txn_abort(txn);
-            return rc;
+            rc = sink(buf, (size_t)rd, user);
+            done += (uint64_t)rd;
         }
     }
+    free(buf);
+    close(fd);
+    return rc;
+}
 
-    /* drop lookups */
+int db_data_sha256(const uint8_t data_id[DB_ID_SIZE], uint8_t out[32])
+{
+    if(!data_id || !out)
+        return -EINVAL;
+    DataMeta meta;
+    int      rc = db_data_get_meta((uint8_t *)data_id, &meta);
+    if(rc != 0)
+        return rc;
+    if(!(meta.flags & DATA_META_F_DIGEST))
     {
-        MDB_val sk = {.mv_size = 32, .mv_data = meta.sha};
-        (void)mdb_del(txn, DB->db_data_sha2id, &sk, NULL);
-
-        MDB_val mk = {.mv_size = DB_ID_SIZE, .mv_data = (void *)data_id};
-        (void)mdb_del(txn, DB->db_data_id2meta, &mk, NULL);
+        memcpy(out, meta.sha, 32);
+        return 0;
     }
 
-    int mrc = mdb_txn_commit(txn);
-    if(mrc != MDB_SUCCESS)
-        return db_map_mdb_err(mrc);
+    CryptSha256Ctx *c = crypt_sha256_begin();
+    if(!c)
+        return -ENOMEM;
+    rc = db_data_stream(data_id, 0, 0, data_sha256_sink, c);
+    Sha256 d;
+    if(crypt_sha256_end(c, rc == 0 ? &d : NULL) != 0 && rc == 0)
+        rc = -EIO;
+    if(rc == 0)
+        memcpy(out, d.b, 32);
+    return rc;
+}
 
-    /* best-effort unlink (DB is source of truth) */
+int db_data_materialize(const uint8_t data_id[DB_ID_SIZE], char *out_path,
+                        unsigned long out_sz)
+{
+    if(!data_id || !out_path || out_sz == 0)
+        return -EINVAL;
+
+    DataMeta meta;
+    int      rc = db_data_get_meta((uint8_t *)data_id, &meta);
+    if(rc != 0)
+        return rc;
+    if(!(meta.flags & DATA_META_F_MASK))
+        return data_format_path(out_path, out_sz, meta.sha);
+
+    char   hex[65];
+    Sha256 d;
+    memcpy(d.b, meta.sha, 32);
+    crypt_sha256_hex(&d, hex);
+    rc = data_cache_path(out_path, out_sz, hex);
+    if(rc != 0)
+        return rc;
+    struct stat st;
+    if(stat(out_path, &st) == 0 && (uint64_t)st.st_size == meta.size)
+        return 0; /* materialized before */
+
+    /* content-addressed: racing callers write the same bytes and the last
+       rename wins; a copy outliving its content is stale but never wrong */
+    char tmp[PATH_MAX];
+    int  n = snprintf(tmp, sizeof tmp, "%s.XXXXXX", out_path);
+    if(n < 0 || (size_t)n >= sizeof tmp)
+        return -ENAMETOOLONG;
+    int fd = mkstemp(tmp);
+    if(fd < 0)
+        return -EIO;
+    rc = db_data_stream(data_id, 0, 0, fd_sink, &fd);
+    if(rc == 0 && fdatasync(fd) != 0)
+        rc = -EIO;
+    close(fd);
+    if(rc == 0 && rename(tmp, out_path) != 0)
+        rc = -EIO;
+    if(rc != 0)
     {
-        char   path[4096], hex[65];
-        Sha256 d;
-        memcpy(d.b, meta.sha, 32);
-        crypt_sha256_hex(&d, hex);
-        if(path_sha256(path, sizeof path, DB->root, hex) == 0)
-            (void)unlink(path);
+        unlink(tmp);
+        return rc == -ENOENT ? rc : -EIO;
     }
-
     return 0;
 }
 
-/****************************************************************************
- * PRIVATE FUNCTIONS DEFINITIONS
- ****************************************************************************
- */
-
-static int db_user_get_role(const uint8_t id[DB_ID_SIZE], user_role_t *out_role)
+int db_data_open_range_for(const uint8_t principal[DB_ID_SIZE],
+                           const uint8_t data_id[DB_ID_SIZE], uint64_t off,
+                           uint64_t len, int *out_fd, DataMeta *out_meta,
+                           uint64_t *out_len)
 {
-    if(!id || !out_role)
+    if(!principal || !data_id || !out_fd)
         return -EINVAL;
 
-    MDB_txn *txn = NULL;
-    if(mdb_txn_begin(DB->env, NULL, MDB_RDONLY, &txn) != MDB_SUCCESS)
-        return -EIO;
-
-    MDB_val k   = {.mv_size = DB_ID_SIZE, .mv_data = (void *)id};
-    MDB_val v   = {0};
-    int     mrc = mdb_get(txn, DB->db_user_id2data, &k, &v);
-    if(mrc != MDB_SUCCESS)
+    /* ACL presence, meta and the open from the same snapshot */
+    DataMeta meta;
+    int      fd = -1;
     {
-        mdb_txn_abort(txn);
-        return db_map_mdb_err(mrc == MDB_NOTFOUND ? MDB_NOTFOUND : mrc);
+        MDB_txn *txn    = NULL;
+        uint64_t ticket = 0;
+        if(data_read_begin(&txn, &ticket) != 0)
+            return -EIO;
+        int rc = acl_has_any(txn, principal, data_id);
+        if(rc == 0)
+        {
+            MDB_val k = {.mv_size = DB_ID_SIZE, .mv_data = (void *)data_id};
+            MDB_val v = {0};
+            rc        = mdb_get(txn, DB->db_data_id2meta, &k, &v);
+            rc        = rc == MDB_SUCCESS ? db_data_meta_decode(txn, &v, &meta)
+                                          : db_map_mdb_err(rc);
+        }
+        if(rc == 0 && off > meta.size)
+            rc = -ERANGE;
+        if(rc == 0)
+            rc = data_open_bytes(txn, &meta, off, len);
+        data_read_end(txn, ticket);
+        if(rc < 0)
+            return rc;
+        fd = rc;
     }
 
-    uint8_t role = 0;
-    if(db_user_get_and_check_mem(&v, NULL, &role, NULL, NULL, NULL) != 0)
+    uint64_t avail = meta.size - off;
+    if(len == 0 || len > avail)
+        len = avail;
+
+    if(off && lseek(fd, (off_t)off, SEEK_SET) == (off_t)-1)
     {
-        mdb_txn_abort(txn);
+        close(fd);
         return -EIO;
     }
+    (void)posix_fadvise(fd, (off_t)off, (off_t)len, POSIX_FADV_SEQUENTIAL);
 
-    *out_role = (user_role_t)role;
-    mdb_txn_abort(txn);
+    *out_fd = fd;
+    if(out_meta)
+        *out_meta = meta;
+    if(out_len)
+        *out_len = len;
     return 0;
 }
 
-static uint64_t now_secs(void)
+int db_data_open_for(const uint8_t principal[DB_ID_SIZE],
+                     const uint8_t data_id[DB_ID_SIZE], int *out_fd,
+                     DataMeta *out_meta)
 {
-    return (uint64_t)time(NULL);
-}
\ No newline at end of file
+    return db_data_open_range_for(principal, data_id, 0, 0, out_fd, out_meta,
+                                  NULL);
+}
+
+int db_data_send_for(const uint8_t principal[DB_ID_SIZE],
+                     const uint8_t data_id[DB_ID_SIZE], uint64_t off,
+                     uint64_t len, int out_fd, uint64_t *out_sent)
+{
+    if(out_sent)
+        *out_sent = 0;
+    if(out_fd < 0)
+        return -EINVAL;
+
+    int      fd = -1;
+    uint64_t n  = 0;
+    int      rc = db_data_open_range_for(principal, data_id, off, len, &fd,
+                                         NULL, &n);
+    if(rc != 0)
+        return rc;
+
+    size_t sent = 0;
+    if(fs_sendfile_range(out_fd, fd, (off_t)off, (size_t)n, &sent) != 0)
+        rc = -errno;
+    close(fd);
+    if(out_sent)
+        *out_sent = (uint64_t)sent;
+    return rc;
+}
+
+int db_data_add_from_fd(uint8_t owner[DB_ID_SIZE], int src_fd, const char *mime,
+                        uint8_t out_data_id[DB_ID_SIZE])
+{
+    if(!owner || src_fd < 0)
+        return -EINVAL;
+
+    /* Permission check: owner must exist and be a publisher */
+    {
+        int prc = db_data_check_publisher(owner);
+        if(prc != 0)
+            return prc;
+    }
+    return data_add_fd(owner, src_fd, mime, NULL, out_data_id);
+}
+
+int db_data_add_from_buf(uint8_t owner[DB_ID_SIZE], const void *buf,
+                         size_t len, const char *mime,
+                         uint8_t out_data_id[DB_ID_SIZE])
+{
+    if(!buf && len)
+        return -EINVAL;
+    struct iovec iov = {.iov_base = (void *)buf, .iov_len = len};
+    return db_data_add_from_iov(owner, &iov, 1, mime, out_data_id);
+}
+
+int db_data_add_from_iov(uint8_t owner[DB_ID_SIZE], const struct iovec *iov,
+                         int iovcnt, const char *mime,
+                         uint8_t out_data_id[DB_ID_SIZE])
+{
+    if(!owner || iovcnt < 0 || (iovcnt && !iov))
+        return -EINVAL;
+    size_t total = 0;
+    for(int i = 0; i < iovcnt; ++i)
+    {
+        if((!iov[i].iov_base && iov[i].iov_len) ||
+           iov[i].iov_len > SIZE_MAX - total)
+            return -EINVAL;
+        total += iov[i].iov_len;
+    }
+
+    /* Permission check: owner must exist and be a publisher */
+    {
+        int prc = db_data_check_publisher(owner);
+        if(prc != 0)
+            return prc;
+    }
+
+    /* Same placement as db_data_add_from_fd, hashed straight from the
+       caller's memory: small objects go inline or to a pack (gathered only
+       when scattered), large ones are chunked, the rest is written to a
+       temp with pwritev unless the content is already present */
+    Sha256         digest;
+    uint8_t       *flat   = NULL;
+    const uint8_t *inl    = NULL;
+    ChunkList      chunks = {0};
+    PackLoc        loc;
+    int            packed = 0;
+    size_t         max    = data_small_max();
+    if(max && total <= max)
+    {
+        inl = iovcnt == 1 ? iov[0].iov_base : NULL;
+        if(!inl)
+        {
+            flat = malloc(total ? total : 1);
+            if(!flat)
+                return -ENOMEM;
+            size_t off = 0;
+            for(int i = 0; i < iovcnt; ++i)
+            {
+                if(iov[i].iov_len)
+                    memcpy(flat + off, iov[i].iov_base, iov[i].iov_len);
+                off += iov[i].iov_len;
+            }
+            inl = flat;
+        }
+        if(crypt_digest_buf(inl, total, &digest) != 0)
+        {
+            free(flat);
+            return -EIO;
+        }
+        if(!data_goes_inline(total))
+        {
+            packed = data_pack_object(&digest, inl, total, &loc);
+            inl    = NULL;
+            if(packed < 0)
+            {
+                free(flat);
+                return -EIO;
+            }
+        }
+    }
+    else if(DB->cdc_avg && total > DB->cdc_avg * 8u)
+    {
+        /* the caller's bytes cannot change under the call: a hash-first
+           miss hands its digest to the chunker, which then only hashes
+           the chunks */
+        size_t got   = 0;
+        int    known = DB->dedup_hash_first &&
+                    crypt_digest_iov(iov, iovcnt, &digest) == 0;
+        if(known && data_content_present(&digest, total))
+            atomic_fetch_add(&DB->st_dedup_saved, (uint64_t)total);
+        else if(chunk_ingest_iov(iov, iovcnt, DB->cdc_avg, known, &digest,
+                                 &got, &chunks) != 0)
+            return -EIO;
+    }
+    else if(crypt_digest_iov(iov, iovcnt, &digest) != 0 ||
+            data_store_iov(iov, iovcnt, &digest, total) != 0)
+        return -EIO;
+
+    /* Upsert sha2data and data_meta in a single transaction */
+    int rc = data_index_commit(owner, &digest, total, mime, inl,
+                               packed ? &loc : NULL, chunks.n ? &chunks : NULL,
+                               NULL, out_data_id);
+
+    free(flat);
+    if(packed)
+        pack_release(DB->packs, &loc, 1);
+    chunk_list_free(&chunks);
+    return rc;
+}
+
+int db_data_add_batch(uint8_t owner[DB_ID_SIZE], size_t n, const int fds[],
+                      const char *const mimes[], uint8_t *out_ids,
+                      int out_status[])
+{
+    if(!owner || n == 0 || !fds || !out_status)
+        return -EINVAL;
+
+    /* Role is checked once for the whole batch */
+    {
+        int prc = db_data_check_publisher(owner);
+        if(prc != 0)
+            return prc;
+    }
+
+    int        rc      = 0;
+    Sha256    *digests = calloc(n, sizeof *digests);
+    uint64_t  *sizes   = calloc(n, sizeof *sizes);
+    FsTmp     *tmps    = DB->flusher ? calloc(n, sizeof *tmps) : NULL;
+    uint8_t  **inl     = data_small_max() ? calloc(n, sizeof *inl) : NULL;
+    PackLoc   *locs    = DB->pack_max ? calloc(n, sizeof *locs) : NULL;
+    ChunkList *chunks  = DB->cdc_avg ? calloc(n, sizeof *chunks) : NULL;
+    size_t     npinned = 0;
+    if(!digests || !sizes || (DB->flusher && !tmps) ||
+       (data_small_max() && !inl) || (DB->pack_max && !locs) ||
+       (DB->cdc_avg && !chunks))
+    {
+        free(tmps);
+        rc = -ENOMEM;
+        goto done;
+    }
+
+    /* Hash + copy + fsync + publish across the pool; in group mode the
+       workers only stage and the batch is synced/published once here */
+    BatchIngest bi = {.fds     = fds,
+                      .digests = digests,
+                      .sizes   = sizes,
+                      .status  = out_status,
+                      .tmps    = tmps,
+                      .inl     = inl,
+                      .defer   = inl && crypt_digest_lanes() > 1,
+                      .chunks  = chunks};
+    wp_parallel_for(n, DB->ingest_threads, batch_ingest_one, &bi);
+    if(bi.defer)
+    {
+        /* small items were only read: hash them together, several per
+           instruction on the multi-buffer backends (with one lane the
+           workers hashed them as they read them) */
+        batch_hash_small(n, &bi);
+    }
+    if(tmps)
+    {
+        rc = batch_publish_group(n, &bi);
+        free(tmps);
+        if(rc != 0)
+            goto done;
+    }
+
+    /* Small items that are not inline share the open pack and one sync */
+    if(locs)
+    {
+        rc = batch_pack_items(n, &bi, locs, &npinned);
+        if(rc != 0)
+            goto done;
+    }
+
+    /* One write txn indexes every stored object */
+    uint64_t created = now_secs();
+
+retry_chunk:
+    MDB_txn *txn = NULL;
+    int      mrc = mdb_txn_begin(DB->env, NULL, 0, &txn);
+    if(mrc != MDB_SUCCESS)
+    {
+        rc = db_map_mdb_err(mrc);
+        goto done;
+    }
+
+    for(size_t i = 0; i < n; ++i)
+    {
+        uint8_t *id = out_ids ? out_ids + i * DB_ID_SIZE : NULL;
+        uint8_t  tmp_id[DB_ID_SIZE];
+        if(!id)
+            id = tmp_id;
+        memset(id, 0, DB_ID_SIZE);
+
+        if(out_status[i] == -EIO)
+            continue; /* storage failed for this item */
+
+        mrc = data_index_put(txn, owner, &digests[i], sizes[i],
+                             mimes ? mimes[i] : NULL, created,
+                             inl ? inl[i] : NULL,
+                             locs && locs[i].pack ? &locs[i] : NULL,
+                             chunks && chunks[i].n ? &chunks[i] : NULL, id);
+        if(mrc == MDB_MAP_FULL)
+        {
+            mdb_txn_abort(txn);
+            int grc = db_env_mapsize_expand(); /* grow */
+            if(grc != 0)
+            {
+                rc = db_map_mdb_err(grc);
+                goto done;
+            }
+            goto retry_chunk; /* retry whole chunk */
+        }
+        if(mrc == MDB_KEYEXIST)
+        {
+            /* owner already holds this content: id is that record */
+            out_status[i] = -EEXIST;
+            continue;
+        }
+        if(mrc == MDB_NOTFOUND)
+        {
+            memset(id, 0, DB_ID_SIZE);
+            out_status[i] = -EAGAIN;
+            continue;
+        }
+        if(mrc != MDB_SUCCESS)
+        {
+            mdb_txn_abort(txn);
+            rc = db_map_mdb_err(mrc);
+            goto done;
+        }
+        out_status[i] = 0;
+    }
+
+    mrc = mdb_txn_commit(txn);
+    if(mrc == MDB_MAP_FULL)
+    {
+        int grc = db_env_mapsize_expand();
+        if(grc == 0)
+            goto retry_chunk;
+        mrc = grc;
+    }
+    rc = db_map_mdb_err(mrc);
+
+done:
+    if(locs)
+        pack_release(DB->packs, locs, n);
+    if(inl)
+        for(size_t i = 0; i < n; ++i)
+            free(inl[i]);
+    free(inl);
+    if(chunks)
+        for(size_t i = 0; i < n; ++i)
+            chunk_list_free(&chunks[i]);
+    free(chunks);
+    free(locs);
+    free(digests);
+    free(sizes);
+    return rc;
+}
+
+int db_data_delete(const uint8_t owner[DB_ID_SIZE],
+                   const uint8_t data_id[DB_ID_SIZE])
+{
+    if(!owner || !data_id)
+        return -EINVAL;
+
+    MDB_txn *txn = NULL;
+    if(mdb_txn_begin(DB->env, NULL, 0, &txn) != MDB_SUCCESS)
+        return -EIO;
+
+    /* must be owner */
+    {
+        int rc = acl_has_owner(txn, owner, data_id);
+        if(rc != 0)
+        {
+            mdb_txn_abort(txn);
+            return rc;
+        }
+    }
+
+    /* fetch meta (for blob path) */
+    DataMeta meta = {0};
+    {
+        MDB_val k  = {.mv_size = DB_ID_SIZE, .mv_data = (void *)data_id};
+        MDB_val v  = {0};
+        int     rc = mdb_get(txn, DB->db_data_id2meta, &k, &v);
+        if(rc == MDB_NOTFOUND)
+        {
+            mdb_txn_abort(txn);
+            return -ENOENT;
+        }
+        if(rc != MDB_SUCCESS || db_data_meta_decode(NULL, &v, &meta) != 0)
+        {
+            mdb_txn_abort(txn);
+            return -EIO;
+        }
+    }
+
+    /* nuke all ACLs for this data */
+    {
+        int rc = acl_data_destroy(txn, data_id);
+        if(rc != 0)
+        {
+            mdb_txn_abort(txn);
+            return rc == MDB_MAP_FULL ? db_map_mdb_err(rc) : rc;
+        }
+    }
+
+    /* drop this record's reference and meta */
+    char   hex[65];
+    Sha256 d;
+    memcpy(d.b, meta.sha, 32);
+    crypt_sha256_hex(&d, hex);
+
+    FsTmp retired = {.fd = -1, .name = {0}};
+    int   uncache = 0;
+    {
+        MDB_val sk = {.mv_size = 32, .mv_data = meta.sha};
+        MDB_val iv = {.mv_size = DB_ID_SIZE, .mv_data = (void *)data_id};
+        (void)mdb_del(txn, DB->db_data_sha2ids, &sk, &iv);
+
+        MDB_val mk = {.mv_size = DB_ID_SIZE, .mv_data = (void *)data_id};
+        (void)mdb_del(txn, DB->db_data_id2meta, &mk, NULL);
+
+        uint8_t otk[40];
+        owner_time_key(otk, meta.owner, meta.created_at, data_id);
+        MDB_val ok = {.mv_size = sizeof otk, .mv_data = otk};
+        (void)mdb_del(txn, DB->db_data_owner_time, &ok, NULL);
+
+        uint8_t osk[48];
+        owner_sha_key(osk, meta.owner, meta.sha);
+        MDB_val os = {.mv_size = sizeof osk, .mv_data = osk};
+        (void)mdb_del(txn, DB->db_data_owner_sha, &os, NULL);
+
+        /* last reference (trashed records keep the content too): move the
+           blob aside while the write txn is held, so a concurrent upload of
+           the same bytes either indexes first (and keeps it) or finds it
+           gone */
+        DataMeta any;
+        if(db_data_sha_any_meta(txn, &sk, &any) == MDB_NOTFOUND)
+        {
+            int rc = data_release_content(txn, &meta, hex, &retired, &uncache);
+            if(rc != MDB_SUCCESS)
+            {
+                mdb_txn_abort(txn);
+                return db_map_mdb_err(rc);
+            }
+        }
+    }
+
+    int mrc = mdb_txn_commit(txn);
+    if(mrc != MDB_SUCCESS)
+    {
+        if(retired.name[0])
+            (void)fs_objdir_restore_object(DB->objdir, &retired, hex);
+        return db_map_mdb_err(mrc);
+    }
+    meta_cache_drop(DB->meta_cache, data_id);
+
+    /* best-effort unlink (DB is source of truth) */
+    fs_objdir_tmp_discard(DB->objdir, &retired);
+    char cp[PATH_MAX];
+    if(uncache && data_cache_path(cp, sizeof cp, hex) == 0)
+        (void)unlink(cp);
+    return 0;
+}
+
+int db_data_delete_many(const uint8_t actor[DB_ID_SIZE], size_t n,
+                        const uint8_t *ids, int *out_status)
+{
+    if(!actor || (n && !ids))
+        return -EINVAL;
+
+    size_t trashed = 0;
+    int    rc      = 0;
+    for(size_t at = 0; at < n && rc == 0; at += DB_DELETE_TXN_MAX)
+    {
+        size_t m    = n - at < DB_DELETE_TXN_MAX ? n - at : DB_DELETE_TXN_MAX;
+        size_t done = 0;
+        rc          = data_trash_txn(actor, m, ids + at * DB_ID_SIZE,
+                                     out_status ? out_status + at : NULL, &done);
+        trashed += done;
+        if(rc != 0 && out_status)
+            for(size_t i = at; i < n; ++i)
+                out_status[i] = rc;
+    }
+
+    /* content past the grace period goes now, off the caller's thread */
+    if(trashed)
+        trash_reaper_kick();
+    return rc;
+}
+
+int db_data_undelete(const uint8_t actor[DB_ID_SIZE],
+                     const uint8_t data_id[DB_ID_SIZE])
+{
+    if(!actor || !data_id)
+        return -EINVAL;
+
+retry_chunk:
+    MDB_txn *txn = NULL;
+    int      mrc = mdb_txn_begin(DB->env, NULL, 0, &txn);
+    if(mrc != MDB_SUCCESS)
+        return db_map_mdb_err(mrc);
+
+    /* copy the record out: the trash entry goes before it is re-indexed */
+    uint8_t  rec[sizeof(DataMetaV0)];
+    DataMeta meta;
+    MDB_val  raw = {0};
+    uint64_t at  = 0;
+    mrc          = trash_get(txn, data_id, &raw, &at);
+    if(mrc != MDB_SUCCESS)
+    {
+        mdb_txn_abort(txn);
+        return mrc == MDB_NOTFOUND ? -ENOENT : -EIO;
+    }
+    /* past the reaper's deadline: gone, whether or not it has run yet */
+    if(at + DB->trash_grace <= now_secs())
+    {
+        mdb_txn_abort(txn);
+        return -ENOENT;
+    }
+    if(raw.mv_size > sizeof rec || db_data_meta_decode(NULL, &raw, &meta) != 0)
+    {
+        mdb_txn_abort(txn);
+        return -EIO;
+    }
+    memcpy(rec, raw.mv_data, raw.mv_size);
+    raw.mv_data = rec;
+    if(memcmp(meta.owner, actor, DB_ID_SIZE) != 0)
+    {
+        mdb_txn_abort(txn);
+        return -EPERM;
+    }
+
+    /* one record per (content, owner) */
+    MDB_val sk   = {.mv_size = 32, .mv_data = meta.sha};
+    uint8_t other[DB_ID_SIZE];
+    size_t  refs = 0;
+    mrc          = data_sha_find_owned(txn, actor, &sk, other, &refs);
+    if(mrc != MDB_NOTFOUND)
+    {
+        mdb_txn_abort(txn);
+        return mrc == MDB_SUCCESS ? -EEXIST : -EIO;
+    }
+
+    MDB_val mk = {.mv_size = DB_ID_SIZE, .mv_data = (void *)data_id};
+    mrc        = trash_del(txn, data_id, meta.sha);
+    if(mrc == MDB_SUCCESS)
+        mrc = mdb_put(txn, DB->db_data_id2meta, &mk, &raw, MDB_NOOVERWRITE);
+    if(mrc == MDB_SUCCESS)
+        mrc = mdb_put(txn, DB->db_data_sha2ids, &sk, &mk, MDB_NODUPDATA);
+    if(mrc == MDB_SUCCESS)
+        mrc = db_data_owner_index_put(txn, &meta, data_id);
+    if(mrc == MDB_SUCCESS)
+    {
+        int arc = acl_grant_owner(txn, actor, data_id);
+        mrc     = arc == 0 || arc == MDB_MAP_FULL ? arc : -arc;
+    }
+    if(mrc == MDB_SUCCESS)
+        mrc = mdb_txn_commit(txn);
+    else
+        mdb_txn_abort(txn);
+    if(mrc == MDB_MAP_FULL)
+    {
+        int grc = db_env_mapsize_expand(); /* grow */
+        if(grc != 0)
+            return db_map_mdb_err(grc);
+        goto retry_chunk;
+    }
+    return mrc == MDB_SUCCESS ? 0 : db_map_mdb_err(mrc);
+}
+
+int db_data_reap(size_t max, size_t *out_reaped)
+{
+    if(out_reaped)
+        *out_reaped = 0;
+    if(!DB || !DB->env)
+        return -EINVAL;
+
+    size_t total = 0;
+    int    rc    = 0;
+    for(;;)
+    {
+        size_t want = DB_DELETE_TXN_MAX;
+        if(max && max - total < want)
+            want = max - total;
+        size_t got = 0;
+        rc         = data_reap_txn(want, &got);
+        total += got;
+        if(rc != 0 || got < want || (max && total >= max))
+            break;
+    }
+    if(out_reaped)
+        *out_reaped = total;
+    return rc;
+}
+
+int db_data_upgrade_metas(size_t max, size_t *out_upgraded)
+{
+    if(out_upgraded)
+        *out_upgraded = 0;
+
+retry_chunk:
+    MDB_txn *txn = NULL;
+    int      mrc = mdb_txn_begin(DB->env, NULL, 0, &txn);
+    if(mrc != MDB_SUCCESS)
+        return db_map_mdb_err(mrc);
+
+    /* collect first: rewriting under a live cursor would move it */
+    uint8_t    *keys = NULL;
+    size_t      nk   = 0, cap = 0;
+    MDB_cursor *cur  = NULL;
+    mrc              = mdb_cursor_open(txn, DB->db_data_id2meta, &cur);
+    if(mrc != MDB_SUCCESS)
+    {
+        mdb_txn_abort(txn);
+        return db_map_mdb_err(mrc);
+    }
+    MDB_val k = {0}, v = {0};
+    for(mrc = mdb_cursor_get(cur, &k, &v, MDB_FIRST);
+        mrc == MDB_SUCCESS && (max == 0 || nk < max);
+        mrc = mdb_cursor_get(cur, &k, &v, MDB_NEXT))
+    {
+        if(k.mv_size != DB_ID_SIZE || v.mv_size != sizeof(DataMetaV0) ||
+           (*(const uint8_t *)v.mv_data &
+            ~(DATA_META_F_MASK | DATA_META_F_DIGEST)) != DATA_META_V0)
+            continue;
+        if(nk == cap)
+        {
+            size_t   ncap  = cap ? cap * 2 : 256;
+            uint8_t *nkeys = realloc(keys, ncap * DB_ID_SIZE);
+            if(!nkeys)
+            {
+                mrc = ENOMEM;
+                break;
+            }
+            keys = nkeys;
+            cap  = ncap;
+        }
+        memcpy(keys + nk++ * DB_ID_SIZE, k.mv_data, DB_ID_SIZE);
+    }
+    mdb_cursor_close(cur);
+    if(mrc != MDB_SUCCESS && mrc != MDB_NOTFOUND)
+    {
+        mdb_txn_abort(txn);
+        free(keys);
+        return db_map_mdb_err(mrc);
+    }
+
+    size_t done = 0;
+    mrc         = MDB_SUCCESS;
+    for(size_t i = 0; i < nk && mrc == MDB_SUCCESS; ++i)
+    {
+        MDB_val  mk = {.mv_size = DB_ID_SIZE,
+                       .mv_data = keys + i * DB_ID_SIZE};
+        MDB_val  mv = {0};
+        DataMeta m;
+        if(mdb_get(txn, DB->db_data_id2meta, &mk, &mv) != MDB_SUCCESS ||
+           db_data_meta_decode(NULL, &mv, &m) != 0)
+            continue;
+
+        uint16_t mime_id = 0;
+        int      irc     = mime_intern(txn, m.mime, &mime_id);
+        if(irc == -ENOSPC)
+            break; /* dictionary full: the rest stays v0 */
+        if(irc != 0)
+        {
+            mrc = irc == MDB_MAP_FULL ? irc : -irc;
+            break;
+        }
+
+        Sha256 d;
+        memcpy(d.b, m.sha, 32);
+        MDB_val nv = {.mv_size = sizeof(DataMetaRec), .mv_data = NULL};
+        mrc = mdb_put(txn, DB->db_data_id2meta, &mk, &nv, MDB_RESERVE);
+        if(mrc == MDB_SUCCESS)
+        {
+            write_data_meta_rec(nv.mv_data, &d, mime_id, m.size, m.created_at,
+                                m.owner, m.flags & DATA_META_F_MASK);
+            ++done;
+        }
+    }
+    if(mrc == MDB_MAP_FULL)
+    {
+        mdb_txn_abort(txn);
+        free(keys);
+        int grc = db_env_mapsize_expand(); /* grow */
+        if(grc != 0)
+            return db_map_mdb_err(grc);
+        goto retry_chunk; /* retry whole chunk */
+    }
+    if(mrc != MDB_SUCCESS)
+    {
+        mdb_txn_abort(txn);
+        free(keys);
+        return db_map_mdb_err(mrc);
+    }
+
+    mrc = mdb_txn_commit(txn);
+    if(mrc == MDB_SUCCESS) /* cached copies carry the old version */
+        for(size_t i = 0; i < nk; ++i)
+            meta_cache_drop(DB->meta_cache, keys + i * DB_ID_SIZE);
+    free(keys);
+    if(mrc == MDB_MAP_FULL)
+    {
+        int grc = db_env_mapsize_expand();
+        if(grc != 0)
+            return db_map_mdb_err(grc);
+        goto retry_chunk;
+    }
+    if(mrc != MDB_SUCCESS)
+        return db_map_mdb_err(mrc);
+    if(out_upgraded)
+        *out_upgraded = done;
+    return 0;
+}
+
+int db_data_list_by_owner(const uint8_t owner[DB_ID_SIZE],
+                          uint8_t       page_token[DB_PAGE_TOKEN_SIZE],
+                          uint8_t *out_ids, size_t *inout_count)
+{
+    if(!owner || !page_token || !out_ids || !inout_count)
+        return -EINVAL;
+    size_t cap   = *inout_count;
+    *inout_count = 0;
+    if(cap == 0)
+        return 0;
+
+    static const uint8_t first[DB_PAGE_TOKEN_SIZE] = {0};
+
+    MDB_txn    *txn = NULL;
+    MDB_cursor *cur = NULL;
+    if(mdb_txn_begin(DB->env, NULL, MDB_RDONLY, &txn) != MDB_SUCCESS)
+        return -EIO;
+    if(mdb_cursor_open(txn, DB->db_data_owner_time, &cur) != MDB_SUCCESS)
+    {
+        mdb_txn_abort(txn);
+        return -EIO;
+    }
+
+    /* seek just past the last row handed out (or past the owner's newest),
+       then walk backwards: O(page) whatever the owner's total */
+    uint8_t seek[40];
+    memcpy(seek, owner, DB_ID_SIZE);
+    if(memcmp(page_token, first, DB_PAGE_TOKEN_SIZE) == 0)
+        memset(seek + DB_ID_SIZE, 0xFF, DB_PAGE_TOKEN_SIZE);
+    else
+        memcpy(seek + DB_ID_SIZE, page_token, DB_PAGE_TOKEN_SIZE);
+
+    MDB_val k  = {.mv_size = sizeof seek, .mv_data = seek};
+    MDB_val v  = {0};
+    int     rc = mdb_cursor_get(cur, &k, &v, MDB_SET_RANGE);
+    if(rc == MDB_SUCCESS)
+        rc = mdb_cursor_get(cur, &k, &v, MDB_PREV);
+    else if(rc == MDB_NOTFOUND)
+        rc = mdb_cursor_get(cur, &k, &v, MDB_LAST);
+
+    size_t n = 0;
+    while(rc == MDB_SUCCESS && n < cap)
+    {
+        const uint8_t *key = (const uint8_t *)k.mv_data;
+        if(k.mv_size != sizeof seek || memcmp(key, owner, DB_ID_SIZE) != 0)
+            break;
+        memcpy(out_ids + n * DB_ID_SIZE, key + DB_ID_SIZE + 8, DB_ID_SIZE);
+        memcpy(page_token, key + DB_ID_SIZE, DB_PAGE_TOKEN_SIZE);
+        ++n;
+        rc = mdb_cursor_get(cur, &k, &v, MDB_PREV);
+    }
+
+    mdb_cursor_close(cur);
+    mdb_txn_abort(txn);
+    if(rc != MDB_SUCCESS && rc != MDB_NOTFOUND)
+        return -EIO;
+    *inout_count = n;
+    return 0;
+}
+
+int db_data_scan_time_range(uint64_t t0_ms, uint64_t t1_ms,
+                            uint8_t cursor[DB_ID_SIZE], size_t limit,
+                            db_data_scan_cb cb, void *user,
+                            size_t *out_visited)
+{
+    if(out_visited)
+        *out_visited = 0;
+    if(!cursor || !cb || t0_ms > t1_ms)
+        return -EINVAL;
+    if(limit == 0 || t0_ms == t1_ms)
+        return 0;
+
+    static const uint8_t first[DB_ID_SIZE] = {0};
+
+    MDB_txn    *txn = NULL;
+    MDB_cursor *cur = NULL;
+    if(mdb_txn_begin(DB->env, NULL, MDB_RDONLY, &txn) != MDB_SUCCESS)
+        return -EIO;
+    if(mdb_cursor_open(txn, DB->db_data_id2meta, &cur) != MDB_SUCCESS)
+    {
+        mdb_txn_abort(txn);
+        return -EIO;
+    }
+
+    /* synthetic UUIDv7 for t0 (or the resume id) as the seek key */
+    int     resume = memcmp(cursor, first, DB_ID_SIZE) != 0;
+    uint8_t seek[DB_ID_SIZE];
+    if(resume)
+        memcpy(seek, cursor, DB_ID_SIZE);
+    else
+        uuid_v7_floor(t0_ms, seek);
+
+    MDB_val k  = {.mv_size = DB_ID_SIZE, .mv_data = seek};
+    MDB_val v  = {0};
+    int     rc = mdb_cursor_get(cur, &k, &v, MDB_SET_RANGE);
+    if(rc == MDB_SUCCESS && resume && k.mv_size == DB_ID_SIZE &&
+       memcmp(k.mv_data, cursor, DB_ID_SIZE) == 0)
+        rc = mdb_cursor_get(cur, &k, &v, MDB_NEXT);
+
+    size_t n    = 0;
+    int    derr = 0;
+    while(rc == MDB_SUCCESS && n < limit)
+    {
+        const uint8_t *id = (const uint8_t *)k.mv_data;
+        if(k.mv_size != DB_ID_SIZE || uuid_v7_ms(id) >= t1_ms)
+            break;
+        DataMeta m;
+        derr = db_data_meta_decode(txn, &v, &m);
+        if(derr != 0)
+            break;
+        memcpy(cursor, id, DB_ID_SIZE);
+        ++n;
+        if(cb(id, &m, user) != 0)
+            break;
+        rc = mdb_cursor_get(cur, &k, &v, MDB_NEXT);
+    }
+
+    mdb_cursor_close(cur);
+    mdb_txn_abort(txn);
+    if(out_visited)
+        *out_visited = n;
+    if(derr != 0 || (rc != MDB_SUCCESS && rc != MDB_NOTFOUND))
+        return -EIO;
+    return 0;
+}
+
+int db_data_owner_index_put(MDB_txn *txn, const DataMeta *meta,
+                            const uint8_t data_id[DB_ID_SIZE])
+{
+    uint8_t key[40];
+    uint8_t one = 1;
+    owner_time_key(key, meta->owner, meta->created_at, data_id);
+    MDB_val k   = {.mv_size = sizeof key, .mv_data = key};
+    MDB_val v   = {.mv_size = sizeof one, .mv_data = &one};
+    int     mrc = mdb_put(txn, DB->db_data_owner_time, &k, &v, 0);
+    if(mrc != MDB_SUCCESS)
+        return mrc;
+
+    uint8_t osk[48];
+    owner_sha_key(osk, meta->owner, meta->sha);
+    MDB_val ok = {.mv_size = sizeof osk, .mv_data = osk};
+    MDB_val iv = {.mv_size = DB_ID_SIZE, .mv_data = (void *)data_id};
+    return mdb_put(txn, DB->db_data_owner_sha, &ok, &iv, 0);
+}
+
+int db_data_meta_decode(MDB_txn *txn, const MDB_val *v, DataMeta *out)
+{
+    if(!v || !v->mv_data)
+        return -EINVAL;
+    const uint8_t raw = *(const uint8_t *)v->mv_data;
+    const uint8_t ver =
+        raw & (uint8_t)~(DATA_META_F_MASK | DATA_META_F_DIGEST);
+    if(ver == DATA_META_V0 && v->mv_size == sizeof(DataMetaV0))
+    {
+        if(!out)
+            return 0;
+        DataMetaV0 r0;
+        memcpy(&r0, v->mv_data, sizeof r0);
+        memset(out, 0, sizeof *out);
+        out->ver   = DATA_META_V0;
+        out->flags = raw & (uint8_t)(DATA_META_F_MASK | DATA_META_F_DIGEST);
+        memcpy(out->sha, r0.sha, 32);
+        memcpy(out->mime, r0.mime, sizeof out->mime);
+        out->mime[sizeof out->mime - 1] = '\0';
+        out->size                       = r0.size;
+        out->created_at                 = r0.created_at;
+        memcpy(out->owner, r0.owner, DB_ID_SIZE);
+        return 0;
+    }
+    if(ver != DATA_META_V1 || v->mv_size != sizeof(DataMetaRec))
+        return -EINVAL;
+    if(!out)
+        return 0;
+
+    /* v1: widen into the public layout, MIME from the dictionary */
+    DataMetaRec r;
+    memcpy(&r, v->mv_data, sizeof r);
+    memset(out, 0, sizeof *out);
+    out->ver   = DATA_META_V1;
+    out->flags = raw & (uint8_t)(DATA_META_F_MASK | DATA_META_F_DIGEST);
+    memcpy(out->sha, r.sha, 32);
+    out->size       = r.size;
+    out->created_at = r.created_at;
+    memcpy(out->owner, r.owner, DB_ID_SIZE);
+    return txn ? mime_lookup(txn, r.mime_id, out->mime) : 0;
+}
+
+int db_data_sha_any_meta(MDB_txn *txn, MDB_val *sha, DataMeta *out)
+{
+    MDB_val v   = {0};
+    int     mrc = mdb_get(txn, DB->db_data_sha2ids, sha, &v);
+    if(mrc == MDB_NOTFOUND && sha->mv_size == 32)
+        return trash_any_meta(txn, sha->mv_data, out);
+    if(mrc != MDB_SUCCESS)
+        return mrc;
+    if(v.mv_size != DB_ID_SIZE)
+        return MDB_CORRUPTED;
+    MDB_val mk = {.mv_size = DB_ID_SIZE, .mv_data = v.mv_data};
+    MDB_val mv = {0};
+    mrc        = mdb_get(txn, DB->db_data_id2meta, &mk, &mv);
+    if(mrc != MDB_SUCCESS)
+        return mrc;
+    return db_data_meta_decode(NULL, &mv, out) == 0 ? MDB_SUCCESS
+                                                    : MDB_CORRUPTED;
+}
+
+int db_data_check_publisher(const uint8_t owner[DB_ID_SIZE])
+{
+    user_role_t role = USER_ROLE_NONE;
+    int         prc  = db_user_get_role(owner, &role);
+    if(prc != 0)
+        return db_map_mdb_err(prc);
+    if(role != USER_ROLE_PUBLISHER)
+        return -EPERM;
+    return 0;
+}
+
+int db_data_add_staged(uint8_t owner[DB_ID_SIZE], int fd, const Sha256 *digest,
+                       size_t size, const char *mime,
+                       const uint8_t session[DB_ID_SIZE],
+                       uint8_t out_data_id[DB_ID_SIZE])
+{
+    /* content already stored: only the reference is new */
+    if(data_content_present(digest, size))
+    {
+        atomic_fetch_add(&DB->st_dedup_saved, (uint64_t)size);
+        return data_index_commit(owner, digest, size, mime, NULL, NULL, NULL,
+                                 session, out_data_id);
+    }
+
+    /* inline, packed, chunked or compressed placement: the regular ingest */
+    size_t max = data_small_max();
+    if((max && size <= max) || (DB->cdc_avg && size > DB->cdc_avg * 8u) ||
+       crypt_compression_level() > 0)
+    {
+        if(lseek(fd, 0, SEEK_SET) != 0)
+            return -EIO;
+        return data_add_fd(owner, fd, mime, session, out_data_id);
+    }
+
+    /* a plain blob: the staged file itself is linked in as the object,
+       data durable before the name exists, name durable before the index
+       (which also ends the session, so no append reaches the object) */
+    char hex[65];
+    crypt_sha256_hex(digest, hex);
+    int rc = -EAGAIN;
+    for(int tries = 0; tries < 2 && rc == -EAGAIN; ++tries)
+    {
+        FsTmp tmp = {.fd = dup(fd), .name = ""};
+        if(tmp.fd < 0)
+            return -EIO;
+        if(DB->flusher ? fs_flusher_sync(DB->flusher) != 0 : fsync(fd) != 0)
+        {
+            close(tmp.fd);
+            return -EIO;
+        }
+        if(fs_objdir_publish(DB->objdir, &tmp, hex) != 0 ||
+           (DB->flusher && fs_flusher_sync(DB->flusher) != 0))
+            return -EIO;
+        if(!DB->flusher)
+            atomic_fetch_add(&DB->st_fsyncs, 1);
+        atomic_fetch_add(&DB->st_objects, 1);
+        /* -EAGAIN: a delete retired the blob between publish and index */
+        rc = data_index_commit(owner, digest, size, mime, NULL, NULL, NULL,
+                               session, out_data_id);
+    }
+    return rc;
+}
+
+/****************************************************************************
+ * PRIVATE FUNCTIONS DEFINITIONS
+ ****************************************************************************
+ */
+
+static int db_user_get_role(const uint8_t id[DB_ID_SIZE], user_role_t *out_role)
+{
+    if(!id || !out_role)
+        return -EINVAL;
+
+    MDB_txn *txn = NULL;
+    if(mdb_txn_begin(DB->env, NULL, MDB_RDONLY, &txn) != MDB_SUCCESS)
+        return -EIO;
+
+    MDB_val k   = {.mv_size = DB_ID_SIZE, .mv_data = (void *)id};
+    MDB_val v   = {0};
+    int     mrc = mdb_get(txn, DB->db_user_id2data, &k, &v);
+    if(mrc != MDB_SUCCESS)
+    {
+        mdb_txn_abort(txn);
+        return db_map_mdb_err(mrc == MDB_NOTFOUND ? MDB_NOTFOUND : mrc);
+    }
+
+    uint8_t role = 0;
+    if(db_user_get_and_check_mem(&v, NULL, &role, NULL, NULL, NULL) != 0)
+    {
+        mdb_txn_abort(txn);
+        return -EIO;
+    }
+
+    *out_role = (user_role_t)role;
+    mdb_txn_abort(txn);
+    return 0;
+}
+
+static uint64_t now_secs(void)
+{
+    return (uint64_t)time(NULL);
+}
+
+static int data_index_put(MDB_txn *txn, const uint8_t owner[DB_ID_SIZE],
+                          const Sha256 *digest, uint64_t size,
+                          const char *mime, uint64_t created_at,
+                          const void *inl, const PackLoc *pack,
+                          const ChunkList *chunks, uint8_t out_id[DB_ID_SIZE])
+{
+    /* one record per (content, owner); other owners add a reference */
+    MDB_val shak = {.mv_size = 32, .mv_data = (void *)digest->b};
+    size_t  refs = 0;
+    int     mrc  = data_sha_find_owned(txn, owner, &shak, out_id, &refs);
+    if(mrc == MDB_SUCCESS)
+        return MDB_KEYEXIST;
+    if(mrc != MDB_NOTFOUND)
+        return mrc;
+    if(refs == 0)
+    {
+        /* trashed records still hold the content: follow them */
+        DataMeta held;
+        mrc = trash_any_meta(txn, digest->b, &held);
+        if(mrc == MDB_SUCCESS)
+            refs = 1;
+        else if(mrc != MDB_NOTFOUND)
+            return mrc;
+    }
+
+    /* first reference: inline bytes are stored (packed ones, chunks and
+       their manifest indexed) now; a blob or chunk this upload deduplicated
+       against may have been retired by a delete that committed in between.
+       Later references follow wherever the content lives. */
+    uint8_t flags = 0;
+    if(refs == 0 && inl)
+    {
+        MDB_val iv = {.mv_size = (size_t)size, .mv_data = NULL};
+        mrc        = mdb_put(txn, DB->db_data_inline, &shak, &iv, MDB_RESERVE);
+        if(mrc != MDB_SUCCESS)
+            return mrc;
+        memcpy(iv.mv_data, inl, (size_t)size);
+        flags = DB_DATA_F_INLINE;
+    }
+    else if(refs == 0 && pack)
+    {
+        mrc = pack_index_put(txn, digest->b, pack);
+        if(mrc != MDB_SUCCESS)
+            return mrc;
+        flags = DB_DATA_F_PACKED;
+    }
+    else if(refs == 0 && chunks)
+    {
+        mrc = chunk_manifest_put(txn, digest->b, chunks);
+        if(mrc != MDB_SUCCESS)
+            return mrc;
+        flags = DB_DATA_F_CHUNKED;
+    }
+    else if(refs == 0)
+    {
+        /* the published file, not this upload, says how it is stored: a
+           dedup hit keeps the bytes that were there */
+        char hex[65];
+        crypt_sha256_hex(digest, hex);
+        int fd = fs_objdir_open_object(DB->objdir, hex, O_RDONLY);
+        if(fd < 0)
+            return errno == ENOENT ? MDB_NOTFOUND : EIO;
+        int zrc = codec_stream_probe(fd);
+        close(fd);
+        if(zrc < 0)
+            return EIO;
+        if(zrc > 0)
+            flags = DB_DATA_F_ZLIB;
+    }
+    else
+    {
+        DataMeta any;
+        mrc = db_data_sha_any_meta(txn, &shak, &any);
+        if(mrc != MDB_SUCCESS)
+            return mrc;
+        flags = any.flags & DATA_META_F_MASK;
+    }
+
+    /* interned MIME => compact v1 record; a full dictionary falls back to v0 */
+    uint16_t mime_id     = 0;
+    int      inline_mime = DB->meta_inline_mime;
+    if(!inline_mime)
+    {
+        mrc = mime_intern(txn, mime, &mime_id);
+        if(mrc == MDB_MAP_FULL)
+            return mrc;
+        if(mrc != 0 && mrc != -ENOSPC)
+            return -mrc;
+        inline_mime = mrc == -ENOSPC;
+    }
+
+    /* generate new id (UUIDv7, monotonic => append) */
+    uuid_v7(out_id);
+
+    MDB_val datak = {.mv_size = DB_ID_SIZE, .mv_data = (void *)out_id};
+    MDB_val datav = {.mv_size = inline_mime ? sizeof(DataMetaV0)
+                                            : sizeof(DataMetaRec),
+                     .mv_data = NULL};
+
+    mrc = mdb_put(txn, DB->db_data_id2meta, &datak, &datav,
+                  MDB_NOOVERWRITE | MDB_RESERVE | MDB_APPEND);
+    if(mrc != MDB_SUCCESS)
+        return mrc;
+
+    MDB_val shav = {.mv_size = DB_ID_SIZE, .mv_data = (void *)out_id};
+    mrc          = mdb_put(txn, DB->db_data_sha2ids, &shak, &shav,
+                           MDB_NODUPDATA);
+    if(mrc != MDB_SUCCESS)
+        return mrc;
+
+    /* fill the record in-place (no stack buffer) */
+    if(inline_mime)
+        write_data_meta(datav.mv_data, digest, mime, size, created_at, owner,
+                        flags);
+    else
+        write_data_meta_rec(datav.mv_data, digest, mime_id, size, created_at,
+                            owner, flags);
+
+    {
+        DataMeta m;
+        memcpy(m.owner, owner, DB_ID_SIZE);
+        memcpy(m.sha, digest->b, 32);
+        m.created_at = created_at;
+        mrc          = db_data_owner_index_put(txn, &m, out_id);
+        if(mrc != MDB_SUCCESS)
+            return mrc;
+    }
+
+    /* MDB_MAP_FULL as is, -errno back to the positive code the callers
+       map with db_map_mdb_err */
+    mrc = acl_grant_owner(txn, owner, out_id);
+    return mrc == MDB_MAP_FULL ? mrc : -mrc;
+}
+
+static int data_sha_find_owned(MDB_txn *txn, const uint8_t owner[DB_ID_SIZE],
+                               MDB_val *sha, uint8_t out_id[DB_ID_SIZE],
+                               size_t *out_refs)
+{
+    *out_refs = 0;
+    uint8_t osk[48];
+    owner_sha_key(osk, owner, sha->mv_data);
+    MDB_val ok  = {.mv_size = sizeof osk, .mv_data = osk};
+    MDB_val iv  = {0};
+    int     mrc = mdb_get(txn, DB->db_data_owner_sha, &ok, &iv);
+    if(mrc == MDB_SUCCESS)
+    {
+        if(iv.mv_size != DB_ID_SIZE)
+            return MDB_CORRUPTED;
+        memcpy(out_id, iv.mv_data, DB_ID_SIZE);
+        return MDB_SUCCESS;
+    }
+    if(mrc != MDB_NOTFOUND)
+        return mrc;
+
+    MDB_cursor *cur = NULL;
+    mrc             = mdb_cursor_open(txn, DB->db_data_sha2ids, &cur);
+    if(mrc != MDB_SUCCESS)
+        return mrc;
+    MDB_val v = {0};
+    mrc       = mdb_cursor_get(cur, sha, &v, MDB_SET);
+    if(mrc == MDB_SUCCESS)
+        mrc = mdb_cursor_count(cur, out_refs);
+    mdb_cursor_close(cur);
+    return mrc == MDB_SUCCESS ? MDB_NOTFOUND : mrc;
+}
+
+static int data_resolve_sorted(size_t n, const uint8_t *ids, int status[],
+                               int with_mime, data_hit_fn hit, void *user)
+{
+    IdSlot *slots = malloc(n * sizeof *slots);
+    if(!slots)
+        return -ENOMEM;
+    for(size_t i = 0; i < n; ++i)
+    {
+        slots[i].id  = ids + i * DB_ID_SIZE;
+        slots[i].pos = i;
+    }
+    /* key order: neighbouring probes hit the same (hot) leaf pages */
+    qsort(slots, n, sizeof *slots, id_slot_cmp);
+
+    MDB_txn    *txn = NULL;
+    MDB_cursor *cur = NULL;
+    if(mdb_txn_begin(DB->env, NULL, MDB_RDONLY, &txn) != MDB_SUCCESS)
+    {
+        free(slots);
+        return -EIO;
+    }
+    if(mdb_cursor_open(txn, DB->db_data_id2meta, &cur) != MDB_SUCCESS)
+    {
+        mdb_txn_abort(txn);
+        free(slots);
+        return -EIO;
+    }
+
+    int      last = MDB_NOTFOUND;
+    DataMeta m;
+    for(size_t i = 0; i < n; ++i)
+    {
+        const IdSlot *s = &slots[i];
+        /* repeated id: reuse the previous probe */
+        if(i == 0 || memcmp(s->id, slots[i - 1].id, DB_ID_SIZE) != 0)
+        {
+            MDB_val k = {.mv_size = DB_ID_SIZE, .mv_data = (void *)s->id};
+            MDB_val v = {0};
+            last      = mdb_cursor_get(cur, &k, &v, MDB_SET);
+            if(last == MDB_SUCCESS &&
+               db_data_meta_decode(with_mime ? txn : NULL, &v, &m) != 0)
+                last = MDB_CORRUPTED;
+        }
+        if(last == MDB_SUCCESS)
+        {
+            status[s->pos] = 0;
+            hit(s->pos, &m, user);
+        }
+        else
+            status[s->pos] = last == MDB_NOTFOUND ? -ENOENT : -EIO;
+    }
+
+    mdb_cursor_close(cur);
+    mdb_txn_abort(txn);
+    free(slots);
+    return 0;
+}
+
+static int id_slot_cmp(const void *a, const void *b)
+{
+    const IdSlot *x = (const IdSlot *)a;
+    const IdSlot *y = (const IdSlot *)b;
+    int           c = memcmp(x->id, y->id, DB_ID_SIZE);
+    if(c != 0)
+        return c;
+    return (x->pos > y->pos) - (x->pos < y->pos);
+}
+
+static void meta_hit_copy(size_t pos, const DataMeta *meta, void *user)
+{
+    memcpy((DataMeta *)user + pos, meta, sizeof *meta);
+}
+
+static void path_hit_format(size_t pos, const DataMeta *meta, void *user)
+{
+    PathSink *ps = (PathSink *)user;
+    if(meta->flags & DATA_META_F_MASK)
+        ps->status[pos] = -ENODATA;
+    else
+        ps->status[pos] = data_format_path(ps->paths + pos * ps->path_sz,
+                                           ps->path_sz, meta->sha);
+}
+
+static int data_format_path(char *out, size_t out_sz, const uint8_t sha[32])
+{
+    char hex[65];
+    for(int i = 0; i < 32; ++i)
+        memcpy(hex + i * 2, HEX_PAIRS + sha[i] * 2, 2);
+    hex[64] = '\0';
+    /* the shard layout (and a running re-layout) is the object dir's */
+    if(fs_objdir_object_path(DB->objdir, hex, out, out_sz) != 0)
+        return errno == ENAMETOOLONG ? -ENAMETOOLONG : -EIO;
+    return 0;
+}
+
+static void batch_ingest_one(size_t i, void *user)
+{
+    BatchIngest *bi = (BatchIngest *)user;
+    size_t       sz = 0;
+    int          rc = -1;
+    if(bi->tmps)
+        bi->tmps[i].fd = -1;
+    if(bi->inl && bi->fds[i] >= 0)
+    {
+        rc = data_read_small(bi->fds[i], &bi->inl[i], &sz,
+                             bi->defer ? NULL : &bi->digests[i]);
+        if(rc != 0)
+        {
+            bi->sizes[i]  = (uint64_t)sz;
+            bi->status[i] = rc == 1 ? 0 : -EIO;
+            return;
+        }
+        rc = -1;
+    }
+    if(bi->chunks && bi->fds[i] >= 0)
+    {
+        rc = data_chunk_object(bi->fds[i], &bi->digests[i], &sz,
+                               &bi->chunks[i]);
+        if(rc != 0)
+        {
+            bi->sizes[i]  = (uint64_t)sz;
+            bi->status[i] = rc == 1 ? 0 : -EIO;
+            return;
+        }
+        rc = -1;
+    }
+    if(bi->fds[i] >= 0 &&
+       data_hash_first(bi->fds[i], &bi->digests[i], &sz) == 1)
+    {
+        bi->sizes[i]  = (uint64_t)sz;
+        bi->status[i] = 0;
+        return;
+    }
+    if(bi->fds[i] >= 0 && !bi->tmps)
+    {
+        /* published (or found redundant) right here */
+        rc            = data_store_object(bi->fds[i], &bi->digests[i], &sz);
+        bi->sizes[i]  = (uint64_t)sz;
+        bi->status[i] = rc == 0 ? 0 : -EIO;
+        return;
+    }
+    if(bi->fds[i] >= 0)
+        rc = crypt_stage_sha256_object_from_fd(DB->objdir, bi->fds[i],
+                                               &bi->tmps[i], &bi->digests[i],
+                                               &sz, 0);
+    if(rc != 0)
+    {
+        bi->status[i] = -EIO;
+        return;
+    }
+    bi->sizes[i]  = (uint64_t)sz;
+    bi->status[i] = 0;
+}
+
+static int data_hash_first(int src_fd, Sha256 *digest, size_t *size)
+{
+    struct stat sst;
+    if(!DB->dedup_hash_first || fstat(src_fd, &sst) != 0 ||
+       !S_ISREG(sst.st_mode))
+        return 0;
+    off_t off = lseek(src_fd, 0, SEEK_CUR);
+    if(off == (off_t)-1 || sst.st_size < off)
+        return 0;
+    size_t len = (size_t)(sst.st_size - off);
+    if(crypt_digest_fd_range(src_fd, off, len, digest) != 0)
+        return 0;
+
+    if(!data_content_present(digest, len))
+        return 0;
+
+    (void)lseek(src_fd, off + (off_t)len, SEEK_SET);
+    *size = len;
+    atomic_fetch_add(&DB->st_dedup_saved, (uint64_t)len);
+    return 1;
+}
+
+static int data_content_present(const Sha256 *digest, size_t len)
+{
+    /* indexed content whose blob (or inline/packed/chunked copy) is
+       present: nothing to write */
+    MDB_txn *txn   = NULL;
+    DataMeta any   = {0};
+    int      known = 0;
+    if(mdb_txn_begin(DB->env, NULL, MDB_RDONLY, &txn) == MDB_SUCCESS)
+    {
+        MDB_val k = {.mv_size = 32, .mv_data = (void *)digest->b};
+        known     = db_data_sha_any_meta(txn, &k, &any) == MDB_SUCCESS &&
+                any.size == (uint64_t)len;
+        mdb_txn_abort(txn);
+    }
+    if(!known)
+        return 0;
+    if(any.flags & (DB_DATA_F_INLINE | DB_DATA_F_PACKED | DB_DATA_F_CHUNKED))
+        return 1;
+
+    char        hex[65];
+    struct stat ost;
+    crypt_sha256_hex(digest, hex);
+    return fs_objdir_stat_object(DB->objdir, hex, &ost) == 0 &&
+           ((any.flags & DB_DATA_F_ZLIB) || (size_t)ost.st_size == len);
+}
+
+static int data_index_commit(uint8_t owner[DB_ID_SIZE], const Sha256 *digest,
+                             size_t size, const char *mime, const void *inl,
+                             const PackLoc *pack, const ChunkList *chunks,
+                             const uint8_t *upload, uint8_t out_id[DB_ID_SIZE])
+{
+    uint8_t  data_id[DB_ID_SIZE] = {0};
+    uint64_t created_at          = now_secs();
+
+retry_chunk:
+    MDB_txn *txn = NULL;
+
+    int mrc = mdb_txn_begin(DB->env, NULL, 0, &txn);
+    if(mrc != MDB_SUCCESS)
+        return db_map_mdb_err(mrc);
+
+    mrc = data_index_put(txn, owner, digest, (uint64_t)size, mime, created_at,
+                         inl, pack, chunks, data_id);
+    if(mrc == MDB_NOTFOUND)
+    {
+        mdb_txn_abort(txn);
+        return -EAGAIN; /* blob deleted under us: upload again */
+    }
+    if(mrc == MDB_SUCCESS && upload)
+    {
+        /* the session ends with the index: it never outlives its object */
+        MDB_val uk = {.mv_size = DB_ID_SIZE, .mv_data = (void *)upload};
+        mrc        = mdb_del(txn, DB->db_data_uploads, &uk, NULL);
+        if(mrc == MDB_NOTFOUND)
+        {
+            mdb_txn_abort(txn);
+            return -ENOENT;
+        }
+    }
+    if(mrc == MDB_MAP_FULL)
+    {
+        mdb_txn_abort(txn);
+        int grc = db_env_mapsize_expand(); /* grow */
+        if(grc != 0)
+            return db_map_mdb_err(grc); /* stop if grow failed */
+        goto retry_chunk;               /* retry whole chunk */
+    }
+    if(mrc != MDB_SUCCESS)
+    {
+        mdb_txn_abort(txn);
+        return db_map_mdb_err(mrc);
+    }
+
+    mrc = mdb_txn_commit(txn);
+    if(mrc == MDB_MAP_FULL)
+    {
+        int grc = db_env_mapsize_expand();
+        if(grc != 0)
+            return db_map_mdb_err(grc); /* stop if grow failed */
+        goto retry_chunk;
+    }
+    if(mrc != MDB_SUCCESS)
+        return db_map_mdb_err(mrc); /* txn is already aborted/freed */
+    if(out_id)
+        memcpy(out_id, data_id, DB_ID_SIZE);
+    return 0;
+}
+
+static int data_add_fd(uint8_t owner[DB_ID_SIZE], int src_fd,
+                       const char *mime, const uint8_t *upload,
+                       uint8_t out_data_id[DB_ID_SIZE])
+{
+    /* Small regular files go inline or to a pack, large ones are chunked
+       (DB_CDC_AVG_KB); anything else takes the one-pass ingest:
+       stream → temp → fsync → atomic publish; digest+size */
+    Sha256    digest;
+    size_t    total  = 0;
+    uint8_t  *inl    = NULL;
+    ChunkList chunks = {0};
+    int       small  = data_read_small(src_fd, &inl, &total, &digest);
+    if(small < 0)
+        return -EIO;
+    int chunked = small ? 0
+                        : data_chunk_object(src_fd, &digest, &total, &chunks);
+    if(chunked < 0)
+        return -EIO;
+    if(!small && !chunked && data_store_object(src_fd, &digest, &total) != 0)
+        return -EIO;
+
+    PackLoc loc;
+    int     packed = 0;
+    if(small && !data_goes_inline(total))
+    {
+        packed = data_pack_object(&digest, inl, total, &loc);
+        free(inl);
+        inl = NULL;
+        if(packed < 0)
+            return -EIO;
+    }
+
+    /* Upsert sha2data and data_meta in a single transaction */
+    int rc = data_index_commit(owner, &digest, total, mime, inl,
+                               packed ? &loc : NULL, chunks.n ? &chunks : NULL,
+                               upload, out_data_id);
+
+    free(inl);
+    if(packed)
+        pack_release(DB->packs, &loc, 1);
+    chunk_list_free(&chunks);
+    return rc;
+}
+
+static int data_store_iov(const struct iovec *iov, int iovcnt,
+                          const Sha256 *digest, size_t size)
+{
+    if(data_content_present(digest, size))
+    {
+        atomic_fetch_add(&DB->st_dedup_saved, (uint64_t)size);
+        return 0;
+    }
+
+    /* data durable before the name exists, name durable before the index */
+    FsTmp tmp;
+    if(crypt_stage_object_from_iov(DB->objdir, iov, iovcnt, &tmp,
+                                   !DB->flusher) != 0)
+        return -EIO;
+    if(DB->flusher && fs_flusher_sync(DB->flusher) != 0)
+    {
+        fs_objdir_tmp_discard(DB->objdir, &tmp);
+        return -EIO;
+    }
+    char hex[65];
+    crypt_sha256_hex(digest, hex);
+    if(fs_objdir_publish(DB->objdir, &tmp, hex) != 0 ||
+       (DB->flusher && fs_flusher_sync(DB->flusher) != 0))
+        return -EIO;
+    if(!DB->flusher)
+        atomic_fetch_add(&DB->st_fsyncs, 1);
+    atomic_fetch_add(&DB->st_objects, 1);
+    return 0;
+}
+
+static int data_store_object(int src_fd, Sha256 *digest, size_t *size)
+{
+    if(data_hash_first(src_fd, digest, size) == 1)
+        return 0;
+
+    /* data durable before the name exists, name durable before the index */
+    FsTmp tmp;
+    if(crypt_stage_sha256_object_from_fd(DB->objdir, src_fd, &tmp, digest,
+                                         size, !DB->flusher) != 0)
+        return -EIO;
+    if(!DB->flusher)
+        atomic_fetch_add(&DB->st_fsyncs, 1);
+    if(data_stage_redundant(&tmp, digest, *size))
+        return 0;
+    if(DB->flusher && fs_flusher_sync(DB->flusher) != 0)
+    {
+        fs_objdir_tmp_discard(DB->objdir, &tmp);
+        return -EIO;
+    }
+    char hex[65];
+    crypt_sha256_hex(digest, hex);
+    if(fs_objdir_publish(DB->objdir, &tmp, hex) != 0 ||
+       (DB->flusher && fs_flusher_sync(DB->flusher) != 0))
+        return -EIO;
+    atomic_fetch_add(&DB->st_objects, 1);
+    return 0;
+}
+
+static int data_stage_redundant(FsTmp *tmp, const Sha256 *digest,
+                                size_t size)
+{
+    if(!data_content_present(digest, size))
+        return 0;
+    fs_objdir_tmp_discard(DB->objdir, tmp);
+    atomic_fetch_add(&DB->st_dedup_saved, (uint64_t)size);
+    return 1;
+}
+
+static int data_chunk_object(int src_fd, Sha256 *digest, size_t *size,
+                             ChunkList *out)
+{
+    struct stat sst;
+    memset(out, 0, sizeof *out);
+    if(!DB->cdc_avg || fstat(src_fd, &sst) != 0 || !S_ISREG(sst.st_mode))
+        return 0;
+    off_t off = lseek(src_fd, 0, SEEK_CUR);
+    if(off == (off_t)-1 || sst.st_size < off ||
+       (uint64_t)(sst.st_size - off) <= (uint64_t)DB->cdc_avg * 8u)
+        return 0; /* one chunk at most: a plain blob is cheaper */
+
+    if(data_hash_first(src_fd, digest, size) == 1)
+        return 1;
+    return chunk_ingest_fd(src_fd, DB->cdc_avg, digest, size, out) == 0 ? 1
+                                                                        : -EIO;
+}
+
+static int batch_publish_group(size_t n, BatchIngest *bi)
+{
+    /* content indexed meanwhile needs neither the sync nor the blob */
+    for(size_t i = 0; i < n; ++i)
+        if(bi->tmps[i].fd >= 0)
+            (void)data_stage_redundant(&bi->tmps[i], &bi->digests[i],
+                                       (size_t)bi->sizes[i]);
+
+    int src = fs_flusher_sync(DB->flusher);
+    for(size_t i = 0; i < n; ++i)
+    {
+        if(bi->tmps[i].fd < 0)
+            continue;
+        if(src != 0)
+        {
+            fs_objdir_tmp_discard(DB->objdir, &bi->tmps[i]);
+            bi->status[i] = -EIO;
+            continue;
+        }
+        char hex[65];
+        crypt_sha256_hex(&bi->digests[i], hex);
+        if(fs_objdir_publish(DB->objdir, &bi->tmps[i], hex) != 0)
+            bi->status[i] = -EIO;
+        else
+            atomic_fetch_add(&DB->st_objects, 1);
+    }
+    if(src != 0 || fs_flusher_sync(DB->flusher) != 0)
+        return -EIO;
+    return 0;
+}
+
+static void batch_hash_small(size_t n, BatchIngest *bi)
+{
+    const void **p   = malloc(n * sizeof *p);
+    size_t      *len = malloc(n * sizeof *len);
+    size_t      *at  = malloc(n * sizeof *at);
+    Sha256      *d   = malloc(n * sizeof *d);
+    size_t       k   = 0;
+    if(!p || !len || !at || !d)
+    {
+        for(size_t i = 0; i < n; ++i)
+            if(bi->inl[i] && bi->status[i] == 0 &&
+               crypt_digest_buf(bi->inl[i], (size_t)bi->sizes[i],
+                                &bi->digests[i]) != 0)
+                bi->status[i] = -EIO;
+        goto done;
+    }
+    for(size_t i = 0; i < n; ++i)
+        if(bi->inl[i] && bi->status[i] == 0)
+        {
+            p[k]   = bi->inl[i];
+            len[k] = (size_t)bi->sizes[i];
+            at[k]  = i;
+            k++;
+        }
+    if(k && crypt_digest_many(k, p, len, d) != 0)
+    {
+        for(size_t j = 0; j < k; ++j)
+            bi->status[at[j]] = -EIO;
+        goto done;
+    }
+    for(size_t j = 0; j < k; ++j)
+        bi->digests[at[j]] = d[j];
+done:
+    free(p);
+    free(len);
+    free(at);
+    free(d);
+}
+
+static int data_read_small(int src_fd, uint8_t **out, size_t *len,
+                           Sha256 *digest)
+{
+    struct stat sst;
+    size_t      max = data_small_max();
+    if(!max || fstat(src_fd, &sst) != 0 || !S_ISREG(sst.st_mode))
+        return 0;
+    off_t off = lseek(src_fd, 0, SEEK_CUR);
+    if(off == (off_t)-1 || sst.st_size < off ||
+       (uint64_t)(sst.st_size - off) > max)
+        return 0;
+
+    /* one byte of slack tells a file that grew since fstat() */
+    size_t   cap = (size_t)(sst.st_size - off) + 1;
+    uint8_t *buf = malloc(cap);
+    if(!buf)
+        return -1;
+    size_t got = 0;
+    while(got < cap)
+    {
+        ssize_t rd = read(src_fd, buf + got, cap - got);
+        if(rd > 0)
+            got += (size_t)rd;
+        else if(rd == 0)
+            break;
+        else if(errno != EINTR)
+        {
+            free(buf);
+            return -1;
+        }
+    }
+    if(got > max || got == cap ||
+       (digest && crypt_digest_buf(buf, got, digest) != 0))
+    {
+        free(buf);
+        return lseek(src_fd, off, SEEK_SET) == off ? 0 : -1;
+    }
+    *out = buf;
+    *len = got;
+    return 1;
+}
+
+static int data_open_bytes(MDB_txn *txn, const DataMeta *meta, uint64_t off,
+                           uint64_t len)
+{
+    if(meta->flags & DB_DATA_F_INLINE)
+    {
+        MDB_val sk  = {.mv_size = 32, .mv_data = (void *)meta->sha};
+        MDB_val bv  = {0};
+        int     mrc = mdb_get(txn, DB->db_data_inline, &sk, &bv);
+        if(mrc != MDB_SUCCESS)
+            return db_map_mdb_err(mrc);
+        int fd = fs_memfd_from_buf("db_inline", bv.mv_data, bv.mv_size);
+        return fd >= 0 ? fd : -EIO;
+    }
+    if(meta->flags & DB_DATA_F_PACKED)
+    {
+        uint8_t *buf = malloc(meta->size ? (size_t)meta->size : 1);
+        if(!buf)
+            return -EIO;
+        int rc = data_pack_read(txn, meta, 0, buf, (size_t)meta->size);
+        int fd = rc == 0 ? fs_memfd_from_buf("db_packed", buf,
+                                             (size_t)meta->size)
+                         : rc;
+        free(buf);
+        return fd >= 0 || fd == -ENOENT ? fd : -EIO;
+    }
+    if(meta->flags & DB_DATA_F_CHUNKED)
+    {
+        /* the range only, from the chunk holding 'off', into an unnamed
+           file (objects can be large); the bytes before it stay a hole */
+        if(off > meta->size)
+            off = meta->size;
+        if(len == 0 || len > meta->size - off)
+            len = meta->size - off;
+        char dir[PATH_MAX];
+        snprintf(dir, sizeof dir, "%s/objects/cache", DB->root);
+        int fd = fs_tmpfile_in(dir);
+        if(fd < 0)
+            return -EIO;
+        int rc = lseek(fd, (off_t)off, SEEK_SET) == (off_t)off
+                     ? data_chunked_copy(txn, meta, off, len, fd)
+                     : -EIO;
+        if(rc == 0 && lseek(fd, 0, SEEK_SET) == 0)
+            return fd;
+        close(fd);
+        return rc == -ENOENT ? rc : -EIO;
+    }
+
+    int fd = data_open_object(meta);
+    if(fd < 0 || !(meta->flags & DB_DATA_F_ZLIB))
+        return fd;
+
+    /* compressed: only the range is inflated, from its nearest seek point,
+       into an unnamed file like chunked objects (a whole multi-GB object
+       must not land in anonymous memory); the bytes before 'off' stay a
+       hole */
+    if(off > meta->size)
+        off = meta->size;
+    if(len == 0 || len > meta->size - off)
+        len = meta->size - off;
+    char dir[PATH_MAX];
+    snprintf(dir, sizeof dir, "%s/objects/cache", DB->root);
+    int mfd = fs_tmpfile_in(dir);
+    if(mfd < 0 || lseek(mfd, (off_t)off, SEEK_SET) != (off_t)off)
+    {
+        if(mfd >= 0)
+            close(mfd);
+        close(fd);
+        return -EIO;
+    }
+    int zrc = data_zlib_stream(fd, off, len, fd_sink, &mfd);
+    if(zrc == 0 && lseek(mfd, 0, SEEK_SET) == 0)
+        return mfd;
+    close(mfd);
+    return zrc == -ENOMEM ? zrc : -EIO;
+}
+
+static int data_open_object(const DataMeta *meta)
+{
+    char   hex[65];
+    Sha256 d;
+    memcpy(d.b, meta->sha, 32);
+    crypt_sha256_hex(&d, hex);
+
+    /* openat on the cached shard dirfd: no path walk */
+    int fd = fs_objdir_open_object(DB->objdir, hex, O_RDONLY);
+    if(fd < 0)
+        return errno == ENOENT ? -ENOENT : -EIO;
+    return fd;
+}
+
+static int data_read_begin(MDB_txn **txn, uint64_t *ticket)
+{
+    *ticket = pack_reader_enter(DB->packs);
+    if(mdb_txn_begin(DB->env, NULL, MDB_RDONLY, txn) == MDB_SUCCESS)
+        return 0;
+    pack_reader_exit(DB->packs, *ticket);
+    return -EIO;
+}
+
+static void data_read_end(MDB_txn *txn, uint64_t ticket)
+{
+    mdb_txn_abort(txn);
+    pack_reader_exit(DB->packs, ticket);
+}
+
+static int data_zlib_stream(int fd, uint64_t off, uint64_t len,
+                            db_data_sink_cb sink, void *user)
+{
+    CodecRd *r   = codec_inflate_open(fd, off);
+    uint8_t *buf = r ? malloc(DATA_STREAM_BUFSZ) : NULL;
+    int      rc  = !r ? (errno == ENOMEM ? -ENOMEM : -EIO)
+                      : buf ? 0
+                            : -ENOMEM;
+    uint64_t done = 0;
+    while(rc == 0 && done < len)
+    {
+        size_t want = len - done < DATA_STREAM_BUFSZ ? (size_t)(len - done)
+                                                     : DATA_STREAM_BUFSZ;
+        size_t got  = 0;
+        rc          = codec_inflate_read(r, buf, want, &got);
+        if(rc == 0 && got == 0)
+            rc = -EIO; /* the stream is shorter than the meta */
+        if(rc == 0)
+            rc = sink(buf, got, user);
+        done += got;
+    }
+    free(buf);
+    codec_inflate_close(r);
+    close(fd);
+    return rc;
+}
+
+static int data_pack_object(const Sha256 *digest, const uint8_t *buf,
+                            size_t len, PackLoc *out)
+{
+    /* content already indexed: this upload only adds a reference */
+    MDB_txn *txn = NULL;
+    if(mdb_txn_begin(DB->env, NULL, MDB_RDONLY, &txn) != MDB_SUCCESS)
+        return -EIO;
+    MDB_val k     = {.mv_size = 32, .mv_data = (void *)digest->b};
+    MDB_val v     = {0};
+    int     known = mdb_get(txn, DB->db_data_sha2ids, &k, &v) == MDB_SUCCESS;
+    mdb_txn_abort(txn);
+    if(known)
+        return 0;
+
+    if(pack_append(DB->packs, buf, len, out) != 0)
+        return -EIO;
+    int src = DB->flusher ? fs_flusher_sync(DB->flusher)
+                          : pack_sync(DB->packs);
+    if(src < 0)
+    {
+        pack_release(DB->packs, out, 1);
+        return -EIO;
+    }
+    if(!DB->flusher && src == 1)
+        atomic_fetch_add(&DB->st_fsyncs, 1);
+    atomic_fetch_add(&DB->st_objects, 1);
+    return 1;
+}
+
+static int batch_pack_items(size_t n, BatchIngest *bi, PackLoc *locs,
+                            size_t *out_pinned)
+{
+    *out_pinned  = 0;
+    MDB_txn *txn = NULL;
+    if(mdb_txn_begin(DB->env, NULL, MDB_RDONLY, &txn) != MDB_SUCCESS)
+        return -EIO;
+    for(size_t i = 0; i < n; ++i)
+    {
+        if(!bi->inl[i] || data_goes_inline((size_t)bi->sizes[i]))
+            continue;
+        /* content already indexed: the item only adds a reference */
+        MDB_val k = {.mv_size = 32, .mv_data = bi->digests[i].b};
+        MDB_val v = {0};
+        if(mdb_get(txn, DB->db_data_sha2ids, &k, &v) != MDB_SUCCESS)
+        {
+            if(pack_append(DB->packs, bi->inl[i], (size_t)bi->sizes[i],
+                           &locs[i]) == 0)
+                ++*out_pinned;
+            else
+                bi->status[i] = -EIO;
+        }
+        free(bi->inl[i]);
+        bi->inl[i] = NULL;
+    }
+    mdb_txn_abort(txn);
+    if(*out_pinned == 0)
+        return 0;
+
+    int src = DB->flusher ? fs_flusher_sync(DB->flusher)
+                          : pack_sync(DB->packs);
+    if(src < 0)
+        return -EIO;
+    if(!DB->flusher && src == 1)
+        atomic_fetch_add(&DB->st_fsyncs, 1);
+    atomic_fetch_add(&DB->st_objects, (uint64_t)*out_pinned);
+    return 0;
+}
+
+static int data_pack_read(MDB_txn *txn, const DataMeta *meta, uint64_t off,
+                          void *buf, size_t len)
+{
+    PackLoc loc;
+    int     mrc = pack_index_get(txn, meta->sha, &loc);
+    if(mrc != MDB_SUCCESS)
+        return mrc == MDB_NOTFOUND ? -ENOENT : -EIO;
+    if(loc.len != meta->size)
+        return -EIO;
+    int rc = pack_read(DB->packs, &loc, off, buf, len);
+    return rc == 0 || rc == -ENOENT ? rc : -EIO;
+}
+
+static int data_chunked_stream(const DataMeta *meta, uint64_t off,
+                               uint64_t len, db_data_sink_cb sink, void *user)
+{
+    ChunkSpan *sp  = malloc(DATA_CHUNK_BATCH * sizeof *sp);
+    uint8_t   *buf = malloc(DATA_STREAM_BUFSZ);
+    int        rc  = sp && buf ? 0 : -ENOMEM;
+    uint64_t   end = off + len;
+    while(rc == 0 && off < end)
+    {
+        /* the ticket keeps the located segments on disk without the txn */
+        MDB_txn *txn    = NULL;
+        uint64_t ticket = 0;
+        size_t   n      = 0;
+        if(data_read_begin(&txn, &ticket) != 0)
+        {
+            rc = -EIO;
+            break;
+        }
+        rc = chunk_locate(txn, meta->sha, meta->size, off, sp,
+                          DATA_CHUNK_BATCH, &n);
+        mdb_txn_abort(txn);
+        if(rc == 0 && n == 0)
+            rc = -EIO;
+        for(size_t i = 0; rc == 0 && i < n && off < end; ++i)
+        {
+            uint64_t stop = sp[i].start + sp[i].loc.len;
+            if(stop > end)
+                stop = end;
+            while(rc == 0 && off < stop)
+            {
+                size_t take = stop - off < DATA_STREAM_BUFSZ
+                                  ? (size_t)(stop - off)
+                                  : DATA_STREAM_BUFSZ;
+                rc = pack_read(DB->packs, &sp[i].loc, off - sp[i].start, buf,
+                               take);
+                if(rc != 0)
+                    rc = rc == -ENOENT ? rc : -EIO;
+                else
+                    rc = sink(buf, take, user);
+                off += take;
+            }
+        }
+        pack_reader_exit(DB->packs, ticket);
+    }
+    free(buf);
+    free(sp);
+    return rc;
+}
+
+static int data_chunked_copy(MDB_txn *txn, const DataMeta *meta, uint64_t off,
+                             uint64_t len, int fd)
+{
+    size_t   cap = len < DATA_STREAM_BUFSZ ? (size_t)len : DATA_STREAM_BUFSZ;
+    uint8_t *buf = malloc(cap ? cap : 1);
+    if(!buf)
+        return -EIO;
+    int      rc   = 0;
+    uint64_t done = 0;
+    while(rc == 0 && done < len)
+    {
+        size_t n = len - done < cap ? (size_t)(len - done) : cap;
+        rc       = chunk_read(txn, meta->sha, meta->size, off + done, buf, n);
+        if(rc == 0)
+            rc = fd_sink(buf, n, &fd);
+        done += n;
+    }
+    free(buf);
+    return rc;
+}
+
+static int fd_sink(const void *buf, size_t len, void *user)
+{
+    int            fd = *(int *)user;
+    const uint8_t *p  = (const uint8_t *)buf;
+    while(len > 0)
+    {
+        ssize_t wr = write(fd, p, len);
+        if(wr > 0)
+        {
+            p += wr;
+            len -= (size_t)wr;
+        }
+        else if(wr < 0 && errno == EINTR)
+            continue;
+        else
+            return -EIO;
+    }
+    return 0;
+}
+
+static int data_cache_path(char *out, size_t out_sz, const char hex[65])
+{
+    int n = snprintf(out, out_sz, "%s/objects/cache/%s", DB->root, hex);
+    return n < 0 || (size_t)n >= out_sz ? -ENAMETOOLONG : 0;
+}
+
+static int data_release_content(MDB_txn *txn, const DataMeta *meta,
+                                const char hex[65], FsTmp *retired,
+                                int *uncache)
+{
+    MDB_val sk = {.mv_size = 32, .mv_data = (void *)meta->sha};
+    *uncache   = (meta->flags & DATA_META_F_MASK) != 0;
+    if(meta->flags & DB_DATA_F_INLINE)
+        (void)mdb_del(txn, DB->db_data_inline, &sk, NULL);
+    else if(meta->flags & DB_DATA_F_PACKED)
+    {
+        if(!chunk_in_use(txn, meta->sha))
+            (void)pack_index_del(txn, meta->sha);
+    }
+    else if(meta->flags & DB_DATA_F_CHUNKED)
+    {
+        int rc = chunk_manifest_release(txn, meta->sha);
+        if(rc != MDB_SUCCESS && rc != MDB_NOTFOUND)
+            return rc;
+    }
+    else
+        (void)fs_objdir_retire_object(DB->objdir, hex, retired);
+    return MDB_SUCCESS;
+}
+
+static int data_trash_one(MDB_txn *txn, const uint8_t actor[DB_ID_SIZE],
+                          const uint8_t id[DB_ID_SIZE], uint64_t now,
+                          int *status)
+{
+    MDB_val mk = {.mv_size = DB_ID_SIZE, .mv_data = (void *)id};
+    MDB_val mv = {0};
+    int     rc = acl_has_owner(txn, actor, id);
+    if(rc == -ENOENT)
+    {
+        /* someone else's, gone, or listed twice */
+        rc      = mdb_get(txn, DB->db_data_id2meta, &mk, &mv);
+        *status = rc == MDB_SUCCESS    ? -EPERM
+                  : rc == MDB_NOTFOUND ? -ENOENT
+                                       : -EIO;
+        return MDB_SUCCESS;
+    }
+    if(rc != 0)
+    {
+        *status = -EIO;
+        return MDB_SUCCESS;
+    }
+
+    /* copy the record out: its id2meta slot goes before the trash put */
+    uint8_t  rec[sizeof(DataMetaV0)];
+    DataMeta meta;
+    rc = mdb_get(txn, DB->db_data_id2meta, &mk, &mv);
+    if(rc != MDB_SUCCESS && rc != MDB_NOTFOUND)
+        return rc;
+    if(rc == MDB_NOTFOUND)
+    {
+        *status = -ENOENT;
+        return MDB_SUCCESS;
+    }
+    if(mv.mv_size > sizeof rec || db_data_meta_decode(NULL, &mv, &meta) != 0)
+    {
+        *status = -EIO;
+        return MDB_SUCCESS;
+    }
+    memcpy(rec, mv.mv_data, mv.mv_size);
+    MDB_val raw = {.mv_size = mv.mv_size, .mv_data = rec};
+
+    rc = acl_data_destroy(txn, id);
+    if(rc != 0)
+        return rc == MDB_MAP_FULL ? rc : -rc;
+
+    /* the content is left alone: the trash entry keeps it referenced */
+    MDB_val sk = {.mv_size = 32, .mv_data = meta.sha};
+    (void)mdb_del(txn, DB->db_data_sha2ids, &sk, &mk);
+    (void)mdb_del(txn, DB->db_data_id2meta, &mk, NULL);
+
+    uint8_t otk[40];
+    owner_time_key(otk, meta.owner, meta.created_at, id);
+    MDB_val ok = {.mv_size = sizeof otk, .mv_data = otk};
+    (void)mdb_del(txn, DB->db_data_owner_time, &ok, NULL);
+
+    uint8_t osk[48];
+    owner_sha_key(osk, meta.owner, meta.sha);
+    MDB_val os = {.mv_size = sizeof osk, .mv_data = osk};
+    (void)mdb_del(txn, DB->db_data_owner_sha, &os, NULL);
+
+    rc      = trash_put(txn, id, &meta, &raw, now);
+    *status = rc == MDB_SUCCESS ? 0 : -EIO;
+    return rc;
+}
+
+static int data_trash_txn(const uint8_t actor[DB_ID_SIZE], size_t n,
+                          const uint8_t *ids, int status[], size_t *out_done)
+{
+    uint64_t now = now_secs();
+    *out_done    = 0;
+
+retry_chunk:
+    MDB_txn *txn = NULL;
+    int      mrc = mdb_txn_begin(DB->env, NULL, 0, &txn);
+    if(mrc != MDB_SUCCESS)
+        return db_map_mdb_err(mrc);
+
+    size_t done = 0;
+    for(size_t i = 0; i < n && mrc == MDB_SUCCESS; ++i)
+    {
+        int st = 0;
+        mrc    = data_trash_one(txn, actor, ids + i * DB_ID_SIZE, now, &st);
+        if(status)
+            status[i] = st;
+        done += st == 0;
+    }
+    if(mrc == MDB_MAP_FULL)
+    {
+        mdb_txn_abort(txn);
+        int grc = db_env_mapsize_expand(); /* grow */
+        if(grc != 0)
+            return db_map_mdb_err(grc);
+        goto retry_chunk; /* retry whole chunk */
+    }
+    if(mrc != MDB_SUCCESS)
+    {
+        mdb_txn_abort(txn);
+        return db_map_mdb_err(mrc);
+    }
+
+    mrc = mdb_txn_commit(txn);
+    if(mrc == MDB_MAP_FULL)
+    {
+        int grc = db_env_mapsize_expand();
+        if(grc != 0)
+            return db_map_mdb_err(grc);
+        goto retry_chunk;
+    }
+    if(mrc != MDB_SUCCESS)
+        return db_map_mdb_err(mrc);
+    /* ids this txn refused were not cached as gone: dropping them is only a
+       later miss */
+    for(size_t i = 0; i < n; ++i)
+        meta_cache_drop(DB->meta_cache, ids + i * DB_ID_SIZE);
+    *out_done = done;
+    return 0;
+}
+
+static int data_reap_txn(size_t max, size_t *out_reaped)
+{
+    uint64_t now = now_secs();
+    *out_reaped  = 0;
+
+retry_chunk:
+    MDB_txn *txn = NULL;
+    int      mrc = mdb_txn_begin(DB->env, NULL, 0, &txn);
+    if(mrc != MDB_SUCCESS)
+        return db_map_mdb_err(mrc);
+
+    /* collect first: deleting under a live cursor would move it */
+    uint8_t    *keys = NULL;
+    size_t      nk   = 0, cap = 0;
+    MDB_cursor *cur  = NULL;
+    mrc              = mdb_cursor_open(txn, DB->db_data_trash, &cur);
+    if(mrc != MDB_SUCCESS)
+    {
+        mdb_txn_abort(txn);
+        return db_map_mdb_err(mrc);
+    }
+    MDB_val k = {0}, v = {0};
+    for(mrc = mdb_cursor_get(cur, &k, &v, MDB_FIRST);
+        mrc == MDB_SUCCESS && nk < max;
+        mrc = mdb_cursor_get(cur, &k, &v, MDB_NEXT))
+    {
+        uint64_t at = 0;
+        if(k.mv_size != DB_ID_SIZE || v.mv_size < sizeof at)
+            continue;
+        memcpy(&at, v.mv_data, sizeof at);
+        if(at + DB->trash_grace > now)
+            continue;
+        if(nk == cap)
+        {
+            size_t   ncap  = cap ? cap * 2 : 256;
+            uint8_t *nkeys = realloc(keys, ncap * DB_ID_SIZE);
+            if(!nkeys)
+            {
+                mrc = ENOMEM;
+                break;
+            }
+            keys = nkeys;
+            cap  = ncap;
+        }
+        memcpy(keys + nk++ * DB_ID_SIZE, k.mv_data, DB_ID_SIZE);
+    }
+    mdb_cursor_close(cur);
+    ReapSlot *slots = NULL;
+    if(mrc == MDB_SUCCESS || mrc == MDB_NOTFOUND)
+    {
+        slots = calloc(nk ? nk : 1, sizeof *slots);
+        mrc   = slots ? MDB_SUCCESS : ENOMEM;
+    }
+    if(mrc != MDB_SUCCESS)
+    {
+        mdb_txn_abort(txn);
+        free(keys);
+        return db_map_mdb_err(mrc);
+    }
+
+    size_t done = 0;
+    for(size_t i = 0; i < nk && mrc == MDB_SUCCESS; ++i)
+    {
+        const uint8_t *id  = keys + i * DB_ID_SIZE;
+        ReapSlot      *sl  = &slots[i];
+        MDB_val        raw = {0};
+        DataMeta       m;
+        sl->retired.fd = -1;
+        mrc            = trash_get(txn, id, &raw, NULL);
+        if(mrc != MDB_SUCCESS)
+            break;
+        if(db_data_meta_decode(NULL, &raw, &m) != 0)
+        {
+            /* unreadable: drop the entry, its content stays for the GC */
+            MDB_val ik = {.mv_size = DB_ID_SIZE, .mv_data = (void *)id};
+            mrc        = mdb_del(txn, DB->db_data_trash, &ik, NULL);
+            continue;
+        }
+        mrc = trash_del(txn, id, m.sha);
+        if(mrc != MDB_SUCCESS)
+            break;
+        ++done;
+
+        Sha256 d;
+        memcpy(d.b, m.sha, 32);
+        crypt_sha256_hex(&d, sl->hex);
+        MDB_val  sk = {.mv_size = 32, .mv_data = m.sha};
+        DataMeta any;
+        if(db_data_sha_any_meta(txn, &sk, &any) == MDB_NOTFOUND)
+            mrc = data_release_content(txn, &m, sl->hex, &sl->retired,
+                                       &sl->uncache);
+    }
+    free(keys);
+
+    if(mrc == MDB_SUCCESS)
+        mrc = mdb_txn_commit(txn);
+    else
+        mdb_txn_abort(txn);
+    if(mrc != MDB_SUCCESS)
+    {
+        for(size_t i = 0; i < nk; ++i)
+            if(slots[i].retired.name[0])
+                (void)fs_objdir_restore_object(DB->objdir, &slots[i].retired,
+                                               slots[i].hex);
+        free(slots);
+        if(mrc != MDB_MAP_FULL)
+            return db_map_mdb_err(mrc);
+        int grc = db_env_mapsize_expand(); /* grow */
+        if(grc != 0)
+            return db_map_mdb_err(grc);
+        goto retry_chunk; /* retry whole chunk */
+    }
+
+    /* best-effort unlink (DB is source of truth) */
+    for(size_t i = 0; i < nk; ++i)
+    {
+        char cp[PATH_MAX];
+        fs_objdir_tmp_discard(DB->objdir, &slots[i].retired);
+        if(slots[i].uncache && data_cache_path(cp, sizeof cp, slots[i].hex) == 0)
+            (void)unlink(cp);
+    }
+    free(slots);
+    *out_reaped = done;
+    return 0;
+}
+
+static int data_sha256_sink(const void *buf, size_t len, void *user)
+{
+    return crypt_sha256_update((CryptSha256Ctx *)user, buf, len) == 0 ? 0
+                                                                      : -EIO;
+}
@@ -9,6 +9,16 @@
 
 #include "db_int.h"
 #include "fsutil.h"
+#include "workpool.h"
+#include "sha256.h"
+#include "db_mime.h"
+#include "db_meta_cache.h"
+#include "db_pack.h"
+#include "db_trash.h"
+#include "db_upload.h"
+
+#include <dirent.h>
+#include <fcntl.h>
 
 /****************************************************************************
  * PRIVATE DEFINES
@@ -18,8 +28,34 @@
 /* Logical names of LMDB sub-databases */
 #define DB_USER_ID2DATA "user_id2data" /* key = id(16),  val = UserPacked */
 #define DB_USER_MAIL2ID "user_mail2id" /* key = email,   val = id(16) */
-#define DB_DATA_ID2META "data_id2meta" /* key = id(16),  val = DataMeta */
-#define DB_DATA_SHA2ID  "data_sha2id"  /* key = sha(32), val = id(16) */
+#define DB_DATA_ID2META "data_id2meta" /* key = id(16),  val = DataMeta(Rec) */
+#define DB_DATA_SHA2IDS "data_sha2ids" /* key = sha(32), dups = id(16) */
+/* key = owner(16)|created_at(8, BE)|id(16), val = sentinel */
+#define DB_DATA_OWNER_TIME "data_owner_time"
+#define DB_DATA_OWNER_SHA  "data_owner_sha" /* key = owner|sha, val = id */
+#define DB_DATA_INLINE  "data_inline"  /* key = sha(32),   val = object bytes */
+#define DB_DATA_PACKS   "data_packs"   /* key = sha(32),   val = PackLoc */
+#define DB_PACK_EXTENTS "pack_extents" /* key = pack(4)|off(8), val = len|sha */
+#define DB_DATA_MANIFESTS "data_manifests" /* key = sha(32), val = ChunkRef[] */
+#define DB_DATA_CHUNKS    "data_chunks"    /* key = sha(32), val = refs(8) */
+#define DB_DATA_SCRUB     "data_scrub"     /* key = "ckpt", val = ScrubCkpt */
+#define DB_DATA_TRASH     "data_trash"     /* key = id(16), val = at(8)|meta */
+#define DB_DATA_TRASH_SHA "data_trash_sha" /* key = sha(32), dups = id(16) */
+#define DB_DATA_UPLOADS   "data_uploads"   /* key = id(16), val = UploadRec */
+#define DB_MIME_STR2ID  "mime_str2id"  /* key = MIME name, val = id(2) */
+#define DB_MIME_ID2STR  "mime_id2str"  /* key = id(2),     val = MIME name */
+#define DB_STORE_CONF   "store_conf"   /* key = setting,   val = value */
+
+/* store_conf key of the content digest ("sha256" | "blake3") */
+#define DB_CONF_DIGEST "digest"
+
+/* store_conf key of the derived-index schema (u32): bumped whenever a
+   build adds or changes an index rebuilt from data_id2meta */
+#define DB_CONF_SCHEMA  "schema"
+#define DB_INDEX_SCHEMA 1u
+
+/* Pre-refcount index (one id per sha); folded into DB_DATA_SHA2IDS on open */
+#define DB_DATA_SHA2ID_V1 "data_sha2id"
 
 /* Presence-only ACL DBs */
 #define DB_ACL_FWD \
@@ -50,12 +86,42 @@ struct DB *DB = NULL;
  * @brief The db_data_ensure_layout function is a static utility that ensures
  * the directory structure for a database is properly set up under the
  * specified root path. It creates the necessary directories
- * (root, root/objects/sha256, and root/meta) with appropriate permissions,
+ * (root, root/objects, and root/meta) with appropriate permissions; the
+ * object directory of the store's digest is made by fs_objdir_open(),
  * returning -EIO if any directory creation fails for reasons other than the
  * directory already existing.
  */
 static int db_data_ensure_layout(const char *root);
 
+/* Copy a pre-refcount sha->id index into DB_DATA_SHA2IDS and drop it. */
+static int db_data_migrate_sha2id(MDB_txn *txn);
+
+/* Rebuild the owner|time and owner|sha indexes from data_id2meta when the
+   recorded schema differs from DB_INDEX_SCHEMA (older store, or one a
+   build without them wrote to), in its own write txn grown and retried on
+   MDB_MAP_FULL. MDB rc. */
+static int db_data_backfill_owner_index(void);
+
+/* db_data_backfill_owner_index() inside 'txn'; *dirty = 0 when the schema
+   was current and nothing was written. */
+static int db_data_owner_index_rebuild(MDB_txn *txn, int *dirty);
+
+/* Content digest of the store into DB->digest_alg: the recorded one, else
+   DB_CONTENT_HASH for a store without data (recorded now), else SHA-256
+   (stores older than the setting). */
+static int db_store_conf_digest(MDB_txn *txn);
+
+/* Shard layout of the store into *cur: the recorded one, else
+   DB_SHARD_LAYOUT for a store without data (recorded now), else 2x2. 1 and
+   the previous layout into *from when a re-layout was interrupted. */
+static int db_store_conf_layout(MDB_txn *txn, FsLayout *cur, FsLayout *from,
+                                int *moving);
+
+/* 1 when <root>/objects holds anything: blobs of some layout, packs,
+   materialized copies or upload files (the empty cache/ and uploads/
+   made by db_open do not count). */
+static int db_objects_present(const char *root);
+
 static int db_env_setup_and_open(const char *root_dir, size_t mapsize_bytes);
 
 static int db_env_mapsize_set(uint64_t mapsize_bytes);
@@ -81,8 +147,127 @@ int db_open(const char *root_dir, size_t mapsize_bytes)
 
     snprintf(DB->root, sizeof DB->root, "%s", root_dir);
 
+    /* DB_INGEST_THREADS caps batch ingest workers; 0/unset = one per CPU */
+    const char *it     = getenv("DB_INGEST_THREADS");
+    long        nthr   = it ? atol(it) : 0;
+    DB->ingest_threads = nthr > 0 ? (unsigned)nthr : wp_ncpu();
+
+    /* DB_DEDUP_HASH_FIRST=1 hashes seekable sources before writing them */
+    const char *hf       = getenv("DB_DEDUP_HASH_FIRST");
+    DB->dedup_hash_first = hf && atoi(hf) != 0;
+
+    /* DB_META_INLINE_MIME=1 keeps writing v0 meta records (MIME inline), for
+       stores still read by builds without the MIME dictionary */
+    const char *im       = getenv("DB_META_INLINE_MIME");
+    DB->meta_inline_mime = im && atoi(im) != 0;
+
+    /* DB_INLINE_MAX=<bytes>: objects up to this size are stored in LMDB with
+       their meta (one txn, no file); 0 = off */
+    const char *il   = getenv("DB_INLINE_MAX");
+    long        ilv  = il ? atol(il) : 0;
+    DB->inline_max   = ilv > 0 ? (size_t)ilv : 0;
+    if(DB->inline_max > DB_INLINE_MAX_CAP)
+        DB->inline_max = DB_INLINE_MAX_CAP;
+
+    /* DB_PACK_MAX=<bytes>: larger-than-inline objects up to this size are
+       appended to shared pack files (objects/packs); 0 = off. Existing
+       packs stay readable either way. DB_PACK_SEGMENT_KB sizes a pack. */
+    const char *pm  = getenv("DB_PACK_MAX");
+    long        pmv = pm ? atol(pm) : 0;
+    DB->pack_max    = pmv > 0 ? (size_t)pmv : 0;
+    if(DB->pack_max > DB_PACK_MAX_CAP)
+        DB->pack_max = DB_PACK_MAX_CAP;
+    const char *ps  = getenv("DB_PACK_SEGMENT_KB");
+    long        psv = ps ? atol(ps) : 0;
+    DB->packs       = pack_store_open(
+        root_dir, psv > 0 ? (uint64_t)psv * 1024u : DB_PACK_SEGMENT_DEFAULT);
+    if(!DB->packs)
+    {
+        fs_objdir_close(DB->objdir);
+        free(DB);
+        DB = NULL;
+        return -EIO;
+    }
+
+    /* DB_CDC_AVG_KB=<KiB>: regular files longer than 8x this are cut into
+       content-defined chunks of about that size, stored once in the packs;
+       0/unset = whole-file objects only */
+    const char *ca  = getenv("DB_CDC_AVG_KB");
+    long        cav = ca ? atol(ca) : 0;
+    if(cav > 0)
+    {
+        size_t avg = (size_t)cav * 1024u;
+        if(avg < DB_CDC_AVG_MIN)
+            avg = DB_CDC_AVG_MIN;
+        if(avg > DB_CDC_AVG_MAX)
+            avg = DB_CDC_AVG_MAX;
+        while(avg & (avg - 1))
+            avg &= avg - 1; /* power of two: the cut masks are bit counts */
+        DB->cdc_avg = avg;
+    }
+
+    /* DB_GC_GRACE_S=<seconds>: files changed more recently are never
+       collected by db_data_gc(NULL, ..) */
+    const char *gg = getenv("DB_GC_GRACE_S");
+    long        ggv = gg ? atol(gg) : -1;
+    DB->gc_grace    = ggv >= 0 && ggv <= (long)UINT32_MAX ? (uint32_t)ggv
+                                                          : DB_GC_GRACE_DEFAULT;
+
+    /* DB_TRASH_GRACE_S=<seconds>: db_data_delete_many() keeps the records
+       undeletable (and their content stored) this long; default one day,
+       0 = reap at once */
+    const char *tg  = getenv("DB_TRASH_GRACE_S");
+    long        tgv = tg ? atol(tg) : -1;
+    DB->trash_grace = tgv >= 0 && tgv <= (long)UINT32_MAX
+                          ? (uint32_t)tgv
+                          : DB_TRASH_GRACE_DEFAULT;
+
+    /* DB_UPLOAD_TTL_S=<seconds>: upload sessions without an append for
+       this long are dropped by the reaper; default one day */
+    const char *ut  = getenv("DB_UPLOAD_TTL_S");
+    long        utv = ut ? atol(ut) : -1;
+    DB->upload_ttl  = utv >= 0 && utv <= (long)UINT32_MAX
+                          ? (uint32_t)utv
+                          : DB_UPLOAD_TTL_DEFAULT;
+
+    /* DB_INGEST_ENGINE=uring|threads|serial picks the streaming engine */
+    const char *en = getenv("DB_INGEST_ENGINE");
+    if(en && strcmp(en, "uring") == 0)
+        crypt_set_ingest_engine(CRYPT_ENGINE_URING);
+    else if(en && strcmp(en, "threads") == 0)
+        crypt_set_ingest_engine(CRYPT_ENGINE_THREADS);
+    else if(en && strcmp(en, "serial") == 0)
+        crypt_set_ingest_engine(CRYPT_ENGINE_SERIAL);
+    else
+        crypt_set_ingest_engine(CRYPT_ENGINE_AUTO);
+
+    /* DB_COMPRESS=zlib stores compressible blobs deflated at
+       DB_COMPRESS_LEVEL (default 1); ignored in builds without zlib */
+    const char *cz = getenv("DB_COMPRESS");
+    const char *cl = getenv("DB_COMPRESS_LEVEL");
+    crypt_set_compression(cz && strcmp(cz, "zlib") == 0 ? (cl ? atoi(cl) : 1)
+                                                        : 0);
+
+    /* DB_SHA256_IMPL=openssl, or a list of shani/avx2/avx512, limits the
+       SHA-256 backends (default: all the CPU has) */
+    const char *si   = getenv("DB_SHA256_IMPL");
+    unsigned    mask = CRYPT_SHA256_IMPL_ALL;
+    if(si && *si && strcmp(si, "auto") != 0)
+    {
+        mask = 0;
+        if(strstr(si, "shani"))
+            mask |= CRYPT_SHA256_IMPL_SHANI;
+        if(strstr(si, "avx2"))
+            mask |= CRYPT_SHA256_IMPL_AVX2;
+        if(strstr(si, "avx512"))
+            mask |= CRYPT_SHA256_IMPL_AVX512;
+    }
+    (void)crypt_sha256_set_impl(mask);
+
     if(mdb_env_create(&DB->env) != MDB_SUCCESS)
     {
+        pack_store_close(DB->packs);
+        fs_objdir_close(DB->objdir);
         free(DB);
         DB = NULL;
         return -EIO;
@@ -105,7 +290,61 @@ int db_open(const char *root_dir, size_t mapsize_bytes)
     if(mdb_dbi_open(txn, DB_DATA_ID2META, MDB_CREATE, &DB->db_data_id2meta) !=
        MDB_SUCCESS)
         goto fail;
-    if(mdb_dbi_open(txn, DB_DATA_SHA2ID, MDB_CREATE, &DB->db_data_sha2id) !=
+    /* every data id sharing a blob is one dup: the dup count is its refcount */
+    if(mdb_dbi_open(txn, DB_DATA_SHA2IDS,
+                    MDB_CREATE | MDB_DUPSORT | MDB_DUPFIXED,
+                    &DB->db_data_sha2ids) != MDB_SUCCESS)
+        goto fail;
+    if(db_data_migrate_sha2id(txn) != MDB_SUCCESS)
+        goto fail;
+    if(mdb_dbi_open(txn, DB_DATA_INLINE, MDB_CREATE, &DB->db_data_inline) !=
+       MDB_SUCCESS)
+        goto fail;
+    if(mdb_dbi_open(txn, DB_DATA_PACKS, MDB_CREATE, &DB->db_data_packs) !=
+       MDB_SUCCESS)
+        goto fail;
+    if(mdb_dbi_open(txn, DB_PACK_EXTENTS, MDB_CREATE, &DB->db_pack_extents) !=
+       MDB_SUCCESS)
+        goto fail;
+    if(mdb_dbi_open(txn, DB_DATA_MANIFESTS, MDB_CREATE,
+                    &DB->db_data_manifests) != MDB_SUCCESS)
+        goto fail;
+    if(mdb_dbi_open(txn, DB_DATA_CHUNKS, MDB_CREATE, &DB->db_data_chunks) !=
+       MDB_SUCCESS)
+        goto fail;
+    if(mdb_dbi_open(txn, DB_DATA_SCRUB, MDB_CREATE, &DB->db_data_scrub) !=
+       MDB_SUCCESS)
+        goto fail;
+    if(mdb_dbi_open(txn, DB_DATA_TRASH, MDB_CREATE, &DB->db_data_trash) !=
+       MDB_SUCCESS)
+        goto fail;
+    if(mdb_dbi_open(txn, DB_DATA_TRASH_SHA,
+                    MDB_CREATE | MDB_DUPSORT | MDB_DUPFIXED,
+                    &DB->db_data_trash_sha) != MDB_SUCCESS)
+        goto fail;
+    if(mdb_dbi_open(txn, DB_DATA_UPLOADS, MDB_CREATE, &DB->db_data_uploads) !=
+       MDB_SUCCESS)
+        goto fail;
+    if(mdb_dbi_open(txn, DB_MIME_STR2ID, MDB_CREATE, &DB->db_mime_str2id) !=
+       MDB_SUCCESS)
+        goto fail;
+    if(mdb_dbi_open(txn, DB_MIME_ID2STR, MDB_CREATE, &DB->db_mime_id2str) !=
+       MDB_SUCCESS)
+        goto fail;
+    if(mdb_dbi_open(txn, DB_DATA_OWNER_TIME, MDB_CREATE,
+                    &DB->db_data_owner_time) != MDB_SUCCESS)
+        goto fail;
+    if(mdb_dbi_open(txn, DB_DATA_OWNER_SHA, MDB_CREATE,
+                    &DB->db_data_owner_sha) != MDB_SUCCESS)
+        goto fail;
+    if(mdb_dbi_open(txn, DB_STORE_CONF, MDB_CREATE, &DB->db_store_conf) !=
+       MDB_SUCCESS)
+        goto fail;
+    if(db_store_conf_digest(txn) != MDB_SUCCESS)
+        goto fail;
+    FsLayout layout, layout_from;
+    int      moving = 0;
+    if(db_store_conf_layout(txn, &layout, &layout_from, &moving) !=
        MDB_SUCCESS)
         goto fail;
 
@@ -122,12 +361,95 @@ int db_open(const char *root_dir, size_t mapsize_bytes)
         mdb_txn_abort(txn);
         goto fail_env;
     }
+    if(db_data_backfill_owner_index() != MDB_SUCCESS)
+        goto fail_env;
+
+    /* objects live under objects/<digest>: a store never mixes two */
+    const char *ns = DB->digest_alg == CRYPT_HASH_BLAKE3 ? "blake3" : "sha256";
+    crypt_set_content_hash((CryptHash)DB->digest_alg);
+
+    /* DB_SHARDS_PRECREATE=1 builds every leaf dir up front (<= 65536) */
+    const char *pc = getenv("DB_SHARDS_PRECREATE");
+    DB->objdir     = fs_objdir_open(root_dir, ns, moving ? layout_from : layout,
+                                    pc && atoi(pc) != 0);
+    /* an interrupted re-layout: lookups fall back to the old layout until
+       db_data_relayout() runs again */
+    if(DB->objdir && moving &&
+       fs_objdir_relayout_begin(DB->objdir, layout) != 0)
+        goto fail_env;
+    if(!DB->objdir)
+        goto fail_env;
+
+    DB->mime_cache = mime_cache_create();
+    if(!DB->mime_cache)
+        goto fail_env;
+
+    /* DB_META_CACHE=<records> bounds the data_id -> meta cache of
+       db_data_get_meta/_path (default 65536); 0 = off */
+    const char *mc  = getenv("DB_META_CACHE");
+    long        mcn = mc ? atol(mc) : (long)DB_META_CACHE_DEFAULT;
+    if(mcn > 0)
+    {
+        DB->meta_cache = meta_cache_create((size_t)mcn);
+        if(!DB->meta_cache)
+            goto fail_env;
+    }
+
+    /* DB_DURABILITY=group: one syncfs per group of ingests instead of an
+       fsync per object; DB_FSYNC_WINDOW_US lets each group grow */
+    const char *du = getenv("DB_DURABILITY");
+    if(du && strcmp(du, "group") == 0)
+    {
+        const char *fw = getenv("DB_FSYNC_WINDOW_US");
+        long        us = fw ? atol(fw) : 0;
+        DB->flusher    = fs_flusher_open(root_dir, us > 0 ? (unsigned)us : 0);
+        if(!DB->flusher)
+            goto fail_env;
+    }
+
+    /* DB_REPACK_INTERVAL_S=<s> runs db_data_repack() in the background at
+       DB_REPACK_DEAD_PCT (default 30) dead bytes; 0/unset = on demand only */
+    const char *ri = getenv("DB_REPACK_INTERVAL_S");
+    long        rs = ri ? atol(ri) : 0;
+    if(rs > 0)
+    {
+        const char *rp  = getenv("DB_REPACK_DEAD_PCT");
+        long        pct = rp ? atol(rp) : (long)DB_REPACK_DEAD_PCT_DEFAULT;
+        if(pct < 0 || pct > 100)
+            pct = DB_REPACK_DEAD_PCT_DEFAULT;
+        if(pack_repacker_start(DB->packs, (unsigned)rs, (unsigned)pct) != 0)
+            goto fail_env;
+    }
+
+    /* DB_TRASH_REAP_INTERVAL_S=<s> (default 60) paces the background reaper
+       of expired trash; 0 = db_data_reap() on demand only */
+    const char *tr = getenv("DB_TRASH_REAP_INTERVAL_S");
+    long        ts = tr ? atol(tr) : (long)DB_TRASH_REAP_INTERVAL_DEFAULT;
+    if(ts > 0 && trash_reaper_start((unsigned)ts) != 0)
+        goto fail_env;
+
+    /* session files a crash left without (or aside from) their record */
+    if(upload_sweep() != 0)
+        goto fail_env;
+
+    /* DB_UPLOAD_REAP_INTERVAL_S=<s> (default 600) paces the reaper of idle
+       upload sessions; 0 = db_upload_reap() on demand only */
+    const char *ur = getenv("DB_UPLOAD_REAP_INTERVAL_S");
+    long        uv = ur ? atol(ur) : (long)DB_UPLOAD_REAP_INTERVAL_DEFAULT;
+    if(uv > 0 && upload_reaper_start((unsigned)uv) != 0)
+        goto fail_env;
     return 0;
 
 fail:
     mdb_txn_abort(txn);
 fail_env:
+    trash_reaper_stop();
+    pack_store_close(DB->packs);
     mdb_env_close(DB->env);
+    fs_flusher_close(DB->flusher);
+    mime_cache_destroy(DB->mime_cache);
+    meta_cache_destroy(DB->meta_cache);
+    fs_objdir_close(DB->objdir);
     free(DB);
     DB = NULL;
     return -EIO;
@@ -137,9 +459,18 @@ void db_close(void)
 {
     if(!DB)
         return;
+    db_scrub_stop();
+    upload_reaper_stop();
+    trash_reaper_stop();
+    pack_store_close(DB->packs); /* stops the repacker first */
     mdb_env_close(DB->env);
+    fs_flusher_close(DB->flusher);
+    mime_cache_destroy(DB->mime_cache);
+    meta_cache_destroy(DB->meta_cache);
+    fs_objdir_close(DB->objdir);
     free(DB);
     DB = NULL;
+    crypt_set_content_hash(CRYPT_HASH_SHA256);
 }
 
 int db_env_mapsize_expand(void)
@@ -174,6 +505,28 @@ int db_env_metrics(uint64_t *used, uint64_t *mapsize, uint32_t *psize)
     return 0;
 }
 
+int db_ingest_stats(DbIngestStats *out)
+{
+    if(!DB || !out)
+        return -EINVAL;
+    out->objects           = atomic_load(&DB->st_objects);
+    out->syncs             = atomic_load(&DB->st_fsyncs) +
+                 fs_flusher_count(DB->flusher);
+    out->dedup_bytes_saved = atomic_load(&DB->st_dedup_saved);
+    return 0;
+}
+
+int db_meta_cache_stats(DbMetaCacheStats *out)
+{
+    if(!DB || !out)
+        return -EINVAL;
+    size_t n = 0, cap = 0;
+    meta_cache_stats(DB->meta_cache, &out->hits, &out->misses, &n, &cap);
+    out->entries  = n;
+    out->capacity = cap;
+    return 0;
+}
+
 int db_map_mdb_err(int mdb_rc)
 {
     switch(mdb_rc)
@@ -213,7 +566,17 @@ static int db_data_ensure_layout(const char *root)
     if(mkdir_p(p, 0770) != 0 && errno != EEXIST)
         return -EIO;
 
-    snprintf(p, sizeof p, "%s/objects/sha256", root);
+    snprintf(p, sizeof p, "%s/objects", root);
+    if(mkdir_p(p, 0770) != 0 && errno != EEXIST)
+        return -EIO;
+
+    /* materialized copies of content without a blob (db_data_materialize) */
+    snprintf(p, sizeof p, "%s/objects/cache", root);
+    if(mkdir_p(p, 0770) != 0 && errno != EEXIST)
+        return -EIO;
+
+    /* files of resumable upload sessions (db_upload_*) */
+    snprintf(p, sizeof p, "%s/objects/uploads", root);
     if(mkdir_p(p, 0770) != 0 && errno != EEXIST)
         return -EIO;
 
@@ -224,6 +587,41 @@ static int db_data_ensure_layout(const char *root)
     return 0;
 }
 
+static int db_objects_present(const char *root)
+{
+    char p[2048];
+    snprintf(p, sizeof p, "%s/objects", root);
+    DIR *d = opendir(p);
+    if(!d)
+        return errno != ENOENT; /* unreadable: assume data */
+
+    int            found = 0;
+    struct dirent *de;
+    while(!found && (de = readdir(d)) != NULL)
+    {
+        if(strcmp(de->d_name, ".") == 0 || strcmp(de->d_name, "..") == 0)
+            continue;
+        /* any entry below it, blob leaves included, is data */
+        int  sfd = openat(dirfd(d), de->d_name,
+                          O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        DIR *sd  = sfd < 0 ? NULL : fdopendir(sfd);
+        if(!sd)
+        {
+            if(sfd >= 0)
+                close(sfd);
+            found = 1; /* a file, or unreadable */
+            continue;
+        }
+        struct dirent *se;
+        while(!found && (se = readdir(sd)) != NULL)
+            found = strcmp(se->d_name, ".") != 0 &&
+                    strcmp(se->d_name, "..") != 0;
+        closedir(sd);
+    }
+    closedir(d);
+    return found;
+}
+
 static int db_env_setup_and_open(const char *metadir, size_t mapsize_bytes)
 {
     if(!DB || !DB->env)
@@ -235,7 +633,7 @@ static int db_env_setup_and_open(const char *metadir, size_t mapsize_bytes)
     DB->map_size_bytes_max = mx ? (uint64_t)strtoull(mx, NULL, 10) << 20
                                 : (uint64_t)mapsize_bytes * 8;
 
-    int mrc = mdb_env_set_maxdbs(DB->env, 16);
+    int mrc = mdb_env_set_maxdbs(DB->env, 32);
     if(mrc != MDB_SUCCESS)
         return mrc;
 
@@ -259,4 +657,195 @@ static int db_env_mapsize_set(uint64_t mapsize_bytes)
         return 0;
     }
     return mrc;
-}
\ No newline at end of file
+}
+
+static int db_data_migrate_sha2id(MDB_txn *txn)
+{
+    MDB_dbi old = 0;
+    int     mrc = mdb_dbi_open(txn, DB_DATA_SHA2ID_V1, 0, &old);
+    if(mrc == MDB_NOTFOUND)
+        return MDB_SUCCESS; /* fresh store or already migrated */
+    if(mrc != MDB_SUCCESS)
+        return mrc;
+
+    MDB_cursor *cur = NULL;
+    mrc             = mdb_cursor_open(txn, old, &cur);
+    if(mrc != MDB_SUCCESS)
+        return mrc;
+    MDB_val k = {0}, v = {0};
+    for(mrc = mdb_cursor_get(cur, &k, &v, MDB_FIRST); mrc == MDB_SUCCESS;
+        mrc = mdb_cursor_get(cur, &k, &v, MDB_NEXT))
+    {
+        int prc = mdb_put(txn, DB->db_data_sha2ids, &k, &v, MDB_NODUPDATA);
+        if(prc != MDB_SUCCESS && prc != MDB_KEYEXIST)
+        {
+            mdb_cursor_close(cur);
+            return prc;
+        }
+    }
+    mdb_cursor_close(cur);
+    if(mrc != MDB_NOTFOUND)
+        return mrc;
+    return mdb_drop(txn, old, 1);
+}
+
+static int db_data_backfill_owner_index(void)
+{
+    MDB_txn *txn   = NULL;
+    int      dirty = 0;
+retry:
+    if(mdb_txn_begin(DB->env, NULL, 0, &txn) != MDB_SUCCESS)
+        return MDB_PANIC;
+    int mrc = db_data_owner_index_rebuild(txn, &dirty);
+    if(mrc == MDB_SUCCESS && dirty)
+        mrc = mdb_txn_commit(txn);
+    else
+        mdb_txn_abort(txn);
+    if(mrc == MDB_MAP_FULL && db_env_mapsize_expand() == 0)
+        goto retry;
+    return mrc;
+}
+
+static int db_data_owner_index_rebuild(MDB_txn *txn, int *dirty)
+{
+    *dirty       = 0;
+    MDB_val  ck  = {.mv_size = sizeof DB_CONF_SCHEMA - 1,
+                    .mv_data = (void *)DB_CONF_SCHEMA};
+    MDB_val  cv  = {0};
+    uint32_t ver = 0;
+    int      mrc = mdb_get(txn, DB->db_store_conf, &ck, &cv);
+    if(mrc == MDB_SUCCESS && cv.mv_size == sizeof ver)
+        memcpy(&ver, cv.mv_data, sizeof ver);
+    else if(mrc != MDB_SUCCESS && mrc != MDB_NOTFOUND)
+        return mrc;
+    if(ver == DB_INDEX_SCHEMA)
+        return MDB_SUCCESS;
+
+    *dirty = 1;
+    /* a newer build keeps these current too: only hand the marker back, so
+       it rebuilds whatever this one did not maintain */
+    if(ver < DB_INDEX_SCHEMA)
+    {
+        mrc = mdb_drop(txn, DB->db_data_owner_time, 0);
+        if(mrc == MDB_SUCCESS)
+            mrc = mdb_drop(txn, DB->db_data_owner_sha, 0);
+        if(mrc != MDB_SUCCESS)
+            return mrc;
+
+        MDB_cursor *cur = NULL;
+        mrc             = mdb_cursor_open(txn, DB->db_data_id2meta, &cur);
+        if(mrc != MDB_SUCCESS)
+            return mrc;
+        MDB_val k = {0}, v = {0};
+        for(mrc = mdb_cursor_get(cur, &k, &v, MDB_FIRST); mrc == MDB_SUCCESS;
+            mrc = mdb_cursor_get(cur, &k, &v, MDB_NEXT))
+        {
+            DataMeta m;
+            if(k.mv_size != DB_ID_SIZE ||
+               db_data_meta_decode(NULL, &v, &m) != 0)
+                continue;
+            int prc = db_data_owner_index_put(txn, &m, k.mv_data);
+            if(prc != MDB_SUCCESS)
+            {
+                mdb_cursor_close(cur);
+                return prc;
+            }
+        }
+        mdb_cursor_close(cur);
+        if(mrc != MDB_NOTFOUND)
+            return mrc;
+    }
+
+    ver = DB_INDEX_SCHEMA;
+    cv  = (MDB_val){.mv_size = sizeof ver, .mv_data = &ver};
+    return mdb_put(txn, DB->db_store_conf, &ck, &cv, 0);
+}
+
+static int db_store_conf_digest(MDB_txn *txn)
+{
+    MDB_val k = {.mv_size = sizeof DB_CONF_DIGEST - 1,
+                 .mv_data = (void *)DB_CONF_DIGEST};
+    MDB_val v = {0};
+    int     mrc = mdb_get(txn, DB->db_store_conf, &k, &v);
+    if(mrc == MDB_SUCCESS)
+    {
+        if(v.mv_size == 6 && memcmp(v.mv_data, "blake3", 6) == 0)
+            DB->digest_alg = CRYPT_HASH_BLAKE3;
+        else if(v.mv_size == 6 && memcmp(v.mv_data, "sha256", 6) == 0)
+            DB->digest_alg = CRYPT_HASH_SHA256;
+        else
+            return MDB_INCOMPATIBLE; /* written by a newer build */
+        return MDB_SUCCESS;
+    }
+    if(mrc != MDB_NOTFOUND)
+        return mrc;
+
+    /* DB_CONTENT_HASH=blake3|sha256 only picks the digest of a new store:
+       existing records (and their blob names) are SHA-256 */
+    MDB_stat metas, trash;
+    if(mdb_stat(txn, DB->db_data_id2meta, &metas) != MDB_SUCCESS ||
+       mdb_stat(txn, DB->db_data_trash, &trash) != MDB_SUCCESS)
+        return MDB_PANIC;
+    const char *ch = getenv("DB_CONTENT_HASH");
+    DB->digest_alg = metas.ms_entries == 0 && trash.ms_entries == 0 && ch &&
+                             strcmp(ch, "blake3") == 0
+                         ? CRYPT_HASH_BLAKE3
+                         : CRYPT_HASH_SHA256;
+    v.mv_data = DB->digest_alg == CRYPT_HASH_BLAKE3 ? "blake3" : "sha256";
+    v.mv_size = 6;
+    return mdb_put(txn, DB->db_store_conf, &k, &v, 0);
+}
+
+static int db_store_conf_layout(MDB_txn *txn, FsLayout *cur, FsLayout *from,
+                                int *moving)
+{
+    char    name[8];
+    MDB_val k   = {.mv_size = sizeof DB_CONF_LAYOUT - 1,
+                   .mv_data = (void *)DB_CONF_LAYOUT};
+    MDB_val v   = {0};
+    int     mrc = mdb_get(txn, DB->db_store_conf, &k, &v);
+    if(mrc == MDB_SUCCESS)
+    {
+        if(v.mv_size >= sizeof name)
+            return MDB_INCOMPATIBLE;
+        memcpy(name, v.mv_data, v.mv_size);
+        name[v.mv_size] = '\0';
+        if(fs_layout_parse(name, cur) != 0)
+            return MDB_INCOMPATIBLE; /* written by a newer build */
+
+        k.mv_size = sizeof DB_CONF_LAYOUT_FROM - 1;
+        k.mv_data = (void *)DB_CONF_LAYOUT_FROM;
+        mrc       = mdb_get(txn, DB->db_store_conf, &k, &v);
+        if(mrc == MDB_NOTFOUND)
+            return MDB_SUCCESS;
+        if(mrc != MDB_SUCCESS)
+            return mrc;
+        if(v.mv_size >= sizeof name)
+            return MDB_INCOMPATIBLE;
+        memcpy(name, v.mv_data, v.mv_size);
+        name[v.mv_size] = '\0';
+        if(fs_layout_parse(name, from) != 0)
+            return MDB_INCOMPATIBLE;
+        *moving = 1;
+        return MDB_SUCCESS;
+    }
+    if(mrc != MDB_NOTFOUND)
+        return mrc;
+
+    /* DB_SHARD_LAYOUT=<levels>x<width> only shapes a new store: existing
+       blobs sit in xx/yy (db_data_relayout() moves them) */
+    MDB_stat metas, trash, uploads;
+    if(mdb_stat(txn, DB->db_data_id2meta, &metas) != MDB_SUCCESS ||
+       mdb_stat(txn, DB->db_data_trash, &trash) != MDB_SUCCESS ||
+       mdb_stat(txn, DB->db_data_uploads, &uploads) != MDB_SUCCESS)
+        return MDB_PANIC;
+    const char *sl = getenv("DB_SHARD_LAYOUT");
+    *cur           = FS_LAYOUT_DEFAULT; /* kept when 'sl' does not parse */
+    if(metas.ms_entries == 0 && trash.ms_entries == 0 &&
+       uploads.ms_entries == 0 && sl && !db_objects_present(DB->root))
+        (void)fs_layout_parse(sl, cur);
+    fs_layout_name(*cur, name);
+    v.mv_data = name;
+    v.mv_size = strlen(name);
+    return mdb_put(txn, DB->db_store_conf, &k, &v, 0);
+}
@@ -0,0 +1,306 @@
+/**
+ * @file db_gc.c
+ * @brief Orphan GC: blobs and temps under objects/sha256 that no record
+ *        needs any more.
+ *
+ * @author  Roman Horshkov <roman.horshkov@gmail.com>
+ * @date    2025
+ * (c) 2025
+ */
+
+#include "db_int.h"
+#include "fsutil.h"
+#include "sha256.h"
+#include "workpool.h"
+
+#include <pthread.h>
+
+/****************************************************************************
+ * PRIVATE DEFINES
+ ****************************************************************************
+ */
+
+/* Content that lives somewhere else than a blob file */
+#define GC_NOT_BLOB (DB_DATA_F_INLINE | DB_DATA_F_PACKED | DB_DATA_F_CHUNKED)
+
+/****************************************************************************
+ * PRIVATE STUCTURED VARIABLES
+ ****************************************************************************
+ */
+
+/* One pass, shared by the shard walkers */
+typedef struct
+{
+    time_t before;  /* files changed after this are young */
+    int    dry_run;
+
+    /* removal pacing: the next unlink may start at 'next_ns' */
+    pthread_mutex_t rate_mu;
+    uint64_t        step_ns; /* 0 = unlimited */
+    uint64_t        next_ns;
+
+    _Atomic uint64_t shards;
+    _Atomic uint64_t objects;
+    _Atomic uint64_t orphans;
+    _Atomic uint64_t orphan_bytes;
+    _Atomic uint64_t temps;
+    _Atomic uint64_t temp_bytes;
+    _Atomic uint64_t removed;
+    _Atomic uint64_t young;
+    _Atomic uint64_t errors;
+    _Atomic int      nomem;
+} GcRun;
+
+/****************************************************************************
+ * PRIVATE VARIABLES
+ ****************************************************************************
+ */
+/* None */
+
+/****************************************************************************
+ * PRIVATE FUNCTIONS PROTOTYPES
+ ****************************************************************************
+ */
+
+/* wp_item_fn: sweep the temps of shard 'i' and collect its orphans. */
+static void gc_shard(size_t i, void *user);
+
+/* Merge-join the sorted digests d[0..n) against data_sha2ids (and probe the
+   trash for the misses) in one read snapshot; orphans are compacted to the
+   front of 'd'. Their count, or -1 on an LMDB error. */
+static long gc_join(uint8_t *d, size_t n);
+
+/* 1 when no record of 'sha' keeps its bytes in a blob, 0 when one does,
+   -1 on an LMDB error. */
+static int gc_unreferenced(MDB_txn *txn, const uint8_t sha[32]);
+
+/* Re-check orphan 'sha' under the write lock and unlink its blob. 1 removed,
+   0 referenced meanwhile or already gone, -1 on error. */
+static int gc_remove(const uint8_t sha[32], const char hex[65]);
+
+/* Block until the rate limit allows one more removal. */
+static void gc_rate_wait(GcRun *run);
+
+static uint64_t gc_now_ns(void);
+
+/****************************************************************************
+ * PUBLIC FUNCTIONS DEFINITIONS
+ ****************************************************************************
+ */
+
+int db_data_gc(const DbGcOptions *opt, DbGcReport *out_report)
+{
+    if(out_report)
+        memset(out_report, 0, sizeof *out_report);
+    if(!DB || !DB->env || !DB->objdir)
+        return -EINVAL;
+
+    DbGcOptions o = {.grace_secs = DB->gc_grace};
+    if(opt)
+        o = *opt;
+
+    GcRun run;
+    memset(&run, 0, sizeof run);
+    run.before  = time(NULL) - (time_t)o.grace_secs;
+    run.dry_run = o.dry_run;
+    run.step_ns = o.max_per_sec ? 1000000000ull / o.max_per_sec : 0;
+    pthread_mutex_init(&run.rate_mu, NULL);
+
+    /* named ingest temps and retired objects sit next to the shards */
+    FsTempSweep top = {0};
+    if(fs_objdir_sweep_temps(DB->objdir, run.before, run.dry_run, &top) != 0)
+        atomic_fetch_add(&run.errors, 1);
+    run.temps      = top.found;
+    run.temp_bytes = top.bytes;
+    run.removed    = top.removed;
+    run.young      = top.young;
+
+    wp_parallel_for(fs_objdir_shards(DB->objdir),
+                    o.threads ? o.threads : DB->ingest_threads, gc_shard, &run);
+    pthread_mutex_destroy(&run.rate_mu);
+
+    if(out_report)
+    {
+        out_report->shards       = atomic_load(&run.shards);
+        out_report->objects      = atomic_load(&run.objects);
+        out_report->orphans      = atomic_load(&run.orphans);
+        out_report->orphan_bytes = atomic_load(&run.orphan_bytes);
+        out_report->temps        = atomic_load(&run.temps);
+        out_report->temp_bytes   = atomic_load(&run.temp_bytes);
+        out_report->removed      = atomic_load(&run.removed);
+        out_report->young        = atomic_load(&run.young);
+        out_report->errors       = atomic_load(&run.errors);
+    }
+    return atomic_load(&run.nomem) ? -ENOMEM : 0;
+}
+
+/****************************************************************************
+ * PRIVATE FUNCTIONS DEFINITIONS
+ ****************************************************************************
+ */
+
+static void gc_shard(size_t i, void *user)
+{
+    GcRun      *run = user;
+    uint8_t    *d   = NULL;
+    size_t      n   = 0;
+    FsTempSweep tmp = {0};
+    if(fs_objdir_scan_shard(DB->objdir, (unsigned)i, run->before, run->dry_run,
+                            &d, &n, &tmp) != 0)
+    {
+        if(errno == ENOMEM)
+            atomic_store(&run->nomem, 1);
+        atomic_fetch_add(&run->errors, 1);
+        return;
+    }
+    atomic_fetch_add(&run->shards, 1);
+    atomic_fetch_add(&run->temps, tmp.found);
+    atomic_fetch_add(&run->temp_bytes, tmp.bytes);
+    atomic_fetch_add(&run->removed, tmp.removed);
+    atomic_fetch_add(&run->young, tmp.young);
+    if(n == 0)
+        return;
+    atomic_fetch_add(&run->objects, n);
+
+    long orphans = gc_join(d, n);
+    if(orphans < 0)
+        atomic_fetch_add(&run->errors, 1);
+
+    for(long k = 0; k < orphans; ++k)
+    {
+        const uint8_t *sha = d + (size_t)k * 32;
+        char           hex[65];
+        Sha256         dg;
+        struct stat    st;
+        memcpy(dg.b, sha, 32);
+        crypt_sha256_hex(&dg, hex);
+        if(fs_objdir_stat_object(DB->objdir, hex, &st) != 0)
+            continue; /* removed by a delete meanwhile */
+        if(st.st_ctime > run->before)
+        {
+            atomic_fetch_add(&run->young, 1); /* upload not indexed yet */
+            continue;
+        }
+        atomic_fetch_add(&run->orphans, 1);
+        atomic_fetch_add(&run->orphan_bytes, (uint64_t)st.st_size);
+        if(run->dry_run)
+            continue;
+
+        gc_rate_wait(run);
+        int rc = gc_remove(sha, hex);
+        if(rc > 0)
+            atomic_fetch_add(&run->removed, 1);
+        else if(rc < 0)
+            atomic_fetch_add(&run->errors, 1);
+    }
+    free(d);
+}
+
+static long gc_join(uint8_t *d, size_t n)
+{
+    MDB_txn    *txn = NULL;
+    MDB_cursor *cur = NULL;
+    if(mdb_txn_begin(DB->env, NULL, MDB_RDONLY, &txn) != MDB_SUCCESS)
+        return -1;
+    if(mdb_cursor_open(txn, DB->db_data_sha2ids, &cur) != MDB_SUCCESS)
+    {
+        mdb_txn_abort(txn);
+        return -1;
+    }
+
+    /* both sides are sorted: one forward pass over the shard's key range */
+    MDB_val k   = {.mv_size = 32, .mv_data = d};
+    MDB_val v   = {0};
+    int     mrc = mdb_cursor_get(cur, &k, &v, MDB_SET_RANGE);
+    long    out = 0;
+    for(size_t i = 0; i < n; ++i)
+    {
+        const uint8_t *sha = d + i * 32;
+        int            cmp = 1; /* index exhausted: everything left is orphan */
+        while(mrc == MDB_SUCCESS && (cmp = memcmp(k.mv_data, sha, 32)) < 0)
+            mrc = mdb_cursor_get(cur, &k, &v, MDB_NEXT_NODUP);
+        if(mrc != MDB_SUCCESS && mrc != MDB_NOTFOUND)
+        {
+            out = -1;
+            break;
+        }
+        if(mrc == MDB_NOTFOUND)
+            cmp = 1;
+
+        /* no live record: a trashed one may still hold the blob */
+        int     orphan = 1;
+        MDB_val tk     = {.mv_size = 32, .mv_data = (void *)sha};
+        MDB_val tv     = {0};
+        if(cmp == 0 ||
+           mdb_get(txn, DB->db_data_trash_sha, &tk, &tv) != MDB_NOTFOUND)
+        {
+            orphan = gc_unreferenced(txn, sha);
+            if(orphan < 0)
+            {
+                out = -1;
+                break;
+            }
+        }
+        if(orphan)
+            memmove(d + (size_t)out++ * 32, sha, 32);
+    }
+
+    mdb_cursor_close(cur);
+    mdb_txn_abort(txn);
+    return out;
+}
+
+static int gc_unreferenced(MDB_txn *txn, const uint8_t sha[32])
+{
+    /* every record of a digest agrees on where the bytes live */
+    DataMeta any;
+    MDB_val  k   = {.mv_size = 32, .mv_data = (void *)sha};
+    int      mrc = db_data_sha_any_meta(txn, &k, &any);
+    if(mrc == MDB_NOTFOUND)
+        return 1;
+    if(mrc != MDB_SUCCESS)
+        return -1;
+    return (any.flags & GC_NOT_BLOB) != 0;
+}
+
+static int gc_remove(const uint8_t sha[32], const char hex[65])
+{
+    /* an upload indexes a new blob reference only after it stat()ed the
+       blob inside its write txn: holding the write lock across the check
+       and the unlink means it either committed first or sees ENOENT */
+    MDB_txn *txn = NULL;
+    if(mdb_txn_begin(DB->env, NULL, 0, &txn) != MDB_SUCCESS)
+        return -1;
+    int rc = gc_unreferenced(txn, sha);
+    if(rc == 1 && fs_objdir_unlink_object(DB->objdir, hex) != 0)
+        rc = errno == ENOENT ? 0 : -1;
+    mdb_txn_abort(txn);
+    return rc;
+}
+
+static void gc_rate_wait(GcRun *run)
+{
+    if(run->step_ns == 0)
+        return;
+    pthread_mutex_lock(&run->rate_mu);
+    uint64_t now = gc_now_ns();
+    uint64_t at  = run->next_ns > now ? run->next_ns : now;
+    run->next_ns = at + run->step_ns;
+    pthread_mutex_unlock(&run->rate_mu);
+
+    if(at > now)
+    {
+        struct timespec ts = {.tv_sec  = (time_t)((at - now) / 1000000000ull),
+                              .tv_nsec = (long)((at - now) % 1000000000ull)};
+        while(nanosleep(&ts, &ts) != 0 && errno == EINTR)
+        {
+        }
+    }
+}
+
+static uint64_t gc_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
@@ -0,0 +1,192 @@
+/**
+ * @file db_layout.c
+ * @brief Shard layout of objects/<digest>: online re-layout of the blob
+ *        tree to another fan-out.
+ *
+ * @author  Roman Horshkov <roman.horshkov@gmail.com>
+ * @date    2025
+ * (c) 2025
+ */
+
+#include "db_int.h"
+#include "fsutil.h"
+#include "workpool.h"
+
+#include <pthread.h>
+
+/****************************************************************************
+ * PRIVATE DEFINES
+ ****************************************************************************
+ */
+/* None */
+
+/****************************************************************************
+ * PRIVATE STUCTURED VARIABLES
+ ****************************************************************************
+ */
+
+/* One pass, shared by the shard movers */
+typedef struct
+{
+    _Atomic uint64_t shards;
+    _Atomic uint64_t moved;
+    _Atomic uint64_t merged;
+    _Atomic uint64_t errors;
+} RelayoutRun;
+
+/****************************************************************************
+ * PRIVATE VARIABLES
+ ****************************************************************************
+ */
+
+/* One re-layout at a time: the second caller gets -EBUSY */
+static pthread_mutex_t RELAYOUT_MU = PTHREAD_MUTEX_INITIALIZER;
+
+/****************************************************************************
+ * PRIVATE FUNCTIONS PROTOTYPES
+ ****************************************************************************
+ */
+
+/* wp_item_fn: move the blobs of old leaf 'i'. */
+static void relayout_shard(size_t i, void *user);
+
+/* Record 'to' as the layout (and 'from' as the previous one, or drop the
+   previous one when 'from' is NULL) in one write txn. 0 or -errno. */
+static int relayout_conf_put(FsLayout to, const FsLayout *from);
+
+/****************************************************************************
+ * PUBLIC FUNCTIONS DEFINITIONS
+ ****************************************************************************
+ */
+
+int db_data_relayout(const DbRelayoutOptions *opt,
+                     DbRelayoutReport *out_report)
+{
+    if(out_report)
+        memset(out_report, 0, sizeof *out_report);
+    if(!DB || !DB->env || !DB->objdir || !opt)
+        return -EINVAL;
+    FsLayout to = {opt->levels, opt->width};
+    if(!fs_layout_valid(to))
+        return -EINVAL;
+    if(pthread_mutex_trylock(&RELAYOUT_MU) != 0)
+        return -EBUSY;
+
+    FsLayout cur, from;
+    int      moving = fs_objdir_layout(DB->objdir, &cur, &from);
+    int      rc     = 0;
+    if(moving && (cur.levels != to.levels || cur.width != to.width))
+        rc = -EBUSY; /* finish the interrupted one first */
+    else if(!moving && cur.levels == to.levels && cur.width == to.width)
+        goto out;
+    else if(!moving)
+    {
+        /* recorded first: a crash from here on resumes at db_open */
+        rc = relayout_conf_put(to, &cur);
+        if(rc == 0 && fs_objdir_relayout_begin(DB->objdir, to) != 0)
+            rc = -errno;
+    }
+    if(rc != 0)
+        goto out;
+
+    RelayoutRun run;
+    memset(&run, 0, sizeof run);
+    wp_parallel_for(fs_objdir_relink_shards(DB->objdir),
+                    opt->threads ? opt->threads : DB->ingest_threads,
+                    relayout_shard, &run);
+    if(out_report)
+    {
+        out_report->shards = atomic_load(&run.shards);
+        out_report->moved  = atomic_load(&run.moved);
+        out_report->merged = atomic_load(&run.merged);
+        out_report->errors = atomic_load(&run.errors);
+    }
+    if(atomic_load(&run.errors) != 0)
+    {
+        rc = -EIO; /* the fallback stays on; the next call resumes */
+        goto out;
+    }
+    rc = relayout_conf_put(to, NULL);
+    if(rc == 0)
+        fs_objdir_relayout_end(DB->objdir);
+
+out:
+    pthread_mutex_unlock(&RELAYOUT_MU);
+    return rc;
+}
+
+int db_data_layout(unsigned *out_levels, unsigned *out_width)
+{
+    if(!DB || !DB->objdir || !out_levels || !out_width)
+        return -EINVAL;
+    FsLayout cur;
+    int      moving = fs_objdir_layout(DB->objdir, &cur, NULL);
+    *out_levels     = cur.levels;
+    *out_width      = cur.width;
+    return moving;
+}
+
+/****************************************************************************
+ * PRIVATE FUNCTIONS DEFINITIONS
+ ****************************************************************************
+ */
+
+static void relayout_shard(size_t i, void *user)
+{
+    RelayoutRun *run = user;
+    FsRelink     st  = {0};
+    if(fs_objdir_relink_shard(DB->objdir, i, &st) != 0)
+    {
+        atomic_fetch_add(&run->errors, 1);
+        return;
+    }
+    atomic_fetch_add(&run->shards, 1);
+    atomic_fetch_add(&run->moved, st.moved);
+    atomic_fetch_add(&run->merged, st.merged);
+    atomic_fetch_add(&run->errors, st.errors);
+}
+
+static int relayout_conf_put(FsLayout to, const FsLayout *from)
+{
+retry_chunk:
+    MDB_txn *txn = NULL;
+    int      mrc = mdb_txn_begin(DB->env, NULL, 0, &txn);
+    if(mrc != MDB_SUCCESS)
+        return db_map_mdb_err(mrc);
+
+    char    name[8];
+    MDB_val k = {.mv_size = sizeof DB_CONF_LAYOUT - 1,
+                 .mv_data = (void *)DB_CONF_LAYOUT};
+    fs_layout_name(to, name);
+    MDB_val v = {.mv_size = strlen(name), .mv_data = name};
+    mrc       = mdb_put(txn, DB->db_store_conf, &k, &v, 0);
+
+    k.mv_size = sizeof DB_CONF_LAYOUT_FROM - 1;
+    k.mv_data = (void *)DB_CONF_LAYOUT_FROM;
+    if(mrc == MDB_SUCCESS && from)
+    {
+        char prev[8];
+        fs_layout_name(*from, prev);
+        v.mv_size = strlen(prev);
+        v.mv_data = prev;
+        mrc       = mdb_put(txn, DB->db_store_conf, &k, &v, 0);
+    }
+    else if(mrc == MDB_SUCCESS)
+    {
+        mrc = mdb_del(txn, DB->db_store_conf, &k, NULL);
+        if(mrc == MDB_NOTFOUND)
+            mrc = MDB_SUCCESS;
+    }
+    if(mrc == MDB_SUCCESS)
+        mrc = mdb_txn_commit(txn);
+    else
+        mdb_txn_abort(txn);
+    if(mrc == MDB_MAP_FULL)
+    {
+        int grc = db_env_mapsize_expand(); /* grow */
+        if(grc != 0)
+            return db_map_mdb_err(grc); /* stop if grow failed */
+        goto retry_chunk;               /* retry whole chunk */
+    }
+    return mrc == MDB_SUCCESS ? 0 : db_map_mdb_err(mrc);
+}
@@ -0,0 +1,270 @@
+/**
+ * @file db_meta_cache.c
+ * @brief Sharded, set-associative data_id -> DataMeta cache.
+ *
+ * @author  Roman Horshkov <roman.horshkov@gmail.com>
+ * @date    2025
+ * (c) 2025
+ */
+
+#include "db_meta_cache.h"
+
+#include <pthread.h>
+
+/****************************************************************************
+ * PRIVATE DEFINES
+ ****************************************************************************
+ */
+
+/* Independently locked parts; an id's shard comes from its hash */
+#ifndef META_CACHE_SHARDS
+#    define META_CACHE_SHARDS 64u
+#endif
+
+/* Entries per set: a lookup compares at most this many ids */
+#define META_CACHE_WAYS 4u
+
+/****************************************************************************
+ * PRIVATE STUCTURED VARIABLES
+ ****************************************************************************
+ */
+
+typedef struct
+{
+    uint8_t  id[DB_ID_SIZE];
+    uint8_t  used; /* slot holds an entry */
+    uint8_t  ref;  /* hit since the clock hand last passed */
+    DataMeta meta;
+} MetaSlot;
+
+/* Cache-line aligned: threads on different shards share no line */
+typedef struct
+{
+    _Alignas(64) pthread_mutex_t lock;
+    uint64_t  gen;      /* bumped by every drop */
+    uint64_t  hits;
+    uint64_t  misses;
+    size_t    count;    /* used slots */
+    size_t    set_mask; /* sets - 1 (power of two) */
+    unsigned  hand;     /* clock hand, shared by the sets */
+    MetaSlot* slots;    /* sets * META_CACHE_WAYS */
+} MetaShard;
+
+struct MetaCache
+{
+    size_t    capacity;
+    MetaShard shard[META_CACHE_SHARDS];
+};
+
+/****************************************************************************
+ * PRIVATE VARIABLES
+ ****************************************************************************
+ */
+/* None */
+
+/****************************************************************************
+ * PRIVATE FUNCTIONS PROTOTYPES
+ ****************************************************************************
+ */
+
+/* Ids are time-ordered UUIDs: mix both halves so that neighbours spread */
+static inline uint64_t meta_cache_hash(const uint8_t id[DB_ID_SIZE]);
+
+/* Set of 'id' in its shard (*out_shard); NULL when the cache is off */
+static MetaSlot* meta_cache_set(MetaCache* mc, const uint8_t id[DB_ID_SIZE],
+                                MetaShard** out_shard);
+
+/* Way of 'set' holding 'id', or NULL */
+static MetaSlot* meta_set_find(MetaSlot* set, const uint8_t id[DB_ID_SIZE]);
+
+/****************************************************************************
+ * PUBLIC FUNCTIONS DEFINITIONS
+ ****************************************************************************
+ */
+
+MetaCache* meta_cache_create(size_t entries)
+{
+    size_t per  = (entries + META_CACHE_SHARDS - 1) / META_CACHE_SHARDS;
+    size_t sets = 1;
+    while(sets * META_CACHE_WAYS < per)
+        sets <<= 1;
+
+    void* mem = NULL;
+    if(posix_memalign(&mem, 64, sizeof(MetaCache)) != 0)
+        return NULL;
+    MetaCache* mc = mem;
+    memset(mc, 0, sizeof *mc);
+    mc->capacity = sets * META_CACHE_WAYS * META_CACHE_SHARDS;
+
+    for(unsigned i = 0; i < META_CACHE_SHARDS; ++i)
+    {
+        MetaShard* s = &mc->shard[i];
+        s->set_mask  = sets - 1;
+        s->slots     = calloc(sets * META_CACHE_WAYS, sizeof(MetaSlot));
+        if(!s->slots || pthread_mutex_init(&s->lock, NULL) != 0)
+        {
+            free(s->slots);
+            s->slots = NULL;
+            meta_cache_destroy(mc);
+            return NULL;
+        }
+    }
+    return mc;
+}
+
+void meta_cache_destroy(MetaCache* mc)
+{
+    if(!mc)
+        return;
+    for(unsigned i = 0; i < META_CACHE_SHARDS; ++i)
+    {
+        if(!mc->shard[i].slots)
+            break; /* creation stopped here */
+        pthread_mutex_destroy(&mc->shard[i].lock);
+        free(mc->shard[i].slots);
+    }
+    free(mc);
+}
+
+int meta_cache_get(MetaCache* mc, const uint8_t id[DB_ID_SIZE], DataMeta* out,
+                   uint64_t* gen)
+{
+    MetaShard* s;
+    MetaSlot*  set = meta_cache_set(mc, id, &s);
+    if(!set)
+        return -ENOENT;
+
+    pthread_mutex_lock(&s->lock);
+    MetaSlot* e = meta_set_find(set, id);
+    if(e)
+    {
+        memcpy(out, &e->meta, sizeof *out);
+        e->ref = 1;
+        ++s->hits;
+    }
+    else
+    {
+        *gen = s->gen;
+        ++s->misses;
+    }
+    pthread_mutex_unlock(&s->lock);
+    return e ? 0 : -ENOENT;
+}
+
+void meta_cache_put(MetaCache* mc, const uint8_t id[DB_ID_SIZE],
+                    const DataMeta* meta, uint64_t gen)
+{
+    MetaShard* s;
+    MetaSlot*  set = meta_cache_set(mc, id, &s);
+    if(!set)
+        return;
+
+    pthread_mutex_lock(&s->lock);
+    if(s->gen != gen)
+    {
+        pthread_mutex_unlock(&s->lock);
+        return;
+    }
+    MetaSlot* e = meta_set_find(set, id); /* filled by a concurrent miss */
+    for(unsigned w = 0; !e && w < META_CACHE_WAYS; ++w)
+        if(!set[w].used)
+            e = &set[w];
+    if(!e)
+    {
+        /* second chance: the first way not hit since the hand passed */
+        unsigned start = s->hand++ % META_CACHE_WAYS;
+        for(unsigned i = 0; i < META_CACHE_WAYS && !e; ++i)
+        {
+            MetaSlot* w = &set[(start + i) % META_CACHE_WAYS];
+            if(w->ref)
+                w->ref = 0;
+            else
+                e = w;
+        }
+        if(!e)
+            e = &set[start];
+    }
+    if(!e->used)
+        ++s->count;
+    memcpy(e->id, id, DB_ID_SIZE);
+    memcpy(&e->meta, meta, sizeof e->meta);
+    e->used = 1;
+    e->ref  = 0;
+    pthread_mutex_unlock(&s->lock);
+}
+
+void meta_cache_drop(MetaCache* mc, const uint8_t id[DB_ID_SIZE])
+{
+    MetaShard* s;
+    MetaSlot*  set = meta_cache_set(mc, id, &s);
+    if(!set)
+        return;
+
+    pthread_mutex_lock(&s->lock);
+    ++s->gen;
+    MetaSlot* e = meta_set_find(set, id);
+    if(e)
+    {
+        e->used = 0;
+        --s->count;
+    }
+    pthread_mutex_unlock(&s->lock);
+}
+
+void meta_cache_stats(MetaCache* mc, uint64_t* hits, uint64_t* misses,
+                      size_t* entries, size_t* capacity)
+{
+    uint64_t h = 0, m = 0;
+    size_t   n = 0;
+    for(unsigned i = 0; mc && i < META_CACHE_SHARDS; ++i)
+    {
+        MetaShard* s = &mc->shard[i];
+        pthread_mutex_lock(&s->lock);
+        h += s->hits;
+        m += s->misses;
+        n += s->count;
+        pthread_mutex_unlock(&s->lock);
+    }
+    if(hits)
+        *hits = h;
+    if(misses)
+        *misses = m;
+    if(entries)
+        *entries = n;
+    if(capacity)
+        *capacity = mc ? mc->capacity : 0;
+}
+
+/****************************************************************************
+ * PRIVATE FUNCTIONS DEFINITIONS
+ ****************************************************************************
+ */
+
+static inline uint64_t meta_cache_hash(const uint8_t id[DB_ID_SIZE])
+{
+    uint64_t a, b;
+    memcpy(&a, id, 8);
+    memcpy(&b, id + 8, 8);
+    uint64_t h = (a ^ (b * 0x9E3779B97F4A7C15ull)) * 0xBF58476D1CE4E5B9ull;
+    return h ^ (h >> 31);
+}
+
+static MetaSlot* meta_cache_set(MetaCache* mc, const uint8_t id[DB_ID_SIZE],
+                                MetaShard** out_shard)
+{
+    if(!mc || !id)
+        return NULL;
+    uint64_t   h = meta_cache_hash(id);
+    MetaShard* s = &mc->shard[h % META_CACHE_SHARDS];
+    *out_shard   = s;
+    return s->slots +
+           ((size_t)(h / META_CACHE_SHARDS) & s->set_mask) * META_CACHE_WAYS;
+}
+
+static MetaSlot* meta_set_find(MetaSlot* set, const uint8_t id[DB_ID_SIZE])
+{
+    for(unsigned w = 0; w < META_CACHE_WAYS; ++w)
+        if(set[w].used && memcmp(set[w].id, id, DB_ID_SIZE) == 0)
+            return &set[w];
+    return NULL;
+}
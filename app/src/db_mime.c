@@ -0,0 +1,172 @@
+/**
+ * @file db_mime.c
+ * @brief
+ *
+ * @author  Roman Horshkov <roman.horshkov@gmail.com>
+ * @date    2025
+ * (c) 2025
+ */
+
+#include "db_mime.h"
+
+#include <pthread.h>
+
+/****************************************************************************
+ * PRIVATE DEFINES
+ ****************************************************************************
+ */
+
+/* Ids cached in memory; a store typically has a few dozen MIME types and
+   ids past this are read from the dictionary on every lookup. */
+#ifndef MIME_CACHE_SLOTS
+#define MIME_CACHE_SLOTS 1024
+#endif
+
+#define MIME_ID_MAX 0xFFFFu /* id 0 is never handed out */
+
+/****************************************************************************
+ * PRIVATE STUCTURED VARIABLES
+ ****************************************************************************
+ */
+
+struct MimeCache
+{
+    pthread_mutex_t fill;                    /* serializes slot fills */
+    _Atomic uint8_t ready[MIME_CACHE_SLOTS]; /* slot published (release) */
+    char            name[MIME_CACHE_SLOTS][32];
+};
+
+/****************************************************************************
+ * PRIVATE VARIABLES
+ ****************************************************************************
+ */
+/* None */
+
+/****************************************************************************
+ * PRIVATE FUNCTIONS PROTOTYPES
+ ****************************************************************************
+ */
+
+/* 2-byte big-endian dictionary key: ids sort numerically */
+static inline void mime_id_key(uint8_t out[2], uint16_t id)
+{
+    out[0] = (uint8_t)(id >> 8);
+    out[1] = (uint8_t)id;
+}
+
+/****************************************************************************
+ * PUBLIC FUNCTIONS DEFINITIONS
+ ****************************************************************************
+ */
+
+MimeCache* mime_cache_create(void)
+{
+    MimeCache* mc = calloc(1, sizeof *mc);
+    if(!mc)
+        return NULL;
+    if(pthread_mutex_init(&mc->fill, NULL) != 0)
+    {
+        free(mc);
+        return NULL;
+    }
+    return mc;
+}
+
+void mime_cache_destroy(MimeCache* mc)
+{
+    if(!mc)
+        return;
+    pthread_mutex_destroy(&mc->fill);
+    free(mc);
+}
+
+int mime_intern(MDB_txn* txn, const char* mime, uint16_t* out_id)
+{
+    if(!txn || !out_id)
+        return -EINVAL;
+
+    /* same truncation as DataMeta.mime, so lookups round-trip exactly */
+    char name[32];
+    snprintf(name, sizeof name, "%s",
+             (mime && *mime) ? mime : "application/octet-stream");
+
+    MDB_val k   = {.mv_size = strlen(name), .mv_data = name};
+    MDB_val v   = {0};
+    int     mrc = mdb_get(txn, DB->db_mime_str2id, &k, &v);
+    if(mrc == MDB_SUCCESS && v.mv_size == sizeof(uint16_t))
+    {
+        memcpy(out_id, v.mv_data, sizeof *out_id);
+        return 0;
+    }
+    if(mrc != MDB_NOTFOUND)
+        return -EIO;
+
+    /* append-only dictionary: the next id is the entry count + 1 */
+    MDB_stat st;
+    if(mdb_stat(txn, DB->db_mime_id2str, &st) != MDB_SUCCESS)
+        return -EIO;
+    if(st.ms_entries >= MIME_ID_MAX)
+        return -ENOSPC;
+    uint16_t id = (uint16_t)(st.ms_entries + 1);
+
+    uint8_t idk[2];
+    mime_id_key(idk, id);
+    MDB_val ik = {.mv_size = sizeof idk, .mv_data = idk};
+    MDB_val iv = {.mv_size = strlen(name), .mv_data = name};
+    mrc        = mdb_put(txn, DB->db_mime_id2str, &ik, &iv, MDB_NOOVERWRITE);
+    if(mrc == MDB_SUCCESS)
+    {
+        MDB_val sv = {.mv_size = sizeof id, .mv_data = &id};
+        mrc = mdb_put(txn, DB->db_mime_str2id, &k, &sv, MDB_NOOVERWRITE);
+    }
+    if(mrc == MDB_MAP_FULL)
+        return mrc;
+    if(mrc != MDB_SUCCESS)
+        return -EIO;
+    *out_id = id;
+    return 0;
+}
+
+int mime_lookup(MDB_txn* txn, uint16_t id, char out[32])
+{
+    if(!txn || !out || id == 0)
+        return -EINVAL;
+
+    MimeCache* mc = DB->mime_cache;
+    if(mc && id < MIME_CACHE_SLOTS &&
+       atomic_load_explicit(&mc->ready[id], memory_order_acquire))
+    {
+        memcpy(out, mc->name[id], 32);
+        return 0;
+    }
+
+    uint8_t idk[2];
+    mime_id_key(idk, id);
+    MDB_val k   = {.mv_size = sizeof idk, .mv_data = idk};
+    MDB_val v   = {0};
+    int     mrc = mdb_get(txn, DB->db_mime_id2str, &k, &v);
+    if(mrc == MDB_NOTFOUND)
+        return -ENOENT;
+    if(mrc != MDB_SUCCESS || v.mv_size == 0 || v.mv_size > 31)
+        return -EIO;
+    memset(out, 0, 32);
+    memcpy(out, v.mv_data, v.mv_size);
+
+    if(mc && id < MIME_CACHE_SLOTS)
+    {
+        pthread_mutex_lock(&mc->fill);
+        if(!atomic_load_explicit(&mc->ready[id], memory_order_relaxed))
+        {
+            memcpy(mc->name[id], out, 32);
+            atomic_store_explicit(&mc->ready[id], 1, memory_order_release);
+        }
+        pthread_mutex_unlock(&mc->fill);
+    }
+    return 0;
+}
+
+/****************************************************************************
+ * PRIVATE FUNCTIONS DEFINITIONS
+ ****************************************************************************
+ */
+/* None */
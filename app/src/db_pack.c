@@ -0,0 +1,872 @@
+/**
+ * @file db_pack.c
+ * @brief
+ *
+ * @author  Roman Horshkov <roman.horshkov@gmail.com>
+ * @date    2025
+ * (c) 2025
+ */
+
+#include "db_pack.h"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+/****************************************************************************
+ * PRIVATE DEFINES
+ ****************************************************************************
+ */
+
+#define PACK_DIR        "objects/packs"
+#define PACK_NAME_FMT   "pack-%08x.dat"
+#define PACK_NAME_SIZE  24
+#define PACK_EXTENT_KEY 12 /* pack(4, BE) | off(8, BE) */
+#define PACK_EXTENT_VAL 40 /* len(8) | sha(32) */
+
+/* Distinct reader epochs tracked at once */
+#ifndef PACK_READER_EPOCHS
+#    define PACK_READER_EPOCHS 16
+#endif
+
+/****************************************************************************
+ * PRIVATE STUCTURED VARIABLES
+ ****************************************************************************
+ */
+
+/* Outstanding appends into one segment */
+typedef struct
+{
+    uint32_t pack;
+    uint64_t n;
+} PackPin;
+
+/* Readers that entered while the epoch was 'epoch' */
+typedef struct
+{
+    uint64_t epoch;
+    uint64_t n;
+} PackEpoch;
+
+/* A segment emptied by a pass: unlinked once no reader from 'epoch' or
+   before is left */
+typedef struct
+{
+    uint32_t pack;
+    uint64_t epoch;
+} PackRetired;
+
+struct PackStore
+{
+    _Atomic int dirfd;      /* objects/packs, -1 until the first segment */
+    char        dir[2048];  /* created by the first append */
+    uint64_t    segment_max; /* roll-over size */
+
+    /* append segment */
+    pthread_mutex_t mu;
+    uint32_t        cur;     /* id of the open segment (0: none yet) */
+    int             cur_fd;  /* -1 until the first append */
+    uint64_t        cur_off; /* next append offset */
+    int             dirty;   /* written since the last sync */
+
+    PackPin* pins; /* appends not yet indexed (or given up), by segment */
+    size_t   npins, cappins;
+
+    /* readers between pack_reader_enter() and pack_reader_exit() */
+    pthread_mutex_t rd_mu;
+    uint64_t        epoch; /* bumped by every retire */
+    PackEpoch       rd[PACK_READER_EPOCHS]; /* ascending epochs, n > 0 */
+    size_t          nrd;
+
+    /* repack passes (background or db_data_repack) */
+    pthread_mutex_t repack_mu;
+    PackRetired*    retired; /* unlinked by a later pass */
+    size_t          nretired, capretired;
+
+    /* background repacker */
+    pthread_mutex_t bg_mu;
+    pthread_cond_t  bg_cv;
+    pthread_t       bg_thread;
+    int             bg_running;
+    int             bg_stop;
+    unsigned        bg_interval_s;
+    unsigned        bg_dead_pct;
+};
+
+/* One live object of a segment being repacked */
+typedef struct
+{
+    uint8_t  sha[32];
+    uint64_t off;
+    uint64_t len;
+    PackLoc  to;
+} PackMove;
+
+/****************************************************************************
+ * PRIVATE VARIABLES
+ ****************************************************************************
+ */
+/* None */
+
+/****************************************************************************
+ * PRIVATE FUNCTIONS PROTOTYPES
+ ****************************************************************************
+ */
+
+static inline void pack_name(char out[PACK_NAME_SIZE], uint32_t id)
+{
+    snprintf(out, PACK_NAME_SIZE, PACK_NAME_FMT, id);
+}
+
+/* pack(4, BE) | off(8, BE): extents sort by segment, then by offset */
+static inline void pack_extent_key(uint8_t out[PACK_EXTENT_KEY], uint32_t pack,
+                                   uint64_t off)
+{
+    for(int i = 0; i < 4; ++i)
+        out[i] = (uint8_t)(pack >> (24 - 8 * i));
+    for(int i = 0; i < 8; ++i)
+        out[4 + i] = (uint8_t)(off >> (56 - 8 * i));
+}
+
+static inline uint32_t pack_extent_pack(const uint8_t* key)
+{
+    return ((uint32_t)key[0] << 24) | ((uint32_t)key[1] << 16) |
+           ((uint32_t)key[2] << 8) | (uint32_t)key[3];
+}
+
+static inline uint64_t pack_extent_off(const uint8_t* key)
+{
+    uint64_t off = 0;
+    for(int i = 0; i < 8; ++i)
+        off = (off << 8) | key[4 + i];
+    return off;
+}
+
+/* Close the open segment (durable first) and create the next one. */
+static int pack_roll(PackStore* ps);
+
+/* Live bytes per segment id < n, from pack_extents. MDB rc. */
+static int pack_live_bytes(uint32_t n, uint64_t* live);
+
+/* Copy the live objects of segment 'p' to the append segment and repoint
+   their index entries. 0 or -errno. */
+static int pack_move_live(PackStore* ps, uint32_t p);
+
+/* Unlink the retired segments that are still empty, have no pinned
+   appends and no reader left from before their retirement. */
+static void pack_unlink_retired(PackStore* ps);
+
+/* Pins on segment 'p' (ps->mu held). */
+static uint64_t pack_pins(const PackStore* ps, uint32_t p);
+
+/* Oldest epoch a reader is still in, or UINT64_MAX. */
+static uint64_t pack_oldest_reader(PackStore* ps);
+
+static int   pack_retire(PackStore* ps, uint32_t p);
+static void* repacker_main(void* arg);
+
+/****************************************************************************
+ * PUBLIC FUNCTIONS DEFINITIONS
+ ****************************************************************************
+ */
+
+PackStore* pack_store_open(const char* root, uint64_t segment_max)
+{
+    if(!root || segment_max == 0)
+    {
+        errno = EINVAL;
+        return NULL;
+    }
+    PackStore* ps = calloc(1, sizeof *ps);
+    if(!ps)
+        return NULL;
+    int n = snprintf(ps->dir, sizeof ps->dir, "%s/%s", root, PACK_DIR);
+    if(n < 0 || (size_t)n >= sizeof ps->dir)
+    {
+        free(ps);
+        errno = ENAMETOOLONG;
+        return NULL;
+    }
+    ps->segment_max = segment_max;
+    ps->cur_fd      = -1;
+
+    /* stores that never packed have no directory: pack_roll() makes it */
+    int dirfd = open(ps->dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if(dirfd < 0 && errno != ENOENT)
+    {
+        free(ps);
+        return NULL;
+    }
+    atomic_init(&ps->dirfd, dirfd);
+
+    /* resume the newest segment; a torn tail past the last indexed object
+       is dead space for the repacker */
+    DIR* d = dirfd >= 0 ? fdopendir(dup(dirfd)) : NULL;
+    if(d)
+    {
+        struct dirent* e;
+        while((e = readdir(d)))
+        {
+            unsigned id = 0;
+            if(sscanf(e->d_name, "pack-%8x.dat", &id) == 1 && id > ps->cur)
+                ps->cur = id;
+        }
+        closedir(d);
+    }
+    if(ps->cur)
+    {
+        char name[PACK_NAME_SIZE];
+        pack_name(name, ps->cur);
+        ps->cur_fd = openat(dirfd, name, O_RDWR | O_CLOEXEC);
+        struct stat st;
+        if(ps->cur_fd < 0 || fstat(ps->cur_fd, &st) != 0)
+        {
+            if(ps->cur_fd >= 0)
+                close(ps->cur_fd);
+            close(dirfd);
+            free(ps);
+            return NULL;
+        }
+        ps->cur_off = (uint64_t)st.st_size;
+    }
+
+    pthread_condattr_t ca;
+    pthread_condattr_init(&ca);
+    pthread_condattr_setclock(&ca, CLOCK_MONOTONIC);
+    pthread_mutex_init(&ps->mu, NULL);
+    pthread_mutex_init(&ps->rd_mu, NULL);
+    pthread_mutex_init(&ps->repack_mu, NULL);
+    pthread_mutex_init(&ps->bg_mu, NULL);
+    pthread_cond_init(&ps->bg_cv, &ca);
+    pthread_condattr_destroy(&ca);
+    return ps;
+}
+
+void pack_store_close(PackStore* ps)
+{
+    if(!ps)
+        return;
+    if(ps->bg_running)
+    {
+        pthread_mutex_lock(&ps->bg_mu);
+        ps->bg_stop = 1;
+        pthread_cond_broadcast(&ps->bg_cv);
+        pthread_mutex_unlock(&ps->bg_mu);
+        pthread_join(ps->bg_thread, NULL);
+    }
+    if(ps->cur_fd >= 0)
+    {
+        if(ps->dirty)
+            (void)fdatasync(ps->cur_fd);
+        close(ps->cur_fd);
+    }
+    pthread_cond_destroy(&ps->bg_cv);
+    pthread_mutex_destroy(&ps->bg_mu);
+    pthread_mutex_destroy(&ps->repack_mu);
+    pthread_mutex_destroy(&ps->rd_mu);
+    pthread_mutex_destroy(&ps->mu);
+    int dirfd = atomic_load(&ps->dirfd);
+    if(dirfd >= 0)
+        close(dirfd);
+    free(ps->pins);
+    free(ps->retired);
+    free(ps);
+}
+
+int pack_append(PackStore* ps, const void* buf, size_t len, PackLoc* out)
+{
+    if(!ps || (!buf && len) || !out)
+        return -EINVAL;
+
+    pthread_mutex_lock(&ps->mu);
+    if(ps->cur_fd < 0 ||
+       (ps->cur_off > 0 && ps->cur_off + len > ps->segment_max))
+    {
+        int rrc = pack_roll(ps);
+        if(rrc != 0)
+        {
+            pthread_mutex_unlock(&ps->mu);
+            return rrc;
+        }
+    }
+
+    /* room for the pin first: a failed append leaves nothing behind */
+    size_t pin = 0;
+    while(pin < ps->npins && ps->pins[pin].pack != ps->cur)
+        ++pin;
+    if(pin == ps->npins && ps->npins == ps->cappins)
+    {
+        size_t   ncap = ps->cappins ? ps->cappins * 2 : 4;
+        PackPin* np   = realloc(ps->pins, ncap * sizeof *np);
+        if(!np)
+        {
+            pthread_mutex_unlock(&ps->mu);
+            return -ENOMEM;
+        }
+        ps->pins    = np;
+        ps->cappins = ncap;
+    }
+
+    const uint8_t* p    = (const uint8_t*)buf;
+    size_t         done = 0;
+    while(done < len)
+    {
+        ssize_t wr = pwrite(ps->cur_fd, p + done, len - done,
+                            (off_t)(ps->cur_off + done));
+        if(wr > 0)
+            done += (size_t)wr;
+        else if(wr < 0 && errno == EINTR)
+            continue;
+        else
+        {
+            int e = wr < 0 ? errno : EIO;
+            pthread_mutex_unlock(&ps->mu);
+            return -e; /* the torn bytes are never indexed */
+        }
+    }
+    out->pack = ps->cur;
+    out->off  = ps->cur_off;
+    out->len  = (uint64_t)len;
+    ps->cur_off += (uint64_t)len;
+    ps->dirty = 1;
+    if(pin == ps->npins)
+        ps->pins[ps->npins++] = (PackPin){.pack = ps->cur, .n = 0};
+    ps->pins[pin].n++;
+    pthread_mutex_unlock(&ps->mu);
+    return 0;
+}
+
+void pack_release(PackStore* ps, const PackLoc* locs, size_t n)
+{
+    if(!ps || !locs || n == 0)
+        return;
+    pthread_mutex_lock(&ps->mu);
+    for(size_t i = 0; i < n; ++i)
+    {
+        if(locs[i].pack == 0)
+            continue;
+        for(size_t j = 0; j < ps->npins; ++j)
+        {
+            if(ps->pins[j].pack != locs[i].pack)
+                continue;
+            if(--ps->pins[j].n == 0)
+                ps->pins[j] = ps->pins[--ps->npins];
+            break;
+        }
+    }
+    pthread_mutex_unlock(&ps->mu);
+}
+
+uint64_t pack_reader_enter(PackStore* ps)
+{
+    if(!ps)
+        return 0;
+    pthread_mutex_lock(&ps->rd_mu);
+    /* all slots taken: join the newest; an older ticket only keeps more
+       segments around */
+    if(ps->nrd == PACK_READER_EPOCHS ||
+       (ps->nrd && ps->rd[ps->nrd - 1].epoch == ps->epoch))
+        ps->rd[ps->nrd - 1].n++;
+    else
+        ps->rd[ps->nrd++] = (PackEpoch){.epoch = ps->epoch, .n = 1};
+    uint64_t e = ps->rd[ps->nrd - 1].epoch;
+    pthread_mutex_unlock(&ps->rd_mu);
+    return e;
+}
+
+void pack_reader_exit(PackStore* ps, uint64_t ticket)
+{
+    if(!ps)
+        return;
+    pthread_mutex_lock(&ps->rd_mu);
+    for(size_t i = 0; i < ps->nrd; ++i)
+    {
+        if(ps->rd[i].epoch != ticket)
+            continue;
+        if(--ps->rd[i].n == 0)
+        {
+            memmove(&ps->rd[i], &ps->rd[i + 1],
+                    (ps->nrd - i - 1) * sizeof *ps->rd);
+            ps->nrd--;
+        }
+        break;
+    }
+    pthread_mutex_unlock(&ps->rd_mu);
+}
+
+int pack_sync(PackStore* ps)
+{
+    if(!ps)
+        return -EINVAL;
+    int rc = 0;
+    pthread_mutex_lock(&ps->mu);
+    if(ps->dirty && ps->cur_fd >= 0)
+    {
+        if(fdatasync(ps->cur_fd) != 0)
+            rc = -errno;
+        else
+        {
+            ps->dirty = 0;
+            rc        = 1;
+        }
+    }
+    pthread_mutex_unlock(&ps->mu);
+    return rc;
+}
+
+int pack_read(PackStore* ps, const PackLoc* loc, uint64_t off, void* buf,
+              size_t len)
+{
+    if(!ps || !loc || (!buf && len) || off > loc->len ||
+       (uint64_t)len > loc->len - off)
+        return -EINVAL;
+
+    char name[PACK_NAME_SIZE];
+    pack_name(name, loc->pack);
+    int dirfd = atomic_load(&ps->dirfd);
+    int fd    = dirfd >= 0 ? openat(dirfd, name, O_RDONLY | O_CLOEXEC) : -1;
+    if(dirfd < 0)
+        errno = ENOENT;
+    if(fd < 0)
+        return errno == ENOENT ? -ENOENT : -EIO;
+
+    uint8_t* p    = (uint8_t*)buf;
+    size_t   done = 0;
+    while(done < len)
+    {
+        ssize_t rd = pread(fd, p + done, len - done,
+                           (off_t)(loc->off + off + done));
+        if(rd > 0)
+            done += (size_t)rd;
+        else if(rd < 0 && errno == EINTR)
+            continue;
+        else
+            break;
+    }
+    close(fd);
+    return done == len ? 0 : -EIO;
+}
+
+int pack_index_put(MDB_txn* txn, const uint8_t sha[32], const PackLoc* loc)
+{
+    MDB_val sk  = {.mv_size = 32, .mv_data = (void*)sha};
+    MDB_val old = {0};
+    int     mrc = mdb_get(txn, DB->db_data_packs, &sk, &old);
+    if(mrc == MDB_SUCCESS && old.mv_size == sizeof(PackLoc))
+    {
+        PackLoc o;
+        uint8_t ok[PACK_EXTENT_KEY];
+        memcpy(&o, old.mv_data, sizeof o);
+        pack_extent_key(ok, o.pack, o.off);
+        MDB_val ek = {.mv_size = sizeof ok, .mv_data = ok};
+        mrc        = mdb_del(txn, DB->db_pack_extents, &ek, NULL);
+        if(mrc != MDB_SUCCESS && mrc != MDB_NOTFOUND)
+            return mrc;
+    }
+    else if(mrc != MDB_NOTFOUND && mrc != MDB_SUCCESS)
+        return mrc;
+
+    MDB_val lv = {.mv_size = sizeof *loc, .mv_data = (void*)loc};
+    mrc        = mdb_put(txn, DB->db_data_packs, &sk, &lv, 0);
+    if(mrc != MDB_SUCCESS)
+        return mrc;
+
+    uint8_t nk[PACK_EXTENT_KEY];
+    uint8_t nv[PACK_EXTENT_VAL];
+    pack_extent_key(nk, loc->pack, loc->off);
+    memcpy(nv, &loc->len, 8);
+    memcpy(nv + 8, sha, 32);
+    MDB_val ek = {.mv_size = sizeof nk, .mv_data = nk};
+    MDB_val ev = {.mv_size = sizeof nv, .mv_data = nv};
+    return mdb_put(txn, DB->db_pack_extents, &ek, &ev, 0);
+}
+
+int pack_index_get(MDB_txn* txn, const uint8_t sha[32], PackLoc* out)
+{
+    MDB_val sk  = {.mv_size = 32, .mv_data = (void*)sha};
+    MDB_val v   = {0};
+    int     mrc = mdb_get(txn, DB->db_data_packs, &sk, &v);
+    if(mrc != MDB_SUCCESS)
+        return mrc;
+    if(v.mv_size != sizeof *out)
+        return MDB_CORRUPTED;
+    memcpy(out, v.mv_data, sizeof *out);
+    return MDB_SUCCESS;
+}
+
+int pack_index_del(MDB_txn* txn, const uint8_t sha[32])
+{
+    PackLoc loc;
+    int     mrc = pack_index_get(txn, sha, &loc);
+    if(mrc != MDB_SUCCESS)
+        return mrc;
+    uint8_t ok[PACK_EXTENT_KEY];
+    pack_extent_key(ok, loc.pack, loc.off);
+    MDB_val ek = {.mv_size = sizeof ok, .mv_data = ok};
+    mrc        = mdb_del(txn, DB->db_pack_extents, &ek, NULL);
+    if(mrc != MDB_SUCCESS && mrc != MDB_NOTFOUND)
+        return mrc;
+    MDB_val sk = {.mv_size = 32, .mv_data = (void*)sha};
+    return mdb_del(txn, DB->db_data_packs, &sk, NULL);
+}
+
+int pack_repacker_start(PackStore* ps, unsigned interval_s, unsigned dead_pct)
+{
+    if(!ps || interval_s == 0 || ps->bg_running)
+        return -EINVAL;
+    ps->bg_interval_s = interval_s;
+    ps->bg_dead_pct   = dead_pct;
+    int prc = pthread_create(&ps->bg_thread, NULL, repacker_main, ps);
+    if(prc != 0)
+        return -prc;
+    ps->bg_running = 1;
+    return 0;
+}
+
+int db_data_repack(unsigned min_dead_pct, uint64_t* out_reclaimed)
+{
+    if(out_reclaimed)
+        *out_reclaimed = 0;
+    if(!DB || !DB->packs || min_dead_pct > 100)
+        return -EINVAL;
+    PackStore* ps = DB->packs;
+
+    pthread_mutex_lock(&ps->repack_mu);
+    pack_unlink_retired(ps);
+
+    /* the append segment is never repacked; later ids did not exist yet */
+    pthread_mutex_lock(&ps->mu);
+    uint32_t cur = ps->cur;
+    pthread_mutex_unlock(&ps->mu);
+
+    int      rc        = 0;
+    uint64_t reclaimed = 0;
+    uint64_t* live     = cur > 1 ? calloc(cur, sizeof *live) : NULL;
+    if(cur > 1 && !live)
+        rc = -ENOMEM;
+    if(live && pack_live_bytes(cur, live) != MDB_SUCCESS)
+        rc = -EIO;
+
+    for(uint32_t p = 1; rc == 0 && p < cur; ++p)
+    {
+        char        name[PACK_NAME_SIZE];
+        struct stat st;
+        pack_name(name, p);
+        if(fstatat(atomic_load(&ps->dirfd), name, &st, 0) != 0)
+            continue;
+        uint64_t size = (uint64_t)st.st_size;
+        uint64_t dead = size > live[p] ? size - live[p] : 0;
+        if(live[p] != 0 && dead * 100 < (uint64_t)min_dead_pct * size)
+            continue;
+        if(live[p] != 0)
+            rc = pack_move_live(ps, p);
+        if(rc == 0)
+            rc = pack_retire(ps, p);
+        if(rc == 0)
+            reclaimed += dead;
+    }
+
+    free(live);
+    pthread_mutex_unlock(&ps->repack_mu);
+    if(out_reclaimed)
+        *out_reclaimed = reclaimed;
+    return rc;
+}
+
+/****************************************************************************
+ * PRIVATE FUNCTIONS DEFINITIONS
+ ****************************************************************************
+ */
+
+static int pack_roll(PackStore* ps)
+{
+    if(ps->cur_fd >= 0)
+    {
+        if(ps->dirty && fdatasync(ps->cur_fd) != 0)
+            return -errno;
+        close(ps->cur_fd);
+        ps->cur_fd = -1;
+        ps->dirty  = 0;
+    }
+    int dirfd = atomic_load(&ps->dirfd);
+    if(dirfd < 0)
+    {
+        if(mkdir_p(ps->dir, 0770) != 0 && errno != EEXIST)
+            return -errno;
+        dirfd = open(ps->dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if(dirfd < 0)
+            return -errno;
+        atomic_store(&ps->dirfd, dirfd);
+    }
+    char name[PACK_NAME_SIZE];
+    pack_name(name, ps->cur + 1);
+    int fd = openat(dirfd, name, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0640);
+    if(fd < 0)
+        return -errno;
+    /* the new name must survive a crash before anything points into it */
+    if(fsync(dirfd) != 0)
+    {
+        int e = errno;
+        close(fd);
+        (void)unlinkat(dirfd, name, 0);
+        return -e;
+    }
+    ps->cur++;
+    ps->cur_fd  = fd;
+    ps->cur_off = 0;
+    return 0;
+}
+
+static int pack_live_bytes(uint32_t n, uint64_t* live)
+{
+    MDB_txn*    txn = NULL;
+    MDB_cursor* cur = NULL;
+    int         mrc = mdb_txn_begin(DB->env, NULL, MDB_RDONLY, &txn);
+    if(mrc != MDB_SUCCESS)
+        return mrc;
+    mrc = mdb_cursor_open(txn, DB->db_pack_extents, &cur);
+    if(mrc != MDB_SUCCESS)
+    {
+        mdb_txn_abort(txn);
+        return mrc;
+    }
+    MDB_val k = {0}, v = {0};
+    for(mrc = mdb_cursor_get(cur, &k, &v, MDB_FIRST); mrc == MDB_SUCCESS;
+        mrc = mdb_cursor_get(cur, &k, &v, MDB_NEXT))
+    {
+        if(k.mv_size != PACK_EXTENT_KEY || v.mv_size != PACK_EXTENT_VAL)
+            continue;
+        uint32_t p = pack_extent_pack(k.mv_data);
+        if(p >= n)
+            break; /* sorted by segment */
+        uint64_t len;
+        memcpy(&len, v.mv_data, 8);
+        live[p] += len;
+    }
+    mdb_cursor_close(cur);
+    mdb_txn_abort(txn);
+    return mrc == MDB_NOTFOUND ? MDB_SUCCESS : mrc;
+}
+
+static int pack_move_live(PackStore* ps, uint32_t p)
+{
+    /* snapshot the segment's extents */
+    PackMove* mv = NULL;
+    size_t    n = 0, cap = 0;
+    {
+        MDB_txn*    txn = NULL;
+        MDB_cursor* cur = NULL;
+        if(mdb_txn_begin(DB->env, NULL, MDB_RDONLY, &txn) != MDB_SUCCESS)
+            return -EIO;
+        if(mdb_cursor_open(txn, DB->db_pack_extents, &cur) != MDB_SUCCESS)
+        {
+            mdb_txn_abort(txn);
+            return -EIO;
+        }
+        uint8_t seek[PACK_EXTENT_KEY];
+        pack_extent_key(seek, p, 0);
+        MDB_val k   = {.mv_size = sizeof seek, .mv_data = seek};
+        MDB_val v   = {0};
+        int     mrc = mdb_cursor_get(cur, &k, &v, MDB_SET_RANGE);
+        for(; mrc == MDB_SUCCESS; mrc = mdb_cursor_get(cur, &k, &v, MDB_NEXT))
+        {
+            if(k.mv_size != PACK_EXTENT_KEY || pack_extent_pack(k.mv_data) != p)
+                break;
+            if(v.mv_size != PACK_EXTENT_VAL)
+                continue;
+            if(n == cap)
+            {
+                size_t    ncap = cap ? cap * 2 : 64;
+                PackMove* nmv  = realloc(mv, ncap * sizeof *nmv);
+                if(!nmv)
+                {
+                    mrc = ENOMEM;
+                    break;
+                }
+                mv  = nmv;
+                cap = ncap;
+            }
+            mv[n].off = pack_extent_off(k.mv_data);
+            memcpy(&mv[n].len, v.mv_data, 8);
+            memcpy(mv[n].sha, (const uint8_t*)v.mv_data + 8, 32);
+            ++n;
+        }
+        mdb_cursor_close(cur);
+        mdb_txn_abort(txn);
+        if(mrc != MDB_SUCCESS && mrc != MDB_NOTFOUND)
+        {
+            free(mv);
+            return mrc == ENOMEM ? -ENOMEM : -EIO;
+        }
+    }
+
+    /* copy them to the append segment */
+    int    rc     = 0;
+    size_t copied = 0;
+    for(; copied < n && rc == 0; ++copied)
+    {
+        PackLoc  from = {.pack = p, .off = mv[copied].off,
+                         .len = mv[copied].len};
+        uint8_t* buf  = malloc(from.len ? (size_t)from.len : 1);
+        if(!buf)
+        {
+            rc = -ENOMEM;
+            break;
+        }
+        rc = pack_read(ps, &from, 0, buf, (size_t)from.len);
+        if(rc == 0)
+            rc = pack_append(ps, buf, (size_t)from.len, &mv[copied].to);
+        free(buf);
+        if(rc != 0)
+            break;
+    }
+    if(rc == 0)
+    {
+        int src = DB->flusher ? fs_flusher_sync(DB->flusher) : pack_sync(ps);
+        rc      = src < 0 ? -EIO : 0;
+    }
+
+    /* repoint whatever still lives where we copied it from */
+retry_chunk:
+    if(rc == 0)
+    {
+        MDB_txn* txn = NULL;
+        int      mrc = mdb_txn_begin(DB->env, NULL, 0, &txn);
+        for(size_t i = 0; mrc == MDB_SUCCESS && i < n; ++i)
+        {
+            PackLoc now;
+            int     grc = pack_index_get(txn, mv[i].sha, &now);
+            if(grc == MDB_NOTFOUND ||
+               (grc == MDB_SUCCESS && (now.pack != p || now.off != mv[i].off)))
+                continue; /* deleted or moved meanwhile: the copy is dead */
+            mrc = grc == MDB_SUCCESS ? pack_index_put(txn, mv[i].sha, &mv[i].to)
+                                     : grc;
+        }
+        if(mrc == MDB_SUCCESS)
+            mrc = mdb_txn_commit(txn);
+        else if(txn)
+            mdb_txn_abort(txn);
+        if(mrc == MDB_MAP_FULL && db_env_mapsize_expand() == 0)
+            goto retry_chunk;
+        if(mrc != MDB_SUCCESS)
+            rc = -EIO;
+    }
+    for(size_t i = 0; i < copied; ++i)
+        pack_release(ps, &mv[i].to, 1);
+    free(mv);
+    return rc;
+}
+
+static void pack_unlink_retired(PackStore* ps)
+{
+    uint64_t oldest = pack_oldest_reader(ps);
+    size_t   keep   = 0;
+    for(size_t i = 0; i < ps->nretired; ++i)
+    {
+        uint32_t p = ps->retired[i].pack;
+        /* a reader from before the retirement may hold a location in 'p';
+           an append into 'p' from before it was sealed may be indexed
+           later: both keep the file */
+        pthread_mutex_lock(&ps->mu);
+        int busy = oldest <= ps->retired[i].epoch || pack_pins(ps, p) != 0;
+        pthread_mutex_unlock(&ps->mu);
+        uint64_t live[1] = {0};
+        if(!busy)
+        {
+            MDB_txn*    txn = NULL;
+            MDB_cursor* cur = NULL;
+            busy            = 1;
+            if(mdb_txn_begin(DB->env, NULL, MDB_RDONLY, &txn) == MDB_SUCCESS)
+            {
+                if(mdb_cursor_open(txn, DB->db_pack_extents, &cur) ==
+                   MDB_SUCCESS)
+                {
+                    uint8_t seek[PACK_EXTENT_KEY];
+                    pack_extent_key(seek, p, 0);
+                    MDB_val k   = {.mv_size = sizeof seek, .mv_data = seek};
+                    MDB_val v   = {0};
+                    int     mrc = mdb_cursor_get(cur, &k, &v, MDB_SET_RANGE);
+                    live[0]     = mrc == MDB_SUCCESS &&
+                              k.mv_size == PACK_EXTENT_KEY &&
+                              pack_extent_pack(k.mv_data) == p;
+                    busy = mrc != MDB_SUCCESS && mrc != MDB_NOTFOUND;
+                    mdb_cursor_close(cur);
+                }
+                mdb_txn_abort(txn);
+            }
+        }
+        if(busy)
+        {
+            ps->retired[keep++] = ps->retired[i]; /* try again next pass */
+            continue;
+        }
+        if(live[0])
+            continue; /* back in use: a normal candidate again */
+        char name[PACK_NAME_SIZE];
+        pack_name(name, p);
+        (void)unlinkat(atomic_load(&ps->dirfd), name, 0);
+    }
+    ps->nretired = keep;
+}
+
+static uint64_t pack_pins(const PackStore* ps, uint32_t p)
+{
+    for(size_t i = 0; i < ps->npins; ++i)
+        if(ps->pins[i].pack == p)
+            return ps->pins[i].n;
+    return 0;
+}
+
+static uint64_t pack_oldest_reader(PackStore* ps)
+{
+    pthread_mutex_lock(&ps->rd_mu);
+    uint64_t e = ps->nrd ? ps->rd[0].epoch : UINT64_MAX;
+    pthread_mutex_unlock(&ps->rd_mu);
+    return e;
+}
+
+static int pack_retire(PackStore* ps, uint32_t p)
+{
+    for(size_t i = 0; i < ps->nretired; ++i)
+        if(ps->retired[i].pack == p)
+            return 0;
+    if(ps->nretired == ps->capretired)
+    {
+        size_t       ncap = ps->capretired ? ps->capretired * 2 : 16;
+        PackRetired* nr   = realloc(ps->retired, ncap * sizeof *nr);
+        if(!nr)
+            return -ENOMEM;
+        ps->retired    = nr;
+        ps->capretired = ncap;
+    }
+    /* readers that entered until now may still hold a location inside 'p'
+       from an older snapshot; later ones see the repointed index */
+    pthread_mutex_lock(&ps->rd_mu);
+    uint64_t e = ps->epoch++;
+    pthread_mutex_unlock(&ps->rd_mu);
+    ps->retired[ps->nretired++] = (PackRetired){.pack = p, .epoch = e};
+    return 0;
+}
+
+static void* repacker_main(void* arg)
+{
+    PackStore* ps = (PackStore*)arg;
+    pthread_mutex_lock(&ps->bg_mu);
+    while(!ps->bg_stop)
+    {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        ts.tv_sec += (time_t)ps->bg_interval_s;
+        while(!ps->bg_stop &&
+              pthread_cond_timedwait(&ps->bg_cv, &ps->bg_mu, &ts) != ETIMEDOUT)
+            ;
+        if(ps->bg_stop)
+            break;
+        pthread_mutex_unlock(&ps->bg_mu);
+        (void)db_data_repack(ps->bg_dead_pct, NULL);
+        pthread_mutex_lock(&ps->bg_mu);
+    }
+    pthread_mutex_unlock(&ps->bg_mu);
+    return NULL;
+}
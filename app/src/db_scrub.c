@@ -0,0 +1,630 @@
+/**
+ * @file db_scrub.c
+ * @brief Integrity scrubber: stored contents re-read and re-hashed against
+ *        their records, throttled and resumable.
+ *
+ * @author  Roman Horshkov <roman.horshkov@gmail.com>
+ * @date    2025
+ * (c) 2025
+ */
+
+#define _GNU_SOURCE /* O_NOATIME */
+#include "db_int.h"
+#include "fsutil.h"
+#include "sha256.h"
+#include "workpool.h"
+
+#include <fcntl.h>
+#include <pthread.h>
+
+/****************************************************************************
+ * PRIVATE DEFINES
+ ****************************************************************************
+ */
+
+/* Digests verified between two checkpoints */
+#ifndef SCRUB_BATCH
+#    define SCRUB_BATCH 64u
+#endif
+/* Read size of blob verification (one budgeted I/O) */
+#ifndef SCRUB_BUFSZ
+#    define SCRUB_BUFSZ (1024u * 1024u)
+#endif
+/* Streamed contents up to this size are kept in memory and hashed with the
+   rest of their batch (crypt_digest_many) */
+#ifndef SCRUB_MANY_MAX
+#    define SCRUB_MANY_MAX (64u * 1024u)
+#endif
+/* Digests per db_scrub_run call of the background thread (stop latency) */
+#define SCRUB_BG_STEP 1024u
+
+#define SCRUB_CKPT_KEY "ckpt"
+
+/****************************************************************************
+ * PRIVATE STUCTURED VARIABLES
+ ****************************************************************************
+ */
+
+/* data_scrub value: where the current pass stands */
+typedef struct __attribute__((packed))
+{
+    uint8_t  last[32]; /* digest verified last (valid when 'active') */
+    uint8_t  active;   /* 0: the next run starts at the first digest */
+    uint64_t passes;   /* full passes completed */
+} ScrubCkpt;
+
+/* One digest of a batch */
+typedef struct
+{
+    uint8_t  id[DB_ID_SIZE]; /* a record of the content (read path) */
+    DataMeta meta;
+    int      fault; /* DB_SCRUB_* or 0 */
+    uint64_t bytes; /* bytes read */
+    uint8_t *buf;   /* small content read but not hashed yet, else NULL */
+} ScrubItem;
+
+/* One db_scrub_run call, shared by the verifiers */
+typedef struct
+{
+    ScrubItem *items;
+
+    /* budgets: a read may start once both allow it */
+    pthread_mutex_t pace_mu;
+    uint64_t        op_ns;   /* per read call; 0 = unlimited */
+    uint64_t        mib_ns;  /* per MiB read; 0 = unlimited */
+    uint64_t        next_op; /* earliest start of the next read call */
+    uint64_t        next_bw;
+} ScrubRun;
+
+/* Sink of db_data_stream: hashes, or collects into buf[0..meta.size) */
+typedef struct
+{
+    ScrubRun       *run;
+    CryptDigestCtx *sha;
+    uint8_t        *buf;
+    uint64_t        cap;
+    uint64_t        n;
+} ScrubSink;
+
+/* Background scrubber */
+typedef struct
+{
+    pthread_mutex_t mu;
+    pthread_cond_t  cv;
+    pthread_t       thread;
+    int             running;
+    _Atomic int     stop;
+    DbScrubOptions  opt;
+    unsigned        interval_s;
+    db_scrub_cb     cb;
+    void           *user;
+} ScrubBg;
+
+/****************************************************************************
+ * PRIVATE VARIABLES
+ ****************************************************************************
+ */
+
+/* Runs take turns: they share one checkpoint */
+static pthread_mutex_t SCRUB_RUN_MU = PTHREAD_MUTEX_INITIALIZER;
+
+static ScrubBg SCRUB_BG = {.mu = PTHREAD_MUTEX_INITIALIZER,
+                           .cv = PTHREAD_COND_INITIALIZER};
+
+/****************************************************************************
+ * PRIVATE FUNCTIONS PROTOTYPES
+ ****************************************************************************
+ */
+
+/* db_scrub_run() that also stops when *stop becomes non-zero. */
+static int scrub_run(const DbScrubOptions *opt, db_scrub_cb cb, void *user,
+                     DbScrubReport *out, _Atomic int *stop);
+
+/* Fill up to 'max' items with the digests after the checkpoint. Returns the
+   count (0 at the end of the pass) or -EIO. */
+static long scrub_next_batch(const ScrubCkpt *ck, ScrubItem *items,
+                             size_t max);
+
+/* wp_item_fn: verify items[i]. */
+static void scrub_one(size_t i, void *user);
+
+/* Verify a plain blob file through the shard handles. */
+static int scrub_blob(ScrubRun *run, ScrubItem *it);
+
+/* Verify any other content through db_data_stream; small contents are only
+   read into it->buf for scrub_hash_pending(). */
+static int scrub_stream(ScrubRun *run, ScrubItem *it);
+
+/* Hash the it->buf contents of items[0..n) in one go, set their faults and
+   free the buffers. */
+static void scrub_hash_pending(ScrubItem *items, size_t n);
+
+static int scrub_sink(const void *buf, size_t len, void *user);
+
+/* 1 when 'meta' still describes how its content is stored; a fault seen
+   while a delete retired the content is not one. Checked under the write
+   lock, which deletes hold while they retire. */
+static int scrub_still_stored(const DataMeta *meta);
+
+static int scrub_ckpt_load(ScrubCkpt *ck);
+static int scrub_ckpt_store(const ScrubCkpt *ck);
+
+/* Block until the budgets allow a read of 'bytes'. */
+static void scrub_pace(ScrubRun *run, size_t bytes);
+
+static uint64_t scrub_now_ns(void);
+static void    *scrubber_main(void *arg);
+
+/* db_scrub_cb of the background thread: a non-zero return of the user's
+   callback ends the scrubber. */
+static int scrubber_cb(const DataMeta *meta, int fault, void *user);
+
+/****************************************************************************
+ * PUBLIC FUNCTIONS DEFINITIONS
+ ****************************************************************************
+ */
+
+int db_scrub_run(const DbScrubOptions *opt, db_scrub_cb cb, void *user,
+                 DbScrubReport *out_report)
+{
+    return scrub_run(opt, cb, user, out_report, NULL);
+}
+
+int db_scrub_start(const DbScrubOptions *opt, unsigned interval_s,
+                   db_scrub_cb cb, void *user)
+{
+    if(!DB || !DB->env)
+        return -EINVAL;
+    ScrubBg *bg = &SCRUB_BG;
+    pthread_mutex_lock(&bg->mu);
+    if(bg->running)
+    {
+        pthread_mutex_unlock(&bg->mu);
+        return -EBUSY;
+    }
+    memset(&bg->opt, 0, sizeof bg->opt);
+    if(opt)
+        bg->opt = *opt;
+    bg->interval_s = interval_s;
+    bg->cb         = cb;
+    bg->user       = user;
+    atomic_store(&bg->stop, 0);
+    int rc = pthread_create(&bg->thread, NULL, scrubber_main, bg);
+    if(rc == 0)
+        bg->running = 1;
+    pthread_mutex_unlock(&bg->mu);
+    return -rc;
+}
+
+void db_scrub_stop(void)
+{
+    ScrubBg *bg = &SCRUB_BG;
+    pthread_mutex_lock(&bg->mu);
+    if(!bg->running)
+    {
+        pthread_mutex_unlock(&bg->mu);
+        return;
+    }
+    atomic_store(&bg->stop, 1);
+    pthread_cond_broadcast(&bg->cv);
+    pthread_mutex_unlock(&bg->mu);
+
+    pthread_join(bg->thread, NULL);
+    pthread_mutex_lock(&bg->mu);
+    bg->running = 0;
+    pthread_mutex_unlock(&bg->mu);
+}
+
+/****************************************************************************
+ * PRIVATE FUNCTIONS DEFINITIONS
+ ****************************************************************************
+ */
+
+static int scrub_run(const DbScrubOptions *opt, db_scrub_cb cb, void *user,
+                     DbScrubReport *out, _Atomic int *stop)
+{
+    if(out)
+        memset(out, 0, sizeof *out);
+    if(!DB || !DB->env)
+        return -EINVAL;
+
+    DbScrubOptions o = {0};
+    if(opt)
+        o = *opt;
+
+    ScrubRun run;
+    memset(&run, 0, sizeof run);
+    run.op_ns  = o.iops ? 1000000000ull / o.iops : 0;
+    run.mib_ns = o.mb_per_sec ? 1000000000ull / o.mb_per_sec : 0;
+    run.items  = calloc(SCRUB_BATCH, sizeof *run.items);
+    if(!run.items)
+        return -ENOMEM;
+    pthread_mutex_init(&run.pace_mu, NULL);
+
+    pthread_mutex_lock(&SCRUB_RUN_MU);
+    ScrubCkpt ck;
+    int       rc   = scrub_ckpt_load(&ck);
+    int       halt = 0;
+    uint64_t  done = 0, bytes = 0, faults = 0;
+    while(rc == 0 && !halt && (!stop || !atomic_load(stop)))
+    {
+        size_t want = SCRUB_BATCH;
+        if(o.max_objects && o.max_objects - done < want)
+            want = (size_t)(o.max_objects - done);
+        if(want == 0)
+            break;
+        long n = scrub_next_batch(&ck, run.items, want);
+        if(n < 0)
+        {
+            rc = (int)n;
+            break;
+        }
+        if(n == 0)
+        {
+            /* end of the pass: the next run starts over */
+            ck.active = 0;
+            ck.passes++;
+            rc = scrub_ckpt_store(&ck);
+            if(out)
+                out->wrapped = 1;
+            break;
+        }
+
+        wp_parallel_for((size_t)n, o.threads ? o.threads : 1, scrub_one, &run);
+        scrub_hash_pending(run.items, (size_t)n);
+
+        for(long i = 0; i < n; ++i)
+        {
+            ScrubItem *it = &run.items[i];
+            bytes += it->bytes;
+            if(it->fault && !halt && scrub_still_stored(&it->meta))
+            {
+                faults++;
+                if(cb && cb(&it->meta, it->fault, user) != 0)
+                    halt = 1; /* the batch is verified: still checkpoint it */
+            }
+        }
+        done += (uint64_t)n;
+        memcpy(ck.last, run.items[n - 1].meta.sha, 32);
+        ck.active = 1;
+        rc        = scrub_ckpt_store(&ck);
+    }
+    pthread_mutex_unlock(&SCRUB_RUN_MU);
+
+    pthread_mutex_destroy(&run.pace_mu);
+    free(run.items);
+    if(out)
+    {
+        out->objects = done;
+        out->bytes   = bytes;
+        out->faults  = faults;
+        out->passes  = ck.passes;
+    }
+    return rc;
+}
+
+static long scrub_next_batch(const ScrubCkpt *ck, ScrubItem *items,
+                             size_t max)
+{
+    MDB_txn    *txn = NULL;
+    MDB_cursor *cur = NULL;
+    if(mdb_txn_begin(DB->env, NULL, MDB_RDONLY, &txn) != MDB_SUCCESS)
+        return -EIO;
+    if(mdb_cursor_open(txn, DB->db_data_sha2ids, &cur) != MDB_SUCCESS)
+    {
+        mdb_txn_abort(txn);
+        return -EIO;
+    }
+
+    MDB_val k = {0}, v = {0};
+    int     mrc;
+    if(!ck->active)
+        mrc = mdb_cursor_get(cur, &k, &v, MDB_FIRST);
+    else
+    {
+        k.mv_size = 32;
+        k.mv_data = (void *)ck->last;
+        mrc       = mdb_cursor_get(cur, &k, &v, MDB_SET_RANGE);
+        if(mrc == MDB_SUCCESS && memcmp(k.mv_data, ck->last, 32) == 0)
+            mrc = mdb_cursor_get(cur, &k, &v, MDB_NEXT_NODUP);
+    }
+
+    long n = 0;
+    while(mrc == MDB_SUCCESS && (size_t)n < max)
+    {
+        ScrubItem *it = &items[n];
+        memset(it, 0, sizeof *it);
+        if(k.mv_size != 32 || v.mv_size != DB_ID_SIZE)
+        {
+            mrc = MDB_CORRUPTED;
+            break;
+        }
+        memcpy(it->id, v.mv_data, DB_ID_SIZE);
+        MDB_val mk = {.mv_size = DB_ID_SIZE, .mv_data = it->id};
+        MDB_val mv = {0};
+        mrc        = mdb_get(txn, DB->db_data_id2meta, &mk, &mv);
+        if(mrc != MDB_SUCCESS || db_data_meta_decode(txn, &mv, &it->meta) != 0)
+        {
+            mrc = mrc == MDB_SUCCESS ? MDB_CORRUPTED : mrc;
+            break;
+        }
+        ++n;
+        mrc = mdb_cursor_get(cur, &k, &v, MDB_NEXT_NODUP);
+    }
+    mdb_cursor_close(cur);
+    mdb_txn_abort(txn);
+    return mrc == MDB_SUCCESS || mrc == MDB_NOTFOUND ? n : -EIO;
+}
+
+static void scrub_one(size_t i, void *user)
+{
+    ScrubRun  *run = user;
+    ScrubItem *it  = &run->items[i];
+    it->fault      = it->meta.flags & DATA_META_F_MASK ? scrub_stream(run, it)
+                                                     : scrub_blob(run, it);
+}
+
+static int scrub_blob(ScrubRun *run, ScrubItem *it)
+{
+    char   hex[65];
+    Sha256 d;
+    memcpy(d.b, it->meta.sha, 32);
+    crypt_sha256_hex(&d, hex);
+
+    scrub_pace(run, 0); /* the open is an I/O of its own */
+    int fd = fs_objdir_open_object(DB->objdir, hex, O_RDONLY | O_NOATIME);
+    if(fd < 0 && errno == EPERM) /* O_NOATIME needs ownership */
+        fd = fs_objdir_open_object(DB->objdir, hex, O_RDONLY);
+    if(fd < 0)
+        return errno == ENOENT ? DB_SCRUB_MISSING : DB_SCRUB_IOERR;
+    struct stat st;
+    if(fstat(fd, &st) != 0)
+    {
+        close(fd);
+        return DB_SCRUB_IOERR;
+    }
+    if((uint64_t)st.st_size != it->meta.size)
+    {
+        close(fd);
+        return DB_SCRUB_SIZE;
+    }
+
+    /* read once, then drop what this pass brought in; a blob that was
+       already cached is being served: leave its pages alone */
+    int cold = fs_cached_pages(fd, it->meta.size) == 0;
+    (void)posix_fadvise(fd, 0, 0, POSIX_FADV_NOREUSE);
+    (void)posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    uint8_t        *buf   = malloc(SCRUB_BUFSZ);
+    CryptDigestCtx *sha   = crypt_digest_begin();
+    int             fault = buf && sha ? 0 : DB_SCRUB_IOERR;
+    uint64_t        off   = 0;
+    while(fault == 0 && off < it->meta.size)
+    {
+        size_t want = it->meta.size - off < SCRUB_BUFSZ
+                          ? (size_t)(it->meta.size - off)
+                          : SCRUB_BUFSZ;
+        scrub_pace(run, want);
+        ssize_t rd = pread(fd, buf, want, (off_t)off);
+        if(rd < 0 && errno == EINTR)
+            continue;
+        if(rd <= 0)
+        {
+            fault = rd == 0 ? DB_SCRUB_SIZE : DB_SCRUB_IOERR;
+            break;
+        }
+        if(crypt_digest_update(sha, buf, (size_t)rd) != 0)
+            fault = DB_SCRUB_IOERR;
+        if(cold)
+            (void)posix_fadvise(fd, (off_t)off, (off_t)rd, POSIX_FADV_DONTNEED);
+        off += (uint64_t)rd;
+    }
+    it->bytes = off;
+    free(buf);
+    close(fd);
+
+    if(sha && crypt_digest_end(sha, &d) != 0 && fault == 0)
+        fault = DB_SCRUB_IOERR;
+    if(fault == 0 && memcmp(d.b, it->meta.sha, 32) != 0)
+        fault = DB_SCRUB_HASH;
+    return fault;
+}
+
+static int scrub_stream(ScrubRun *run, ScrubItem *it)
+{
+    ScrubSink s = {.run = run, .n = 0};
+    if(it->meta.size && it->meta.size <= SCRUB_MANY_MAX)
+    {
+        s.buf = malloc((size_t)it->meta.size);
+        s.cap = it->meta.size;
+    }
+    if(!s.buf)
+        s.sha = crypt_digest_begin();
+    if(!s.buf && !s.sha)
+        return DB_SCRUB_IOERR;
+    int rc = it->meta.size ? db_data_stream(it->id, 0, 0, scrub_sink, &s) : 0;
+    it->bytes = s.n;
+
+    Sha256 d;
+    if(s.sha && crypt_digest_end(s.sha, &d) != 0 && rc == 0)
+        rc = -EIO;
+    if(rc == 0 && s.n == it->meta.size && s.buf)
+    {
+        it->buf = s.buf; /* hashed with its batch */
+        return 0;
+    }
+    free(s.buf);
+    if(rc == -ENOENT)
+        return DB_SCRUB_MISSING;
+    if(rc != 0)
+        return DB_SCRUB_IOERR;
+    if(s.n != it->meta.size)
+        return DB_SCRUB_SIZE;
+    return memcmp(d.b, it->meta.sha, 32) != 0 ? DB_SCRUB_HASH : 0;
+}
+
+static void scrub_hash_pending(ScrubItem *items, size_t n)
+{
+    const void *p[SCRUB_BATCH];
+    size_t      len[SCRUB_BATCH], at[SCRUB_BATCH], k = 0;
+    Sha256      d[SCRUB_BATCH];
+    for(size_t i = 0; i < n; ++i)
+        if(items[i].buf)
+        {
+            p[k]    = items[i].buf;
+            len[k]  = (size_t)items[i].meta.size;
+            at[k++] = i;
+        }
+    int rc = k ? crypt_digest_many(k, p, len, d) : 0;
+    for(size_t j = 0; j < k; ++j)
+    {
+        ScrubItem *it = &items[at[j]];
+        if(rc != 0)
+            it->fault = DB_SCRUB_IOERR;
+        else if(memcmp(d[j].b, it->meta.sha, 32) != 0)
+            it->fault = DB_SCRUB_HASH;
+        free(it->buf);
+        it->buf = NULL;
+    }
+}
+
+static int scrub_sink(const void *buf, size_t len, void *user)
+{
+    ScrubSink *s = user;
+    scrub_pace(s->run, len);
+    if(s->buf)
+    {
+        /* more than recorded: only the count matters (a size fault) */
+        if(s->n < s->cap)
+            memcpy(s->buf + s->n, buf,
+                   len < s->cap - s->n ? len : (size_t)(s->cap - s->n));
+        s->n += len;
+        return 0;
+    }
+    s->n += len;
+    return crypt_digest_update(s->sha, buf, len) == 0 ? 0 : -EIO;
+}
+
+static int scrub_still_stored(const DataMeta *meta)
+{
+    MDB_txn *txn = NULL;
+    if(mdb_txn_begin(DB->env, NULL, 0, &txn) != MDB_SUCCESS)
+        return 1; /* cannot tell: report */
+    DataMeta any;
+    MDB_val  k   = {.mv_size = 32, .mv_data = (void *)meta->sha};
+    int      mrc = db_data_sha_any_meta(txn, &k, &any);
+    mdb_txn_abort(txn);
+    if(mrc == MDB_NOTFOUND)
+        return 0;
+    return mrc != MDB_SUCCESS ||
+           (any.flags & DATA_META_F_MASK) == (meta->flags & DATA_META_F_MASK);
+}
+
+static int scrub_ckpt_load(ScrubCkpt *ck)
+{
+    memset(ck, 0, sizeof *ck);
+    MDB_txn *txn = NULL;
+    if(mdb_txn_begin(DB->env, NULL, MDB_RDONLY, &txn) != MDB_SUCCESS)
+        return -EIO;
+    MDB_val k   = {.mv_size = sizeof SCRUB_CKPT_KEY - 1,
+                   .mv_data = (void *)SCRUB_CKPT_KEY};
+    MDB_val v   = {0};
+    int     mrc = mdb_get(txn, DB->db_data_scrub, &k, &v);
+    if(mrc == MDB_SUCCESS && v.mv_size == sizeof *ck)
+        memcpy(ck, v.mv_data, sizeof *ck);
+    mdb_txn_abort(txn);
+    return mrc == MDB_SUCCESS || mrc == MDB_NOTFOUND ? 0 : -EIO;
+}
+
+static int scrub_ckpt_store(const ScrubCkpt *ck)
+{
+retry_chunk:
+    MDB_txn *txn = NULL;
+    int      mrc = mdb_txn_begin(DB->env, NULL, 0, &txn);
+    if(mrc != MDB_SUCCESS)
+        return db_map_mdb_err(mrc);
+    MDB_val k = {.mv_size = sizeof SCRUB_CKPT_KEY - 1,
+                 .mv_data = (void *)SCRUB_CKPT_KEY};
+    MDB_val v = {.mv_size = sizeof *ck, .mv_data = (void *)ck};
+    mrc       = mdb_put(txn, DB->db_data_scrub, &k, &v, 0);
+    if(mrc == MDB_SUCCESS)
+        mrc = mdb_txn_commit(txn);
+    else
+        mdb_txn_abort(txn);
+    if(mrc == MDB_MAP_FULL)
+    {
+        int grc = db_env_mapsize_expand();
+        if(grc != 0)
+            return db_map_mdb_err(grc);
+        goto retry_chunk;
+    }
+    return mrc == MDB_SUCCESS ? 0 : db_map_mdb_err(mrc);
+}
+
+static void scrub_pace(ScrubRun *run, size_t bytes)
+{
+    if(run->op_ns == 0 && run->mib_ns == 0)
+        return;
+    pthread_mutex_lock(&run->pace_mu);
+    uint64_t now = scrub_now_ns();
+    uint64_t at  = now;
+    if(run->next_op > at)
+        at = run->next_op;
+    if(run->next_bw > at)
+        at = run->next_bw;
+    run->next_op = at + run->op_ns;
+    run->next_bw = at + (uint64_t)((double)run->mib_ns *
+                                   ((double)bytes / (1024.0 * 1024.0)));
+    pthread_mutex_unlock(&run->pace_mu);
+
+    if(at > now)
+    {
+        struct timespec ts = {.tv_sec  = (time_t)((at - now) / 1000000000ull),
+                              .tv_nsec = (long)((at - now) % 1000000000ull)};
+        while(nanosleep(&ts, &ts) != 0 && errno == EINTR)
+        {
+        }
+    }
+}
+
+static uint64_t scrub_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static void *scrubber_main(void *arg)
+{
+    ScrubBg       *bg  = arg;
+    DbScrubOptions opt = bg->opt;
+    opt.max_objects    = SCRUB_BG_STEP;
+    while(!atomic_load(&bg->stop))
+    {
+        DbScrubReport r;
+        int rc = scrub_run(&opt, bg->cb ? scrubber_cb : NULL, bg, &r,
+                           &bg->stop);
+        if(rc == 0 && !r.wrapped)
+            continue;
+
+        /* pass done (or failed): rest before the next one */
+        struct timespec until;
+        clock_gettime(CLOCK_REALTIME, &until);
+        until.tv_sec += bg->interval_s ? (time_t)bg->interval_s : 1;
+        pthread_mutex_lock(&bg->mu);
+        while(!atomic_load(&bg->stop) &&
+              pthread_cond_timedwait(&bg->cv, &bg->mu, &until) != ETIMEDOUT)
+        {
+        }
+        pthread_mutex_unlock(&bg->mu);
+    }
+    return NULL;
+}
+
+static int scrubber_cb(const DataMeta *meta, int fault, void *user)
+{
+    ScrubBg *bg = user;
+    if(bg->cb(meta, fault, bg->user) == 0)
+        return 0;
+    atomic_store(&bg->stop, 1);
+    return 1;
+}
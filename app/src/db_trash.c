@@ -0,0 +1,193 @@
+/**
+ * @file db_trash.c
+ * @brief
+ *
+ * @author  Roman Horshkov <roman.horshkov@gmail.com>
+ * @date    2025
+ * (c) 2025
+ */
+
+#include "db_trash.h"
+
+#include <pthread.h>
+
+/****************************************************************************
+ * PRIVATE DEFINES
+ ****************************************************************************
+ */
+
+#define TRASH_STAMP 8 /* deleted_at(8) ahead of the raw meta record */
+
+/****************************************************************************
+ * PRIVATE STUCTURED VARIABLES
+ ****************************************************************************
+ */
+
+/* Background reaper */
+typedef struct
+{
+    pthread_mutex_t mu;
+    pthread_cond_t  cv;
+    pthread_t       thread;
+    int             running;
+    int             stop;
+    int             kicked;
+    unsigned        interval_s;
+} TrashReaper;
+
+/****************************************************************************
+ * PRIVATE VARIABLES
+ ****************************************************************************
+ */
+
+static TrashReaper REAPER = {.mu = PTHREAD_MUTEX_INITIALIZER,
+                             .cv = PTHREAD_COND_INITIALIZER};
+
+/****************************************************************************
+ * PRIVATE FUNCTIONS PROTOTYPES
+ ****************************************************************************
+ */
+
+static void* reaper_main(void* arg);
+
+/****************************************************************************
+ * PUBLIC FUNCTIONS DEFINITIONS
+ ****************************************************************************
+ */
+
+int trash_put(MDB_txn* txn, const uint8_t id[DB_ID_SIZE], const DataMeta* m,
+              const MDB_val* raw, uint64_t deleted_at)
+{
+    MDB_val k   = {.mv_size = DB_ID_SIZE, .mv_data = (void*)id};
+    MDB_val v   = {.mv_size = TRASH_STAMP + raw->mv_size, .mv_data = NULL};
+    int     mrc = mdb_put(txn, DB->db_data_trash, &k, &v, MDB_RESERVE);
+    if(mrc != MDB_SUCCESS)
+        return mrc;
+    memcpy(v.mv_data, &deleted_at, TRASH_STAMP);
+    memcpy((uint8_t*)v.mv_data + TRASH_STAMP, raw->mv_data, raw->mv_size);
+
+    MDB_val sk = {.mv_size = 32, .mv_data = (void*)m->sha};
+    return mdb_put(txn, DB->db_data_trash_sha, &sk, &k, MDB_NODUPDATA);
+}
+
+int trash_get(MDB_txn* txn, const uint8_t id[DB_ID_SIZE], MDB_val* raw,
+              uint64_t* deleted_at)
+{
+    MDB_val k   = {.mv_size = DB_ID_SIZE, .mv_data = (void*)id};
+    MDB_val v   = {0};
+    int     mrc = mdb_get(txn, DB->db_data_trash, &k, &v);
+    if(mrc != MDB_SUCCESS)
+        return mrc;
+    if(v.mv_size <= TRASH_STAMP)
+        return MDB_CORRUPTED;
+    if(deleted_at)
+        memcpy(deleted_at, v.mv_data, TRASH_STAMP);
+    raw->mv_size = v.mv_size - TRASH_STAMP;
+    raw->mv_data = (uint8_t*)v.mv_data + TRASH_STAMP;
+    return MDB_SUCCESS;
+}
+
+int trash_del(MDB_txn* txn, const uint8_t id[DB_ID_SIZE],
+              const uint8_t sha[32])
+{
+    MDB_val k   = {.mv_size = DB_ID_SIZE, .mv_data = (void*)id};
+    MDB_val sk  = {.mv_size = 32, .mv_data = (void*)sha};
+    int     mrc = mdb_del(txn, DB->db_data_trash_sha, &sk, &k);
+    if(mrc != MDB_SUCCESS && mrc != MDB_NOTFOUND)
+        return mrc;
+    return mdb_del(txn, DB->db_data_trash, &k, NULL);
+}
+
+int trash_any_meta(MDB_txn* txn, const uint8_t sha[32], DataMeta* out)
+{
+    MDB_val sk  = {.mv_size = 32, .mv_data = (void*)sha};
+    MDB_val iv  = {0};
+    int     mrc = mdb_get(txn, DB->db_data_trash_sha, &sk, &iv);
+    if(mrc != MDB_SUCCESS)
+        return mrc;
+    if(iv.mv_size != DB_ID_SIZE)
+        return MDB_CORRUPTED;
+    MDB_val raw = {0};
+    mrc         = trash_get(txn, iv.mv_data, &raw, NULL);
+    if(mrc != MDB_SUCCESS)
+        return mrc == MDB_NOTFOUND ? MDB_CORRUPTED : mrc;
+    return db_data_meta_decode(NULL, &raw, out) == 0 ? MDB_SUCCESS
+                                                     : MDB_CORRUPTED;
+}
+
+int trash_reaper_start(unsigned interval_s)
+{
+    pthread_mutex_lock(&REAPER.mu);
+    if(REAPER.running)
+    {
+        pthread_mutex_unlock(&REAPER.mu);
+        return 0;
+    }
+    REAPER.interval_s = interval_s ? interval_s : 1;
+    REAPER.stop       = 0;
+    REAPER.kicked     = 0;
+    int rc            = pthread_create(&REAPER.thread, NULL, reaper_main, NULL);
+    if(rc == 0)
+        REAPER.running = 1;
+    pthread_mutex_unlock(&REAPER.mu);
+    return -rc;
+}
+
+void trash_reaper_stop(void)
+{
+    pthread_mutex_lock(&REAPER.mu);
+    if(!REAPER.running)
+    {
+        pthread_mutex_unlock(&REAPER.mu);
+        return;
+    }
+    REAPER.stop = 1;
+    pthread_cond_broadcast(&REAPER.cv);
+    pthread_mutex_unlock(&REAPER.mu);
+
+    pthread_join(REAPER.thread, NULL);
+    pthread_mutex_lock(&REAPER.mu);
+    REAPER.running = 0;
+    pthread_mutex_unlock(&REAPER.mu);
+}
+
+void trash_reaper_kick(void)
+{
+    pthread_mutex_lock(&REAPER.mu);
+    if(REAPER.running)
+    {
+        REAPER.kicked = 1;
+        pthread_cond_signal(&REAPER.cv);
+    }
+    pthread_mutex_unlock(&REAPER.mu);
+}
+
+/****************************************************************************
+ * PRIVATE FUNCTIONS DEFINITIONS
+ ****************************************************************************
+ */
+
+static void* reaper_main(void* arg)
+{
+    (void)arg;
+    pthread_mutex_lock(&REAPER.mu);
+    while(!REAPER.stop)
+    {
+        struct timespec until;
+        clock_gettime(CLOCK_REALTIME, &until);
+        until.tv_sec += (time_t)REAPER.interval_s;
+        while(!REAPER.stop && !REAPER.kicked &&
+              pthread_cond_timedwait(&REAPER.cv, &REAPER.mu, &until) !=
+                  ETIMEDOUT)
+        {
+        }
+        if(REAPER.stop)
+            break;
+        REAPER.kicked = 0;
+        pthread_mutex_unlock(&REAPER.mu);
+        (void)db_data_reap(0, NULL);
+        pthread_mutex_lock(&REAPER.mu);
+    }
+    pthread_mutex_unlock(&REAPER.mu);
+    return NULL;
+}
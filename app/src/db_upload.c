@@ -0,0 +1,670 @@
+/**
+ * @file db_upload.c
+ * @brief Resumable upload sessions.
+ *
+ * @author  Roman Horshkov <roman.horshkov@gmail.com>
+ * @date    2025
+ * (c) 2025
+ */
+
+#include "db_upload.h"
+#include "uuid.h"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+/****************************************************************************
+ * PRIVATE DEFINES
+ ****************************************************************************
+ */
+
+#define UPLOAD_REC_V0 0
+
+/* Suffix of a session file set aside while db_upload_commit() links it */
+#define UPLOAD_ASIDE ".commit"
+
+/* Session locks, picked by session id: appends to one session serialize,
+   different sessions rarely contend */
+#ifndef UPLOAD_LOCKS
+#    define UPLOAD_LOCKS 64
+#endif
+
+/****************************************************************************
+ * PRIVATE STUCTURED VARIABLES
+ ****************************************************************************
+ */
+
+/* data_uploads value */
+typedef struct __attribute__((packed))
+{
+    uint8_t  ver;                          /* UPLOAD_REC_V0 */
+    uint8_t  owner[DB_ID_SIZE];            /* uploader id */
+    uint64_t created_at;                   /* epoch seconds */
+    uint64_t touched_at;                   /* last append, epoch seconds */
+    uint64_t offset;                       /* bytes durable in the file */
+    uint8_t  sha[CRYPT_SHA256_STATE_SIZE]; /* SHA-256 state of [0, offset) */
+    char     mime[32];                     /* MIME type, NUL-terminated */
+} UploadRec;
+
+/* Background reaper */
+typedef struct
+{
+    pthread_mutex_t mu;
+    pthread_cond_t  cv;
+    pthread_t       thread;
+    int             running;
+    int             stop;
+    unsigned        interval_s;
+} UploadReaper;
+
+/****************************************************************************
+ * PRIVATE VARIABLES
+ ****************************************************************************
+ */
+
+static pthread_mutex_t LOCKS[UPLOAD_LOCKS] = {
+    [0 ... UPLOAD_LOCKS - 1] = PTHREAD_MUTEX_INITIALIZER};
+
+static UploadReaper REAPER = {.mu = PTHREAD_MUTEX_INITIALIZER,
+                              .cv = PTHREAD_COND_INITIALIZER};
+
+/****************************************************************************
+ * PRIVATE FUNCTIONS PROTOTYPES
+ ****************************************************************************
+ */
+
+static pthread_mutex_t* upload_lock(const uint8_t session[DB_ID_SIZE]);
+
+/* "<root>/objects/uploads/<hex32>" (or the directory with session NULL).
+   0 or -ENAMETOOLONG. */
+static int upload_path(char* out, size_t out_sz,
+                       const uint8_t session[DB_ID_SIZE]);
+
+/* Session record owned by 'owner' (any owner with owner NULL). 0, -ENOENT,
+   -EPERM or -EIO. */
+static int upload_get(const uint8_t session[DB_ID_SIZE],
+                      const uint8_t owner[DB_ID_SIZE], UploadRec* out);
+
+/* Write (rec != NULL) or drop the record in its own txn, grown and retried
+   on MDB_MAP_FULL. 0, -ENOENT (drop) or -errno. */
+static int upload_put(const uint8_t session[DB_ID_SIZE], const UploadRec* rec);
+
+/* Remove the file, then the record. 0, -ENOENT or -errno. */
+static int upload_drop(const uint8_t session[DB_ID_SIZE]);
+
+/* Session id of a file name "<hex32>[.commit]"; 1 set aside, 0 plain, -1
+   not a session file. */
+static int upload_name_parse(const char* name, uint8_t out[DB_ID_SIZE]);
+
+static void* reaper_main(void* arg);
+
+/****************************************************************************
+ * PUBLIC FUNCTIONS DEFINITIONS
+ ****************************************************************************
+ */
+
+int db_upload_begin(const uint8_t owner[DB_ID_SIZE], const char* mime,
+                    uint8_t out_session[DB_ID_SIZE])
+{
+    if(!DB || !owner || !mime || !out_session)
+        return -EINVAL;
+    UploadRec rec = {.ver = UPLOAD_REC_V0};
+    if(strlen(mime) >= sizeof rec.mime)
+        return -EINVAL;
+    int prc = db_data_check_publisher(owner);
+    if(prc != 0)
+        return prc;
+
+    uint8_t sid[DB_ID_SIZE];
+    if(uuid_v7(sid) != 0)
+        return -EIO;
+    memcpy(rec.owner, owner, DB_ID_SIZE);
+    memcpy(rec.mime, mime, strlen(mime));
+    rec.created_at = rec.touched_at = (uint64_t)time(NULL);
+    CryptSha256State st;
+    crypt_sha256_state_init(&st);
+    crypt_sha256_state_save(&st, rec.sha);
+
+    /* the file and its name are durable before the session exists */
+    char path[PATH_MAX], dir[PATH_MAX];
+    if(upload_path(path, sizeof path, sid) != 0 ||
+       upload_path(dir, sizeof dir, NULL) != 0)
+        return -ENAMETOOLONG;
+    int fd = open(path, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0660);
+    if(fd < 0)
+        return -EIO;
+    close(fd);
+    int dfd = open(dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if(dfd < 0 || fsync(dfd) != 0)
+    {
+        if(dfd >= 0)
+            close(dfd);
+        unlink(path);
+        return -EIO;
+    }
+    close(dfd);
+
+    int rc = upload_put(sid, &rec);
+    if(rc != 0)
+    {
+        unlink(path);
+        return rc;
+    }
+    memcpy(out_session, sid, DB_ID_SIZE);
+    return 0;
+}
+
+int db_upload_append(const uint8_t owner[DB_ID_SIZE],
+                     const uint8_t session[DB_ID_SIZE], uint64_t off,
+                     const void* buf, size_t len, uint64_t* out_offset)
+{
+    if(!DB || !owner || !session || (!buf && len))
+        return -EINVAL;
+
+    pthread_mutex_t* mu = upload_lock(session);
+    pthread_mutex_lock(mu);
+    UploadRec rec;
+    int       rc = upload_get(session, owner, &rec);
+    if(rc != 0)
+        goto out;
+    if(off > rec.offset)
+    {
+        rc = -ERANGE;
+        goto out;
+    }
+
+    /* a resent prefix is skipped; bytes past the recorded offset (left by
+       an append that failed before its record) are overwritten */
+    uint64_t skip = rec.offset - off;
+    if(skip < len)
+    {
+        const uint8_t* p = (const uint8_t*)buf + skip;
+        size_t         n = len - (size_t)skip;
+        char           path[PATH_MAX];
+        if(upload_path(path, sizeof path, session) != 0)
+        {
+            rc = -ENAMETOOLONG;
+            goto out;
+        }
+        int fd = open(path, O_WRONLY | O_CLOEXEC);
+        if(fd < 0)
+        {
+            rc = -EIO;
+            goto out;
+        }
+        /* a second link is an object name: never write through it */
+        struct stat fst;
+        rc = fstat(fd, &fst) != 0 ? -EIO : fst.st_nlink > 1 ? -EBUSY : 0;
+        if(rc != 0)
+        {
+            close(fd);
+            goto out;
+        }
+        size_t done = 0;
+        while(done < n)
+        {
+            ssize_t wr = pwrite(fd, p + done, n - done,
+                                (off_t)(rec.offset + done));
+            if(wr < 0 && errno == EINTR)
+                continue;
+            if(wr <= 0)
+                break;
+            done += (size_t)wr;
+        }
+        int synced = done == n && (DB->flusher ? fs_flusher_sync(DB->flusher)
+                                               : fdatasync(fd)) == 0;
+        close(fd);
+        if(!synced)
+        {
+            rc = -EIO;
+            goto out;
+        }
+
+        /* BLAKE3 has no resumable midstate here: hashed at commit */
+        if(DB->digest_alg == CRYPT_HASH_SHA256)
+        {
+            CryptSha256State st;
+            crypt_sha256_state_load(&st, rec.sha);
+            crypt_sha256_state_update(&st, p, n);
+            crypt_sha256_state_save(&st, rec.sha);
+        }
+        rec.offset += n;
+        rec.touched_at = (uint64_t)time(NULL);
+        rc             = upload_put(session, &rec);
+        if(rc != 0)
+            goto out;
+    }
+    if(out_offset)
+        *out_offset = rec.offset;
+
+out:
+    pthread_mutex_unlock(mu);
+    return rc;
+}
+
+int db_upload_status(const uint8_t owner[DB_ID_SIZE],
+                     const uint8_t session[DB_ID_SIZE], uint64_t* out_offset)
+{
+    if(!DB || !owner || !session || !out_offset)
+        return -EINVAL;
+    UploadRec rec;
+    int       rc = upload_get(session, owner, &rec);
+    if(rc == 0)
+        *out_offset = rec.offset;
+    return rc;
+}
+
+int db_upload_commit(const uint8_t owner[DB_ID_SIZE],
+                     const uint8_t session[DB_ID_SIZE],
+                     uint8_t out_data_id[DB_ID_SIZE])
+{
+    if(!DB || !owner || !session)
+        return -EINVAL;
+
+    pthread_mutex_t* mu = upload_lock(session);
+    pthread_mutex_lock(mu);
+    UploadRec rec;
+    int       rc = upload_get(session, owner, &rec);
+    if(rc != 0)
+        goto out;
+    if(rec.offset > (uint64_t)SIZE_MAX)
+    {
+        rc = -EFBIG;
+        goto out;
+    }
+
+    char path[PATH_MAX];
+    if(upload_path(path, sizeof path, session) != 0)
+    {
+        rc = -ENAMETOOLONG;
+        goto out;
+    }
+    int fd = open(path, O_RDWR | O_CLOEXEC);
+    if(fd < 0)
+    {
+        rc = -EIO;
+        goto out;
+    }
+    /* only the recorded bytes are the upload */
+    if(ftruncate(fd, (off_t)rec.offset) != 0)
+    {
+        close(fd);
+        rc = -EIO;
+        goto out;
+    }
+    Sha256 digest;
+    if(DB->digest_alg == CRYPT_HASH_SHA256)
+    {
+        CryptSha256State st;
+        crypt_sha256_state_load(&st, rec.sha);
+        crypt_sha256_state_final(&st, &digest);
+    }
+    else if(crypt_digest_fd_range(fd, 0, (size_t)rec.offset, &digest) != 0)
+    {
+        close(fd);
+        rc = -EIO;
+        goto out;
+    }
+    /* set aside while linked: the session name never reaches an object,
+       and the record goes in the indexing txn */
+    char aside[PATH_MAX];
+    if(snprintf(aside, sizeof aside, "%s" UPLOAD_ASIDE, path) >=
+           (int)sizeof aside ||
+       rename(path, aside) != 0)
+    {
+        close(fd);
+        rc = -EIO;
+        goto out;
+    }
+    uint8_t data_id[DB_ID_SIZE];
+    rc = db_data_add_staged((uint8_t*)owner, fd, &digest, (size_t)rec.offset,
+                            rec.mime, session, data_id);
+    close(fd);
+    if(rc != 0)
+    {
+        (void)rename(aside, path); /* the session stays open */
+        goto out;
+    }
+    (void)unlink(aside); /* a crash here leaves it to upload_sweep() */
+    if(out_data_id)
+        memcpy(out_data_id, data_id, DB_ID_SIZE);
+
+out:
+    pthread_mutex_unlock(mu);
+    return rc;
+}
+
+int db_upload_abort(const uint8_t owner[DB_ID_SIZE],
+                    const uint8_t session[DB_ID_SIZE])
+{
+    if(!DB || !owner || !session)
+        return -EINVAL;
+    pthread_mutex_t* mu = upload_lock(session);
+    pthread_mutex_lock(mu);
+    UploadRec rec;
+    int       rc = upload_get(session, owner, &rec);
+    if(rc == 0)
+        rc = upload_drop(session);
+    pthread_mutex_unlock(mu);
+    return rc;
+}
+
+int db_upload_reap(size_t max, size_t* out_reaped)
+{
+    if(out_reaped)
+        *out_reaped = 0;
+    if(!DB)
+        return -EINVAL;
+
+    /* expired ids from one snapshot; each is re-checked under its lock */
+    uint64_t    now = (uint64_t)time(NULL);
+    uint8_t*    ids = NULL;
+    size_t      n   = 0;
+    size_t      cap = 0;
+    MDB_txn*    txn = NULL;
+    MDB_cursor* c   = NULL;
+    int         mrc = mdb_txn_begin(DB->env, NULL, MDB_RDONLY, &txn);
+    if(mrc != MDB_SUCCESS)
+        return db_map_mdb_err(mrc);
+    mrc = mdb_cursor_open(txn, DB->db_data_uploads, &c);
+    MDB_val k = {0}, v = {0};
+    if(mrc == MDB_SUCCESS)
+        mrc = mdb_cursor_get(c, &k, &v, MDB_FIRST);
+    while(mrc == MDB_SUCCESS && (!max || n < max))
+    {
+        UploadRec rec;
+        if(k.mv_size == DB_ID_SIZE && v.mv_size == sizeof rec)
+        {
+            memcpy(&rec, v.mv_data, sizeof rec);
+            if(rec.touched_at + DB->upload_ttl <= now)
+            {
+                if(n == cap)
+                {
+                    size_t   ncap  = cap ? cap * 2 : 64;
+                    uint8_t* grown = realloc(ids, ncap * DB_ID_SIZE);
+                    if(!grown)
+                    {
+                        mrc = ENOMEM;
+                        break;
+                    }
+                    ids = grown;
+                    cap = ncap;
+                }
+                memcpy(ids + n++ * DB_ID_SIZE, k.mv_data, DB_ID_SIZE);
+            }
+        }
+        mrc = mdb_cursor_get(c, &k, &v, MDB_NEXT);
+    }
+    if(c)
+        mdb_cursor_close(c);
+    mdb_txn_abort(txn);
+    if(mrc == ENOMEM)
+    {
+        free(ids);
+        return -ENOMEM;
+    }
+    if(mrc != MDB_SUCCESS && mrc != MDB_NOTFOUND)
+    {
+        free(ids);
+        return db_map_mdb_err(mrc);
+    }
+
+    int    rc     = 0;
+    size_t reaped = 0;
+    for(size_t i = 0; i < n && rc == 0; ++i)
+    {
+        const uint8_t*   sid = ids + i * DB_ID_SIZE;
+        pthread_mutex_t* mu  = upload_lock(sid);
+        pthread_mutex_lock(mu);
+        UploadRec rec;
+        int       grc = upload_get(sid, NULL, &rec);
+        if(grc == 0 && rec.touched_at + DB->upload_ttl <= now)
+        {
+            grc = upload_drop(sid);
+            if(grc == 0)
+                ++reaped;
+        }
+        if(grc != 0 && grc != -ENOENT)
+            rc = grc;
+        pthread_mutex_unlock(mu);
+    }
+    free(ids);
+    if(out_reaped)
+        *out_reaped = reaped;
+    return rc;
+}
+
+int upload_sweep(void)
+{
+    if(!DB)
+        return -EINVAL;
+    char dir[PATH_MAX];
+    if(upload_path(dir, sizeof dir, NULL) != 0)
+        return -ENAMETOOLONG;
+    DIR* d = opendir(dir);
+    if(!d)
+        return errno == ENOENT ? 0 : -EIO;
+
+    int            rc = 0;
+    struct dirent* de;
+    while((de = readdir(d)) != NULL)
+    {
+        uint8_t sid[DB_ID_SIZE];
+        int     aside = upload_name_parse(de->d_name, sid);
+        if(aside < 0)
+            continue;
+        UploadRec rec;
+        int       grc = upload_get(sid, NULL, &rec);
+        if(grc != 0 && grc != -ENOENT)
+        {
+            rc = grc;
+            break;
+        }
+        if(grc == -ENOENT)
+            (void)unlinkat(dirfd(d), de->d_name, 0); /* never began/ended */
+        else if(aside)
+        {
+            /* the commit did not index: the session is open again */
+            char hex[33];
+            memcpy(hex, de->d_name, 32);
+            hex[32] = '\0';
+            if(renameat(dirfd(d), de->d_name, dirfd(d), hex) != 0)
+                rc = -EIO;
+        }
+    }
+    closedir(d);
+    return rc;
+}
+
+int upload_reaper_start(unsigned interval_s)
+{
+    pthread_mutex_lock(&REAPER.mu);
+    if(REAPER.running)
+    {
+        pthread_mutex_unlock(&REAPER.mu);
+        return 0;
+    }
+    REAPER.interval_s = interval_s ? interval_s : 1;
+    REAPER.stop       = 0;
+    int rc            = pthread_create(&REAPER.thread, NULL, reaper_main, NULL);
+    if(rc == 0)
+        REAPER.running = 1;
+    pthread_mutex_unlock(&REAPER.mu);
+    return -rc;
+}
+
+void upload_reaper_stop(void)
+{
+    pthread_mutex_lock(&REAPER.mu);
+    if(!REAPER.running)
+    {
+        pthread_mutex_unlock(&REAPER.mu);
+        return;
+    }
+    REAPER.stop = 1;
+    pthread_cond_broadcast(&REAPER.cv);
+    pthread_mutex_unlock(&REAPER.mu);
+
+    pthread_join(REAPER.thread, NULL);
+    pthread_mutex_lock(&REAPER.mu);
+    REAPER.running = 0;
+    pthread_mutex_unlock(&REAPER.mu);
+}
+
+/****************************************************************************
+ * PRIVATE FUNCTIONS DEFINITIONS
+ ****************************************************************************
+ */
+
+static pthread_mutex_t* upload_lock(const uint8_t session[DB_ID_SIZE])
+{
+    /* v7 ids: the tail bytes are random */
+    return &LOCKS[session[DB_ID_SIZE - 1] % UPLOAD_LOCKS];
+}
+
+static int upload_path(char* out, size_t out_sz,
+                       const uint8_t session[DB_ID_SIZE])
+{
+    int n;
+    if(!session)
+        n = snprintf(out, out_sz, "%s/objects/uploads", DB->root);
+    else
+    {
+        uint8_t id[DB_ID_SIZE];
+        char    hex[33];
+        memcpy(id, session, DB_ID_SIZE);
+        uuid_to_hex(id, hex);
+        n = snprintf(out, out_sz, "%s/objects/uploads/%s", DB->root, hex);
+    }
+    return n < 0 || (size_t)n >= out_sz ? -ENAMETOOLONG : 0;
+}
+
+static int upload_get(const uint8_t session[DB_ID_SIZE],
+                      const uint8_t owner[DB_ID_SIZE], UploadRec* out)
+{
+    MDB_txn* txn = NULL;
+    int      mrc = mdb_txn_begin(DB->env, NULL, MDB_RDONLY, &txn);
+    if(mrc != MDB_SUCCESS)
+        return db_map_mdb_err(mrc);
+    MDB_val k = {.mv_size = DB_ID_SIZE, .mv_data = (void*)session};
+    MDB_val v = {0};
+    mrc       = mdb_get(txn, DB->db_data_uploads, &k, &v);
+    if(mrc == MDB_SUCCESS && (v.mv_size != sizeof *out ||
+                              *(const uint8_t*)v.mv_data != UPLOAD_REC_V0))
+        mrc = MDB_CORRUPTED;
+    if(mrc == MDB_SUCCESS)
+        memcpy(out, v.mv_data, sizeof *out);
+    mdb_txn_abort(txn);
+    if(mrc == MDB_NOTFOUND)
+        return -ENOENT;
+    if(mrc != MDB_SUCCESS)
+        return -EIO;
+    if(owner && memcmp(out->owner, owner, DB_ID_SIZE) != 0)
+        return -EPERM;
+    return 0;
+}
+
+static int upload_put(const uint8_t session[DB_ID_SIZE], const UploadRec* rec)
+{
+retry_chunk:
+    MDB_txn* txn = NULL;
+    int      mrc = mdb_txn_begin(DB->env, NULL, 0, &txn);
+    if(mrc != MDB_SUCCESS)
+        return db_map_mdb_err(mrc);
+
+    MDB_val k = {.mv_size = DB_ID_SIZE, .mv_data = (void*)session};
+    if(rec)
+    {
+        MDB_val v = {.mv_size = sizeof *rec, .mv_data = (void*)rec};
+        mrc       = mdb_put(txn, DB->db_data_uploads, &k, &v, 0);
+    }
+    else
+        mrc = mdb_del(txn, DB->db_data_uploads, &k, NULL);
+    if(mrc == MDB_MAP_FULL)
+    {
+        mdb_txn_abort(txn);
+        int grc = db_env_mapsize_expand(); /* grow */
+        if(grc != 0)
+            return db_map_mdb_err(grc); /* stop if grow failed */
+        goto retry_chunk;
+    }
+    if(mrc != MDB_SUCCESS)
+    {
+        mdb_txn_abort(txn);
+        return db_map_mdb_err(mrc);
+    }
+
+    mrc = mdb_txn_commit(txn);
+    if(mrc == MDB_MAP_FULL)
+    {
+        int grc = db_env_mapsize_expand();
+        if(grc != 0)
+            return db_map_mdb_err(grc);
+        goto retry_chunk;
+    }
+    return db_map_mdb_err(mrc); /* txn is already aborted/freed */
+}
+
+static int upload_drop(const uint8_t session[DB_ID_SIZE])
+{
+    /* file first: a record left without it fails appends and expires,
+       a file left without its record would never be found */
+    char path[PATH_MAX];
+    if(upload_path(path, sizeof path, session) == 0)
+        (void)unlink(path);
+    return upload_put(session, NULL);
+}
+
+static int upload_name_parse(const char* name, uint8_t out[DB_ID_SIZE])
+{
+    size_t len = strlen(name);
+    int    aside;
+    if(len == 32)
+        aside = 0;
+    else if(len == 32 + sizeof UPLOAD_ASIDE - 1 &&
+            strcmp(name + 32, UPLOAD_ASIDE) == 0)
+        aside = 1;
+    else
+        return -1;
+    for(int i = 0; i < 32; ++i)
+    {
+        char c = name[i];
+        int  v = c >= '0' && c <= '9'   ? c - '0'
+                 : c >= 'a' && c <= 'f' ? c - 'a' + 10
+                                        : -1;
+        if(v < 0)
+            return -1;
+        if(i % 2 == 0)
+            out[i / 2] = (uint8_t)(v << 4);
+        else
+            out[i / 2] |= (uint8_t)v;
+    }
+    return aside;
+}
+
+static void* reaper_main(void* arg)
+{
+    (void)arg;
+    pthread_mutex_lock(&REAPER.mu);
+    while(!REAPER.stop)
+    {
+        struct timespec until;
+        clock_gettime(CLOCK_REALTIME, &until);
+        until.tv_sec += (time_t)REAPER.interval_s;
+        while(!REAPER.stop &&
+              pthread_cond_timedwait(&REAPER.cv, &REAPER.mu, &until) !=
+                  ETIMEDOUT)
+        {
+        }
+        if(REAPER.stop)
+            break;
+        pthread_mutex_unlock(&REAPER.mu);
+        (void)db_upload_reap(0, NULL);
+        pthread_mutex_lock(&REAPER.mu);
+    }
+    pthread_mutex_unlock(&REAPER.mu);
+    return NULL;
+}
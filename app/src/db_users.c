@@ -636,7 +636,7 @@ retry_txn:
             mdb_txn_abort(txn);
             return -ENOENT;
         }
-        if(rc != MDB_SUCCESS || v.mv_size != sizeof(DataMeta))
+        if(rc != MDB_SUCCESS || db_data_meta_decode(NULL, &v, NULL) != 0)
         {
             mdb_txn_abort(txn);
             return -EIO;
@@ -671,6 +671,14 @@ retry_txn:
     /* Grant VIEW to recipient (writes forward+reverse; idempotent). */
     {
         int rc = acl_grant_view(txn, target, data_id);
+        if(rc == MDB_MAP_FULL)
+        {
+            mdb_txn_abort(txn);
+            int grc = db_env_mapsize_expand();
+            if(grc != 0)
+                return db_map_mdb_err(grc);
+            goto retry_txn;
+        }
         if(rc != 0)
         {
             mdb_txn_abort(txn);
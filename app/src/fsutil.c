@@ -7,6 +7,7 @@
  * (c) 2025
  */
 
+#define _GNU_SOURCE /* O_TMPFILE, AT_EMPTY_PATH */
 #include "fsutil.h"
 
 #include <errno.h>
@@ -19,24 +20,91 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <dirent.h>
+#include <time.h>
+#include <stdatomic.h>
+#include <sys/resource.h>
+#include <pthread.h>
+#include <poll.h>
+#include <limits.h>
+#include <sys/sendfile.h>
+#include <sys/mman.h>
+#if defined(__linux__)
+#    include <sys/random.h>
+#endif
 
 /****************************************************************************
  * PRIVATE DEFINES
  ****************************************************************************
  */
-/* None */
+
+/* Leaf handles kept at most (direct-mapped by shard index) */
+#define FS_LEAF_SLOTS 65536u
+
+/* Layout (and re-layout flag) packed for lock-free readers */
+#define FS_SHAPE(l, on)    ((l).levels | (l).width << 4 | (unsigned)(on) << 8)
+#define FS_SHAPE_RELAYOUT  0x100u
+#define FS_SHAPE_LAYOUT(s) ((FsLayout){(s) & 0xFu, ((s) >> 4) & 0xFu})
+
+/* Failed sync groups kept until all of their waiters have seen the error */
+#ifndef FS_FLUSH_BAD
+#    define FS_FLUSH_BAD 8
+#endif
 
 /****************************************************************************
  * PRIVATE STUCTURED VARIABLES
  ****************************************************************************
  */
-/* None */
+
+struct FsObjDir
+{
+    int              base_fd;    /* <root>/objects/<ns> */
+    char             base[4096]; /* its path */
+    size_t           base_len;
+    pthread_rwlock_t lock;       /* write: layout switch; read: object calls */
+    FsLayout         cur;        /* publish here */
+    FsLayout         from;       /* previous layout while 'relayout' */
+    int              relayout;
+    _Atomic unsigned shape;      /* FS_SHAPE(cur, relayout) */
+    _Atomic uint64_t* leaf;      /* (idx + 1) << 32 | dirfd, 0 = empty */
+    size_t           slots;      /* power of two */
+    _Atomic long     cached;     /* leaf handles currently held */
+    long             budget;     /* max leaf handles to keep open */
+    _Atomic int      no_tmpfile; /* O_TMPFILE rejected by this fs */
+};
+
+/* Tickets (lo, hi] of one failed syncfs(); 'left' waiters still to report. */
+typedef struct
+{
+    uint64_t lo;
+    uint64_t hi;
+    uint64_t left;
+    int      err;
+} FsBadRange;
+
+/* Group commit: tickets are handed out under 'mu'; the flusher thread syncs
+   everything up to the newest ticket it saw before calling syncfs(). */
+struct FsFlusher
+{
+    int             fd;        /* any fd on the target filesystem */
+    unsigned        window_us; /* extra wait to grow a group (0 = none) */
+    pthread_t       thread;
+    pthread_mutex_t mu;
+    pthread_cond_t  cv_req;  /* new ticket / shutdown */
+    pthread_cond_t  cv_done; /* a group finished */
+    uint64_t        issued;  /* last ticket handed out */
+    uint64_t        synced;  /* every ticket <= synced is durable */
+    FsBadRange      bad[FS_FLUSH_BAD]; /* failed groups not yet collected */
+    unsigned        nbad;
+    int             stop;
+    _Atomic uint64_t nsyncs; /* syncfs() calls issued */
+};
 
 /****************************************************************************
  * PRIVATE VARIABLES
  ****************************************************************************
  */
-/* None */
+
+static const char FS_HEX[] = "0123456789abcdef";
 
 /****************************************************************************
  * PRIVATE FUNCTIONS PROTOTYPES
@@ -47,6 +115,66 @@ static int mkdir_one(const char* path, mode_t mode);
 
 static int fsync_parent_dir(const char* path);
 
+static int hex_nibble(char c);
+
+/* Object call run in a leaf dirfd; 0/fd or -1/errno */
+typedef int (*obj_op_fn)(FsObjDir* od, int dfd, const char* hex64, void* arg);
+
+/* Leaf of a digest in layout 'l': its first levels * width hex digits.
+   -1 on bad hex. */
+static long layout_index(FsLayout l, const char* hex64);
+
+/* "ab/cd" path of leaf 'idx' below the base; returns its length */
+static size_t layout_leaf(FsLayout l, size_t idx, char* out);
+
+/* 1 when the directories of depth 'depth' of 'l' are also used by 'to' */
+static int layout_shares_dir(FsLayout l, unsigned depth, FsLayout to);
+
+static int is_hex64(const char* name);
+
+/* Returns a dirfd for leaf 'idx' of 'l' (from the cache when 'cache');
+   *owned set when the caller must close it. */
+static int leaf_fd(FsObjDir* od, FsLayout l, size_t idx, int cache,
+                   int create, int* owned);
+
+static void leaf_put(int fd, int owned);
+
+/* Empty leaf cache sized for 'shards' leaves; held handles are closed */
+static int leaf_cache_reset(FsObjDir* od, size_t shards);
+
+static void leaf_cache_close(FsObjDir* od);
+
+static int op_open(FsObjDir* od, int dfd, const char* hex64, void* arg);
+static int op_stat(FsObjDir* od, int dfd, const char* hex64, void* arg);
+static int op_unlink(FsObjDir* od, int dfd, const char* hex64, void* arg);
+static int op_retire(FsObjDir* od, int dfd, const char* hex64, void* arg);
+/* Link the object into its leaf of layout *arg (the mover's first step);
+   already there counts as done. */
+static int op_relink(FsObjDir* od, int dfd, const char* hex64, void* arg);
+
+/* 'fn' on the leaf of 'hex64' in layout 'l'; errno kept */
+static int layout_try(FsObjDir* od, FsLayout l, int cache, const char* hex64,
+                      obj_op_fn fn, void* arg);
+
+/* 'fn' in the current layout, during a re-layout also in the old one */
+static int objdir_lookup(FsObjDir* od, const char* hex64, obj_op_fn fn,
+                         void* arg);
+
+static int tmp_name_random(char name[48]);
+
+static void* flusher_main(void* arg);
+
+/* 1 when 'name' is an ingest temp, a retired object or a legacy
+   '<hex64>.tmp.*' copy, else 0. */
+static int is_temp_name(const char* name);
+
+/* Count (and unless 'dry_run' unlink) the temp 'name' of 'dfd' when its
+   ctime is not after 'before'. */
+static void sweep_temp(int dfd, const char* name, time_t before, int dry_run,
+                       FsTempSweep* tmp);
+
+static int digest_cmp(const void* a, const void* b);
+
 /****************************************************************************
  * PUBLIC FUNCTIONS DEFINITIONS
  ****************************************************************************
@@ -175,11 +303,1195 @@ int ensure_symlink(const char* link_path, const char* target)
     return 0;
 }
 
+int fs_layout_valid(FsLayout l)
+{
+    return l.levels >= 1 && l.levels <= 3 && l.width >= 1 && l.width <= 3 &&
+           l.levels * l.width <= FS_LAYOUT_MAX_DIGITS;
+}
+
+size_t fs_layout_shards(FsLayout l)
+{
+    return (size_t)1 << (4u * l.levels * l.width);
+}
+
+void fs_layout_name(FsLayout l, char out[8])
+{
+    snprintf(out, 8, "%ux%u", l.levels % 10u, l.width % 10u);
+}
+
+int fs_layout_parse(const char* s, FsLayout* out)
+{
+    if(!s || !out || strlen(s) != 3 || s[1] != 'x' || s[0] < '0' ||
+       s[0] > '9' || s[2] < '0' || s[2] > '9')
+    {
+        errno = EINVAL;
+        return -1;
+    }
+    FsLayout l = {(unsigned)(s[0] - '0'), (unsigned)(s[2] - '0')};
+    if(!fs_layout_valid(l))
+    {
+        errno = EINVAL;
+        return -1;
+    }
+    *out = l;
+    return 0;
+}
+
+FsObjDir* fs_objdir_open(const char* root, const char* ns, FsLayout layout,
+                         int precreate)
+{
+    if(!root || !ns || !*ns || strchr(ns, '/') || !fs_layout_valid(layout))
+    {
+        errno = EINVAL;
+        return NULL;
+    }
+    FsObjDir* od = calloc(1, sizeof *od);
+    if(!od)
+        return NULL;
+    int n = snprintf(od->base, sizeof od->base, "%s/objects/%s", root, ns);
+    if(n < 0 || (size_t)n >= sizeof od->base)
+    {
+        free(od);
+        errno = ENAMETOOLONG;
+        return NULL;
+    }
+    od->base_len = (size_t)n;
+    if(mkdir_p(od->base, 0770) != 0 && errno != EEXIST)
+    {
+        free(od);
+        return NULL;
+    }
+
+    /* writers first: a re-layout is not starved by a steady read load */
+    pthread_rwlockattr_t ra;
+    pthread_rwlockattr_init(&ra);
+    pthread_rwlockattr_setkind_np(&ra,
+                                  PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP);
+    int lrc = pthread_rwlock_init(&od->lock, &ra);
+    pthread_rwlockattr_destroy(&ra);
+    if(lrc != 0)
+    {
+        free(od);
+        errno = lrc;
+        return NULL;
+    }
+    od->cur = layout;
+    atomic_init(&od->shape, FS_SHAPE(layout, 0));
+    od->base_fd = -1;
+
+    /* keep at most half of the fd limit for leaf handles */
+    struct rlimit rl;
+    long          soft = 1024;
+    if(getrlimit(RLIMIT_NOFILE, &rl) == 0)
+        soft = rl.rlim_cur == RLIM_INFINITY ? 2L * FS_LEAF_SLOTS
+                                            : (long)rl.rlim_cur;
+    od->budget = soft / 2;
+    if(od->budget > (long)FS_LEAF_SLOTS)
+        od->budget = FS_LEAF_SLOTS;
+
+    if(leaf_cache_reset(od, fs_layout_shards(layout)) != 0)
+    {
+        fs_objdir_close(od);
+        return NULL;
+    }
+    od->base_fd = open(od->base, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if(od->base_fd < 0)
+    {
+        fs_objdir_close(od);
+        return NULL;
+    }
+
+    /* every level of every leaf, parents before children */
+    if(precreate && fs_layout_shards(layout) <= FS_LEAF_SLOTS)
+    {
+        for(unsigned d = 1; d <= layout.levels; ++d)
+        {
+            FsLayout up = {d, layout.width};
+            size_t   nd = fs_layout_shards(up);
+            for(size_t i = 0; i < nd; ++i)
+            {
+                char rel[16];
+                layout_leaf(up, i, rel);
+                if(mkdirat(od->base_fd, rel, 0770) != 0 && errno != EEXIST)
+                {
+                    fs_objdir_close(od);
+                    return NULL;
+                }
+            }
+        }
+    }
+    return od;
+}
+
+void fs_objdir_close(FsObjDir* od)
+{
+    if(!od)
+        return;
+    leaf_cache_close(od);
+    free(od->leaf);
+    if(od->base_fd >= 0)
+        close(od->base_fd);
+    pthread_rwlock_destroy(&od->lock);
+    free(od);
+}
+
+size_t fs_objdir_shards(FsObjDir* od)
+{
+    if(!od)
+        return 0;
+    unsigned s = atomic_load_explicit(&od->shape, memory_order_acquire);
+    return fs_layout_shards(FS_SHAPE_LAYOUT(s));
+}
+
+int fs_objdir_object_path(FsObjDir* od, const char* hex64, char* out,
+                          size_t out_sz)
+{
+    if(!od || !out)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+    unsigned s = atomic_load_explicit(&od->shape, memory_order_acquire);
+    FsLayout l = FS_SHAPE_LAYOUT(s);
+    if(s & FS_SHAPE_RELAYOUT)
+    {
+        /* an old name is unlinked by the mover once the lock drops: move
+           the object ahead of it and hand out the new name, which the
+           re-layout never removes. Only when that link fails is the old
+           name returned (valid until its shard is moved). */
+        struct stat st;
+        pthread_rwlock_rdlock(&od->lock);
+        l = od->cur;
+        if(od->relayout &&
+           layout_try(od, od->cur, 1, hex64, op_stat, &st) < 0 &&
+           errno == ENOENT &&
+           layout_try(od, od->from, 0, hex64, op_relink, &od->cur) != 0 &&
+           errno != ENOENT)
+            l = od->from;
+        pthread_rwlock_unlock(&od->lock);
+    }
+    long idx = layout_index(l, hex64);
+    if(idx < 0)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+    if(od->base_len + 1 + l.levels * (l.width + 1) + 64 + 1 > out_sz)
+    {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    char* p = out;
+    memcpy(p, od->base, od->base_len);
+    p += od->base_len;
+    *p++ = '/';
+    p += layout_leaf(l, (size_t)idx, p);
+    *p++ = '/';
+    memcpy(p, hex64, 64);
+    p[64] = '\0';
+    return 0;
+}
+
+int fs_objdir_tmp_open(FsObjDir* od, FsTmp* tmp)
+{
+    if(!od || !tmp)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+    tmp->fd      = -1;
+    tmp->name[0] = '\0';
+
+#if defined(O_TMPFILE)
+    if(!atomic_load_explicit(&od->no_tmpfile, memory_order_relaxed))
+    {
+        int fd = openat(od->base_fd, ".", O_TMPFILE | O_RDWR | O_CLOEXEC, 0660);
+        if(fd >= 0)
+        {
+            tmp->fd = fd;
+            return 0;
+        }
+        if(errno != EOPNOTSUPP && errno != EISDIR && errno != EINVAL)
+            return -1;
+        atomic_store(&od->no_tmpfile, 1); /* remember; go named */
+    }
+#endif
+
+    for(int tries = 0; tries < 128; ++tries)
+    {
+        if(tmp_name_random(tmp->name) != 0)
+            return -1;
+        int fd = openat(od->base_fd, tmp->name,
+                        O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0660);
+        if(fd >= 0)
+        {
+            tmp->fd = fd;
+            return 0;
+        }
+        if(errno != EEXIST)
+            return -1;
+    }
+    errno = EEXIST;
+    return -1;
+}
+
+void fs_objdir_tmp_discard(FsObjDir* od, FsTmp* tmp)
+{
+    if(!od || !tmp)
+        return;
+    int saved = errno;
+    if(tmp->fd >= 0)
+        close(tmp->fd);
+    if(tmp->name[0])
+        (void)unlinkat(od->base_fd, tmp->name, 0);
+    tmp->fd      = -1;
+    tmp->name[0] = '\0';
+    errno        = saved;
+}
+
+int fs_objdir_publish(FsObjDir* od, FsTmp* tmp, const char* hex64)
+{
+    if(!od || !tmp || tmp->fd < 0)
+    {
+        fs_objdir_tmp_discard(od, tmp);
+        errno = EINVAL;
+        return -1;
+    }
+
+    /* always into the current layout: a re-layout walker never misses it */
+    pthread_rwlock_rdlock(&od->lock);
+    long idx   = layout_index(od->cur, hex64);
+    int  owned = 0;
+    int  sfd   = idx < 0 ? -1
+                         : leaf_fd(od, od->cur, (size_t)idx, 1, 1, &owned);
+    int  rc    = -1;
+    if(idx < 0)
+        errno = EINVAL;
+    else if(sfd >= 0 && tmp->name[0] == '\0')
+    {
+        rc = linkat(tmp->fd, "", sfd, hex64, AT_EMPTY_PATH);
+        if(rc != 0 && (errno == ENOENT || errno == EPERM))
+        {
+            /* AT_EMPTY_PATH needs CAP_DAC_READ_SEARCH; /proc does not */
+            char proc[64];
+            snprintf(proc, sizeof proc, "/proc/self/fd/%d", tmp->fd);
+            rc = linkat(AT_FDCWD, proc, sfd, hex64, AT_SYMLINK_FOLLOW);
+        }
+    }
+    else if(sfd >= 0)
+    {
+        rc = linkat(od->base_fd, tmp->name, sfd, hex64, 0);
+    }
+    if(rc != 0 && errno == EEXIST)
+        rc = 0; /* dedup: object already published */
+
+    leaf_put(sfd, owned);
+    pthread_rwlock_unlock(&od->lock);
+    fs_objdir_tmp_discard(od, tmp);
+    return rc == 0 ? 0 : -1;
+}
+
+int fs_objdir_open_object(FsObjDir* od, const char* hex64, int flags)
+{
+    if(!od)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+    return objdir_lookup(od, hex64, op_open, &flags);
+}
+
+int fs_objdir_stat_object(FsObjDir* od, const char* hex64, struct stat* st)
+{
+    if(!od || !st)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+    return objdir_lookup(od, hex64, op_stat, st);
+}
+
+int fs_objdir_unlink_object(FsObjDir* od, const char* hex64)
+{
+    if(!od)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+    return objdir_lookup(od, hex64, op_unlink, NULL);
+}
+
+int fs_objdir_retire_object(FsObjDir* od, const char* hex64, FsTmp* out)
+{
+    if(!od || !out)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+    out->fd = -1;
+    /* same filesystem: a rename, never a copy; random names do not collide */
+    int rc = tmp_name_random(out->name);
+    if(rc == 0)
+        rc = objdir_lookup(od, hex64, op_retire, out->name);
+    if(rc != 0)
+        out->name[0] = '\0';
+    return rc;
+}
+
+int fs_objdir_restore_object(FsObjDir* od, FsTmp* tmp, const char* hex64)
+{
+    if(!od || !tmp || !tmp->name[0])
+    {
+        errno = EINVAL;
+        return -1;
+    }
+    pthread_rwlock_rdlock(&od->lock);
+    long idx   = layout_index(od->cur, hex64);
+    int  owned = 0;
+    int  sfd   = idx < 0 ? -1
+                         : leaf_fd(od, od->cur, (size_t)idx, 1, 1, &owned);
+    int  rc    = -1;
+    if(idx < 0)
+        errno = EINVAL;
+    else if(sfd >= 0)
+        rc = renameat(od->base_fd, tmp->name, sfd, hex64);
+    int e = errno;
+    leaf_put(sfd, owned);
+    pthread_rwlock_unlock(&od->lock);
+    if(rc == 0)
+        tmp->name[0] = '\0';
+    errno = e;
+    return rc;
+}
+
+int fs_objdir_scan_shard(FsObjDir* od, unsigned idx, time_t before,
+                         int dry_run, uint8_t** out, size_t* n,
+                         FsTempSweep* tmp)
+{
+    if(!od || !out || !n || !tmp)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+    *out = NULL;
+    *n   = 0;
+    pthread_rwlock_rdlock(&od->lock);
+    if(idx >= fs_layout_shards(od->cur))
+    {
+        pthread_rwlock_unlock(&od->lock);
+        errno = EINVAL;
+        return -1;
+    }
+    int owned = 0;
+    int sfd   = leaf_fd(od, od->cur, idx, 1, 0, &owned);
+    /* fdopendir() owns its fd: walk a fresh one, the cached handle stays */
+    int dfd = sfd < 0 ? -1
+                      : openat(sfd, ".", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    int oe  = errno;
+    leaf_put(sfd, owned);
+    pthread_rwlock_unlock(&od->lock);
+    if(sfd < 0 && oe == ENOENT)
+        return 0;
+    if(dfd < 0)
+    {
+        errno = oe;
+        return -1;
+    }
+    DIR* d = fdopendir(dfd);
+    if(!d)
+    {
+        close(dfd);
+        return -1;
+    }
+
+    uint8_t*       v   = NULL;
+    size_t         cnt = 0, cap = 0;
+    int            rc  = 0;
+    struct dirent* de;
+    while((de = readdir(d)) != NULL)
+    {
+        const char* name = de->d_name;
+        if(is_temp_name(name))
+        {
+            sweep_temp(dirfd(d), name, before, dry_run, tmp);
+            continue;
+        }
+        if(strlen(name) != 64)
+            continue;
+        uint8_t sha[32];
+        int     ok = 1;
+        for(int i = 0; ok && i < 32; ++i)
+        {
+            int hi = hex_nibble(name[2 * i]);
+            int lo = hex_nibble(name[2 * i + 1]);
+            ok     = hi >= 0 && lo >= 0;
+            sha[i] = (uint8_t)((hi << 4) | lo);
+        }
+        if(!ok)
+            continue; /* not ours */
+        if(cnt == cap)
+        {
+            size_t   ncap = cap ? cap * 2 : 64;
+            uint8_t* nv   = realloc(v, ncap * 32);
+            if(!nv)
+            {
+                rc = -1;
+                break;
+            }
+            v   = nv;
+            cap = ncap;
+        }
+        memcpy(v + cnt * 32, sha, 32);
+        ++cnt;
+    }
+    int e = errno;
+    closedir(d);
+    if(rc != 0)
+    {
+        free(v);
+        errno = e;
+        return -1;
+    }
+    if(cnt > 1)
+        qsort(v, cnt, 32, digest_cmp);
+    *out = v;
+    *n   = cnt;
+    return 0;
+}
+
+int fs_objdir_sweep_temps(FsObjDir* od, time_t before, int dry_run,
+                          FsTempSweep* tmp)
+{
+    if(!od || !tmp)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+    int dfd = openat(od->base_fd, ".", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if(dfd < 0)
+        return -1;
+    DIR* d = fdopendir(dfd);
+    if(!d)
+    {
+        close(dfd);
+        return -1;
+    }
+    struct dirent* de;
+    while((de = readdir(d)) != NULL)
+        if(is_temp_name(de->d_name))
+            sweep_temp(dirfd(d), de->d_name, before, dry_run, tmp);
+    closedir(d);
+    return 0;
+}
+
+int fs_objdir_relayout_begin(FsObjDir* od, FsLayout to)
+{
+    if(!od || !fs_layout_valid(to))
+    {
+        errno = EINVAL;
+        return -1;
+    }
+    pthread_rwlock_wrlock(&od->lock);
+    int rc = 0;
+    if(od->relayout)
+    {
+        errno = EBUSY;
+        rc    = -1;
+    }
+    else if(to.levels != od->cur.levels || to.width != od->cur.width)
+    {
+        /* no object call runs: the cached leaves can go */
+        rc = leaf_cache_reset(od, fs_layout_shards(to));
+        if(rc == 0)
+        {
+            od->from     = od->cur;
+            od->cur      = to;
+            od->relayout = 1;
+            atomic_store_explicit(&od->shape, FS_SHAPE(to, 1),
+                                  memory_order_release);
+        }
+    }
+    pthread_rwlock_unlock(&od->lock);
+    return rc;
+}
+
+int fs_objdir_layout(FsObjDir* od, FsLayout* cur, FsLayout* from)
+{
+    if(!od)
+        return 0;
+    pthread_rwlock_rdlock(&od->lock);
+    int on = od->relayout;
+    if(cur)
+        *cur = od->cur;
+    if(from && on)
+        *from = od->from;
+    pthread_rwlock_unlock(&od->lock);
+    return on;
+}
+
+int fs_objdir_relink_shard(FsObjDir* od, size_t idx, FsRelink* st)
+{
+    if(!od || !st)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+    pthread_rwlock_rdlock(&od->lock);
+    if(!od->relayout || idx >= fs_layout_shards(od->from))
+    {
+        pthread_rwlock_unlock(&od->lock);
+        errno = EINVAL;
+        return -1;
+    }
+    FsLayout from = od->from, to = od->cur;
+    char     rel[16];
+    layout_leaf(from, idx, rel);
+    int dfd = openat(od->base_fd, rel, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    DIR* d  = dfd < 0 ? NULL : fdopendir(dfd);
+    if(!d)
+    {
+        int e = errno;
+        if(dfd >= 0)
+            close(dfd);
+        pthread_rwlock_unlock(&od->lock);
+        errno = e;
+        return e == ENOENT ? 0 : -1; /* never created: nothing to move */
+    }
+
+    struct dirent* de;
+    while((de = readdir(d)) != NULL)
+    {
+        const char* name = de->d_name;
+        long        nidx = layout_index(to, name);
+        if(nidx < 0 || !is_hex64(name))
+            continue; /* temps and subdirectories stay */
+
+        /* new name first: the object is reachable at every step */
+        int owned = 0;
+        int nfd   = leaf_fd(od, to, (size_t)nidx, 1, 1, &owned);
+        int rc    = nfd < 0 ? -1 : linkat(dirfd(d), name, nfd, name, 0);
+        int e     = errno;
+        leaf_put(nfd, owned);
+        if(rc != 0 && e == ENOENT && nfd >= 0)
+            continue; /* deleted meanwhile */
+        if(rc != 0 && e != EEXIST)
+        {
+            ++st->errors;
+            continue;
+        }
+        if(unlinkat(dirfd(d), name, 0) != 0 && errno != ENOENT)
+        {
+            ++st->errors;
+            continue;
+        }
+        if(rc == 0)
+            ++st->moved;
+        else
+            ++st->merged; /* published in the new layout meanwhile */
+    }
+    closedir(d);
+    if(!layout_shares_dir(from, from.levels, to))
+        (void)unlinkat(od->base_fd, rel, AT_REMOVEDIR);
+    pthread_rwlock_unlock(&od->lock);
+    return 0;
+}
+
+size_t fs_objdir_relink_shards(FsObjDir* od)
+{
+    if(!od)
+        return 0;
+    pthread_rwlock_rdlock(&od->lock);
+    size_t n = od->relayout ? fs_layout_shards(od->from) : 0;
+    pthread_rwlock_unlock(&od->lock);
+    return n;
+}
+
+void fs_objdir_relayout_end(FsObjDir* od)
+{
+    if(!od)
+        return;
+    pthread_rwlock_wrlock(&od->lock);
+    int      was  = od->relayout;
+    FsLayout from = od->from, to = od->cur;
+    od->relayout  = 0;
+    atomic_store_explicit(&od->shape, FS_SHAPE(to, 0), memory_order_release);
+    pthread_rwlock_unlock(&od->lock);
+    if(!was)
+        return;
+
+    /* leaves went with their last object; the levels above, deepest first
+       (nothing falls back to them any more) */
+    for(unsigned dep = from.levels - 1; dep >= 1; --dep)
+    {
+        if(layout_shares_dir(from, dep, to))
+            continue;
+        FsLayout up = {dep, from.width};
+        size_t   nd = fs_layout_shards(up);
+        for(size_t i = 0; i < nd; ++i)
+        {
+            char rel[16];
+            layout_leaf(up, i, rel);
+            (void)unlinkat(od->base_fd, rel, AT_REMOVEDIR);
+        }
+    }
+}
+
+int fs_sendfile_range(int out_fd, int in_fd, off_t off, size_t len,
+                      size_t* sent)
+{
+    size_t done = 0;
+    int    rc   = 0;
+    while(done < len)
+    {
+        ssize_t n = sendfile(out_fd, in_fd, &off, len - done);
+        if(n > 0)
+        {
+            done += (size_t)n;
+            continue;
+        }
+        if(n == 0)
+        {
+            errno = EIO; /* source ended before the range did */
+            rc    = -1;
+            break;
+        }
+        if(errno == EINTR)
+            continue;
+        if(errno == EAGAIN)
+        {
+            struct pollfd pfd = {.fd = out_fd, .events = POLLOUT};
+            if(poll(&pfd, 1, -1) >= 0 || errno == EINTR)
+                continue;
+        }
+        rc = -1;
+        break;
+    }
+    if(sent)
+        *sent = done;
+    return rc;
+}
+
+int fs_memfd_from_buf(const char* name, const void* buf, size_t len)
+{
+    int fd = memfd_create(name, MFD_CLOEXEC);
+    if(fd < 0)
+        return -1;
+    const uint8_t* p   = (const uint8_t*)buf;
+    size_t         off = 0;
+    while(off < len)
+    {
+        ssize_t wr = write(fd, p + off, len - off);
+        if(wr > 0)
+            off += (size_t)wr;
+        else if(wr < 0 && errno == EINTR)
+            continue;
+        else
+        {
+            int e = wr < 0 ? errno : EIO;
+            close(fd);
+            errno = e;
+            return -1;
+        }
+    }
+    if(lseek(fd, 0, SEEK_SET) == (off_t)-1)
+    {
+        int e = errno;
+        close(fd);
+        errno = e;
+        return -1;
+    }
+    return fd;
+}
+
+long fs_cached_pages(int fd, uint64_t size)
+{
+    if(size == 0)
+        return 0;
+    long psz = sysconf(_SC_PAGESIZE);
+    if(psz <= 0 || size > (uint64_t)SIZE_MAX - (uint64_t)psz)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+    size_t         pages = (size_t)((size + (uint64_t)psz - 1) / (uint64_t)psz);
+    unsigned char* vec   = malloc(pages);
+    if(!vec)
+        return -1;
+    void* map = mmap(NULL, (size_t)size, PROT_READ, MAP_SHARED, fd, 0);
+    if(map == MAP_FAILED)
+    {
+        free(vec);
+        return -1;
+    }
+    long n = -1;
+    if(mincore(map, (size_t)size, vec) == 0)
+    {
+        n = 0;
+        for(size_t i = 0; i < pages; ++i)
+            n += vec[i] & 1;
+    }
+    int e = errno;
+    munmap(map, (size_t)size);
+    free(vec);
+    errno = e;
+    return n;
+}
+
+int fs_tmpfile_in(const char* dir)
+{
+#if defined(O_TMPFILE)
+    int fd = open(dir, O_TMPFILE | O_RDWR | O_CLOEXEC, 0600);
+    if(fd >= 0 || (errno != EOPNOTSUPP && errno != EISDIR && errno != EINVAL))
+        return fd;
+#endif
+    char name[PATH_MAX];
+    int  n = snprintf(name, sizeof name, "%s/.tmp.XXXXXX", dir);
+    if(n < 0 || (size_t)n >= sizeof name)
+    {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    int tfd = mkostemp(name, O_CLOEXEC);
+    if(tfd >= 0)
+        (void)unlink(name);
+    return tfd;
+}
+
+FsFlusher* fs_flusher_open(const char* path, unsigned window_us)
+{
+    if(!path)
+    {
+        errno = EINVAL;
+        return NULL;
+    }
+    FsFlusher* fl = calloc(1, sizeof *fl);
+    if(!fl)
+        return NULL;
+    fl->window_us = window_us;
+    atomic_init(&fl->nsyncs, 0);
+    fl->fd = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if(fl->fd < 0)
+    {
+        free(fl);
+        return NULL;
+    }
+    pthread_condattr_t ca;
+    pthread_condattr_init(&ca);
+    pthread_condattr_setclock(&ca, CLOCK_MONOTONIC);
+    pthread_mutex_init(&fl->mu, NULL);
+    pthread_cond_init(&fl->cv_req, &ca);
+    pthread_cond_init(&fl->cv_done, NULL);
+    pthread_condattr_destroy(&ca);
+
+    int prc = pthread_create(&fl->thread, NULL, flusher_main, fl);
+    if(prc != 0)
+    {
+        pthread_cond_destroy(&fl->cv_done);
+        pthread_cond_destroy(&fl->cv_req);
+        pthread_mutex_destroy(&fl->mu);
+        close(fl->fd);
+        free(fl);
+        errno = prc;
+        return NULL;
+    }
+    return fl;
+}
+
+void fs_flusher_close(FsFlusher* fl)
+{
+    if(!fl)
+        return;
+    pthread_mutex_lock(&fl->mu);
+    fl->stop = 1;
+    pthread_cond_broadcast(&fl->cv_req);
+    pthread_mutex_unlock(&fl->mu);
+    pthread_join(fl->thread, NULL);
+
+    pthread_cond_destroy(&fl->cv_done);
+    pthread_cond_destroy(&fl->cv_req);
+    pthread_mutex_destroy(&fl->mu);
+    close(fl->fd);
+    free(fl);
+}
+
+int fs_flusher_sync(FsFlusher* fl)
+{
+    if(!fl)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+    pthread_mutex_lock(&fl->mu);
+    uint64_t ticket = ++fl->issued;
+    pthread_cond_signal(&fl->cv_req);
+    while(fl->synced < ticket)
+        pthread_cond_wait(&fl->cv_done, &fl->mu);
+    int rc = 0;
+    for(unsigned i = 0; i < fl->nbad; ++i)
+    {
+        FsBadRange* b = &fl->bad[i];
+        if(ticket <= b->lo || ticket > b->hi)
+            continue;
+        rc = -1;
+        int e = b->err;
+        if(--b->left == 0)
+        {
+            fl->bad[i] = fl->bad[--fl->nbad];
+            pthread_cond_broadcast(&fl->cv_req); /* flusher may wait for room */
+        }
+        errno = e;
+        break;
+    }
+    pthread_mutex_unlock(&fl->mu);
+    return rc;
+}
+
+uint64_t fs_flusher_count(FsFlusher* fl)
+{
+    return fl ? atomic_load(&fl->nsyncs) : 0;
+}
+
 /****************************************************************************
  * PRIVATE FUNCTIONS DEFINITIONS
  ****************************************************************************
  */
 
+static void* flusher_main(void* arg)
+{
+    FsFlusher* fl = (FsFlusher*)arg;
+    pthread_mutex_lock(&fl->mu);
+    for(;;)
+    {
+        while(fl->issued == fl->synced && !fl->stop)
+            pthread_cond_wait(&fl->cv_req, &fl->mu);
+        if(fl->issued == fl->synced)
+            break; /* stop requested and nothing pending */
+
+        /* optional window: let more writers join this group */
+        if(fl->window_us && !fl->stop)
+        {
+            struct timespec dl;
+            clock_gettime(CLOCK_MONOTONIC, &dl);
+            dl.tv_nsec += (long)fl->window_us * 1000L;
+            dl.tv_sec += dl.tv_nsec / 1000000000L;
+            dl.tv_nsec %= 1000000000L;
+            while(!fl->stop &&
+                  pthread_cond_timedwait(&fl->cv_req, &fl->mu, &dl) == 0)
+                ;
+        }
+
+        /* everything written before these tickets is covered */
+        uint64_t target = fl->issued;
+        pthread_mutex_unlock(&fl->mu);
+
+        int rc = syncfs(fl->fd);
+        int e  = errno;
+        atomic_fetch_add(&fl->nsyncs, 1);
+
+        pthread_mutex_lock(&fl->mu);
+        if(rc != 0)
+        {
+            /* one ticket per waiter: the range lives until each of them
+               has reported the error, so a later failure cannot hide it.
+               Earlier groups are already complete; their waiters only need
+               'mu' to collect and free a slot. */
+            while(fl->nbad == FS_FLUSH_BAD)
+                pthread_cond_wait(&fl->cv_req, &fl->mu);
+            fl->bad[fl->nbad++] =
+                (FsBadRange){fl->synced, target, target - fl->synced, e};
+        }
+        fl->synced = target;
+        pthread_cond_broadcast(&fl->cv_done);
+    }
+    pthread_mutex_unlock(&fl->mu);
+    return NULL;
+}
+
+static int hex_nibble(char c)
+{
+    if(c >= '0' && c <= '9')
+        return c - '0';
+    if(c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    return -1;
+}
+
+static long layout_index(FsLayout l, const char* hex64)
+{
+    if(!hex64 || strnlen(hex64, 65) != 64)
+        return -1;
+    long v = 0;
+    for(unsigned i = 0; i < l.levels * l.width; ++i)
+    {
+        int n = hex_nibble(hex64[i]);
+        if(n < 0)
+            return -1;
+        v = (v << 4) | n;
+    }
+    return v;
+}
+
+static size_t layout_leaf(FsLayout l, size_t idx, char* out)
+{
+    unsigned digits = l.levels * l.width;
+    size_t   len    = 0;
+    for(unsigned i = 0; i < digits; ++i)
+    {
+        if(i && i % l.width == 0)
+            out[len++] = '/';
+        out[len++] = FS_HEX[(idx >> (4u * (digits - 1 - i))) & 0xF];
+    }
+    out[len] = '\0';
+    return len;
+}
+
+static int layout_shares_dir(FsLayout l, unsigned depth, FsLayout to)
+{
+    return l.width == to.width && depth <= to.levels;
+}
+
+static int is_hex64(const char* name)
+{
+    if(strnlen(name, 65) != 64)
+        return 0;
+    for(int i = 0; i < 64; ++i)
+        if(hex_nibble(name[i]) < 0)
+            return 0;
+    return 1;
+}
+
+static int leaf_fd(FsObjDir* od, FsLayout l, size_t idx, int cache,
+                   int create, int* owned)
+{
+    *owned = 0;
+    _Atomic uint64_t* slot = cache ? &od->leaf[idx & (od->slots - 1)] : NULL;
+    if(slot)
+    {
+        uint64_t v = atomic_load_explicit(slot, memory_order_acquire);
+        if((v >> 32) == (uint64_t)idx + 1)
+            return (int)(uint32_t)v;
+    }
+
+    char rel[16];
+    layout_leaf(l, idx, rel);
+    int fd = openat(od->base_fd, rel, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if(fd < 0 && errno == ENOENT && create)
+    {
+        /* each level in turn: "ab", "ab/cd", ... */
+        for(unsigned d = 1; d <= l.levels; ++d)
+        {
+            char c = rel[d * (l.width + 1) - 1];
+            rel[d * (l.width + 1) - 1] = '\0';
+            int rc = mkdirat(od->base_fd, rel, 0770);
+            rel[d * (l.width + 1) - 1] = c;
+            if(rc != 0 && errno != EEXIST)
+                return -1;
+        }
+        fd = openat(od->base_fd, rel, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    }
+    if(fd < 0)
+        return -1;
+
+    if(!slot || atomic_fetch_add(&od->cached, 1) >= od->budget)
+    {
+        if(slot)
+            atomic_fetch_sub(&od->cached, 1);
+        *owned = 1; /* over budget or slot not ours: transient handle */
+        return fd;
+    }
+    uint64_t expect = 0;
+    uint64_t mine   = ((uint64_t)idx + 1) << 32 | (uint32_t)fd;
+    if(atomic_compare_exchange_strong(slot, &expect, mine))
+        return fd;
+    atomic_fetch_sub(&od->cached, 1);
+    if((expect >> 32) == (uint64_t)idx + 1)
+    {
+        close(fd); /* another thread won */
+        return (int)(uint32_t)expect;
+    }
+    *owned = 1; /* slot taken by another leaf */
+    return fd;
+}
+
+static void leaf_put(int fd, int owned)
+{
+    if(owned && fd >= 0)
+        close(fd);
+}
+
+static int leaf_cache_reset(FsObjDir* od, size_t shards)
+{
+    size_t            slots = shards < FS_LEAF_SLOTS ? shards : FS_LEAF_SLOTS;
+    _Atomic uint64_t* leaf  = malloc(slots * sizeof *leaf);
+    if(!leaf)
+        return -1;
+    for(size_t i = 0; i < slots; ++i)
+        atomic_init(&leaf[i], 0);
+    leaf_cache_close(od);
+    free(od->leaf);
+    od->leaf  = leaf;
+    od->slots = slots;
+    atomic_store(&od->cached, 0);
+    return 0;
+}
+
+static void leaf_cache_close(FsObjDir* od)
+{
+    for(size_t i = 0; od->leaf && i < od->slots; ++i)
+    {
+        uint64_t v = atomic_load(&od->leaf[i]);
+        if(v)
+            close((int)(uint32_t)v);
+    }
+}
+
+static int op_open(FsObjDir* od, int dfd, const char* hex64, void* arg)
+{
+    (void)od;
+    return openat(dfd, hex64, *(int*)arg | O_CLOEXEC);
+}
+
+static int op_stat(FsObjDir* od, int dfd, const char* hex64, void* arg)
+{
+    (void)od;
+    return fstatat(dfd, hex64, arg, 0);
+}
+
+static int op_unlink(FsObjDir* od, int dfd, const char* hex64, void* arg)
+{
+    (void)od;
+    (void)arg;
+    return unlinkat(dfd, hex64, 0);
+}
+
+static int op_retire(FsObjDir* od, int dfd, const char* hex64, void* arg)
+{
+    return renameat(dfd, hex64, od->base_fd, arg);
+}
+
+static int op_relink(FsObjDir* od, int dfd, const char* hex64, void* arg)
+{
+    FsLayout to    = *(const FsLayout*)arg;
+    long     nidx  = layout_index(to, hex64);
+    int      owned = 0;
+    int nfd = nidx < 0 ? -1 : leaf_fd(od, to, (size_t)nidx, 1, 1, &owned);
+    if(nfd < 0)
+        return -1;
+    int rc = linkat(dfd, hex64, nfd, hex64, 0);
+    int e  = errno;
+    leaf_put(nfd, owned);
+    if(rc != 0 && e == EEXIST)
+        return 0;
+    errno = e;
+    return rc;
+}
+
+static int layout_try(FsObjDir* od, FsLayout l, int cache, const char* hex64,
+                      obj_op_fn fn, void* arg)
+{
+    long idx = layout_index(l, hex64);
+    if(idx < 0)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+    int owned = 0;
+    int sfd   = leaf_fd(od, l, (size_t)idx, cache, 0, &owned);
+    if(sfd < 0)
+        return -1;
+    int rc = fn(od, sfd, hex64, arg);
+    int e  = errno;
+    leaf_put(sfd, owned);
+    errno = e;
+    return rc;
+}
+
+static int objdir_lookup(FsObjDir* od, const char* hex64, obj_op_fn fn,
+                         void* arg)
+{
+    pthread_rwlock_rdlock(&od->lock);
+    int rc = layout_try(od, od->cur, 1, hex64, fn, arg);
+    if(rc < 0 && errno == ENOENT && od->relayout)
+    {
+        /* not moved yet, or moved between the two tries */
+        rc = layout_try(od, od->from, 0, hex64, fn, arg);
+        if(rc < 0 && errno == ENOENT)
+            rc = layout_try(od, od->cur, 1, hex64, fn, arg);
+    }
+    int e = errno;
+    pthread_rwlock_unlock(&od->lock);
+    errno = e;
+    return rc;
+}
+
+static int tmp_name_random(char name[48])
+{
+    unsigned char rnd[16];
+    size_t        got = 0;
+#if defined(__linux__)
+    ssize_t r = getrandom(rnd, sizeof rnd, GRND_NONBLOCK);
+    if(r > 0)
+        got = (size_t)r;
+#endif
+    if(got < sizeof rnd)
+    {
+        /* weak but unique enough for O_EXCL retries */
+        static _Atomic unsigned long ctr = 0;
+        unsigned long                x   = atomic_fetch_add(&ctr, 1) ^
+                          ((unsigned long)getpid() << 20) ^
+                          (unsigned long)time(NULL);
+        for(size_t i = got; i < sizeof rnd; ++i)
+        {
+            x      = x * 6364136223846793005UL + 1442695040888963407UL;
+            rnd[i] = (unsigned char)(x >> 56);
+        }
+    }
+    memcpy(name, ".ingest.", 8);
+    for(int i = 0; i < 16; ++i)
+    {
+        name[8 + i * 2] = FS_HEX[rnd[i] >> 4];
+        name[9 + i * 2] = FS_HEX[rnd[i] & 0xF];
+    }
+    name[8 + 32] = '\0';
+    return 0;
+}
+
+static int is_temp_name(const char* name)
+{
+    if(strncmp(name, ".ingest.", 8) == 0)
+        return 1;
+    if(strlen(name) <= 69 || strncmp(name + 64, ".tmp.", 5) != 0)
+        return 0;
+    for(int i = 0; i < 64; ++i)
+        if(hex_nibble(name[i]) < 0)
+            return 0;
+    return 1;
+}
+
+static void sweep_temp(int dfd, const char* name, time_t before, int dry_run,
+                       FsTempSweep* tmp)
+{
+    /* ctime moves on rename and link: a just-retired object looks young */
+    struct stat st;
+    if(fstatat(dfd, name, &st, AT_SYMLINK_NOFOLLOW) != 0 ||
+       !S_ISREG(st.st_mode))
+        return;
+    if(st.st_ctime > before)
+    {
+        tmp->young++;
+        return;
+    }
+    tmp->found++;
+    tmp->bytes += (uint64_t)st.st_size;
+    if(!dry_run && unlinkat(dfd, name, 0) == 0)
+        tmp->removed++;
+}
+
+static int digest_cmp(const void* a, const void* b)
+{
+    return memcmp(a, b, 32);
+}
+
 static int mkdir_one(const char* path, mode_t mode)
 {
     if(mkdir(path, mode) == 0)
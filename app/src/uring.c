@@ -0,0 +1,221 @@
+/**
+ * @file uring.c
+ * @brief
+ *
+ * @author  Roman Horshkov <roman.horshkov@gmail.com>
+ * @date    2025
+ * (c) 2025
+ */
+
+#define _GNU_SOURCE
+#include "uring.h"
+
+#include <errno.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+/****************************************************************************
+ * PRIVATE DEFINES
+ ****************************************************************************
+ */
+
+#define URING_LOAD_ACQ(p)     __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define URING_STORE_REL(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+
+/****************************************************************************
+ * PRIVATE STUCTURED VARIABLES
+ ****************************************************************************
+ */
+/* None */
+
+/****************************************************************************
+ * PRIVATE VARIABLES
+ ****************************************************************************
+ */
+/* None */
+
+/****************************************************************************
+ * PRIVATE FUNCTIONS PROTOTYPES
+ ****************************************************************************
+ */
+
+static int sys_io_uring_setup(unsigned entries, struct io_uring_params* p);
+static int sys_io_uring_enter(int fd, unsigned to_submit, unsigned min_complete,
+                              unsigned flags);
+static int sys_io_uring_register(int fd, unsigned opcode, const void* arg,
+                                 unsigned nr_args);
+
+/****************************************************************************
+ * PUBLIC FUNCTIONS DEFINITIONS
+ ****************************************************************************
+ */
+
+int uring_init(Uring* r, unsigned entries)
+{
+    if(!r || entries == 0)
+        return -EINVAL;
+    memset(r, 0, sizeof *r);
+    r->ring_fd = -1;
+
+    int                    err = 0;
+    struct io_uring_params p;
+    memset(&p, 0, sizeof p);
+    int fd = sys_io_uring_setup(entries, &p);
+    if(fd < 0)
+        return -errno;
+    r->ring_fd = fd;
+
+    r->sq_ring_sz = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    r->cq_ring_sz = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    int single    = (p.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if(single && r->cq_ring_sz > r->sq_ring_sz)
+        r->sq_ring_sz = r->cq_ring_sz;
+
+    r->sq_ring = mmap(NULL, r->sq_ring_sz, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if(r->sq_ring == MAP_FAILED)
+        goto fail;
+    if(single)
+        r->cq_ring = r->sq_ring;
+    else
+    {
+        r->cq_ring = mmap(NULL, r->cq_ring_sz, PROT_READ | PROT_WRITE,
+                          MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+        if(r->cq_ring == MAP_FAILED)
+        {
+            r->cq_ring = NULL;
+            goto fail;
+        }
+    }
+    r->sqes_sz = p.sq_entries * sizeof(struct io_uring_sqe);
+    r->sqes    = mmap(NULL, r->sqes_sz, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if(r->sqes == MAP_FAILED)
+    {
+        r->sqes = NULL;
+        goto fail;
+    }
+
+    char* sq         = (char*)r->sq_ring;
+    char* cq         = (char*)r->cq_ring;
+    r->sq_head       = (unsigned*)(sq + p.sq_off.head);
+    r->sq_tail       = (unsigned*)(sq + p.sq_off.tail);
+    r->sq_mask       = (unsigned*)(sq + p.sq_off.ring_mask);
+    r->sq_array      = (unsigned*)(sq + p.sq_off.array);
+    r->sq_entries    = p.sq_entries;
+    r->sq_local_tail = *r->sq_tail;
+    r->cq_head       = (unsigned*)(cq + p.cq_off.head);
+    r->cq_tail       = (unsigned*)(cq + p.cq_off.tail);
+    r->cq_mask       = (unsigned*)(cq + p.cq_off.ring_mask);
+    r->cqes          = (struct io_uring_cqe*)(cq + p.cq_off.cqes);
+    return 0;
+
+fail:
+    err = errno;
+    if(r->sq_ring == MAP_FAILED)
+        r->sq_ring = NULL;
+    uring_exit(r);
+    return -err;
+}
+
+void uring_exit(Uring* r)
+{
+    if(!r)
+        return;
+    if(r->sqes)
+        munmap(r->sqes, r->sqes_sz);
+    if(r->cq_ring && r->cq_ring != r->sq_ring)
+        munmap(r->cq_ring, r->cq_ring_sz);
+    if(r->sq_ring)
+        munmap(r->sq_ring, r->sq_ring_sz);
+    if(r->ring_fd >= 0)
+        close(r->ring_fd);
+    memset(r, 0, sizeof *r);
+    r->ring_fd = -1;
+}
+
+int uring_register_buffers(Uring* r, const struct iovec* iov, unsigned n)
+{
+    if(!r || !iov || n == 0)
+        return -EINVAL;
+    if(sys_io_uring_register(r->ring_fd, IORING_REGISTER_BUFFERS, iov, n) < 0)
+        return -errno;
+    return 0;
+}
+
+struct io_uring_sqe* uring_get_sqe(Uring* r)
+{
+    unsigned head = URING_LOAD_ACQ(r->sq_head);
+    if(r->sq_local_tail - head >= r->sq_entries)
+        return NULL;
+    unsigned             idx = r->sq_local_tail & *r->sq_mask;
+    struct io_uring_sqe* sqe = &r->sqes[idx];
+    memset(sqe, 0, sizeof *sqe);
+    r->sq_array[idx] = idx;
+    r->sq_local_tail++;
+    return sqe;
+}
+
+unsigned uring_sq_space(Uring* r)
+{
+    return r->sq_entries - (r->sq_local_tail - URING_LOAD_ACQ(r->sq_head));
+}
+
+int uring_submit_and_wait(Uring* r, unsigned wait_nr)
+{
+    unsigned to_submit = r->sq_local_tail - *r->sq_tail;
+    URING_STORE_REL(r->sq_tail, r->sq_local_tail);
+
+    for(;;)
+    {
+        int n = sys_io_uring_enter(r->ring_fd, to_submit, wait_nr,
+                                   wait_nr ? IORING_ENTER_GETEVENTS : 0);
+        if(n >= 0)
+            return n;
+        if(errno == EINTR)
+        {
+            /* resubmit only what the kernel has not consumed yet */
+            to_submit = r->sq_local_tail - URING_LOAD_ACQ(r->sq_head);
+            continue;
+        }
+        return -errno;
+    }
+}
+
+struct io_uring_cqe* uring_peek_cqe(Uring* r)
+{
+    unsigned head = *r->cq_head;
+    if(head == URING_LOAD_ACQ(r->cq_tail))
+        return NULL;
+    return &r->cqes[head & *r->cq_mask];
+}
+
+void uring_cqe_seen(Uring* r)
+{
+    URING_STORE_REL(r->cq_head, *r->cq_head + 1);
+}
+
+/****************************************************************************
+ * PRIVATE FUNCTIONS DEFINITIONS
+ ****************************************************************************
+ */
+
+static int sys_io_uring_setup(unsigned entries, struct io_uring_params* p)
+{
+    return (int)syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int sys_io_uring_enter(int fd, unsigned to_submit, unsigned min_complete,
+                              unsigned flags)
+{
+    return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete,
+                        flags, NULL, 0);
+}
+
+static int sys_io_uring_register(int fd, unsigned opcode, const void* arg,
+                                 unsigned nr_args)
+{
+    return (int)syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
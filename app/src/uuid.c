@@ -156,6 +156,21 @@ void uuid_to_hex(uint8_t id[UUID_BYTES_SIZE], char out32[33])
     out32[32] = '\0';
 }
 
+uint64_t uuid_v7_ms(const uint8_t id[UUID_BYTES_SIZE])
+{
+    uint64_t ms = 0;
+    for(int i = 0; i < 6; ++i)
+        ms = (ms << 8) | id[i];
+    return ms;
+}
+
+void uuid_v7_floor(uint64_t ms, uint8_t out[UUID_BYTES_SIZE])
+{
+    memset(out, 0, UUID_BYTES_SIZE);
+    for(int i = 0; i < 6; ++i)
+        out[i] = (uint8_t)(ms >> (40 - 8 * i));
+}
+
 /****************************************************************************
  * PRIVATE FUNCTIONS DEFINITIONS
  ****************************************************************************
@@ -0,0 +1,111 @@
+/**
+ * @file workpool.c
+ * @brief
+ *
+ * @author  Roman Horshkov <roman.horshkov@gmail.com>
+ * @date    2025
+ * (c) 2025
+ */
+
+#include "workpool.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <unistd.h>
+
+/****************************************************************************
+ * PRIVATE DEFINES
+ ****************************************************************************
+ */
+/* None */
+
+/****************************************************************************
+ * PRIVATE STUCTURED VARIABLES
+ ****************************************************************************
+ */
+
+typedef struct
+{
+    _Atomic size_t next; /* next unclaimed index */
+    size_t         n;
+    wp_item_fn     fn;
+    void*          user;
+} WpLoop;
+
+/****************************************************************************
+ * PRIVATE VARIABLES
+ ****************************************************************************
+ */
+/* None */
+
+/****************************************************************************
+ * PRIVATE FUNCTIONS PROTOTYPES
+ ****************************************************************************
+ */
+
+static void* wp_worker(void* arg);
+
+/****************************************************************************
+ * PUBLIC FUNCTIONS DEFINITIONS
+ ****************************************************************************
+ */
+
+unsigned wp_ncpu(void)
+{
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (unsigned)n : 1u;
+}
+
+int wp_parallel_for(size_t n, unsigned nthreads, wp_item_fn fn, void* user)
+{
+    if(!fn)
+        return -EINVAL;
+    if(n == 0)
+        return 0;
+
+    if(nthreads == 0)
+        nthreads = wp_ncpu();
+    if(nthreads > WP_MAX_THREADS)
+        nthreads = WP_MAX_THREADS;
+    if((size_t)nthreads > n)
+        nthreads = (unsigned)n;
+
+    WpLoop loop = {.n = n, .fn = fn, .user = user};
+    atomic_init(&loop.next, 0);
+
+    /* caller is worker 0; spawn the rest */
+    pthread_t tids[WP_MAX_THREADS];
+    unsigned  spawned = 0;
+    for(unsigned t = 1; t < nthreads; ++t)
+    {
+        if(pthread_create(&tids[spawned], NULL, wp_worker, &loop) != 0)
+            break; /* run with what we have */
+        spawned++;
+    }
+
+    wp_worker(&loop);
+
+    for(unsigned t = 0; t < spawned; ++t)
+        pthread_join(tids[t], NULL);
+    return 0;
+}
+
+/****************************************************************************
+ * PRIVATE FUNCTIONS DEFINITIONS
+ ****************************************************************************
+ */
+
+static void* wp_worker(void* arg)
+{
+    WpLoop* loop = (WpLoop*)arg;
+    for(;;)
+    {
+        size_t i = atomic_fetch_add_explicit(&loop->next, 1,
+                                             memory_order_relaxed);
+        if(i >= loop->n)
+            break;
+        loop->fn(i, loop->user);
+    }
+    return NULL;
+}
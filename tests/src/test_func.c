@@ -1,8 +1,15 @@
 /* src/tests/test_functionality.c */
 #include <sys/stat.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <stdatomic.h>
+#include <lmdb.h>
 
 #include "test_utils.h"
 #include "db_interface.h"
+#include "sha256.h"
+#include "blake3.h"
 
 static int is_zero16(const uint8_t x[16])
 {
@@ -252,6 +259,10 @@ int t_resolve_path_points_to_object(void)
     struct stat st;
     EXPECT_TRUE(stat(path, &st) == 0 && S_ISREG(st.st_mode));
 
+    /* a buffer too small for the path is the caller's error, not I/O */
+    char small[16];
+    EXPECT_EQ_RC(db_data_get_path(D, small, sizeof small), -ENAMETOOLONG);
+
     close(fd);
     unlink("./.tmp_blob4.dcm");
     tu_teardown_store(&ctx);
@@ -361,9 +372,9 @@ int t_owner_delete_cascade(void)
     return 0;
 }
 
-/* No dedup: second upload with same SHA must fail with -EEXIST; only the
- * original owner can delete. (Covers “different uploader second upload”.) */
-int t_no_dedup_second_upload_fails_and_owner_deletes(void)
+/* Shared dedup: a second owner uploading the same bits gets an own record on
+ * the same blob; the blob survives until its last reference is deleted. */
+int t_dedup_second_owner_shares_blob(void)
 {
     Ctx ctx;
     if(tu_setup_store(&ctx) != 0)
@@ -390,24 +401,46 @@ int t_no_dedup_second_upload_fails_and_owner_deletes(void)
     /* First upload creates object */
     EXPECT_EQ_RC(db_data_add_from_fd(A, fd, "application/dicom", D1), 0);
 
-    /* Second upload by B with same bits: must fail (-EEXIST), out id untouched/zero */
+    /* Second upload by B with same bits: own record, same blob */
     lseek(fd, 0, SEEK_SET);
-    int rc = db_data_add_from_fd(B, fd, "application/dicom", D2);
-    EXPECT_EQ_RC(rc, -EEXIST);
-    EXPECT_TRUE(is_zero16(D2));
+    EXPECT_EQ_RC(db_data_add_from_fd(B, fd, "text/plain", D2), 0);
+    EXPECT_TRUE(!is_zero16(D2));
+    EXPECT_TRUE(memcmp(D1, D2, DB_ID_SIZE) != 0);
 
-    /* B cannot delete (not an owner) */
-    EXPECT_EQ_RC(db_data_delete(B, D1), -ENOENT);
+    char p1[PATH_MAX], p2[PATH_MAX];
+    EXPECT_EQ_RC(db_data_get_path(D1, p1, sizeof p1), 0);
+    EXPECT_EQ_RC(db_data_get_path(D2, p2, sizeof p2), 0);
+    EXPECT_TRUE(strcmp(p1, p2) == 0);
 
-    /* Resolution still works after B's failed delete */
-    char path[PATH_MAX];
-    EXPECT_EQ_RC(db_data_get_path(D1, path, sizeof path), 0);
+    DataMeta m2;
+    EXPECT_EQ_RC(db_data_get_meta(D2, &m2), 0);
+    EXPECT_TRUE(memcmp(m2.owner, B, DB_ID_SIZE) == 0);
+    EXPECT_TRUE(strcmp(m2.mime, "text/plain") == 0);
+
+    /* Each owner deletes only its own record */
+    EXPECT_EQ_RC(db_data_delete(B, D1), -ENOENT);
+    EXPECT_EQ_RC(db_data_delete(A, D2), -ENOENT);
 
-    /* A can delete */
+    /* A's delete leaves the blob to B */
     EXPECT_EQ_RC(db_data_delete(A, D1), 0);
+    EXPECT_EQ_RC(db_data_get_path(D1, p1, sizeof p1), -ENOENT);
+    EXPECT_TRUE(access(p2, F_OK) == 0);
+    int rfd = -1;
+    EXPECT_EQ_RC(db_data_open(D2, &rfd), 0);
+    close(rfd);
+
+    /* A's owner|sha entry went with its record: A may upload it anew */
+    uint8_t D3[DB_ID_SIZE] = {0};
+    lseek(fd, 0, SEEK_SET);
+    EXPECT_EQ_RC(db_data_add_from_fd(A, fd, "application/dicom", D3), 0);
+    EXPECT_TRUE(memcmp(D3, D1, DB_ID_SIZE) != 0);
+    lseek(fd, 0, SEEK_SET);
+    EXPECT_EQ_RC(db_data_add_from_fd(A, fd, "application/dicom", D1), -EEXIST);
+    EXPECT_EQ_RC(db_data_delete(A, D3), 0);
 
-    /* Resolution fails after delete */
-    EXPECT_EQ_RC(db_data_get_path(D1, path, sizeof path), -ENOENT);
+    /* Last reference removes the blob */
+    EXPECT_EQ_RC(db_data_delete(B, D2), 0);
+    EXPECT_TRUE(access(p2, F_OK) != 0);
 
     close(fd);
     unlink("./.tmp_blob7.dcm");
@@ -895,41 +928,2799 @@ int t_list_publishers_viewers(void)
     return 0;
 }
 
-/* ------------------------------ Registry ---------------------------------- */
-static const TU_Test TESTS[] = {
-    {"open_creates_layout", t_open_creates_layout},
-    {"add_user_and_find", t_add_user_and_find},
-    {"roles_and_listing", t_roles_and_listing},
-    {"upload_requires_publisher", t_upload_requires_publisher},
-    {"share_requires_relationship", t_share_requires_relationship},
-    {"share_by_email", t_share_by_email},
-    {"resolve_path_points_to_object", t_resolve_path_points_to_object},
-    {"owner_delete_cascade", t_owner_delete_cascade},
+/* Regular files (zero-copy, also from a non-zero offset) and pipes (read
+ * loop) store identical bytes whose digest matches DataMeta. */
+int t_ingest_regular_and_pipe_sources(void)
+{
+    Ctx ctx;
+    if(tu_setup_store(&ctx) != 0)
+    {
+        tu_failf(__FILE__, __LINE__, "setup");
+        return -1;
+    }
 
-    /* no-dedup semantics */
-    {"no_dedup_second_upload_fails_and_owner_deletes",
-     t_no_dedup_second_upload_fails_and_owner_deletes},
-    {"same_user_second_upload_fails", t_same_user_second_upload_fails},
-    {"reupload_after_delete_new_id", t_reupload_after_delete_new_id},
+    uint8_t P[DB_ID_SIZE] = {0};
+    char    ep[DB_EMAIL_MAX_LEN];
+    snprintf(ep, sizeof ep, "%s", "zc@x.com");
+    db_add_user(ep, P);
+    db_user_set_role_publisher(P);
 
-    /* sharing edges */
-    {"share_idempotent", t_share_idempotent},
-    {"share_self_noop", t_share_self_noop},
-    {"share_to_missing_email", t_share_to_missing_email},
-    {"share_denied_when_not_owner", t_share_denied_when_not_owner},
+    int fd = tu_make_blob("./.tmp_blob_zc.dcm", "zero-copy-payload");
+    EXPECT_TRUE(fd >= 0);
+    struct stat fst;
+    EXPECT_TRUE(fstat(fd, &fst) == 0);
 
-    /* life-cycle edges */
-    {"double_delete_semantics", t_double_delete_semantics},
-    {"cannot_share_after_delete", t_cannot_share_after_delete},
-    {"share_invalid_email_empty", t_share_invalid_email_empty},
+    /* regular file, from offset 'skip': only the tail is stored */
+    const off_t skip = 4;
+    uint8_t     D1[DB_ID_SIZE] = {0};
+    lseek(fd, skip, SEEK_SET);
+    EXPECT_EQ_RC(db_data_add_from_fd(P, fd, "x/bin", D1), 0);
+    EXPECT_TRUE(lseek(fd, 0, SEEK_CUR) == lseek(fd, 0, SEEK_END));
 
-    /* interface-only extras */
-    {"open_invalid_args", t_open_invalid_args},
-    {"find_by_ids_mixed", t_find_by_ids_mixed},
-    {"data_meta_sane", t_data_meta_sane},
-    {"get_path_invalid_args", t_get_path_invalid_args},
-    {"env_metrics_sane", t_env_metrics_sane},
-    {"list_publishers_viewers", t_list_publishers_viewers},
+    DataMeta m = {0};
+    EXPECT_EQ_RC(db_data_get_meta(D1, &m), 0);
+    EXPECT_EQ_SIZE(m.size, (size_t)(fst.st_size - skip));
+
+    char   path[PATH_MAX];
+    Sha256 d;
+    size_t sz = 0;
+    EXPECT_EQ_RC(db_data_get_path(D1, path, sizeof path), 0);
+    EXPECT_EQ_RC(crypt_sha256_file(path, &d, &sz), 0);
+    EXPECT_TRUE(memcmp(d.b, m.sha, 32) == 0);
+    EXPECT_EQ_SIZE(sz, m.size);
+
+    /* pipe: same bytes from offset 0 must hash like the whole file */
+    int pfd[2];
+    EXPECT_TRUE(pipe(pfd) == 0);
+    char whole[64];
+    lseek(fd, 0, SEEK_SET);
+    ssize_t n = read(fd, whole, sizeof whole);
+    EXPECT_TRUE(n > 0 && write(pfd[1], whole, (size_t)n) == n);
+    close(pfd[1]);
+
+    uint8_t D2[DB_ID_SIZE] = {0};
+    EXPECT_EQ_RC(db_data_add_from_fd(P, pfd[0], "x/bin", D2), 0);
+    close(pfd[0]);
+
+    Sha256 whole_d;
+    EXPECT_EQ_RC(crypt_sha256_fd(fd, &whole_d, NULL), 0);
+    EXPECT_EQ_RC(db_data_get_meta(D2, &m), 0);
+    EXPECT_TRUE(memcmp(whole_d.b, m.sha, 32) == 0);
+    EXPECT_EQ_SIZE(m.size, (size_t)n);
+
+    close(fd);
+    unlink("./.tmp_blob_zc.dcm");
+    tu_teardown_store(&ctx);
+    return 0;
+}
+
+/* Every streaming engine stores the same bytes: a multi-buffer regular file
+ * (zero-copy off) and the same content through a non-blocking pipe must hash
+ * identically, so the pipe upload is a dedup hit. */
+int t_ingest_engines_agree(void)
+{
+    Ctx ctx;
+    if(tu_setup_store(&ctx) != 0)
+    {
+        tu_failf(__FILE__, __LINE__, "setup");
+        return -1;
+    }
+
+    uint8_t P[DB_ID_SIZE] = {0};
+    char    ep[DB_EMAIL_MAX_LEN];
+    snprintf(ep, sizeof ep, "%s", "eng@x.com");
+    db_add_user(ep, P);
+    db_user_set_role_publisher(P);
+
+    const size_t   LEN = (1u << 20) + 4099; /* spans several ring buffers */
+    unsigned char *buf = malloc(LEN);
+    EXPECT_TRUE(buf != NULL);
+    if(!buf)
+    {
+        tu_teardown_store(&ctx);
+        return -1;
+    }
+
+    const CryptEngine engines[3] = {CRYPT_ENGINE_URING, CRYPT_ENGINE_THREADS,
+                                    CRYPT_ENGINE_SERIAL};
+    crypt_set_zero_copy(0);
+    for(int e = 0; e < 3; ++e)
+    {
+        crypt_set_ingest_engine(engines[e]);
+        for(size_t i = 0; i < LEN; ++i)
+            buf[i] = (unsigned char)((i * 131u + (size_t)e * 7u) >> 3);
+
+        int fd = open("./.tmp_blob_eng.bin", O_CREAT | O_RDWR | O_TRUNC, 0640);
+        EXPECT_TRUE(fd >= 0 && write(fd, buf, LEN) == (ssize_t)LEN);
+        lseek(fd, 0, SEEK_SET);
+
+        uint8_t D[DB_ID_SIZE] = {0};
+        EXPECT_EQ_RC(db_data_add_from_fd(P, fd, "x/bin", D), 0);
+        EXPECT_TRUE(lseek(fd, 0, SEEK_CUR) == (off_t)LEN);
+
+        DataMeta m = {0};
+        Sha256   d;
+        EXPECT_EQ_RC(db_data_get_meta(D, &m), 0);
+        EXPECT_EQ_RC(crypt_sha256_fd(fd, &d, NULL), 0);
+        EXPECT_TRUE(memcmp(d.b, m.sha, 32) == 0);
+        EXPECT_EQ_SIZE(m.size, LEN);
+        close(fd);
+        unlink("./.tmp_blob_eng.bin");
+
+        /* same bytes through a non-blocking pipe fed by a child */
+        int pfd[2];
+        EXPECT_TRUE(pipe(pfd) == 0);
+        pid_t pid = fork();
+        if(pid == 0)
+        {
+            close(pfd[0]);
+            size_t off = 0;
+            while(off < LEN)
+            {
+                ssize_t w = write(pfd[1], buf + off, LEN - off);
+                if(w <= 0)
+                    _exit(1);
+                off += (size_t)w;
+            }
+            _exit(0);
+        }
+        close(pfd[1]);
+        fcntl(pfd[0], F_SETFL, fcntl(pfd[0], F_GETFL) | O_NONBLOCK);
+        uint8_t D2[DB_ID_SIZE] = {0};
+        EXPECT_EQ_RC(db_data_add_from_fd(P, pfd[0], "x/bin", D2), -EEXIST);
+        close(pfd[0]);
+        waitpid(pid, NULL, 0);
+    }
+    crypt_set_ingest_engine(CRYPT_ENGINE_AUTO);
+    crypt_set_zero_copy(1);
+
+    free(buf);
+    tu_teardown_store(&ctx);
+    return 0;
+}
+
+/* Publish leaves no temp behind; db_data_open reaches the same bytes as
+ * db_data_get_path; DB_SHARDS_PRECREATE builds the shard tree at open. */
+int t_open_blob_via_shard_handles(void)
+{
+    setenv("DB_SHARDS_PRECREATE", "1", 1);
+    Ctx ctx;
+    int rc = tu_setup_store(&ctx);
+    unsetenv("DB_SHARDS_PRECREATE");
+    if(rc != 0)
+    {
+        tu_failf(__FILE__, __LINE__, "setup");
+        return -1;
+    }
+
+    char leaf[PATH_MAX + 64];
+    snprintf(leaf, sizeof leaf, "%s/objects/sha256/ff/ff", ctx.root);
+    EXPECT_TRUE(tu_is_dir(leaf));
+
+    uint8_t P[DB_ID_SIZE] = {0};
+    char    ep[DB_EMAIL_MAX_LEN];
+    snprintf(ep, sizeof ep, "%s", "sh@x.com");
+    db_add_user(ep, P);
+    db_user_set_role_publisher(P);
+
+    int fd = tu_make_blob("./.tmp_blob_sh.dcm", "shard-handles");
+    EXPECT_TRUE(fd >= 0);
+    uint8_t D[DB_ID_SIZE] = {0};
+    EXPECT_EQ_RC(db_data_add_from_fd(P, fd, "x/bin", D), 0);
+
+    /* no named temps left in objects/sha256 */
+    char base[PATH_MAX + 64];
+    snprintf(base, sizeof base, "%s/objects/sha256", ctx.root);
+    DIR           *dir   = opendir(base);
+    int            temps = 0;
+    struct dirent *e;
+    while(dir && (e = readdir(dir)))
+        if(strncmp(e->d_name, ".ingest.", 8) == 0)
+            temps++;
+    if(dir)
+        closedir(dir);
+    EXPECT_EQ_INT(temps, 0);
+
+    int      ofd = -1;
+    DataMeta m   = {0};
+    Sha256   d;
+    EXPECT_EQ_RC(db_data_open(D, &ofd), 0);
+    EXPECT_EQ_RC(db_data_get_meta(D, &m), 0);
+    EXPECT_EQ_RC(crypt_sha256_fd(ofd, &d, NULL), 0);
+    EXPECT_TRUE(memcmp(d.b, m.sha, 32) == 0);
+    if(ofd >= 0)
+        close(ofd);
+
+    EXPECT_EQ_RC(db_data_delete(P, D), 0);
+    EXPECT_EQ_RC(db_data_open(D, &ofd), -ENOENT);
+
+    close(fd);
+    unlink("./.tmp_blob_sh.dcm");
+    tu_teardown_store(&ctx);
+    return 0;
+}
+
+int t_add_batch_dedup_and_perm(void)
+{
+    Ctx ctx;
+    if(tu_setup_store(&ctx) != 0)
+    {
+        tu_failf(__FILE__, __LINE__, "setup");
+        return -1;
+    }
+
+    uint8_t P[DB_ID_SIZE] = {0}, V[DB_ID_SIZE] = {0};
+    char    ep[DB_EMAIL_MAX_LEN], ev[DB_EMAIL_MAX_LEN];
+    snprintf(ep, sizeof ep, "%s", "batch@x.com");
+    snprintf(ev, sizeof ev, "%s", "batchv@x.com");
+    db_add_user(ep, P);
+    db_add_user(ev, V);
+    db_user_set_role_publisher(P);
+    db_user_set_role_viewer(V);
+
+    /* pre-existing content: item 1 must dedup against it */
+    int     f0 = tu_make_blob("./.tmp_batch_0.dcm", "batch-zero");
+    int     f1 = tu_make_blob("./.tmp_batch_1.dcm", "batch-one");
+    int     f2 = tu_make_blob("./.tmp_batch_2.dcm", "batch-two");
+    int     f3 = tu_make_blob("./.tmp_batch_3.dcm", "batch-zero"); /* dup of 0 */
+    uint8_t E[DB_ID_SIZE] = {0};
+    EXPECT_EQ_RC(db_data_add_from_fd(P, f1, "x/bin", E), 0);
+    lseek(f1, 0, SEEK_SET);
+
+    int         fds[5]   = {f0, f1, f2, f3, -1};
+    const char *mimes[5] = {"a/a", "b/b", "c/c", "d/d", "e/e"};
+    uint8_t     ids[5 * DB_ID_SIZE];
+    int         st[5];
+    EXPECT_EQ_RC(db_data_add_batch(P, 5, fds, mimes, ids, st), 0);
+    EXPECT_EQ_INT(st[0], 0);
+    EXPECT_EQ_INT(st[1], -EEXIST);
+    EXPECT_EQ_INT(st[2], 0);
+    EXPECT_EQ_INT(st[3], -EEXIST);
+    EXPECT_EQ_INT(st[4], -EIO);
+    EXPECT_TRUE(memcmp(ids + 1 * DB_ID_SIZE, E, DB_ID_SIZE) == 0);
+    EXPECT_TRUE(memcmp(ids + 3 * DB_ID_SIZE, ids, DB_ID_SIZE) == 0);
+
+    DataMeta m = {0};
+    EXPECT_EQ_RC(db_data_get_meta(ids + 2 * DB_ID_SIZE, &m), 0);
+    EXPECT_TRUE(strcmp(m.mime, "c/c") == 0);
+    EXPECT_TRUE(m.size == 6 + strlen("batch-two")); /* DICM head + tag */
+
+    /* viewers cannot batch-upload */
+    lseek(f2, 0, SEEK_SET);
+    EXPECT_EQ_RC(db_data_add_batch(V, 1, &f2, NULL, NULL, st), -EPERM);
+
+    close(f0);
+    close(f1);
+    close(f2);
+    close(f3);
+    unlink("./.tmp_batch_0.dcm");
+    unlink("./.tmp_batch_1.dcm");
+    unlink("./.tmp_batch_2.dcm");
+    unlink("./.tmp_batch_3.dcm");
+    tu_teardown_store(&ctx);
+    return 0;
+}
+
+/* DB_DURABILITY=group: a batch costs two syncfs (data, then links) no
+ * matter how many objects it holds, and single ingests still round-trip. */
+int t_group_durability_coalesces(void)
+{
+    setenv("DB_DURABILITY", "group", 1);
+    Ctx ctx;
+    int rc = tu_setup_store(&ctx);
+    unsetenv("DB_DURABILITY");
+    if(rc != 0)
+    {
+        tu_failf(__FILE__, __LINE__, "setup");
+        return -1;
+    }
+
+    uint8_t P[DB_ID_SIZE] = {0};
+    char    ep[DB_EMAIL_MAX_LEN];
+    snprintf(ep, sizeof ep, "%s", "grp@x.com");
+    db_add_user(ep, P);
+    db_user_set_role_publisher(P);
+
+    enum { N = 12 };
+    int     fds[N];
+    int     st[N];
+    uint8_t ids[N * DB_ID_SIZE];
+    char    path[PATH_MAX];
+    for(int i = 0; i < N; ++i)
+    {
+        char tag[32];
+        snprintf(path, sizeof path, "./.tmp_grp_%d.dcm", i);
+        snprintf(tag, sizeof tag, "group-%d", i);
+        fds[i] = tu_make_blob(path, tag);
+        unlink(path);
+        EXPECT_TRUE(fds[i] >= 0);
+    }
+
+    DbIngestStats s0 = {0}, s1 = {0}, s2 = {0};
+    EXPECT_EQ_RC(db_ingest_stats(&s0), 0);
+    EXPECT_EQ_RC(db_data_add_batch(P, N, fds, NULL, ids, st), 0);
+    EXPECT_EQ_RC(db_ingest_stats(&s1), 0);
+    EXPECT_TRUE(s1.objects - s0.objects == N);
+    EXPECT_TRUE(s1.syncs - s0.syncs <= 2);
+
+    for(int i = 0; i < N; ++i)
+    {
+        EXPECT_EQ_INT(st[i], 0);
+        int      ofd = -1;
+        DataMeta m   = {0};
+        Sha256   d;
+        EXPECT_EQ_RC(db_data_open(ids + i * DB_ID_SIZE, &ofd), 0);
+        EXPECT_EQ_RC(db_data_get_meta(ids + i * DB_ID_SIZE, &m), 0);
+        EXPECT_EQ_RC(crypt_sha256_fd(ofd, &d, NULL), 0);
+        EXPECT_TRUE(memcmp(d.b, m.sha, 32) == 0);
+        if(ofd >= 0)
+            close(ofd);
+        close(fds[i]);
+    }
+
+    int     fd = tu_make_blob("./.tmp_grp_one.dcm", "group-single");
+    uint8_t D[DB_ID_SIZE];
+    EXPECT_EQ_RC(db_data_add_from_fd(P, fd, "x/bin", D), 0);
+    EXPECT_EQ_RC(db_ingest_stats(&s2), 0);
+    EXPECT_TRUE(s2.objects - s1.objects == 1);
+    EXPECT_TRUE(s2.syncs - s1.syncs == 2);
+    close(fd);
+    unlink("./.tmp_grp_one.dcm");
+
+    tu_teardown_store(&ctx);
+    return 0;
+}
+
+/* DB_DEDUP_HASH_FIRST: re-uploading indexed content writes nothing and is
+ * counted; a missing blob is rewritten even though the index knows it. */
+int t_hash_first_dedup_skips_write(void)
+{
+    setenv("DB_DEDUP_HASH_FIRST", "1", 1);
+    Ctx ctx;
+    int rc = tu_setup_store(&ctx);
+    unsetenv("DB_DEDUP_HASH_FIRST");
+    if(rc != 0)
+    {
+        tu_failf(__FILE__, __LINE__, "setup");
+        return -1;
+    }
+
+    uint8_t P[DB_ID_SIZE] = {0};
+    char    ep[DB_EMAIL_MAX_LEN];
+    snprintf(ep, sizeof ep, "%s", "hf@x.com");
+    db_add_user(ep, P);
+    db_user_set_role_publisher(P);
+
+    int fa = tu_make_blob("./.tmp_hf_a.dcm", "hash-first-payload");
+    int fb = tu_make_blob("./.tmp_hf_b.dcm", "hash-first-payload");
+    EXPECT_TRUE(fa >= 0 && fb >= 0);
+    size_t len = 6 + strlen("hash-first-payload");
+
+    DbIngestStats s0 = {0}, s1 = {0}, s2 = {0};
+    uint8_t       D[DB_ID_SIZE] = {0}, D2[DB_ID_SIZE] = {0};
+    EXPECT_EQ_RC(db_data_add_from_fd(P, fa, "x/bin", D), 0);
+    EXPECT_EQ_RC(db_ingest_stats(&s0), 0);
+    EXPECT_TRUE(s0.dedup_bytes_saved == 0);
+
+    /* same bytes from another file: hit, nothing written, offset consumed */
+    EXPECT_EQ_RC(db_data_add_from_fd(P, fb, "x/bin", D2), -EEXIST);
+    EXPECT_EQ_RC(db_ingest_stats(&s1), 0);
+    EXPECT_TRUE(s1.dedup_bytes_saved - s0.dedup_bytes_saved == len);
+    EXPECT_TRUE(s1.objects == s0.objects);
+    EXPECT_TRUE(lseek(fb, 0, SEEK_CUR) == (off_t)len);
+
+    /* blob lost behind the index's back: stored again, not skipped */
+    char path[PATH_MAX];
+    EXPECT_EQ_RC(db_data_get_path(D, path, sizeof path), 0);
+    EXPECT_TRUE(unlink(path) == 0);
+    lseek(fb, 0, SEEK_SET);
+    EXPECT_EQ_RC(db_data_add_from_fd(P, fb, "x/bin", D2), -EEXIST);
+    EXPECT_EQ_RC(db_ingest_stats(&s2), 0);
+    EXPECT_TRUE(s2.dedup_bytes_saved == s1.dedup_bytes_saved);
+    EXPECT_TRUE(s2.objects == s1.objects + 1);
+    EXPECT_TRUE(access(path, F_OK) == 0);
+
+    close(fa);
+    close(fb);
+    unlink("./.tmp_hf_a.dcm");
+    unlink("./.tmp_hf_b.dcm");
+    tu_teardown_store(&ctx);
+    return 0;
+}
+
+/* Batch follows the same rule: a hit only for the owner's own record. */
+int t_dedup_batch_refcounts_per_owner(void)
+{
+    Ctx ctx;
+    if(tu_setup_store(&ctx) != 0)
+    {
+        tu_failf(__FILE__, __LINE__, "setup failed");
+        return -1;
+    }
+
+    uint8_t A[DB_ID_SIZE] = {0}, B[DB_ID_SIZE] = {0};
+    char    ea[DB_EMAIL_MAX_LEN], eb[DB_EMAIL_MAX_LEN];
+    snprintf(ea, sizeof ea, "%s", "ba@x.com");
+    snprintf(eb, sizeof eb, "%s", "bb@x.com");
+    db_add_user(ea, A);
+    db_user_set_role_publisher(A);
+    db_add_user(eb, B);
+    db_user_set_role_publisher(B);
+
+    int fd = tu_make_blob("./.tmp_rc_batch.dcm", "refcounted");
+    EXPECT_TRUE(fd >= 0);
+    uint8_t D1[DB_ID_SIZE] = {0};
+    EXPECT_EQ_RC(db_data_add_from_fd(A, fd, NULL, D1), 0);
+
+    /* B: new record; A: its existing record */
+    uint8_t ids[DB_ID_SIZE] = {0};
+    int     st[1]           = {0};
+    lseek(fd, 0, SEEK_SET);
+    EXPECT_EQ_RC(db_data_add_batch(B, 1, &fd, NULL, ids, st), 0);
+    EXPECT_EQ_RC(st[0], 0);
+    EXPECT_TRUE(memcmp(ids, D1, DB_ID_SIZE) != 0);
+
+    uint8_t ida[DB_ID_SIZE] = {0};
+    lseek(fd, 0, SEEK_SET);
+    EXPECT_EQ_RC(db_data_add_batch(A, 1, &fd, NULL, ida, st), 0);
+    EXPECT_EQ_RC(st[0], -EEXIST);
+    EXPECT_TRUE(memcmp(ida, D1, DB_ID_SIZE) == 0);
+
+    /* deleting in either order keeps the blob until the last one */
+    char path[PATH_MAX];
+    EXPECT_EQ_RC(db_data_get_path(D1, path, sizeof path), 0);
+    EXPECT_EQ_RC(db_data_delete(B, ids), 0);
+    EXPECT_TRUE(access(path, F_OK) == 0);
+    EXPECT_EQ_RC(db_data_delete(A, D1), 0);
+    EXPECT_TRUE(access(path, F_OK) != 0);
+
+    close(fd);
+    unlink("./.tmp_rc_batch.dcm");
+    tu_teardown_store(&ctx);
+    return 0;
+}
+
+/* Serving path: ACL-gated open with ranges, and sendfile straight out. */
+int t_open_for_acl_and_range(void)
+{
+    Ctx ctx;
+    if(tu_setup_store(&ctx) != 0)
+    {
+        tu_failf(__FILE__, __LINE__, "setup failed");
+        return -1;
+    }
+
+    uint8_t A[DB_ID_SIZE] = {0}, V[DB_ID_SIZE] = {0}, X[DB_ID_SIZE] = {0};
+    char    ea[DB_EMAIL_MAX_LEN], ev[DB_EMAIL_MAX_LEN], ex[DB_EMAIL_MAX_LEN];
+    snprintf(ea, sizeof ea, "%s", "srv_a@x.com");
+    snprintf(ev, sizeof ev, "%s", "srv_v@x.com");
+    snprintf(ex, sizeof ex, "%s", "srv_x@x.com");
+    db_add_user(ea, A);
+    db_add_user(ev, V);
+    db_add_user(ex, X);
+    db_user_set_role_publisher(A);
+
+    int fd = tu_make_blob("./.tmp_serve.dcm", "0123456789");
+    EXPECT_TRUE(fd >= 0);
+    uint8_t D[DB_ID_SIZE] = {0};
+    EXPECT_EQ_RC(db_data_add_from_fd(A, fd, "application/dicom", D), 0);
+    close(fd);
+    unlink("./.tmp_serve.dcm");
+    EXPECT_EQ_RC(db_user_share_data_with_user_email(A, D, ev), 0);
+
+    /* owner: whole blob plus meta */
+    DataMeta m;
+    int      rfd = -1;
+    EXPECT_EQ_RC(db_data_open_for(A, D, &rfd, &m), 0);
+    EXPECT_TRUE(m.size == 16);
+    EXPECT_TRUE(strcmp(m.mime, "application/dicom") == 0);
+    close(rfd);
+
+    /* viewer: range, fd positioned at the first byte */
+    uint64_t n = 0;
+    char     buf[16];
+    EXPECT_EQ_RC(db_data_open_range_for(V, D, 8, 4, &rfd, NULL, &n), 0);
+    EXPECT_TRUE(n == 4);
+    EXPECT_TRUE(read(rfd, buf, 4) == 4 && memcmp(buf, "2345", 4) == 0);
+    close(rfd);
+
+    /* clipped and out-of-range requests */
+    EXPECT_EQ_RC(db_data_open_range_for(V, D, 12, 100, &rfd, NULL, &n), 0);
+    EXPECT_TRUE(n == 4);
+    close(rfd);
+    EXPECT_EQ_RC(db_data_open_range_for(V, D, 17, 0, &rfd, NULL, &n), -ERANGE);
+
+    /* no relation: indistinguishable from a missing id */
+    EXPECT_EQ_RC(db_data_open_for(X, D, &rfd, NULL), -ENOENT);
+    EXPECT_EQ_RC(db_data_send_for(X, D, 0, 0, STDERR_FILENO, NULL), -ENOENT);
+
+    /* sendfile into a pipe */
+    int pp[2];
+    EXPECT_TRUE(pipe(pp) == 0);
+    uint64_t sent = 0;
+    EXPECT_EQ_RC(db_data_send_for(V, D, 6, 5, pp[1], &sent), 0);
+    EXPECT_TRUE(sent == 5);
+    EXPECT_TRUE(read(pp[0], buf, sizeof buf) == 5 &&
+                memcmp(buf, "01234", 5) == 0);
+    close(pp[0]);
+    close(pp[1]);
+
+    /* deleted: gone for everyone */
+    EXPECT_EQ_RC(db_data_delete(A, D), 0);
+    EXPECT_EQ_RC(db_data_open_for(V, D, &rfd, NULL), -ENOENT);
+
+    tu_teardown_store(&ctx);
+    return 0;
+}
+
+/* Batch meta/path lookups match the single-id calls, in input order. */
+int t_get_metas_and_paths_batch(void)
+{
+    Ctx ctx;
+    if(tu_setup_store(&ctx) != 0)
+    {
+        tu_failf(__FILE__, __LINE__, "setup failed");
+        return -1;
+    }
+    uint8_t P[DB_ID_SIZE] = {0};
+    char    ep[DB_EMAIL_MAX_LEN];
+    snprintf(ep, sizeof ep, "%s", "gallery@x.com");
+    db_add_user(ep, P);
+    db_user_set_role_publisher(P);
+
+    uint8_t D[3][DB_ID_SIZE];
+    for(int i = 0; i < 3; ++i)
+    {
+        char path[64], tag[16];
+        snprintf(path, sizeof path, "./.tmp_gal_%d.dcm", i);
+        snprintf(tag, sizeof tag, "thumb-%d", i);
+        int fd = tu_make_blob(path, tag);
+        EXPECT_TRUE(fd >= 0);
+        EXPECT_EQ_RC(db_data_add_from_fd(P, fd, "image/jpeg", D[i]), 0);
+        close(fd);
+        unlink(path);
+    }
+
+    /* out of key order, a missing id and a repeat */
+    uint8_t ids[5 * DB_ID_SIZE];
+    memcpy(ids + 0 * DB_ID_SIZE, D[2], DB_ID_SIZE);
+    memset(ids + 1 * DB_ID_SIZE, 0xAB, DB_ID_SIZE);
+    memcpy(ids + 2 * DB_ID_SIZE, D[0], DB_ID_SIZE);
+    memcpy(ids + 3 * DB_ID_SIZE, D[2], DB_ID_SIZE);
+    memcpy(ids + 4 * DB_ID_SIZE, D[1], DB_ID_SIZE);
+    const int want[5] = {2, -1, 0, 2, 1};
+
+    DataMeta metas[5];
+    int      st[5];
+    EXPECT_EQ_RC(db_data_get_metas(5, ids, metas, st), 0);
+    static char paths[5][PATH_MAX];
+    int         pst[5];
+    EXPECT_EQ_RC(db_data_get_paths(5, ids, &paths[0][0], PATH_MAX, pst), 0);
+    for(int i = 0; i < 5; ++i)
+    {
+        if(want[i] < 0)
+        {
+            EXPECT_EQ_RC(st[i], -ENOENT);
+            EXPECT_EQ_RC(pst[i], -ENOENT);
+            continue;
+        }
+        DataMeta m;
+        char     p[PATH_MAX];
+        EXPECT_EQ_RC(st[i], 0);
+        EXPECT_EQ_RC(pst[i], 0);
+        EXPECT_EQ_RC(db_data_get_meta(D[want[i]], &m), 0);
+        EXPECT_TRUE(memcmp(&m, &metas[i], sizeof m) == 0);
+        EXPECT_EQ_RC(db_data_get_path(D[want[i]], p, sizeof p), 0);
+        EXPECT_TRUE(strcmp(p, paths[i]) == 0);
+        EXPECT_TRUE(access(paths[i], F_OK) == 0);
+    }
+
+    /* slot too small for a path */
+    char small[2][32];
+    EXPECT_EQ_RC(db_data_get_paths(2, ids, &small[0][0], sizeof small[0], pst),
+                 0);
+    EXPECT_EQ_RC(pst[0], -ENAMETOOLONG);
+    EXPECT_EQ_RC(pst[1], -ENOENT);
+
+    EXPECT_EQ_RC(db_data_get_metas(0, ids, metas, st), -EINVAL);
+
+    tu_teardown_store(&ctx);
+    return 0;
+}
+
+/* v0 meta records (MIME inline) stay readable next to interned ones, and
+ * the upgrade pass rewrites them without changing what readers see. */
+int t_mime_interned_and_v0_upgrade(void)
+{
+    setenv("DB_META_INLINE_MIME", "1", 1);
+    Ctx ctx;
+    int rc = tu_setup_store(&ctx);
+    unsetenv("DB_META_INLINE_MIME");
+    if(rc != 0)
+    {
+        tu_failf(__FILE__, __LINE__, "setup failed");
+        return -1;
+    }
+    uint8_t P[DB_ID_SIZE] = {0};
+    char    ep[DB_EMAIL_MAX_LEN];
+    snprintf(ep, sizeof ep, "%s", "mime@x.com");
+    db_add_user(ep, P);
+    db_user_set_role_publisher(P);
+
+    const char *mimes[4] = {"image/png", "application/dicom", NULL,
+                            "application/vnd.some-very-long-vendor-type+json"};
+    uint8_t     D[4][DB_ID_SIZE];
+    for(int i = 0; i < 4; ++i)
+    {
+        /* first two written as v0 records, the rest after reopening */
+        if(i == 2)
+        {
+            db_close();
+            EXPECT_EQ_RC(db_open(ctx.root, 256ULL << 20), 0);
+        }
+        char path[64], tag[16];
+        snprintf(path, sizeof path, "./.tmp_mime_%d.dcm", i);
+        snprintf(tag, sizeof tag, "mime-%d", i);
+        int fd = tu_make_blob(path, tag);
+        EXPECT_TRUE(fd >= 0);
+        EXPECT_EQ_RC(db_data_add_from_fd(P, fd, mimes[i], D[i]), 0);
+        close(fd);
+        unlink(path);
+    }
+
+    const char *want[4] = {"image/png", "application/dicom",
+                           "application/octet-stream", mimes[3]};
+    DataMeta    before[4];
+    for(int i = 0; i < 4; ++i)
+    {
+        EXPECT_EQ_RC(db_data_get_meta(D[i], &before[i]), 0);
+        EXPECT_TRUE(strncmp(before[i].mime, want[i], 31) == 0);
+        EXPECT_TRUE(memcmp(before[i].owner, P, DB_ID_SIZE) == 0);
+        /* the record version alone: no placement or digest bits */
+        EXPECT_TRUE(before[i].ver == (i < 2 ? 0 : 1));
+    }
+    EXPECT_TRUE(strlen(before[3].mime) == 31);
+
+    size_t up = 0;
+    EXPECT_EQ_RC(db_data_upgrade_metas(1, &up), 0);
+    EXPECT_TRUE(up == 1);
+    EXPECT_EQ_RC(db_data_upgrade_metas(0, &up), 0);
+    EXPECT_TRUE(up == 1);
+    EXPECT_EQ_RC(db_data_upgrade_metas(0, &up), 0);
+    EXPECT_TRUE(up == 0);
+
+    /* same content after the rewrite, also through a fresh cache */
+    db_close();
+    EXPECT_EQ_RC(db_open(ctx.root, 256ULL << 20), 0);
+    DataMeta after[4];
+    int      st[4];
+    EXPECT_EQ_RC(db_data_get_metas(4, &D[0][0], after, st), 0);
+    for(int i = 0; i < 4; ++i)
+    {
+        EXPECT_EQ_RC(st[i], 0);
+        EXPECT_TRUE(strcmp(after[i].mime, before[i].mime) == 0);
+        EXPECT_TRUE(memcmp(after[i].sha, before[i].sha, 32) == 0);
+        EXPECT_TRUE(after[i].size == before[i].size);
+        EXPECT_TRUE(after[i].created_at == before[i].created_at);
+        EXPECT_TRUE(memcmp(after[i].owner, before[i].owner, DB_ID_SIZE) == 0);
+        EXPECT_TRUE(after[i].ver == 1 && after[i].flags == before[i].flags);
+    }
+
+    tu_teardown_store(&ctx);
+    return 0;
+}
+
+/* A store an older build wrote to: drop the first row of both owner
+   indexes and the schema marker, behind the closed store's back. */
+static int owner_index_make_stale(const char *root)
+{
+    char dir[PATH_MAX + 8];
+    snprintf(dir, sizeof dir, "%s/meta", root);
+    MDB_env *env = NULL;
+    MDB_txn *txn = NULL;
+    int      rc  = mdb_env_create(&env);
+    if(rc == MDB_SUCCESS)
+        rc = mdb_env_set_maxdbs(env, 32);
+    if(rc == MDB_SUCCESS)
+        rc = mdb_env_set_mapsize(env, 256ULL << 20);
+    if(rc == MDB_SUCCESS)
+        rc = mdb_env_open(env, dir, 0, 0770);
+    if(rc == MDB_SUCCESS)
+        rc = mdb_txn_begin(env, NULL, 0, &txn);
+    const char *names[2] = {"data_owner_time", "data_owner_sha"};
+    for(int i = 0; i < 2 && rc == MDB_SUCCESS; ++i)
+    {
+        MDB_dbi     dbi;
+        MDB_cursor *cur = NULL;
+        MDB_val     k, v;
+        rc = mdb_dbi_open(txn, names[i], 0, &dbi);
+        if(rc == MDB_SUCCESS)
+            rc = mdb_cursor_open(txn, dbi, &cur);
+        if(rc == MDB_SUCCESS)
+            rc = mdb_cursor_get(cur, &k, &v, MDB_FIRST);
+        if(rc == MDB_SUCCESS)
+            rc = mdb_cursor_del(cur, 0);
+        mdb_cursor_close(cur);
+    }
+    MDB_dbi conf;
+    if(rc == MDB_SUCCESS)
+        rc = mdb_dbi_open(txn, "store_conf", 0, &conf);
+    if(rc == MDB_SUCCESS)
+    {
+        MDB_val k = {.mv_size = 6, .mv_data = "schema"};
+        rc        = mdb_del(txn, conf, &k, NULL);
+        rc        = rc == MDB_NOTFOUND ? MDB_SUCCESS : rc;
+    }
+    if(rc == MDB_SUCCESS)
+        rc = mdb_txn_commit(txn);
+    else if(txn)
+        mdb_txn_abort(txn);
+    mdb_env_close(env);
+    return rc;
+}
+
+/* Owner listing pages newest-first, resumes from the token, drops deleted
+ * items and never shows another owner's uploads. */
+int t_list_by_owner_newest_first(void)
+{
+    Ctx ctx;
+    if(tu_setup_store(&ctx) != 0)
+    {
+        tu_failf(__FILE__, __LINE__, "setup failed");
+        return -1;
+    }
+    uint8_t A[DB_ID_SIZE] = {0}, B[DB_ID_SIZE] = {0};
+    char    ea[DB_EMAIL_MAX_LEN], eb[DB_EMAIL_MAX_LEN];
+    snprintf(ea, sizeof ea, "%s", "lister_a@x.com");
+    snprintf(eb, sizeof eb, "%s", "lister_b@x.com");
+    db_add_user(ea, A);
+    db_add_user(eb, B);
+    db_user_set_role_publisher(A);
+    db_user_set_role_publisher(B);
+
+    enum { N = 5 };
+    uint8_t D[N][DB_ID_SIZE], E[DB_ID_SIZE];
+    for(int i = 0; i < N + 1; ++i)
+    {
+        char path[64], tag[16];
+        snprintf(path, sizeof path, "./.tmp_list_%d.dcm", i);
+        snprintf(tag, sizeof tag, "mine-%d", i);
+        int fd = tu_make_blob(path, tag);
+        EXPECT_TRUE(fd >= 0);
+        EXPECT_EQ_RC(db_data_add_from_fd(i < N ? A : B, fd, "image/jpeg",
+                                         i < N ? D[i] : E),
+                     0);
+        close(fd);
+        unlink(path);
+    }
+
+    /* pages of 2: D4 D3 | D2 D1 | D0 */
+    uint8_t tok[DB_PAGE_TOKEN_SIZE] = {0};
+    uint8_t got[N * DB_ID_SIZE];
+    size_t  total = 0;
+    for(;;)
+    {
+        size_t cnt = 2;
+        EXPECT_EQ_RC(db_data_list_by_owner(A, tok, got + total * DB_ID_SIZE,
+                                           &cnt),
+                     0);
+        total += cnt;
+        if(cnt < 2 || total >= N)
+            break;
+    }
+    EXPECT_TRUE(total == N);
+    for(int i = 0; i < N; ++i)
+        EXPECT_TRUE(memcmp(got + i * DB_ID_SIZE, D[N - 1 - i], DB_ID_SIZE) ==
+                    0);
+
+    /* past the end: empty page */
+    size_t cnt = 2;
+    EXPECT_EQ_RC(db_data_list_by_owner(A, tok, got, &cnt), 0);
+    EXPECT_TRUE(cnt == 0);
+
+    /* delete the newest and a middle one */
+    EXPECT_EQ_RC(db_data_delete(A, D[4]), 0);
+    EXPECT_EQ_RC(db_data_delete(A, D[2]), 0);
+    memset(tok, 0, sizeof tok);
+    cnt = N;
+    EXPECT_EQ_RC(db_data_list_by_owner(A, tok, got, &cnt), 0);
+    EXPECT_TRUE(cnt == 3);
+    EXPECT_TRUE(memcmp(got + 0 * DB_ID_SIZE, D[3], DB_ID_SIZE) == 0);
+    EXPECT_TRUE(memcmp(got + 1 * DB_ID_SIZE, D[1], DB_ID_SIZE) == 0);
+    EXPECT_TRUE(memcmp(got + 2 * DB_ID_SIZE, D[0], DB_ID_SIZE) == 0);
+
+    /* B sees only its own upload */
+    memset(tok, 0, sizeof tok);
+    cnt = N;
+    EXPECT_EQ_RC(db_data_list_by_owner(B, tok, got, &cnt), 0);
+    EXPECT_TRUE(cnt == 1);
+    EXPECT_TRUE(memcmp(got, E, DB_ID_SIZE) == 0);
+
+    EXPECT_EQ_RC(db_data_list_by_owner(NULL, tok, got, &cnt), -EINVAL);
+
+    /* stale (not empty) owner indexes are rebuilt on open */
+    db_close();
+    EXPECT_EQ_RC(owner_index_make_stale(ctx.root), 0);
+    EXPECT_EQ_RC(db_open(ctx.root, 256ULL << 20), 0);
+    memset(tok, 0, sizeof tok);
+    cnt = N;
+    EXPECT_EQ_RC(db_data_list_by_owner(A, tok, got, &cnt), 0);
+    EXPECT_TRUE(cnt == 3);
+    memset(tok, 0, sizeof tok);
+    cnt = N;
+    EXPECT_EQ_RC(db_data_list_by_owner(B, tok, got, &cnt), 0);
+    EXPECT_TRUE(cnt == 1);
+    for(int i = 0; i < N + 1; ++i)
+    {
+        char    path[64], tag[16];
+        uint8_t id[DB_ID_SIZE];
+        if(i == 2 || i == 4)
+            continue; /* deleted above */
+        snprintf(path, sizeof path, "./.tmp_list_%d.dcm", i);
+        snprintf(tag, sizeof tag, "mine-%d", i);
+        int fd = tu_make_blob(path, tag);
+        EXPECT_TRUE(fd >= 0);
+        EXPECT_EQ_RC(db_data_add_from_fd(i < N ? A : B, fd, "image/jpeg", id),
+                     -EEXIST);
+        close(fd);
+        unlink(path);
+    }
+
+    tu_teardown_store(&ctx);
+    return 0;
+}
+
+typedef struct
+{
+    uint8_t ids[8][DB_ID_SIZE];
+    size_t  n;
+    size_t  stop_at; /* stop after this many items (0: never) */
+} ScanAcc;
+
+static int scan_collect(const uint8_t data_id[DB_ID_SIZE], const DataMeta *m,
+                        void *user)
+{
+    ScanAcc *a = user;
+    if(a->n < 8 && strcmp(m->mime, "image/png") == 0)
+        memcpy(a->ids[a->n], data_id, DB_ID_SIZE);
+    a->n++;
+    return a->stop_at && a->n >= a->stop_at;
+}
+
+static uint64_t now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (uint64_t)ts.tv_sec * 1000u + (uint64_t)(ts.tv_nsec / 1000000u);
+}
+
+/* Time-range scans visit exactly the uploads made inside [t0, t1), in
+ * upload order, page by page, and honour an early stop. */
+int t_scan_time_range_pages(void)
+{
+    Ctx ctx;
+    if(tu_setup_store(&ctx) != 0)
+    {
+        tu_failf(__FILE__, __LINE__, "setup failed");
+        return -1;
+    }
+    uint8_t P[DB_ID_SIZE] = {0};
+    char    ep[DB_EMAIL_MAX_LEN];
+    snprintf(ep, sizeof ep, "%s", "scanner@x.com");
+    db_add_user(ep, P);
+    db_user_set_role_publisher(P);
+
+    /* two bursts separated by a clock tick we can name */
+    uint8_t  D[6][DB_ID_SIZE];
+    uint64_t ta = now_ms(), tb = 0;
+    for(int i = 0; i < 6; ++i)
+    {
+        if(i == 3)
+        {
+            usleep(3000);
+            tb = now_ms();
+            usleep(3000);
+        }
+        char path[64], tag[16];
+        snprintf(path, sizeof path, "./.tmp_scan_%d.dcm", i);
+        snprintf(tag, sizeof tag, "scan-%d", i);
+        int fd = tu_make_blob(path, tag);
+        EXPECT_TRUE(fd >= 0);
+        EXPECT_EQ_RC(db_data_add_from_fd(P, fd, "image/png", D[i]), 0);
+        close(fd);
+        unlink(path);
+    }
+    uint64_t tc = now_ms() + 1;
+
+    /* first burst only */
+    uint8_t cur[DB_ID_SIZE] = {0};
+    ScanAcc acc             = {0};
+    size_t  seen            = 0;
+    EXPECT_EQ_RC(
+        db_data_scan_time_range(ta, tb, cur, 16, scan_collect, &acc, &seen), 0);
+    EXPECT_TRUE(seen == 3 && acc.n == 3);
+    for(int i = 0; i < 3; ++i)
+        EXPECT_TRUE(memcmp(acc.ids[i], D[i], DB_ID_SIZE) == 0);
+
+    /* whole range in pages of 4: 4 + 2 */
+    memset(cur, 0, sizeof cur);
+    memset(&acc, 0, sizeof acc);
+    EXPECT_EQ_RC(
+        db_data_scan_time_range(ta, tc, cur, 4, scan_collect, &acc, &seen), 0);
+    EXPECT_TRUE(seen == 4);
+    EXPECT_TRUE(memcmp(cur, D[3], DB_ID_SIZE) == 0);
+    EXPECT_EQ_RC(
+        db_data_scan_time_range(ta, tc, cur, 4, scan_collect, &acc, &seen), 0);
+    EXPECT_TRUE(seen == 2 && acc.n == 6);
+    for(int i = 0; i < 6; ++i)
+        EXPECT_TRUE(memcmp(acc.ids[i], D[i], DB_ID_SIZE) == 0);
+
+    /* early stop, then resume right after the stop point */
+    memset(cur, 0, sizeof cur);
+    memset(&acc, 0, sizeof acc);
+    acc.stop_at = 2;
+    EXPECT_EQ_RC(
+        db_data_scan_time_range(tb, tc, cur, 16, scan_collect, &acc, &seen), 0);
+    EXPECT_TRUE(seen == 2);
+    EXPECT_TRUE(memcmp(cur, D[4], DB_ID_SIZE) == 0);
+    acc.stop_at = 0;
+    EXPECT_EQ_RC(
+        db_data_scan_time_range(tb, tc, cur, 16, scan_collect, &acc, &seen), 0);
+    EXPECT_TRUE(seen == 1 && acc.n == 3);
+    EXPECT_TRUE(memcmp(acc.ids[2], D[5], DB_ID_SIZE) == 0);
+
+    /* deleted data drops out; empty and inverted ranges */
+    EXPECT_EQ_RC(db_data_delete(P, D[1]), 0);
+    memset(cur, 0, sizeof cur);
+    memset(&acc, 0, sizeof acc);
+    EXPECT_EQ_RC(
+        db_data_scan_time_range(ta, tb, cur, 16, scan_collect, &acc, &seen), 0);
+    EXPECT_TRUE(seen == 2);
+    EXPECT_EQ_RC(
+        db_data_scan_time_range(tc, tc, cur, 16, scan_collect, &acc, &seen), 0);
+    EXPECT_TRUE(seen == 0);
+    EXPECT_EQ_RC(
+        db_data_scan_time_range(tc, ta, cur, 16, scan_collect, &acc, &seen),
+        -EINVAL);
+
+    tu_teardown_store(&ctx);
+    return 0;
+}
+
+/* With DB_INLINE_MAX set, small uploads live in LMDB: no object file, no
+ * path, but the same bytes through db_data_read / db_data_open /
+ * db_data_open_for; larger ones still become blobs. Sharing and delete keep
+ * the inline copy refcounted like a blob. */
+int t_inline_small_blobs(void)
+{
+    setenv("DB_INLINE_MAX", "256", 1);
+    Ctx ctx;
+    int rc = tu_setup_store(&ctx);
+    unsetenv("DB_INLINE_MAX");
+    if(rc != 0)
+    {
+        tu_failf(__FILE__, __LINE__, "setup failed");
+        return -1;
+    }
+    uint8_t A[DB_ID_SIZE] = {0}, B[DB_ID_SIZE] = {0};
+    char    ea[DB_EMAIL_MAX_LEN], eb[DB_EMAIL_MAX_LEN];
+    snprintf(ea, sizeof ea, "%s", "inline_a@x.com");
+    snprintf(eb, sizeof eb, "%s", "inline_b@x.com");
+    db_add_user(ea, A);
+    db_add_user(eb, B);
+    db_user_set_role_publisher(A);
+    db_user_set_role_publisher(B);
+
+    char objs[PATH_MAX + 64];
+    snprintf(objs, sizeof objs, "%s/objects/sha256", ctx.root);
+
+    /* small: inline, nothing under objects/ */
+    const char *tag = "structured-report";
+    uint8_t     S[DB_ID_SIZE], S2[DB_ID_SIZE];
+    int         fd = tu_make_blob("./.tmp_inl_small.dcm", tag);
+    EXPECT_TRUE(fd >= 0);
+    EXPECT_EQ_RC(db_data_add_from_fd(A, fd, "application/dicom", S), 0);
+    EXPECT_TRUE(lseek(fd, 0, SEEK_SET) == 0);
+    EXPECT_EQ_RC(db_data_add_from_fd(B, fd, "application/dicom", S2), 0);
+    close(fd);
+    unlink("./.tmp_inl_small.dcm");
+    EXPECT_TRUE(tu_dir_size_bytes(objs) == 0);
+
+    DataMeta m;
+    char     p[PATH_MAX];
+    EXPECT_EQ_RC(db_data_get_meta(S, &m), 0);
+    EXPECT_TRUE(m.flags & DB_DATA_F_INLINE);
+    EXPECT_TRUE(m.size == 6 + strlen(tag));
+    EXPECT_TRUE(strcmp(m.mime, "application/dicom") == 0);
+    EXPECT_EQ_RC(db_data_get_path(S, p, sizeof p), -ENODATA);
+    EXPECT_EQ_RC(db_data_get_meta(S2, &m), 0);
+    EXPECT_TRUE(m.flags & DB_DATA_F_INLINE);
+
+    char   buf[64];
+    size_t got = 0;
+    EXPECT_EQ_RC(db_data_read(S, 0, buf, sizeof buf, &got), 0);
+    EXPECT_TRUE(got == m.size && memcmp(buf, "DICM", 4) == 0 &&
+                memcmp(buf + 6, tag, strlen(tag)) == 0);
+    EXPECT_EQ_RC(db_data_read(S, 6, buf, 4, &got), 0);
+    EXPECT_TRUE(got == 4 && memcmp(buf, tag, 4) == 0);
+    EXPECT_EQ_RC(db_data_read(S, m.size + 1, buf, 4, &got), -ERANGE);
+
+    /* fd-based readers get a memfd with the same bytes */
+    int      ofd = -1;
+    uint64_t len = 0;
+    EXPECT_EQ_RC(db_data_open(S, &ofd), 0);
+    EXPECT_TRUE(read(ofd, buf, sizeof buf) == (ssize_t)m.size);
+    close(ofd);
+    EXPECT_EQ_RC(db_data_open_range_for(B, S2, 6, 0, &ofd, NULL, &len), 0);
+    EXPECT_TRUE(len == strlen(tag));
+    EXPECT_TRUE(read(ofd, buf, sizeof buf) == (ssize_t)len &&
+                memcmp(buf, tag, len) == 0);
+    close(ofd);
+
+    /* above the threshold: a regular blob */
+    uint8_t L[DB_ID_SIZE];
+    fd = open("./.tmp_inl_large.dcm", O_CREAT | O_RDWR | O_TRUNC, 0640);
+    EXPECT_TRUE(fd >= 0);
+    char big[1024];
+    memset(big, 'L', sizeof big);
+    EXPECT_TRUE(write(fd, big, sizeof big) == (ssize_t)sizeof big);
+    EXPECT_TRUE(lseek(fd, 0, SEEK_SET) == 0);
+    EXPECT_EQ_RC(db_data_add_from_fd(A, fd, "application/dicom", L), 0);
+    close(fd);
+    unlink("./.tmp_inl_large.dcm");
+    EXPECT_EQ_RC(db_data_get_meta(L, &m), 0);
+    EXPECT_TRUE(!(m.flags & DB_DATA_F_INLINE));
+    EXPECT_EQ_RC(db_data_get_path(L, p, sizeof p), 0);
+    EXPECT_TRUE(tu_dir_size_bytes(objs) == sizeof big);
+    EXPECT_EQ_RC(db_data_read(L, 1000, buf, sizeof buf, &got), 0);
+    EXPECT_TRUE(got == 24 && buf[0] == 'L');
+
+    /* batch: per-item choice, statuses and paths agree */
+    {
+        int     fds[2];
+        int     st[2];
+        char    bp[2][PATH_MAX];
+        uint8_t ids[2 * DB_ID_SIZE];
+        fds[0] = tu_make_blob("./.tmp_inl_b0.dcm", "batch-small");
+        fds[1] = open("./.tmp_inl_b1.dcm", O_CREAT | O_RDWR | O_TRUNC, 0640);
+        EXPECT_TRUE(fds[0] >= 0 && fds[1] >= 0);
+        memset(big, 'M', sizeof big);
+        EXPECT_TRUE(write(fds[1], big, sizeof big) == (ssize_t)sizeof big);
+        EXPECT_TRUE(lseek(fds[1], 0, SEEK_SET) == 0);
+        EXPECT_EQ_RC(db_data_add_batch(A, 2, fds, NULL, ids, st), 0);
+        EXPECT_EQ_RC(st[0], 0);
+        EXPECT_EQ_RC(st[1], 0);
+        close(fds[0]);
+        close(fds[1]);
+        unlink("./.tmp_inl_b0.dcm");
+        unlink("./.tmp_inl_b1.dcm");
+        EXPECT_EQ_RC(db_data_get_paths(2, ids, &bp[0][0], PATH_MAX, st), 0);
+        EXPECT_EQ_RC(st[0], -ENODATA);
+        EXPECT_EQ_RC(st[1], 0);
+        EXPECT_EQ_RC(db_data_read(ids, 0, buf, sizeof buf, &got), 0);
+        EXPECT_TRUE(got == 6 + strlen("batch-small"));
+    }
+
+    /* inlining off: a blob-path upload of inline content reuses the
+       inline copy and publishes nothing */
+    {
+        db_close();
+        EXPECT_EQ_RC(db_open(ctx.root, 256ULL << 20), 0);
+        uint8_t C[DB_ID_SIZE] = {0}, S3[DB_ID_SIZE];
+        char    ec[DB_EMAIL_MAX_LEN];
+        snprintf(ec, sizeof ec, "%s", "inline_c@x.com");
+        EXPECT_EQ_RC(db_add_user(ec, C), 0);
+        EXPECT_EQ_RC(db_user_set_role_publisher(C), 0);
+        uint64_t before = tu_dir_size_bytes(objs);
+        fd              = tu_make_blob("./.tmp_inl_again.dcm", tag);
+        EXPECT_TRUE(fd >= 0);
+        EXPECT_EQ_RC(db_data_add_from_fd(C, fd, "application/dicom", S3), 0);
+        close(fd);
+        unlink("./.tmp_inl_again.dcm");
+        EXPECT_TRUE(tu_dir_size_bytes(objs) == before);
+        EXPECT_EQ_RC(db_data_get_meta(S3, &m), 0);
+        EXPECT_TRUE(m.flags & DB_DATA_F_INLINE);
+        EXPECT_EQ_RC(db_data_delete(C, S3), 0);
+    }
+
+    /* the inline copy goes with its last reference */
+    EXPECT_EQ_RC(db_data_delete(A, S), 0);
+    EXPECT_EQ_RC(db_data_read(S2, 0, buf, sizeof buf, &got), 0);
+    EXPECT_EQ_RC(db_data_delete(B, S2), 0);
+    EXPECT_EQ_RC(db_data_read(S2, 0, buf, sizeof buf, &got), -ENOENT);
+
+    tu_teardown_store(&ctx);
+    return 0;
+}
+
+int t_pack_files_and_repack(void)
+{
+    setenv("DB_PACK_MAX", "4096", 1);
+    setenv("DB_PACK_SEGMENT_KB", "8", 1);
+    Ctx ctx;
+    int rc = tu_setup_store(&ctx);
+    unsetenv("DB_PACK_MAX");
+    unsetenv("DB_PACK_SEGMENT_KB");
+    if(rc != 0)
+    {
+        tu_failf(__FILE__, __LINE__, "setup failed");
+        return -1;
+    }
+    uint8_t A[DB_ID_SIZE] = {0}, B[DB_ID_SIZE] = {0};
+    char    ea[DB_EMAIL_MAX_LEN], eb[DB_EMAIL_MAX_LEN];
+    snprintf(ea, sizeof ea, "%s", "pack_a@x.com");
+    snprintf(eb, sizeof eb, "%s", "pack_b@x.com");
+    db_add_user(ea, A);
+    db_add_user(eb, B);
+    db_user_set_role_publisher(A);
+    db_user_set_role_publisher(B);
+
+    char objs[PATH_MAX + 64], packs[PATH_MAX + 64];
+    snprintf(objs, sizeof objs, "%s/objects/sha256", ctx.root);
+    snprintf(packs, sizeof packs, "%s/objects/packs", ctx.root);
+    EXPECT_TRUE(access(packs, F_OK) != 0); /* made by the first append */
+
+    /* 24 distinct 1000-byte objects: three 8 KiB packs, no blob files */
+    enum { N = 24, SZ = 1000 };
+    uint8_t ids[N][DB_ID_SIZE];
+    char    body[SZ];
+    for(int i = 0; i < N; ++i)
+    {
+        memset(body, 'a' + i, sizeof body);
+        int fd = open("./.tmp_pack.bin", O_CREAT | O_RDWR | O_TRUNC, 0640);
+        EXPECT_TRUE(fd >= 0);
+        EXPECT_TRUE(write(fd, body, sizeof body) == (ssize_t)sizeof body);
+        EXPECT_TRUE(lseek(fd, 0, SEEK_SET) == 0);
+        EXPECT_EQ_RC(db_data_add_from_fd(A, fd, "application/dicom", ids[i]),
+                     0);
+        close(fd);
+    }
+    unlink("./.tmp_pack.bin");
+    EXPECT_TRUE(tu_dir_size_bytes(objs) == 0);
+    EXPECT_TRUE(tu_dir_size_bytes(packs) == (uint64_t)N * SZ);
+
+    DataMeta m;
+    char     p[PATH_MAX];
+    char     buf[SZ + 8];
+    size_t   got = 0;
+    EXPECT_EQ_RC(db_data_get_meta(ids[5], &m), 0);
+    EXPECT_TRUE((m.flags & DB_DATA_F_PACKED) && !(m.flags & DB_DATA_F_INLINE));
+    EXPECT_TRUE(m.size == SZ);
+    EXPECT_EQ_RC(db_data_get_path(ids[5], p, sizeof p), -ENODATA);
+    EXPECT_EQ_RC(db_data_read(ids[5], 10, buf, 16, &got), 0);
+    EXPECT_TRUE(got == 16 && buf[0] == 'a' + 5 && buf[15] == 'a' + 5);
+
+    /* a second owner of the same bytes references the packed copy */
+    uint8_t S[DB_ID_SIZE];
+    {
+        memset(body, 'a' + 17, sizeof body);
+        int fd = open("./.tmp_pack.bin", O_CREAT | O_RDWR | O_TRUNC, 0640);
+        EXPECT_TRUE(fd >= 0);
+        EXPECT_TRUE(write(fd, body, sizeof body) == (ssize_t)sizeof body);
+        EXPECT_TRUE(lseek(fd, 0, SEEK_SET) == 0);
+        EXPECT_EQ_RC(db_data_add_from_fd(B, fd, "application/dicom", S), 0);
+        close(fd);
+        unlink("./.tmp_pack.bin");
+    }
+    EXPECT_EQ_RC(db_data_get_meta(S, &m), 0);
+    EXPECT_TRUE(m.flags & DB_DATA_F_PACKED);
+    EXPECT_TRUE(tu_dir_size_bytes(packs) == (uint64_t)N * SZ);
+
+    /* keep one object per pack (and the shared one), delete the rest */
+    for(int i = 0; i < N; ++i)
+        if(i != 0 && i != 9 && i != 17 && i != 23)
+            EXPECT_EQ_RC(db_data_delete(A, ids[i]), 0);
+    EXPECT_EQ_RC(db_data_delete(A, ids[17]), 0); /* B still holds it */
+
+    /* sealed packs 1 and 2 are 7/8 dead: their survivors move to the open
+       pack (which rolls over), the files go on the next pass; pack 3 is 3/4
+       dead, under the threshold */
+    uint64_t reclaimed = 0;
+    EXPECT_EQ_RC(db_data_repack(80, &reclaimed), 0);
+    EXPECT_TRUE(reclaimed == 14u * SZ);
+    EXPECT_EQ_RC(db_data_repack(80, &reclaimed), 0);
+    EXPECT_TRUE(reclaimed == 0);
+    EXPECT_TRUE(tu_dir_size_bytes(packs) == 10u * SZ);
+
+    const int keep[] = {0, 9, 23};
+    for(size_t k = 0; k < sizeof keep / sizeof keep[0]; ++k)
+    {
+        EXPECT_EQ_RC(db_data_read(ids[keep[k]], 0, buf, sizeof buf, &got), 0);
+        EXPECT_TRUE(got == SZ && buf[0] == 'a' + keep[k] &&
+                    buf[SZ - 1] == 'a' + keep[k]);
+    }
+    int ofd = -1;
+    EXPECT_EQ_RC(db_data_open_for(B, S, &ofd, &m), 0);
+    EXPECT_TRUE(read(ofd, buf, sizeof buf) == SZ && buf[0] == 'a' + 17);
+    close(ofd);
+
+    /* batch: packed items share one sync and read back */
+    {
+        int     fds[2];
+        int     st[2];
+        uint8_t bids[2 * DB_ID_SIZE];
+        for(int i = 0; i < 2; ++i)
+        {
+            char name[32];
+            snprintf(name, sizeof name, "./.tmp_pack_b%d.bin", i);
+            memset(body, 'A' + i, sizeof body);
+            fds[i] = open(name, O_CREAT | O_RDWR | O_TRUNC, 0640);
+            EXPECT_TRUE(fds[i] >= 0);
+            EXPECT_TRUE(write(fds[i], body, sizeof body) ==
+                        (ssize_t)sizeof body);
+            EXPECT_TRUE(lseek(fds[i], 0, SEEK_SET) == 0);
+            unlink(name);
+        }
+        EXPECT_EQ_RC(db_data_add_batch(A, 2, fds, NULL, bids, st), 0);
+        close(fds[0]);
+        close(fds[1]);
+        EXPECT_EQ_RC(st[0], 0);
+        EXPECT_EQ_RC(st[1], 0);
+        EXPECT_EQ_RC(db_data_read(bids + DB_ID_SIZE, 0, buf, sizeof buf,
+                                  &got),
+                     0);
+        EXPECT_TRUE(got == SZ && buf[0] == 'B');
+        EXPECT_TRUE(tu_dir_size_bytes(objs) == 0);
+    }
+
+    tu_teardown_store(&ctx);
+    return 0;
+}
+
+/* DB_COMPRESS=zlib: compressible blobs are stored deflated under the digest
+ * of their plain bytes and read back plain; incompressible ones stay raw. */
+int t_compressed_blobs(void)
+{
+#ifndef DB_HAVE_ZLIB
+    return 0; /* built without zlib: DB_COMPRESS is ignored */
+#else
+    setenv("DB_COMPRESS", "zlib", 1);
+    Ctx ctx;
+    int rc = tu_setup_store(&ctx);
+    unsetenv("DB_COMPRESS");
+    if(rc != 0)
+    {
+        tu_failf(__FILE__, __LINE__, "setup failed");
+        return -1;
+    }
+    uint8_t A[DB_ID_SIZE] = {0}, B[DB_ID_SIZE] = {0};
+    char    ea[DB_EMAIL_MAX_LEN], eb[DB_EMAIL_MAX_LEN];
+    snprintf(ea, sizeof ea, "%s", "zlib_a@x.com");
+    snprintf(eb, sizeof eb, "%s", "zlib_b@x.com");
+    db_add_user(ea, A);
+    db_add_user(eb, B);
+    db_user_set_role_publisher(A);
+    db_user_set_role_publisher(B);
+
+    char objs[PATH_MAX + 64];
+    snprintf(objs, sizeof objs, "%s/objects/sha256", ctx.root);
+
+    /* report-like text: compresses well; over three seek spans */
+    const size_t LEN = 3u * 1024u * 1024u + 4321u;
+    char*        txt = malloc(LEN);
+    uint8_t*     rnd = malloc(LEN);
+    char*        out = malloc(LEN);
+    EXPECT_TRUE(txt && rnd && out);
+    for(size_t i = 0; i < LEN; ++i)
+        txt[i] = "Study 1.2.840 series CT axial report line\n"[i % 42];
+    EXPECT_EQ_RC(crypt_rand_bytes(rnd, LEN), 0);
+
+    uint8_t T[DB_ID_SIZE], R[DB_ID_SIZE];
+    int     fd = open("./.tmp_zlib.bin", O_CREAT | O_RDWR | O_TRUNC, 0640);
+    EXPECT_TRUE(fd >= 0);
+    EXPECT_TRUE(write(fd, txt, LEN) == (ssize_t)LEN);
+    EXPECT_TRUE(lseek(fd, 0, SEEK_SET) == 0);
+    EXPECT_EQ_RC(db_data_add_from_fd(A, fd, "text/plain", T), 0);
+    close(fd);
+
+    DataMeta m;
+    Sha256   d;
+    char     p[PATH_MAX];
+    EXPECT_EQ_RC(db_data_get_meta(T, &m), 0);
+    EXPECT_TRUE(m.flags & DB_DATA_F_ZLIB);
+    EXPECT_EQ_SIZE(m.size, LEN);
+    EXPECT_EQ_RC(crypt_sha256_buf(txt, LEN, &d), 0);
+    EXPECT_TRUE(memcmp(d.b, m.sha, 32) == 0); /* address of the plain bytes */
+    EXPECT_TRUE(tu_dir_size_bytes(objs) < LEN / 4);
+    EXPECT_EQ_RC(db_data_get_path(T, p, sizeof p), -ENODATA);
+
+    size_t got = 0;
+    EXPECT_EQ_RC(db_data_read(T, 100000, out, 4096, &got), 0);
+    EXPECT_TRUE(got == 4096 && memcmp(out, txt + 100000, 4096) == 0);
+    EXPECT_EQ_RC(db_data_read(T, LEN - 10, out, 4096, &got), 0);
+    EXPECT_TRUE(got == 10 && memcmp(out, txt + LEN - 10, 10) == 0);
+    /* across a seek point, and the whole blob front to back */
+    EXPECT_EQ_RC(db_data_read(T, (1u << 20) - 10, out, 4096, &got), 0);
+    EXPECT_TRUE(got == 4096 && memcmp(out, txt + (1u << 20) - 10, 4096) == 0);
+    for(size_t off = 0; off < LEN; off += got)
+    {
+        EXPECT_EQ_RC(db_data_read(T, off, out + off, 65536, &got), 0);
+        EXPECT_TRUE(got > 0);
+    }
+    EXPECT_TRUE(memcmp(out, txt, LEN) == 0);
+
+    int      ofd = -1;
+    uint64_t len = 0;
+    EXPECT_EQ_RC(db_data_open_range_for(A, T, 4096, 0, &ofd, NULL, &len), 0);
+    EXPECT_TRUE(len == LEN - 4096);
+    EXPECT_TRUE(read(ofd, out, LEN) == (ssize_t)len &&
+                memcmp(out, txt + 4096, len) == 0);
+    close(ofd);
+    /* a range past the first spans: only it is inflated */
+    const uint64_t ROFF = 2u * 1024u * 1024u + 77u;
+    EXPECT_EQ_RC(db_data_open_range_for(A, T, ROFF, 1000, &ofd, NULL, &len),
+                 0);
+    EXPECT_TRUE(len == 1000);
+    EXPECT_TRUE(read(ofd, out, 1000) == 1000 &&
+                memcmp(out, txt + ROFF, 1000) == 0);
+    close(ofd);
+    /* streamed through the inflating reader */
+    EXPECT_EQ_RC(db_data_materialize(T, p, sizeof p), 0);
+    EXPECT_EQ_RC(crypt_sha256_file(p, &d, &got), 0);
+    EXPECT_TRUE(got == LEN && memcmp(d.b, m.sha, 32) == 0);
+
+    /* random bytes: the probe says no, the blob is plain */
+    fd = open("./.tmp_zlib.bin", O_CREAT | O_RDWR | O_TRUNC, 0640);
+    EXPECT_TRUE(fd >= 0);
+    EXPECT_TRUE(write(fd, rnd, LEN) == (ssize_t)LEN);
+    EXPECT_TRUE(lseek(fd, 0, SEEK_SET) == 0);
+    EXPECT_EQ_RC(db_data_add_from_fd(A, fd, "x/bin", R), 0);
+    close(fd);
+    unlink("./.tmp_zlib.bin");
+    EXPECT_EQ_RC(db_data_get_meta(R, &m), 0);
+    EXPECT_TRUE(!(m.flags & DB_DATA_F_ZLIB));
+    EXPECT_EQ_RC(db_data_get_path(R, p, sizeof p), 0);
+    EXPECT_EQ_RC(db_data_read(R, 7, out, 64, &got), 0);
+    EXPECT_TRUE(got == 64 && memcmp(out, rnd + 7, 64) == 0);
+
+    /* the same text through a pipe: same address, the second owner's
+       record follows the compressed blob */
+    int pfd[2];
+    EXPECT_TRUE(pipe(pfd) == 0);
+    pid_t pid = fork();
+    if(pid == 0)
+    {
+        close(pfd[0]);
+        size_t off = 0;
+        while(off < LEN)
+        {
+            ssize_t w = write(pfd[1], txt + off, LEN - off);
+            if(w <= 0)
+                _exit(1);
+            off += (size_t)w;
+        }
+        _exit(0);
+    }
+    close(pfd[1]);
+    uint8_t T2[DB_ID_SIZE];
+    EXPECT_EQ_RC(db_data_add_from_fd(B, pfd[0], "text/plain", T2), 0);
+    close(pfd[0]);
+    waitpid(pid, NULL, 0);
+    EXPECT_EQ_RC(db_data_get_meta(T2, &m), 0);
+    EXPECT_TRUE(m.flags & DB_DATA_F_ZLIB);
+    EXPECT_TRUE(memcmp(d.b, m.sha, 32) == 0);
+    EXPECT_EQ_RC(db_data_open(T2, &ofd), 0);
+    EXPECT_TRUE(read(ofd, out, LEN) == (ssize_t)LEN &&
+                memcmp(out, txt, LEN) == 0);
+    close(ofd);
+
+    /* the blob goes with its last reference */
+    EXPECT_EQ_RC(db_data_delete(A, T), 0);
+    EXPECT_EQ_RC(db_data_read(T2, 0, out, 16, &got), 0);
+    EXPECT_EQ_RC(db_data_delete(B, T2), 0);
+    EXPECT_EQ_RC(db_data_delete(A, R), 0);
+    EXPECT_TRUE(tu_dir_size_bytes(objs) == 0);
+
+    free(txt);
+    free(rnd);
+    free(out);
+    tu_teardown_store(&ctx);
+    return 0;
+#endif
+}
+
+/* db_data_stream sink: append to a buffer */
+typedef struct
+{
+    uint8_t* buf;
+    size_t   n;
+} StreamBuf;
+
+static int stream_collect(const void* buf, size_t len, void* user)
+{
+    StreamBuf* sb = (StreamBuf*)user;
+    memcpy(sb->buf + sb->n, buf, len);
+    sb->n += len;
+    return 0;
+}
+
+/* stream_collect that runs two full repacks before its first piece: the
+   segments the stream located must outlive both */
+static int stream_repack(const void* buf, size_t len, void* user)
+{
+    StreamBuf* sb = (StreamBuf*)user;
+    uint64_t   r  = 0;
+    if(sb->n == 0 &&
+       (db_data_repack(0, &r) != 0 || db_data_repack(0, &r) != 0))
+        return -EIO;
+    return stream_collect(buf, len, user);
+}
+
+static int upload_buf(const uint8_t owner[DB_ID_SIZE], const uint8_t* p,
+                      size_t n, uint8_t out_id[DB_ID_SIZE])
+{
+    int fd = open("./.tmp_cdc.bin", O_CREAT | O_RDWR | O_TRUNC, 0640);
+    if(fd < 0)
+        return -EIO;
+    unlink("./.tmp_cdc.bin");
+    int rc = write(fd, p, n) == (ssize_t)n && lseek(fd, 0, SEEK_SET) == 0
+                 ? db_data_add_from_fd((uint8_t*)owner, fd, "application/dicom",
+                                       out_id)
+                 : -EIO;
+    close(fd);
+    return rc;
+}
+
+/* DB_CDC_AVG_KB: a large file becomes a manifest of content-defined chunks;
+ * an edited copy only stores the chunks around its edits. */
+int t_chunked_dedup(void)
+{
+    setenv("DB_CDC_AVG_KB", "8", 1);
+    setenv("DB_PACK_SEGMENT_KB", "256", 1);
+    Ctx ctx;
+    int rc = tu_setup_store(&ctx);
+    unsetenv("DB_CDC_AVG_KB");
+    unsetenv("DB_PACK_SEGMENT_KB");
+    if(rc != 0)
+    {
+        tu_failf(__FILE__, __LINE__, "setup failed");
+        return -1;
+    }
+    uint8_t A[DB_ID_SIZE] = {0}, B[DB_ID_SIZE] = {0};
+    char    ea[DB_EMAIL_MAX_LEN], eb[DB_EMAIL_MAX_LEN];
+    snprintf(ea, sizeof ea, "%s", "cdc_a@x.com");
+    snprintf(eb, sizeof eb, "%s", "cdc_b@x.com");
+    db_add_user(ea, A);
+    db_add_user(eb, B);
+    db_user_set_role_publisher(A);
+    db_user_set_role_publisher(B);
+
+    char objs[PATH_MAX + 64], packs[PATH_MAX + 64];
+    snprintf(objs, sizeof objs, "%s/objects/sha256", ctx.root);
+    snprintf(packs, sizeof packs, "%s/objects/packs", ctx.root);
+
+    /* a 1 MiB series and a re-export with 100 bytes inserted and 16
+       overwritten further on */
+    const size_t LEN = 1u << 20, INS = 100;
+    uint8_t*     a   = malloc(LEN);
+    uint8_t*     b   = malloc(LEN + INS);
+    uint8_t*     out = malloc(LEN + INS);
+    EXPECT_TRUE(a && b && out);
+    EXPECT_EQ_RC(crypt_rand_bytes(a, LEN), 0);
+    memcpy(b, a, 400000);
+    memset(b + 400000, 'X', INS);
+    memcpy(b + 400000 + INS, a + 400000, LEN - 400000);
+    memset(b + 800000, 'Y', 16);
+
+    DbIngestStats st0, st1;
+    uint8_t       IA[DB_ID_SIZE], IB[DB_ID_SIZE];
+    EXPECT_EQ_RC(upload_buf(A, a, LEN, IA), 0);
+    EXPECT_TRUE(tu_dir_size_bytes(objs) == 0);
+    uint64_t packed = tu_dir_size_bytes(packs);
+    EXPECT_TRUE(packed == LEN);
+    EXPECT_EQ_RC(db_ingest_stats(&st0), 0);
+    EXPECT_EQ_RC(upload_buf(A, b, LEN + INS, IB), 0);
+    EXPECT_EQ_RC(db_ingest_stats(&st1), 0);
+    uint64_t grown = tu_dir_size_bytes(packs) - packed;
+    EXPECT_TRUE(grown > INS && grown < LEN / 8);
+    EXPECT_TRUE(st1.dedup_bytes_saved - st0.dedup_bytes_saved ==
+                LEN + INS - grown);
+
+    DataMeta m;
+    Sha256   d;
+    char     p[PATH_MAX];
+    EXPECT_EQ_RC(db_data_get_meta(IB, &m), 0);
+    EXPECT_TRUE(m.flags & DB_DATA_F_CHUNKED);
+    EXPECT_EQ_SIZE(m.size, LEN + INS);
+    EXPECT_EQ_RC(crypt_sha256_buf(b, LEN + INS, &d), 0);
+    EXPECT_TRUE(memcmp(d.b, m.sha, 32) == 0); /* address of the whole file */
+    EXPECT_EQ_RC(db_data_get_path(IB, p, sizeof p), -ENODATA);
+
+    /* ranges across chunk boundaries, the edits and the end */
+    size_t got = 0;
+    EXPECT_EQ_RC(db_data_read(IB, 399990, out, 300, &got), 0);
+    EXPECT_TRUE(got == 300 && memcmp(out, b + 399990, 300) == 0);
+    EXPECT_EQ_RC(db_data_read(IB, 0, out, LEN + INS, &got), 0);
+    EXPECT_TRUE(got == LEN + INS && memcmp(out, b, LEN + INS) == 0);
+    EXPECT_EQ_RC(db_data_read(IB, LEN + INS - 5, out, 64, &got), 0);
+    EXPECT_TRUE(got == 5 && memcmp(out, b + LEN + INS - 5, 5) == 0);
+
+    /* stream, fd and materialized file agree */
+    StreamBuf sb = {.buf = out, .n = 0};
+    EXPECT_EQ_RC(db_data_stream(IA, 12345, 0, stream_collect, &sb), 0);
+    EXPECT_TRUE(sb.n == LEN - 12345 && memcmp(out, a + 12345, sb.n) == 0);
+    int ofd = -1;
+    EXPECT_EQ_RC(db_data_open(IA, &ofd), 0);
+    EXPECT_TRUE(read(ofd, out, LEN) == (ssize_t)LEN &&
+                memcmp(out, a, LEN) == 0);
+    close(ofd);
+    EXPECT_EQ_RC(db_data_materialize(IB, p, sizeof p), 0);
+    EXPECT_TRUE(strstr(p, "/objects/cache/") != NULL);
+    ofd = open(p, O_RDONLY);
+    EXPECT_TRUE(ofd >= 0 && read(ofd, out, LEN + INS) == (ssize_t)(LEN + INS) &&
+                memcmp(out, b, LEN + INS) == 0);
+    close(ofd);
+    uint64_t rlen = 0;
+    EXPECT_EQ_RC(db_data_open_range_for(A, IB, 700001, 5000, &ofd, NULL, &rlen),
+                 0);
+    EXPECT_TRUE(rlen == 5000 && read(ofd, out, LEN) == 5000 &&
+                memcmp(out, b + 700001, 5000) == 0);
+    close(ofd);
+
+    /* the sink may call back into db_*: no txn is held across it, and the
+       segments it is reading from are pinned through two repacks */
+    sb.n = 0;
+    EXPECT_EQ_RC(db_data_stream(IB, 0, 0, stream_repack, &sb), 0);
+    EXPECT_TRUE(sb.n == LEN + INS && memcmp(out, b, LEN + INS) == 0);
+    EXPECT_EQ_RC(db_data_read(IB, 0, out, LEN + INS, &got), 0);
+    EXPECT_TRUE(got == LEN + INS && memcmp(out, b, LEN + INS) == 0);
+
+    /* a second owner's batch of the same file adds a reference only */
+    {
+        int     fd = open("./.tmp_cdc.bin", O_CREAT | O_RDWR | O_TRUNC, 0640);
+        int     st = -1;
+        uint8_t id[DB_ID_SIZE];
+        EXPECT_TRUE(fd >= 0);
+        unlink("./.tmp_cdc.bin");
+        EXPECT_TRUE(write(fd, a, LEN) == (ssize_t)LEN);
+        EXPECT_TRUE(lseek(fd, 0, SEEK_SET) == 0);
+        uint64_t before = tu_dir_size_bytes(packs);
+        EXPECT_EQ_RC(db_data_add_batch(B, 1, &fd, NULL, id, &st), 0);
+        close(fd);
+        EXPECT_EQ_RC(st, 0);
+        EXPECT_TRUE(tu_dir_size_bytes(packs) == before);
+        EXPECT_EQ_RC(db_data_get_meta(id, &m), 0);
+        EXPECT_TRUE(m.flags & DB_DATA_F_CHUNKED);
+        EXPECT_EQ_RC(db_data_delete(A, IA), 0);
+        EXPECT_EQ_RC(db_data_read(id, 0, out, LEN, &got), 0);
+        EXPECT_TRUE(got == LEN && memcmp(out, a, LEN) == 0);
+        EXPECT_EQ_RC(db_data_delete(B, id), 0);
+    }
+
+    /* shared chunks outlive the first file; the copy goes with the last
+       reference and the chunks become dead pack space */
+    EXPECT_EQ_RC(db_data_read(IB, 0, out, LEN + INS, &got), 0);
+    EXPECT_TRUE(got == LEN + INS && memcmp(out, b, LEN + INS) == 0);
+    EXPECT_EQ_RC(db_data_delete(A, IB), 0);
+    EXPECT_TRUE(access(p, F_OK) != 0);
+    uint64_t reclaimed = 0;
+    EXPECT_EQ_RC(db_data_repack(0, &reclaimed), 0);
+    EXPECT_TRUE(reclaimed > LEN / 2);
+    EXPECT_EQ_RC(db_data_repack(0, &reclaimed), 0);
+    EXPECT_TRUE(tu_dir_size_bytes(packs) <= 256u * 1024u);
+
+    free(a);
+    free(b);
+    free(out);
+    tu_teardown_store(&ctx);
+    return 0;
+}
+
+/* Drop 'n' bytes at objects/sha256/xx/yy/<name>, creating the shard. */
+static int plant_file(const char* objs, const char* hex, const char* name,
+                      const void* p, size_t n)
+{
+    char path[PATH_MAX + 128];
+    snprintf(path, sizeof path, "%s/%.2s", objs, hex);
+    if(mkdir(path, 0770) != 0 && errno != EEXIST)
+        return -1;
+    snprintf(path, sizeof path, "%s/%.2s/%.2s", objs, hex, hex + 2);
+    if(mkdir(path, 0770) != 0 && errno != EEXIST)
+        return -1;
+    snprintf(path, sizeof path, "%s/%.2s/%.2s/%s", objs, hex, hex + 2, name);
+    int fd = open(path, O_CREAT | O_WRONLY | O_TRUNC, 0640);
+    if(fd < 0)
+        return -1;
+    int rc = write(fd, p, n) == (ssize_t)n ? 0 : -1;
+    close(fd);
+    return rc;
+}
+
+/* db_data_gc: unreferenced blobs, blobs of inline content and stale temps go;
+ * referenced blobs and anything inside the grace period stay. */
+int t_gc_orphans(void)
+{
+    setenv("DB_INLINE_MAX", "1024", 1);
+    Ctx ctx;
+    int rc = tu_setup_store(&ctx);
+    unsetenv("DB_INLINE_MAX");
+    if(rc != 0)
+    {
+        tu_failf(__FILE__, __LINE__, "setup failed");
+        return -1;
+    }
+    uint8_t A[DB_ID_SIZE] = {0};
+    char    ea[DB_EMAIL_MAX_LEN];
+    snprintf(ea, sizeof ea, "%s", "gc_a@x.com");
+    db_add_user(ea, A);
+    db_user_set_role_publisher(A);
+
+    char objs[PATH_MAX + 64];
+    snprintf(objs, sizeof objs, "%s/objects/sha256", ctx.root);
+
+    /* live blob, a blob whose delete could not unlink it, inline content
+       with a stray blob, a blob no record ever referenced, and temps */
+    uint8_t  live[8192], lost[8192], ghost[8192], small[100];
+    Sha256   d;
+    char     hl[65], hg[65], hs[65], hx[65], path[PATH_MAX + 256];
+    uint8_t  IL[DB_ID_SIZE], IX[DB_ID_SIZE], IS[DB_ID_SIZE];
+    DataMeta m;
+    EXPECT_EQ_RC(crypt_rand_bytes(live, sizeof live), 0);
+    EXPECT_EQ_RC(crypt_rand_bytes(lost, sizeof lost), 0);
+    EXPECT_EQ_RC(crypt_rand_bytes(ghost, sizeof ghost), 0);
+    EXPECT_EQ_RC(crypt_rand_bytes(small, sizeof small), 0);
+    EXPECT_EQ_RC(upload_buf(A, live, sizeof live, IL), 0);
+    EXPECT_EQ_RC(upload_buf(A, lost, sizeof lost, IX), 0);
+    EXPECT_EQ_RC(upload_buf(A, small, sizeof small, IS), 0);
+    EXPECT_EQ_RC(db_data_get_meta(IS, &m), 0);
+    EXPECT_TRUE(m.flags & DB_DATA_F_INLINE);
+    EXPECT_EQ_RC(db_data_get_meta(IL, &m), 0);
+    memcpy(d.b, m.sha, 32);
+    crypt_sha256_hex(&d, hl);
+    EXPECT_EQ_RC(db_data_get_meta(IX, &m), 0);
+    memcpy(d.b, m.sha, 32);
+    crypt_sha256_hex(&d, hx);
+    EXPECT_EQ_RC(db_data_delete(A, IX), 0);
+    EXPECT_EQ_RC(plant_file(objs, hx, hx, lost, sizeof lost), 0);
+    EXPECT_EQ_RC(crypt_sha256_buf(small, sizeof small, &d), 0);
+    crypt_sha256_hex(&d, hs);
+    EXPECT_EQ_RC(plant_file(objs, hs, hs, small, sizeof small), 0);
+    EXPECT_EQ_RC(crypt_sha256_buf(ghost, sizeof ghost, &d), 0);
+    crypt_sha256_hex(&d, hg);
+    EXPECT_EQ_RC(plant_file(objs, hg, hg, ghost, sizeof ghost), 0);
+    snprintf(path, sizeof path, "%s.tmp.4242", hg);
+    EXPECT_EQ_RC(plant_file(objs, hg, path, ghost, 100), 0);
+    snprintf(path, sizeof path, "%s/.ingest.00112233445566778899aabbccddeeff",
+             objs);
+    int tfd = open(path, O_CREAT | O_WRONLY | O_TRUNC, 0640);
+    EXPECT_TRUE(tfd >= 0 && write(tfd, ghost, 50) == 50);
+    close(tfd);
+
+    /* everything was just written: the default grace keeps it all */
+    DbGcReport  r;
+    DbGcOptions o = {.grace_secs = 3600, .dry_run = 1};
+    EXPECT_EQ_RC(db_data_gc(&o, &r), 0);
+    EXPECT_TRUE(r.objects == 4 && r.orphans == 0 && r.temps == 0);
+    EXPECT_TRUE(r.young == 5 && r.removed == 0 && r.errors == 0);
+
+    /* dry run reports without touching anything */
+    o.grace_secs = 0;
+    EXPECT_EQ_RC(db_data_gc(&o, &r), 0);
+    EXPECT_TRUE(r.orphans == 3 && r.orphan_bytes == 2 * 8192 + 100);
+    EXPECT_TRUE(r.temps == 2 && r.temp_bytes == 150 && r.removed == 0);
+    EXPECT_TRUE(access(path, F_OK) == 0);
+
+    /* the real pass, paced to 20 removals per second */
+    struct timespec t0, t1;
+    o.dry_run     = 0;
+    o.max_per_sec = 20;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    EXPECT_EQ_RC(db_data_gc(&o, &r), 0);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    EXPECT_TRUE(r.orphans == 3 && r.temps == 2 && r.removed == 5);
+    EXPECT_TRUE(r.errors == 0);
+    double ms = (double)(t1.tv_sec - t0.tv_sec) * 1e3 +
+                (double)(t1.tv_nsec - t0.tv_nsec) / 1e6;
+    EXPECT_TRUE(ms >= 90.0); /* three unlinks, two 50 ms gaps */
+    EXPECT_TRUE(access(path, F_OK) != 0);
+    snprintf(path, sizeof path, "%s/%.2s/%.2s/%s", objs, hg, hg + 2, hg);
+    EXPECT_TRUE(access(path, F_OK) != 0);
+    snprintf(path, sizeof path, "%s/%.2s/%.2s/%s", objs, hl, hl + 2, hl);
+    EXPECT_TRUE(access(path, F_OK) == 0);
+
+    uint8_t buf[8192];
+    size_t  got = 0;
+    EXPECT_EQ_RC(db_data_read(IL, 0, buf, sizeof buf, &got), 0);
+    EXPECT_TRUE(got == sizeof buf && memcmp(buf, live, got) == 0);
+    EXPECT_EQ_RC(db_data_read(IS, 0, buf, sizeof small, &got), 0);
+    EXPECT_TRUE(got == sizeof small && memcmp(buf, small, got) == 0);
+
+    /* nothing left to collect; re-uploading the collected bytes works */
+    EXPECT_EQ_RC(db_data_gc(NULL, &r), 0);
+    EXPECT_TRUE(r.objects == 1 && r.orphans == 0 && r.temps == 0);
+    EXPECT_EQ_RC(upload_buf(A, lost, sizeof lost, IX), 0);
+    EXPECT_EQ_RC(db_data_read(IX, 0, buf, sizeof buf, &got), 0);
+    EXPECT_TRUE(got == sizeof buf && memcmp(buf, lost, got) == 0);
+
+    tu_teardown_store(&ctx);
+    return 0;
+}
+
+typedef struct
+{
+    _Atomic int n;
+    int         faults[8];
+    uint8_t     shas[8][32];
+} ScrubSeen;
+
+static int scrub_collect(const DataMeta* meta, int fault, void* user)
+{
+    ScrubSeen* s = (ScrubSeen*)user;
+    int        i = atomic_load(&s->n);
+    if(i < 8)
+    {
+        s->faults[i] = fault;
+        memcpy(s->shas[i], meta->sha, 32);
+    }
+    atomic_store(&s->n, i + 1);
+    return 0;
+}
+
+/* Fault reported for the content 'sha', or 0. */
+static int scrub_fault_of(const ScrubSeen* s, const uint8_t sha[32])
+{
+    for(int i = 0; i < s->n && i < 8; ++i)
+        if(memcmp(s->shas[i], sha, 32) == 0)
+            return s->faults[i];
+    return 0;
+}
+
+/* db_scrub_run: flipped, truncated and missing blobs are reported, intact
+ * blob, packed and inline contents are not; progress resumes from the
+ * checkpoint and the budgets pace the reads. */
+int t_scrub_detects_corruption(void)
+{
+    setenv("DB_INLINE_MAX", "1024", 1);
+    setenv("DB_PACK_MAX", "16384", 1);
+    Ctx ctx;
+    int rc = tu_setup_store(&ctx);
+    unsetenv("DB_INLINE_MAX");
+    unsetenv("DB_PACK_MAX");
+    if(rc != 0)
+    {
+        tu_failf(__FILE__, __LINE__, "setup failed");
+        return -1;
+    }
+    uint8_t A[DB_ID_SIZE] = {0};
+    char    ea[DB_EMAIL_MAX_LEN];
+    snprintf(ea, sizeof ea, "%s", "scrub_a@x.com");
+    db_add_user(ea, A);
+    db_user_set_role_publisher(A);
+
+    /* blobs 0..3, then a packed and an inline object */
+    const size_t SZ[6] = {65536, 65536, 65536, 65536, 8192, 100};
+    uint8_t*     buf   = malloc(65536);
+    uint8_t      ids[6][DB_ID_SIZE];
+    DataMeta     m[6];
+    char         hex[4][65];
+    EXPECT_TRUE(buf != NULL);
+    for(int i = 0; i < 6; ++i)
+    {
+        EXPECT_EQ_RC(crypt_rand_bytes(buf, SZ[i]), 0);
+        EXPECT_EQ_RC(upload_buf(A, buf, SZ[i], ids[i]), 0);
+        EXPECT_EQ_RC(db_data_get_meta(ids[i], &m[i]), 0);
+        if(i < 4)
+        {
+            Sha256 d;
+            memcpy(d.b, m[i].sha, 32);
+            crypt_sha256_hex(&d, hex[i]);
+        }
+    }
+    EXPECT_TRUE(m[4].flags & DB_DATA_F_PACKED);
+    EXPECT_TRUE(m[5].flags & DB_DATA_F_INLINE);
+
+    ScrubSeen     seen = {0};
+    DbScrubReport r;
+    EXPECT_EQ_RC(db_scrub_run(NULL, scrub_collect, &seen, &r), 0);
+    EXPECT_TRUE(r.objects == 6 && r.faults == 0 && r.wrapped && r.passes == 1);
+    EXPECT_TRUE(r.bytes == 4 * 65536 + 8192 + 100);
+    EXPECT_EQ_INT(seen.n, 0);
+
+    /* bit rot in blob 0, blob 1 truncated, blob 2 gone */
+    char path[PATH_MAX + 160];
+    snprintf(path, sizeof path, "%s/objects/sha256/%.2s/%.2s/%s", ctx.root,
+             hex[0], hex[0] + 2, hex[0]);
+    int fd = open(path, O_RDWR);
+    EXPECT_TRUE(fd >= 0 && pread(fd, buf, 1, 4096) == 1);
+    buf[0] ^= 0x01;
+    EXPECT_TRUE(pwrite(fd, buf, 1, 4096) == 1);
+    close(fd);
+    snprintf(path, sizeof path, "%s/objects/sha256/%.2s/%.2s/%s", ctx.root,
+             hex[1], hex[1] + 2, hex[1]);
+    EXPECT_EQ_RC(truncate(path, 1000), 0);
+    snprintf(path, sizeof path, "%s/objects/sha256/%.2s/%.2s/%s", ctx.root,
+             hex[2], hex[2] + 2, hex[2]);
+    EXPECT_EQ_RC(unlink(path), 0);
+
+    /* a partial run, then the rest from the checkpoint */
+    DbScrubOptions o = {.threads = 4, .max_objects = 2};
+    EXPECT_EQ_RC(db_scrub_run(&o, scrub_collect, &seen, &r), 0);
+    EXPECT_TRUE(r.objects == 2 && !r.wrapped && r.passes == 1);
+    uint64_t f = r.faults;
+    o.max_objects = 0;
+    EXPECT_EQ_RC(db_scrub_run(&o, scrub_collect, &seen, &r), 0);
+    EXPECT_TRUE(r.objects == 4 && r.wrapped && r.passes == 2);
+    EXPECT_TRUE(f + r.faults == 3);
+    EXPECT_EQ_INT(seen.n, 3);
+    EXPECT_EQ_INT(scrub_fault_of(&seen, m[0].sha), DB_SCRUB_HASH);
+    EXPECT_EQ_INT(scrub_fault_of(&seen, m[1].sha), DB_SCRUB_SIZE);
+    EXPECT_EQ_INT(scrub_fault_of(&seen, m[2].sha), DB_SCRUB_MISSING);
+
+    /* deleted content is not a fault; 20 reads/s paces the pass */
+    EXPECT_EQ_RC(db_data_delete(A, ids[2]), 0);
+    struct timespec t0, t1;
+    DbScrubOptions  slow = {.iops = 20};
+    atomic_store(&seen.n, 0);
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    EXPECT_EQ_RC(db_scrub_run(&slow, scrub_collect, &seen, &r), 0);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    EXPECT_TRUE(r.objects == 5 && r.faults == 2 && r.wrapped);
+    double ms = (double)(t1.tv_sec - t0.tv_sec) * 1e3 +
+                (double)(t1.tv_nsec - t0.tv_nsec) / 1e6;
+    EXPECT_TRUE(ms >= 200.0); /* at least 6 reads, 50 ms apart */
+
+    /* the background scrubber reports the same and stops on request */
+    atomic_store(&seen.n, 0);
+    EXPECT_EQ_RC(db_scrub_start(NULL, 3600, scrub_collect, &seen), 0);
+    EXPECT_EQ_RC(db_scrub_start(NULL, 3600, scrub_collect, &seen), -EBUSY);
+    for(int i = 0; i < 500 && atomic_load(&seen.n) < 2; ++i)
+        usleep(10000);
+    db_scrub_stop();
+    EXPECT_EQ_INT(seen.n, 2);
+
+    free(buf);
+    tu_teardown_store(&ctx);
+    return 0;
+}
+
+/* db_data_delete_many parks records in the trash: their content outlives
+ * them for DB_TRASH_GRACE_S, then the background reaper drops it. */
+int t_delete_many_trash_reaper(void)
+{
+    setenv("DB_TRASH_GRACE_S", "3600", 1);
+    setenv("DB_TRASH_REAP_INTERVAL_S", "0", 1);
+    Ctx ctx;
+    int rc = tu_setup_store(&ctx);
+    if(rc != 0)
+    {
+        unsetenv("DB_TRASH_GRACE_S");
+        unsetenv("DB_TRASH_REAP_INTERVAL_S");
+        tu_failf(__FILE__, __LINE__, "setup failed");
+        return -1;
+    }
+    uint8_t A[DB_ID_SIZE] = {0}, B[DB_ID_SIZE] = {0};
+    char    ea[DB_EMAIL_MAX_LEN], eb[DB_EMAIL_MAX_LEN];
+    snprintf(ea, sizeof ea, "%s", "trash_a@x.com");
+    snprintf(eb, sizeof eb, "%s", "trash_b@x.com");
+    db_add_user(ea, A);
+    db_add_user(eb, B);
+    db_user_set_role_publisher(A);
+    db_user_set_role_publisher(B);
+
+    /* A: three blobs; B: one of its own and a copy of A's first */
+    uint8_t  p[3][8192], q[4096];
+    uint8_t  ids[6][DB_ID_SIZE];
+    char     hex[3][65], path[PATH_MAX + 256];
+    Sha256   d;
+    DataMeta m;
+    for(int i = 0; i < 3; ++i)
+    {
+        EXPECT_EQ_RC(crypt_rand_bytes(p[i], sizeof p[i]), 0);
+        EXPECT_EQ_RC(upload_buf(A, p[i], sizeof p[i], ids[i]), 0);
+        EXPECT_EQ_RC(db_data_get_meta(ids[i], &m), 0);
+        memcpy(d.b, m.sha, 32);
+        crypt_sha256_hex(&d, hex[i]);
+    }
+    EXPECT_EQ_RC(crypt_rand_bytes(q, sizeof q), 0);
+    EXPECT_EQ_RC(upload_buf(B, q, sizeof q, ids[3]), 0);
+    EXPECT_EQ_RC(upload_buf(B, p[0], sizeof p[0], ids[4]), 0);
+    memset(ids[5], 0x5a, DB_ID_SIZE);
+
+    /* mixed batch: A's three, B's record, an unknown id, a repeat */
+    uint8_t batch[6 * DB_ID_SIZE];
+    int     st[6];
+    memcpy(batch, ids[0], DB_ID_SIZE);
+    memcpy(batch + 1 * DB_ID_SIZE, ids[1], DB_ID_SIZE);
+    memcpy(batch + 2 * DB_ID_SIZE, ids[3], DB_ID_SIZE);
+    memcpy(batch + 3 * DB_ID_SIZE, ids[5], DB_ID_SIZE);
+    memcpy(batch + 4 * DB_ID_SIZE, ids[2], DB_ID_SIZE);
+    memcpy(batch + 5 * DB_ID_SIZE, ids[1], DB_ID_SIZE);
+    EXPECT_EQ_RC(db_data_delete_many(A, 6, batch, st), 0);
+    EXPECT_TRUE(st[0] == 0 && st[1] == 0 && st[4] == 0);
+    EXPECT_EQ_RC(st[2], -EPERM);
+    EXPECT_EQ_RC(st[3], -ENOENT);
+    EXPECT_EQ_RC(st[5], -ENOENT);
+    EXPECT_EQ_RC(db_data_get_meta(ids[1], &m), -ENOENT);
+    EXPECT_EQ_RC(db_data_get_meta(ids[3], &m), 0);
+    EXPECT_EQ_RC(db_data_delete_many(A, 0, NULL, NULL), 0);
+
+    /* within the grace period: the blobs stay, the reaper finds nothing */
+    size_t reaped = 9;
+    EXPECT_EQ_RC(db_data_reap(0, &reaped), 0);
+    EXPECT_EQ_RC((int)reaped, 0);
+    for(int i = 0; i < 3; ++i)
+    {
+        snprintf(path, sizeof path, "%s/objects/sha256/%.2s/%.2s/%s", ctx.root,
+                 hex[i], hex[i] + 2, hex[i]);
+        EXPECT_TRUE(access(path, F_OK) == 0);
+    }
+    DbGcReport  r;
+    DbGcOptions o = {.grace_secs = 0};
+    EXPECT_EQ_RC(db_data_gc(&o, &r), 0);
+    EXPECT_TRUE(r.objects == 4 && r.orphans == 0 && r.errors == 0);
+
+    /* undelete: owner only, once; shares are not restored */
+    uint8_t buf[8192];
+    size_t  got = 0;
+    EXPECT_EQ_RC(db_data_undelete(B, ids[1]), -EPERM);
+    EXPECT_EQ_RC(db_data_undelete(A, ids[1]), 0);
+    EXPECT_EQ_RC(db_data_undelete(A, ids[1]), -ENOENT);
+    EXPECT_EQ_RC(db_data_read(ids[1], 0, buf, sizeof buf, &got), 0);
+    EXPECT_TRUE(got == sizeof buf && memcmp(buf, p[1], got) == 0);
+    int fd = -1;
+    EXPECT_EQ_RC(db_data_open_for(A, ids[1], &fd, &m), 0);
+    close(fd);
+
+    /* re-uploading trashed content reuses the stored blob; undeleting the
+       old record would then duplicate (content, owner) */
+    uint8_t again[DB_ID_SIZE];
+    EXPECT_EQ_RC(upload_buf(A, p[2], sizeof p[2], again), 0);
+    EXPECT_EQ_RC(db_data_undelete(A, ids[2]), -EEXIST);
+    db_close();
+
+    /* past the grace period undelete refuses what the reaper would drop,
+       whether or not it has run */
+    setenv("DB_TRASH_GRACE_S", "1", 1);
+    setenv("DB_TRASH_REAP_INTERVAL_S", "0", 1);
+    rc = db_open(ctx.root, 256ULL << 20);
+    unsetenv("DB_TRASH_GRACE_S");
+    unsetenv("DB_TRASH_REAP_INTERVAL_S");
+    EXPECT_EQ_RC(rc, 0);
+    EXPECT_EQ_RC(db_data_delete_many(B, 1, ids[3], st), 0);
+    EXPECT_EQ_RC(st[0], 0);
+    sleep(2);
+    EXPECT_EQ_RC(db_data_undelete(B, ids[3]), -ENOENT);
+    EXPECT_EQ_RC(db_data_reap(0, &reaped), 0);
+    EXPECT_EQ_RC((int)reaped, 3); /* ids[0], ids[2] and ids[3] */
+    db_close();
+
+    /* no grace and a running reaper: the next batch sweeps everything */
+    setenv("DB_TRASH_GRACE_S", "0", 1);
+    setenv("DB_TRASH_REAP_INTERVAL_S", "3600", 1);
+    rc = db_open(ctx.root, 256ULL << 20);
+    unsetenv("DB_TRASH_GRACE_S");
+    unsetenv("DB_TRASH_REAP_INTERVAL_S");
+    EXPECT_EQ_RC(rc, 0);
+    EXPECT_EQ_RC(db_data_delete_many(B, 1, ids[4], st), 0);
+    EXPECT_EQ_RC(st[0], 0);
+    snprintf(path, sizeof path, "%s/objects/sha256/%.2s/%.2s/%s", ctx.root,
+             hex[0], hex[0] + 2, hex[0]);
+    for(int i = 0; i < 200 && access(path, F_OK) == 0; ++i)
+        usleep(10000);
+    EXPECT_TRUE(access(path, F_OK) != 0);
+    EXPECT_EQ_RC(db_data_undelete(A, ids[0]), -ENOENT);
+    EXPECT_EQ_RC(db_data_read(again, 0, buf, sizeof buf, &got), 0);
+    EXPECT_TRUE(got == sizeof buf && memcmp(buf, p[2], got) == 0);
+    EXPECT_EQ_RC(db_data_read(ids[1], 0, buf, sizeof buf, &got), 0);
+    EXPECT_TRUE(got == sizeof buf && memcmp(buf, p[1], got) == 0);
+    EXPECT_EQ_RC(db_data_reap(0, &reaped), 0);
+    EXPECT_EQ_RC((int)reaped, 0);
+
+    tu_teardown_store(&ctx);
+    return 0;
+}
+
+/* db_data_add_from_buf / _iov store memory without an fd and land on the
+ * same content, placement and dedup as the fd path. */
+int t_add_from_buf_and_iov(void)
+{
+    setenv("DB_INLINE_MAX", "1024", 1);
+#ifdef DB_HAVE_ZLIB
+    setenv("DB_COMPRESS", "zlib", 1);
+#endif
+    Ctx ctx;
+    int rc = tu_setup_store(&ctx);
+    unsetenv("DB_INLINE_MAX");
+    unsetenv("DB_COMPRESS");
+    if(rc != 0)
+    {
+        tu_failf(__FILE__, __LINE__, "setup failed");
+        return -1;
+    }
+    uint8_t A[DB_ID_SIZE] = {0}, B[DB_ID_SIZE] = {0};
+    char    ea[DB_EMAIL_MAX_LEN], eb[DB_EMAIL_MAX_LEN];
+    snprintf(ea, sizeof ea, "%s", "iov_a@x.com");
+    snprintf(eb, sizeof eb, "%s", "iov_b@x.com");
+    db_add_user(ea, A);
+    db_add_user(eb, B);
+    db_user_set_role_publisher(A);
+    db_user_set_role_publisher(B);
+
+    static uint8_t rnd[200000], txt[100000];
+    EXPECT_EQ_RC(crypt_rand_bytes(rnd, sizeof rnd), 0);
+    for(size_t i = 0; i < sizeof txt; ++i)
+        txt[i] = (uint8_t)("lorem ipsum dolor sit amet "[i % 27]);
+
+    /* one buffer; the same bytes in three pieces dedup against it */
+    uint8_t  id1[DB_ID_SIZE], id2[DB_ID_SIZE], id3[DB_ID_SIZE];
+    DataMeta m1, m2;
+    Sha256   d;
+    EXPECT_EQ_RC(db_data_add_from_buf(A, rnd, sizeof rnd, "image/png", id1), 0);
+    EXPECT_EQ_RC(db_data_get_meta(id1, &m1), 0);
+    EXPECT_EQ_RC(crypt_sha256_buf(rnd, sizeof rnd, &d), 0);
+    EXPECT_TRUE(memcmp(m1.sha, d.b, 32) == 0 && m1.size == sizeof rnd);
+    EXPECT_TRUE((m1.flags & (DB_DATA_F_INLINE | DB_DATA_F_PACKED |
+                             DB_DATA_F_ZLIB | DB_DATA_F_CHUNKED)) == 0);
+    EXPECT_EQ_RC(db_data_add_from_buf(A, rnd, sizeof rnd, "image/png", id2),
+                 -EEXIST);
+
+    DbIngestStats s0 = {0}, s1 = {0};
+    EXPECT_EQ_RC(db_ingest_stats(&s0), 0);
+    struct iovec v[3] = {{rnd, 10}, {rnd + 10, 150000}, {rnd + 150010, 49990}};
+    EXPECT_EQ_RC(db_data_add_from_iov(B, v, 3, "image/png", id2), 0);
+    EXPECT_EQ_RC(db_ingest_stats(&s1), 0);
+    EXPECT_EQ_RC(db_data_get_meta(id2, &m2), 0);
+    EXPECT_TRUE(memcmp(m2.sha, m1.sha, 32) == 0);
+    EXPECT_TRUE(s1.objects == s0.objects);
+    EXPECT_TRUE(s1.dedup_bytes_saved - s0.dedup_bytes_saved == sizeof rnd);
+
+    /* many segments (more than one pwritev batch) of compressible text */
+    static struct iovec tv[250];
+    for(size_t i = 0; i < 250; ++i)
+    {
+        tv[i].iov_base = txt + i * 400;
+        tv[i].iov_len  = 400;
+    }
+    EXPECT_EQ_RC(db_data_add_from_iov(A, tv, 250, "text/plain", id3), 0);
+    EXPECT_EQ_RC(db_data_get_meta(id3, &m2), 0);
+#ifdef DB_HAVE_ZLIB
+    EXPECT_TRUE(m2.flags & DB_DATA_F_ZLIB);
+#endif
+    static uint8_t back[200000];
+    size_t         got = 0;
+    EXPECT_EQ_RC(db_data_read(id3, 0, back, sizeof txt, &got), 0);
+    EXPECT_TRUE(got == sizeof txt && memcmp(back, txt, got) == 0);
+    EXPECT_EQ_RC(db_data_read(id2, 0, back, sizeof rnd, &got), 0);
+    EXPECT_TRUE(got == sizeof rnd && memcmp(back, rnd, got) == 0);
+
+    /* small scattered objects are gathered and stored inline; the fd
+       path finds the same content */
+    uint8_t      id4[DB_ID_SIZE], id5[DB_ID_SIZE];
+    struct iovec sv[3] = {{txt, 40}, {rnd, 0}, {rnd + 7, 60}};
+    uint8_t      flat[100];
+    memcpy(flat, txt, 40);
+    memcpy(flat + 40, rnd + 7, 60);
+    EXPECT_EQ_RC(db_data_add_from_iov(A, sv, 3, "text/plain", id4), 0);
+    EXPECT_EQ_RC(db_data_get_meta(id4, &m1), 0);
+    EXPECT_TRUE((m1.flags & DB_DATA_F_INLINE) && m1.size == sizeof flat);
+    EXPECT_EQ_RC(upload_buf(B, flat, sizeof flat, id5), 0);
+    EXPECT_EQ_RC(db_data_get_meta(id5, &m2), 0);
+    EXPECT_TRUE(memcmp(m1.sha, m2.sha, 32) == 0);
+    EXPECT_EQ_RC(db_data_read(id4, 0, back, sizeof flat, &got), 0);
+    EXPECT_TRUE(got == sizeof flat && memcmp(back, flat, got) == 0);
+
+    /* empty object, bad arguments */
+    EXPECT_EQ_RC(db_data_add_from_iov(B, NULL, 0, "text/plain", id4), 0);
+    EXPECT_EQ_RC(db_data_get_meta(id4, &m1), 0);
+    EXPECT_TRUE(m1.size == 0);
+    EXPECT_EQ_RC(db_data_add_from_buf(A, NULL, 5, "text/plain", id4), -EINVAL);
+    EXPECT_EQ_RC(db_data_add_from_iov(A, NULL, 2, "text/plain", id4), -EINVAL);
+
+    tu_teardown_store(&ctx);
+    return 0;
+}
+
+/* Upload sessions survive a reopen, accept resent bytes, reject gaps and
+ * commit into the same content as a one-shot upload; idle ones expire. */
+int t_upload_sessions_resume(void)
+{
+    Ctx ctx;
+    if(tu_setup_store(&ctx) != 0)
+    {
+        tu_failf(__FILE__, __LINE__, "setup failed");
+        return -1;
+    }
+    uint8_t A[DB_ID_SIZE] = {0}, B[DB_ID_SIZE] = {0};
+    char    ea[DB_EMAIL_MAX_LEN], eb[DB_EMAIL_MAX_LEN];
+    snprintf(ea, sizeof ea, "%s", "up_a@x.com");
+    snprintf(eb, sizeof eb, "%s", "up_b@x.com");
+    db_add_user(ea, A);
+    db_add_user(eb, B);
+    db_user_set_role_publisher(A);
+    db_user_set_role_publisher(B);
+
+    enum
+    {
+        LEN = 3 << 20,
+        K   = 1 << 20
+    };
+    uint8_t* big  = malloc(LEN);
+    uint8_t* back = malloc(LEN);
+    if(!big || !back)
+    {
+        free(big);
+        free(back);
+        tu_teardown_store(&ctx);
+        tu_failf(__FILE__, __LINE__, "oom");
+        return -1;
+    }
+    EXPECT_EQ_RC(crypt_rand_bytes(big, LEN), 0);
+
+    uint8_t  s[DB_ID_SIZE], id[DB_ID_SIZE];
+    uint64_t at = 0;
+    EXPECT_EQ_RC(db_upload_begin(A, "application/dicom", s), 0);
+    EXPECT_EQ_RC(db_upload_append(A, s, 0, big, K, &at), 0);
+    EXPECT_TRUE(at == K);
+    EXPECT_EQ_RC(db_upload_append(A, s, 2 * K, big + 2 * K, K, &at), -ERANGE);
+    /* a retry resending part of what was stored */
+    EXPECT_EQ_RC(db_upload_append(A, s, K / 2, big + K / 2, K, &at), 0);
+    EXPECT_TRUE(at == K + K / 2);
+    EXPECT_EQ_RC(db_upload_append(B, s, at, big + at, 1, NULL), -EPERM);
+    EXPECT_EQ_RC(db_upload_status(B, s, &at), -EPERM);
+
+    /* a restart in the middle: the client asks where to resume */
+    db_close();
+    EXPECT_EQ_RC(db_open(ctx.root, 256ULL << 20), 0);
+    at = 0;
+    EXPECT_EQ_RC(db_upload_status(A, s, &at), 0);
+    EXPECT_TRUE(at == K + K / 2);
+    EXPECT_EQ_RC(db_upload_append(A, s, at, big + at, LEN - at, &at), 0);
+    EXPECT_TRUE(at == LEN);
+    EXPECT_EQ_RC(db_upload_commit(A, s, id), 0);
+    EXPECT_EQ_RC(db_upload_commit(A, s, id), -ENOENT);
+
+    DataMeta m, m2;
+    Sha256   d;
+    size_t   got = 0;
+    EXPECT_EQ_RC(db_data_get_meta(id, &m), 0);
+    EXPECT_EQ_RC(crypt_sha256_buf(big, LEN, &d), 0);
+    EXPECT_TRUE(memcmp(m.sha, d.b, 32) == 0 && m.size == LEN);
+    EXPECT_TRUE(strcmp(m.mime, "application/dicom") == 0);
+    EXPECT_EQ_RC(db_data_read(id, 0, back, LEN, &got), 0);
+    EXPECT_TRUE(got == LEN && memcmp(back, big, LEN) == 0);
+    char sh[33], path[4200];
+    tu_hex16(sh, s);
+    snprintf(path, sizeof path, "%s/objects/uploads/%s", ctx.root, sh);
+    EXPECT_TRUE(access(path, F_OK) != 0);
+
+    /* the same bytes from another owner deduplicate */
+    DbIngestStats st0 = {0}, st1 = {0};
+    uint8_t       id2[DB_ID_SIZE];
+    EXPECT_EQ_RC(db_ingest_stats(&st0), 0);
+    EXPECT_EQ_RC(db_upload_begin(B, "application/dicom", s), 0);
+    EXPECT_EQ_RC(db_upload_append(B, s, 0, big, LEN, NULL), 0);
+    EXPECT_EQ_RC(db_upload_commit(B, s, id2), 0);
+    EXPECT_EQ_RC(db_ingest_stats(&st1), 0);
+    EXPECT_TRUE(st1.objects == st0.objects);
+    EXPECT_EQ_RC(db_data_get_meta(id2, &m2), 0);
+    EXPECT_TRUE(memcmp(m2.sha, m.sha, 32) == 0);
+    /* ... and the owner's own second copy is refused */
+    EXPECT_EQ_RC(db_upload_begin(A, "application/dicom", s), 0);
+    EXPECT_EQ_RC(db_upload_append(A, s, 0, big, LEN, NULL), 0);
+    EXPECT_EQ_RC(db_upload_commit(A, s, id2), -EEXIST);
+    EXPECT_EQ_RC(db_upload_abort(A, s), 0);
+    EXPECT_EQ_RC(db_upload_status(A, s, &at), -ENOENT);
+
+    /* small and empty uploads */
+    EXPECT_EQ_RC(db_upload_begin(A, "text/plain", s), 0);
+    EXPECT_EQ_RC(db_upload_append(A, s, 0, "hello ", 6, NULL), 0);
+    EXPECT_EQ_RC(db_upload_append(A, s, 6, "world", 5, NULL), 0);
+    EXPECT_EQ_RC(db_upload_commit(A, s, id), 0);
+    EXPECT_EQ_RC(db_data_read(id, 0, back, 11, &got), 0);
+    EXPECT_TRUE(got == 11 && memcmp(back, "hello world", 11) == 0);
+    EXPECT_EQ_RC(db_upload_begin(B, "text/plain", s), 0);
+    EXPECT_EQ_RC(db_upload_commit(B, s, id), 0);
+    EXPECT_EQ_RC(db_data_get_meta(id, &m), 0);
+    EXPECT_TRUE(m.size == 0);
+    EXPECT_EQ_RC(db_upload_begin(A, "application/x-much-too-long-mime-type", s),
+                 -EINVAL);
+
+    /* a session file with a second name (an object link left by an
+       interrupted commit) is never written through */
+    char other[4300];
+    EXPECT_EQ_RC(db_upload_begin(A, "text/plain", s), 0);
+    EXPECT_EQ_RC(db_upload_append(A, s, 0, "abc", 3, NULL), 0);
+    tu_hex16(sh, s);
+    snprintf(path, sizeof path, "%s/objects/uploads/%s", ctx.root, sh);
+    snprintf(other, sizeof other, "%s/objects/linked", ctx.root);
+    EXPECT_EQ_RC(link(path, other), 0);
+    EXPECT_EQ_RC(db_upload_append(A, s, 3, "def", 3, NULL), -EBUSY);
+    EXPECT_EQ_RC(unlink(other), 0);
+
+    /* a crash mid-commit (file set aside) or mid-begin (file, no record):
+       the open puts the first back and removes the second */
+    char aside[4300], orphan[4300];
+    snprintf(aside, sizeof aside, "%s.commit", path);
+    EXPECT_EQ_RC(rename(path, aside), 0);
+    snprintf(orphan, sizeof orphan, "%s/objects/uploads/%032d", ctx.root, 7);
+    int ofd = open(orphan, O_CREAT | O_WRONLY, 0600);
+    EXPECT_TRUE(ofd >= 0);
+    close(ofd);
+    db_close();
+    EXPECT_EQ_RC(db_open(ctx.root, 256ULL << 20), 0);
+    EXPECT_TRUE(access(orphan, F_OK) != 0 && access(aside, F_OK) != 0);
+    EXPECT_EQ_RC(db_upload_append(A, s, 3, "def", 3, &at), 0);
+    EXPECT_TRUE(at == 6);
+    EXPECT_EQ_RC(db_upload_commit(A, s, id), 0);
+    EXPECT_TRUE(access(path, F_OK) != 0);
+
+    /* idle sessions are reaped (TTL 0: any session is idle) */
+    EXPECT_EQ_RC(db_upload_begin(A, "application/dicom", s), 0);
+    EXPECT_EQ_RC(db_upload_append(A, s, 0, big, K, NULL), 0);
+    size_t reaped = 1;
+    EXPECT_EQ_RC(db_upload_reap(0, &reaped), 0);
+    EXPECT_TRUE(reaped == 0);
+    db_close();
+    setenv("DB_UPLOAD_TTL_S", "0", 1);
+    int rc = db_open(ctx.root, 256ULL << 20);
+    unsetenv("DB_UPLOAD_TTL_S");
+    EXPECT_EQ_RC(rc, 0);
+    EXPECT_EQ_RC(db_upload_reap(0, &reaped), 0);
+    EXPECT_TRUE(reaped == 1);
+    EXPECT_EQ_RC(db_upload_status(A, s, &at), -ENOENT);
+    tu_hex16(sh, s);
+    snprintf(path, sizeof path, "%s/objects/uploads/%s", ctx.root, sh);
+    EXPECT_TRUE(access(path, F_OK) != 0);
+
+    free(big);
+    free(back);
+    tu_teardown_store(&ctx);
+    return 0;
+}
+
+int t_sha256_backends_match(void)
+{
+    enum
+    {
+        NMSG = 45
+    };
+    static uint8_t pool[300000];
+    EXPECT_EQ_RC(crypt_rand_bytes(pool, sizeof pool), 0);
+
+    /* padding edges first (one vs two tail blocks), then random sizes at
+       unaligned offsets; enough messages to refill every lane */
+    static const size_t edge[] = {0,   1,   55,  56,   63,   64,  65,
+                                  119, 120, 127, 128, 1000, 4113};
+    const void* p[NMSG];
+    size_t      n[NMSG];
+    Sha256      ref[NMSG], got[NMSG];
+    uint32_t    r = 12345;
+    for(size_t i = 0; i < NMSG; ++i)
+    {
+        r    = r * 1103515245u + 12345u;
+        n[i] = i < sizeof edge / sizeof edge[0] ? edge[i]
+               : i == NMSG - 1                  ? 250000
+                                                : (size_t)(r >> 8) % 20000;
+        p[i] = pool + (r >> 4) % (sizeof pool - n[i]);
+
+        /* reference: OpenSSL over a file */
+        FILE* f = tmpfile();
+        EXPECT_TRUE(f != NULL);
+        if(!f)
+            return -1;
+        EXPECT_TRUE(fwrite(p[i], 1, n[i], f) == n[i] && fflush(f) == 0);
+        size_t sz = 0;
+        EXPECT_EQ_RC(crypt_sha256_fd(fileno(f), &ref[i], &sz), 0);
+        EXPECT_EQ_SIZE(sz, n[i]);
+        fclose(f);
+    }
+
+    /* every combination of backends this CPU has, including none */
+    unsigned tried = 0;
+    for(unsigned mask = 0; mask <= CRYPT_SHA256_IMPL_ALL; ++mask)
+    {
+        if(crypt_sha256_set_impl(mask) != mask)
+            continue;
+        tried++;
+        memset(got, 0, sizeof got);
+        EXPECT_EQ_RC(crypt_sha256_many(NMSG, p, n, got), 0);
+        for(size_t i = 0; i < NMSG; ++i)
+        {
+            const uint8_t* b = p[i];
+            EXPECT_TRUE(memcmp(got[i].b, ref[i].b, 32) == 0);
+
+            Sha256 d;
+            EXPECT_EQ_RC(crypt_sha256_buf(b, n[i], &d), 0);
+            EXPECT_TRUE(memcmp(d.b, ref[i].b, 32) == 0);
+
+            size_t       a = n[i] / 3, c = n[i] / 2;
+            struct iovec v[3] = {{(void*)b, a},
+                                 {(void*)(b + a), c - a},
+                                 {(void*)(b + c), n[i] - c}};
+            EXPECT_EQ_RC(crypt_sha256_iov(v, 3, &d), 0);
+            EXPECT_TRUE(memcmp(d.b, ref[i].b, 32) == 0);
+
+            CryptSha256Ctx* x = crypt_sha256_begin();
+            EXPECT_TRUE(x != NULL);
+            EXPECT_EQ_RC(crypt_sha256_update(x, b, a), 0);
+            EXPECT_EQ_RC(crypt_sha256_update(x, b + a, n[i] - a), 0);
+            EXPECT_EQ_RC(crypt_sha256_end(x, &d), 0);
+            EXPECT_TRUE(memcmp(d.b, ref[i].b, 32) == 0);
+
+            CryptSha256State st;
+            crypt_sha256_state_init(&st);
+            crypt_sha256_state_update(&st, b, c);
+            crypt_sha256_state_update(&st, b + c, n[i] - c);
+            crypt_sha256_state_final(&st, &d);
+            EXPECT_TRUE(memcmp(d.b, ref[i].b, 32) == 0);
+        }
+
+        /* short batches leave lanes idle from the start */
+        EXPECT_EQ_RC(crypt_sha256_many(3, p + 10, n + 10, got), 0);
+        for(size_t i = 0; i < 3; ++i)
+            EXPECT_TRUE(memcmp(got[i].b, ref[10 + i].b, 32) == 0);
+        EXPECT_EQ_RC(crypt_sha256_many(0, NULL, NULL, NULL), 0);
+    }
+    EXPECT_TRUE(tried >= 1);
+    EXPECT_TRUE(crypt_sha256_set_impl(CRYPT_SHA256_IMPL_ALL) ==
+                crypt_sha256_impl());
+    return 0;
+}
+
+/* BLAKE3 matches the reference digests (bytes i % 251) with every kernel
+ * set, one-shot on one and all threads, and fed piecewise across the
+ * 16 KiB buffer of the incremental hasher. */
+int t_blake3_vectors(void)
+{
+    static const struct
+    {
+        size_t      n;
+        const char* hex;
+    } V[] = {
+        {0, "af1349b9f5f9a1a6a0404dea36dcc9499bcb25c9adc112b7cc9a93cae41f3262"},
+        {1, "2d3adedff11b61f14c886e35afa036736dcd87a74d27b5c1510225d0f592e213"},
+        {64, "4eed7141ea4a5cd4b788606bd23f46e212af9cacebacdc7d1f4c6dc7f2511b98"},
+        {65, "de1e5fa0be70df6d2be8fffd0e99ceaa8eb6e8c93a63f2d8d1c30ecb6b263dee"},
+        {1024,
+         "42214739f095a406f3fc83deb889744ac00df831c10daa55189b5d121c855af7"},
+        {1025,
+         "d00278ae47eb27b34faecf67b4fe263f82d5412916c1ffd97c8cb7fb814b8444"},
+        {3072,
+         "b98cb0ff3623be03326b373de6b9095218513e64f1ee2edd2525c7ad1e5cffd2"},
+        {16385,
+         "1dabe216be2578830263b049de1639f39f05a4da616b9b78c7a5e4e41662fd1f"},
+        {102400,
+         "bc3e3d41a1146b069abffad3c0d44860cf664390afce4d9661f7902e7943e085"},
+        {1048576,
+         "74cb441fd087764ca9c3694da742ebe30cbeb3060a17009ca81825c7a8d10343"},
+        {9437201,
+         "55acc923d408c025dbb36dba475f23915c686c9c0573142caaeb5812ca10b636"},
+    };
+    const size_t max = 9437201;
+    uint8_t*     in  = malloc(max);
+    EXPECT_TRUE(in != NULL);
+    if(!in)
+        return -1;
+    for(size_t i = 0; i < max; ++i)
+        in[i] = (uint8_t)(i % 251);
+
+    static const unsigned masks[] = {
+        0, CRYPT_BLAKE3_IMPL_AVX2, CRYPT_BLAKE3_IMPL_AVX512,
+        CRYPT_BLAKE3_IMPL_AVX2 | CRYPT_BLAKE3_IMPL_AVX512};
+    for(size_t m = 0; m < sizeof masks / sizeof masks[0]; ++m)
+    {
+        if(crypt_blake3_set_impl(masks[m]) != masks[m])
+            continue;
+        for(size_t v = 0; v < sizeof V / sizeof V[0]; ++v)
+        {
+            Sha256 d;
+            char   hex[65];
+            crypt_blake3(in, V[v].n, 1, d.b);
+            crypt_sha256_hex(&d, hex);
+            EXPECT_TRUE(strcmp(hex, V[v].hex) == 0);
+            crypt_blake3(in, V[v].n, 0, d.b);
+            crypt_sha256_hex(&d, hex);
+            EXPECT_TRUE(strcmp(hex, V[v].hex) == 0);
+
+            CryptBlake3* h = crypt_blake3_begin();
+            EXPECT_TRUE(h != NULL);
+            for(size_t off = 0, step = 1; off < V[v].n; step = step * 3 + 7)
+            {
+                size_t k = step < V[v].n - off ? step : V[v].n - off;
+                crypt_blake3_update(h, in + off, k);
+                off += k;
+            }
+            crypt_blake3_end(h, d.b);
+            crypt_sha256_hex(&d, hex);
+            EXPECT_TRUE(strcmp(hex, V[v].hex) == 0);
+        }
+    }
+    (void)crypt_blake3_set_impl(CRYPT_BLAKE3_IMPL_AVX2 |
+                                CRYPT_BLAKE3_IMPL_AVX512);
+    free(in);
+    return 0;
+}
+
+/* A store created with DB_CONTENT_HASH=blake3 names its objects by BLAKE3
+ * under objects/blake3, tags the metas, keeps the setting across reopens
+ * and still hands out SHA-256 on demand; an existing SHA-256 store ignores
+ * the variable. */
+int t_blake3_store(void)
+{
+    setenv("DB_CONTENT_HASH", "blake3", 1);
+    Ctx ctx;
+    int rc = tu_setup_store(&ctx);
+    unsetenv("DB_CONTENT_HASH");
+    if(rc != 0)
+    {
+        tu_failf(__FILE__, __LINE__, "setup failed");
+        return -1;
+    }
+    uint8_t A[DB_ID_SIZE] = {0};
+    char    ea[DB_EMAIL_MAX_LEN];
+    snprintf(ea, sizeof ea, "%s", "b3_a@x.com");
+    db_add_user(ea, A);
+    db_user_set_role_publisher(A);
+
+    static uint8_t body[300000];
+    EXPECT_EQ_RC(crypt_rand_bytes(body, sizeof body), 0);
+    Sha256 b3, sha;
+    crypt_blake3(body, sizeof body, 1, b3.b);
+    EXPECT_EQ_RC(crypt_sha256_buf(body, sizeof body, &sha), 0);
+
+    uint8_t  D[DB_ID_SIZE], U[DB_ID_SIZE], S[DB_ID_SIZE];
+    DataMeta m;
+    char     hex[65], want[PATH_MAX + 128], p[PATH_MAX];
+    uint8_t  d32[32];
+    EXPECT_EQ_RC(db_data_add_from_buf(A, body, sizeof body,
+                                      "application/octet-stream", D),
+                 0);
+    EXPECT_EQ_RC(db_data_get_meta(D, &m), 0);
+    EXPECT_TRUE((m.flags & DB_DATA_F_BLAKE3) && m.ver == 1);
+    EXPECT_TRUE(memcmp(m.sha, b3.b, 32) == 0);
+    crypt_sha256_hex(&b3, hex);
+    snprintf(want, sizeof want, "%s/objects/blake3/%.2s/%.2s/%s", ctx.root,
+             hex, hex + 2, hex);
+    EXPECT_EQ_RC(db_data_get_path(D, p, sizeof p), 0);
+    EXPECT_TRUE(strcmp(p, want) == 0);
+    EXPECT_EQ_RC(db_data_sha256(D, d32), 0);
+    EXPECT_TRUE(memcmp(d32, sha.b, 32) == 0);
+
+    /* resumable upload: no midstate, hashed at commit */
+    const size_t un = sizeof body - 1;
+    Sha256       ub3;
+    crypt_blake3(body + 1, un, 1, ub3.b);
+    EXPECT_EQ_RC(db_upload_begin(A, "application/octet-stream", S), 0);
+    EXPECT_EQ_RC(db_upload_append(A, S, 0, body + 1, 1000, NULL), 0);
+    EXPECT_EQ_RC(db_upload_append(A, S, 1000, body + 1001, un - 1000, NULL),
+                 0);
+    EXPECT_EQ_RC(db_upload_commit(A, S, U), 0);
+    EXPECT_EQ_RC(db_data_get_meta(U, &m), 0);
+    EXPECT_TRUE(memcmp(m.sha, ub3.b, 32) == 0);
+
+    /* the store keeps its digest without the variable */
+    db_close();
+    EXPECT_EQ_RC(db_open(ctx.root, 256ULL << 20), 0);
+    EXPECT_TRUE(crypt_content_hash() == CRYPT_HASH_BLAKE3);
+    EXPECT_EQ_RC(db_data_add_from_buf(A, body, 5000, "text/plain", D), 0);
+    EXPECT_EQ_RC(db_data_get_meta(D, &m), 0);
+    Sha256 b3s;
+    crypt_blake3(body, 5000, 1, b3s.b);
+    EXPECT_TRUE((m.flags & DB_DATA_F_BLAKE3) && memcmp(m.sha, b3s.b, 32) == 0);
+
+    /* the scrubber verifies with the store's digest */
+    ScrubSeen     seen = {0};
+    DbScrubReport r;
+    EXPECT_EQ_RC(db_scrub_run(NULL, scrub_collect, &seen, &r), 0);
+    EXPECT_TRUE(r.objects == 3 && r.faults == 0);
+    EXPECT_EQ_INT(seen.n, 0);
+    tu_teardown_store(&ctx);
+    EXPECT_TRUE(crypt_content_hash() == CRYPT_HASH_SHA256);
+
+    /* SHA-256 store with records: the variable does not switch it */
+    if(tu_setup_store(&ctx) != 0)
+    {
+        tu_failf(__FILE__, __LINE__, "setup failed");
+        return -1;
+    }
+    db_add_user(ea, A);
+    db_user_set_role_publisher(A);
+    EXPECT_EQ_RC(db_data_add_from_buf(A, body, 5000, "text/plain", D), 0);
+    db_close();
+    setenv("DB_CONTENT_HASH", "blake3", 1);
+    rc = db_open(ctx.root, 256ULL << 20);
+    unsetenv("DB_CONTENT_HASH");
+    EXPECT_EQ_RC(rc, 0);
+    EXPECT_TRUE(crypt_content_hash() == CRYPT_HASH_SHA256);
+    EXPECT_EQ_RC(db_data_add_from_buf(A, body, sizeof body, "text/plain", D),
+                 0);
+    EXPECT_EQ_RC(db_data_get_meta(D, &m), 0);
+    EXPECT_TRUE(!(m.flags & DB_DATA_F_BLAKE3) &&
+                memcmp(m.sha, sha.b, 32) == 0);
+    EXPECT_EQ_RC(db_data_sha256(D, d32), 0);
+    EXPECT_TRUE(memcmp(d32, sha.b, 32) == 0);
+    tu_teardown_store(&ctx);
+    return 0;
+}
+
+/* db_data_get_meta / _path serve repeated lookups from the meta cache; a
+ * delete, whether direct or through the trash, drops the entry on commit. */
+int t_meta_cache_hits_and_invalidation(void)
+{
+    setenv("DB_TRASH_GRACE_S", "3600", 1);
+    Ctx ctx;
+    int rc = tu_setup_store(&ctx);
+    unsetenv("DB_TRASH_GRACE_S");
+    if(rc != 0)
+    {
+        tu_failf(__FILE__, __LINE__, "setup failed");
+        return -1;
+    }
+    uint8_t A[DB_ID_SIZE] = {0};
+    char    ea[DB_EMAIL_MAX_LEN];
+    snprintf(ea, sizeof ea, "%s", "mcache@x.com");
+    db_add_user(ea, A);
+    db_user_set_role_publisher(A);
+
+    uint8_t p[3][4096], ids[3][DB_ID_SIZE];
+    for(int i = 0; i < 3; ++i)
+    {
+        EXPECT_EQ_RC(crypt_rand_bytes(p[i], sizeof p[i]), 0);
+        EXPECT_EQ_RC(upload_buf(A, p[i], sizeof p[i], ids[i]), 0);
+    }
+
+    DbMetaCacheStats s0, s1;
+    EXPECT_EQ_RC(db_meta_cache_stats(NULL), -EINVAL);
+    EXPECT_EQ_RC(db_meta_cache_stats(&s0), 0);
+    EXPECT_TRUE(s0.capacity == 65536); /* the default */
+
+    /* first lookup reads the DBI, the next ones are hits with equal output */
+    char     a[PATH_MAX + 256], b[PATH_MAX + 256];
+    DataMeta m1, m2;
+    EXPECT_EQ_RC(db_data_get_path(ids[0], a, sizeof a), 0);
+    EXPECT_EQ_RC(db_data_get_path(ids[0], b, sizeof b), 0);
+    EXPECT_TRUE(strcmp(a, b) == 0 && access(a, F_OK) == 0);
+    EXPECT_EQ_RC(db_data_get_meta(ids[0], &m1), 0);
+    EXPECT_EQ_RC(db_data_get_meta(ids[1], &m2), 0);
+    EXPECT_EQ_RC(db_data_get_meta(ids[1], &m2), 0);
+    EXPECT_TRUE(m1.size == sizeof p[0] && m2.size == sizeof p[1]);
+    EXPECT_EQ_RC(db_meta_cache_stats(&s1), 0);
+    EXPECT_TRUE(s1.misses - s0.misses == 2 && s1.hits - s0.hits == 3);
+    EXPECT_TRUE(s1.entries >= 2 && s1.entries <= s1.capacity);
+
+    /* deleted records are gone at once, not served from memory */
+    EXPECT_EQ_RC(db_data_delete(A, ids[0]), 0);
+    EXPECT_EQ_RC(db_data_get_path(ids[0], a, sizeof a), -ENOENT);
+    int st = 1;
+    EXPECT_EQ_RC(db_data_delete_many(A, 1, ids[1], &st), 0);
+    EXPECT_EQ_RC(st, 0);
+    EXPECT_EQ_RC(db_data_get_meta(ids[1], &m2), -ENOENT);
+    EXPECT_EQ_RC(db_data_undelete(A, ids[1]), 0);
+    EXPECT_EQ_RC(db_data_get_meta(ids[1], &m2), 0);
+    EXPECT_TRUE(memcmp(m2.sha, m1.sha, 32) != 0 && m2.size == sizeof p[1]);
+    db_close();
+
+    /* DB_META_CACHE=0: every lookup reads the DBI, counters stay at 0 */
+    setenv("DB_META_CACHE", "0", 1);
+    rc = db_open(ctx.root, 256ULL << 20);
+    unsetenv("DB_META_CACHE");
+    EXPECT_EQ_RC(rc, 0);
+    EXPECT_EQ_RC(db_data_get_path(ids[2], a, sizeof a), 0);
+    EXPECT_EQ_RC(db_data_get_path(ids[2], b, sizeof b), 0);
+    EXPECT_TRUE(strcmp(a, b) == 0 && access(a, F_OK) == 0);
+    EXPECT_EQ_RC(db_meta_cache_stats(&s1), 0);
+    EXPECT_TRUE(s1.capacity == 0 && s1.hits == 0 && s1.misses == 0);
+
+    tu_teardown_store(&ctx);
+    return 0;
+}
+
+/* DB_SHARD_LAYOUT picks the fan-out of a new store; db_data_relayout moves
+ * the blobs to another one while paths keep resolving, and an interrupted
+ * pass resumes after a reopen. */
+int t_shard_relayout(void)
+{
+    setenv("DB_SHARD_LAYOUT", "1x2", 1);
+    Ctx ctx;
+    int rc = tu_setup_store(&ctx);
+    unsetenv("DB_SHARD_LAYOUT");
+    if(rc != 0)
+    {
+        tu_failf(__FILE__, __LINE__, "setup failed");
+        return -1;
+    }
+    uint8_t A[DB_ID_SIZE] = {0};
+    char    ea[DB_EMAIL_MAX_LEN];
+    snprintf(ea, sizeof ea, "%s", "relayout@x.com");
+    db_add_user(ea, A);
+    db_user_set_role_publisher(A);
+
+    uint8_t  p[4][8192], ids[4][DB_ID_SIZE];
+    char     hex[3][65], want[PATH_MAX + 256], path[PATH_MAX + 256];
+    DataMeta m;
+    for(int i = 0; i < 3; ++i)
+    {
+        EXPECT_EQ_RC(crypt_rand_bytes(p[i], sizeof p[i]), 0);
+        EXPECT_EQ_RC(upload_buf(A, p[i], sizeof p[i], ids[i]), 0);
+        EXPECT_EQ_RC(db_data_get_meta(ids[i], &m), 0);
+        Sha256 d;
+        memcpy(d.b, m.sha, 32);
+        crypt_sha256_hex(&d, hex[i]);
+    }
+    unsigned lv = 0, wd = 0;
+    EXPECT_EQ_RC(db_data_layout(&lv, &wd), 0);
+    EXPECT_TRUE(lv == 1 && wd == 2);
+    snprintf(want, sizeof want, "%s/objects/sha256/%.2s/%s", ctx.root, hex[0],
+             hex[0]);
+    EXPECT_EQ_RC(db_data_get_path(ids[0], path, sizeof path), 0);
+    EXPECT_TRUE(strcmp(path, want) == 0 && access(path, F_OK) == 0);
+
+    /* bad shapes, and a no-op to the current one */
+    DbRelayoutOptions o = {.levels = 4, .width = 2};
+    DbRelayoutReport  r;
+    EXPECT_EQ_RC(db_data_relayout(&o, &r), -EINVAL);
+    o.levels = 3;
+    o.width  = 3;
+    EXPECT_EQ_RC(db_data_relayout(&o, &r), -EINVAL);
+    EXPECT_EQ_RC(db_data_relayout(NULL, &r), -EINVAL);
+    o.levels = 1;
+    o.width  = 2;
+    EXPECT_EQ_RC(db_data_relayout(&o, &r), 0);
+    EXPECT_TRUE(r.shards == 0 && r.moved == 0);
+
+    /* a directory under a blob name cannot be linked: the pass fails */
+    char jam[PATH_MAX + 256];
+    snprintf(jam, sizeof jam, "%s/objects/sha256/%.2s/%.2s%062d", ctx.root,
+             hex[1], hex[1], 0);
+    EXPECT_EQ_RC(mkdir(jam, 0770), 0);
+    o.levels  = 3;
+    o.threads = 2;
+    EXPECT_EQ_RC(db_data_relayout(&o, &r), -EIO);
+    EXPECT_TRUE(r.shards == 256 && r.moved == 3 && r.errors == 1);
+    EXPECT_EQ_RC(db_data_layout(&lv, &wd), 1);
+    EXPECT_TRUE(lv == 3 && wd == 2);
+
+    /* still moving after a reopen; new blobs go to the new layout */
+    db_close();
+    EXPECT_EQ_RC(db_open(ctx.root, 256ULL << 20), 0);
+    EXPECT_EQ_RC(db_data_layout(&lv, &wd), 1);
+    EXPECT_EQ_RC(crypt_rand_bytes(p[3], sizeof p[3]), 0);
+    EXPECT_EQ_RC(upload_buf(A, p[3], sizeof p[3], ids[3]), 0);
+    o.levels = 2;
+    EXPECT_EQ_RC(db_data_relayout(&o, &r), -EBUSY); /* other target */
+
+    /* a blob not moved yet: its path is the new name, linked on demand,
+       so it outlives the pass that drops the old one */
+    char old0[PATH_MAX + 256];
+    snprintf(old0, sizeof old0, "%s/objects/sha256/%.2s/%s", ctx.root, hex[0],
+             hex[0]);
+    snprintf(want, sizeof want, "%s/objects/sha256/%.2s/%.2s/%.2s/%s",
+             ctx.root, hex[0], hex[0] + 2, hex[0] + 4, hex[0]);
+    EXPECT_EQ_RC(rename(want, old0), 0);
+    EXPECT_EQ_RC(db_data_get_path(ids[0], path, sizeof path), 0);
+    EXPECT_TRUE(strcmp(path, want) == 0 && access(path, F_OK) == 0);
+
+    EXPECT_EQ_RC(rmdir(jam), 0);
+    o.levels = 3;
+    EXPECT_EQ_RC(db_data_relayout(&o, &r), 0);
+    EXPECT_TRUE(r.moved == 0 && r.merged == 1 && r.errors == 0);
+    EXPECT_TRUE(access(path, F_OK) == 0 && access(old0, F_OK) != 0);
+    EXPECT_EQ_RC(db_data_layout(&lv, &wd), 0);
+
+    for(int i = 0; i < 3; ++i)
+    {
+        snprintf(want, sizeof want, "%s/objects/sha256/%.2s/%.2s/%.2s/%s",
+                 ctx.root, hex[i], hex[i] + 2, hex[i] + 4, hex[i]);
+        EXPECT_EQ_RC(db_data_get_path(ids[i], path, sizeof path), 0);
+        EXPECT_TRUE(strcmp(path, want) == 0);
+        uint8_t back[8192];
+        int     fd = open(path, O_RDONLY);
+        EXPECT_TRUE(fd >= 0);
+        EXPECT_TRUE(read(fd, back, sizeof back) == (ssize_t)sizeof back);
+        close(fd);
+        EXPECT_TRUE(memcmp(back, p[i], sizeof back) == 0);
+    }
+    snprintf(want, sizeof want, "%s/objects/sha256/%.2s/%s", ctx.root, hex[0],
+             hex[0]);
+    EXPECT_TRUE(access(want, F_OK) != 0); /* old name gone */
+
+    /* the layout is recorded: the variable no longer applies */
+    db_close();
+    setenv("DB_SHARD_LAYOUT", "1x1", 1);
+    rc = db_open(ctx.root, 256ULL << 20);
+    unsetenv("DB_SHARD_LAYOUT");
+    EXPECT_EQ_RC(rc, 0);
+    EXPECT_EQ_RC(db_data_layout(&lv, &wd), 0);
+    EXPECT_TRUE(lv == 3 && wd == 2);
+
+    /* dedup, GC and delete work in the new tree */
+    uint8_t D[DB_ID_SIZE];
+    EXPECT_EQ_RC(upload_buf(A, p[0], sizeof p[0], D), -EEXIST);
+    DbGcOptions go = {.grace_secs = 0};
+    DbGcReport  gr;
+    EXPECT_EQ_RC(db_data_gc(&go, &gr), 0);
+    EXPECT_TRUE(gr.objects == 4 && gr.orphans == 0 && gr.errors == 0);
+    EXPECT_EQ_RC(db_data_get_path(ids[2], path, sizeof path), 0);
+    EXPECT_EQ_RC(db_data_delete(A, ids[2]), 0);
+    EXPECT_TRUE(access(path, F_OK) != 0);
+
+    /* and back to the default */
+    o.levels = 2;
+    EXPECT_EQ_RC(db_data_relayout(&o, &r), 0);
+    EXPECT_TRUE(r.moved == 3 && r.errors == 0);
+    EXPECT_EQ_RC(db_data_get_path(ids[3], path, sizeof path), 0);
+    EXPECT_TRUE(access(path, F_OK) == 0);
+    snprintf(want, sizeof want, "%s/objects/sha256/%.2s/%.2s/%.2s", ctx.root,
+             hex[0], hex[0] + 2, hex[0] + 4);
+    EXPECT_TRUE(!tu_is_dir(want)); /* emptied leaves are removed */
+    tu_teardown_store(&ctx);
+    return 0;
+}
+
+/* ------------------------------ Registry ---------------------------------- */
+static const TU_Test TESTS[] = {
+    {"open_creates_layout", t_open_creates_layout},
+    {"add_user_and_find", t_add_user_and_find},
+    {"roles_and_listing", t_roles_and_listing},
+    {"upload_requires_publisher", t_upload_requires_publisher},
+    {"share_requires_relationship", t_share_requires_relationship},
+    {"share_by_email", t_share_by_email},
+    {"resolve_path_points_to_object", t_resolve_path_points_to_object},
+    {"owner_delete_cascade", t_owner_delete_cascade},
+
+    /* dedup semantics */
+    {"dedup_second_owner_shares_blob", t_dedup_second_owner_shares_blob},
+    {"dedup_batch_refcounts_per_owner", t_dedup_batch_refcounts_per_owner},
+    {"same_user_second_upload_fails", t_same_user_second_upload_fails},
+    {"reupload_after_delete_new_id", t_reupload_after_delete_new_id},
+
+    /* sharing edges */
+    {"share_idempotent", t_share_idempotent},
+    {"share_self_noop", t_share_self_noop},
+    {"share_to_missing_email", t_share_to_missing_email},
+    {"share_denied_when_not_owner", t_share_denied_when_not_owner},
+
+    /* life-cycle edges */
+    {"double_delete_semantics", t_double_delete_semantics},
+    {"cannot_share_after_delete", t_cannot_share_after_delete},
+    {"share_invalid_email_empty", t_share_invalid_email_empty},
+
+    /* interface-only extras */
+    {"open_invalid_args", t_open_invalid_args},
+    {"find_by_ids_mixed", t_find_by_ids_mixed},
+    {"data_meta_sane", t_data_meta_sane},
+    {"get_path_invalid_args", t_get_path_invalid_args},
+    {"env_metrics_sane", t_env_metrics_sane},
+    {"list_publishers_viewers", t_list_publishers_viewers},
+
+    /* ingest paths */
+    {"ingest_regular_and_pipe_sources", t_ingest_regular_and_pipe_sources},
+    {"ingest_engines_agree", t_ingest_engines_agree},
+    {"open_blob_via_shard_handles", t_open_blob_via_shard_handles},
+    {"add_batch_dedup_and_perm", t_add_batch_dedup_and_perm},
+    {"group_durability_coalesces", t_group_durability_coalesces},
+    {"hash_first_dedup_skips_write", t_hash_first_dedup_skips_write},
+
+    /* reads, batch lookups and listings */
+    {"open_for_acl_and_range", t_open_for_acl_and_range},
+    {"get_metas_and_paths_batch", t_get_metas_and_paths_batch},
+    {"mime_interned_and_v0_upgrade", t_mime_interned_and_v0_upgrade},
+    {"list_by_owner_newest_first", t_list_by_owner_newest_first},
+    {"scan_time_range_pages", t_scan_time_range_pages},
+
+    /* storage placement */
+    {"inline_small_blobs", t_inline_small_blobs},
+    {"pack_files_and_repack", t_pack_files_and_repack},
+    {"compressed_blobs", t_compressed_blobs},
+    {"chunked_dedup", t_chunked_dedup},
+
+    /* maintenance */
+    {"gc_orphans", t_gc_orphans},
+    {"scrub_detects_corruption", t_scrub_detects_corruption},
+    {"delete_many_trash_reaper", t_delete_many_trash_reaper},
+
+    /* memory and resumable ingest */
+    {"add_from_buf_and_iov", t_add_from_buf_and_iov},
+    {"upload_sessions_resume", t_upload_sessions_resume},
+
+    /* content hashing */
+    {"sha256_backends_match", t_sha256_backends_match},
+    {"blake3_vectors", t_blake3_vectors},
+    {"blake3_store", t_blake3_store},
+
+    /* caching and layout */
+    {"meta_cache_hits_and_invalidation", t_meta_cache_hits_and_invalidation},
+    {"shard_relayout", t_shard_relayout},
 };
 
 static const size_t NTESTS = sizeof(TESTS) / sizeof(TESTS[0]);
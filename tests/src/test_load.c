@@ -2,9 +2,15 @@
 
 #include <lmdb.h>
 #include <inttypes.h>  // for PRIu64
+#include <sys/resource.h>
+#include <sys/wait.h>
 
 #include "test_utils.h"
 #include "db_interface.h"
+#include "sha256.h"
+#include "blake3.h"
+#include "workpool.h"
+#include "fsutil.h"
 
 /* helper: create file of `size` with deterministic content */
 static int make_blob_sized(const char* path, size_t size, uint32_t seed)
@@ -493,11 +499,1795 @@ static int tl_upload_mixed_sizes_and_share_details(void)
     return 0;
 }
 
+/* user+sys CPU time of this process in ms */
+static double cpu_now_ms(void)
+{
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    return (double)(ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) * 1000.0 +
+           (double)(ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) / 1000.0;
+}
+
+/* Ingest the same-sized regular file through the zero-copy path and through
+ * the read/write loop; report wall and CPU time per GiB for each. */
+static int tl_ingest_zero_copy_vs_stream(void)
+{
+    const size_t MB   = env_sz("ZC_MB", 64);
+    const size_t REPS = env_sz("ZC_REPS", 3);
+
+    Ctx ctx;
+    if(tu_setup_store(&ctx) != 0)
+    {
+        tu_failf(__FILE__, __LINE__, "setup failed");
+        return -1;
+    }
+
+    uint8_t owner[DB_ID_SIZE] = {0};
+    char    eo[DB_EMAIL_MAX_LEN];
+    snprintf(eo, sizeof eo, "%s", "zc_bench@x.com");
+    db_add_user(eo, owner);
+    db_user_set_role_publisher(owner);
+
+    const char* mode_name[2] = {"stream", "zero-copy"};
+    for(int mode = 0; mode < 2; ++mode)
+    {
+        crypt_set_zero_copy(mode);
+        double wall = 0.0, cpu = 0.0;
+        size_t bytes = 0;
+        for(size_t r = 0; r < REPS; ++r)
+        {
+            char p[PATH_MAX];
+            snprintf(p, sizeof p, "./.tmp_zc_%d_%zu.bin", mode, r);
+            int fd = make_blob_sized(p, MB << 20,
+                                     0xC0DEu + (uint32_t)(mode * 64) +
+                                         (uint32_t)r);
+            if(fd < 0)
+            {
+                tu_failf(__FILE__, __LINE__, "blob create failed");
+                break;
+            }
+            (void)fsync(fd);
+
+            uint8_t id[DB_ID_SIZE];
+            double  w0 = tu_now_ms(), c0 = cpu_now_ms();
+            int     rc = db_data_add_from_fd(owner, fd, "x/bin", id);
+            double  w1 = tu_now_ms(), c1 = cpu_now_ms();
+            EXPECT_EQ_RC(rc, 0);
+            wall  += w1 - w0;
+            cpu   += c1 - c0;
+            bytes += MB << 20;
+            close(fd);
+            unlink(p);
+        }
+        double gib = (double)bytes / (1024.0 * 1024.0 * 1024.0);
+        fprintf(stderr,
+                C_YEL "ingest %-9s %zu x %zu MiB: wall %.1f ms/GiB  cpu %.1f "
+                      "ms/GiB\n" C_RESET,
+                mode_name[mode], REPS, MB, gib > 0 ? wall / gib : 0.0,
+                gib > 0 ? cpu / gib : 0.0);
+    }
+    crypt_set_zero_copy(1);
+
+    tu_teardown_store(&ctx);
+    return 0;
+}
+
+/* Stream the same volume through a pipe (as a socket upload would arrive)
+ * and from a regular file with zero-copy off, once per ingest engine;
+ * report wall and CPU time per GiB. */
+static int tl_ingest_engines(void)
+{
+    const size_t MB = env_sz("ENG_MB", 64);
+
+    Ctx ctx;
+    if(tu_setup_store(&ctx) != 0)
+    {
+        tu_failf(__FILE__, __LINE__, "setup failed");
+        return -1;
+    }
+
+    uint8_t owner[DB_ID_SIZE] = {0};
+    char    eo[DB_EMAIL_MAX_LEN];
+    snprintf(eo, sizeof eo, "%s", "eng_bench@x.com");
+    db_add_user(eo, owner);
+    db_user_set_role_publisher(owner);
+
+    const CryptEngine engines[3]  = {CRYPT_ENGINE_SERIAL, CRYPT_ENGINE_THREADS,
+                                     CRYPT_ENGINE_URING};
+    const char*       eng_name[3] = {"serial", "threads", "uring"};
+    const char*       src_name[2] = {"pipe", "file"};
+    if(!crypt_uring_available())
+        eng_name[2] = "uring(n/a)";
+
+    crypt_set_zero_copy(0);
+    for(int src = 0; src < 2; ++src)
+    {
+        for(int e = 0; e < 3; ++e)
+        {
+            crypt_set_ingest_engine(engines[e]);
+
+            char p[PATH_MAX];
+            snprintf(p, sizeof p, "./.tmp_eng_%d_%d.bin", src, e);
+            int fd = make_blob_sized(p, MB << 20,
+                                     0xE61Eu + (uint32_t)(src * 8 + e));
+            unlink(p);
+            if(fd < 0)
+            {
+                tu_failf(__FILE__, __LINE__, "blob create failed");
+                break;
+            }
+
+            int   in  = fd;
+            int   pfd[2];
+            pid_t pid = -1;
+            if(src == 0)
+            {
+                if(pipe(pfd) != 0)
+                {
+                    close(fd);
+                    tu_failf(__FILE__, __LINE__, "pipe failed");
+                    break;
+                }
+                pid = fork();
+                if(pid == 0)
+                {
+                    close(pfd[0]);
+                    char    b[1 << 16];
+                    ssize_t n;
+                    while((n = read(fd, b, sizeof b)) > 0)
+                        if(write(pfd[1], b, (size_t)n) != n)
+                            _exit(1);
+                    _exit(0);
+                }
+                close(pfd[1]);
+                in = pfd[0];
+            }
+
+            uint8_t id[DB_ID_SIZE];
+            double  w0 = tu_now_ms(), c0 = cpu_now_ms();
+            int     rc = db_data_add_from_fd(owner, in, "x/bin", id);
+            double  w1 = tu_now_ms(), c1 = cpu_now_ms();
+            EXPECT_EQ_RC(rc, 0);
+
+            if(src == 0)
+            {
+                close(pfd[0]);
+                waitpid(pid, NULL, 0);
+            }
+            close(fd);
+
+            double gib = (double)(MB << 20) / (1024.0 * 1024.0 * 1024.0);
+            fprintf(stderr,
+                    C_YEL "ingest %-4s %-10s %zu MiB: wall %.1f ms/GiB  cpu "
+                          "%.1f ms/GiB\n" C_RESET,
+                    src_name[src], eng_name[e], MB, (w1 - w0) / gib,
+                    (c1 - c0) / gib);
+        }
+    }
+    crypt_set_ingest_engine(CRYPT_ENGINE_AUTO);
+    crypt_set_zero_copy(1);
+
+    tu_teardown_store(&ctx);
+    return 0;
+}
+
+/* Ingest N small-to-medium files one by one, then the same volume through
+ * db_data_add_batch; report files/s and MiB/s for each. */
+static int tl_add_batch_vs_serial(void)
+{
+    const size_t N  = env_sz("BATCH_N", 64);
+    const size_t KB = env_sz("BATCH_KB", 256);
+
+    Ctx ctx;
+    if(tu_setup_store(&ctx) != 0)
+    {
+        tu_failf(__FILE__, __LINE__, "setup failed");
+        return -1;
+    }
+
+    uint8_t owner[DB_ID_SIZE] = {0};
+    char    eo[DB_EMAIL_MAX_LEN];
+    snprintf(eo, sizeof eo, "%s", "batch_bench@x.com");
+    db_add_user(eo, owner);
+    db_user_set_role_publisher(owner);
+
+    int     *fds = calloc(N, sizeof *fds);
+    int     *st  = calloc(N, sizeof *st);
+    uint8_t *ids = calloc(N, DB_ID_SIZE);
+    if(!fds || !st || !ids)
+    {
+        free(fds);
+        free(st);
+        free(ids);
+        tu_teardown_store(&ctx);
+        tu_failf(__FILE__, __LINE__, "oom");
+        return -1;
+    }
+
+    const char *mode_name[2] = {"serial", "batch"};
+    for(int mode = 0; mode < 2; ++mode)
+    {
+        for(size_t i = 0; i < N; ++i)
+        {
+            char p[PATH_MAX];
+            snprintf(p, sizeof p, "./.tmp_batch_%d_%zu.bin", mode, i);
+            fds[i] = make_blob_sized(p, KB << 10,
+                                     0xBA7Cu + (uint32_t)(mode * 100003) +
+                                         (uint32_t)i);
+            unlink(p); /* fd keeps it alive */
+        }
+
+        double t0 = tu_now_ms();
+        if(mode == 0)
+        {
+            for(size_t i = 0; i < N; ++i)
+                st[i] = db_data_add_from_fd(owner, fds[i], "x/bin",
+                                            ids + i * DB_ID_SIZE);
+        }
+        else
+        {
+            EXPECT_EQ_RC(db_data_add_batch(owner, N, fds, NULL, ids, st), 0);
+        }
+        double t1 = tu_now_ms();
+
+        size_t ok = 0;
+        for(size_t i = 0; i < N; ++i)
+        {
+            ok += st[i] == 0;
+            if(fds[i] >= 0)
+                close(fds[i]);
+        }
+        EXPECT_EQ_INT((int)ok, (int)N);
+
+        double sec = (t1 - t0) / 1000.0;
+        double mib = (double)(N * KB) / 1024.0;
+        fprintf(stderr,
+                C_YEL "ingest %-6s %zu x %zu KiB: %.1f ms  %.0f files/s  "
+                      "%.1f MiB/s\n" C_RESET,
+                mode_name[mode], N, KB, t1 - t0, sec > 0 ? (double)N / sec : 0.0,
+                sec > 0 ? mib / sec : 0.0);
+    }
+
+    free(fds);
+    free(st);
+    free(ids);
+    tu_teardown_store(&ctx);
+    return 0;
+}
+
+/* Concurrent single-object uploads (one db_data_add_from_fd per item from
+ * a pool of threads): fsync per object vs DB_DURABILITY=group. */
+typedef struct
+{
+    const uint8_t* owner;
+    const int*     fds;
+    int*           rcs;
+    uint8_t*       ids; /* optional: N ids out */
+} SmallIngest;
+
+static void small_ingest_one(size_t i, void* user)
+{
+    SmallIngest* si = (SmallIngest*)user;
+    uint8_t      tmp[DB_ID_SIZE];
+    uint8_t*     id = si->ids ? si->ids + i * DB_ID_SIZE : tmp;
+    si->rcs[i] = db_data_add_from_fd((uint8_t*)si->owner, si->fds[i], "x/bin",
+                                     id);
+}
+
+static int tl_small_objects_group_sync(void)
+{
+    const size_t N   = env_sz("SYNC_N", 256);
+    const size_t KB  = env_sz("SYNC_KB", 4);
+    const size_t THR = env_sz("SYNC_THREADS", 8);
+
+    int* fds = calloc(N, sizeof *fds);
+    int* rcs = calloc(N, sizeof *rcs);
+    if(!fds || !rcs)
+    {
+        free(fds);
+        free(rcs);
+        tu_failf(__FILE__, __LINE__, "oom");
+        return -1;
+    }
+
+    const char* mode_name[2] = {"fsync-each", "group"};
+    for(int mode = 0; mode < 2; ++mode)
+    {
+        if(mode == 1)
+            setenv("DB_DURABILITY", "group", 1);
+        Ctx ctx;
+        int src = tu_setup_store(&ctx);
+        unsetenv("DB_DURABILITY");
+        if(src != 0)
+        {
+            tu_failf(__FILE__, __LINE__, "setup failed");
+            break;
+        }
+
+        uint8_t owner[DB_ID_SIZE] = {0};
+        char    eo[DB_EMAIL_MAX_LEN];
+        snprintf(eo, sizeof eo, "%s", "sync_bench@x.com");
+        db_add_user(eo, owner);
+        db_user_set_role_publisher(owner);
+
+        for(size_t i = 0; i < N; ++i)
+        {
+            char p[PATH_MAX];
+            snprintf(p, sizeof p, "./.tmp_sync_%d_%zu.bin", mode, i);
+            fds[i] = make_blob_sized(p, KB << 10,
+                                     0x5C00u + (uint32_t)(mode * 65537) +
+                                         (uint32_t)i);
+            unlink(p);
+        }
+
+        DbIngestStats s0 = {0}, s1 = {0};
+        db_ingest_stats(&s0);
+        SmallIngest si = {.owner = owner, .fds = fds, .rcs = rcs};
+        double      t0 = tu_now_ms();
+        wp_parallel_for(N, (unsigned)THR, small_ingest_one, &si);
+        double t1 = tu_now_ms();
+        db_ingest_stats(&s1);
+
+        size_t ok = 0;
+        for(size_t i = 0; i < N; ++i)
+        {
+            ok += rcs[i] == 0;
+            if(fds[i] >= 0)
+                close(fds[i]);
+        }
+        EXPECT_EQ_INT((int)ok, (int)N);
+
+        double sec = (t1 - t0) / 1000.0;
+        fprintf(stderr,
+                C_YEL "ingest %-10s %zu x %zu KiB, %zu thr: %.1f ms  %.0f "
+                      "obj/s  syncs %" PRIu64 "\n" C_RESET,
+                mode_name[mode], N, KB, THR, t1 - t0,
+                sec > 0 ? (double)N / sec : 0.0, s1.syncs - s0.syncs);
+        tu_teardown_store(&ctx);
+    }
+
+    free(fds);
+    free(rcs);
+    return 0;
+}
+
+static int tl_small_objects_inline(void)
+{
+    const size_t N   = env_sz("INLINE_N", 256);
+    const size_t SZ  = env_sz("INLINE_BYTES", 512);
+    const size_t THR = env_sz("INLINE_THREADS", 8);
+
+    int* fds = calloc(N, sizeof *fds);
+    int* rcs = calloc(N, sizeof *rcs);
+    if(!fds || !rcs)
+    {
+        free(fds);
+        free(rcs);
+        tu_failf(__FILE__, __LINE__, "oom");
+        return -1;
+    }
+
+    const char* mode_name[2] = {"blob", "inline"};
+    for(int mode = 0; mode < 2; ++mode)
+    {
+        if(mode == 1)
+            setenv("DB_INLINE_MAX", "4096", 1);
+        Ctx ctx;
+        int src = tu_setup_store(&ctx);
+        unsetenv("DB_INLINE_MAX");
+        if(src != 0)
+        {
+            tu_failf(__FILE__, __LINE__, "setup failed");
+            break;
+        }
+
+        uint8_t owner[DB_ID_SIZE] = {0};
+        char    eo[DB_EMAIL_MAX_LEN];
+        snprintf(eo, sizeof eo, "%s", "inline_bench@x.com");
+        db_add_user(eo, owner);
+        db_user_set_role_publisher(owner);
+
+        for(size_t i = 0; i < N; ++i)
+        {
+            char p[PATH_MAX];
+            snprintf(p, sizeof p, "./.tmp_inl_%d_%zu.bin", mode, i);
+            fds[i] = make_blob_sized(p, SZ, 0x1D00u + (uint32_t)i);
+            unlink(p);
+        }
+
+        DbIngestStats s0 = {0}, s1 = {0};
+        db_ingest_stats(&s0);
+        SmallIngest si = {.owner = owner, .fds = fds, .rcs = rcs};
+        double      t0 = tu_now_ms();
+        wp_parallel_for(N, (unsigned)THR, small_ingest_one, &si);
+        double t1 = tu_now_ms();
+        db_ingest_stats(&s1);
+
+        size_t ok = 0;
+        for(size_t i = 0; i < N; ++i)
+        {
+            ok += rcs[i] == 0;
+            if(fds[i] >= 0)
+                close(fds[i]);
+        }
+        EXPECT_EQ_INT((int)ok, (int)N);
+
+        char objs[PATH_MAX + 64];
+        snprintf(objs, sizeof objs, "%s/objects/sha256", ctx.root);
+        double sec = (t1 - t0) / 1000.0;
+        fprintf(stderr,
+                C_YEL "ingest %-6s %zu x %zu B, %zu thr: %.1f ms  %.0f obj/s  "
+                      "fsyncs %" PRIu64 "  object files %" PRIu64 " B\n" C_RESET,
+                mode_name[mode], N, SZ, THR, t1 - t0,
+                sec > 0 ? (double)N / sec : 0.0, s1.syncs - s0.syncs,
+                tu_dir_size_bytes(objs));
+        tu_teardown_store(&ctx);
+    }
+
+    free(fds);
+    free(rcs);
+    return 0;
+}
+
+/* Many small (not inline) objects: one file each vs shared pack files, then
+   a repack pass after most of them are deleted. */
+static int tl_small_objects_packed(void)
+{
+    const size_t N   = env_sz("PACK_N", 512);
+    const size_t SZ  = env_sz("PACK_BYTES", 8192);
+    const size_t THR = env_sz("PACK_THREADS", 8);
+
+    int*     fds = calloc(N, sizeof *fds);
+    int*     rcs = calloc(N, sizeof *rcs);
+    uint8_t* ids = calloc(N, DB_ID_SIZE);
+    if(!fds || !rcs || !ids)
+    {
+        free(fds);
+        free(rcs);
+        free(ids);
+        tu_failf(__FILE__, __LINE__, "oom");
+        return -1;
+    }
+
+    const char* mode_name[2] = {"blob", "packed"};
+    for(int mode = 0; mode < 2; ++mode)
+    {
+        if(mode == 1)
+        {
+            setenv("DB_PACK_MAX", "65536", 1);
+            setenv("DB_PACK_SEGMENT_KB", "1024", 1);
+        }
+        Ctx ctx;
+        int src = tu_setup_store(&ctx);
+        unsetenv("DB_PACK_MAX");
+        unsetenv("DB_PACK_SEGMENT_KB");
+        if(src != 0)
+        {
+            tu_failf(__FILE__, __LINE__, "setup failed");
+            break;
+        }
+
+        uint8_t owner[DB_ID_SIZE] = {0};
+        char    eo[DB_EMAIL_MAX_LEN];
+        snprintf(eo, sizeof eo, "%s", "pack_bench@x.com");
+        db_add_user(eo, owner);
+        db_user_set_role_publisher(owner);
+
+        for(size_t i = 0; i < N; ++i)
+        {
+            char p[PATH_MAX];
+            snprintf(p, sizeof p, "./.tmp_pack_%d_%zu.bin", mode, i);
+            fds[i] = make_blob_sized(p, SZ, 0x9A00u + (uint32_t)i);
+            unlink(p);
+        }
+
+        DbIngestStats s0 = {0}, s1 = {0};
+        db_ingest_stats(&s0);
+        SmallIngest si = {.owner = owner, .fds = fds, .rcs = rcs, .ids = ids};
+        double      t0 = tu_now_ms();
+        wp_parallel_for(N, (unsigned)THR, small_ingest_one, &si);
+        double t1 = tu_now_ms();
+        db_ingest_stats(&s1);
+
+        size_t ok = 0;
+        for(size_t i = 0; i < N; ++i)
+        {
+            ok += rcs[i] == 0;
+            if(fds[i] >= 0)
+                close(fds[i]);
+        }
+        EXPECT_EQ_INT((int)ok, (int)N);
+
+        char objs[PATH_MAX + 64], packs[PATH_MAX + 64];
+        snprintf(objs, sizeof objs, "%s/objects/sha256", ctx.root);
+        snprintf(packs, sizeof packs, "%s/objects/packs", ctx.root);
+        double sec = (t1 - t0) / 1000.0;
+        fprintf(stderr,
+                C_YEL "ingest %-6s %zu x %zu B, %zu thr: %.1f ms  %.0f obj/s  "
+                      "fsyncs %" PRIu64 "  objects %" PRIu64
+                      " B  packs %" PRIu64 " B\n" C_RESET,
+                mode_name[mode], N, SZ, THR, t1 - t0,
+                sec > 0 ? (double)N / sec : 0.0, s1.syncs - s0.syncs,
+                tu_dir_size_bytes(objs), tu_dir_size_bytes(packs));
+
+        /* drop 3 of 4, then compact what the packs still hold */
+        if(mode == 1)
+        {
+            for(size_t i = 0; i < N; ++i)
+                if(i % 4 != 0)
+                    (void)db_data_delete(owner, ids + i * DB_ID_SIZE);
+            uint64_t reclaimed = 0;
+            double   r0        = tu_now_ms();
+            EXPECT_EQ_RC(db_data_repack(50, &reclaimed), 0);
+            EXPECT_EQ_RC(db_data_repack(50, NULL), 0);
+            double r1 = tu_now_ms();
+            fprintf(stderr,
+                    C_YEL "repack after deleting 3/4: %.1f ms  reclaimed %" PRIu64
+                          " B  packs %" PRIu64 " B\n" C_RESET,
+                    r1 - r0, reclaimed, tu_dir_size_bytes(packs));
+        }
+        tu_teardown_store(&ctx);
+    }
+
+    free(fds);
+    free(rcs);
+    free(ids);
+    return 0;
+}
+
+/* Compressible blobs (report-like text): raw vs DB_COMPRESS=zlib on ingest
+   time, bytes on disk and a full read-back through db_data_read. */
+static int tl_compressed_blobs(void)
+{
+    const size_t N  = env_sz("ZLIB_N", 32);
+    const size_t KB = env_sz("ZLIB_KB", 1024);
+    const size_t SZ = KB * 1024u;
+
+    char*    txt = malloc(SZ);
+    char*    out = malloc(SZ);
+    uint8_t* ids = calloc(N, DB_ID_SIZE);
+    if(!txt || !out || !ids)
+    {
+        free(txt);
+        free(out);
+        free(ids);
+        tu_failf(__FILE__, __LINE__, "oom");
+        return -1;
+    }
+
+    const char* mode_name[2] = {"raw", "zlib"};
+    for(int mode = 0; mode < 2; ++mode)
+    {
+        if(mode == 1)
+            setenv("DB_COMPRESS", "zlib", 1);
+        Ctx ctx;
+        int src = tu_setup_store(&ctx);
+        unsetenv("DB_COMPRESS");
+        if(src != 0)
+        {
+            tu_failf(__FILE__, __LINE__, "setup failed");
+            break;
+        }
+
+        uint8_t owner[DB_ID_SIZE] = {0};
+        char    eo[DB_EMAIL_MAX_LEN];
+        snprintf(eo, sizeof eo, "%s", "zlib_bench@x.com");
+        db_add_user(eo, owner);
+        db_user_set_role_publisher(owner);
+
+        double ing = 0.0;
+        for(size_t i = 0; i < N; ++i)
+        {
+            /* distinct per object, text-like: words and numbers */
+            static const char* const W[] = {
+                "patient ", "study ",  "series ", "axial ", "contrast ",
+                "lesion ",  "normal ", "mm ",     "right ", "left ",
+                "CT ",      "MR ",     "slice ",  "no ",    "finding ",
+                "report\n"};
+            uint32_t x = 0x9E3779B9u * (uint32_t)(i + 1);
+            size_t   j = 0;
+            while(j < SZ)
+            {
+                x = x * 1664525u + 1013904223u;
+                char wb[24];
+                int  wn;
+                if((x >> 28) < 3)
+                    wn = snprintf(wb, sizeof wb, "%u ", (x >> 8) % 1000u);
+                else
+                    wn = snprintf(wb, sizeof wb, "%s", W[(x >> 24) & 15]);
+                size_t k = (size_t)wn < SZ - j ? (size_t)wn : SZ - j;
+                memcpy(txt + j, wb, k);
+                j += k;
+            }
+            int fd = open("./.tmp_zlib_bench.bin",
+                          O_CREAT | O_RDWR | O_TRUNC, 0640);
+            if(fd < 0 || write(fd, txt, SZ) != (ssize_t)SZ ||
+               lseek(fd, 0, SEEK_SET) != 0)
+            {
+                if(fd >= 0)
+                    close(fd);
+                tu_failf(__FILE__, __LINE__, "blob write failed");
+                break;
+            }
+            double t0 = tu_now_ms();
+            EXPECT_EQ_RC(
+                db_data_add_from_fd(owner, fd, "text/plain",
+                                    ids + i * DB_ID_SIZE),
+                0);
+            ing += tu_now_ms() - t0;
+            close(fd);
+        }
+        unlink("./.tmp_zlib_bench.bin");
+
+        double r0 = tu_now_ms();
+        for(size_t i = 0; i < N; ++i)
+        {
+            size_t got = 0;
+            EXPECT_EQ_RC(db_data_read(ids + i * DB_ID_SIZE, 0, out, SZ, &got),
+                         0);
+            EXPECT_EQ_SIZE(got, SZ);
+        }
+        double r1 = tu_now_ms();
+
+        char objs[PATH_MAX + 64];
+        snprintf(objs, sizeof objs, "%s/objects/sha256", ctx.root);
+        uint64_t disk = tu_dir_size_bytes(objs);
+        fprintf(stderr,
+                C_YEL "blobs %-4s %zu x %zu KiB: ingest %.1f ms  read %.1f ms  "
+                      "on disk %" PRIu64 " B (%.2fx)\n" C_RESET,
+                mode_name[mode], N, KB, ing, r1 - r0, disk,
+                disk ? (double)(N * SZ) / (double)disk : 0.0);
+        tu_teardown_store(&ctx);
+    }
+
+    free(txt);
+    free(out);
+    free(ids);
+    return 0;
+}
+
+/* Re-exported series: whole-file objects vs content-defined chunks. Each
+   re-export inserts a few bytes and patches a header further on. */
+static int tl_chunked_reexport(void)
+{
+    const size_t MB   = env_sz("CDC_MB", 32);
+    const size_t REPS = env_sz("CDC_REPS", 8);
+    const size_t SZ   = MB << 20;
+    const size_t INS  = 64;
+
+    uint8_t* base = malloc(SZ + REPS * INS);
+    uint8_t* cur  = malloc(SZ + REPS * INS);
+    if(!base || !cur || crypt_rand_bytes(base, SZ) != 0)
+    {
+        free(base);
+        free(cur);
+        tu_failf(__FILE__, __LINE__, "oom");
+        return -1;
+    }
+
+    const char* mode_name[2] = {"whole", "cdc"};
+    for(int mode = 0; mode < 2; ++mode)
+    {
+        if(mode == 1)
+            setenv("DB_CDC_AVG_KB", "64", 1);
+        Ctx ctx;
+        int src = tu_setup_store(&ctx);
+        unsetenv("DB_CDC_AVG_KB");
+        if(src != 0)
+        {
+            tu_failf(__FILE__, __LINE__, "setup failed");
+            break;
+        }
+
+        uint8_t owner[DB_ID_SIZE] = {0};
+        char    eo[DB_EMAIL_MAX_LEN];
+        snprintf(eo, sizeof eo, "%s", "cdc_bench@x.com");
+        db_add_user(eo, owner);
+        db_user_set_role_publisher(owner);
+
+        double ing = 0.0;
+        size_t len = SZ;
+        memcpy(cur, base, SZ);
+        for(size_t r = 0; r <= REPS; ++r)
+        {
+            if(r > 0)
+            {
+                size_t at = (r * 7919u * 4099u) % (len / 2);
+                memmove(cur + at + INS, cur + at, len - at);
+                memset(cur + at, (int)r, INS);
+                len += INS;
+                memset(cur + len - len / 3, (int)(0x80 + r), 32);
+            }
+            int fd = open("./.tmp_cdc_bench.bin", O_CREAT | O_RDWR | O_TRUNC,
+                          0640);
+            if(fd < 0 || write(fd, cur, len) != (ssize_t)len ||
+               lseek(fd, 0, SEEK_SET) != 0)
+            {
+                if(fd >= 0)
+                    close(fd);
+                tu_failf(__FILE__, __LINE__, "blob write failed");
+                break;
+            }
+            uint8_t id[DB_ID_SIZE];
+            double  t0 = tu_now_ms();
+            EXPECT_EQ_RC(db_data_add_from_fd(owner, fd, "application/dicom",
+                                             id),
+                         0);
+            ing += tu_now_ms() - t0;
+            close(fd);
+        }
+        unlink("./.tmp_cdc_bench.bin");
+
+        char objs[PATH_MAX + 64], packs[PATH_MAX + 64];
+        snprintf(objs, sizeof objs, "%s/objects/sha256", ctx.root);
+        snprintf(packs, sizeof packs, "%s/objects/packs", ctx.root);
+        uint64_t disk = tu_dir_size_bytes(objs) + tu_dir_size_bytes(packs);
+        fprintf(stderr,
+                C_YEL "series %-5s 1+%zu x %zu MiB: ingest %.1f ms  "
+                      "on disk %" PRIu64 " B (%.2f MiB per re-export)\n" C_RESET,
+                mode_name[mode], REPS, MB, ing, disk,
+                REPS ? ((double)disk - (double)SZ) / (double)REPS / 1048576.0
+                     : 0.0);
+        tu_teardown_store(&ctx);
+    }
+
+    free(base);
+    free(cur);
+    return 0;
+}
+
+/* Orphan GC over a fully precreated shard tree: the 65536-directory walk
+   on one thread vs the worker pool, then the removal pass. */
+static int tl_gc_walk(void)
+{
+    const size_t LIVE    = env_sz("GC_LIVE", 256);
+    const size_t ORPHANS = env_sz("GC_ORPHANS", 2048);
+    const size_t THR     = env_sz("GC_THREADS", 8);
+
+    setenv("DB_SHARDS_PRECREATE", "1", 1);
+    setenv("DB_DURABILITY", "group", 1);
+    Ctx ctx;
+    int rc = tu_setup_store(&ctx);
+    unsetenv("DB_SHARDS_PRECREATE");
+    unsetenv("DB_DURABILITY");
+    if(rc != 0)
+    {
+        tu_failf(__FILE__, __LINE__, "setup failed");
+        return -1;
+    }
+    uint8_t owner[DB_ID_SIZE] = {0};
+    char    eo[DB_EMAIL_MAX_LEN];
+    snprintf(eo, sizeof eo, "%s", "gc_bench@x.com");
+    db_add_user(eo, owner);
+    db_user_set_role_publisher(owner);
+
+    for(size_t i = 0; i < LIVE; ++i)
+    {
+        int fd = make_blob_sized("./.tmp_gc_bench.bin", 4096, (uint32_t)i + 1);
+        if(fd < 0)
+        {
+            tu_failf(__FILE__, __LINE__, "blob write failed");
+            break;
+        }
+        uint8_t id[DB_ID_SIZE];
+        EXPECT_EQ_RC(db_data_add_from_fd(owner, fd, "application/dicom", id),
+                     0);
+        close(fd);
+    }
+    unlink("./.tmp_gc_bench.bin");
+
+    /* orphans as a crash between publish and index commit leaves them */
+    for(size_t i = 0; i < ORPHANS; ++i)
+    {
+        uint8_t rnd[32];
+        Sha256  d;
+        char    hex[65], path[PATH_MAX + 160];
+        EXPECT_EQ_RC(crypt_rand_bytes(rnd, sizeof rnd), 0);
+        memcpy(d.b, rnd, 32);
+        crypt_sha256_hex(&d, hex);
+        snprintf(path, sizeof path, "%s/objects/sha256/%.2s/%.2s/%s", ctx.root,
+                 hex, hex + 2, hex);
+        int fd = open(path, O_CREAT | O_WRONLY | O_TRUNC, 0640);
+        EXPECT_TRUE(fd >= 0 && write(fd, rnd, sizeof rnd) == (ssize_t)sizeof rnd);
+        if(fd >= 0)
+            close(fd);
+    }
+
+    const unsigned thr[2] = {1, (unsigned)THR};
+    DbGcReport     r      = {0};
+    for(int k = 0; k < 2; ++k)
+    {
+        DbGcOptions o  = {.grace_secs = 0, .threads = thr[k], .dry_run = 1};
+        double      t0 = tu_now_ms();
+        EXPECT_EQ_RC(db_data_gc(&o, &r), 0);
+        fprintf(stderr,
+                C_YEL "gc dry run %2u thr: %" PRIu64 " shards %.1f ms  "
+                      "objects %" PRIu64 "  orphans %" PRIu64 "\n" C_RESET,
+                thr[k], r.shards, tu_now_ms() - t0, r.objects, r.orphans);
+        EXPECT_TRUE(r.objects == LIVE + ORPHANS && r.orphans == ORPHANS);
+    }
+    DbGcOptions o  = {.grace_secs = 0, .threads = thr[1]};
+    double      t0 = tu_now_ms();
+    EXPECT_EQ_RC(db_data_gc(&o, &r), 0);
+    fprintf(stderr,
+            C_YEL "gc remove  %2u thr: %.1f ms  removed %" PRIu64 "\n" C_RESET,
+            thr[1], tu_now_ms() - t0, r.removed);
+    EXPECT_TRUE(r.removed == ORPHANS);
+
+    tu_teardown_store(&ctx);
+    return 0;
+}
+
+/* Integrity scrub of cold blobs next to one hot blob: throughput without
+   and with a MiB/s budget, and what the pass leaves in the page cache. */
+static int tl_scrub_cache(void)
+{
+    const size_t N  = env_sz("SCRUB_OBJS", 32);
+    const size_t KB = env_sz("SCRUB_KB", 1024);
+    const size_t BW = env_sz("SCRUB_MBPS", 64);
+
+    Ctx ctx;
+    if(tu_setup_store(&ctx) != 0)
+    {
+        tu_failf(__FILE__, __LINE__, "setup failed");
+        return -1;
+    }
+    uint8_t owner[DB_ID_SIZE] = {0};
+    char    eo[DB_EMAIL_MAX_LEN];
+    snprintf(eo, sizeof eo, "%s", "scrub_bench@x.com");
+    db_add_user(eo, owner);
+    db_user_set_role_publisher(owner);
+
+    char (*paths)[PATH_MAX] = calloc(N, sizeof *paths);
+    if(!paths)
+    {
+        tu_teardown_store(&ctx);
+        tu_failf(__FILE__, __LINE__, "oom");
+        return -1;
+    }
+    for(size_t i = 0; i < N; ++i)
+    {
+        int fd = make_blob_sized("./.tmp_scrub_bench.bin", KB * 1024,
+                                 (uint32_t)i + 7);
+        uint8_t id[DB_ID_SIZE];
+        EXPECT_TRUE(fd >= 0);
+        EXPECT_EQ_RC(db_data_add_from_fd(owner, fd, "application/dicom", id),
+                     0);
+        close(fd);
+        EXPECT_EQ_RC(db_data_get_path(id, paths[i], sizeof paths[i]), 0);
+
+        /* blob 0 is being served, the others are cold */
+        fd = open(paths[i], O_RDONLY);
+        EXPECT_TRUE(fd >= 0);
+        if(i == 0)
+        {
+            uint8_t buf[65536];
+            while(read(fd, buf, sizeof buf) > 0)
+            {
+            }
+        }
+        else
+            (void)posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+        close(fd);
+    }
+    unlink("./.tmp_scrub_bench.bin");
+
+    const uint32_t mbps[2] = {0, (uint32_t)BW};
+    for(int k = 0; k < 2; ++k)
+    {
+        DbScrubOptions o = {.threads = 4, .mb_per_sec = mbps[k]};
+        DbScrubReport  r;
+        double         t0 = tu_now_ms();
+        EXPECT_EQ_RC(db_scrub_run(&o, NULL, NULL, &r), 0);
+        double ms = tu_now_ms() - t0;
+        EXPECT_TRUE(r.objects == N && r.faults == 0);
+
+        long hot = 0, cold = 0;
+        for(size_t i = 0; i < N; ++i)
+        {
+            int  fd = open(paths[i], O_RDONLY);
+            long c  = fd >= 0 ? fs_cached_pages(fd, KB * 1024) : 0;
+            if(fd >= 0)
+                close(fd);
+            if(i == 0)
+                hot = c;
+            else
+                cold += c;
+        }
+        long pages = (long)(KB * 1024 / 4096);
+        fprintf(stderr,
+                C_YEL "scrub %zu x %zu KiB, budget %3u MiB/s: %.1f ms  "
+                      "%.0f MiB/s  hot blob cached %ld/%ld pages  cold blobs "
+                      "cached %ld pages\n" C_RESET,
+                N, KB, mbps[k], ms,
+                (double)r.bytes / 1048576.0 / (ms / 1000.0), hot, pages, cold);
+    }
+
+    free(paths);
+    tu_teardown_store(&ctx);
+    return 0;
+}
+
+/* Retention sweep: one db_data_delete per object vs db_data_delete_many,
+   whose blobs are unlinked afterwards by db_data_reap. */
+static int tl_delete_many(void)
+{
+    const size_t N = env_sz("DEL_OBJS", 2048);
+
+    setenv("DB_DURABILITY", "group", 1);
+    setenv("DB_TRASH_REAP_INTERVAL_S", "0", 1);
+    setenv("DB_TRASH_GRACE_S", "0", 1);
+    Ctx ctx;
+    int rc = tu_setup_store(&ctx);
+    unsetenv("DB_DURABILITY");
+    unsetenv("DB_TRASH_REAP_INTERVAL_S");
+    unsetenv("DB_TRASH_GRACE_S");
+    if(rc != 0)
+    {
+        tu_failf(__FILE__, __LINE__, "setup failed");
+        return -1;
+    }
+    uint8_t owner[DB_ID_SIZE] = {0};
+    char    eo[DB_EMAIL_MAX_LEN];
+    snprintf(eo, sizeof eo, "%s", "del_bench@x.com");
+    db_add_user(eo, owner);
+    db_user_set_role_publisher(owner);
+
+    uint8_t* ids = malloc(N * DB_ID_SIZE);
+    int*     st  = malloc(N * sizeof *st);
+    if(!ids || !st)
+    {
+        free(ids);
+        free(st);
+        tu_teardown_store(&ctx);
+        tu_failf(__FILE__, __LINE__, "oom");
+        return -1;
+    }
+    for(size_t i = 0; i < N; ++i)
+    {
+        int fd = make_blob_sized("./.tmp_del_bench.bin", 4096, (uint32_t)i + 1);
+        if(fd < 0)
+        {
+            tu_failf(__FILE__, __LINE__, "blob write failed");
+            break;
+        }
+        EXPECT_EQ_RC(db_data_add_from_fd(owner, fd, "application/dicom",
+                                         ids + i * DB_ID_SIZE),
+                     0);
+        close(fd);
+    }
+    unlink("./.tmp_del_bench.bin");
+
+    const size_t half = N / 2;
+    double       t0   = tu_now_ms();
+    for(size_t i = 0; i < half; ++i)
+        EXPECT_EQ_RC(db_data_delete(owner, ids + i * DB_ID_SIZE), 0);
+    double one = tu_now_ms() - t0;
+
+    t0 = tu_now_ms();
+    EXPECT_EQ_RC(db_data_delete_many(owner, N - half, ids + half * DB_ID_SIZE,
+                                     st),
+                 0);
+    double many = tu_now_ms() - t0;
+    for(size_t i = 0; i < N - half; ++i)
+        EXPECT_EQ_RC(st[i], 0);
+
+    size_t reaped = 0;
+    t0            = tu_now_ms();
+    EXPECT_EQ_RC(db_data_reap(0, &reaped), 0);
+    double reap = tu_now_ms() - t0;
+    EXPECT_TRUE(reaped == N - half);
+
+    fprintf(stderr,
+            C_YEL "delete %zu one by one: %.1f ms  (%.1f us/obj)\n"
+                  "delete %zu batched:    %.1f ms  (%.1f us/obj) + reap %.1f ms\n" C_RESET,
+            half, one, half ? one * 1e3 / (double)half : 0.0, N - half, many,
+            N - half ? many * 1e3 / (double)(N - half) : 0.0, reap);
+
+    DbGcReport  r = {0};
+    DbGcOptions o = {.grace_secs = 0, .dry_run = 1};
+    EXPECT_EQ_RC(db_data_gc(&o, &r), 0);
+    EXPECT_TRUE(r.objects == 0);
+
+    free(ids);
+    free(st);
+    tu_teardown_store(&ctx);
+    return 0;
+}
+
+/* Objects already in memory: spill to a temp file + add_from_fd vs
+ * add_from_buf straight from the buffer. */
+static int tl_add_from_buf(void)
+{
+    const size_t N  = env_sz("BUF_OBJS", 64);
+    const size_t KB = env_sz("BUF_KB", 256);
+
+    Ctx ctx;
+    if(tu_setup_store(&ctx) != 0)
+    {
+        tu_failf(__FILE__, __LINE__, "setup failed");
+        return -1;
+    }
+    uint8_t owner[DB_ID_SIZE] = {0};
+    char    eo[DB_EMAIL_MAX_LEN];
+    snprintf(eo, sizeof eo, "%s", "buf_bench@x.com");
+    db_add_user(eo, owner);
+    db_user_set_role_publisher(owner);
+
+    const size_t len = KB * 1024;
+    uint8_t*     buf = malloc(len);
+    if(!buf)
+    {
+        tu_teardown_store(&ctx);
+        tu_failf(__FILE__, __LINE__, "oom");
+        return -1;
+    }
+    EXPECT_EQ_RC(crypt_rand_bytes(buf, len), 0);
+
+    const char* mode_name[2] = {"temp file + fd", "from buffer   "};
+    for(int mode = 0; mode < 2; ++mode)
+    {
+        double t0 = tu_now_ms();
+        for(size_t i = 0; i < N; ++i)
+        {
+            uint8_t id[DB_ID_SIZE];
+            memcpy(buf, &i, sizeof i);
+            buf[sizeof i] = (uint8_t)mode; /* distinct content per upload */
+            if(mode == 1)
+            {
+                EXPECT_EQ_RC(db_data_add_from_buf(owner, buf, len,
+                                                  "application/dicom", id),
+                             0);
+                continue;
+            }
+            int fd = open("./.tmp_buf_bench.bin", O_CREAT | O_RDWR | O_TRUNC,
+                          0640);
+            if(fd < 0 || write(fd, buf, len) != (ssize_t)len ||
+               lseek(fd, 0, SEEK_SET) != 0)
+            {
+                if(fd >= 0)
+                    close(fd);
+                tu_failf(__FILE__, __LINE__, "spill failed");
+                break;
+            }
+            EXPECT_EQ_RC(db_data_add_from_fd(owner, fd, "application/dicom", id),
+                         0);
+            close(fd);
+        }
+        double ms = tu_now_ms() - t0;
+        fprintf(stderr,
+                C_YEL "%s: %zu x %zu KiB in %.1f ms  (%.1f MiB/s)\n" C_RESET,
+                mode_name[mode], N, KB, ms,
+                ms > 0 ? (double)(N * KB) / 1024.0 / (ms / 1e3) : 0.0);
+    }
+    unlink("./.tmp_buf_bench.bin");
+
+    free(buf);
+    tu_teardown_store(&ctx);
+    return 0;
+}
+
+/* One large object: one-shot add_from_fd vs an upload session fed in
+ * pieces, and the bytes a resume after a mid-way drop has to resend. */
+static int tl_upload_session(void)
+{
+    const size_t MB    = env_sz("UP_MB", 64);
+    const size_t PIECE = env_sz("UP_PIECE_KB", 1024) * 1024;
+
+    Ctx ctx;
+    if(tu_setup_store(&ctx) != 0)
+    {
+        tu_failf(__FILE__, __LINE__, "setup failed");
+        return -1;
+    }
+    uint8_t owner[DB_ID_SIZE] = {0};
+    char    eo[DB_EMAIL_MAX_LEN];
+    snprintf(eo, sizeof eo, "%s", "up_bench@x.com");
+    db_add_user(eo, owner);
+    db_user_set_role_publisher(owner);
+
+    const size_t len = MB << 20;
+    uint8_t*     buf = malloc(len);
+    if(!buf || PIECE == 0)
+    {
+        free(buf);
+        tu_teardown_store(&ctx);
+        tu_failf(__FILE__, __LINE__, "oom");
+        return -1;
+    }
+    EXPECT_EQ_RC(crypt_rand_bytes(buf, len), 0);
+
+    /* one shot from a file */
+    uint8_t id[DB_ID_SIZE];
+    int     fd = open("./.tmp_up_bench.bin", O_CREAT | O_RDWR | O_TRUNC, 0640);
+    if(fd < 0 || write(fd, buf, len) != (ssize_t)len ||
+       lseek(fd, 0, SEEK_SET) != 0)
+    {
+        if(fd >= 0)
+            close(fd);
+        free(buf);
+        tu_teardown_store(&ctx);
+        tu_failf(__FILE__, __LINE__, "spill failed");
+        return -1;
+    }
+    double t0 = tu_now_ms();
+    EXPECT_EQ_RC(db_data_add_from_fd(owner, fd, "application/dicom", id), 0);
+    double one = tu_now_ms() - t0;
+    close(fd);
+    unlink("./.tmp_up_bench.bin");
+
+    /* the same size in pieces, dropped half-way, resumed after a reopen */
+    buf[0] ^= 0xFF; /* distinct content */
+    uint8_t  s[DB_ID_SIZE];
+    uint64_t at = 0;
+    t0          = tu_now_ms();
+    EXPECT_EQ_RC(db_upload_begin(owner, "application/dicom", s), 0);
+    while(at < len / 2)
+    {
+        size_t n = len - at < PIECE ? len - at : PIECE;
+        EXPECT_EQ_RC(db_upload_append(owner, s, at, buf + at, n, &at), 0);
+    }
+    double first = tu_now_ms() - t0;
+    db_close();
+    EXPECT_EQ_RC(db_open(ctx.root, 256ULL << 20), 0);
+    t0 = tu_now_ms();
+    EXPECT_EQ_RC(db_upload_status(owner, s, &at), 0);
+    uint64_t resent = len - at;
+    while(at < len)
+    {
+        size_t n = len - at < PIECE ? len - at : PIECE;
+        EXPECT_EQ_RC(db_upload_append(owner, s, at, buf + at, n, &at), 0);
+    }
+    EXPECT_EQ_RC(db_upload_commit(owner, s, id), 0);
+    double rest = tu_now_ms() - t0;
+
+    fprintf(stderr,
+            C_YEL "add_from_fd %zu MiB:        %.1f ms  (%.1f MiB/s)\n"
+                  "session, %zu KiB pieces:  %.1f ms  (%.1f MiB/s); "
+                  "resumed with %" PRIu64 " of %zu bytes to resend\n" C_RESET,
+            MB, one, one > 0 ? (double)MB / (one / 1e3) : 0.0, PIECE >> 10,
+            first + rest,
+            first + rest > 0 ? (double)MB / ((first + rest) / 1e3) : 0.0,
+            resent, len);
+
+    free(buf);
+    tu_teardown_store(&ctx);
+    return 0;
+}
+
+/* SHA-256 of many small buffers (crypt_sha256_many) and of one large one
+ * on each backend the CPU has; OpenSSL is the baseline. */
+static int tl_sha256_backends(void)
+{
+    const size_t N  = env_sz("SHA_OBJS", 32768);
+    const size_t KB = env_sz("SHA_KB", 4);
+    const size_t MB = env_sz("SHA_MB", 256);
+
+    const size_t len  = KB * 1024;
+    uint8_t*     pool = malloc(N * len > MB << 20 ? N * len : MB << 20);
+    const void** p    = malloc(N * sizeof *p);
+    size_t*      n    = malloc(N * sizeof *n);
+    Sha256*      d    = malloc(2 * N * sizeof *d);
+    if(!pool || !p || !n || !d)
+    {
+        free(pool);
+        free(p);
+        free(n);
+        free(d);
+        tu_failf(__FILE__, __LINE__, "oom");
+        return -1;
+    }
+    EXPECT_EQ_RC(crypt_rand_bytes(pool, N * len > MB << 20 ? N * len
+                                                           : MB << 20),
+                 0);
+    for(size_t i = 0; i < N; ++i)
+    {
+        p[i] = pool + i * len;
+        n[i] = len;
+    }
+
+    static const struct
+    {
+        const char* name;
+        unsigned    mask;
+    } be[] = {{"openssl    ", 0},
+              {"sha-ni     ", CRYPT_SHA256_IMPL_SHANI},
+              {"avx2 x8    ", CRYPT_SHA256_IMPL_AVX2},
+              {"avx512 x16 ", CRYPT_SHA256_IMPL_AVX512}};
+    for(size_t b = 0; b < sizeof be / sizeof be[0]; ++b)
+    {
+        if(crypt_sha256_set_impl(be[b].mask) != be[b].mask)
+            continue;
+        Sha256* out = b == 0 ? d : d + N;
+        double  t0  = tu_now_ms();
+        EXPECT_EQ_RC(crypt_sha256_many(N, p, n, out), 0);
+        double ms = tu_now_ms() - t0;
+        if(b > 0)
+            EXPECT_TRUE(memcmp(d, out, N * sizeof *d) == 0);
+
+        Sha256 one;
+        t0 = tu_now_ms();
+        EXPECT_EQ_RC(crypt_sha256_buf(pool, MB << 20, &one), 0);
+        double big = tu_now_ms() - t0;
+        fprintf(stderr,
+                C_YEL "%s %zu x %zu KiB: %7.1f ms (%6.0f MiB/s)   one %zu "
+                      "MiB: %6.1f ms (%6.0f MiB/s)\n" C_RESET,
+                be[b].name, N, KB, ms,
+                ms > 0 ? (double)(N * KB) / 1024.0 / (ms / 1e3) : 0.0, MB, big,
+                big > 0 ? (double)MB / (big / 1e3) : 0.0);
+    }
+    (void)crypt_sha256_set_impl(CRYPT_SHA256_IMPL_ALL);
+
+    free(pool);
+    free(p);
+    free(n);
+    free(d);
+    return 0;
+}
+
+/* Content digest of a large buffer and of a large file ingest: SHA-256 vs
+   BLAKE3 on one thread and on every core. */
+static int tl_blake3_vs_sha256(void)
+{
+    const size_t MB = env_sz("B3_MB", 512);
+    uint8_t*     in = malloc(MB << 20);
+    if(!in)
+    {
+        tu_failf(__FILE__, __LINE__, "oom");
+        return -1;
+    }
+    EXPECT_EQ_RC(crypt_rand_bytes(in, MB << 20), 0);
+
+    Sha256 d;
+    double t0 = tu_now_ms();
+    EXPECT_EQ_RC(crypt_sha256_buf(in, MB << 20, &d), 0);
+    double sha = tu_now_ms() - t0;
+    t0         = tu_now_ms();
+    crypt_blake3(in, MB << 20, 1, d.b);
+    double b1 = tu_now_ms() - t0;
+    t0        = tu_now_ms();
+    crypt_blake3(in, MB << 20, 0, d.b);
+    double bn = tu_now_ms() - t0;
+    free(in);
+    fprintf(stderr,
+            C_YEL "%zu MiB buffer: sha256 %6.0f MiB/s  blake3 x1 %6.0f MiB/s  "
+                  "blake3 x%u %6.0f MiB/s\n" C_RESET,
+            MB, sha > 0 ? (double)MB / (sha / 1e3) : 0.0,
+            b1 > 0 ? (double)MB / (b1 / 1e3) : 0.0, wp_ncpu(),
+            bn > 0 ? (double)MB / (bn / 1e3) : 0.0);
+
+    /* the same file into a SHA-256 and a BLAKE3 store */
+    const char* alg[2] = {"sha256", "blake3"};
+    for(int a = 0; a < 2; ++a)
+    {
+        setenv("DB_CONTENT_HASH", alg[a], 1);
+        Ctx ctx;
+        int src = tu_setup_store(&ctx);
+        unsetenv("DB_CONTENT_HASH");
+        if(src != 0)
+        {
+            tu_failf(__FILE__, __LINE__, "setup failed");
+            return -1;
+        }
+        uint8_t owner[DB_ID_SIZE] = {0};
+        char    eo[DB_EMAIL_MAX_LEN];
+        snprintf(eo, sizeof eo, "%s", "b3_bench@x.com");
+        db_add_user(eo, owner);
+        db_user_set_role_publisher(owner);
+
+        char p[PATH_MAX];
+        snprintf(p, sizeof p, "./.tmp_b3_%d.bin", a);
+        int fd = make_blob_sized(p, MB << 20, 0xB3B3u);
+        unlink(p);
+        uint8_t id[DB_ID_SIZE];
+        t0 = tu_now_ms();
+        EXPECT_EQ_RC(db_data_add_from_fd(owner, fd, "x/bin", id), 0);
+        double ms = tu_now_ms() - t0;
+        close(fd);
+        fprintf(stderr,
+                C_YEL "ingest %zu MiB file, %s store: %7.1f ms (%6.0f MiB/s)"
+                      "\n" C_RESET,
+                MB, alg[a], ms, ms > 0 ? (double)MB / (ms / 1e3) : 0.0);
+        tu_teardown_store(&ctx);
+    }
+    return 0;
+}
+
+/* Re-upload of already stored content: copy-then-dedup vs hash-first. */
+static int tl_reupload_hash_first(void)
+{
+    const size_t MB   = env_sz("HF_MB", 64);
+    const size_t REPS = env_sz("HF_REPS", 3);
+
+    const char* mode_name[2] = {"copy-first", "hash-first"};
+    for(int mode = 0; mode < 2; ++mode)
+    {
+        if(mode == 1)
+            setenv("DB_DEDUP_HASH_FIRST", "1", 1);
+        Ctx ctx;
+        int src = tu_setup_store(&ctx);
+        unsetenv("DB_DEDUP_HASH_FIRST");
+        if(src != 0)
+        {
+            tu_failf(__FILE__, __LINE__, "setup failed");
+            return -1;
+        }
+
+        uint8_t owner[DB_ID_SIZE] = {0};
+        char    eo[DB_EMAIL_MAX_LEN];
+        snprintf(eo, sizeof eo, "%s", "hf_bench@x.com");
+        db_add_user(eo, owner);
+        db_user_set_role_publisher(owner);
+
+        char p[PATH_MAX];
+        snprintf(p, sizeof p, "./.tmp_hf_%d.bin", mode);
+        int fd = make_blob_sized(p, MB << 20, 0x4F1Du);
+        unlink(p);
+        uint8_t id[DB_ID_SIZE];
+        EXPECT_EQ_RC(db_data_add_from_fd(owner, fd, "x/bin", id), 0);
+
+        DbIngestStats s0 = {0}, s1 = {0};
+        db_ingest_stats(&s0);
+        double t0 = tu_now_ms();
+        for(size_t r = 0; r < REPS; ++r)
+        {
+            lseek(fd, 0, SEEK_SET);
+            EXPECT_EQ_RC(db_data_add_from_fd(owner, fd, "x/bin", id), -EEXIST);
+        }
+        double t1 = tu_now_ms();
+        db_ingest_stats(&s1);
+        close(fd);
+
+        fprintf(stderr,
+                C_YEL "reupload %-10s %zu x %zu MiB: %.1f ms/upload  saved "
+                      "%" PRIu64 " MiB\n" C_RESET,
+                mode_name[mode], REPS, MB, (t1 - t0) / (double)REPS,
+                (s1.dedup_bytes_saved - s0.dedup_bytes_saved) >> 20);
+        tu_teardown_store(&ctx);
+    }
+    return 0;
+}
+
+static int tl_serve_open_for(void)
+{
+    const size_t N = env_sz("SERVE_N", 20000);
+
+    Ctx ctx;
+    if(tu_setup_store(&ctx) != 0)
+    {
+        tu_failf(__FILE__, __LINE__, "setup failed");
+        return -1;
+    }
+    uint8_t owner[DB_ID_SIZE] = {0};
+    char    eo[DB_EMAIL_MAX_LEN];
+    snprintf(eo, sizeof eo, "%s", "serve_bench@x.com");
+    db_add_user(eo, owner);
+    db_user_set_role_publisher(owner);
+
+    int fd = make_blob_sized("./.tmp_serve_bench.bin", 64 << 10, 0x5E7Eu);
+    unlink("./.tmp_serve_bench.bin");
+    uint8_t id[DB_ID_SIZE];
+    EXPECT_EQ_RC(db_data_add_from_fd(owner, fd, "x/bin", id), 0);
+    close(fd);
+
+    /* meta + path (second meta lookup) + open; no ACL check at all */
+    double t0 = tu_now_ms();
+    for(size_t i = 0; i < N; ++i)
+    {
+        DataMeta m;
+        char     p[PATH_MAX];
+        EXPECT_EQ_RC(db_data_get_meta(id, &m), 0);
+        EXPECT_EQ_RC(db_data_get_path(id, p, sizeof p), 0);
+        int rfd = open(p, O_RDONLY);
+        EXPECT_TRUE(rfd >= 0);
+        close(rfd);
+    }
+    double t1 = tu_now_ms();
+    for(size_t i = 0; i < N; ++i)
+    {
+        DataMeta m;
+        int      rfd = -1;
+        EXPECT_EQ_RC(db_data_open_for(owner, id, &rfd, &m), 0);
+        close(rfd);
+    }
+    double t2 = tu_now_ms();
+
+    fprintf(stderr,
+            C_YEL "serve open x%zu: meta+path+open %.2f us, open_for (acl) "
+                  "%.2f us\n" C_RESET,
+            N, (t1 - t0) * 1000.0 / (double)N, (t2 - t1) * 1000.0 / (double)N);
+    tu_teardown_store(&ctx);
+    return 0;
+}
+
+static int tl_gallery_metas_paths(void)
+{
+    const size_t N    = env_sz("GALLERY_N", 512);
+    const size_t REPS = env_sz("GALLERY_REPS", 50);
+
+    Ctx ctx;
+    if(tu_setup_store(&ctx) != 0)
+    {
+        tu_failf(__FILE__, __LINE__, "setup failed");
+        return -1;
+    }
+    uint8_t owner[DB_ID_SIZE] = {0};
+    char    eo[DB_EMAIL_MAX_LEN];
+    snprintf(eo, sizeof eo, "%s", "gallery_bench@x.com");
+    db_add_user(eo, owner);
+    db_user_set_role_publisher(owner);
+
+    int      *fds   = calloc(N, sizeof *fds);
+    int      *st    = calloc(N, sizeof *st);
+    uint8_t  *ids   = calloc(N, DB_ID_SIZE);
+    DataMeta *metas = calloc(N, sizeof *metas);
+    char     *paths = calloc(N, PATH_MAX);
+    EXPECT_TRUE(fds && st && ids && metas && paths);
+    for(size_t i = 0; i < N; ++i)
+    {
+        char p[64];
+        snprintf(p, sizeof p, "./.tmp_gal_%zu.bin", i);
+        fds[i] = make_blob_sized(p, 512, (uint32_t)(0x6A11u + i));
+        unlink(p);
+        EXPECT_TRUE(fds[i] >= 0);
+    }
+    EXPECT_EQ_RC(db_data_add_batch(owner, N, fds, NULL, ids, st), 0);
+    for(size_t i = 0; i < N; ++i)
+        close(fds[i]);
+
+    double t0 = tu_now_ms();
+    for(size_t r = 0; r < REPS; ++r)
+        for(size_t i = 0; i < N; ++i)
+        {
+            EXPECT_EQ_RC(db_data_get_meta(ids + i * DB_ID_SIZE, &metas[i]), 0);
+            EXPECT_EQ_RC(db_data_get_path(ids + i * DB_ID_SIZE,
+                                          paths + i * PATH_MAX, PATH_MAX),
+                         0);
+        }
+    double t1 = tu_now_ms();
+    for(size_t r = 0; r < REPS; ++r)
+    {
+        EXPECT_EQ_RC(db_data_get_metas(N, ids, metas, st), 0);
+        EXPECT_EQ_RC(db_data_get_paths(N, ids, paths, PATH_MAX, st), 0);
+    }
+    double t2 = tu_now_ms();
+
+    const double items = (double)(N * REPS);
+    fprintf(stderr,
+            C_YEL "gallery %zu ids x%zu: per-id meta+path %.3f us/item, "
+                  "batched %.3f us/item\n" C_RESET,
+            N, REPS, (t1 - t0) * 1000.0 / items, (t2 - t1) * 1000.0 / items);
+
+    free(fds);
+    free(st);
+    free(ids);
+    free(metas);
+    free(paths);
+    tu_teardown_store(&ctx);
+    return 0;
+}
+
+static int tl_meta_cache(void)
+{
+    const size_t N    = env_sz("MCACHE_N", 4096);
+    const size_t REPS = env_sz("MCACHE_REPS", 50);
+
+    Ctx ctx;
+    if(tu_setup_store(&ctx) != 0)
+    {
+        tu_failf(__FILE__, __LINE__, "setup failed");
+        return -1;
+    }
+    uint8_t owner[DB_ID_SIZE] = {0};
+    char    eo[DB_EMAIL_MAX_LEN];
+    snprintf(eo, sizeof eo, "%s", "mcache_bench@x.com");
+    db_add_user(eo, owner);
+    db_user_set_role_publisher(owner);
+
+    int     *fds = calloc(N, sizeof *fds);
+    int     *st  = calloc(N, sizeof *st);
+    uint8_t *ids = calloc(N, DB_ID_SIZE);
+    EXPECT_TRUE(fds && st && ids);
+    for(size_t i = 0; i < N; ++i)
+    {
+        char p[64];
+        snprintf(p, sizeof p, "./.tmp_mc_%zu.bin", i);
+        fds[i] = make_blob_sized(p, 256, (uint32_t)(0x3C4Eu + i));
+        unlink(p);
+        EXPECT_TRUE(fds[i] >= 0);
+    }
+    EXPECT_EQ_RC(db_data_add_batch(owner, N, fds, NULL, ids, st), 0);
+    for(size_t i = 0; i < N; ++i)
+        close(fds[i]);
+
+    /* the same hot set resolved through the DBI and through the cache */
+    const char* mode_name[2] = {"txn per lookup", "meta cache    "};
+    for(int mode = 0; mode < 2; ++mode)
+    {
+        db_close();
+        setenv("DB_META_CACHE", mode ? "65536" : "0", 1);
+        int rc = db_open(ctx.root, 256ULL << 20);
+        unsetenv("DB_META_CACHE");
+        EXPECT_EQ_RC(rc, 0);
+
+        char   path[PATH_MAX];
+        double t0 = tu_now_ms();
+        for(size_t r = 0; r < REPS; ++r)
+            for(size_t i = 0; i < N; ++i)
+                EXPECT_EQ_RC(
+                    db_data_get_path(ids + i * DB_ID_SIZE, path, sizeof path),
+                    0);
+        double t1 = tu_now_ms();
+
+        DbMetaCacheStats cs;
+        EXPECT_EQ_RC(db_meta_cache_stats(&cs), 0);
+        double lookups = (double)(N * REPS);
+        double hit_pct =
+            cs.hits + cs.misses
+                ? 100.0 * (double)cs.hits / (double)(cs.hits + cs.misses)
+                : 0.0;
+        fprintf(stderr,
+                C_YEL "get_path %s %zu ids x%zu: %.0f ns/lookup, "
+                      "hit rate %.1f%%\n" C_RESET,
+                mode_name[mode], N, REPS, (t1 - t0) * 1e6 / lookups, hit_pct);
+    }
+
+    free(fds);
+    free(st);
+    free(ids);
+    tu_teardown_store(&ctx);
+    return 0;
+}
+
+static int tl_shard_relayout(void)
+{
+    const size_t N = env_sz("RELAYOUT_N", 8192);
+
+    /* a small store in one directory level vs the default two, then moved
+       online to three levels */
+    const char* layouts[2] = {"1x2", "2x2"};
+    for(int l = 0; l < 2; ++l)
+    {
+        setenv("DB_SHARD_LAYOUT", layouts[l], 1);
+        Ctx ctx;
+        int rc = tu_setup_store(&ctx);
+        unsetenv("DB_SHARD_LAYOUT");
+        if(rc != 0)
+        {
+            tu_failf(__FILE__, __LINE__, "setup failed");
+            return -1;
+        }
+        uint8_t owner[DB_ID_SIZE] = {0};
+        char    eo[DB_EMAIL_MAX_LEN];
+        snprintf(eo, sizeof eo, "relayout_bench%d@x.com", l);
+        db_add_user(eo, owner);
+        db_user_set_role_publisher(owner);
+
+        int     *fds = calloc(N, sizeof *fds);
+        int     *st  = calloc(N, sizeof *st);
+        uint8_t *ids = calloc(N, DB_ID_SIZE);
+        EXPECT_TRUE(fds && st && ids);
+        for(size_t i = 0; i < N; ++i)
+        {
+            char p[64];
+            snprintf(p, sizeof p, "./.tmp_rl_%zu.bin", i);
+            fds[i] = make_blob_sized(p, 256, (uint32_t)(0x7E1Au + i));
+            unlink(p);
+            EXPECT_TRUE(fds[i] >= 0);
+        }
+        double t0 = tu_now_ms();
+        EXPECT_EQ_RC(db_data_add_batch(owner, N, fds, NULL, ids, st), 0);
+        double t1 = tu_now_ms();
+        for(size_t i = 0; i < N; ++i)
+            close(fds[i]);
+
+        DbRelayoutOptions o = {.levels = 3, .width = 2};
+        DbRelayoutReport  r;
+        double            t2 = tu_now_ms();
+        EXPECT_EQ_RC(db_data_relayout(&o, &r), 0);
+        double t3 = tu_now_ms();
+        EXPECT_TRUE(r.moved == N && r.errors == 0);
+
+        char path[PATH_MAX];
+        for(size_t i = 0; i < N; i += N / 16 + 1)
+        {
+            EXPECT_EQ_RC(
+                db_data_get_path(ids + i * DB_ID_SIZE, path, sizeof path), 0);
+            EXPECT_TRUE(access(path, F_OK) == 0);
+        }
+        fprintf(stderr,
+                C_YEL "layout %s: ingest %zu blobs %.0f/s; relayout to 3x2 "
+                      "%.0f ms (%.0f blobs/s, %llu shards)\n" C_RESET,
+                layouts[l], N, (double)N * 1000.0 / (t1 - t0), t3 - t2,
+                (double)N * 1000.0 / (t3 - t2),
+                (unsigned long long)r.shards);
+
+        free(fds);
+        free(st);
+        free(ids);
+        tu_teardown_store(&ctx);
+    }
+    return 0;
+}
+
+static int tl_meta_footprint(void)
+{
+    const size_t N = env_sz("META_N", 1024);
+
+    int*      fds   = calloc(N, sizeof *fds);
+    int*      st    = calloc(N, sizeof *st);
+    uint8_t*  ids   = calloc(N, DB_ID_SIZE);
+    DataMeta* metas = calloc(N, sizeof *metas);
+    EXPECT_TRUE(fds && st && ids && metas);
+
+    const char* mode_name[2] = {"inline-mime", "interned"};
+    const char* mimes[4]     = {"image/jpeg", "image/png", "application/dicom",
+                                "video/mp4"};
+    for(int mode = 0; mode < 2; ++mode)
+    {
+        setenv("DB_DURABILITY", "group", 1);
+        if(mode == 0)
+            setenv("DB_META_INLINE_MIME", "1", 1);
+        Ctx ctx;
+        int src = tu_setup_store(&ctx);
+        unsetenv("DB_DURABILITY");
+        unsetenv("DB_META_INLINE_MIME");
+        if(src != 0)
+        {
+            tu_failf(__FILE__, __LINE__, "setup failed");
+            break;
+        }
+        uint8_t owner[DB_ID_SIZE] = {0};
+        char    eo[DB_EMAIL_MAX_LEN];
+        snprintf(eo, sizeof eo, "%s", "meta_bench@x.com");
+        db_add_user(eo, owner);
+        db_user_set_role_publisher(owner);
+
+        const char** ms = calloc(N, sizeof *ms);
+        EXPECT_TRUE(ms != NULL);
+        for(size_t i = 0; i < N; ++i)
+        {
+            char p[64];
+            snprintf(p, sizeof p, "./.tmp_meta_%zu.bin", i);
+            fds[i] = make_blob_sized(p, 64, 0x3E7Au + (uint32_t)i);
+            unlink(p);
+            ms[i] = mimes[i % 4];
+        }
+
+        uint64_t used0 = 0, used1 = 0, map = 0;
+        uint32_t psz = 0;
+        db_env_metrics(&used0, &map, &psz);
+        EXPECT_EQ_RC(db_data_add_batch(owner, N, fds, ms, ids, st), 0);
+        db_env_metrics(&used1, &map, &psz);
+        for(size_t i = 0; i < N; ++i)
+            close(fds[i]);
+        free(ms);
+
+        double t0 = tu_now_ms();
+        for(int r = 0; r < 20; ++r)
+            EXPECT_EQ_RC(db_data_get_metas(N, ids, metas, st), 0);
+        double t1 = tu_now_ms();
+
+        fprintf(stderr,
+                C_YEL "meta %-11s %zu objs: +%.1f B/object in LMDB, "
+                      "get_metas %.3f us/item\n" C_RESET,
+                mode_name[mode], N, (double)(used1 - used0) / (double)N,
+                (t1 - t0) * 1000.0 / (double)(N * 20));
+        tu_teardown_store(&ctx);
+    }
+
+    free(fds);
+    free(st);
+    free(ids);
+    free(metas);
+    return 0;
+}
+
+static int cmp_meta_newest(const void* a, const void* b)
+{
+    const DataMeta* x = a;
+    const DataMeta* y = b;
+    return (x->created_at < y->created_at) - (x->created_at > y->created_at);
+}
+
+static int tl_my_uploads_page(void)
+{
+    const size_t N    = env_sz("MYUP_N", 2048);
+    const size_t PAGE = env_sz("MYUP_PAGE", 50);
+    const size_t REPS = env_sz("MYUP_REPS", 50);
+
+    setenv("DB_DURABILITY", "group", 1);
+    Ctx ctx;
+    int src = tu_setup_store(&ctx);
+    unsetenv("DB_DURABILITY");
+    if(src != 0)
+    {
+        tu_failf(__FILE__, __LINE__, "setup failed");
+        return -1;
+    }
+    uint8_t owner[DB_ID_SIZE] = {0};
+    char    eo[DB_EMAIL_MAX_LEN];
+    snprintf(eo, sizeof eo, "%s", "myup_bench@x.com");
+    db_add_user(eo, owner);
+    db_user_set_role_publisher(owner);
+
+    int*      fds   = calloc(N, sizeof *fds);
+    int*      st    = calloc(N, sizeof *st);
+    uint8_t*  ids   = calloc(N, DB_ID_SIZE);
+    uint8_t*  page  = calloc(PAGE, DB_ID_SIZE);
+    DataMeta* metas = calloc(N, sizeof *metas);
+    EXPECT_TRUE(fds && st && ids && page && metas);
+    for(size_t i = 0; i < N; ++i)
+    {
+        char p[64];
+        snprintf(p, sizeof p, "./.tmp_myup_%zu.bin", i);
+        fds[i] = make_blob_sized(p, 256, (uint32_t)(0x3C0Du + i));
+        unlink(p);
+        EXPECT_TRUE(fds[i] >= 0);
+    }
+    EXPECT_EQ_RC(db_data_add_batch(owner, N, fds, NULL, ids, st), 0);
+    for(size_t i = 0; i < N; ++i)
+        close(fds[i]);
+
+    /* without the index: fetch every meta the owner holds, sort, cut */
+    double t0 = tu_now_ms();
+    for(size_t r = 0; r < REPS; ++r)
+    {
+        EXPECT_EQ_RC(db_data_get_metas(N, ids, metas, st), 0);
+        qsort(metas, N, sizeof *metas, cmp_meta_newest);
+    }
+    double t1 = tu_now_ms();
+    for(size_t r = 0; r < REPS; ++r)
+    {
+        uint8_t tok[DB_PAGE_TOKEN_SIZE] = {0};
+        size_t  cnt                     = PAGE;
+        EXPECT_EQ_RC(db_data_list_by_owner(owner, tok, page, &cnt), 0);
+        EXPECT_TRUE(cnt == (PAGE < N ? PAGE : N));
+    }
+    double t2 = tu_now_ms();
+
+    fprintf(stderr,
+            C_YEL "my uploads %zu items, page %zu: scan+sort %.1f us/page, "
+                  "index %.1f us/page\n" C_RESET,
+            N, PAGE, (t1 - t0) * 1000.0 / (double)REPS,
+            (t2 - t1) * 1000.0 / (double)REPS);
+
+    free(fds);
+    free(st);
+    free(ids);
+    free(page);
+    free(metas);
+    tu_teardown_store(&ctx);
+    return 0;
+}
+
 static const TU_Test LOAD_TESTS[] = {
     {"add_many_users_sample_lookup", tl_add_many_users_sample_lookup},
     {"db_measure_size", tl_db_measure_size},
     {"upload_mixed_sizes_and_share_details",
      tl_upload_mixed_sizes_and_share_details},
+    {"ingest_zero_copy_vs_stream", tl_ingest_zero_copy_vs_stream},
+    {"add_batch_vs_serial", tl_add_batch_vs_serial},
+    {"ingest_engines", tl_ingest_engines},
+    {"small_objects_group_sync", tl_small_objects_group_sync},
+    {"reupload_hash_first", tl_reupload_hash_first},
+    {"serve_open_for", tl_serve_open_for},
+    {"gallery_metas_paths", tl_gallery_metas_paths},
+    {"meta_footprint", tl_meta_footprint},
+    {"my_uploads_page", tl_my_uploads_page},
+    {"small_objects_inline", tl_small_objects_inline},
+    {"small_objects_packed", tl_small_objects_packed},
+    {"compressed_blobs", tl_compressed_blobs},
+    {"chunked_reexport", tl_chunked_reexport},
+    {"gc_walk", tl_gc_walk},
+    {"scrub_cache", tl_scrub_cache},
+    {"delete_many", tl_delete_many},
+    {"add_from_buf", tl_add_from_buf},
+    {"upload_session", tl_upload_session},
+    {"sha256_backends", tl_sha256_backends},
+    {"blake3_vs_sha256", tl_blake3_vs_sha256},
+    {"meta_cache", tl_meta_cache},
+    {"shard_relayout", tl_shard_relayout},
 };
 
 static const size_t NLOAD = sizeof(LOAD_TESTS) / sizeof(LOAD_TESTS[0]);